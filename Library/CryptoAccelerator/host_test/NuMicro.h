@@ -0,0 +1,36 @@
+/*
+ * NuMicro.h for the host build of psa_crypto_driver_crpt.c.
+ *
+ * Pulls in the real CRPT/Key Store register layout and StdDriver
+ * prototypes, with CRPT pointing at a plain structure that crpt_sim.c
+ * operates on.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __NUMICRO_H__
+#define __NUMICRO_H__
+
+#include <stdint.h>
+
+#define __I         volatile const
+#define __O         volatile
+#define __IO        volatile
+#define __ALIGNED(x)        __attribute__((aligned(x)))
+#define __STATIC_INLINE     static inline
+
+#include "crypto_reg.h"
+#include "keystore_reg.h"
+
+extern CRPT_T g_sCrptSim;
+#define CRPT        (&g_sCrptSim)
+
+/* Any word-aligned buffer the 32-bit DMA address registers can hold; the
+ * harness links non-PIE so static data and small heap blocks qualify,
+ * stack buffers and large heap blocks take the bounce buffer path. */
+#define NU_CRPT_DMA_ADDR_OK(p)  ((((uintptr_t)(p)) & 3U) == 0 && ((uintptr_t)(p)) <= 0xFFFFFFF0UL)
+
+#include "keystore.h"
+#include "crypto.h"
+#include "rng.h"
+
+#endif /* __NUMICRO_H__ */
@@ -0,0 +1,1137 @@
+/*
+ * Software model of the M460 CRPT engine, Key Store SRAM and PRNG for the
+ * host build of psa_crypto_driver_crpt.c.
+ *
+ * Implements the StdDriver AES_*, SHA_*, ECC_*, RSA_*, KS_* and RNG_*
+ * functions the drivers call on top of CRPT_T registers in plain memory,
+ * using the mbed TLS software primitives. DMA addresses are taken as 32-bit pointers, so the
+ * test binary must be linked non-PIE (see Makefile). Each engine run bumps a
+ * counter in g_sCrptSimStat so tests can tell the driver was used.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* The ECC model works on mbedtls_ecp_group/point fields directly */
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "mbedtls/aes.h"
+#include "mbedtls/ccm.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/sha512.h"
+#include "mbedtls/ecp.h"
+#include "mbedtls/bignum.h"
+
+#include "NuMicro.h"
+#include "crpt_sim.h"
+
+#define SIM_KS_SRAM_KEYS    32
+
+CRPT_T g_sCrptSim;
+crpt_sim_stat_t g_sCrptSimStat;
+int32_t g_KS_i32ErrCode;
+
+static struct
+{
+    int      used;
+    uint32_t meta;
+    uint32_t key[18];
+} s_asKs[SIM_KS_SRAM_KEYS];
+
+static uint32_t s_au32PrngN[18];
+
+/* GCM message of a DMA cascade: the engine keeps its state in the feedback
+ * buffer, the model checks the driver hands back the one it wrote last */
+static mbedtls_gcm_context s_sGcm;
+static int s_iGcmOpen;
+static uint32_t s_u32GcmLeft, s_u32GcmSeq;
+
+static void *s_pvRsaBuf;
+
+static union
+{
+    mbedtls_sha256_context sha256;
+    mbedtls_sha512_context sha512;
+} s_sha;
+
+/*
+ * Helpers
+ */
+
+static uint32_t sim_rand32(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static int sim_rng(void *p, unsigned char *out, size_t len)
+{
+    (void)p;
+    while(len--)
+        *out++ = (unsigned char)sim_rand32();
+    return 0;
+}
+
+static void sim_be32(const uint32_t *words, size_t n, uint8_t *out)
+{
+    size_t i;
+
+    for(i = 0; i < n; i++)
+    {
+        out[4 * i] = (uint8_t)(words[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(words[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(words[i] >> 8);
+        out[4 * i + 3] = (uint8_t)words[i];
+    }
+}
+
+static int sim_zero(const uint8_t *p, size_t len)
+{
+    while(len--)
+    {
+        if(*p++ != 0)
+            return 0;
+    }
+    return 1;
+}
+
+static int sim_curve(E_ECC_CURVE curve, mbedtls_ecp_group *grp, size_t *bytes)
+{
+    mbedtls_ecp_group_id id;
+
+    if(curve == CURVE_P_256)
+        id = MBEDTLS_ECP_DP_SECP256R1;
+    else if(curve == CURVE_P_384)
+        id = MBEDTLS_ECP_DP_SECP384R1;
+    else
+        return -1;
+
+    mbedtls_ecp_group_init(grp);
+    if(mbedtls_ecp_group_load(grp, id) != 0)
+        return -1;
+    *bytes = mbedtls_mpi_size(&grp->P);
+    return 0;
+}
+
+static int sim_ecc_ready(CRPT_T *crpt)
+{
+    /* ECC_* spin on g_ECC_done, which only ECC_DriverISR() sets */
+    return (crpt->INTEN & CRPT_INTEN_ECCIEN_Msk) != 0;
+}
+
+static int sim_read_hex(mbedtls_mpi *x, const char *hex)
+{
+    return mbedtls_mpi_read_string(x, 16, hex);
+}
+
+static void sim_write_hex(const mbedtls_mpi *x, size_t bytes, char *hex)
+{
+    static const char s_acHex[] = "0123456789abcdef";
+    uint8_t buf[72];
+    size_t i;
+
+    mbedtls_mpi_write_binary(x, buf, bytes);
+    for(i = 0; i < bytes; i++)
+    {
+        *hex++ = s_acHex[buf[i] >> 4];
+        *hex++ = s_acHex[buf[i] & 0xF];
+    }
+    *hex = '\0';
+}
+
+/* Key Store words are least significant first, see CRPT_Hex2Reg() */
+static int sim_ks_ecc_key(int32_t idx, size_t bytes, mbedtls_mpi *x)
+{
+    uint8_t buf[72];
+    size_t i, words = bytes / 4;
+
+    if(idx < 0 || idx >= SIM_KS_SRAM_KEYS || !s_asKs[idx].used ||
+            (s_asKs[idx].meta & KS_METADATA_OWNER_Msk) != KS_META_ECC ||
+            KS_GetKeyWordCnt(s_asKs[idx].meta) != words)
+        return -1;
+
+    for(i = 0; i < words; i++)
+        sim_be32(&s_asKs[idx].key[words - 1 - i], 1, buf + 4 * i);
+
+    return mbedtls_mpi_read_binary(x, buf, bytes);
+}
+
+static int32_t sim_ks_write_ecc(const mbedtls_mpi *x, size_t bytes, uint32_t meta)
+{
+    uint8_t buf[72];
+    uint32_t words[18];
+    size_t i, n = bytes / 4;
+
+    memset(words, 0, sizeof(words));
+    mbedtls_mpi_write_binary(x, buf, bytes);
+    for(i = 0; i < n; i++)
+    {
+        const uint8_t *p = buf + bytes - 4 * (i + 1);
+        words[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                   ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    return KS_Write(KS_SRAM, meta, words);
+}
+
+/*
+ * Key Store
+ */
+
+int32_t KS_Open(void)
+{
+    g_sCrptSimStat.ks_opened = 1;
+    return 0;
+}
+
+uint32_t KS_GetKeyWordCnt(uint32_t u32Meta)
+{
+    const uint16_t au8CntTbl[21] = { 4, 6, 6, 7, 8, 8, 8, 9, 12, 13, 16, 17, 18, 0, 0, 0, 32, 48, 64, 96, 128 };
+    return au8CntTbl[((u32Meta & KS_METADATA_SIZE_Msk) >> KS_METADATA_SIZE_Pos)];
+}
+
+int32_t KS_Write(KS_MEM_Type eType, uint32_t u32Meta, uint32_t au32Key[])
+{
+    int32_t i;
+    uint32_t cnt = KS_GetKeyWordCnt(u32Meta);
+
+    if(!g_sCrptSimStat.ks_opened || eType != KS_SRAM || cnt == 0 || cnt > 18)
+        return -1;
+
+    for(i = 0; i < SIM_KS_SRAM_KEYS; i++)
+    {
+        if(!s_asKs[i].used)
+        {
+            s_asKs[i].used = 1;
+            s_asKs[i].meta = u32Meta;
+            memset(s_asKs[i].key, 0, sizeof(s_asKs[i].key));
+            memcpy(s_asKs[i].key, au32Key, cnt * 4);
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int32_t KS_EraseKey(int32_t i32KeyIdx)
+{
+    if(i32KeyIdx < 0 || i32KeyIdx >= SIM_KS_SRAM_KEYS || !s_asKs[i32KeyIdx].used)
+        return -1;
+
+    memset(&s_asKs[i32KeyIdx], 0, sizeof(s_asKs[i32KeyIdx]));
+    return 0;
+}
+
+int crpt_sim_ks_keys(void)
+{
+    int i, n = 0;
+
+    for(i = 0; i < SIM_KS_SRAM_KEYS; i++)
+        n += s_asKs[i].used;
+
+    return n;
+}
+
+/*
+ * PRNG into Key Store
+ */
+
+int32_t RNG_Open(void)
+{
+    return 0;
+}
+
+static int32_t sim_rng_init(uint32_t u32KeySize, uint32_t au32ECC_N[18], uint32_t u32Mode)
+{
+    (void)u32KeySize;
+
+    memcpy(s_au32PrngN, au32ECC_N, sizeof(s_au32PrngN));
+    CRPT->PRNG_KSCTL = (KS_OWNER_ECC << CRPT_PRNG_KSCTL_OWNER_Pos) | u32Mode |
+                       CRPT_PRNG_KSCTL_WDST_Msk | (KS_SRAM << CRPT_PRNG_KSCTL_WSDST_Pos);
+    return 0;
+}
+
+int32_t RNG_ECDSA_Init(uint32_t u32KeySize, uint32_t au32ECC_N[18])
+{
+    return sim_rng_init(u32KeySize, au32ECC_N, CRPT_PRNG_KSCTL_ECDSA_Msk);
+}
+
+int32_t RNG_ECDH_Init(uint32_t u32KeySize, uint32_t au32ECC_N[18])
+{
+    return sim_rng_init(u32KeySize, au32ECC_N, CRPT_PRNG_KSCTL_ECDH_Msk);
+}
+
+/* Random integer in [1, n-1] written straight to Key Store SRAM */
+static int32_t sim_rng_ks(uint32_t u32KeySize)
+{
+    mbedtls_mpi n, x;
+    uint8_t buf[48];
+    size_t bytes, i;
+    uint32_t meta;
+    int32_t idx = -1;
+
+    if((CRPT->PRNG_KSCTL & CRPT_PRNG_KSCTL_WDST_Msk) == 0)
+        return -1;
+
+    if(u32KeySize == PRNG_KEY_SIZE_256)
+    {
+        bytes = 32;
+        meta = KS_META_ECC | KS_META_256;
+    }
+    else if(u32KeySize == PRNG_KEY_SIZE_384)
+    {
+        bytes = 48;
+        meta = KS_META_ECC | KS_META_384;
+    }
+    else
+        return -1;
+
+    mbedtls_mpi_init(&n);
+    mbedtls_mpi_init(&x);
+    for(i = 0; i < bytes / 4; i++)
+        sim_be32(&s_au32PrngN[bytes / 4 - 1 - i], 1, buf + 4 * i);
+    mbedtls_mpi_read_binary(&n, buf, bytes);
+
+    do
+    {
+        sim_rng(NULL, buf, bytes);
+        mbedtls_mpi_read_binary(&x, buf, bytes);
+    }
+    while(mbedtls_mpi_cmp_int(&x, 1) < 0 || mbedtls_mpi_cmp_mpi(&x, &n) >= 0);
+
+    idx = sim_ks_write_ecc(&x, bytes, meta);
+    g_sCrptSimStat.prng_ks++;
+
+    mbedtls_mpi_free(&n);
+    mbedtls_mpi_free(&x);
+    return idx;
+}
+
+int32_t RNG_ECDSA(uint32_t u32KeySize)
+{
+    return sim_rng_ks(u32KeySize);
+}
+
+int32_t RNG_ECDH(uint32_t u32KeySize)
+{
+    return sim_rng_ks(u32KeySize);
+}
+
+/*
+ * AES
+ */
+
+void AES_Open(CRPT_T *crpt, uint32_t u32Channel, uint32_t u32EncDec,
+              uint32_t u32OpMode, uint32_t u32KeySize, uint32_t u32SwapType)
+{
+    (void)u32Channel;
+
+    crpt->AES_CTL = (u32EncDec << CRPT_AES_CTL_ENCRPT_Pos) |
+                    (u32OpMode << CRPT_AES_CTL_OPMODE_Pos) |
+                    (u32KeySize << CRPT_AES_CTL_KEYSZ_Pos) |
+                    (u32SwapType << CRPT_AES_CTL_OUTSWAP_Pos);
+}
+
+void AES_SetKey(CRPT_T *crpt, uint32_t u32Channel, uint32_t au32Keys[], uint32_t u32KeySize)
+{
+    uint32_t i;
+
+    (void)u32Channel;
+
+    for(i = 0; i < 4UL + u32KeySize * 2UL; i++)
+        crpt->AES_KEY[i] = au32Keys[i];
+}
+
+void AES_SetKey_KS(CRPT_T *crpt, KS_MEM_Type mem, int32_t i32KeyIdx)
+{
+    crpt->AES_KSCTL = CRPT_AES_KSCTL_RSRC_Msk |
+                      (uint32_t)((int)mem << CRPT_AES_KSCTL_RSSRC_Pos) |
+                      (uint32_t)i32KeyIdx;
+}
+
+void AES_SetInitVect(CRPT_T *crpt, uint32_t u32Channel, uint32_t au32IV[])
+{
+    uint32_t i;
+
+    (void)u32Channel;
+
+    for(i = 0; i < 4; i++)
+        crpt->AES_IV[i] = au32IV[i];
+}
+
+void AES_SetDMATransfer(CRPT_T *crpt, uint32_t u32Channel, uint32_t u32SrcAddr,
+                        uint32_t u32DstAddr, uint32_t u32TransCnt)
+{
+    (void)u32Channel;
+
+    crpt->AES_SADDR = u32SrcAddr;
+    crpt->AES_DADDR = u32DstAddr;
+    crpt->AES_CNT = u32TransCnt;
+}
+
+static int sim_gcm(CRPT_T *crpt, const uint8_t *key, uint32_t keysz, int enc,
+                   const uint8_t *src, uint8_t *dst, uint32_t cnt, uint32_t u32DMAMode);
+static int sim_ccm(CRPT_T *crpt, const uint8_t *key, uint32_t keysz, int enc,
+                   const uint8_t *src, uint8_t *dst, uint32_t cnt);
+
+static int sim_aes(CRPT_T *crpt, uint32_t u32DMAMode)
+{
+    static const uint32_t au32Meta[3] = { KS_META_128, KS_META_192, KS_META_256 };
+    mbedtls_aes_context ctx;
+    uint32_t ctl = crpt->AES_CTL;
+    uint32_t keysz = (ctl & CRPT_AES_CTL_KEYSZ_Msk) >> CRPT_AES_CTL_KEYSZ_Pos;
+    uint32_t mode = (ctl & CRPT_AES_CTL_OPMODE_Msk) >> CRPT_AES_CTL_OPMODE_Pos;
+    int enc = (ctl & CRPT_AES_CTL_ENCRPT_Msk) != 0;
+    const uint8_t *src = (const uint8_t *)(uintptr_t)crpt->AES_SADDR;
+    uint8_t *dst = (uint8_t *)(uintptr_t)crpt->AES_DADDR;
+    uint32_t cnt = crpt->AES_CNT, words[8];
+    uint8_t key[32], iv[16], stream[16];
+    size_t off = 0, i;
+    int ret;
+
+    /* The drivers hand the engine byte streams */
+    if((ctl & (CRPT_AES_CTL_INSWAP_Msk | CRPT_AES_CTL_OUTSWAP_Msk)) !=
+            (CRPT_AES_CTL_INSWAP_Msk | CRPT_AES_CTL_OUTSWAP_Msk) ||
+            keysz > 2 || cnt == 0 || (cnt & 15) != 0 || ((uintptr_t)src & 3) || ((uintptr_t)dst & 3))
+        return -1;
+
+    if(crpt->AES_KSCTL & CRPT_AES_KSCTL_RSRC_Msk)
+    {
+        int32_t idx = (int32_t)(crpt->AES_KSCTL & CRPT_AES_KSCTL_NUM_Msk);
+
+        if(!s_asKs[idx].used || (s_asKs[idx].meta & KS_METADATA_OWNER_Msk) != KS_META_AES ||
+                (s_asKs[idx].meta & KS_METADATA_SIZE_Msk) != au32Meta[keysz])
+            return -1;
+        memcpy(words, s_asKs[idx].key, sizeof(words));
+        g_sCrptSimStat.aes_ks++;
+    }
+    else
+    {
+        for(i = 0; i < 8; i++)
+            words[i] = crpt->AES_KEY[i];
+    }
+    sim_be32(words, 4 + keysz * 2, key);
+    for(i = 0; i < 4; i++)
+        words[i] = crpt->AES_IV[i];
+    sim_be32(words, 4, iv);
+
+    /* Only GCM has a DMA cascade here */
+    if(mode == AES_MODE_GCM)
+        return sim_gcm(crpt, key, keysz, enc, src, dst, cnt, u32DMAMode);
+    if(u32DMAMode != CRYPTO_DMA_ONE_SHOT)
+        return -1;
+    if(mode == AES_MODE_CCM)
+        return sim_ccm(crpt, key, keysz, enc, src, dst, cnt);
+
+    mbedtls_aes_init(&ctx);
+    if(enc || mode == AES_MODE_CTR)
+        ret = mbedtls_aes_setkey_enc(&ctx, key, 128 + keysz * 64);
+    else
+        ret = mbedtls_aes_setkey_dec(&ctx, key, 128 + keysz * 64);
+
+    if(ret == 0)
+    {
+        switch(mode)
+        {
+        case AES_MODE_ECB:
+            for(i = 0; i < cnt && ret == 0; i += 16)
+                ret = mbedtls_aes_crypt_ecb(&ctx, enc ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT,
+                                            src + i, dst + i);
+            break;
+        case AES_MODE_CBC:
+            ret = mbedtls_aes_crypt_cbc(&ctx, enc ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT,
+                                        cnt, iv, src, dst);
+            break;
+        case AES_MODE_CTR:
+            ret = mbedtls_aes_crypt_ctr(&ctx, cnt, &off, iv, stream, src, dst);
+            break;
+        default:
+            ret = -1;
+            break;
+        }
+    }
+
+    mbedtls_aes_free(&ctx);
+    return ret;
+}
+
+#define SIM_ALIGN16(len)    (((len) + 15U) & ~15U)
+
+/* {IV}{A}{P} in one shot, or {IV}{A} with FBOUT and then P in DMA cascade
+ * runs with FBIN and FBOUT, as gcm_alt.c packs them. Output text, then the
+ * tag after its last block. */
+static int sim_gcm(CRPT_T *crpt, const uint8_t *key, uint32_t keysz, int enc,
+                   const uint8_t *src, uint8_t *dst, uint32_t cnt, uint32_t u32DMAMode)
+{
+    uint32_t ctl = crpt->AES_CTL;
+    uint32_t fb = ctl & (CRPT_AES_CTL_FBIN_Msk | CRPT_AES_CTL_FBOUT_Msk);
+    uint32_t ivlen = crpt->AES_GCM_IVCNT[0], alen = crpt->AES_GCM_ACNT[0];
+    uint32_t plen = crpt->AES_GCM_PCNT[0], hdr, len;
+    uint8_t *fbuf = (uint8_t *)(uintptr_t)crpt->AES_FBADDR;
+    uint8_t bits[16];
+    size_t olen;
+    int ret = 0;
+
+    if(crpt->AES_GCM_IVCNT[1] != 0 || crpt->AES_GCM_ACNT[1] != 0 || crpt->AES_GCM_PCNT[1] != 0)
+        return -1;
+
+    if(u32DMAMode == CRYPTO_DMA_ONE_SHOT || u32DMAMode == CRYPTO_DMA_FIRST)
+    {
+        /* IV || 0^31 || 1 for 96 bits, else IV || 0 || [len(IV)]64 */
+        hdr = (ivlen == 12) ? 16 : SIM_ALIGN16(ivlen) + 16;
+        memset(bits, 0, sizeof(bits));
+        if(ivlen == 12)
+        {
+            bits[15] = 1;
+            if(memcmp(src + 12, bits + 12, 4) != 0)
+                return -1;
+        }
+        else
+        {
+            bits[12] = (uint8_t)(ivlen >> 21);
+            bits[13] = (uint8_t)(ivlen >> 13);
+            bits[14] = (uint8_t)(ivlen >> 5);
+            bits[15] = (uint8_t)(ivlen << 3);
+            if(ivlen == 0 || memcmp(src + hdr - 16, bits, 16) != 0)
+                return -1;
+        }
+        len = hdr + SIM_ALIGN16(alen);
+        if(u32DMAMode == CRYPTO_DMA_ONE_SHOT ? (fb != 0 || cnt != len + SIM_ALIGN16(plen)) :
+                (fb != CRPT_AES_CTL_FBOUT_Msk || cnt != len || plen == 0 || fbuf == NULL))
+            return -1;
+
+        mbedtls_gcm_free(&s_sGcm);
+        mbedtls_gcm_init(&s_sGcm);
+        s_iGcmOpen = 0;
+        ret = mbedtls_gcm_setkey(&s_sGcm, MBEDTLS_CIPHER_ID_AES, key, 128 + keysz * 64);
+        if(ret == 0)
+            ret = mbedtls_gcm_starts(&s_sGcm, enc ? MBEDTLS_GCM_ENCRYPT : MBEDTLS_GCM_DECRYPT, src, ivlen);
+        if(ret == 0)
+            ret = mbedtls_gcm_update_ad(&s_sGcm, src + hdr, alen);
+        if(ret != 0)
+            return -1;
+
+        if(u32DMAMode == CRYPTO_DMA_FIRST)
+        {
+            s_iGcmOpen = 1;
+            s_u32GcmLeft = plen;
+            s_u32GcmSeq++;
+            memcpy(fbuf, &s_u32GcmSeq, 4);
+            return 0;
+        }
+        src += len;
+    }
+    else
+    {
+        if(!s_iGcmOpen || fb != (CRPT_AES_CTL_FBIN_Msk | CRPT_AES_CTL_FBOUT_Msk) || fbuf == NULL ||
+                memcmp(fbuf, &s_u32GcmSeq, 4) != 0 || cnt == 0 || (cnt & 15) != 0)
+            return -1;
+        if(u32DMAMode == CRYPTO_DMA_CONTINUE ? cnt >= s_u32GcmLeft : cnt != SIM_ALIGN16(s_u32GcmLeft))
+            return -1;
+        plen = (u32DMAMode == CRYPTO_DMA_CONTINUE) ? cnt : s_u32GcmLeft;
+        s_u32GcmLeft -= plen;
+        s_u32GcmSeq++;
+        memcpy(fbuf, &s_u32GcmSeq, 4);
+        if(u32DMAMode == CRYPTO_DMA_CONTINUE)
+            return mbedtls_gcm_update(&s_sGcm, src, plen, dst, plen, &olen);
+        s_iGcmOpen = 0;
+    }
+
+    ret = mbedtls_gcm_update(&s_sGcm, src, plen, dst, plen, &olen);
+    if(ret == 0)
+        ret = mbedtls_gcm_finish(&s_sGcm, NULL, 0, &olen, dst + SIM_ALIGN16(plen), 16);
+    mbedtls_gcm_free(&s_sGcm);
+    return ret;
+}
+
+/* B0 || [len(A)]16 || A || P, each padded to a block, with Ctr0 in AES_IV,
+ * as ccm_alt.c packs them. Output text, then the tag after its last block;
+ * decryption returns the tag over the plaintext without checking it. */
+static int sim_ccm(CRPT_T *crpt, const uint8_t *key, uint32_t keysz, int enc,
+                   const uint8_t *src, uint8_t *dst, uint32_t cnt)
+{
+    mbedtls_ccm_context ctx;
+    uint32_t q = (src[0] & 7U) + 1U, tlen = ((src[0] >> 3) & 7U) * 2U + 2U;
+    uint32_t alen = ((uint32_t)src[16] << 8) | src[17], plen = 0, i, words[4];
+    uint8_t ctr0[16];
+    size_t olen;
+    int ret;
+
+    for(i = 16 - q; i < 16; i++)
+        plen = (plen << 8) | src[i];
+    for(i = 0; i < 4; i++)
+        words[i] = crpt->AES_IV[i];
+    sim_be32(words, 4, ctr0);
+
+    if(q < 2 || q > 8 || tlen < 4 || (src[0] & 0x80) || ((src[0] & 0x40) != 0) != (alen != 0) ||
+            ctr0[0] != q - 1 || memcmp(ctr0 + 1, src + 1, 15 - q) != 0 || !sim_zero(ctr0 + 16 - q, q) ||
+            crpt->AES_GCM_ACNT[0] != 16 + SIM_ALIGN16(alen + 2) || crpt->AES_GCM_PCNT[0] != plen ||
+            cnt != 16 + SIM_ALIGN16(alen + 2) + SIM_ALIGN16(plen))
+        return -1;
+
+    mbedtls_ccm_init(&ctx);
+    ret = mbedtls_ccm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, key, 128 + keysz * 64);
+    if(ret == 0)
+        ret = mbedtls_ccm_starts(&ctx, enc ? MBEDTLS_CCM_ENCRYPT : MBEDTLS_CCM_DECRYPT, src + 1, 15 - q);
+    if(ret == 0)
+        ret = mbedtls_ccm_set_lengths(&ctx, alen, plen, tlen);
+    if(ret == 0)
+        ret = mbedtls_ccm_update_ad(&ctx, src + 18, alen);
+    if(ret == 0)
+        ret = mbedtls_ccm_update(&ctx, src + 16 + SIM_ALIGN16(alen + 2), plen, dst, plen, &olen);
+    if(ret == 0)
+        ret = mbedtls_ccm_finish(&ctx, dst + SIM_ALIGN16(plen), tlen);
+    mbedtls_ccm_free(&ctx);
+    return ret;
+}
+
+void AES_Start(CRPT_T *crpt, int32_t u32Channel, uint32_t u32DMAMode)
+{
+    uint32_t mode = (crpt->AES_CTL & CRPT_AES_CTL_OPMODE_Msk) >> CRPT_AES_CTL_OPMODE_Pos;
+
+    (void)u32Channel;
+
+    crpt->AES_CTL |= CRPT_AES_CTL_START_Msk | (u32DMAMode << CRPT_AES_CTL_DMALAST_Pos);
+    crpt->INTSTS &= ~(CRPT_INTSTS_AESIF_Msk | CRPT_INTSTS_AESEIF_Msk);
+
+    if(sim_aes(crpt, u32DMAMode) != 0)
+    {
+        crpt->INTSTS |= CRPT_INTSTS_AESEIF_Msk;
+        g_sCrptSimStat.errors++;
+    }
+    else
+    {
+        crpt->INTSTS |= CRPT_INTSTS_AESIF_Msk;
+        if(mode == AES_MODE_GCM || mode == AES_MODE_CCM)
+            g_sCrptSimStat.aead++;
+        else
+            g_sCrptSimStat.aes++;
+    }
+    crpt->AES_CTL &= ~CRPT_AES_CTL_START_Msk;
+}
+
+/*
+ * SHA
+ */
+
+void SHA_Open(CRPT_T *crpt, uint32_t u32OpMode, uint32_t u32SwapType, uint32_t hmac_key_len)
+{
+    crpt->HMAC_CTL = (u32OpMode << CRPT_HMAC_CTL_OPMODE_Pos) |
+                     (u32SwapType << CRPT_HMAC_CTL_OUTSWAP_Pos);
+
+    if(hmac_key_len != 0UL)
+        crpt->HMAC_KEYCNT = hmac_key_len;
+}
+
+void SHA_SetDMATransfer(CRPT_T *crpt, uint32_t u32SrcAddr, uint32_t u32TransCnt)
+{
+    crpt->HMAC_SADDR = u32SrcAddr;
+    crpt->HMAC_DMACNT = u32TransCnt;
+}
+
+static int sim_sha(CRPT_T *crpt, uint32_t u32DMAMode)
+{
+    uint32_t mode = (crpt->HMAC_CTL & CRPT_HMAC_CTL_OPMODE_Msk) >> CRPT_HMAC_CTL_OPMODE_Pos;
+    const uint8_t *src = (const uint8_t *)(uintptr_t)crpt->HMAC_SADDR;
+    uint32_t cnt = crpt->HMAC_DMACNT;
+    int first, last, is512 = (mode == SHA_MODE_SHA384 || mode == SHA_MODE_SHA512);
+    uint8_t digest[64];
+    size_t i, len;
+
+    if(mode != SHA_MODE_SHA224 && mode != SHA_MODE_SHA256 &&
+            mode != SHA_MODE_SHA384 && mode != SHA_MODE_SHA512)
+        return -1;
+    if(((crpt->HMAC_CTL >> CRPT_HMAC_CTL_OUTSWAP_Pos) & 3) != SHA_IN_OUT_SWAP)
+        return -1;
+
+    /* ONE_SHOT: whole message. With DMACSCAD, DMAFIRST starts a message,
+     * DMALAST ends it, and every block but the last must be whole. */
+    if(u32DMAMode == CRYPTO_DMA_ONE_SHOT)
+    {
+        first = last = 1;
+    }
+    else if(u32DMAMode == CRYPTO_DMA_CONTINUE || u32DMAMode == CRYPTO_DMA_LAST)
+    {
+        first = (crpt->HMAC_CTL & CRPT_HMAC_CTL_DMAFIRST_Msk) != 0;
+        last = (u32DMAMode == CRYPTO_DMA_LAST);
+        if(!last && (cnt % (is512 ? 128 : 64)) != 0)
+            return -1;
+        if(!first && !g_sCrptSimStat.sha_open)
+            return -1;
+    }
+    else
+        return -1;
+
+    if(first)
+    {
+        if(is512)
+        {
+            mbedtls_sha512_init(&s_sha.sha512);
+            mbedtls_sha512_starts(&s_sha.sha512, mode == SHA_MODE_SHA384);
+        }
+        else
+        {
+            mbedtls_sha256_init(&s_sha.sha256);
+            mbedtls_sha256_starts(&s_sha.sha256, mode == SHA_MODE_SHA224);
+        }
+    }
+
+    if(is512)
+        mbedtls_sha512_update(&s_sha.sha512, src, cnt);
+    else
+        mbedtls_sha256_update(&s_sha.sha256, src, cnt);
+    g_sCrptSimStat.sha_open = !last;
+
+    if(last)
+    {
+        if(is512)
+        {
+            mbedtls_sha512_finish(&s_sha.sha512, digest);
+            len = (mode == SHA_MODE_SHA384) ? 48 : 64;
+        }
+        else
+        {
+            mbedtls_sha256_finish(&s_sha.sha256, digest);
+            len = (mode == SHA_MODE_SHA224) ? 28 : 32;
+        }
+        /* OUTSWAP: digest bytes in memory order */
+        for(i = 0; i < len / 4; i++)
+            memcpy((void *)&crpt->HMAC_DGST[i], digest + 4 * i, 4);
+    }
+
+    return 0;
+}
+
+void SHA_Start(CRPT_T *crpt, uint32_t u32DMAMode)
+{
+    crpt->HMAC_CTL &= ~(0x7UL << CRPT_HMAC_CTL_DMALAST_Pos);
+    crpt->HMAC_CTL |= CRPT_HMAC_CTL_START_Msk | (u32DMAMode << CRPT_HMAC_CTL_DMALAST_Pos);
+    crpt->INTSTS &= ~(CRPT_INTSTS_HMACIF_Msk | CRPT_INTSTS_HMACEIF_Msk);
+
+    if(sim_sha(crpt, u32DMAMode) != 0)
+    {
+        crpt->INTSTS |= CRPT_INTSTS_HMACEIF_Msk;
+        g_sCrptSimStat.errors++;
+    }
+    else
+    {
+        crpt->INTSTS |= CRPT_INTSTS_HMACIF_Msk;
+        g_sCrptSimStat.sha++;
+    }
+    crpt->HMAC_CTL &= ~CRPT_HMAC_CTL_START_Msk;
+}
+
+void SHA_Read(CRPT_T *crpt, uint32_t u32Digest[])
+{
+    uint32_t i, wcnt;
+
+    i = (crpt->HMAC_CTL & CRPT_HMAC_CTL_OPMODE_Msk) >> CRPT_HMAC_CTL_OPMODE_Pos;
+
+    if(i == SHA_MODE_SHA224)
+        wcnt = 7UL;
+    else if(i == SHA_MODE_SHA256)
+        wcnt = 8UL;
+    else if(i == SHA_MODE_SHA384)
+        wcnt = 12UL;
+    else
+        wcnt = 16UL;
+
+    for(i = 0UL; i < wcnt; i++)
+        u32Digest[i] = crpt->HMAC_DGST[i];
+}
+
+/*
+ * ECC
+ */
+
+void CRPT_Hex2Reg(char input[], uint32_t volatile reg[])
+{
+    int si = (int)strlen(input) - 1, ri = 0;
+    uint32_t i, val32, hex;
+    char c;
+
+    while(si >= 0)
+    {
+        val32 = 0UL;
+        for(i = 0UL; (i < 8UL) && (si >= 0); i++)
+        {
+            c = input[si--];
+            hex = (c >= 'a') ? (uint32_t)(c - 'a' + 10) : (c >= 'A') ? (uint32_t)(c - 'A' + 10) : (uint32_t)(c - '0');
+            val32 |= hex << (i * 4UL);
+        }
+        reg[ri++] = val32;
+    }
+}
+
+static int32_t sim_public_key(CRPT_T *crpt, E_ECC_CURVE ecc_curve, const mbedtls_mpi *d,
+                              char public_k1[], char public_k2[])
+{
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_point Q;
+    size_t bytes;
+    int32_t ret = -1;
+
+    if(!sim_ecc_ready(crpt) || sim_curve(ecc_curve, &grp, &bytes) != 0)
+        return -1;
+    mbedtls_ecp_point_init(&Q);
+
+    if(mbedtls_ecp_mul(&grp, &Q, d, &grp.G, sim_rng, NULL) == 0)
+    {
+        sim_write_hex(&Q.X, bytes, public_k1);
+        sim_write_hex(&Q.Y, bytes, public_k2);
+        g_sCrptSimStat.ecc++;
+        ret = 0;
+    }
+
+    mbedtls_ecp_point_free(&Q);
+    mbedtls_ecp_group_free(&grp);
+    return ret;
+}
+
+int32_t ECC_GeneratePublicKey(CRPT_T *crpt, E_ECC_CURVE ecc_curve, char *private_k,
+                              char public_k1[], char public_k2[])
+{
+    mbedtls_mpi d;
+    int32_t ret;
+
+    mbedtls_mpi_init(&d);
+    ret = (sim_read_hex(&d, private_k) == 0) ?
+          sim_public_key(crpt, ecc_curve, &d, public_k1, public_k2) : -1;
+    mbedtls_mpi_free(&d);
+    return ret;
+}
+
+int32_t ECC_GeneratePublicKey_KS(CRPT_T *crpt, E_ECC_CURVE ecc_curve, KS_MEM_Type mem,
+                                 int32_t i32KeyIdx, char public_k1[], char public_k2[],
+                                 uint32_t u32ExtraOp)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_mpi d;
+    size_t bytes;
+    int32_t ret = -1;
+
+    (void)u32ExtraOp;
+
+    crpt->ECC_KSCTL = ((uint32_t)mem << 6) | CRPT_ECC_KSCTL_RSRCK_Msk | (uint32_t)i32KeyIdx;
+    if(mem != KS_SRAM || sim_curve(ecc_curve, &grp, &bytes) != 0)
+        return -2;
+    mbedtls_ecp_group_free(&grp);
+
+    mbedtls_mpi_init(&d);
+    if(sim_ks_ecc_key(i32KeyIdx, bytes, &d) == 0)
+    {
+        ret = sim_public_key(crpt, ecc_curve, &d, public_k1, public_k2);
+        if(ret == 0)
+            g_sCrptSimStat.ecc_ks++;
+    }
+    mbedtls_mpi_free(&d);
+    return ret;
+}
+
+static int32_t sim_sign(CRPT_T *crpt, E_ECC_CURVE ecc_curve, char *message,
+                        const mbedtls_mpi *d, const mbedtls_mpi *k, char *R, char *S)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_point P;
+    mbedtls_mpi e, r, s, t;
+    size_t bytes;
+    int ret;
+
+    if(!sim_ecc_ready(crpt) || sim_curve(ecc_curve, &grp, &bytes) != 0)
+        return -1;
+
+    mbedtls_ecp_point_init(&P);
+    mbedtls_mpi_init(&e);
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    mbedtls_mpi_init(&t);
+
+    /* r = (k * G).x mod n, s = k^-1 * (e + d * r) mod n */
+    ret = sim_read_hex(&e, message);
+    if(ret == 0)
+        ret = mbedtls_ecp_mul(&grp, &P, k, &grp.G, sim_rng, NULL);
+    if(ret == 0)
+        ret = mbedtls_mpi_mod_mpi(&r, &P.X, &grp.N);
+    if(ret == 0)
+        ret = mbedtls_mpi_mul_mpi(&t, d, &r);
+    if(ret == 0)
+        ret = mbedtls_mpi_add_mpi(&t, &t, &e);
+    if(ret == 0)
+        ret = mbedtls_mpi_mod_mpi(&t, &t, &grp.N);
+    if(ret == 0)
+        ret = mbedtls_mpi_inv_mod(&s, k, &grp.N);
+    if(ret == 0)
+        ret = mbedtls_mpi_mul_mpi(&s, &s, &t);
+    if(ret == 0)
+        ret = mbedtls_mpi_mod_mpi(&s, &s, &grp.N);
+    if(ret == 0)
+    {
+        sim_write_hex(&r, bytes, R);
+        sim_write_hex(&s, bytes, S);
+        g_sCrptSimStat.ecc++;
+    }
+
+    mbedtls_mpi_free(&t);
+    mbedtls_mpi_free(&s);
+    mbedtls_mpi_free(&r);
+    mbedtls_mpi_free(&e);
+    mbedtls_ecp_point_free(&P);
+    mbedtls_ecp_group_free(&grp);
+    return (ret == 0) ? 0 : -1;
+}
+
+int32_t ECC_GenerateSignature(CRPT_T *crpt, E_ECC_CURVE ecc_curve, char *message,
+                              char *d, char *k, char *R, char *S)
+{
+    mbedtls_mpi md, mk;
+    int32_t ret = -1;
+
+    crpt->ECC_KSCTL = 0;
+    mbedtls_mpi_init(&md);
+    mbedtls_mpi_init(&mk);
+    if(sim_read_hex(&md, d) == 0 && sim_read_hex(&mk, k) == 0)
+        ret = sim_sign(crpt, ecc_curve, message, &md, &mk, R, S);
+    mbedtls_mpi_free(&md);
+    mbedtls_mpi_free(&mk);
+    return ret;
+}
+
+int32_t ECC_GenerateSignature_KS(CRPT_T *crpt, E_ECC_CURVE ecc_curve, char *message,
+                                 KS_MEM_Type mem_d, int32_t i32KeyIdx_d,
+                                 KS_MEM_Type mem_k, int32_t i32KeyIdx_k, char *R, char *S)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_mpi md, mk;
+    size_t bytes;
+    int32_t ret = -1;
+
+    crpt->ECC_KSCTL = CRPT_ECC_KSCTL_RSRCK_Msk | (uint32_t)i32KeyIdx_d;
+    if(mem_d != KS_SRAM || mem_k != KS_SRAM || sim_curve(ecc_curve, &grp, &bytes) != 0)
+        return -1;
+    mbedtls_ecp_group_free(&grp);
+
+    mbedtls_mpi_init(&md);
+    mbedtls_mpi_init(&mk);
+    if(sim_ks_ecc_key(i32KeyIdx_d, bytes, &md) == 0 && sim_ks_ecc_key(i32KeyIdx_k, bytes, &mk) == 0)
+    {
+        ret = sim_sign(crpt, ecc_curve, message, &md, &mk, R, S);
+        if(ret == 0)
+            g_sCrptSimStat.ecc_ks++;
+    }
+    mbedtls_mpi_free(&md);
+    mbedtls_mpi_free(&mk);
+    return ret;
+}
+
+int32_t ECC_VerifySignature(CRPT_T *crpt, E_ECC_CURVE ecc_curve, char *message,
+                            char *public_k1, char *public_k2, char *R, char *S)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_point Q, P;
+    mbedtls_mpi e, r, s, w, u1, u2;
+    size_t bytes;
+    int ret;
+    int32_t result = -2;
+
+    if(!sim_ecc_ready(crpt) || sim_curve(ecc_curve, &grp, &bytes) != 0)
+        return -1;
+
+    mbedtls_ecp_point_init(&Q);
+    mbedtls_ecp_point_init(&P);
+    mbedtls_mpi_init(&e);
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    mbedtls_mpi_init(&w);
+    mbedtls_mpi_init(&u1);
+    mbedtls_mpi_init(&u2);
+
+    ret = sim_read_hex(&e, message);
+    if(ret == 0)
+        ret = sim_read_hex(&r, R);
+    if(ret == 0)
+        ret = sim_read_hex(&s, S);
+    if(ret == 0)
+        ret = sim_read_hex(&Q.X, public_k1);
+    if(ret == 0)
+        ret = sim_read_hex(&Q.Y, public_k2);
+    if(ret == 0)
+        ret = mbedtls_mpi_lset(&Q.Z, 1);
+    if(ret == 0)
+        ret = mbedtls_ecp_check_pubkey(&grp, &Q);
+    if(ret == 0)
+        ret = mbedtls_mpi_inv_mod(&w, &s, &grp.N);
+    if(ret == 0)
+        ret = mbedtls_mpi_mul_mpi(&u1, &e, &w);
+    if(ret == 0)
+        ret = mbedtls_mpi_mod_mpi(&u1, &u1, &grp.N);
+    if(ret == 0)
+        ret = mbedtls_mpi_mul_mpi(&u2, &r, &w);
+    if(ret == 0)
+        ret = mbedtls_mpi_mod_mpi(&u2, &u2, &grp.N);
+    if(ret == 0)
+        ret = mbedtls_ecp_muladd(&grp, &P, &u1, &grp.G, &u2, &Q);
+    if(ret == 0)
+        ret = mbedtls_mpi_mod_mpi(&P.X, &P.X, &grp.N);
+    if(ret == 0 && mbedtls_mpi_cmp_mpi(&P.X, &r) == 0)
+        result = 0;
+    g_sCrptSimStat.ecc++;
+
+    mbedtls_mpi_free(&u2);
+    mbedtls_mpi_free(&u1);
+    mbedtls_mpi_free(&w);
+    mbedtls_mpi_free(&s);
+    mbedtls_mpi_free(&r);
+    mbedtls_mpi_free(&e);
+    mbedtls_ecp_point_free(&P);
+    mbedtls_ecp_point_free(&Q);
+    mbedtls_ecp_group_free(&grp);
+    return result;
+}
+
+/*
+ * RSA, normal mode: DADDR = SADDR0 ^ SADDR2 mod SADDR1
+ */
+
+int32_t RSA_Open(CRPT_T *crpt, uint32_t u32OpMode, uint32_t u32KeySize,
+                 void *psRSA_Buf, uint32_t u32BufSize, uint32_t u32UseKS)
+{
+    /* The CRT, SCAP and Key Store variants are not modelled */
+    if(psRSA_Buf == 0 || u32OpMode != RSA_MODE_NORMAL || u32UseKS ||
+            u32BufSize != sizeof(RSA_BUF_NORMAL_T) || u32KeySize > RSA_KEY_SIZE_4096)
+        return -1;
+
+    s_pvRsaBuf = psRSA_Buf;
+    crpt->RSA_CTL = u32OpMode | (u32KeySize << CRPT_RSA_CTL_KEYLEN_Pos);
+    return 0;
+}
+
+int32_t RSA_SetKey(CRPT_T *crpt, char *Key)
+{
+    if(s_pvRsaBuf == 0)
+        return -1;
+
+    CRPT_Hex2Reg(Key, ((RSA_BUF_NORMAL_T *)s_pvRsaBuf)->au32RsaE);
+    crpt->RSA_SADDR[2] = (uint32_t)(uintptr_t)((RSA_BUF_NORMAL_T *)s_pvRsaBuf)->au32RsaE;
+    return 0;
+}
+
+int32_t RSA_SetDMATransfer(CRPT_T *crpt, char *Src, char *n, char *P, char *Q)
+{
+    RSA_BUF_NORMAL_T *psBuf = (RSA_BUF_NORMAL_T *)s_pvRsaBuf;
+
+    (void)P;
+    (void)Q;
+
+    if(psBuf == 0)
+        return -1;
+
+    CRPT_Hex2Reg(Src, psBuf->au32RsaM);
+    CRPT_Hex2Reg(n, psBuf->au32RsaN);
+    crpt->RSA_SADDR[0] = (uint32_t)(uintptr_t)psBuf->au32RsaM;
+    crpt->RSA_SADDR[1] = (uint32_t)(uintptr_t)psBuf->au32RsaN;
+    crpt->RSA_DADDR = (uint32_t)(uintptr_t)psBuf->au32RsaOutput;
+    return 0;
+}
+
+/* Operand words are least significant first */
+static int sim_rsa_read(uint32_t addr, size_t words, mbedtls_mpi *x)
+{
+    const uint32_t *w = (const uint32_t *)(uintptr_t)addr;
+    uint8_t buf[RSA_MAX_KLEN / 8];
+    size_t i;
+
+    if(w == NULL || (addr & 3))
+        return -1;
+    for(i = 0; i < words; i++)
+        sim_be32(&w[words - 1 - i], 1, buf + 4 * i);
+    return mbedtls_mpi_read_binary(x, buf, 4 * words);
+}
+
+static int sim_rsa(CRPT_T *crpt)
+{
+    size_t words = (((crpt->RSA_CTL & CRPT_RSA_CTL_KEYLEN_Msk) >> CRPT_RSA_CTL_KEYLEN_Pos) + 1) * 32;
+    uint32_t *out = (uint32_t *)(uintptr_t)crpt->RSA_DADDR;
+    uint8_t buf[RSA_MAX_KLEN / 8];
+    mbedtls_mpi M, N, E, X;
+    size_t i;
+    int ret = -1;
+
+    mbedtls_mpi_init(&M);
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&E);
+    mbedtls_mpi_init(&X);
+
+    if((crpt->RSA_CTL & ~(CRPT_RSA_CTL_KEYLEN_Msk | CRPT_RSA_CTL_START_Msk)) == RSA_MODE_NORMAL &&
+            out != NULL && ((uintptr_t)out & 3) == 0 &&
+            sim_rsa_read(crpt->RSA_SADDR[0], words, &M) == 0 &&
+            sim_rsa_read(crpt->RSA_SADDR[1], words, &N) == 0 &&
+            sim_rsa_read(crpt->RSA_SADDR[2], words, &E) == 0 &&
+            mbedtls_mpi_get_bit(&N, 0) == 1 && mbedtls_mpi_cmp_mpi(&M, &N) < 0 &&
+            mbedtls_mpi_exp_mod(&X, &M, &E, &N, NULL) == 0 &&
+            mbedtls_mpi_write_binary(&X, buf, 4 * words) == 0)
+    {
+        for(i = 0; i < words; i++)
+            out[i] = ((uint32_t)buf[4 * (words - 1 - i)] << 24) |
+                     ((uint32_t)buf[4 * (words - 1 - i) + 1] << 16) |
+                     ((uint32_t)buf[4 * (words - 1 - i) + 2] << 8) |
+                     buf[4 * (words - 1 - i) + 3];
+        ret = 0;
+    }
+
+    mbedtls_mpi_free(&X);
+    mbedtls_mpi_free(&E);
+    mbedtls_mpi_free(&N);
+    mbedtls_mpi_free(&M);
+    return ret;
+}
+
+void RSA_Start(CRPT_T *crpt)
+{
+    crpt->RSA_CTL |= CRPT_RSA_CTL_START_Msk;
+    crpt->INTSTS &= ~(CRPT_INTSTS_RSAIF_Msk | CRPT_INTSTS_RSAEIF_Msk);
+
+    if(sim_rsa(crpt) != 0)
+    {
+        crpt->INTSTS |= CRPT_INTSTS_RSAEIF_Msk;
+        g_sCrptSimStat.errors++;
+    }
+    else
+    {
+        crpt->INTSTS |= CRPT_INTSTS_RSAIF_Msk;
+        g_sCrptSimStat.rsa++;
+    }
+    crpt->RSA_CTL &= ~CRPT_RSA_CTL_START_Msk;
+}
+
+int32_t RSA_Read(CRPT_T *crpt, char *Output)
+{
+    static const char s_acHex[] = "0123456789abcdef";
+    const uint32_t *w;
+    int32_t count, idx;
+
+    if(s_pvRsaBuf == 0)
+        return -1;
+
+    /* Key length / 4 digits, most significant first */
+    w = ((RSA_BUF_NORMAL_T *)s_pvRsaBuf)->au32RsaOutput;
+    count = (int32_t)((((crpt->RSA_CTL & CRPT_RSA_CTL_KEYLEN_Msk) >> CRPT_RSA_CTL_KEYLEN_Pos) + 1) * 256);
+    Output[count] = '\0';
+    for(idx = 0; idx < count; idx++)
+        Output[count - 1 - idx] = s_acHex[(w[idx / 8] >> ((idx % 8) * 4)) & 0xF];
+    return 0;
+}
+
+void crpt_sim_reset_stat(void)
+{
+    g_sCrptSimStat.aes = 0;
+    g_sCrptSimStat.aes_ks = 0;
+    g_sCrptSimStat.aead = 0;
+    g_sCrptSimStat.sha = 0;
+    g_sCrptSimStat.ecc = 0;
+    g_sCrptSimStat.ecc_ks = 0;
+    g_sCrptSimStat.prng_ks = 0;
+    g_sCrptSimStat.rsa = 0;
+    g_sCrptSimStat.errors = 0;
+}
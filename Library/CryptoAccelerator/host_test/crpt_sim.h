@@ -0,0 +1,34 @@
+/*
+ * Counters of the simulated CRPT engine, see crpt_sim.c.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef CRPT_SIM_H
+#define CRPT_SIM_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t aes;       /* AES runs completed */
+    uint32_t aes_ks;    /* ... of which keyed from Key Store */
+    uint32_t aead;      /* AES-GCM/CCM runs completed */
+    uint32_t sha;       /* SHA DMA blocks completed */
+    uint32_t ecc;       /* ECC operations completed */
+    uint32_t ecc_ks;    /* ... of which keyed from Key Store */
+    uint32_t prng_ks;   /* random keys written to Key Store */
+    uint32_t rsa;       /* RSA exponentiations completed */
+    uint32_t errors;    /* AESEIF/HMACEIF/RSAEIF raised */
+    int ks_opened;
+    int sha_open;       /* cascaded SHA message in progress */
+} crpt_sim_stat_t;
+
+extern crpt_sim_stat_t g_sCrptSimStat;
+
+/* Clear the operation counters */
+void crpt_sim_reset_stat(void);
+
+/* Keys currently held in Key Store SRAM */
+int crpt_sim_ks_keys(void);
+
+#endif /* CRPT_SIM_H */
@@ -0,0 +1,21 @@
+/*
+ * mbed TLS configuration of the host test build: the stock configuration
+ * plus the CRPT PSA drivers. build_info.h includes "mbedtls_config.h" from
+ * the include path, so this file shadows ../mbedtls_config.h and its *_ALT
+ * replacements.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef NU_CRPT_HOST_MBEDTLS_CONFIG_H
+#define NU_CRPT_HOST_MBEDTLS_CONFIG_H
+
+#include "mbedtls/xxxxmbedtls_config.h"
+
+/* The bundled platform.c defines mbedtls_exit as a pointer even without
+ * MBEDTLS_PLATFORM_EXIT_ALT; the host build uses the libc functions. */
+#undef MBEDTLS_PLATFORM_C
+
+#define MBEDTLS_PSA_CRYPTO_DRIVERS
+#define PSA_CRYPTO_DRIVER_NU_CRPT
+
+#endif /* NU_CRPT_HOST_MBEDTLS_CONFIG_H */
@@ -1183,6 +1183,17 @@
  */
 //#define MBEDTLS_PSA_CRYPTO_DRIVERS
 
+/** \def PSA_CRYPTO_DRIVER_NU_CRPT
+ *
+ * Route psa_* calls to the CRPT engine through the accelerator drivers in
+ * psa_crypto_driver_crpt.c, and enable opaque keys in Key Store SRAM
+ * (PSA_CRYPTO_NU_CRPT_KS_LIFETIME). Operations the drivers do not cover
+ * fall back to the built-in code and the *_ALT replacements above.
+ *
+ * Requires: MBEDTLS_PSA_CRYPTO_DRIVERS
+ */
+//#define PSA_CRYPTO_DRIVER_NU_CRPT
+
 /** \def MBEDTLS_PSA_CRYPTO_EXTERNAL_RNG
  *
  * Make the PSA Crypto module use an external random generator provided
@@ -0,0 +1,2117 @@
+/*
+ *  PSA Crypto accelerator drivers for the M460 CRPT engine
+ *
+ *  Copyright (c) 2023, Nuvoton Technology Corporation
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "common.h"
+
+#if defined(MBEDTLS_PSA_CRYPTO_C) && defined(MBEDTLS_PSA_CRYPTO_DRIVERS) && \
+    defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+
+#include <string.h>
+#include "psa/crypto.h"
+#include "mbedtls/platform_util.h"
+#include "psa_crypto_driver_crpt.h"
+#include "NuMicro.h"
+
+#if defined(MBEDTLS_PSA_BUILTIN_ALG_RSA_PKCS1V15_SIGN) && defined(MBEDTLS_PSA_BUILTIN_ALG_RSA_PSS)
+#define NU_CRPT_RSA
+#include "mbedtls/oid.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/rsa.h"
+#include "psa_crypto_hash.h"
+#include "psa_crypto_rsa.h"
+#endif
+
+#define NU_CRPT_KS_MAGIC        0x5053414BUL    /* "PSAK" */
+#define NU_CRPT_TIMEOUT         0x10000000
+
+/* DMA compatible bounce buffer if user buffer doesn't meet requirements
+ *
+ * AES/SHA DMA buffer location requires to be:
+ * (1) Word-aligned
+ * (2) Located in 0x2xxxxxxx region. Check linker files to ensure global variables are placed in this region.
+ *
+ * NU_CRPT_DMA_BUF_SIZE must be a multiple of the SHA-512 block size (128 bytes).
+ * Its value is estimated to trade memory footprint off against performance.
+ */
+#ifndef NU_CRPT_DMA_BUF_SIZE
+#define NU_CRPT_DMA_BUF_SIZE    256
+#endif
+
+#ifndef NU_CRPT_DMA_ADDR_OK
+#define NU_CRPT_DMA_ADDR_OK(p)  ((((uint32_t)(uintptr_t)(p)) & 0xF0000003UL) == 0x20000000UL)
+#endif
+
+#define NU_CRPT_ECC_MAX_BYTES   48
+#define NU_CRPT_ECC_MAX_CHARS   (NU_CRPT_ECC_MAX_BYTES * 2)
+
+/* The output buffer also takes the AEAD tag the engine writes after the text */
+__ALIGNED(4) static uint8_t s_au8DmaIn[NU_CRPT_DMA_BUF_SIZE];
+__ALIGNED(4) static uint8_t s_au8DmaOut[NU_CRPT_DMA_BUF_SIZE + 16];
+
+typedef struct
+{
+    E_ECC_CURVE eCurve;
+    size_t      bytes;
+    uint32_t    u32PrngKeySize;     /* PRNG_KEY_SIZE_xxx */
+    uint32_t    u32KsMeta;          /* KS_META_xxx */
+    const char *pcOrder;            /* Curve order n */
+} nu_crpt_curve_t;
+
+static const nu_crpt_curve_t s_asCurves[] =
+{
+    {
+        CURVE_P_256, 32, PRNG_KEY_SIZE_256, KS_META_256,
+        "ffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632551"
+    },
+    {
+        CURVE_P_384, 48, PRNG_KEY_SIZE_384, KS_META_384,
+        "ffffffffffffffffffffffffffffffffffffffffffffffffc7634d81f4372ddf"
+        "581a0db248b0a77aecec196accc52973"
+    },
+};
+
+/*
+ * Helpers
+ */
+
+static const nu_crpt_curve_t *nu_crpt_get_curve(psa_key_type_t type, size_t bits)
+{
+    size_t i;
+
+    if(!PSA_KEY_TYPE_IS_ECC(type) ||
+            PSA_KEY_TYPE_ECC_GET_FAMILY(type) != PSA_ECC_FAMILY_SECP_R1)
+        return NULL;
+
+    for(i = 0; i < sizeof(s_asCurves) / sizeof(s_asCurves[0]); i++)
+    {
+        if(s_asCurves[i].bytes * 8 == bits)
+            return &s_asCurves[i];
+    }
+
+    return NULL;
+}
+
+static void nu_crpt_bin2hex(const uint8_t *pu8Bin, size_t len, char *pcHex)
+{
+    static const char s_acHex[] = "0123456789abcdef";
+    size_t i;
+
+    for(i = 0; i < len; i++)
+    {
+        *pcHex++ = s_acHex[pu8Bin[i] >> 4];
+        *pcHex++ = s_acHex[pu8Bin[i] & 0xF];
+    }
+    *pcHex = '\0';
+}
+
+static int nu_crpt_hexval(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* pcHex holds exactly 2 * len digits, as written by the ECC_* functions */
+static int nu_crpt_hex2bin(const char *pcHex, uint8_t *pu8Bin, size_t len)
+{
+    size_t i;
+    int hi, lo;
+
+    for(i = 0; i < len; i++)
+    {
+        hi = nu_crpt_hexval(pcHex[2 * i]);
+        lo = nu_crpt_hexval(pcHex[2 * i + 1]);
+        if(hi < 0 || lo < 0)
+            return -1;
+        pu8Bin[i] = (uint8_t)((hi << 4) | lo);
+    }
+
+    return 0;
+}
+
+static int nu_crpt_is_zero(const uint8_t *pu8, size_t len)
+{
+    uint8_t acc = 0;
+
+    while(len--)
+        acc |= *pu8++;
+
+    return acc == 0;
+}
+
+/* Big-endian compare, both operands len bytes */
+static int nu_crpt_cmp(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    return memcmp(a, b, len);
+}
+
+/* a -= b, big-endian, len bytes */
+static void nu_crpt_sub(uint8_t *a, const uint8_t *b, size_t len)
+{
+    int32_t i, borrow = 0, d;
+
+    for(i = (int32_t)len - 1; i >= 0; i--)
+    {
+        d = (int32_t)a[i] - b[i] - borrow;
+        borrow = (d < 0);
+        a[i] = (uint8_t)d;
+    }
+}
+
+static void nu_crpt_curve_order(const nu_crpt_curve_t *curve, uint8_t *pu8N)
+{
+    nu_crpt_hex2bin(curve->pcOrder, pu8N, curve->bytes);
+}
+
+/* 1 <= v <= n - 1 */
+static int nu_crpt_in_range(const nu_crpt_curve_t *curve, const uint8_t *v)
+{
+    uint8_t au8N[NU_CRPT_ECC_MAX_BYTES];
+
+    nu_crpt_curve_order(curve, au8N);
+    return !nu_crpt_is_zero(v, curve->bytes) && nu_crpt_cmp(v, au8N, curve->bytes) < 0;
+}
+
+/* e = leftmost bits of the hash, reduced modulo n (SEC1 4.1.3 step 5) */
+static void nu_crpt_hash_to_hex(const nu_crpt_curve_t *curve,
+                                const uint8_t *hash, size_t hash_length, char *pcHex)
+{
+    uint8_t au8E[NU_CRPT_ECC_MAX_BYTES];
+    uint8_t au8N[NU_CRPT_ECC_MAX_BYTES];
+    size_t len = (hash_length < curve->bytes) ? hash_length : curve->bytes;
+
+    memset(au8E, 0, curve->bytes);
+    memcpy(au8E + curve->bytes - len, hash, len);
+
+    nu_crpt_curve_order(curve, au8N);
+    if(nu_crpt_cmp(au8E, au8N, curve->bytes) >= 0)
+        nu_crpt_sub(au8E, au8N, curve->bytes);
+
+    nu_crpt_bin2hex(au8E, curve->bytes, pcHex);
+}
+
+/* Uncompressed point 04 || X || Y from the ECC_* hex output */
+static psa_status_t nu_crpt_write_point(const nu_crpt_curve_t *curve,
+                                        const char *pcX, const char *pcY,
+                                        uint8_t *data, size_t data_size, size_t *data_length)
+{
+    if(data_size < 1 + 2 * curve->bytes)
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    data[0] = 0x04;
+    if(nu_crpt_hex2bin(pcX, data + 1, curve->bytes) != 0 ||
+            nu_crpt_hex2bin(pcY, data + 1 + curve->bytes, curve->bytes) != 0)
+        return PSA_ERROR_HARDWARE_FAILURE;
+
+    *data_length = 1 + 2 * curve->bytes;
+    return PSA_SUCCESS;
+}
+
+/* Words of an AES key or IV as AES_SetKey()/AES_SetInitVect() take them */
+static void nu_crpt_get_be32(const uint8_t *pu8, uint32_t *pu32, size_t words)
+{
+    size_t i;
+
+    for(i = 0; i < words; i++, pu8 += 4)
+    {
+        pu32[i] = ((uint32_t)pu8[0] << 24) | ((uint32_t)pu8[1] << 16) |
+                  ((uint32_t)pu8[2] << 8) | (uint32_t)pu8[3];
+    }
+}
+
+static psa_status_t nu_crpt_ks_key(const uint8_t *key_buffer, size_t key_buffer_size,
+                                   const nu_crpt_ks_key_t **ppsKey)
+{
+    const nu_crpt_ks_key_t *psKey = (const nu_crpt_ks_key_t *)key_buffer;
+
+    if(key_buffer_size < sizeof(nu_crpt_ks_key_t) || psKey->u32Magic != NU_CRPT_KS_MAGIC)
+        return PSA_ERROR_CORRUPTION_DETECTED;
+
+    *ppsKey = psKey;
+    return PSA_SUCCESS;
+}
+
+/*
+ * SHA
+ */
+
+static psa_status_t nu_crpt_sha_wait(void)
+{
+    int32_t timeout = NU_CRPT_TIMEOUT;
+
+    while(((CRPT->INTSTS & CRPT_INTSTS_HMACIF_Msk) == 0) ||
+            (CRPT->HMAC_STS & CRPT_HMAC_STS_BUSY_Msk))
+    {
+        if(timeout-- <= 0)
+            return PSA_ERROR_HARDWARE_FAILURE;
+    }
+
+    if(CRPT->INTSTS & CRPT_INTSTS_HMACEIF_Msk)
+    {
+        SHA_CLR_INT_FLAG(CRPT);
+        return PSA_ERROR_HARDWARE_FAILURE;
+    }
+
+    SHA_CLR_INT_FLAG(CRPT);
+    return PSA_SUCCESS;
+}
+
+psa_status_t nu_crpt_transparent_hash_compute(
+    psa_algorithm_t alg,
+    const uint8_t *input, size_t input_length,
+    uint8_t *hash, size_t hash_size, size_t *hash_length)
+{
+    uint32_t au32Digest[16];
+    uint32_t u32OpMode;
+    size_t len, chunk;
+    psa_status_t status;
+
+    switch(alg)
+    {
+    case PSA_ALG_SHA_224:
+        u32OpMode = SHA_MODE_SHA224;
+        break;
+    case PSA_ALG_SHA_256:
+        u32OpMode = SHA_MODE_SHA256;
+        break;
+    case PSA_ALG_SHA_384:
+        u32OpMode = SHA_MODE_SHA384;
+        break;
+    case PSA_ALG_SHA_512:
+        u32OpMode = SHA_MODE_SHA512;
+        break;
+    default:
+        return PSA_ERROR_NOT_SUPPORTED;
+    }
+
+    /* The engine cannot DMA an empty message */
+    if(input_length == 0)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    len = PSA_HASH_LENGTH(alg);
+    if(hash_size < len)
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    SHA_Open(CRPT, u32OpMode, SHA_IN_OUT_SWAP, 0);
+    SHA_CLR_INT_FLAG(CRPT);
+
+    if(NU_CRPT_DMA_ADDR_OK(input))
+    {
+        SHA_SetDMATransfer(CRPT, (uint32_t)(uintptr_t)input, input_length);
+        SHA_Start(CRPT, CRYPTO_DMA_ONE_SHOT);
+        status = nu_crpt_sha_wait();
+    }
+    else if(input_length <= NU_CRPT_DMA_BUF_SIZE)
+    {
+        memcpy(s_au8DmaIn, input, input_length);
+        SHA_SetDMATransfer(CRPT, (uint32_t)(uintptr_t)s_au8DmaIn, input_length);
+        SHA_Start(CRPT, CRYPTO_DMA_ONE_SHOT);
+        status = nu_crpt_sha_wait();
+    }
+    else
+    {
+        /* DMA cascade through the bounce buffer, as sha256_alt.c does */
+        CRPT->HMAC_CTL |= CRPT_HMAC_CTL_DMAFIRST_Msk;
+        status = PSA_SUCCESS;
+        while(input_length > 0 && status == PSA_SUCCESS)
+        {
+            chunk = (input_length > NU_CRPT_DMA_BUF_SIZE) ? NU_CRPT_DMA_BUF_SIZE : input_length;
+            memcpy(s_au8DmaIn, input, chunk);
+            SHA_SetDMATransfer(CRPT, (uint32_t)(uintptr_t)s_au8DmaIn, chunk);
+            SHA_Start(CRPT, (chunk == input_length) ? CRYPTO_DMA_LAST : CRYPTO_DMA_CONTINUE);
+            status = nu_crpt_sha_wait();
+            CRPT->HMAC_CTL &= ~CRPT_HMAC_CTL_DMAFIRST_Msk;
+            input += chunk;
+            input_length -= chunk;
+        }
+    }
+
+    if(status == PSA_SUCCESS)
+    {
+        SHA_Read(CRPT, au32Digest);
+        memcpy(hash, au32Digest, len);
+        *hash_length = len;
+    }
+
+    mbedtls_platform_zeroize(s_au8DmaIn, sizeof(s_au8DmaIn));
+    return status;
+}
+
+/*
+ * AES
+ */
+
+static psa_status_t nu_crpt_aes_wait(void)
+{
+    int32_t timeout = NU_CRPT_TIMEOUT;
+
+    while((CRPT->INTSTS & (CRPT_INTSTS_AESIF_Msk | CRPT_INTSTS_AESEIF_Msk)) == 0)
+    {
+        if(timeout-- <= 0)
+            return PSA_ERROR_HARDWARE_FAILURE;
+    }
+
+    if(CRPT->INTSTS & CRPT_INTSTS_AESEIF_Msk)
+    {
+        AES_CLR_INT_FLAG(CRPT);
+        return PSA_ERROR_HARDWARE_FAILURE;
+    }
+
+    AES_CLR_INT_FLAG(CRPT);
+    return PSA_SUCCESS;
+}
+
+static psa_status_t nu_crpt_aes_key_size(size_t key_bytes, uint32_t *pu32KeySz)
+{
+    switch(key_bytes)
+    {
+    case 16:
+        *pu32KeySz = AES_KEY_SIZE_128;
+        break;
+    case 24:
+        *pu32KeySz = AES_KEY_SIZE_192;
+        break;
+    case 32:
+        *pu32KeySz = AES_KEY_SIZE_256;
+        break;
+    default:
+        return PSA_ERROR_NOT_SUPPORTED;
+    }
+
+    return PSA_SUCCESS;
+}
+
+/* 128-bit big-endian counter += blocks */
+static void nu_crpt_ctr_add(uint8_t *pu8Ctr, size_t blocks)
+{
+    int32_t i;
+    uint32_t sum;
+
+    for(i = 15; i >= 0 && blocks != 0; i--)
+    {
+        sum = (uint32_t)pu8Ctr[i] + (uint32_t)(blocks & 0xFF);
+        pu8Ctr[i] = (uint8_t)sum;
+        blocks = (blocks >> 8) + (sum >> 8);
+    }
+}
+
+/* One DMA run of whole blocks. The chaining value is carried in software
+ * so each run is a one-shot operation and the operation object stays
+ * independent of the engine. */
+static psa_status_t nu_crpt_aes_run_chunk(nu_crpt_cipher_operation_t *op,
+        const uint8_t *src, uint8_t *dst, size_t len)
+{
+    uint32_t au32IV[4];
+    uint8_t au8NextIV[16];
+    uint32_t u32OpMode;
+    psa_status_t status;
+
+    switch(op->alg)
+    {
+    case PSA_ALG_CBC_NO_PADDING:
+        u32OpMode = AES_MODE_CBC;
+        if(!op->encrypt)
+            memcpy(au8NextIV, src + len - 16, 16);
+        break;
+    case PSA_ALG_CTR:
+        u32OpMode = AES_MODE_CTR;
+        break;
+    default:
+        u32OpMode = AES_MODE_ECB;
+        break;
+    }
+
+    AES_Open(CRPT, 0, op->encrypt, u32OpMode, op->keysz, AES_IN_OUT_SWAP);
+    if(op->ks_idx >= 0)
+    {
+        AES_SetKey_KS(CRPT, KS_SRAM, op->ks_idx);
+    }
+    else
+    {
+        CRPT->AES_KSCTL = 0;
+        AES_SetKey(CRPT, 0, op->key, op->keysz);
+    }
+    nu_crpt_get_be32(op->iv, au32IV, 4);
+    AES_SetInitVect(CRPT, 0, au32IV);
+    AES_SetDMATransfer(CRPT, 0, (uint32_t)(uintptr_t)src, (uint32_t)(uintptr_t)dst, len);
+
+    AES_CLR_INT_FLAG(CRPT);
+    AES_Start(CRPT, 0, CRYPTO_DMA_ONE_SHOT);
+    status = nu_crpt_aes_wait();
+
+    /* Leave the key registers to aes_alt.c */
+    CRPT->AES_KSCTL = 0;
+    mbedtls_platform_zeroize(au32IV, sizeof(au32IV));
+
+    if(status != PSA_SUCCESS)
+        return status;
+
+    if(op->alg == PSA_ALG_CBC_NO_PADDING)
+        memcpy(op->iv, op->encrypt ? dst + len - 16 : au8NextIV, 16);
+    else if(op->alg == PSA_ALG_CTR)
+        nu_crpt_ctr_add(op->iv, len / 16);
+
+    return PSA_SUCCESS;
+}
+
+/* len is a multiple of 16 */
+static psa_status_t nu_crpt_aes_run(nu_crpt_cipher_operation_t *op,
+                                    const uint8_t *input, uint8_t *output, size_t len)
+{
+    psa_status_t status = PSA_SUCCESS;
+    size_t chunk;
+
+    if(len == 0)
+        return PSA_SUCCESS;
+
+    if(NU_CRPT_DMA_ADDR_OK(input) && NU_CRPT_DMA_ADDR_OK(output))
+        return nu_crpt_aes_run_chunk(op, input, output, len);
+
+    while(len > 0 && status == PSA_SUCCESS)
+    {
+        chunk = (len > NU_CRPT_DMA_BUF_SIZE) ? NU_CRPT_DMA_BUF_SIZE : len;
+        memcpy(s_au8DmaIn, input, chunk);
+        status = nu_crpt_aes_run_chunk(op, s_au8DmaIn, s_au8DmaOut, chunk);
+        if(status == PSA_SUCCESS)
+            memcpy(output, s_au8DmaOut, chunk);
+        input += chunk;
+        output += chunk;
+        len -= chunk;
+    }
+
+    mbedtls_platform_zeroize(s_au8DmaIn, sizeof(s_au8DmaIn));
+    mbedtls_platform_zeroize(s_au8DmaOut, sizeof(s_au8DmaOut));
+    return status;
+}
+
+static psa_status_t nu_crpt_cipher_setup(nu_crpt_cipher_operation_t *op,
+        const psa_key_attributes_t *attributes,
+        psa_algorithm_t alg, int encrypt)
+{
+    if(psa_get_key_type(attributes) != PSA_KEY_TYPE_AES)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    if(alg != PSA_ALG_ECB_NO_PADDING && alg != PSA_ALG_CBC_NO_PADDING && alg != PSA_ALG_CTR)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    memset(op, 0, sizeof(*op));
+    op->alg = alg;
+    op->ks_idx = -1;
+    /* CTR decryption is CTR encryption */
+    op->encrypt = (encrypt || alg == PSA_ALG_CTR) ? 1 : 0;
+    op->iv_required = (alg != PSA_ALG_ECB_NO_PADDING) ? 1 : 0;
+
+    return PSA_SUCCESS;
+}
+
+static psa_status_t nu_crpt_transparent_cipher_setup(nu_crpt_cipher_operation_t *op,
+        const psa_key_attributes_t *attributes,
+        const uint8_t *key_buffer, size_t key_buffer_size,
+        psa_algorithm_t alg, int encrypt)
+{
+    psa_status_t status;
+
+    status = nu_crpt_cipher_setup(op, attributes, alg, encrypt);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    status = nu_crpt_aes_key_size(key_buffer_size, &op->keysz);
+    if(status != PSA_SUCCESS)
+        return status;
+    nu_crpt_get_be32(key_buffer, op->key, key_buffer_size / 4);
+
+    return PSA_SUCCESS;
+}
+
+static psa_status_t nu_crpt_opaque_cipher_setup(nu_crpt_cipher_operation_t *op,
+        const psa_key_attributes_t *attributes,
+        const uint8_t *key_buffer, size_t key_buffer_size,
+        psa_algorithm_t alg, int encrypt)
+{
+    const nu_crpt_ks_key_t *psKey;
+    psa_status_t status;
+
+    status = nu_crpt_cipher_setup(op, attributes, alg, encrypt);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    status = nu_crpt_ks_key(key_buffer, key_buffer_size, &psKey);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    switch(psKey->u32Meta & KS_METADATA_SIZE_Msk)
+    {
+    case KS_META_128:
+        op->keysz = AES_KEY_SIZE_128;
+        break;
+    case KS_META_192:
+        op->keysz = AES_KEY_SIZE_192;
+        break;
+    case KS_META_256:
+        op->keysz = AES_KEY_SIZE_256;
+        break;
+    default:
+        return PSA_ERROR_CORRUPTION_DETECTED;
+    }
+    op->ks_idx = psKey->i32KeyIdx;
+
+    return PSA_SUCCESS;
+}
+
+psa_status_t nu_crpt_cipher_set_iv(
+    nu_crpt_cipher_operation_t *operation,
+    const uint8_t *iv, size_t iv_length)
+{
+    if(iv_length != 16)
+        return PSA_ERROR_INVALID_ARGUMENT;
+
+    memcpy(operation->iv, iv, 16);
+    operation->iv_set = 1;
+
+    return PSA_SUCCESS;
+}
+
+psa_status_t nu_crpt_cipher_update(
+    nu_crpt_cipher_operation_t *operation,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length)
+{
+    nu_crpt_cipher_operation_t *op = operation;
+    psa_status_t status;
+    size_t expected, len, n;
+
+    if(op->alg == PSA_ALG_CTR)
+    {
+        if(output_size < input_length)
+            return PSA_ERROR_BUFFER_TOO_SMALL;
+
+        /* Rest of the key stream block of the previous call */
+        for(n = 0; n < input_length && op->buf_len != 0; n++)
+        {
+            output[n] = input[n] ^ op->buf[op->buf_len];
+            op->buf_len = (op->buf_len + 1) & 15;
+        }
+
+        len = (input_length - n) & ~(size_t)15;
+        status = nu_crpt_aes_run(op, input + n, output + n, len);
+        if(status != PSA_SUCCESS)
+            return status;
+        n += len;
+
+        if(n < input_length)
+        {
+            /* Encrypt a zero block to get the key stream for the tail */
+            memset(op->buf, 0, 16);
+            status = nu_crpt_aes_run(op, op->buf, op->buf, 16);
+            if(status != PSA_SUCCESS)
+                return status;
+            for(len = 0; n < input_length; n++, len++)
+                output[n] = input[n] ^ op->buf[len];
+            op->buf_len = (uint8_t)len;
+        }
+
+        *output_length = input_length;
+        return PSA_SUCCESS;
+    }
+
+    expected = (op->buf_len + input_length) / 16 * 16;
+    if(output_size < expected)
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    *output_length = 0;
+
+    if(op->buf_len != 0)
+    {
+        n = 16 - op->buf_len;
+        if(n > input_length)
+            n = input_length;
+        memcpy(op->buf + op->buf_len, input, n);
+        op->buf_len += (uint8_t)n;
+        input += n;
+        input_length -= n;
+
+        if(op->buf_len < 16)
+            return PSA_SUCCESS;
+
+        status = nu_crpt_aes_run(op, op->buf, output, 16);
+        if(status != PSA_SUCCESS)
+            return status;
+        op->buf_len = 0;
+        output += 16;
+        *output_length = 16;
+    }
+
+    len = input_length & ~(size_t)15;
+    status = nu_crpt_aes_run(op, input, output, len);
+    if(status != PSA_SUCCESS)
+        return status;
+    *output_length += len;
+
+    memcpy(op->buf, input + len, input_length - len);
+    op->buf_len = (uint8_t)(input_length - len);
+
+    return PSA_SUCCESS;
+}
+
+psa_status_t nu_crpt_cipher_finish(
+    nu_crpt_cipher_operation_t *operation,
+    uint8_t *output, size_t output_size, size_t *output_length)
+{
+    (void)output;
+    (void)output_size;
+
+    /* No padding: a partial block left over is an error, except in CTR */
+    if(operation->alg != PSA_ALG_CTR && operation->buf_len != 0)
+        return PSA_ERROR_INVALID_ARGUMENT;
+
+    *output_length = 0;
+    return PSA_SUCCESS;
+}
+
+psa_status_t nu_crpt_cipher_abort(nu_crpt_cipher_operation_t *operation)
+{
+    mbedtls_platform_zeroize(operation, sizeof(*operation));
+    return PSA_SUCCESS;
+}
+
+static psa_status_t nu_crpt_cipher_oneshot(nu_crpt_cipher_operation_t *op,
+        const uint8_t *iv, size_t iv_length,
+        const uint8_t *input, size_t input_length,
+        uint8_t *output, size_t output_size, size_t *output_length)
+{
+    psa_status_t status = PSA_SUCCESS;
+    size_t update_length, finish_length;
+
+    if(iv_length > 0)
+        status = nu_crpt_cipher_set_iv(op, iv, iv_length);
+
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_cipher_update(op, input, input_length,
+                                       output, output_size, &update_length);
+
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_cipher_finish(op, output + update_length,
+                                       output_size - update_length, &finish_length);
+
+    if(status == PSA_SUCCESS)
+        *output_length = update_length + finish_length;
+
+    nu_crpt_cipher_abort(op);
+    return status;
+}
+
+static psa_status_t nu_crpt_cipher_decrypt_oneshot(nu_crpt_cipher_operation_t *op,
+        const uint8_t *input, size_t input_length,
+        uint8_t *output, size_t output_size, size_t *output_length)
+{
+    size_t iv_length = op->iv_required ? 16 : 0;
+
+    /* The core has already checked input_length against the IV length */
+    return nu_crpt_cipher_oneshot(op, input, iv_length,
+                                  input + iv_length, input_length - iv_length,
+                                  output, output_size, output_length);
+}
+
+psa_status_t nu_crpt_transparent_cipher_encrypt_setup(
+    nu_crpt_cipher_operation_t *operation,
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg)
+{
+    return nu_crpt_transparent_cipher_setup(operation, attributes,
+                                            key_buffer, key_buffer_size, alg, 1);
+}
+
+psa_status_t nu_crpt_transparent_cipher_decrypt_setup(
+    nu_crpt_cipher_operation_t *operation,
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg)
+{
+    return nu_crpt_transparent_cipher_setup(operation, attributes,
+                                            key_buffer, key_buffer_size, alg, 0);
+}
+
+psa_status_t nu_crpt_transparent_cipher_encrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *iv, size_t iv_length,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length)
+{
+    nu_crpt_cipher_operation_t op;
+    psa_status_t status;
+
+    status = nu_crpt_transparent_cipher_setup(&op, attributes,
+             key_buffer, key_buffer_size, alg, 1);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    return nu_crpt_cipher_oneshot(&op, iv, iv_length, input, input_length,
+                                  output, output_size, output_length);
+}
+
+psa_status_t nu_crpt_transparent_cipher_decrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length)
+{
+    nu_crpt_cipher_operation_t op;
+    psa_status_t status;
+
+    status = nu_crpt_transparent_cipher_setup(&op, attributes,
+             key_buffer, key_buffer_size, alg, 0);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    return nu_crpt_cipher_decrypt_oneshot(&op, input, input_length,
+                                          output, output_size, output_length);
+}
+
+psa_status_t nu_crpt_opaque_cipher_encrypt_setup(
+    nu_crpt_cipher_operation_t *operation,
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg)
+{
+    return nu_crpt_opaque_cipher_setup(operation, attributes,
+                                       key_buffer, key_buffer_size, alg, 1);
+}
+
+psa_status_t nu_crpt_opaque_cipher_decrypt_setup(
+    nu_crpt_cipher_operation_t *operation,
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg)
+{
+    return nu_crpt_opaque_cipher_setup(operation, attributes,
+                                       key_buffer, key_buffer_size, alg, 0);
+}
+
+psa_status_t nu_crpt_opaque_cipher_encrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *iv, size_t iv_length,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length)
+{
+    nu_crpt_cipher_operation_t op;
+    psa_status_t status;
+
+    status = nu_crpt_opaque_cipher_setup(&op, attributes,
+                                         key_buffer, key_buffer_size, alg, 1);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    return nu_crpt_cipher_oneshot(&op, iv, iv_length, input, input_length,
+                                  output, output_size, output_length);
+}
+
+psa_status_t nu_crpt_opaque_cipher_decrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length)
+{
+    nu_crpt_cipher_operation_t op;
+    psa_status_t status;
+
+    status = nu_crpt_opaque_cipher_setup(&op, attributes,
+                                         key_buffer, key_buffer_size, alg, 0);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    return nu_crpt_cipher_decrypt_oneshot(&op, input, input_length,
+                                          output, output_size, output_length);
+}
+
+/*
+ * AEAD: AES-GCM and AES-CCM
+ *
+ * The engine takes the whole message as one DMA stream, laid out as in
+ * gcm_alt.c and ccm_alt.c, and writes the text followed by the tag.
+ */
+
+#define NU_CRPT_ALIGN16(len)    (((len) + 15) & ~(size_t)15)
+
+/* Engine state between the runs of a GCM DMA cascade, as gcm_alt.c fb_buf */
+#define NU_CRPT_AES_FB_SIZE     72
+
+__ALIGNED(4) static uint8_t s_au8AesFb[NU_CRPT_AES_FB_SIZE];
+
+/* One run from s_au8DmaIn to s_au8DmaOut. u32Fb: FBIN/FBOUT of a cascade */
+static psa_status_t nu_crpt_aead_dma(uint32_t u32Fb, uint32_t u32DMAMode, size_t len)
+{
+    CRPT->AES_CTL &= ~(CRPT_AES_CTL_FBIN_Msk | CRPT_AES_CTL_FBOUT_Msk | CRPT_AES_CTL_DMAEN_Msk |
+                       CRPT_AES_CTL_DMACSCAD_Msk | CRPT_AES_CTL_DMALAST_Msk);
+    CRPT->AES_CTL |= u32Fb;
+    AES_SetDMATransfer(CRPT, 0, (uint32_t)(uintptr_t)s_au8DmaIn, (uint32_t)(uintptr_t)s_au8DmaOut, len);
+
+    AES_CLR_INT_FLAG(CRPT);
+    AES_Start(CRPT, 0, u32DMAMode);
+    return nu_crpt_aes_wait();
+}
+
+/* Bytes of the GCM IV section: IV || 0^31 || 1 for a 96-bit IV, otherwise
+ * IV padded to a block || 0^64 || [len(IV)]64 */
+static size_t nu_crpt_gcm_iv_size(size_t nonce_length)
+{
+    return (nonce_length == 12) ? 16 : NU_CRPT_ALIGN16(nonce_length) + 16;
+}
+
+static void nu_crpt_gcm_pack_iv(const uint8_t *nonce, size_t nonce_length, uint8_t *pu8Buf)
+{
+    size_t len = nu_crpt_gcm_iv_size(nonce_length);
+    uint32_t u32Bits = (uint32_t)nonce_length * 8;
+
+    memset(pu8Buf, 0, len);
+    memcpy(pu8Buf, nonce, nonce_length);
+    if(nonce_length == 12)
+    {
+        pu8Buf[15] = 1;
+    }
+    else
+    {
+        pu8Buf[len - 4] = (uint8_t)(u32Bits >> 24);
+        pu8Buf[len - 3] = (uint8_t)(u32Bits >> 16);
+        pu8Buf[len - 2] = (uint8_t)(u32Bits >> 8);
+        pu8Buf[len - 1] = (uint8_t)u32Bits;
+    }
+}
+
+/* {IV}{A}{P} in one shot if it fits the bounce buffer, otherwise {IV}{A}
+ * first and P in a DMA cascade, as _GCM() in gcm_alt.c does */
+static psa_status_t nu_crpt_gcm(const uint32_t *pu32Key, uint32_t u32KeySz, int encrypt,
+                                const uint8_t *nonce, size_t nonce_length,
+                                const uint8_t *ad, size_t ad_length,
+                                const uint8_t *input, size_t length,
+                                uint8_t *output, uint8_t *pu8Tag)
+{
+    size_t hdr, chunk, len16;
+    psa_status_t status;
+
+    nu_crpt_gcm_pack_iv(nonce, nonce_length, s_au8DmaIn);
+    hdr = nu_crpt_gcm_iv_size(nonce_length);
+    memset(s_au8DmaIn + hdr, 0, NU_CRPT_ALIGN16(ad_length));
+    memcpy(s_au8DmaIn + hdr, ad, ad_length);
+    hdr += NU_CRPT_ALIGN16(ad_length);
+
+    AES_Open(CRPT, 0, encrypt, AES_MODE_GCM, u32KeySz, AES_IN_OUT_SWAP);
+    CRPT->AES_KSCTL = 0;
+    AES_SetKey(CRPT, 0, (uint32_t *)pu32Key, u32KeySz);
+    CRPT->AES_GCM_IVCNT[0] = (uint32_t)nonce_length;
+    CRPT->AES_GCM_IVCNT[1] = 0;
+    CRPT->AES_GCM_ACNT[0] = (uint32_t)ad_length;
+    CRPT->AES_GCM_ACNT[1] = 0;
+    CRPT->AES_GCM_PCNT[0] = (uint32_t)length;
+    CRPT->AES_GCM_PCNT[1] = 0;
+
+    len16 = NU_CRPT_ALIGN16(length);
+    if(hdr + len16 <= NU_CRPT_DMA_BUF_SIZE)
+    {
+        memset(s_au8DmaIn + hdr, 0, len16);
+        memcpy(s_au8DmaIn + hdr, input, length);
+        status = nu_crpt_aead_dma(0, CRYPTO_DMA_ONE_SHOT, hdr + len16);
+        if(status == PSA_SUCCESS)
+        {
+            memcpy(output, s_au8DmaOut, length);
+            memcpy(pu8Tag, s_au8DmaOut + len16, 16);
+        }
+        return status;
+    }
+
+    CRPT->AES_FBADDR = (uint32_t)(uintptr_t)s_au8AesFb;
+    status = nu_crpt_aead_dma(CRPT_AES_CTL_FBOUT_Msk, CRYPTO_DMA_FIRST, hdr);
+    while(length > 0 && status == PSA_SUCCESS)
+    {
+        chunk = (length > NU_CRPT_DMA_BUF_SIZE) ? NU_CRPT_DMA_BUF_SIZE : length;
+        len16 = NU_CRPT_ALIGN16(chunk);
+        memset(s_au8DmaIn + chunk, 0, len16 - chunk);
+        memcpy(s_au8DmaIn, input, chunk);
+        status = nu_crpt_aead_dma(CRPT_AES_CTL_FBIN_Msk | CRPT_AES_CTL_FBOUT_Msk,
+                                  (chunk == length) ? CRYPTO_DMA_LAST : CRYPTO_DMA_CONTINUE, len16);
+        if(status == PSA_SUCCESS)
+        {
+            memcpy(output, s_au8DmaOut, chunk);
+            /* The tag follows the last block of the last run */
+            if(chunk == length)
+                memcpy(pu8Tag, s_au8DmaOut + len16, 16);
+        }
+        input += chunk;
+        output += chunk;
+        length -= chunk;
+    }
+
+    mbedtls_platform_zeroize(s_au8AesFb, sizeof(s_au8AesFb));
+    return status;
+}
+
+/* B0 || [len(A)]16 || A || P, each part padded to a block, in one shot as
+ * ccm_auth_crypt() in ccm_alt.c does. The engine has no CCM cascade. */
+static psa_status_t nu_crpt_ccm(const uint32_t *pu32Key, uint32_t u32KeySz, int encrypt,
+                                const uint8_t *nonce, size_t nonce_length,
+                                const uint8_t *ad, size_t ad_length,
+                                const uint8_t *input, size_t length,
+                                uint8_t *output, uint8_t *pu8Tag, size_t tag_length)
+{
+    size_t q = 15 - nonce_length;
+    size_t ad16 = NU_CRPT_ALIGN16(ad_length + 2);
+    size_t len16 = NU_CRPT_ALIGN16(length);
+    uint8_t au8Ctr0[16];
+    uint32_t au32Ctr0[4];
+    psa_status_t status;
+
+    /* Flags || N || [len(P)]q; length fits the bounce buffer, so two bytes */
+    memset(s_au8DmaIn, 0, 16 + ad16 + len16);
+    s_au8DmaIn[0] = (uint8_t)(((ad_length > 0) ? 0x40 : 0) | (((tag_length - 2) / 2) << 3) | (q - 1));
+    memcpy(s_au8DmaIn + 1, nonce, nonce_length);
+    s_au8DmaIn[14] = (uint8_t)(length >> 8);
+    s_au8DmaIn[15] = (uint8_t)length;
+
+    s_au8DmaIn[16] = (uint8_t)(ad_length >> 8);
+    s_au8DmaIn[17] = (uint8_t)ad_length;
+    memcpy(s_au8DmaIn + 18, ad, ad_length);
+    memcpy(s_au8DmaIn + 16 + ad16, input, length);
+
+    /* Ctr0: flags q - 1 || N || 0 */
+    memset(au8Ctr0, 0, sizeof(au8Ctr0));
+    au8Ctr0[0] = (uint8_t)(q - 1);
+    memcpy(au8Ctr0 + 1, nonce, nonce_length);
+    nu_crpt_get_be32(au8Ctr0, au32Ctr0, 4);
+
+    AES_Open(CRPT, 0, encrypt, AES_MODE_CCM, u32KeySz, AES_IN_OUT_SWAP);
+    CRPT->AES_KSCTL = 0;
+    AES_SetKey(CRPT, 0, (uint32_t *)pu32Key, u32KeySz);
+    AES_SetInitVect(CRPT, 0, au32Ctr0);
+    CRPT->AES_GCM_ACNT[0] = (uint32_t)(16 + ad16);
+    CRPT->AES_GCM_ACNT[1] = 0;
+    CRPT->AES_GCM_PCNT[0] = (uint32_t)length;
+    CRPT->AES_GCM_PCNT[1] = 0;
+
+    status = nu_crpt_aead_dma(0, CRYPTO_DMA_ONE_SHOT, 16 + ad16 + len16);
+    if(status == PSA_SUCCESS)
+    {
+        memcpy(output, s_au8DmaOut, length);
+        memcpy(pu8Tag, s_au8DmaOut + len16, tag_length);
+    }
+
+    return status;
+}
+
+/* What the engine takes; anything else is left to the built-in code, which
+ * also reports the invalid cases */
+static psa_status_t nu_crpt_aead_check(const psa_key_attributes_t *attributes,
+                                       size_t key_buffer_size, psa_algorithm_t alg,
+                                       size_t nonce_length, size_t ad_length, size_t length,
+                                       uint32_t *pu32KeySz, size_t *pTagLength)
+{
+    psa_algorithm_t base = PSA_ALG_AEAD_WITH_DEFAULT_LENGTH_TAG(alg);
+    size_t tag_length = PSA_ALG_AEAD_GET_TAG_LENGTH(alg);
+
+    if(psa_get_key_type(attributes) != PSA_KEY_TYPE_AES)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    if(base == PSA_ALG_GCM)
+    {
+        if((tag_length != 4 && tag_length != 8 && (tag_length < 12 || tag_length > 16)) ||
+                nonce_length == 0 || nonce_length > NU_CRPT_DMA_BUF_SIZE ||
+                ad_length > NU_CRPT_DMA_BUF_SIZE || length > 0xFFFFFFF0UL ||
+                nu_crpt_gcm_iv_size(nonce_length) + NU_CRPT_ALIGN16(ad_length) > NU_CRPT_DMA_BUF_SIZE)
+            return PSA_ERROR_NOT_SUPPORTED;
+    }
+    else if(base == PSA_ALG_CCM)
+    {
+        if(tag_length < 4 || tag_length > 16 || (tag_length & 1) != 0 ||
+                nonce_length < 7 || nonce_length > 13 ||
+                ad_length > NU_CRPT_DMA_BUF_SIZE || length > NU_CRPT_DMA_BUF_SIZE ||
+                16 + NU_CRPT_ALIGN16(ad_length + 2) + NU_CRPT_ALIGN16(length) > NU_CRPT_DMA_BUF_SIZE)
+            return PSA_ERROR_NOT_SUPPORTED;
+    }
+    else
+    {
+        return PSA_ERROR_NOT_SUPPORTED;
+    }
+
+    *pTagLength = tag_length;
+    return nu_crpt_aes_key_size(key_buffer_size, pu32KeySz);
+}
+
+static psa_status_t nu_crpt_aead_run(const uint8_t *key_buffer, size_t key_buffer_size,
+                                     uint32_t u32KeySz, psa_algorithm_t alg, int encrypt,
+                                     const uint8_t *nonce, size_t nonce_length,
+                                     const uint8_t *ad, size_t ad_length,
+                                     const uint8_t *input, size_t length,
+                                     uint8_t *output, uint8_t *pu8Tag, size_t tag_length)
+{
+    uint32_t au32Key[8];
+    psa_status_t status;
+
+    nu_crpt_get_be32(key_buffer, au32Key, key_buffer_size / 4);
+
+    if(PSA_ALG_AEAD_WITH_DEFAULT_LENGTH_TAG(alg) == PSA_ALG_GCM)
+        status = nu_crpt_gcm(au32Key, u32KeySz, encrypt, nonce, nonce_length,
+                             ad, ad_length, input, length, output, pu8Tag);
+    else
+        status = nu_crpt_ccm(au32Key, u32KeySz, encrypt, nonce, nonce_length,
+                             ad, ad_length, input, length, output, pu8Tag, tag_length);
+
+    /* Leave the key registers to aes_alt.c */
+    CRPT->AES_KSCTL = 0;
+    mbedtls_platform_zeroize(au32Key, sizeof(au32Key));
+    mbedtls_platform_zeroize(s_au8DmaIn, sizeof(s_au8DmaIn));
+    mbedtls_platform_zeroize(s_au8DmaOut, sizeof(s_au8DmaOut));
+    return status;
+}
+
+psa_status_t nu_crpt_transparent_aead_encrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *nonce, size_t nonce_length,
+    const uint8_t *additional_data, size_t additional_data_length,
+    const uint8_t *plaintext, size_t plaintext_length,
+    uint8_t *ciphertext, size_t ciphertext_size, size_t *ciphertext_length)
+{
+    uint8_t au8Tag[16];
+    uint32_t u32KeySz;
+    size_t tag_length;
+    psa_status_t status;
+
+    status = nu_crpt_aead_check(attributes, key_buffer_size, alg, nonce_length,
+                                additional_data_length, plaintext_length, &u32KeySz, &tag_length);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    if(ciphertext_size < plaintext_length + tag_length)
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    status = nu_crpt_aead_run(key_buffer, key_buffer_size, u32KeySz, alg, 1,
+                              nonce, nonce_length, additional_data, additional_data_length,
+                              plaintext, plaintext_length, ciphertext, au8Tag, tag_length);
+    if(status == PSA_SUCCESS)
+    {
+        memcpy(ciphertext + plaintext_length, au8Tag, tag_length);
+        *ciphertext_length = plaintext_length + tag_length;
+    }
+
+    mbedtls_platform_zeroize(au8Tag, sizeof(au8Tag));
+    return status;
+}
+
+psa_status_t nu_crpt_transparent_aead_decrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *nonce, size_t nonce_length,
+    const uint8_t *additional_data, size_t additional_data_length,
+    const uint8_t *ciphertext, size_t ciphertext_length,
+    uint8_t *plaintext, size_t plaintext_size, size_t *plaintext_length)
+{
+    uint8_t au8Tag[16], u8Diff = 0;
+    uint32_t u32KeySz;
+    size_t tag_length = PSA_ALG_AEAD_GET_TAG_LENGTH(alg), length, i;
+    psa_status_t status;
+
+    if(ciphertext_length < tag_length)
+        return PSA_ERROR_NOT_SUPPORTED;
+    length = ciphertext_length - tag_length;
+
+    status = nu_crpt_aead_check(attributes, key_buffer_size, alg, nonce_length,
+                                additional_data_length, length, &u32KeySz, &tag_length);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    if(plaintext_size < length)
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    /* The engine computes the tag over the ciphertext; compare in constant time */
+    status = nu_crpt_aead_run(key_buffer, key_buffer_size, u32KeySz, alg, 0,
+                              nonce, nonce_length, additional_data, additional_data_length,
+                              ciphertext, length, plaintext, au8Tag, tag_length);
+    if(status == PSA_SUCCESS)
+    {
+        for(i = 0; i < tag_length; i++)
+            u8Diff |= au8Tag[i] ^ ciphertext[length + i];
+
+        if(u8Diff != 0)
+        {
+            mbedtls_platform_zeroize(plaintext, length);
+            status = PSA_ERROR_INVALID_SIGNATURE;
+        }
+        else
+        {
+            *plaintext_length = length;
+        }
+    }
+
+    mbedtls_platform_zeroize(au8Tag, sizeof(au8Tag));
+    return status;
+}
+
+#if defined(NU_CRPT_RSA)
+/*
+ * RSA signatures: PKCS#1 v1.5 and PSS
+ *
+ * Padding is done here, the modular exponentiation on the engine in normal
+ * mode with the private exponent, as rsa_alt.c does. The engine takes its
+ * operands as hex strings through the StdDriver RSA_* functions.
+ */
+
+#define NU_CRPT_RSA_MAX_BYTES   (RSA_MAX_KLEN / 8)
+
+__ALIGNED(4) static RSA_BUF_NORMAL_T s_sRsaBuf;
+static char s_aacRsaHex[2][RSA_KBUF_HLEN];
+static uint8_t s_aau8RsaEm[2][NU_CRPT_RSA_MAX_BYTES];
+
+static psa_status_t nu_crpt_rsa_wait(void)
+{
+    int32_t timeout = NU_CRPT_TIMEOUT;
+
+    while((CRPT->INTSTS & (CRPT_INTSTS_RSAIF_Msk | CRPT_INTSTS_RSAEIF_Msk)) == 0)
+    {
+        if(timeout-- <= 0)
+            return PSA_ERROR_HARDWARE_FAILURE;
+    }
+
+    if(CRPT->INTSTS & CRPT_INTSTS_RSAEIF_Msk)
+    {
+        RSA_CLR_INT_FLAG(CRPT);
+        return PSA_ERROR_HARDWARE_FAILURE;
+    }
+
+    RSA_CLR_INT_FLAG(CRPT);
+    return PSA_SUCCESS;
+}
+
+/* out = in ^ X mod N, in and out k bytes big-endian */
+static psa_status_t nu_crpt_rsa_run(const mbedtls_mpi *N, const mbedtls_mpi *X,
+                                    const uint8_t *in, uint8_t *out, size_t k)
+{
+    psa_status_t status = PSA_ERROR_HARDWARE_FAILURE;
+    size_t olen;
+
+    /* Hex2Reg() only writes the words of the string: the buffers start zeroed */
+    if(RSA_Open(CRPT, RSA_MODE_NORMAL, (uint32_t)(k / 128 - 1), &s_sRsaBuf, sizeof(s_sRsaBuf), 0) == 0 &&
+            mbedtls_mpi_write_string(X, 16, s_aacRsaHex[0], RSA_KBUF_HLEN, &olen) == 0 &&
+            RSA_SetKey(CRPT, s_aacRsaHex[0]) == 0 &&
+            mbedtls_mpi_write_string(N, 16, s_aacRsaHex[0], RSA_KBUF_HLEN, &olen) == 0)
+    {
+        nu_crpt_bin2hex(in, k, s_aacRsaHex[1]);
+        RSA_SetDMATransfer(CRPT, s_aacRsaHex[1], s_aacRsaHex[0], NULL, NULL);
+
+        RSA_CLR_INT_FLAG(CRPT);
+        RSA_Start(CRPT);
+        status = nu_crpt_rsa_wait();
+        if(status == PSA_SUCCESS)
+        {
+            RSA_Read(CRPT, s_aacRsaHex[1]);
+            if(nu_crpt_hex2bin(s_aacRsaHex[1], out, k) != 0)
+                status = PSA_ERROR_HARDWARE_FAILURE;
+        }
+    }
+
+    mbedtls_platform_zeroize(&s_sRsaBuf, sizeof(s_sRsaBuf));
+    mbedtls_platform_zeroize(s_aacRsaHex, sizeof(s_aacRsaHex));
+    return status;
+}
+
+/* N and E, and D if not NULL, of a key the engine takes: 1024 to 4096 bits
+ * in steps of 1024. pk: modulus bytes. */
+static psa_status_t nu_crpt_rsa_load(const psa_key_attributes_t *attributes,
+                                     const uint8_t *key_buffer, size_t key_buffer_size,
+                                     mbedtls_mpi *N, mbedtls_mpi *D, mbedtls_mpi *E, size_t *pk)
+{
+    mbedtls_rsa_context *rsa = NULL;
+    psa_status_t status;
+    size_t k;
+
+    status = mbedtls_psa_rsa_load_representation(psa_get_key_type(attributes),
+             key_buffer, key_buffer_size, &rsa);
+    if(status != PSA_SUCCESS)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    k = mbedtls_rsa_get_len(rsa);
+    if((k % 128) != 0 || k > NU_CRPT_RSA_MAX_BYTES ||
+            mbedtls_rsa_export(rsa, N, NULL, NULL, D, E) != 0 || mbedtls_mpi_bitlen(N) != 8 * k)
+        status = PSA_ERROR_NOT_SUPPORTED;
+    else
+        *pk = k;
+
+    mbedtls_rsa_free(rsa);
+    mbedtls_free(rsa);
+    return status;
+}
+
+/* The hash of alg, NULL for PKCS#1 v1.5 without DigestInfo. The built-in
+ * code reports a hash of the wrong length. */
+static psa_status_t nu_crpt_rsa_md(psa_algorithm_t alg, size_t hash_length,
+                                   const mbedtls_md_info_t **ppMd)
+{
+    const mbedtls_md_info_t *md;
+
+    if(!PSA_ALG_IS_RSA_PKCS1V15_SIGN(alg) && !PSA_ALG_IS_RSA_PSS(alg))
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    if(alg == PSA_ALG_RSA_PKCS1V15_SIGN_RAW)
+    {
+        *ppMd = NULL;
+        return PSA_SUCCESS;
+    }
+
+    md = mbedtls_md_info_from_psa(PSA_ALG_SIGN_GET_HASH(alg));
+    if(md == NULL || mbedtls_md_get_size(md) != hash_length)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    *ppMd = md;
+    return PSA_SUCCESS;
+}
+
+/* EMSA-PKCS1-v1_5: 00 01 FF..FF 00 [DigestInfo] hash */
+static psa_status_t nu_crpt_pkcs1_v15_encode(const mbedtls_md_info_t *md,
+        const uint8_t *hash, size_t hash_length, uint8_t *em, size_t k)
+{
+    const char *oid = NULL;
+    size_t oid_length = 0, t_length = hash_length;
+
+    if(md != NULL)
+    {
+        if(mbedtls_oid_get_oid_by_md(mbedtls_md_get_type(md), &oid, &oid_length) != 0)
+            return PSA_ERROR_NOT_SUPPORTED;
+        t_length = 10 + oid_length + hash_length;
+    }
+    if(k < t_length + 11)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    *em++ = 0x00;
+    *em++ = 0x01;
+    memset(em, 0xFF, k - t_length - 3);
+    em += k - t_length - 3;
+    *em++ = 0x00;
+
+    if(md != NULL)
+    {
+        *em++ = MBEDTLS_ASN1_SEQUENCE | MBEDTLS_ASN1_CONSTRUCTED;
+        *em++ = (uint8_t)(8 + oid_length + hash_length);
+        *em++ = MBEDTLS_ASN1_SEQUENCE | MBEDTLS_ASN1_CONSTRUCTED;
+        *em++ = (uint8_t)(4 + oid_length);
+        *em++ = MBEDTLS_ASN1_OID;
+        *em++ = (uint8_t)oid_length;
+        memcpy(em, oid, oid_length);
+        em += oid_length;
+        *em++ = MBEDTLS_ASN1_NULL;
+        *em++ = 0x00;
+        *em++ = MBEDTLS_ASN1_OCTET_STRING;
+        *em++ = (uint8_t)hash_length;
+    }
+    memcpy(em, hash, hash_length);
+
+    return PSA_SUCCESS;
+}
+
+/* dst ^= MGF1(seed), the mask hash being the message hash */
+static psa_status_t nu_crpt_mgf1_mask(psa_algorithm_t hash_alg, const uint8_t *seed, size_t hlen,
+                                      uint8_t *dst, size_t len)
+{
+    uint8_t au8In[PSA_HASH_MAX_SIZE + 4];
+    uint8_t au8Mask[PSA_HASH_MAX_SIZE];
+    uint32_t u32Counter;
+    size_t i, n, olen;
+    psa_status_t status = PSA_SUCCESS;
+
+    memcpy(au8In, seed, hlen);
+    for(u32Counter = 0; len > 0 && status == PSA_SUCCESS; u32Counter++)
+    {
+        au8In[hlen] = (uint8_t)(u32Counter >> 24);
+        au8In[hlen + 1] = (uint8_t)(u32Counter >> 16);
+        au8In[hlen + 2] = (uint8_t)(u32Counter >> 8);
+        au8In[hlen + 3] = (uint8_t)u32Counter;
+        status = psa_hash_compute(hash_alg, au8In, hlen + 4, au8Mask, sizeof(au8Mask), &olen);
+
+        n = (len < hlen) ? len : hlen;
+        for(i = 0; i < n && status == PSA_SUCCESS; i++)
+            dst[i] ^= au8Mask[i];
+        dst += n;
+        len -= n;
+    }
+
+    mbedtls_platform_zeroize(au8Mask, sizeof(au8Mask));
+    return status;
+}
+
+/* H = Hash(0^64 || mHash || salt) */
+static psa_status_t nu_crpt_pss_hash(psa_algorithm_t hash_alg, const uint8_t *hash, size_t hlen,
+                                     const uint8_t *salt, size_t salt_length, uint8_t *pu8H)
+{
+    static const uint8_t s_au8Zeros[8] = { 0 };
+    psa_hash_operation_t operation = PSA_HASH_OPERATION_INIT;
+    psa_status_t status;
+    size_t olen;
+
+    status = psa_hash_setup(&operation, hash_alg);
+    if(status == PSA_SUCCESS)
+        status = psa_hash_update(&operation, s_au8Zeros, sizeof(s_au8Zeros));
+    if(status == PSA_SUCCESS)
+        status = psa_hash_update(&operation, hash, hlen);
+    if(status == PSA_SUCCESS)
+        status = psa_hash_update(&operation, salt, salt_length);
+    if(status == PSA_SUCCESS)
+        status = psa_hash_finish(&operation, pu8H, hlen, &olen);
+
+    psa_hash_abort(&operation);
+    return status;
+}
+
+/* The salt mbedtls_rsa_rsassa_pss_sign() picks and PSA_ALG_RSA_PSS expects:
+ * the hash length, or what is left of the k bytes next to it */
+static size_t nu_crpt_pss_salt(size_t hlen, size_t k)
+{
+    return (k - 2 - hlen < hlen) ? k - 2 - hlen : hlen;
+}
+
+/* EMSA-PSS over a modulus of exactly 8 * k bits: maskedDB || H || BC */
+static psa_status_t nu_crpt_pss_encode(psa_algorithm_t hash_alg, const uint8_t *hash, size_t hlen,
+                                       uint8_t *em, size_t k)
+{
+    size_t db_length = k - hlen - 1, salt_length;
+    psa_status_t status;
+
+    salt_length = nu_crpt_pss_salt(hlen, k);
+
+    memset(em, 0, db_length);
+    em[db_length - salt_length - 1] = 0x01;
+    status = psa_generate_random(em + db_length - salt_length, salt_length);
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_pss_hash(hash_alg, hash, hlen, em + db_length - salt_length, salt_length,
+                                  em + db_length);
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_mgf1_mask(hash_alg, em + db_length, hlen, em, db_length);
+
+    em[0] &= 0x7F;
+    em[k - 1] = 0xBC;
+    return status;
+}
+
+/* em: the signature raised to E */
+static psa_status_t nu_crpt_pss_verify(psa_algorithm_t alg, const uint8_t *hash, size_t hlen,
+                                       uint8_t *em, size_t k)
+{
+    psa_algorithm_t hash_alg = PSA_ALG_SIGN_GET_HASH(alg);
+    uint8_t au8H[PSA_HASH_MAX_SIZE];
+    size_t db_length = k - hlen - 1, salt_length, i;
+    psa_status_t status;
+
+    if(em[k - 1] != 0xBC)
+        return PSA_ERROR_INVALID_SIGNATURE;
+    /* The built-in code takes this for an invalid argument */
+    if(em[0] & 0x80)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    status = nu_crpt_mgf1_mask(hash_alg, em + db_length, hlen, em, db_length);
+    if(status != PSA_SUCCESS)
+        return status;
+    em[0] &= 0x7F;
+
+    for(i = 0; i < db_length - 1 && em[i] == 0; i++)
+    {
+    }
+    if(em[i] != 0x01)
+        return PSA_ERROR_INVALID_SIGNATURE;
+
+    salt_length = db_length - i - 1;
+    if(!PSA_ALG_IS_RSA_PSS_ANY_SALT(alg) && salt_length != nu_crpt_pss_salt(hlen, k))
+        return PSA_ERROR_INVALID_SIGNATURE;
+
+    status = nu_crpt_pss_hash(hash_alg, hash, hlen, em + i + 1, salt_length, au8H);
+    if(status == PSA_SUCCESS && memcmp(au8H, em + db_length, hlen) != 0)
+        status = PSA_ERROR_INVALID_SIGNATURE;
+
+    return status;
+}
+
+static psa_status_t nu_crpt_rsa_sign_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    uint8_t *signature, size_t signature_size, size_t *signature_length)
+{
+    const mbedtls_md_info_t *md;
+    mbedtls_mpi N, D, E;
+    size_t k = 0;
+    psa_status_t status;
+
+    if(psa_get_key_type(attributes) != PSA_KEY_TYPE_RSA_KEY_PAIR)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    status = nu_crpt_rsa_md(alg, hash_length, &md);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&D);
+    mbedtls_mpi_init(&E);
+
+    status = nu_crpt_rsa_load(attributes, key_buffer, key_buffer_size, &N, &D, &E, &k);
+    if(status == PSA_SUCCESS && signature_size < k)
+        status = PSA_ERROR_BUFFER_TOO_SMALL;
+
+    if(status == PSA_SUCCESS)
+    {
+        if(PSA_ALG_IS_RSA_PSS(alg))
+            status = nu_crpt_pss_encode(PSA_ALG_SIGN_GET_HASH(alg), hash, hash_length,
+                                        s_aau8RsaEm[0], k);
+        else
+            status = nu_crpt_pkcs1_v15_encode(md, hash, hash_length, s_aau8RsaEm[0], k);
+    }
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_rsa_run(&N, &D, s_aau8RsaEm[0], signature, k);
+
+    /* Check the signature with the public key against faults, as
+     * mbedtls_rsa_private() does */
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_rsa_run(&N, &E, signature, s_aau8RsaEm[1], k);
+    if(status == PSA_SUCCESS && memcmp(s_aau8RsaEm[0], s_aau8RsaEm[1], k) != 0)
+    {
+        mbedtls_platform_zeroize(signature, k);
+        status = PSA_ERROR_HARDWARE_FAILURE;
+    }
+    if(status == PSA_SUCCESS)
+        *signature_length = k;
+
+    mbedtls_platform_zeroize(s_aau8RsaEm, sizeof(s_aau8RsaEm));
+    mbedtls_mpi_free(&E);
+    mbedtls_mpi_free(&D);
+    mbedtls_mpi_free(&N);
+    return status;
+}
+
+static psa_status_t nu_crpt_rsa_verify_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    const uint8_t *signature, size_t signature_length)
+{
+    const mbedtls_md_info_t *md;
+    mbedtls_mpi N, E, S;
+    size_t k = 0;
+    psa_status_t status;
+
+    status = nu_crpt_rsa_md(alg, hash_length, &md);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&E);
+    mbedtls_mpi_init(&S);
+
+    /* A signature of the wrong length or not below N is left to the
+     * built-in code, which tells the two apart */
+    status = nu_crpt_rsa_load(attributes, key_buffer, key_buffer_size, &N, NULL, &E, &k);
+    if(status == PSA_SUCCESS &&
+            (signature_length != k || mbedtls_mpi_read_binary(&S, signature, k) != 0 ||
+             mbedtls_mpi_cmp_mpi(&S, &N) >= 0))
+        status = PSA_ERROR_NOT_SUPPORTED;
+
+    if(status == PSA_SUCCESS && !PSA_ALG_IS_RSA_PSS(alg))
+        status = nu_crpt_pkcs1_v15_encode(md, hash, hash_length, s_aau8RsaEm[1], k);
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_rsa_run(&N, &E, signature, s_aau8RsaEm[0], k);
+
+    if(status == PSA_SUCCESS)
+    {
+        if(PSA_ALG_IS_RSA_PSS(alg))
+            status = nu_crpt_pss_verify(alg, hash, hash_length, s_aau8RsaEm[0], k);
+        else if(memcmp(s_aau8RsaEm[0], s_aau8RsaEm[1], k) != 0)
+            status = PSA_ERROR_INVALID_SIGNATURE;
+    }
+
+    mbedtls_platform_zeroize(s_aau8RsaEm, sizeof(s_aau8RsaEm));
+    mbedtls_mpi_free(&S);
+    mbedtls_mpi_free(&E);
+    mbedtls_mpi_free(&N);
+    return status;
+}
+#endif /* NU_CRPT_RSA */
+
+/*
+ * ECDSA
+ */
+
+static psa_status_t nu_crpt_ecdsa_check(const psa_key_attributes_t *attributes,
+                                        psa_algorithm_t alg, const nu_crpt_curve_t **ppCurve)
+{
+    const nu_crpt_curve_t *curve;
+
+    /* Deterministic ECDSA needs HMAC_DRBG on k, leave it to the built-in code */
+    if(!PSA_ALG_IS_RANDOMIZED_ECDSA(alg))
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    curve = nu_crpt_get_curve(psa_get_key_type(attributes), psa_get_key_bits(attributes));
+    if(curve == NULL)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    *ppCurve = curve;
+    return PSA_SUCCESS;
+}
+
+static psa_status_t nu_crpt_write_signature(const nu_crpt_curve_t *curve,
+        const char *pcR, const char *pcS, uint8_t *signature, int *piRetry)
+{
+    if(nu_crpt_hex2bin(pcR, signature, curve->bytes) != 0 ||
+            nu_crpt_hex2bin(pcS, signature + curve->bytes, curve->bytes) != 0)
+        return PSA_ERROR_HARDWARE_FAILURE;
+
+    /* r = 0 or s = 0: start again with another k */
+    *piRetry = nu_crpt_is_zero(signature, curve->bytes) ||
+               nu_crpt_is_zero(signature + curve->bytes, curve->bytes);
+    return PSA_SUCCESS;
+}
+
+static psa_status_t nu_crpt_ecdsa_verify(const nu_crpt_curve_t *curve,
+        const char *pcX, const char *pcY,
+        const uint8_t *hash, size_t hash_length,
+        const uint8_t *signature, size_t signature_length)
+{
+    char acE[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acR[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acS[NU_CRPT_ECC_MAX_CHARS + 1];
+    int32_t ret;
+
+    if(signature_length != 2 * curve->bytes ||
+            !nu_crpt_in_range(curve, signature) ||
+            !nu_crpt_in_range(curve, signature + curve->bytes))
+        return PSA_ERROR_INVALID_SIGNATURE;
+
+    nu_crpt_hash_to_hex(curve, hash, hash_length, acE);
+    nu_crpt_bin2hex(signature, curve->bytes, acR);
+    nu_crpt_bin2hex(signature + curve->bytes, curve->bytes, acS);
+
+    ret = ECC_VerifySignature(CRPT, curve->eCurve, acE, (char *)pcX, (char *)pcY, acR, acS);
+    if(ret == -2)
+        return PSA_ERROR_INVALID_SIGNATURE;
+    if(ret != 0)
+        return PSA_ERROR_HARDWARE_FAILURE;
+
+    return PSA_SUCCESS;
+}
+
+psa_status_t nu_crpt_transparent_sign_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    uint8_t *signature, size_t signature_size, size_t *signature_length)
+{
+    const nu_crpt_curve_t *curve;
+    uint8_t au8K[NU_CRPT_ECC_MAX_BYTES];
+    char acD[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acK[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acE[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acR[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acS[NU_CRPT_ECC_MAX_CHARS + 1];
+    psa_status_t status;
+    int retry = 1, tries;
+
+#if defined(NU_CRPT_RSA)
+    if(PSA_KEY_TYPE_IS_RSA(psa_get_key_type(attributes)))
+        return nu_crpt_rsa_sign_hash(attributes, key_buffer, key_buffer_size, alg,
+                                     hash, hash_length, signature, signature_size, signature_length);
+#endif
+
+    status = nu_crpt_ecdsa_check(attributes, alg, &curve);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    if(!PSA_KEY_TYPE_IS_ECC_KEY_PAIR(psa_get_key_type(attributes)) ||
+            key_buffer_size != curve->bytes)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    if(signature_size < 2 * curve->bytes)
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    nu_crpt_bin2hex(key_buffer, curve->bytes, acD);
+    nu_crpt_hash_to_hex(curve, hash, hash_length, acE);
+
+    for(tries = 0; retry && tries < 16; tries++)
+    {
+        /* k in [1, n-1] by rejection */
+        status = psa_generate_random(au8K, curve->bytes);
+        if(status != PSA_SUCCESS)
+            break;
+        if(!nu_crpt_in_range(curve, au8K))
+            continue;
+        nu_crpt_bin2hex(au8K, curve->bytes, acK);
+
+        if(ECC_GenerateSignature(CRPT, curve->eCurve, acE, acD, acK, acR, acS) != 0)
+        {
+            status = PSA_ERROR_HARDWARE_FAILURE;
+            break;
+        }
+
+        status = nu_crpt_write_signature(curve, acR, acS, signature, &retry);
+        if(status != PSA_SUCCESS)
+            break;
+    }
+
+    if(status == PSA_SUCCESS && retry)
+        status = PSA_ERROR_INSUFFICIENT_ENTROPY;
+    if(status == PSA_SUCCESS)
+        *signature_length = 2 * curve->bytes;
+
+    mbedtls_platform_zeroize(au8K, sizeof(au8K));
+    mbedtls_platform_zeroize(acK, sizeof(acK));
+    mbedtls_platform_zeroize(acD, sizeof(acD));
+    return status;
+}
+
+psa_status_t nu_crpt_transparent_verify_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    const uint8_t *signature, size_t signature_length)
+{
+    const nu_crpt_curve_t *curve;
+    char acD[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acX[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acY[NU_CRPT_ECC_MAX_CHARS + 1];
+    psa_status_t status;
+
+#if defined(NU_CRPT_RSA)
+    if(PSA_KEY_TYPE_IS_RSA(psa_get_key_type(attributes)))
+        return nu_crpt_rsa_verify_hash(attributes, key_buffer, key_buffer_size, alg,
+                                       hash, hash_length, signature, signature_length);
+#endif
+
+    status = nu_crpt_ecdsa_check(attributes, alg, &curve);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    if(PSA_KEY_TYPE_IS_ECC_KEY_PAIR(psa_get_key_type(attributes)))
+    {
+        if(key_buffer_size != curve->bytes)
+            return PSA_ERROR_NOT_SUPPORTED;
+
+        nu_crpt_bin2hex(key_buffer, curve->bytes, acD);
+        status = (ECC_GeneratePublicKey(CRPT, curve->eCurve, acD, acX, acY) == 0) ?
+                 PSA_SUCCESS : PSA_ERROR_HARDWARE_FAILURE;
+        mbedtls_platform_zeroize(acD, sizeof(acD));
+        if(status != PSA_SUCCESS)
+            return status;
+    }
+    else
+    {
+        if(key_buffer_size != 1 + 2 * curve->bytes || key_buffer[0] != 0x04)
+            return PSA_ERROR_NOT_SUPPORTED;
+
+        nu_crpt_bin2hex(key_buffer + 1, curve->bytes, acX);
+        nu_crpt_bin2hex(key_buffer + 1 + curve->bytes, curve->bytes, acY);
+    }
+
+    return nu_crpt_ecdsa_verify(curve, acX, acY, hash, hash_length,
+                                signature, signature_length);
+}
+
+psa_status_t nu_crpt_transparent_export_public_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    uint8_t *data, size_t data_size, size_t *data_length)
+{
+    const nu_crpt_curve_t *curve;
+    char acD[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acX[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acY[NU_CRPT_ECC_MAX_CHARS + 1];
+    int32_t ret;
+
+    curve = nu_crpt_get_curve(psa_get_key_type(attributes), psa_get_key_bits(attributes));
+    if(curve == NULL || !PSA_KEY_TYPE_IS_ECC_KEY_PAIR(psa_get_key_type(attributes)) ||
+            key_buffer_size != curve->bytes)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    nu_crpt_bin2hex(key_buffer, curve->bytes, acD);
+    ret = ECC_GeneratePublicKey(CRPT, curve->eCurve, acD, acX, acY);
+    mbedtls_platform_zeroize(acD, sizeof(acD));
+    if(ret != 0)
+        return PSA_ERROR_HARDWARE_FAILURE;
+
+    return nu_crpt_write_point(curve, acX, acY, data, data_size, data_length);
+}
+
+psa_status_t nu_crpt_transparent_init(void)
+{
+    /* ECC_* wait for ECC_DriverISR(); AES and SHA are polled */
+    ECC_ENABLE_INT(CRPT);
+    return PSA_SUCCESS;
+}
+
+void nu_crpt_transparent_free(void)
+{
+}
+
+/*
+ * Opaque driver: keys in Key Store SRAM
+ */
+
+static void nu_crpt_ks_words(const nu_crpt_curve_t *curve, uint32_t *pu32N)
+{
+    uint8_t au8N[NU_CRPT_ECC_MAX_BYTES];
+    char acN[NU_CRPT_ECC_MAX_CHARS + 1];
+
+    memset(pu32N, 0, 18 * sizeof(uint32_t));
+    nu_crpt_curve_order(curve, au8N);
+    nu_crpt_bin2hex(au8N, curve->bytes, acN);
+    CRPT_Hex2Reg(acN, pu32N);
+}
+
+static psa_status_t nu_crpt_ks_check_attributes(const psa_key_attributes_t *attributes,
+        const nu_crpt_curve_t **ppCurve, uint32_t *pu32Meta)
+{
+    psa_key_type_t type = psa_get_key_type(attributes);
+
+    /* Key Store SRAM is lost on reset */
+    if(!PSA_KEY_LIFETIME_IS_VOLATILE(psa_get_key_lifetime(attributes)))
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    *ppCurve = NULL;
+
+    if(type == PSA_KEY_TYPE_AES)
+    {
+        switch(psa_get_key_bits(attributes))
+        {
+        case 128:
+            *pu32Meta = KS_META_AES | KS_META_128;
+            break;
+        case 192:
+            *pu32Meta = KS_META_AES | KS_META_192;
+            break;
+        case 256:
+            *pu32Meta = KS_META_AES | KS_META_256;
+            break;
+        default:
+            return PSA_ERROR_NOT_SUPPORTED;
+        }
+        return PSA_SUCCESS;
+    }
+
+    if(PSA_KEY_TYPE_IS_ECC_KEY_PAIR(type))
+    {
+        *ppCurve = nu_crpt_get_curve(type, psa_get_key_bits(attributes));
+        if(*ppCurve == NULL)
+            return PSA_ERROR_NOT_SUPPORTED;
+        *pu32Meta = KS_META_ECC | (*ppCurve)->u32KsMeta;
+        return PSA_SUCCESS;
+    }
+
+    return PSA_ERROR_NOT_SUPPORTED;
+}
+
+static psa_status_t nu_crpt_ks_write(const nu_crpt_curve_t *curve, uint32_t u32Meta,
+                                     const uint8_t *key, size_t key_length,
+                                     uint8_t *key_buffer, size_t key_buffer_size,
+                                     size_t *key_buffer_length)
+{
+    nu_crpt_ks_key_t *psKey = (nu_crpt_ks_key_t *)key_buffer;
+    uint32_t au32Key[18];
+    char acKey[NU_CRPT_ECC_MAX_CHARS + 1];
+    int32_t i32KeyIdx;
+
+    if(key_buffer_size < sizeof(nu_crpt_ks_key_t))
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    memset(au32Key, 0, sizeof(au32Key));
+    if(curve == NULL)
+    {
+        /* AES: the words AES_SetKey() would take */
+        nu_crpt_get_be32(key, au32Key, key_length / 4);
+    }
+    else
+    {
+        /* ECC: least significant word first */
+        nu_crpt_bin2hex(key, key_length, acKey);
+        CRPT_Hex2Reg(acKey, au32Key);
+        mbedtls_platform_zeroize(acKey, sizeof(acKey));
+    }
+
+    i32KeyIdx = KS_Write(KS_SRAM, u32Meta, au32Key);
+    mbedtls_platform_zeroize(au32Key, sizeof(au32Key));
+    if(i32KeyIdx < 0)
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+
+    psKey->u32Magic = NU_CRPT_KS_MAGIC;
+    psKey->i32KeyIdx = i32KeyIdx;
+    psKey->u32Meta = u32Meta;
+    *key_buffer_length = sizeof(nu_crpt_ks_key_t);
+
+    return PSA_SUCCESS;
+}
+
+psa_status_t nu_crpt_opaque_init(void)
+{
+    return (KS_Open() == 0) ? PSA_SUCCESS : PSA_ERROR_HARDWARE_FAILURE;
+}
+
+void nu_crpt_opaque_free(void)
+{
+}
+
+size_t nu_crpt_opaque_size_function(psa_key_type_t key_type, size_t key_bits)
+{
+    if(key_type == PSA_KEY_TYPE_AES ||
+            (PSA_KEY_TYPE_IS_ECC_KEY_PAIR(key_type) && nu_crpt_get_curve(key_type, key_bits) != NULL))
+        return sizeof(nu_crpt_ks_key_t);
+
+    return 0;
+}
+
+psa_status_t nu_crpt_opaque_import_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *data, size_t data_length,
+    uint8_t *key_buffer, size_t key_buffer_size,
+    size_t *key_buffer_length, size_t *bits)
+{
+    psa_key_attributes_t sized = *attributes;
+    const nu_crpt_curve_t *curve;
+    uint32_t u32Meta;
+    psa_status_t status;
+
+    if(psa_get_key_bits(attributes) != 0 && psa_get_key_bits(attributes) != PSA_BYTES_TO_BITS(data_length))
+        return PSA_ERROR_INVALID_ARGUMENT;
+
+    psa_set_key_bits(&sized, PSA_BYTES_TO_BITS(data_length));
+    status = nu_crpt_ks_check_attributes(&sized, &curve, &u32Meta);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    if(curve != NULL && !nu_crpt_in_range(curve, data))
+        return PSA_ERROR_INVALID_ARGUMENT;
+
+    status = nu_crpt_ks_write(curve, u32Meta, data, data_length,
+                              key_buffer, key_buffer_size, key_buffer_length);
+    if(status == PSA_SUCCESS)
+        *bits = PSA_BYTES_TO_BITS(data_length);
+
+    return status;
+}
+
+psa_status_t nu_crpt_opaque_generate_key(
+    const psa_key_attributes_t *attributes,
+    uint8_t *key_buffer, size_t key_buffer_size, size_t *key_buffer_length)
+{
+    nu_crpt_ks_key_t *psKey = (nu_crpt_ks_key_t *)key_buffer;
+    const nu_crpt_curve_t *curve;
+    uint8_t au8Key[32];
+    uint32_t au32N[18];
+    uint32_t u32Meta;
+    int32_t i32KeyIdx;
+    psa_status_t status;
+
+    status = nu_crpt_ks_check_attributes(attributes, &curve, &u32Meta);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    if(curve == NULL)
+    {
+        status = psa_generate_random(au8Key, PSA_BITS_TO_BYTES(psa_get_key_bits(attributes)));
+        if(status == PSA_SUCCESS)
+            status = nu_crpt_ks_write(NULL, u32Meta, au8Key,
+                                      PSA_BITS_TO_BYTES(psa_get_key_bits(attributes)),
+                                      key_buffer, key_buffer_size, key_buffer_length);
+        mbedtls_platform_zeroize(au8Key, sizeof(au8Key));
+        return status;
+    }
+
+    if(key_buffer_size < sizeof(nu_crpt_ks_key_t))
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    /* The private key goes from the PRNG straight into Key Store */
+    nu_crpt_ks_words(curve, au32N);
+    if(RNG_ECDH_Init(curve->u32PrngKeySize, au32N) != 0)
+        return PSA_ERROR_HARDWARE_FAILURE;
+    i32KeyIdx = RNG_ECDH(curve->u32PrngKeySize);
+    CRPT->PRNG_KSCTL = 0;
+    if(i32KeyIdx < 0)
+        return PSA_ERROR_INSUFFICIENT_MEMORY;
+
+    psKey->u32Magic = NU_CRPT_KS_MAGIC;
+    psKey->i32KeyIdx = i32KeyIdx;
+    psKey->u32Meta = u32Meta;
+    *key_buffer_length = sizeof(nu_crpt_ks_key_t);
+
+    return PSA_SUCCESS;
+}
+
+psa_status_t nu_crpt_opaque_destroy_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size)
+{
+    const nu_crpt_ks_key_t *psKey;
+
+    (void)attributes;
+
+    /* Nothing was written for a key whose creation failed */
+    if(nu_crpt_ks_key(key_buffer, key_buffer_size, &psKey) != PSA_SUCCESS)
+        return PSA_SUCCESS;
+
+    return (KS_EraseKey(psKey->i32KeyIdx) == 0) ? PSA_SUCCESS : PSA_ERROR_HARDWARE_FAILURE;
+}
+
+static psa_status_t nu_crpt_ks_public_key(const nu_crpt_curve_t *curve,
+        const nu_crpt_ks_key_t *psKey, char *pcX, char *pcY)
+{
+    int32_t ret;
+
+    ret = ECC_GeneratePublicKey_KS(CRPT, curve->eCurve, KS_SRAM, psKey->i32KeyIdx, pcX, pcY, 0);
+    CRPT->ECC_KSCTL = 0;
+
+    return (ret == 0) ? PSA_SUCCESS : PSA_ERROR_HARDWARE_FAILURE;
+}
+
+static psa_status_t nu_crpt_ks_ecc_key(const psa_key_attributes_t *attributes,
+                                       const uint8_t *key_buffer, size_t key_buffer_size,
+                                       const nu_crpt_curve_t **ppCurve,
+                                       const nu_crpt_ks_key_t **ppsKey)
+{
+    if(!PSA_KEY_TYPE_IS_ECC_KEY_PAIR(psa_get_key_type(attributes)))
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    *ppCurve = nu_crpt_get_curve(psa_get_key_type(attributes), psa_get_key_bits(attributes));
+    if(*ppCurve == NULL)
+        return PSA_ERROR_NOT_SUPPORTED;
+
+    return nu_crpt_ks_key(key_buffer, key_buffer_size, ppsKey);
+}
+
+psa_status_t nu_crpt_opaque_export_public_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    uint8_t *data, size_t data_size, size_t *data_length)
+{
+    const nu_crpt_curve_t *curve;
+    const nu_crpt_ks_key_t *psKey;
+    char acX[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acY[NU_CRPT_ECC_MAX_CHARS + 1];
+    psa_status_t status;
+
+    status = nu_crpt_ks_ecc_key(attributes, key_buffer, key_buffer_size, &curve, &psKey);
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_ks_public_key(curve, psKey, acX, acY);
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_write_point(curve, acX, acY, data, data_size, data_length);
+
+    return status;
+}
+
+psa_status_t nu_crpt_opaque_sign_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    uint8_t *signature, size_t signature_size, size_t *signature_length)
+{
+    const nu_crpt_curve_t *curve;
+    const nu_crpt_ks_key_t *psKey;
+    uint32_t au32N[18];
+    char acE[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acR[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acS[NU_CRPT_ECC_MAX_CHARS + 1];
+    int32_t i32KeyIdx_k, ret;
+    psa_status_t status;
+    int retry = 1, tries;
+
+    status = nu_crpt_ecdsa_check(attributes, alg, &curve);
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_ks_ecc_key(attributes, key_buffer, key_buffer_size, &curve, &psKey);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    if(signature_size < 2 * curve->bytes)
+        return PSA_ERROR_BUFFER_TOO_SMALL;
+
+    nu_crpt_hash_to_hex(curve, hash, hash_length, acE);
+    nu_crpt_ks_words(curve, au32N);
+
+    for(tries = 0; retry && tries < 16; tries++)
+    {
+        /* k must come from the PRNG into Key Store for ECC_GenerateSignature_KS() */
+        if(RNG_ECDSA_Init(curve->u32PrngKeySize, au32N) != 0)
+        {
+            status = PSA_ERROR_HARDWARE_FAILURE;
+            break;
+        }
+        i32KeyIdx_k = RNG_ECDSA(curve->u32PrngKeySize);
+        CRPT->PRNG_KSCTL = 0;
+        if(i32KeyIdx_k < 0)
+        {
+            status = PSA_ERROR_INSUFFICIENT_MEMORY;
+            break;
+        }
+
+        ret = ECC_GenerateSignature_KS(CRPT, curve->eCurve, acE, KS_SRAM, psKey->i32KeyIdx,
+                                       KS_SRAM, i32KeyIdx_k, acR, acS);
+        CRPT->ECC_KSCTL = 0;
+        KS_EraseKey(i32KeyIdx_k);
+        if(ret != 0)
+        {
+            status = PSA_ERROR_HARDWARE_FAILURE;
+            break;
+        }
+
+        status = nu_crpt_write_signature(curve, acR, acS, signature, &retry);
+        if(status != PSA_SUCCESS)
+            break;
+    }
+
+    if(status == PSA_SUCCESS && retry)
+        status = PSA_ERROR_INSUFFICIENT_ENTROPY;
+    if(status == PSA_SUCCESS)
+        *signature_length = 2 * curve->bytes;
+
+    return status;
+}
+
+psa_status_t nu_crpt_opaque_verify_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    const uint8_t *signature, size_t signature_length)
+{
+    const nu_crpt_curve_t *curve;
+    const nu_crpt_ks_key_t *psKey;
+    char acX[NU_CRPT_ECC_MAX_CHARS + 1];
+    char acY[NU_CRPT_ECC_MAX_CHARS + 1];
+    psa_status_t status;
+
+    status = nu_crpt_ecdsa_check(attributes, alg, &curve);
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_ks_ecc_key(attributes, key_buffer, key_buffer_size, &curve, &psKey);
+    if(status == PSA_SUCCESS)
+        status = nu_crpt_ks_public_key(curve, psKey, acX, acY);
+    if(status != PSA_SUCCESS)
+        return status;
+
+    return nu_crpt_ecdsa_verify(curve, acX, acY, hash, hash_length,
+                                signature, signature_length);
+}
+
+#endif /* MBEDTLS_PSA_CRYPTO_C && MBEDTLS_PSA_CRYPTO_DRIVERS && PSA_CRYPTO_DRIVER_NU_CRPT */
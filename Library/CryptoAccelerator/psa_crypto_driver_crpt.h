@@ -0,0 +1,223 @@
+/**
+ * \file psa_crypto_driver_crpt.h
+ *
+ * \brief PSA Crypto accelerator drivers for the M460 CRPT engine.
+ *
+ * Two drivers are declared here and called from the mbedtls-3.1.0 driver
+ * wrappers (library/psa_crypto_driver_wrappers.c) when
+ * PSA_CRYPTO_DRIVER_NU_CRPT and MBEDTLS_PSA_CRYPTO_DRIVERS are defined:
+ *
+ * <ul><li>nu_crpt_transparent_*: keys in PSA local storage. SHA-224/256/384/512
+ * one-shot hashing, AES-ECB/CBC (no padding) and AES-CTR, one-shot AES-GCM
+ * and AES-CCM, ECDSA sign/verify and public key export on
+ * secp256r1/secp384r1, RSA PKCS#1 v1.5 and PSS sign/verify with 1024 to 4096
+ * bit keys in steps of 1024. AES-CCM, and the nonce and additional data of
+ * AES-GCM, must fit the DMA bounce buffer (NU_CRPT_DMA_BUF_SIZE). Anything
+ * else returns PSA_ERROR_NOT_SUPPORTED and falls back to the built-in
+ * implementation.</li>
+ * <li>nu_crpt_opaque_*: keys created with #PSA_CRYPTO_NU_CRPT_KS_LIFETIME live
+ * in Key Store SRAM and never leave it. AES-128/192/256 for the cipher
+ * algorithms above, secp256r1/secp384r1 key pairs for ECDSA.</li></ul>
+ *
+ * The ECC entry points use the StdDriver ECC_* functions, so the application
+ * must enable the CRPT interrupt and call ECC_DriverISR() from
+ * CRPT_IRQHandler(), as in SampleCode/StdDriver/KS_ECDSA. The Key Store must
+ * be clocked; nu_crpt_opaque_init() calls KS_Open(). AES, SHA and RSA
+ * completion is polled, as in aes_alt.c, sha256_alt.c and rsa_alt.c; RSA
+ * works in static buffers of about 7 KB.
+ *
+ * The drivers share the engine with the *_ALT replacements and are not
+ * thread-safe.
+ */
+/*
+ *  Copyright (c) 2023, Nuvoton Technology Corporation
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef PSA_CRYPTO_DRIVER_CRPT_H
+#define PSA_CRYPTO_DRIVER_CRPT_H
+
+#include "psa/crypto.h"
+
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+
+/* Vendor location of keys held in Key Store SRAM. Only volatile keys are
+ * supported: Key Store SRAM does not survive a reset. */
+#define PSA_CRYPTO_NU_CRPT_KS_LOCATION  ((psa_key_location_t) 0x800001)
+#define PSA_CRYPTO_NU_CRPT_KS_LIFETIME                          \
+    PSA_KEY_LIFETIME_FROM_PERSISTENCE_AND_LOCATION(             \
+        PSA_KEY_PERSISTENCE_VOLATILE, PSA_CRYPTO_NU_CRPT_KS_LOCATION )
+
+/* Key buffer of an opaque key: a reference to Key Store SRAM. */
+typedef struct
+{
+    uint32_t u32Magic;      /* NU_CRPT_KS_MAGIC once the key is written */
+    int32_t  i32KeyIdx;     /* Key Store SRAM key number */
+    uint32_t u32Meta;       /* KS_META_xxx the key was written with */
+} nu_crpt_ks_key_t;
+
+psa_status_t nu_crpt_transparent_init( void );
+void nu_crpt_transparent_free( void );
+
+psa_status_t nu_crpt_transparent_hash_compute(
+    psa_algorithm_t alg,
+    const uint8_t *input, size_t input_length,
+    uint8_t *hash, size_t hash_size, size_t *hash_length );
+
+psa_status_t nu_crpt_transparent_cipher_encrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *iv, size_t iv_length,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length );
+
+psa_status_t nu_crpt_transparent_cipher_decrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length );
+
+psa_status_t nu_crpt_transparent_cipher_encrypt_setup(
+    nu_crpt_cipher_operation_t *operation,
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg );
+
+psa_status_t nu_crpt_transparent_cipher_decrypt_setup(
+    nu_crpt_cipher_operation_t *operation,
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg );
+
+/* The multipart cipher entry points below serve both drivers; the operation
+ * remembers where its key lives. */
+psa_status_t nu_crpt_cipher_set_iv(
+    nu_crpt_cipher_operation_t *operation,
+    const uint8_t *iv, size_t iv_length );
+
+psa_status_t nu_crpt_cipher_update(
+    nu_crpt_cipher_operation_t *operation,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length );
+
+psa_status_t nu_crpt_cipher_finish(
+    nu_crpt_cipher_operation_t *operation,
+    uint8_t *output, size_t output_size, size_t *output_length );
+
+psa_status_t nu_crpt_cipher_abort( nu_crpt_cipher_operation_t *operation );
+
+psa_status_t nu_crpt_transparent_aead_encrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *nonce, size_t nonce_length,
+    const uint8_t *additional_data, size_t additional_data_length,
+    const uint8_t *plaintext, size_t plaintext_length,
+    uint8_t *ciphertext, size_t ciphertext_size, size_t *ciphertext_length );
+
+psa_status_t nu_crpt_transparent_aead_decrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *nonce, size_t nonce_length,
+    const uint8_t *additional_data, size_t additional_data_length,
+    const uint8_t *ciphertext, size_t ciphertext_length,
+    uint8_t *plaintext, size_t plaintext_size, size_t *plaintext_length );
+
+psa_status_t nu_crpt_transparent_sign_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    uint8_t *signature, size_t signature_size, size_t *signature_length );
+
+psa_status_t nu_crpt_transparent_verify_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    const uint8_t *signature, size_t signature_length );
+
+psa_status_t nu_crpt_transparent_export_public_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    uint8_t *data, size_t data_size, size_t *data_length );
+
+psa_status_t nu_crpt_opaque_init( void );
+void nu_crpt_opaque_free( void );
+
+size_t nu_crpt_opaque_size_function( psa_key_type_t key_type, size_t key_bits );
+
+psa_status_t nu_crpt_opaque_import_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *data, size_t data_length,
+    uint8_t *key_buffer, size_t key_buffer_size,
+    size_t *key_buffer_length, size_t *bits );
+
+psa_status_t nu_crpt_opaque_generate_key(
+    const psa_key_attributes_t *attributes,
+    uint8_t *key_buffer, size_t key_buffer_size, size_t *key_buffer_length );
+
+psa_status_t nu_crpt_opaque_destroy_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size );
+
+psa_status_t nu_crpt_opaque_export_public_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    uint8_t *data, size_t data_size, size_t *data_length );
+
+psa_status_t nu_crpt_opaque_cipher_encrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *iv, size_t iv_length,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length );
+
+psa_status_t nu_crpt_opaque_cipher_decrypt(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output, size_t output_size, size_t *output_length );
+
+psa_status_t nu_crpt_opaque_cipher_encrypt_setup(
+    nu_crpt_cipher_operation_t *operation,
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg );
+
+psa_status_t nu_crpt_opaque_cipher_decrypt_setup(
+    nu_crpt_cipher_operation_t *operation,
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg );
+
+psa_status_t nu_crpt_opaque_sign_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    uint8_t *signature, size_t signature_size, size_t *signature_length );
+
+psa_status_t nu_crpt_opaque_verify_hash(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size,
+    psa_algorithm_t alg, const uint8_t *hash, size_t hash_length,
+    const uint8_t *signature, size_t signature_length );
+
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
+
+#endif /* PSA_CRYPTO_DRIVER_CRPT_H */
@@ -0,0 +1,72 @@
+/*
+ * NuMicro.h for the host build of the SDH driver.
+ *
+ * Pulls in the real SDH and CLK register layouts. SDH0/SDH1 and the
+ * SD0/SD1 driver state point into the trapping window of sdh_sim.c, the
+ * clock controller is plain memory, and the few SYS, CLK and NVIC calls
+ * sdh.c makes are simulated.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __NUMICRO_H__
+#define __NUMICRO_H__
+
+#include <stdint.h>
+
+#define __I         volatile const
+#define __O         volatile
+#define __IO        volatile
+
+#define TRUE        (1UL)
+#define FALSE       (0UL)
+
+#define __HIRC      (12000000UL)
+
+#include "clk_reg.h"
+#include "sdh_reg.h"
+
+/* Window of sdh_sim.c: SDH0 at +0, SDH1 at +0x1000, SD0/SD1 at +0x2000 */
+extern uint8_t *g_pu8SdhSimRegs;
+#define SDH0        ((SDH_T *)g_pu8SdhSimRegs)
+#define SDH1        ((SDH_T *)(g_pu8SdhSimRegs + 0x1000))
+#define SD0         (*g_psSdhSimSD0)
+#define SD1         (*g_psSdhSimSD1)
+
+extern CLK_T g_sSdhSimClk;
+#define CLK         (&g_sSdhSimClk)
+
+#define CLK_CLKSEL0_SDH0SEL_HXT          (0x0UL << CLK_CLKSEL0_SDH0SEL_Pos)
+#define CLK_CLKSEL0_SDH0SEL_PLL_DIV2     (0x1UL << CLK_CLKSEL0_SDH0SEL_Pos)
+#define CLK_CLKSEL0_SDH0SEL_HCLK         (0x2UL << CLK_CLKSEL0_SDH0SEL_Pos)
+#define CLK_CLKSEL0_SDH0SEL_HIRC         (0x3UL << CLK_CLKSEL0_SDH0SEL_Pos)
+#define CLK_CLKSEL0_SDH1SEL_HXT          (0x0UL << CLK_CLKSEL0_SDH1SEL_Pos)
+#define CLK_CLKSEL0_SDH1SEL_PLL_DIV2     (0x1UL << CLK_CLKSEL0_SDH1SEL_Pos)
+#define CLK_CLKSEL0_SDH1SEL_HCLK         (0x2UL << CLK_CLKSEL0_SDH1SEL_Pos)
+#define CLK_CLKSEL0_SDH1SEL_HIRC         (0x3UL << CLK_CLKSEL0_SDH1SEL_Pos)
+
+uint32_t CLK_GetHXTFreq(void);
+uint32_t CLK_GetPLLClockFreq(void);
+uint32_t CLK_GetHCLKFreq(void);
+
+uint32_t SYS_IsRegLocked(void);
+void SYS_UnlockReg(void);
+void SYS_LockReg(void);
+
+typedef enum
+{
+    SDH0_IRQn = 64,
+    SDH1_IRQn = 90
+} IRQn_Type;
+
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+
+#include "sdh.h"
+
+/* unsigned long is 32 bits on the M460: keep the error codes comparable
+ * with the uint32_t status the driver returns */
+#undef SDH_ERR_FAIL
+#undef SDH_ERR_TIMEOUT
+#define SDH_ERR_FAIL        (-1U)
+#define SDH_ERR_TIMEOUT     (-2U)
+
+#endif /* __NUMICRO_H__ */
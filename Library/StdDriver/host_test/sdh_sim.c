@@ -0,0 +1,1116 @@
+/*
+ * SD host controller and SD card model, simulated time and interrupt
+ * entry for the host test of sdh.c.
+ *
+ * The window g_pu8SdhSimRegs is a PROT_NONE mapping of a memfd that is
+ * also mapped read/write for the model, as in UsbHostLib/host_test. An
+ * access of the driver faults, the SIGSEGV handler opens the page and
+ * sets the trap flag, and SIGTRAP closes it after the one instruction.
+ * Writes to SDH0 are replayed through sdh_write(), so self-clearing
+ * enables, write-1-to-clear status bits and the DMA address counter
+ * behave as on the chip.
+ *
+ * An interrupt is entered from the SIGTRAP handler: the interrupted
+ * context is saved and the handler returns into irq_entry() on the same
+ * stack, below the red zone. irq_entry() runs SDH0_IRQHandler() and
+ * raises SIGUSR1, whose handler puts the saved context back.
+ *
+ * SDH_T::DMASA is 32 bits wide, so the binary is linked non-PIE and
+ * every buffer the driver hands to the DMA is static.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "NuMicro.h"
+#include "sdh_sim.h"
+
+extern void SDH0_IRQHandler(void);
+
+#define PAGE                0x1000
+#define WINDOW_SIZE         (3 * PAGE)
+#define SDH0_PAGE           0
+#define INFO_PAGE           (2 * PAGE)
+
+/* Trapped reads without a write in between that make a polling loop */
+#define POLL_READS          8
+
+/* Wall clock guard against a driver loop the model never ends */
+#define WATCHDOG_S          120
+
+#define SDH_OFF(m)          offsetof(SDH_T, m)
+#define REG(m)              (*(volatile uint32_t *)(s_regs + SDH_OFF(m)))
+
+/* CTL bits the controller clears when it is done */
+#define CTL_BUSY_Msk        (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DIEN_Msk | \
+                             SDH_CTL_DOEN_Msk | SDH_CTL_R2EN_Msk | SDH_CTL_CLK74OEN_Msk | \
+                             SDH_CTL_CLK8OEN_Msk | SDH_CTL_CTLRST_Msk)
+#define INTSTS_W1C_Msk      (SDH_INTSTS_BLKDIF_Msk | SDH_INTSTS_CRCIF_Msk | SDH_INTSTS_CDIF_Msk | \
+                             SDH_INTSTS_RTOIF_Msk | SDH_INTSTS_DITOIF_Msk)
+/* Each source sits at the same bit in INTEN and INTSTS */
+#define IRQ_SRC_Msk         (SDH_INTSTS_BLKDIF_Msk | SDH_INTSTS_CRCIF_Msk | SDH_INTSTS_CDIF_Msk | \
+                             SDH_INTSTS_RTOIF_Msk | SDH_INTSTS_DITOIF_Msk)
+
+/* Card status bits of R1 */
+#define R1_ILLEGAL          (1u << 22)
+#define R1_READY            (1u << 8)
+#define R1_APP_CMD          (1u << 5)
+
+#define NONE                ((uint32_t)-1)
+
+uint8_t *g_pu8SdhSimRegs;                  /* driver view, always trapping */
+/* SDH_INFO_T SD0, SD1 of sdh.c defines g_psSdhSimSD0 and g_psSdhSimSD1 */
+CLK_T g_sSdhSimClk;
+
+static uint8_t *s_regs;                    /* model view */
+static sdh_sim_stats_t s_stats;
+static int s_ready;
+
+static uint64_t s_now, s_idle;
+static int s_nvic, s_in_isr;
+static uint32_t s_poll_reads;
+
+/*---------------------------------------------------------------------------*/
+/* Card                                                                      */
+/*---------------------------------------------------------------------------*/
+
+static struct
+{
+    sdh_sim_card_t cfg;
+    uint8_t *data;
+    int present;
+    int state;
+    int app;                    /* CMD55 came before */
+    uint32_t acmd41;            /* ACMD41 tries, ready on the second */
+    int wide, hs;               /* ACMD6 4-bit bus, CMD6 high speed */
+    uint32_t addr;              /* next sector of a read or write */
+    uint32_t left;              /* blocks left of a read or write, NONE: open ended */
+    uint32_t set_count;         /* CMD23 for the next read or write */
+    uint32_t erase_start, erase_end;
+    uint8_t reg[64];            /* SCR or switch status being read */
+    uint32_t reg_len;
+    uint64_t busy_end;          /* DAT0 held low until then */
+} s_card;
+
+/* Faults, counted down in data blocks */
+static uint32_t s_crc_at = NONE, s_stall_at = NONE;
+
+/*---------------------------------------------------------------------------*/
+/* Controller                                                                */
+/*---------------------------------------------------------------------------*/
+
+static struct
+{
+    uint64_t cmd_t;             /* end of the command, with its response */
+    uint32_t cmd, arg;
+    int resp;                   /* 0 none, 1 48 bits, 2 R2 */
+    int data_after_cmd;         /* DIEN/DOEN came with COEN */
+    uint64_t clk_t;             /* end of CLK74OEN/CLK8OEN */
+    uint64_t data_t;            /* end of the data phase */
+    uint32_t data_cnt;
+    int data_write;
+    int data_crc;               /* block of this phase that fails, NONE */
+    int data_stalled;           /* DIEN/DOEN set, the card never ends it */
+    uint32_t dma;
+    uint64_t remove_t;
+} s_eng;
+
+static void eng_event(void);
+
+static uint32_t bus_khz(void)
+{
+    uint32_t src, div = ((CLK->CLKDIV0 & CLK_CLKDIV0_SDH0DIV_Msk) >> CLK_CLKDIV0_SDH0DIV_Pos) + 1;
+
+    switch(CLK->CLKSEL0 & CLK_CLKSEL0_SDH0SEL_Msk)
+    {
+    case CLK_CLKSEL0_SDH0SEL_PLL_DIV2:
+        src = CLK_GetPLLClockFreq() / 2;
+        break;
+    case CLK_CLKSEL0_SDH0SEL_HCLK:
+        src = CLK_GetHCLKFreq();
+        break;
+    case CLK_CLKSEL0_SDH0SEL_HIRC:
+        src = __HIRC;
+        break;
+    default:
+        src = CLK_GetHXTFreq();
+        break;
+    }
+    return src / div / 1000;
+}
+
+static uint64_t clocks_ns(uint64_t clocks)
+{
+    return clocks * 1000000 / bus_khz();
+}
+
+static int bus_width(void)
+{
+    return (REG(CTL) & SDH_CTL_DBW_Msk) ? 4 : 1;
+}
+
+static uint64_t next_event(void)
+{
+    uint64_t t = 0;
+
+#define EARLIEST(x)     if((x) != 0 && (t == 0 || (x) < t)) t = (x)
+    EARLIEST(s_eng.cmd_t);
+    EARLIEST(s_eng.clk_t);
+    EARLIEST(s_eng.data_t);
+    EARLIEST(s_eng.remove_t);
+    if(s_card.busy_end > s_now)
+        EARLIEST(s_card.busy_end);
+#undef EARLIEST
+    return t;
+}
+
+/* Run the bus up to t */
+static void advance(uint64_t t)
+{
+    uint64_t ev;
+
+    while((ev = next_event()) != 0 && ev <= t)
+    {
+        if(ev > s_now)
+            s_now = ev;
+        eng_event();
+    }
+    if(t > s_now)
+        s_now = t;
+}
+
+static void update_status(void)
+{
+    uint32_t v = REG(INTSTS);
+    int removed = !s_card.present;
+
+    /* GPIO detect: CDSTS set means removed; DAT3 detect: set means inserted */
+    if(!(REG(INTEN) & SDH_INTEN_CDSRC_Msk))
+        removed = !removed;
+    v = removed ? (v | SDH_INTSTS_CDSTS_Msk) : (v & ~SDH_INTSTS_CDSTS_Msk);
+    v = (s_card.busy_end > s_now) ? (v & ~SDH_INTSTS_DAT0STS_Msk) : (v | SDH_INTSTS_DAT0STS_Msk);
+    REG(INTSTS) = v;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Card commands                                                             */
+/*---------------------------------------------------------------------------*/
+
+static void resp48(uint32_t index, uint32_t payload)
+{
+    REG(RESP0) = ((index & 0x3Fu) << 24) | (payload >> 8);
+    REG(RESP1) = payload & 0xFFu;
+}
+
+static uint32_t card_status(void)
+{
+    uint32_t st = ((uint32_t)s_card.state << 9);
+
+    if(s_card.busy_end <= s_now && s_card.state != SDH_SIM_RCV && s_card.state != SDH_SIM_DATA)
+        st |= R1_READY;
+    return st;
+}
+
+/* 136-bit response: start bits, the 128-bit register, as the FIFO holds it */
+static void resp136(const uint8_t reg[16])
+{
+    uint8_t raw[20];
+
+    memset(raw, 0, sizeof(raw));
+    raw[0] = 0x3F;
+    memcpy(raw + 1, reg, 16);
+    memcpy(s_regs + SDH_OFF(FB), raw, sizeof(raw));
+}
+
+static void card_csd(uint8_t csd[16])
+{
+    uint32_t c_size = s_card.cfg.sectors / 1024 - 1;
+
+    memset(csd, 0, 16);
+    csd[0] = 0x40;                      /* CSD version 2.0 */
+    csd[3] = 0x32;                      /* TRAN_SPEED 25 MHz */
+    csd[5] = 0x59;                      /* READ_BL_LEN 512 */
+    csd[7] = (uint8_t)((c_size >> 16) & 0x3F);
+    csd[8] = (uint8_t)(c_size >> 8);
+    csd[9] = (uint8_t)c_size;
+    csd[15] = 0x01;
+}
+
+static void card_reset(void)
+{
+    s_card.state = SDH_SIM_IDLE;
+    s_card.app = 0;
+    s_card.acmd41 = 0;
+    s_card.wide = 0;
+    s_card.hs = 0;
+    s_card.left = 0;
+    s_card.set_count = 0;
+    s_card.reg_len = 0;
+    s_card.busy_end = 0;
+}
+
+static void card_busy(uint64_t ns)
+{
+    s_card.state = SDH_SIM_PRG;
+    s_card.busy_end = s_now + ns;
+}
+
+/* Start a block read or write, with the CMD23 count if one came before */
+static void card_xfer(uint32_t arg, int state, uint32_t blocks)
+{
+    s_card.addr = arg;
+    s_card.left = s_card.set_count ? s_card.set_count : blocks;
+    s_card.set_count = 0;
+    s_card.reg_len = 0;
+    s_card.state = state;
+}
+
+/* Execute a command at the end of its transfer on CMD. Returns 0 if the
+ * card answers, -1 if it stays silent. Commands the state does not allow
+ * are counted and answered with ILLEGAL_COMMAND, so that the driver does
+ * not sit out a time-out for each. */
+static int card_command(uint32_t cmd, uint32_t arg)
+{
+    int app = s_card.app, legal = 1;
+    uint32_t st = card_status();
+    uint8_t reg[16];
+
+    if(!s_card.present)
+        return -1;
+    s_card.app = 0;
+    if(app)
+        s_stats.acmd[cmd & 63]++;
+    else
+        s_stats.cmd[cmd & 63]++;
+
+    if(app && cmd == 41)
+    {
+        /* R3: OCR, busy bit set once powered up, CCS for SDHC */
+        if(s_card.state != SDH_SIM_IDLE && s_card.state != SDH_SIM_READY)
+            legal = 0;
+        else if(++s_card.acmd41 >= 2)
+        {
+            s_card.state = SDH_SIM_READY;
+            resp48(0x3F, 0xC0FF8000u);
+            return 0;
+        }
+        resp48(0x3F, 0x00FF8000u);
+        return 0;
+    }
+    if(app && cmd == 6)
+    {
+        if(s_card.state != SDH_SIM_TRAN || (arg & 3) == 1 || (arg & 3) == 3)
+            legal = 0;
+        else
+            s_card.wide = (arg & 3) == 2;
+        resp48(cmd, st | R1_APP_CMD | (legal ? 0 : R1_ILLEGAL));
+        if(!legal)
+            s_stats.illegal++;
+        return 0;
+    }
+    if(app && cmd == 51)
+    {
+        if(s_card.state != SDH_SIM_TRAN)
+            legal = 0;
+        else
+        {
+            memset(s_card.reg, 0, 8);
+            s_card.reg[0] = 0x02;               /* SD_SPEC 2.00 */
+            s_card.reg[1] = 0x35;               /* 1 and 4-bit bus */
+            s_card.reg[2] = 0x80;
+            s_card.reg[3] = s_card.cfg.cmd23 ? 0x02 : 0x00;
+            s_card.reg_len = 8;
+            s_card.state = SDH_SIM_DATA;
+        }
+        resp48(cmd, st | R1_APP_CMD | (legal ? 0 : R1_ILLEGAL));
+        if(!legal)
+            s_stats.illegal++;
+        return 0;
+    }
+
+    switch(cmd)
+    {
+    case 0:
+        card_reset();
+        return -1;
+    case 8:
+        if(s_card.state != SDH_SIM_IDLE)
+            return -1;
+        resp48(cmd, arg & 0xFFFu);
+        return 0;
+    case 55:
+        s_card.app = 1;
+        if(s_card.state != SDH_SIM_IDLE && (arg >> 16) != SDH_SIM_RCA)
+            legal = 0;
+        resp48(cmd, st | R1_APP_CMD);
+        break;
+    case 2:
+        if(s_card.state != SDH_SIM_READY)
+            return -1;
+        memset(reg, 0, sizeof(reg));
+        memcpy(reg, "\x03SDSIM01", 8);
+        reg[15] = 0x01;
+        resp136(reg);
+        s_card.state = SDH_SIM_IDENT;
+        return 0;
+    case 3:
+        if(s_card.state != SDH_SIM_IDENT && s_card.state != SDH_SIM_STBY)
+            return -1;
+        s_card.state = SDH_SIM_STBY;
+        resp48(cmd, (SDH_SIM_RCA << 16) | (card_status() & 0x1FFFu));
+        return 0;
+    case 9:
+        if(s_card.state != SDH_SIM_STBY)
+            return -1;
+        card_csd(reg);
+        resp136(reg);
+        return 0;
+    case 7:
+        if((arg >> 16) == SDH_SIM_RCA)
+        {
+            s_stats.selects++;
+            if(s_card.state == SDH_SIM_STBY)
+                s_card.state = SDH_SIM_TRAN;
+            else if(s_card.state == SDH_SIM_DIS)
+                s_card.state = SDH_SIM_PRG;
+            else
+                legal = 0;
+            resp48(cmd, st | (legal ? 0 : R1_ILLEGAL));
+            break;
+        }
+        /* addressed to another card: deselect, no answer */
+        s_stats.deselects++;
+        if(s_card.state == SDH_SIM_TRAN)
+            s_card.state = SDH_SIM_STBY;
+        else if(s_card.state == SDH_SIM_PRG)
+            s_card.state = SDH_SIM_DIS;
+        else if(s_card.state != SDH_SIM_STBY)
+        {
+            s_stats.illegal++;
+        }
+        return -1;
+    case 6:
+        if(s_card.state != SDH_SIM_TRAN)
+        {
+            legal = 0;
+        }
+        else
+        {
+            /* switch status: 200 mA, high speed supported, not busy */
+            memset(s_card.reg, 0, 64);
+            s_card.reg[1] = 0xC8;
+            s_card.reg[13] = 0x03;
+            s_card.reg[16] = (arg & 0x80000000u) ? 0x01 : 0x00;
+            if(arg & 0x80000000u)
+                s_card.hs = (arg & 0xF) == 1;
+            s_card.reg_len = 64;
+            s_card.state = SDH_SIM_DATA;
+        }
+        resp48(cmd, st | (legal ? 0 : R1_ILLEGAL));
+        break;
+    case 16:
+        if(s_card.state != SDH_SIM_TRAN || arg != 512)
+            legal = 0;
+        resp48(cmd, st | (legal ? 0 : R1_ILLEGAL));
+        break;
+    case 23:
+        if(s_card.state != SDH_SIM_TRAN || arg == 0)
+            legal = 0;
+        else
+            s_card.set_count = arg & 0xFFFFu;
+        resp48(cmd, st | (legal ? 0 : R1_ILLEGAL));
+        break;
+    case 17:
+    case 18:
+    case 24:
+    case 25:
+        if(s_card.state != SDH_SIM_TRAN || arg >= s_card.cfg.sectors)
+            legal = 0;
+        else if(cmd == 17 || cmd == 24)
+        {
+            s_card.set_count = 0;
+            card_xfer(arg, (cmd == 17) ? SDH_SIM_DATA : SDH_SIM_RCV, 1);
+        }
+        else
+            card_xfer(arg, (cmd == 18) ? SDH_SIM_DATA : SDH_SIM_RCV, NONE);
+        resp48(cmd, st | (legal ? 0 : R1_ILLEGAL));
+        break;
+    case 12:
+        if(s_card.state == SDH_SIM_DATA)
+            s_card.state = SDH_SIM_TRAN;
+        else if(s_card.state == SDH_SIM_RCV)
+            card_busy(SDH_SIM_PROG_END_NS);
+        else
+            legal = 0;
+        s_card.left = 0;
+        resp48(cmd, st | (legal ? 0 : R1_ILLEGAL));
+        break;
+    case 32:
+    case 33:
+        if(s_card.state != SDH_SIM_TRAN || arg >= s_card.cfg.sectors)
+            legal = 0;
+        else if(cmd == 32)
+            s_card.erase_start = arg;
+        else
+            s_card.erase_end = arg;
+        resp48(cmd, st | (legal ? 0 : R1_ILLEGAL));
+        break;
+    case 38:
+        if(s_card.state != SDH_SIM_TRAN || s_card.erase_end < s_card.erase_start)
+            legal = 0;
+        else
+        {
+            memset(s_card.data + (size_t)s_card.erase_start * 512, 0,
+                   (size_t)(s_card.erase_end - s_card.erase_start + 1) * 512);
+            card_busy(SDH_SIM_ERASE_NS);
+        }
+        resp48(cmd, st | (legal ? 0 : R1_ILLEGAL));
+        break;
+    case 13:
+        resp48(cmd, st);
+        break;
+    default:
+        legal = 0;
+        resp48(cmd, st | R1_ILLEGAL);
+        break;
+    }
+
+    if(!legal)
+        s_stats.illegal++;
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Controller phases                                                         */
+/*---------------------------------------------------------------------------*/
+
+static uint32_t block_len(void)
+{
+    return (REG(BLEN) & SDH_BLEN_BLKLEN_Msk) + 1;
+}
+
+static void data_start(int write)
+{
+    uint32_t cnt = (REG(CTL) & SDH_CTL_BLKCNT_Msk) >> SDH_CTL_BLKCNT_Pos;
+    uint32_t len = block_len(), i, have;
+    uint64_t block, t;
+    int first = s_eng.data_after_cmd;
+
+    if(cnt == 0)
+        cnt = 256;
+    s_eng.data_write = write;
+    s_eng.data_cnt = cnt;
+    s_eng.data_crc = -1;
+    s_eng.data_stalled = 0;
+    s_eng.data_after_cmd = 0;
+    s_stats.chunks++;
+    if(s_stats.chunks <= 16)
+        s_stats.chunk_log[s_stats.chunks - 1] = cnt;
+
+    if(bus_width() != (s_card.wide ? 4 : 1))
+        s_stats.illegal++;
+
+    /* what the card has to give or take */
+    if(!s_card.present)
+        have = 0;
+    else if(s_card.state == (write ? SDH_SIM_RCV : SDH_SIM_DATA))
+        have = s_card.reg_len ? 1 : s_card.left;
+    else
+        have = 0;
+
+    for(i = 0; i < cnt; i++)
+    {
+        if(s_stall_at != NONE && s_stall_at-- == 0)
+            have = i < have ? i : have;
+        if(s_crc_at != NONE && s_crc_at-- == 0 && s_eng.data_crc < 0)
+            s_eng.data_crc = (int)i;
+    }
+    if(have < cnt)
+    {
+        s_stats.stalls += s_card.present ? 1 : 0;
+        s_eng.data_stalled = 1;
+        s_eng.data_t = 0;
+        return;
+    }
+
+    block = clocks_ns((uint64_t)len * 8 / (uint32_t)bus_width() + 16 + 2 + (write ? 8 : 0));
+    t = s_now + (first && !write ? SDH_SIM_NAC_FIRST_NS : SDH_SIM_NAC_NEXT_NS);
+    t += cnt * block + (cnt - 1) * (write ? SDH_SIM_PROG_BLOCK_NS : SDH_SIM_NAC_NEXT_NS);
+    if(write)
+        t += SDH_SIM_PROG_BLOCK_NS;
+    s_eng.data_t = t;
+}
+
+static void data_end(void)
+{
+    uint32_t len = block_len(), i, cnt = s_eng.data_cnt;
+    uint8_t *dma = (uint8_t *)(uintptr_t)s_eng.dma;
+    uint32_t v;
+
+    s_eng.data_t = 0;
+    for(i = 0; i < cnt; i++, dma += len)
+    {
+        if(s_eng.data_write)
+        {
+            /* a block with a bad CRC is not taken, nor anything after it */
+            if(s_eng.data_crc < 0 || (int)i < s_eng.data_crc)
+            {
+                memcpy(s_card.data + (size_t)s_card.addr * 512, dma, len);
+                s_stats.blocks_out++;
+            }
+            s_card.addr++;
+        }
+        else if(s_card.reg_len)
+        {
+            memcpy(dma, s_card.reg, len < s_card.reg_len ? len : s_card.reg_len);
+            s_card.reg_len = 0;
+        }
+        else
+        {
+            memcpy(dma, s_card.data + (size_t)s_card.addr * 512, len);
+            s_card.addr++;
+            s_stats.blocks_in++;
+        }
+        if(s_card.left != NONE && s_card.left > 0)
+            s_card.left--;
+    }
+    s_eng.dma += cnt * len;
+    REG(DMASA) = s_eng.dma;
+
+    /* a counted or single block transfer ends by itself */
+    if(s_card.left == 0)
+    {
+        if(s_card.state == SDH_SIM_DATA)
+            s_card.state = SDH_SIM_TRAN;
+        else if(s_card.state == SDH_SIM_RCV)
+            card_busy(SDH_SIM_PROG_END_NS);
+    }
+
+    v = REG(INTSTS) | SDH_INTSTS_BLKDIF_Msk;
+    if(s_eng.data_crc >= 0)
+    {
+        s_stats.crc_errors++;
+        v |= SDH_INTSTS_CRCIF_Msk;
+        if(!s_eng.data_write)
+            v &= ~SDH_INTSTS_CRC16_Msk;
+    }
+    else if(!s_eng.data_write)
+    {
+        v |= SDH_INTSTS_CRC16_Msk;
+    }
+    REG(INTSTS) = v;
+    REG(CTL) &= ~(s_eng.data_write ? SDH_CTL_DOEN_Msk : SDH_CTL_DIEN_Msk);
+}
+
+static void cmd_end(void)
+{
+    uint32_t v = REG(INTSTS), cmd = s_eng.cmd, app = s_card.app;
+    int ok;
+
+    s_eng.cmd_t = 0;
+    ok = card_command(cmd, s_eng.arg);
+    if(s_eng.resp == 0)
+    {
+        REG(CTL) &= ~SDH_CTL_COEN_Msk;
+    }
+    else if(ok == 0)
+    {
+        /* R3 carries no CRC: the controller flags it anyway */
+        if(app && cmd == 41)
+            v = (v & ~SDH_INTSTS_CRC7_Msk) | SDH_INTSTS_CRCIF_Msk;
+        else
+            v |= SDH_INTSTS_CRC7_Msk;
+        REG(INTSTS) = v;
+        REG(CTL) &= ~(SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_R2EN_Msk);
+    }
+    else
+    {
+        /* no response, and no hardware time-out with TOUT at 0 */
+        REG(CTL) &= ~SDH_CTL_COEN_Msk;
+        s_eng.data_after_cmd = 0;
+        return;
+    }
+
+    if(s_eng.data_after_cmd)
+    {
+        if(REG(CTL) & SDH_CTL_DIEN_Msk)
+            data_start(0);
+        else if(REG(CTL) & SDH_CTL_DOEN_Msk)
+            data_start(1);
+    }
+}
+
+static void card_removed(void)
+{
+    s_eng.remove_t = 0;
+    s_card.present = 0;
+    s_card.busy_end = 0;
+    /* what is on the bus never ends */
+    if(s_eng.cmd_t)
+    {
+        s_eng.cmd_t = 0;
+        REG(CTL) &= ~SDH_CTL_COEN_Msk;
+    }
+    if(s_eng.data_t)
+    {
+        s_eng.data_t = 0;
+        s_eng.data_stalled = 1;
+    }
+    REG(INTSTS) |= SDH_INTSTS_CDIF_Msk;
+}
+
+/* Everything due at s_now */
+static void eng_event(void)
+{
+    if(s_eng.remove_t && s_eng.remove_t <= s_now)
+        card_removed();
+    if(s_eng.cmd_t && s_eng.cmd_t <= s_now)
+        cmd_end();
+    if(s_eng.clk_t && s_eng.clk_t <= s_now)
+    {
+        s_eng.clk_t = 0;
+        REG(CTL) &= ~(SDH_CTL_CLK74OEN_Msk | SDH_CTL_CLK8OEN_Msk);
+    }
+    if(s_eng.data_t && s_eng.data_t <= s_now)
+        data_end();
+    if(s_card.busy_end && s_card.busy_end <= s_now)
+    {
+        s_card.busy_end = 0;
+        if(s_card.state == SDH_SIM_PRG)
+            s_card.state = SDH_SIM_TRAN;
+        else if(s_card.state == SDH_SIM_DIS)
+            s_card.state = SDH_SIM_STBY;
+    }
+    update_status();
+}
+
+static void ctl_reset(void)
+{
+    s_stats.ctl_resets++;
+    s_eng.cmd_t = 0;
+    s_eng.clk_t = 0;
+    s_eng.data_t = 0;
+    s_eng.data_after_cmd = 0;
+    s_eng.data_stalled = 0;
+    REG(CTL) &= ~CTL_BUSY_Msk;
+}
+
+static void ctl_write(uint32_t old, uint32_t v)
+{
+    uint32_t rise = v & ~old & CTL_BUSY_Msk;
+
+    /* the enables stay as the controller has them, software only sets them */
+    REG(CTL) = (v & ~CTL_BUSY_Msk) | (old & CTL_BUSY_Msk) | rise;
+    if(v & SDH_CTL_CTLRST_Msk)
+    {
+        ctl_reset();
+        return;
+    }
+
+    if(rise & (SDH_CTL_CLK74OEN_Msk | SDH_CTL_CLK8OEN_Msk))
+        s_eng.clk_t = s_now + clocks_ns((rise & SDH_CTL_CLK74OEN_Msk) ? 74 : 8);
+
+    if(rise & SDH_CTL_COEN_Msk)
+    {
+        s_eng.cmd = (v & SDH_CTL_CMDCODE_Msk) >> SDH_CTL_CMDCODE_Pos;
+        s_eng.arg = REG(CMDARG);
+        s_eng.resp = (rise & SDH_CTL_R2EN_Msk) ? 2 : (rise & SDH_CTL_RIEN_Msk) ? 1 : 0;
+        s_eng.cmd_t = s_now + clocks_ns(48 + (s_eng.resp ? 2 + (s_eng.resp == 2 ? 136 : 48) : 0));
+        s_eng.data_after_cmd = (rise & (SDH_CTL_DIEN_Msk | SDH_CTL_DOEN_Msk)) != 0;
+        return;
+    }
+    if(rise & SDH_CTL_DIEN_Msk)
+        data_start(0);
+    else if(rise & SDH_CTL_DOEN_Msk)
+        data_start(1);
+}
+
+static void sdh_write(uint32_t off, uint32_t old, uint32_t v)
+{
+    s_stats.reg_writes++;
+    switch(off)
+    {
+    case SDH_OFF(CTL):
+        ctl_write(old, v);
+        break;
+    case SDH_OFF(INTSTS):
+        REG(INTSTS) = old & ~(v & INTSTS_W1C_Msk);
+        break;
+    case SDH_OFF(DMACTL):
+        REG(DMACTL) = v & ~SDH_DMACTL_DMARST_Msk;
+        break;
+    case SDH_OFF(DMASA):
+        REG(DMASA) = v;
+        s_eng.dma = v;
+        break;
+    case SDH_OFF(GCTL):
+        REG(GCTL) = v & ~SDH_GCTL_GCTLRST_Msk;
+        if(v & SDH_GCTL_GCTLRST_Msk)
+            ctl_reset();
+        break;
+    case SDH_OFF(GINTSTS):
+        REG(GINTSTS) = old & ~v;
+        break;
+    case SDH_OFF(RESP0):
+    case SDH_OFF(RESP1):
+    case SDH_OFF(DMABCNT):
+        /* read only */
+        break;
+    default:
+        *(volatile uint32_t *)(s_regs + off) = v;
+        break;
+    }
+    update_status();
+}
+
+/*---------------------------------------------------------------------------*/
+/* Interrupts and idle time                                                  */
+/*---------------------------------------------------------------------------*/
+
+static int irq_pending(void)
+{
+    return s_nvic && !s_in_isr && (REG(INTSTS) & REG(INTEN) & IRQ_SRC_Msk) != 0;
+}
+
+static void run_irq(void)
+{
+    int n = 0;
+
+    s_in_isr = 1;
+    do
+    {
+        advance(s_now + SDH_SIM_IRQ_NS);
+        s_stats.irqs++;
+        SDH0_IRQHandler();
+        s_in_isr = 0;
+        if(!irq_pending())
+            break;
+        s_in_isr = 1;
+    }
+    while(++n < 8);
+    s_in_isr = 0;
+}
+
+int sdh_sim_wfi(void)
+{
+    uint64_t t, t0 = s_now;
+
+    while(!irq_pending())
+    {
+        if((t = next_event()) == 0)
+            return -1;
+        advance(t);
+    }
+    s_idle += s_now - t0;
+    run_irq();
+    return 0;
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    if(IRQn == SDH0_IRQn)
+        s_nvic = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Register traps                                                            */
+/*---------------------------------------------------------------------------*/
+
+static uint8_t s_snap[PAGE];
+static uint32_t s_trap_page, s_trap_off;
+static int s_trap_write;
+
+static gregset_t s_irq_gregs;
+static struct _libc_fpstate s_irq_fp;
+
+static void irq_entry(void)
+{
+    run_irq();
+    raise(SIGUSR1);
+    abort();
+}
+
+/* back from irq_entry() into the interrupted instruction stream */
+static void on_irq_return(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+
+    memcpy(uc->uc_mcontext.gregs, s_irq_gregs, sizeof(s_irq_gregs));
+    memcpy(uc->uc_mcontext.fpregs, &s_irq_fp, sizeof(s_irq_fp));
+}
+
+static void on_segv(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uint8_t *a = si->si_addr;
+    uint64_t t;
+
+    if(a < g_pu8SdhSimRegs || a >= g_pu8SdhSimRegs + WINDOW_SIZE)
+    {
+        /* a real crash: let it happen with the default action */
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+    s_trap_off = (uint32_t)(a - g_pu8SdhSimRegs) & ~3u;
+    s_trap_page = s_trap_off & ~(PAGE - 1);
+    s_trap_write = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+
+    advance(s_now + SDH_SIM_ACCESS_NS);
+    if(s_trap_write)
+    {
+        s_poll_reads = 0;
+    }
+    else
+    {
+        if(s_trap_page == SDH0_PAGE)
+            s_stats.reg_reads++;
+        /* a loop waiting on the bus: on to whatever happens next */
+        if(++s_poll_reads >= POLL_READS && !s_in_isr && (t = next_event()) != 0)
+        {
+            s_poll_reads = 0;
+            advance(t);
+        }
+    }
+
+    memcpy(s_snap, s_regs + s_trap_page, PAGE);
+    mprotect(g_pu8SdhSimRegs + s_trap_page, PAGE, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= 0x100;
+}
+
+static void on_trap(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uint32_t *cur = (uint32_t *)(s_regs + s_trap_page), *old = (uint32_t *)s_snap;
+    uint32_t val[PAGE / 4], idx[PAGE / 4];
+    uint32_t i, n = 0;
+    greg_t sp;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+    mprotect(g_pu8SdhSimRegs + s_trap_page, PAGE, PROT_NONE);
+
+    if(s_trap_write && s_trap_page == SDH0_PAGE)
+    {
+        /* Collect what the instruction stored before replaying any of it.
+         * The faulting word always counts, even if the value did not
+         * change. */
+        for(i = 0; i < PAGE / 4; i++)
+        {
+            if(s_trap_page + i * 4 != s_trap_off && cur[i] == old[i])
+                continue;
+            idx[n] = i;
+            val[n++] = cur[i];
+            cur[i] = old[i];
+        }
+        for(i = 0; i < n; i++)
+            sdh_write(idx[i] * 4, old[idx[i]], val[i]);
+    }
+
+    if(!irq_pending())
+        return;
+
+    /* exception entry: run irq_entry() on the interrupted stack */
+    memcpy(s_irq_gregs, uc->uc_mcontext.gregs, sizeof(s_irq_gregs));
+    memcpy(&s_irq_fp, uc->uc_mcontext.fpregs, sizeof(s_irq_fp));
+    sp = (uc->uc_mcontext.gregs[REG_RSP] - 128 - 256) & ~(greg_t)15;
+    sp -= 8;
+    *(uint64_t *)sp = 0;
+    uc->uc_mcontext.gregs[REG_RSP] = sp;
+    uc->uc_mcontext.gregs[REG_RIP] = (greg_t)(uintptr_t)irq_entry;
+    uc->uc_mcontext.gregs[REG_EFL] &= ~0x400;
+}
+
+static void on_alarm(int sig)
+{
+    static const char msg[] = "sdh_sim: watchdog, the driver spins on something the model never ends\n";
+
+    (void)write(2, msg, sizeof(msg) - 1);
+    _exit(3);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Setup and test hooks                                                      */
+/*---------------------------------------------------------------------------*/
+
+static void sim_traps(void)
+{
+    struct sigaction sa;
+    int fd;
+
+    fd = memfd_create("sdh_regs", 0);
+    if(fd < 0 || ftruncate(fd, WINDOW_SIZE) < 0)
+    {
+        perror("sdh_sim: memfd");
+        exit(2);
+    }
+    g_pu8SdhSimRegs = mmap(NULL, WINDOW_SIZE, PROT_NONE, MAP_SHARED, fd, 0);
+    s_regs = mmap(NULL, WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(g_pu8SdhSimRegs == MAP_FAILED || s_regs == MAP_FAILED)
+    {
+        perror("sdh_sim: mmap");
+        exit(2);
+    }
+    g_psSdhSimSD0 = (SDH_INFO_T *)(g_pu8SdhSimRegs + INFO_PAGE);
+    g_psSdhSimSD1 = (SDH_INFO_T *)(g_pu8SdhSimRegs + INFO_PAGE + PAGE / 2);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = on_segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = on_trap;
+    sigaction(SIGTRAP, &sa, NULL);
+    sa.sa_sigaction = on_irq_return;
+    sigaction(SIGUSR1, &sa, NULL);
+    signal(SIGALRM, on_alarm);
+    alarm(WATCHDOG_S);
+}
+
+void sdh_sim_init(const sdh_sim_card_t *card)
+{
+    uint32_t i;
+
+    if(!s_ready)
+    {
+        sim_traps();
+        s_ready = 1;
+    }
+
+    free(s_card.data);
+    memset(&s_card, 0, sizeof(s_card));
+    memset(&s_eng, 0, sizeof(s_eng));
+    memset(s_regs, 0, WINDOW_SIZE);
+    s_crc_at = NONE;
+    s_stall_at = NONE;
+    s_nvic = 0;
+
+    s_card.cfg = *card;
+    s_card.data = malloc((size_t)card->sectors * 512);
+    if(s_card.data == NULL)
+    {
+        perror("sdh_sim: card");
+        exit(2);
+    }
+    for(i = 0; i < card->sectors * 512; i++)
+        s_card.data[i] = (uint8_t)((i >> 9) * 7 + (i & 511) * 13 + (i >> 17));
+    card_reset();
+    s_card.present = 1;
+
+    /* SDH0 on HCLK/4 as in SampleCode/StdDriver/SDH_FATFS */
+    memset(&g_sSdhSimClk, 0, sizeof(g_sSdhSimClk));
+    g_sSdhSimClk.CLKSEL0 = CLK_CLKSEL0_SDH0SEL_HCLK;
+    g_sSdhSimClk.CLKDIV0 = 3u << CLK_CLKDIV0_SDH0DIV_Pos;
+    REG(INTSTS) = SDH_INTSTS_CRC7_Msk | SDH_INTSTS_CRC16_Msk | SDH_INTSTS_DAT0STS_Msk;
+    update_status();
+}
+
+void sdh_sim_remove(uint64_t delay_ns)
+{
+    if(delay_ns == 0)
+    {
+        card_removed();
+        update_status();
+    }
+    else
+    {
+        s_eng.remove_t = s_now + delay_ns;
+    }
+}
+
+void sdh_sim_insert(void)
+{
+    s_eng.remove_t = 0;
+    card_reset();
+    s_card.present = 1;
+    REG(INTSTS) |= SDH_INTSTS_CDIF_Msk;
+    update_status();
+}
+
+void sdh_sim_crc_error(uint32_t count)
+{
+    s_crc_at = count;
+}
+
+void sdh_sim_stall(uint32_t count)
+{
+    s_stall_at = count;
+}
+
+uint64_t sdh_sim_time_ns(void)
+{
+    return s_now;
+}
+
+uint64_t sdh_sim_idle_ns(void)
+{
+    return s_idle;
+}
+
+int sdh_sim_card_state(void)
+{
+    return s_card.present ? s_card.state : -1;
+}
+
+int sdh_sim_bus_width(void)
+{
+    return bus_width();
+}
+
+uint32_t sdh_sim_bus_khz(void)
+{
+    return bus_khz();
+}
+
+uint8_t *sdh_sim_card_data(void)
+{
+    return s_card.data;
+}
+
+const sdh_sim_stats_t *sdh_sim_stats(void)
+{
+    return &s_stats;
+}
+
+void sdh_sim_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+/*---------------------------------------------------------------------------*/
+/* SYS and CLK calls of sdh.c                                                */
+/*---------------------------------------------------------------------------*/
+
+uint32_t CLK_GetHXTFreq(void)
+{
+    return 12000000ul;
+}
+
+uint32_t CLK_GetPLLClockFreq(void)
+{
+    return 200000000ul;
+}
+
+uint32_t CLK_GetHCLKFreq(void)
+{
+    return SDH_SIM_HCLK;
+}
+
+uint32_t SYS_IsRegLocked(void)
+{
+    return 0;
+}
+
+void SYS_UnlockReg(void)
+{
+}
+
+void SYS_LockReg(void)
+{
+}
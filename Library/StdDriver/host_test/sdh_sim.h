@@ -0,0 +1,112 @@
+/*
+ * Register level model of the M460 SD host controller and an SD card.
+ *
+ * SDH0 and the SD0/SD1 driver state live in pages sdh.c cannot touch
+ * directly. Every access traps and is single-stepped; writes to SDH0 are
+ * replayed through the controller model, so sdh.c runs unmodified and
+ * its own polling loops drive the simulation. SD0/SD1 trap as well,
+ * because SDH_Read() waits on DataReadyFlag, which only the interrupt
+ * handler sets.
+ *
+ * SDH0_IRQHandler() of the test is entered between two trapped accesses,
+ * the way the NVIC would enter it between two instructions, whenever
+ * INTSTS & INTEN has a pending source. The card is a state machine of
+ * the SD physical layer spec: commands it does not take in its current
+ * state are counted as illegal instead of being answered.
+ *
+ * Time is simulated. A trapped access costs SDH_SIM_ACCESS_NS of CPU
+ * time; a loop polling the same state with no write in between is moved
+ * on to the next bus event. Only sdh_sim_wfi() is idle time, everything
+ * else counts as CPU busy.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef SDH_SIM_H
+#define SDH_SIM_H
+
+#include <stdint.h>
+
+/* CPU: HCLK 200 MHz, a trapped register access with the loop around it,
+ * and the exception entry and exit of one interrupt */
+#define SDH_SIM_HCLK            200000000ul
+#define SDH_SIM_ACCESS_NS       20
+#define SDH_SIM_IRQ_NS          150
+
+/* Card: read access time of the first block and between blocks, busy
+ * time per written block and after the last one, erase time */
+#define SDH_SIM_NAC_FIRST_NS    50000
+#define SDH_SIM_NAC_NEXT_NS     1000
+#define SDH_SIM_PROG_BLOCK_NS   5000
+#define SDH_SIM_PROG_END_NS     250000
+#define SDH_SIM_ERASE_NS        1000000
+
+#define SDH_SIM_RCA             0x1234u
+
+/* Card states, CURRENT_STATE of the card status */
+enum
+{
+    SDH_SIM_IDLE,
+    SDH_SIM_READY,
+    SDH_SIM_IDENT,
+    SDH_SIM_STBY,
+    SDH_SIM_TRAN,
+    SDH_SIM_DATA,
+    SDH_SIM_RCV,
+    SDH_SIM_PRG,
+    SDH_SIM_DIS
+};
+
+typedef struct
+{
+    uint32_t sectors;           /* capacity, a multiple of 1024 */
+    int cmd23;                  /* SCR CMD_SUPPORT: SET_BLOCK_COUNT */
+} sdh_sim_card_t;
+
+typedef struct
+{
+    uint32_t cmd[64];           /* commands the card executed */
+    uint32_t acmd[64];          /* application commands */
+    uint32_t selects;           /* CMD7 with the card's RCA */
+    uint32_t deselects;         /* CMD7 with another RCA */
+    uint32_t illegal;           /* commands the card state does not allow */
+    uint32_t chunks;            /* data phases started by DIEN/DOEN */
+    uint32_t chunk_log[16];     /* BLKCNT of the first 16 of them */
+    uint32_t blocks_in, blocks_out;     /* 512 byte blocks read and written */
+    uint32_t crc_errors;        /* injected by sdh_sim_crc_error() */
+    uint32_t stalls;            /* data phases that never end */
+    uint32_t ctl_resets;        /* CTL[CTLRST] */
+    uint32_t irqs;              /* SDH0_IRQHandler entries */
+    uint64_t reg_reads, reg_writes;
+} sdh_sim_stats_t;
+
+/* Set up the traps and put a fresh card in the slot */
+void sdh_sim_init(const sdh_sim_card_t *card);
+
+/* Sleep until the next interrupt and run its handler. Returns -1 if
+ * nothing is pending on the bus that could ever raise one. */
+int sdh_sim_wfi(void);
+
+/* The card detect pin: a removed card stops answering at once, an
+ * inserted one is powered up in idle state. delay_ns lets it happen in
+ * the middle of a driver call. */
+void sdh_sim_remove(uint64_t delay_ns);
+void sdh_sim_insert(void);
+
+/* The count-th data block from now, 0 based, fails its CRC. Once;
+ * (uint32_t)-1 takes it back. */
+void sdh_sim_crc_error(uint32_t count);
+/* The data phase that would carry the count-th block from now never ends,
+ * until CTL[CTLRST]. Once; (uint32_t)-1 takes it back. */
+void sdh_sim_stall(uint32_t count);
+
+uint64_t sdh_sim_time_ns(void);
+uint64_t sdh_sim_idle_ns(void);
+int sdh_sim_card_state(void);
+int sdh_sim_bus_width(void);
+uint32_t sdh_sim_bus_khz(void);
+uint8_t *sdh_sim_card_data(void);
+
+const sdh_sim_stats_t *sdh_sim_stats(void);
+void sdh_sim_reset_stats(void);
+
+#endif /* SDH_SIM_H */
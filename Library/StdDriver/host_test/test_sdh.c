@@ -0,0 +1,493 @@
+/*
+ * SDH driver tests on the register model of sdh_sim.c.
+ *
+ * src/sdh.c runs unchanged against SDH0 and an SDHC card, once with CMD23
+ * (SET_BLOCK_COUNT) in its SCR and once without. The card keeps count of
+ * every command, so the tests check what went over the bus, not only what
+ * the driver returned: CMD23 instead of CMD12, one CMD7 for many calls,
+ * the 255-block chunks of a long transfer started from SDH_XferPoll and
+ * from SDH_AsyncIRQHandler, the deselect after an error, the engine reset
+ * after a time-out, and the state left behind by a removed card.
+ *
+ * SDH0_IRQHandler() is the one of SampleCode/StdDriver/SDH_FATFS without
+ * its console output, and without the memset of SD0 on card removal, so
+ * that the driver has to clean up after a removal itself.
+ *
+ * The throughput and CPU figures are simulated time, not a measurement on
+ * the M460.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "NuMicro.h"
+#include "sdh_sim.h"
+
+#define CARD_SECTORS    32768u
+#define BENCH_BYTES     (10u * 1024 * 1024)
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+/* DMA buffers: SDH_T::DMASA is 32 bits, static data of a non-PIE build fits */
+static uint8_t s_au8Buf[600 * 512] __attribute__((aligned(4)));
+static uint8_t s_au8Src[600 * 512] __attribute__((aligned(4)));
+
+static const sdh_sim_card_t s_card_cmd23 = { CARD_SECTORS, 1 };
+static const sdh_sim_card_t s_card_cmd12 = { CARD_SECTORS, 0 };
+
+/* Completion callback */
+static volatile int s_cb_count;
+static volatile uint32_t s_cb_status;
+static SDH_T *volatile s_cb_sdh;
+static void *volatile s_cb_arg;
+
+static void on_done(SDH_T *sdh, uint32_t u32Status, void *pvArg)
+{
+    s_cb_count++;
+    s_cb_status = u32Status;
+    s_cb_sdh = sdh;
+    s_cb_arg = pvArg;
+}
+
+void SDH0_IRQHandler(void)
+{
+    unsigned int volatile isr;
+    unsigned int volatile ier;
+
+    // FMI data abort interrupt
+    if(SDH0->GINTSTS & SDH_GINTSTS_DTAIF_Msk)
+    {
+        /* ResetAllEngine() */
+        SDH0->GCTL |= SDH_GCTL_GCTLRST_Msk;
+    }
+
+    //----- SD interrupt status
+    isr = SDH0->INTSTS;
+    ier = SDH0->INTEN;
+
+    if(isr & SDH_INTSTS_BLKDIF_Msk)
+    {
+        // block down
+        SD0.DataReadyFlag = TRUE;
+        SDH0->INTSTS = SDH_INTSTS_BLKDIF_Msk;
+        // next chunk or end of SDH_ReadAsync/SDH_WriteAsync
+        SDH_AsyncIRQHandler(SDH0);
+    }
+
+    if((ier & SDH_INTEN_CDIEN_Msk) &&
+            (isr & SDH_INTSTS_CDIF_Msk))    // card detect
+    {
+        isr = SDH0->INTSTS;
+        if(isr & SDH_INTSTS_CDSTS_Msk)
+        {
+            SD0.IsCardInsert = FALSE;   // SDISR_CD_Card = 1 means card remove for GPIO mode
+        }
+
+        SDH0->INTSTS = SDH_INTSTS_CDIF_Msk;
+    }
+
+    // CRC error interrupt
+    if(isr & SDH_INTSTS_CRCIF_Msk)
+    {
+        SDH0->INTSTS = SDH_INTSTS_CRCIF_Msk;      // clear interrupt flag
+    }
+
+    if(isr & SDH_INTSTS_DITOIF_Msk)
+    {
+        SDH0->INTSTS = SDH_INTSTS_DITOIF_Msk;
+    }
+}
+
+static const uint8_t *card(uint32_t sector)
+{
+    return sdh_sim_card_data() + (size_t)sector * 512;
+}
+
+static void fill(uint8_t *p, size_t len, uint32_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        p[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+/* A fresh card in the slot, opened and probed */
+static int setup(const sdh_sim_card_t *c)
+{
+    sdh_sim_init(c);
+    SDH_Open(SDH0, CardDetect_From_GPIO);
+    if (SDH_Probe(SDH0) != 0)
+        return -1;
+    sdh_sim_reset_stats();
+    s_cb_count = 0;
+    return 0;
+}
+
+/* Sleep until the callback came, as an RTOS task would on its semaphore */
+static int wait_callback(int count)
+{
+    while (s_cb_count < count)
+    {
+        if (sdh_sim_wfi() != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void test_probe(void)
+{
+    CHECK(setup(&s_card_cmd23) == 0);
+    CHECK(SD0.CardType == SDH_TYPE_SD_HIGH);
+    CHECK(SD0.totalSectorN == CARD_SECTORS);
+    CHECK(SD0.IsSetBlkCnt == 1);
+    CHECK(SD0.IsCardInsert == 1);
+    CHECK(sdh_sim_bus_width() == 4);
+    CHECK(sdh_sim_bus_khz() == SDHC_FREQ);
+    CHECK(sdh_sim_card_state() == SDH_SIM_STBY || sdh_sim_card_state() == SDH_SIM_TRAN);
+
+    CHECK(setup(&s_card_cmd12) == 0);
+    CHECK(SD0.IsSetBlkCnt == 0);
+}
+
+/* A card with CMD23 stops by itself; one without needs CMD12, also after an
+ * asynchronous transfer nobody waited for. CMD7 only once for all of it. */
+static void test_stop_command(void)
+{
+    const sdh_sim_stats_t *st = sdh_sim_stats();
+
+    CHECK(setup(&s_card_cmd23) == 0);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 100, 16) == Successful);
+    CHECK(memcmp(s_au8Buf, card(100), 16 * 512) == 0);
+    fill(s_au8Src, 16 * 512, 1);
+    CHECK(SDH_Write(SDH0, s_au8Src, 200, 16) == Successful);
+    CHECK(memcmp(card(200), s_au8Src, 16 * 512) == 0);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 200, 1) == Successful);
+    CHECK(memcmp(s_au8Buf, s_au8Src, 512) == 0);
+    CHECK(st->cmd[23] == 3);
+    CHECK(st->cmd[18] == 2);
+    CHECK(st->cmd[25] == 1);
+    CHECK(st->cmd[12] == 0);
+    CHECK(st->selects == 1);
+    CHECK(st->deselects == 0);
+    CHECK(st->illegal == 0);
+    CHECK(SD0.IsSelected == 1);
+
+    CHECK(setup(&s_card_cmd12) == 0);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 100, 16) == Successful);
+    CHECK(memcmp(s_au8Buf, card(100), 16 * 512) == 0);
+    CHECK(SDH_Write(SDH0, s_au8Src, 300, 16) == Successful);
+    CHECK(memcmp(card(300), s_au8Src, 16 * 512) == 0);
+    CHECK(st->cmd[23] == 0);
+    CHECK(st->cmd[12] == 2);
+
+    /* the CMD12 of this one is left to the next call */
+    CHECK(SDH_ReadAsync(SDH0, s_au8Buf, 400, 16, on_done, NULL) == Successful);
+    CHECK(wait_callback(1) == 0);
+    CHECK(s_cb_status == Successful);
+    CHECK(memcmp(s_au8Buf, card(400), 16 * 512) == 0);
+    CHECK(st->cmd[12] == 2);
+    CHECK(sdh_sim_card_state() == SDH_SIM_DATA);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 500, 1) == Successful);
+    CHECK(memcmp(s_au8Buf, card(500), 512) == 0);
+    CHECK(st->cmd[12] == 4);
+    CHECK(st->selects == 1);
+    CHECK(st->illegal == 0);
+    CHECK(s_cb_count == 1);
+}
+
+/* 600 blocks take three data phases of at most 255 blocks (BLKCNT is 8
+ * bits), started by SDH_XferPoll and by SDH_AsyncIRQHandler */
+static void test_chunks(void)
+{
+    const sdh_sim_stats_t *st = sdh_sim_stats();
+    int w;
+
+    for (w = 0; w < 2; w++)
+    {
+        CHECK(setup(w ? &s_card_cmd12 : &s_card_cmd23) == 0);
+
+        memset(s_au8Buf, 0, sizeof(s_au8Buf));
+        CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 600) == Successful);
+        CHECK(memcmp(s_au8Buf, card(1000), 600 * 512) == 0);
+        CHECK(st->chunks == 3);
+        CHECK(st->chunk_log[0] == 255 && st->chunk_log[1] == 255 && st->chunk_log[2] == 90);
+
+        sdh_sim_reset_stats();
+        memset(s_au8Buf, 0, sizeof(s_au8Buf));
+        CHECK(SDH_ReadAsync(SDH0, s_au8Buf, 2000, 600, on_done, s_au8Buf) == Successful);
+        CHECK(wait_callback(1) == 0);
+        CHECK(SDH_WaitAsync(SDH0) == Successful);
+        CHECK(s_cb_count == 1 && s_cb_status == Successful);
+        CHECK(s_cb_sdh == SDH0 && s_cb_arg == s_au8Buf);
+        CHECK(memcmp(s_au8Buf, card(2000), 600 * 512) == 0);
+        CHECK(st->chunks == 3);
+        CHECK(st->chunk_log[0] == 255 && st->chunk_log[1] == 255 && st->chunk_log[2] == 90);
+        /* the ISR started the later chunks: the task slept through them */
+        CHECK(st->irqs >= 3);
+
+        sdh_sim_reset_stats();
+        fill(s_au8Src, sizeof(s_au8Src), 2 + w);
+        CHECK(SDH_WriteAsync(SDH0, s_au8Src, 3000, 600, on_done, NULL) == Successful);
+        CHECK(wait_callback(2) == 0);
+        CHECK(SDH_WaitAsync(SDH0) == Successful);
+        CHECK(sdh_sim_card_state() == SDH_SIM_TRAN);
+        CHECK(memcmp(card(3000), s_au8Src, 600 * 512) == 0);
+        CHECK(st->chunks == 3);
+        CHECK(st->chunk_log[0] == 255 && st->chunk_log[1] == 255 && st->chunk_log[2] == 90);
+        CHECK(st->cmd[12] == (w ? 1u : 0u));
+        CHECK(st->illegal == 0);
+    }
+}
+
+/* A CRC error ends the transfer and deselects the card, the next call
+ * selects it again */
+static void test_crc_error(void)
+{
+    const sdh_sim_stats_t *st = sdh_sim_stats();
+
+    CHECK(setup(&s_card_cmd23) == 0);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 0, 1) == Successful);
+    CHECK(st->selects == 1);
+
+    sdh_sim_crc_error(300);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 600) == SDH_CRC16_ERROR);
+    CHECK(st->crc_errors == 1);
+    CHECK(st->chunks == 3);
+    CHECK(st->deselects == 1);
+    CHECK(SD0.IsSelected == 0);
+    CHECK(SD0.XferLeft == 0);
+    CHECK(sdh_sim_card_state() == SDH_SIM_STBY);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 600) == Successful);
+    CHECK(memcmp(s_au8Buf, card(1000), 600 * 512) == 0);
+    CHECK(st->selects == 2);
+
+    /* from the ISR: the rest of the transfer is not started */
+    sdh_sim_reset_stats();
+    sdh_sim_crc_error(10);
+    CHECK(SDH_ReadAsync(SDH0, s_au8Buf, 1000, 600, on_done, NULL) == Successful);
+    CHECK(wait_callback(1) == 0);
+    CHECK(s_cb_status == SDH_CRC16_ERROR);
+    CHECK(st->chunks == 1);
+    CHECK(SDH_WaitAsync(SDH0) == SDH_CRC16_ERROR);
+    CHECK(st->deselects == 1);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 16) == Successful);
+    CHECK(st->selects == 1);
+
+    /* a write with a bad block: the card has to be stopped and released */
+    sdh_sim_reset_stats();
+    fill(s_au8Src, sizeof(s_au8Src), 4);
+    sdh_sim_crc_error(300);
+    CHECK(SDH_WriteAsync(SDH0, s_au8Src, 4000, 600, on_done, NULL) == Successful);
+    CHECK(wait_callback(2) == 0);
+    CHECK(s_cb_status == SDH_CRC_ERROR);
+    CHECK(st->blocks_out == 300);
+    CHECK(SDH_WaitAsync(SDH0) == SDH_CRC_ERROR);
+    CHECK(st->cmd[12] == 1);
+    CHECK(st->deselects == 1);
+    CHECK(SDH_Write(SDH0, s_au8Src, 4000, 600) == Successful);
+    CHECK(memcmp(card(4000), s_au8Src, 600 * 512) == 0);
+    CHECK(st->selects == 1);
+    CHECK(st->illegal == 0);
+    CHECK(s_cb_count == 2);
+}
+
+/* Nothing else goes to the card while an asynchronous transfer is in flight */
+static void test_busy(void)
+{
+    const sdh_sim_stats_t *st = sdh_sim_stats();
+    uint32_t cmds;
+
+    CHECK(setup(&s_card_cmd12) == 0);
+    CHECK(SDH_ReadAsync(SDH0, s_au8Buf, 1000, 600, on_done, NULL) == Successful);
+    CHECK(SDH_IS_BUSY(SDH0));
+    cmds = st->cmd[18] + st->cmd[25] + st->cmd[32] + st->cmd[7];
+    CHECK(SDH_Read(SDH0, s_au8Src, 0, 1) == SDH_BUSY);
+    CHECK(SDH_Write(SDH0, s_au8Src, 0, 1) == SDH_BUSY);
+    CHECK(SDH_Erase(SDH0, 0, 1) == SDH_BUSY);
+    CHECK(SDH_ReadAsync(SDH0, s_au8Src, 0, 1, on_done, NULL) == SDH_BUSY);
+    CHECK(SDH_WriteAsync(SDH0, s_au8Src, 0, 1, on_done, NULL) == SDH_BUSY);
+    CHECK(st->cmd[18] + st->cmd[25] + st->cmd[32] + st->cmd[7] == cmds);
+
+    CHECK(wait_callback(1) == 0);
+    CHECK(!SDH_IS_BUSY(SDH0));
+    CHECK(SDH_WaitAsync(SDH0) == Successful);
+    CHECK(SDH_WaitAsync(SDH0) == Successful);
+    CHECK(memcmp(s_au8Buf, card(1000), 600 * 512) == 0);
+    CHECK(st->cmd[12] == 1);
+
+    /* the refused calls never call back; nor does anything after the end */
+    CHECK(sdh_sim_wfi() == -1);
+    CHECK(s_cb_count == 1);
+    CHECK(SDH_Erase(SDH0, 100, 8) == Successful);
+    CHECK(card(100)[0] == 0 && card(107)[511] == 0);
+    CHECK(s_cb_count == 1);
+    CHECK(st->illegal == 0);
+}
+
+/* A card that stops sending: SDH_WaitAsync gives up, resets the engine,
+ * stops and deselects the card, and calls back with the time-out */
+static void test_timeout(void)
+{
+    const sdh_sim_stats_t *st = sdh_sim_stats();
+
+    CHECK(setup(&s_card_cmd23) == 0);
+    sdh_sim_stall(300);
+    CHECK(SDH_ReadAsync(SDH0, s_au8Buf, 1000, 600, on_done, NULL) == Successful);
+    CHECK(wait_callback(1) == -1);
+    CHECK(s_cb_count == 0);
+    CHECK(SDH_IS_BUSY(SDH0));
+    CHECK(SDH_WaitAsync(SDH0) == SDH_ERR_TIMEOUT);
+    CHECK(s_cb_count == 1 && s_cb_status == SDH_ERR_TIMEOUT);
+    CHECK(!SDH_IS_BUSY(SDH0));
+    CHECK(st->stalls == 1);
+    CHECK(st->ctl_resets == 1);
+    CHECK(st->cmd[12] == 1);
+    CHECK(st->deselects == 1);
+    CHECK(SD0.XferLeft == 0);
+    CHECK(SDH_WaitAsync(SDH0) == SDH_ERR_TIMEOUT);
+    CHECK(s_cb_count == 1);
+
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 600) == Successful);
+    CHECK(memcmp(s_au8Buf, card(1000), 600 * 512) == 0);
+    CHECK(st->selects == 2);
+
+    /* the same without interrupt-driven chunks */
+    sdh_sim_reset_stats();
+    sdh_sim_stall(10);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 600) == SDH_ERR_TIMEOUT);
+    CHECK(st->ctl_resets == 1);
+    CHECK(st->deselects == 1);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 16) == Successful);
+    CHECK(memcmp(s_au8Buf, card(1000), 16 * 512) == 0);
+    CHECK(st->illegal == 0);
+    CHECK(s_cb_count == 1);
+}
+
+static void check_released(void)
+{
+    CHECK(SD0.IsCardInsert == 0);
+    CHECK(SD0.IsSelected == 0);
+    CHECK(SD0.XferLeft == 0);
+    CHECK(SD0.XferEndPending == 0);
+    CHECK(SD0.AsyncBusy == 0);
+}
+
+/* Pulled in the middle of a transfer: no stale selection or block count
+ * survives until the next card is probed */
+static void test_removal(void)
+{
+    const sdh_sim_stats_t *st = sdh_sim_stats();
+
+    CHECK(setup(&s_card_cmd12) == 0);
+    sdh_sim_remove(2000000);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 600) == SDH_NO_SD_CARD);
+    check_released();
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 1) == SDH_NO_SD_CARD);
+
+    sdh_sim_insert();
+    CHECK(SDH_Probe(SDH0) == 0);
+    sdh_sim_reset_stats();
+    CHECK(SDH_Read(SDH0, s_au8Buf, 1000, 600) == Successful);
+    CHECK(memcmp(s_au8Buf, card(1000), 600 * 512) == 0);
+    CHECK(st->selects == 1);
+    CHECK(st->illegal == 0);
+
+    /* noticed by SDH_WaitAsync */
+    sdh_sim_remove(2000000);
+    CHECK(SDH_ReadAsync(SDH0, s_au8Buf, 1000, 600, on_done, NULL) == Successful);
+    CHECK(wait_callback(1) == -1);
+    CHECK(SDH_WaitAsync(SDH0) == SDH_NO_SD_CARD);
+    CHECK(s_cb_count == 1 && s_cb_status == SDH_NO_SD_CARD);
+    check_released();
+
+    /* noticed by the next call instead of SDH_BUSY for ever */
+    sdh_sim_insert();
+    CHECK(SDH_Probe(SDH0) == 0);
+    sdh_sim_remove(2000000);
+    CHECK(SDH_WriteAsync(SDH0, s_au8Src, 1000, 600, on_done, NULL) == Successful);
+    CHECK(wait_callback(2) == -1);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 0, 1) == SDH_NO_SD_CARD);
+    CHECK(s_cb_count == 2 && s_cb_status == SDH_NO_SD_CARD);
+    check_released();
+
+    sdh_sim_insert();
+    CHECK(SDH_Probe(SDH0) == 0);
+    CHECK(SDH_Read(SDH0, s_au8Buf, 0, 16) == Successful);
+    CHECK(memcmp(s_au8Buf, card(0), 16 * 512) == 0);
+    CHECK(s_cb_count == 2);
+}
+
+/* 10 MB read in calls of n blocks, waiting by polling or by sleeping until
+ * the callback. CPU busy is everything but sdh_sim_wfi(). */
+static void bench(int async, uint32_t n)
+{
+    const sdh_sim_stats_t *st = sdh_sim_stats();
+    uint32_t i, calls = BENCH_BYTES / (n * 512), sec = 0;
+    uint64_t t0, idle0, t, busy;
+    int ok = 1;
+
+    CHECK(setup(&s_card_cmd23) == 0);
+    t0 = sdh_sim_time_ns();
+    idle0 = sdh_sim_idle_ns();
+    for (i = 0; i < calls && ok; i++, sec += n)
+    {
+        if (!async)
+        {
+            ok = SDH_Read(SDH0, s_au8Buf, sec, n) == Successful;
+            continue;
+        }
+        ok = SDH_ReadAsync(SDH0, s_au8Buf, sec, n, on_done, NULL) == Successful &&
+             wait_callback((int)i + 1) == 0 &&
+             SDH_WaitAsync(SDH0) == Successful;
+    }
+    CHECK(ok);
+    CHECK(memcmp(s_au8Buf, card(sec - n), n * 512) == 0);
+    CHECK(st->blocks_in == BENCH_BYTES / 512);
+
+    t = sdh_sim_time_ns() - t0;
+    busy = t - (sdh_sim_idle_ns() - idle0);
+    printf("%-5s %3u blocks/call: %6.2f MB/s, CPU busy %5.1f %% (%llu of %llu us), %u irqs\n",
+           async ? "async" : "sync", (unsigned)n, BENCH_BYTES / 1048576.0 / (t / 1e9),
+           100.0 * busy / t, (unsigned long long)(busy / 1000), (unsigned long long)(t / 1000),
+           (unsigned)st->irqs);
+    if (async)
+        CHECK(busy * 10 < t);
+    else
+        CHECK(busy * 10 > t * 9);
+}
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    test_probe();
+    test_stop_command();
+    test_chunks();
+    test_crc_error();
+    test_busy();
+    test_timeout();
+    test_removal();
+
+    printf("simulated time, SD clock %u kHz, 4-bit bus:\n", (unsigned)sdh_sim_bus_khz());
+    bench(0, 16);
+    bench(1, 16);
+    bench(0, 256);
+    bench(1, 256);
+
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
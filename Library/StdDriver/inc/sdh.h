@@ -57,6 +57,7 @@ extern "C"
 #define SDH_CRC16_ERROR      (SDH_ERR_ID|0x17ul) /*!< CRC 16 error  \hideinitializer */
 #define SDH_CRC_ERROR        (SDH_ERR_ID|0x18ul) /*!< CRC error  \hideinitializer */
 #define SDH_CMD8_ERROR       (SDH_ERR_ID|0x19ul) /*!< Command 8 error  \hideinitializer */
+#define SDH_BUSY             (SDH_ERR_ID|0x1Aul) /*!< Asynchronous transfer in progress  \hideinitializer */
 
 #define MMC_FREQ        20000ul   /*!< output 20MHz to MMC  \hideinitializer */
 #define SD_FREQ         25000ul   /*!< output 25MHz to SD  \hideinitializer */
@@ -68,7 +69,9 @@ extern "C"
 #define CardDetect_From_DAT3  (1ul << 9)   /*!< Card detection pin is DAT3 \hideinitializer */
 
 /* SDH Define Error Code */
+#ifndef SDH_TIMEOUT_CNT
 #define SDH_TIMEOUT_CNT     2000000        /*!< SDH time-out counter \hideinitializer */
+#endif
 #define SDH_OK              ( 0UL)          /*!< SDH operation OK \hideinitializer */
 #define SDH_ERR_FAIL        (-1UL)          /*!< SDH operation failed \hideinitializer */
 #define SDH_ERR_TIMEOUT     (-2UL)          /*!< SDH operation abort due to timeout error \hideinitializer */
@@ -79,6 +82,14 @@ extern "C"
 /** @addtogroup SDH_EXPORTED_TYPEDEF SDH Exported Type Defines
   @{
 */
+
+/**
+ *  @brief  Completion callback of \ref SDH_ReadAsync / \ref SDH_WriteAsync.
+ *          Called in interrupt context with the status of the data transfer.
+ *          A stop command still due is sent later, see \ref SDH_WaitAsync.
+ */
+typedef void (*SDH_CALLBACK_T)(SDH_T *sdh, uint32_t u32Status, void *pvArg);
+
 typedef struct SDH_info_t
 {
     unsigned char   IsCardInsert;   /*!< Card insert state */
@@ -92,6 +103,16 @@ typedef struct SDH_info_t
     int             sectorSize;     /*!< Sector size in bytes */
     unsigned char   *dmabuf;
     int32_t         i32ErrCode;     /*!< SDH global error code */
+    unsigned char   IsSelected;     /*!< Card is in transfer state (CMD7 sent) */
+    unsigned char   IsSetBlkCnt;    /*!< Card supports CMD23 (SET_BLOCK_COUNT) */
+    unsigned char   XferWrite;      /*!< Transfer in progress is a write */
+    unsigned char   XferStop;       /*!< Transfer in progress ends with CMD12 */
+    unsigned char volatile XferEndPending;  /*!< Asynchronous transfer still needs CMD12 or deselect */
+    unsigned int volatile XferLeft; /*!< Blocks not yet started */
+    unsigned char volatile AsyncBusy;   /*!< Asynchronous transfer in progress */
+    unsigned int volatile XferStatus;   /*!< Status of the last asynchronous transfer */
+    SDH_CALLBACK_T  pfnCallback;    /*!< Completion callback of the asynchronous transfer */
+    void            *pvCallbackArg; /*!< Argument of pfnCallback */
 } SDH_INFO_T;                       /*!< Structure holds SD card info */
 
 /*@}*/ /* end of group SDH_EXPORTED_TYPEDEF */
@@ -187,11 +208,29 @@ extern int32_t g_SDH_i32ErrCode;
  */
 #define SDH_GET_CARD_CAPACITY(sdh)  (((sdh) == SDH0)? SD0.diskSize : SD1.diskSize)
 
+/**
+ *  @brief    Check whether an asynchronous transfer is in progress.
+ *
+ *  @param[in]    sdh    Select SDH0 or SDH1.
+ *
+ *  @return   1: \ref SDH_ReadAsync / \ref SDH_WriteAsync not finished yet.
+ *            0: Idle.
+ * \hideinitializer
+ */
+#define SDH_IS_BUSY(sdh)  (((sdh) == SDH0)? SD0.AsyncBusy : SD1.AsyncBusy)
+
 
 void SDH_Open(SDH_T *sdh, uint32_t u32CardDetSrc);
 uint32_t SDH_Probe(SDH_T *sdh);
 uint32_t SDH_Read(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount);
 uint32_t SDH_Write(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount);
+uint32_t SDH_Erase(SDH_T *sdh, uint32_t u32StartSec, uint32_t u32SecCount);
+uint32_t SDH_ReadAsync(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount,
+                       SDH_CALLBACK_T pfnCallback, void *pvArg);
+uint32_t SDH_WriteAsync(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount,
+                        SDH_CALLBACK_T pfnCallback, void *pvArg);
+uint32_t SDH_WaitAsync(SDH_T *sdh);
+void SDH_AsyncIRQHandler(SDH_T *sdh);
 
 uint32_t SDH_CardDetection(SDH_T *sdh);
 int SDH_Open_Disk(SDH_T *sdh, uint32_t u32CardDetSrc);
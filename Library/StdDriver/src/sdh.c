@@ -44,6 +44,8 @@ static uint8_t _SDH1_ucSDHCBuffer[512] __attribute__((aligned(4)));
 
 SDH_INFO_T SD0, SD1;
 
+static uint32_t SDH_XferAbort(SDH_T *sdh, SDH_INFO_T *pSD);
+
 static int32_t SDH_CheckRB(SDH_T *sdh)
 {
     uint32_t u32TimeOutCount1, u32TimeOutCount2;
@@ -853,6 +855,7 @@ uint32_t SDH_SelectCardType(SDH_T *sdh)
         {
             return status;
         }
+        pSD->IsSetBlkCnt = (pSD->dmabuf[3] & 0x02ul) ? TRUE : FALSE;    /* SCR CMD_SUPPORT: CMD23 */
 
         if((*pSD->dmabuf & 0xful) == 0x2ul)
         {
@@ -888,6 +891,7 @@ uint32_t SDH_SelectCardType(SDH_T *sdh)
         {
             return status;
         }
+        pSD->IsSetBlkCnt = (pSD->dmabuf[3] & 0x02ul) ? TRUE : FALSE;    /* SCR CMD_SUPPORT: CMD23 */
 
         /* set data bus width. ACMD6 for SD card, SDCR_DBW for host. */
         if((status = SDH_SDCmdAndRsp(sdh, 55ul, pSD->RCA, 0ul)) != Successful)
@@ -923,6 +927,7 @@ uint32_t SDH_SelectCardType(SDH_T *sdh)
         }
 
         sdh->CTL |= SDH_CTL_DBW_Msk; /* set bus width to 4-bit mode for SD host controller */
+        pSD->IsSetBlkCnt = (pSD->CardType == SDH_TYPE_EMMC) ? TRUE : FALSE;
 
     }
 
@@ -1221,6 +1226,16 @@ uint32_t SDH_Probe(SDH_T *sdh)
         return SDH_NO_SD_CARD;
     }
 
+    /* SDH_Init() puts the card back in idle state; drop what was left of a transfer */
+    if(sdh == SDH0)
+    {
+        SDH_XferAbort(sdh, &SD0);
+    }
+    else
+    {
+        SDH_XferAbort(sdh, &SD1);
+    }
+
     if((val = SDH_Init(sdh)) != 0ul)
     {
         return val;
@@ -1245,53 +1260,107 @@ uint32_t SDH_Probe(SDH_T *sdh)
     return 0ul;
 }
 
-/**
- *  @brief  This function use to read data from SD card.
- *
- *  @param[in]     sdh           Select SDH0 or SDH1.
- *  @param[out]    pu8BufAddr    The buffer to receive the data from SD card.
- *  @param[in]     u32StartSec   The start read sector address.
- *  @param[in]     u32SecCount   The the read sector number of data
- *
- *  @return None
+/** @cond HIDDEN_SYMBOLS */
+
+/* CTL bits kept when a command or data phase is started */
+#define SDH_CTL_KEEP_Msk    (SDH_CTL_SDNWR_Msk | SDH_CTL_DBW_Msk | SDH_CTL_CLKKEEP_Msk)
+
+/*
+ * The card is put in transfer state once (CMD7) and stays there across
+ * SDH_Read/SDH_Write/SDH_Erase calls, until an error, SDH_Probe or card
+ * removal clears IsSelected (SDH_DeselectCard, SDH_XferAbort). Only the
+ * busy check is left per call: a write or erase of the last call may
+ * still be programming.
  */
-uint32_t SDH_Read(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount)
+static uint32_t SDH_XferEnd(SDH_T *sdh, SDH_INFO_T *pSD);
+
+static uint32_t SDH_SelectCard(SDH_T *sdh, SDH_INFO_T *pSD)
 {
-    uint32_t volatile bIsSendCmd = FALSE;
-    uint32_t volatile reg;
-    uint32_t volatile i, loop, status;
-    uint32_t blksize = SDH_BLOCK_SIZE;
-    uint32_t u32TimeOutCount;
+    uint32_t status;
 
-    SDH_INFO_T *pSD;
+    /* stop command of an asynchronous transfer nobody waited for */
+    SDH_XferEnd(sdh, pSD);
 
-    if(sdh == SDH0)
+    if(!pSD->IsSelected)
     {
-        pSD = &SD0;
+        if((status = SDH_SDCmdAndRsp(sdh, 7ul, pSD->RCA, 0ul)) != Successful)
+        {
+            return status;
+        }
+        pSD->IsSelected = (unsigned char)TRUE;
     }
-    else
+
+    if(SDH_CheckRB(sdh) != Successful)
     {
-        pSD = &SD1;
+        return SDH_ERR_TIMEOUT;
     }
 
-    pSD->i32ErrCode = 0;
+    return Successful;
+}
+
+static void SDH_DeselectCard(SDH_T *sdh, SDH_INFO_T *pSD)
+{
+    uint32_t u32TimeOutCount = SDH_TIMEOUT_CNT;
+
+    pSD->IsSelected = (unsigned char)FALSE;
+
+    SDH_SDCommand(sdh, 7ul, 0ul);
+    sdh->CTL |= SDH_CTL_CLK8OEN_Msk;
+    while((sdh->CTL & SDH_CTL_CLK8OEN_Msk) == SDH_CTL_CLK8OEN_Msk)
+    {
+        if(--u32TimeOutCount == 0)
+        {
+            break;
+        }
+    }
+}
+
+/* Start the data phase of the next up to 255 blocks (SDCR[BLK_CNT] is 8 bits),
+   with the read or write command itself for the first one. */
+static void SDH_XferChunk(SDH_T *sdh, SDH_INFO_T *pSD, uint32_t u32Cmd)
+{
+    uint32_t reg, cnt;
+
+    cnt = (pSD->XferLeft > 255ul) ? 255ul : pSD->XferLeft;
+    pSD->XferLeft -= cnt;
+
+    pSD->DataReadyFlag = (uint8_t)FALSE;
+    reg = (sdh->CTL & SDH_CTL_KEEP_Msk) | (cnt << SDH_CTL_BLKCNT_Pos);
+    reg |= pSD->XferWrite ? SDH_CTL_DOEN_Msk : SDH_CTL_DIEN_Msk;
+    if(u32Cmd != 0ul)
+    {
+        reg |= (u32Cmd << SDH_CTL_CMDCODE_Pos) | SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk;
+    }
+    sdh->CTL = reg;
+}
+
+static uint32_t SDH_XferStart(SDH_T *sdh, SDH_INFO_T *pSD, uint8_t *pu8BufAddr,
+                              uint32_t u32StartSec, uint32_t u32SecCount, uint32_t u32Write)
+{
+    uint32_t status;
 
     if(u32SecCount == 0ul)
     {
         return SDH_SELECT_ERROR;
     }
 
-    if((status = SDH_SDCmdAndRsp(sdh, 7ul, pSD->RCA, 0ul)) != Successful)
+    if((status = SDH_SelectCard(sdh, pSD)) != Successful)
     {
         return status;
     }
 
-    if(SDH_CheckRB(sdh) != Successful)
+    /* With SET_BLOCK_COUNT the card stops by itself after the last block, no CMD12 */
+    pSD->XferStop = (unsigned char)TRUE;
+    if(pSD->IsSetBlkCnt && (u32SecCount <= 0xfffful))
     {
-        return SDH_ERR_TIMEOUT;
+        if(SDH_SDCmdAndRsp(sdh, 23ul, u32SecCount, 0ul) == Successful)
+        {
+            pSD->XferStop = (unsigned char)FALSE;
+        }
     }
 
-    sdh->BLEN = blksize - 1ul;       /* the actual byte count is equal to (SDBLEN+1) */
+    /* According to SD Spec v2.0, the block size MUST be 512, and the start address MUST be 512*n. */
+    sdh->BLEN = SDH_BLOCK_SIZE - 1ul;
 
     if((pSD->CardType == SDH_TYPE_SD_HIGH) || (pSD->CardType == SDH_TYPE_EMMC))
     {
@@ -1299,102 +1368,147 @@ uint32_t SDH_Read(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_
     }
     else
     {
-        sdh->CMDARG = u32StartSec * blksize;
+        sdh->CMDARG = u32StartSec * SDH_BLOCK_SIZE;
     }
 
     sdh->DMASA = (uint32_t)pu8BufAddr;
+    sdh->INTSTS = SDH_INTSTS_CRCIF_Msk;
+
+    pSD->XferWrite = (unsigned char)u32Write;
+    pSD->XferLeft = u32SecCount;
+    SDH_XferChunk(sdh, pSD, u32Write ? 25ul : 18ul);
+
+    return Successful;
+}
 
-    loop = u32SecCount / 255ul;
-    for(i = 0ul; i < loop; i++)
+/* CRC result of the chunk that just finished */
+static uint32_t SDH_XferCheck(SDH_T *sdh, SDH_INFO_T *pSD)
+{
+    if(pSD->XferWrite)
     {
-        pSD->DataReadyFlag = (uint8_t)FALSE;
-        reg = sdh->CTL & ~SDH_CTL_CMDCODE_Msk;
-        reg = reg | 0xff0000ul;   /* set BLK_CNT to 255 */
-        if(bIsSendCmd == FALSE)
-        {
-            sdh->CTL = reg | (18ul << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DIEN_Msk);
-            bIsSendCmd = TRUE;
-        }
-        else
+        if((sdh->INTSTS & SDH_INTSTS_CRCIF_Msk) != 0ul)
         {
-            sdh->CTL = reg | SDH_CTL_DIEN_Msk;
+            sdh->INTSTS = SDH_INTSTS_CRCIF_Msk;
+            return SDH_CRC_ERROR;
         }
+        return Successful;
+    }
 
-        u32TimeOutCount = SDH_TIMEOUT_CNT;
-        while(!pSD->DataReadyFlag)
-        {
-            if(pSD->DataReadyFlag)
-            {
-                break;
-            }
-            if(pSD->IsCardInsert == FALSE)
-            {
-                return SDH_NO_SD_CARD;
-            }
-            if(--u32TimeOutCount == 0)
-            {
-                pSD->i32ErrCode = SDH_ERR_TIMEOUT;
-                break;
-            }
-        }
+    if((sdh->INTSTS & SDH_INTSTS_CRC7_Msk) != SDH_INTSTS_CRC7_Msk)       /* check CRC7 */
+    {
+        return SDH_CRC7_ERROR;
+    }
 
-        if((sdh->INTSTS & SDH_INTSTS_CRC7_Msk) != SDH_INTSTS_CRC7_Msk)       /* check CRC7 */
-        {
-            return SDH_CRC7_ERROR;
-        }
+    if((sdh->INTSTS & SDH_INTSTS_CRC16_Msk) != SDH_INTSTS_CRC16_Msk)      /* check CRC16 */
+    {
+        return SDH_CRC16_ERROR;
+    }
 
-        if((sdh->INTSTS & SDH_INTSTS_CRC16_Msk) != SDH_INTSTS_CRC16_Msk)      /* check CRC16 */
+    return Successful;
+}
+
+/* End the transfer. The card stays selected unless something went wrong. */
+static uint32_t SDH_XferStop(SDH_T *sdh, SDH_INFO_T *pSD, uint32_t status)
+{
+    pSD->XferLeft = 0ul;
+
+    if(status == SDH_ERR_TIMEOUT)
+    {
+        sdh->CTL |= SDH_CTL_CTLRST_Msk; /* reset SD engine, DIEN/DOEN never cleared */
+    }
+
+    if(pSD->XferStop || (status != Successful))
+    {
+        if(SDH_SDCmdAndRsp(sdh, 12ul, 0ul, 0ul) && (status == Successful))       /* stop command */
         {
-            return SDH_CRC16_ERROR;
+            status = SDH_CRC7_ERROR;
         }
     }
+    sdh->INTSTS = SDH_INTSTS_CRCIF_Msk;
+
+    if(status != Successful)
+    {
+        SDH_DeselectCard(sdh, pSD);
+    }
 
-    loop = u32SecCount % 255ul;
-    if(loop != 0ul)
+    return status;
+}
+
+/* Task-context end of an asynchronous transfer: the interrupt handler only
+   marks it, CMD12 and the deselect after an error poll the card for too long. */
+static uint32_t SDH_XferEnd(SDH_T *sdh, SDH_INFO_T *pSD)
+{
+    if(pSD->XferEndPending)
     {
-        pSD->DataReadyFlag = (uint8_t)FALSE;
-        reg = sdh->CTL & (~SDH_CTL_CMDCODE_Msk);
-        reg = reg & (~SDH_CTL_BLKCNT_Msk);
-        reg |= (loop << 16);    /* setup SDCR_BLKCNT */
+        pSD->XferEndPending = (unsigned char)FALSE;
+        pSD->XferStatus = SDH_XferStop(sdh, pSD, pSD->XferStatus);
+    }
 
-        if(bIsSendCmd == FALSE)
-        {
-            sdh->CTL = reg | (18ul << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DIEN_Msk);
-            bIsSendCmd = TRUE;
-        }
-        else
+    return pSD->XferStatus;
+}
+
+/* The card is gone, or about to be probed again: forget the transfer and the
+   selection without talking to it, and end an asynchronous transfer with
+   SDH_NO_SD_CARD so that its callback still comes exactly once. */
+static uint32_t SDH_XferAbort(SDH_T *sdh, SDH_INFO_T *pSD)
+{
+    pSD->XferLeft = 0ul;
+    pSD->XferEndPending = (unsigned char)FALSE;
+    pSD->IsSelected = (unsigned char)FALSE;
+    pSD->XferStatus = SDH_NO_SD_CARD;
+
+    sdh->CTL |= SDH_CTL_CTLRST_Msk; /* reset SD engine */
+    sdh->INTSTS = SDH_INTSTS_CRCIF_Msk;
+
+    if(pSD->AsyncBusy)
+    {
+        pSD->AsyncBusy = (unsigned char)FALSE;
+        if(pSD->pfnCallback != NULL)
         {
-            sdh->CTL = reg | SDH_CTL_DIEN_Msk;
+            pSD->pfnCallback(sdh, SDH_NO_SD_CARD, pSD->pvCallbackArg);
         }
+    }
+
+    return SDH_NO_SD_CARD;
+}
 
+/* Synchronous completion: wait for each chunk, then for the card to be ready */
+static uint32_t SDH_XferPoll(SDH_T *sdh, SDH_INFO_T *pSD)
+{
+    uint32_t status = Successful;
+    uint32_t u32TimeOutCount;
+
+    while(1)
+    {
         u32TimeOutCount = SDH_TIMEOUT_CNT;
         while(!pSD->DataReadyFlag)
         {
             if(pSD->IsCardInsert == FALSE)
             {
-                return SDH_NO_SD_CARD;
+                return SDH_XferAbort(sdh, pSD);
             }
             if(--u32TimeOutCount == 0)
             {
                 pSD->i32ErrCode = SDH_ERR_TIMEOUT;
+                status = SDH_ERR_TIMEOUT;
                 break;
             }
         }
 
-        if((sdh->INTSTS & SDH_INTSTS_CRC7_Msk) != SDH_INTSTS_CRC7_Msk)       /* check CRC7 */
+        if(status == Successful)
         {
-            return SDH_CRC7_ERROR;
+            status = SDH_XferCheck(sdh, pSD);
         }
-
-        if((sdh->INTSTS & SDH_INTSTS_CRC16_Msk) != SDH_INTSTS_CRC16_Msk)      /* check CRC16 */
+        if((status != Successful) || (pSD->XferLeft == 0ul))
         {
-            return SDH_CRC16_ERROR;
+            break;
         }
+        SDH_XferChunk(sdh, pSD, 0ul);
     }
 
-    if(SDH_SDCmdAndRsp(sdh, 12ul, 0ul, 0ul))       /* stop command */
+    if((status = SDH_XferStop(sdh, pSD, status)) != Successful)
     {
-        return SDH_CRC7_ERROR;
+        return status;
     }
 
     if(SDH_CheckRB(sdh) != Successful)
@@ -1402,22 +1516,103 @@ uint32_t SDH_Read(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_
         return SDH_ERR_TIMEOUT;
     }
 
-    SDH_SDCommand(sdh, 7ul, 0ul);
-    sdh->CTL |= SDH_CTL_CLK8OEN_Msk;
-    u32TimeOutCount = SDH_TIMEOUT_CNT;
-    while((sdh->CTL & SDH_CTL_CLK8OEN_Msk) == SDH_CTL_CLK8OEN_Msk)
+    return Successful;
+}
+
+static uint32_t SDH_XferSubmit(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount,
+                               uint32_t u32Write, SDH_CALLBACK_T pfnCallback, void *pvArg)
+{
+    uint32_t status;
+    SDH_INFO_T *pSD;
+
+    if(sdh == SDH0)
     {
-        if(--u32TimeOutCount == 0)
-        {
-            pSD->i32ErrCode = SDH_ERR_TIMEOUT;
-            break;
-        }
+        pSD = &SD0;
+    }
+    else
+    {
+        pSD = &SD1;
     }
 
-    if(pSD->i32ErrCode != 0)
-        return Fail;
+    pSD->i32ErrCode = 0;
 
-    return Successful;
+    if(pSD->IsCardInsert == FALSE)
+    {
+        return SDH_XferAbort(sdh, pSD);
+    }
+
+    if(pSD->AsyncBusy)
+    {
+        return SDH_BUSY;
+    }
+
+    SDH_XferEnd(sdh, pSD);
+
+    pSD->pfnCallback = pfnCallback;
+    pSD->pvCallbackArg = pvArg;
+    pSD->XferStatus = Successful;
+    pSD->AsyncBusy = (unsigned char)TRUE;
+
+    if((status = SDH_XferStart(sdh, pSD, pu8BufAddr, u32StartSec, u32SecCount, u32Write)) != Successful)
+    {
+        pSD->AsyncBusy = (unsigned char)FALSE;
+    }
+
+    return status;
+}
+
+/** @endcond HIDDEN_SYMBOLS */
+
+/**
+ *  @brief  This function use to read data from SD card.
+ *
+ *  @param[in]     sdh           Select SDH0 or SDH1.
+ *  @param[out]    pu8BufAddr    The buffer to receive the data from SD card.
+ *  @param[in]     u32StartSec   The start read sector address.
+ *  @param[in]     u32SecCount   The the read sector number of data
+ *
+ *  @return   \ref SDH_SELECT_ERROR : u32SecCount is zero. \n
+ *            \ref SDH_BUSY : An asynchronous transfer is in progress. \n
+ *            \ref SDH_NO_SD_CARD : SD card be removed. \n
+ *            \ref SDH_CRC7_ERROR / \ref SDH_CRC16_ERROR : CRC error happen. \n
+ *            \ref SDH_ERR_TIMEOUT : Card or controller does not respond. \n
+ *            \ref Successful : Read data from SD card success.
+ *
+ *  @details  The CPU polls SD0/SD1.DataReadyFlag, which SDHx_IRQHandler sets on
+ *            SDH_INTSTS_BLKDIF, until all data is in. See \ref SDH_ReadAsync.
+ */
+uint32_t SDH_Read(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount)
+{
+    uint32_t status;
+    SDH_INFO_T *pSD;
+
+    if(sdh == SDH0)
+    {
+        pSD = &SD0;
+    }
+    else
+    {
+        pSD = &SD1;
+    }
+
+    pSD->i32ErrCode = 0;
+
+    if(pSD->IsCardInsert == FALSE)
+    {
+        return SDH_XferAbort(sdh, pSD);
+    }
+
+    if(pSD->AsyncBusy)
+    {
+        return SDH_BUSY;
+    }
+
+    if((status = SDH_XferStart(sdh, pSD, pu8BufAddr, u32StartSec, u32SecCount, FALSE)) != Successful)
+    {
+        return status;
+    }
+
+    return SDH_XferPoll(sdh, pSD);
 }
 
 
@@ -1430,18 +1625,16 @@ uint32_t SDH_Read(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_
  *  @param[in]    u32SecCount   The the write sector number of data.
  *
  *  @return   \ref SDH_SELECT_ERROR : u32SecCount is zero. \n
+ *            \ref SDH_BUSY : An asynchronous transfer is in progress. \n
  *            \ref SDH_NO_SD_CARD : SD card be removed. \n
  *            \ref SDH_CRC_ERROR : CRC error happen. \n
  *            \ref SDH_CRC7_ERROR : CRC7 error happen. \n
+ *            \ref SDH_ERR_TIMEOUT : Card or controller does not respond. \n
  *            \ref Successful : Write data to SD card success.
  */
 uint32_t SDH_Write(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount)
 {
-    uint32_t volatile bIsSendCmd = FALSE;
-    uint32_t volatile reg;
-    uint32_t volatile i, loop, status;
-    uint32_t u32TimeOutCount;
-
+    uint32_t status;
     SDH_INFO_T *pSD;
 
     if(sdh == SDH0)
@@ -1455,134 +1648,286 @@ uint32_t SDH_Write(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32
 
     pSD->i32ErrCode = 0;
 
-    if(u32SecCount == 0ul)
+    if(pSD->IsCardInsert == FALSE)
     {
-        return SDH_SELECT_ERROR;
+        return SDH_XferAbort(sdh, pSD);
     }
 
-    if((status = SDH_SDCmdAndRsp(sdh, 7ul, pSD->RCA, 0ul)) != Successful)
+    if(pSD->AsyncBusy)
     {
-        return status;
+        return SDH_BUSY;
     }
 
-    if(SDH_CheckRB(sdh) != Successful)
+    if((status = SDH_XferStart(sdh, pSD, pu8BufAddr, u32StartSec, u32SecCount, TRUE)) != Successful)
     {
-        return SDH_ERR_TIMEOUT;
+        return status;
     }
 
-    /* According to SD Spec v2.0, the write CMD block size MUST be 512, and the start address MUST be 512*n. */
-    sdh->BLEN = SDH_BLOCK_SIZE - 1ul;
+    return SDH_XferPoll(sdh, pSD);
+}
 
-    if((pSD->CardType == SDH_TYPE_SD_HIGH) || (pSD->CardType == SDH_TYPE_EMMC))
+/**
+ *  @brief  This function use to start reading data from SD card without waiting for it.
+ *
+ *  @param[in]     sdh           Select SDH0 or SDH1.
+ *  @param[out]    pu8BufAddr    The buffer to receive the data from SD card.
+ *  @param[in]     u32StartSec   The start read sector address.
+ *  @param[in]     u32SecCount   The the read sector number of data
+ *  @param[in]     pfnCallback   Called from \ref SDH_AsyncIRQHandler when the transfer is done. Can be NULL.
+ *  @param[in]     pvArg         Argument passed to pfnCallback.
+ *
+ *  @return   \ref Successful : Transfer started. pfnCallback will be called exactly once. \n
+ *            Any error of \ref SDH_Read : Transfer not started, pfnCallback will not be called.
+ *
+ *  @details  SDHx_IRQHandler must call \ref SDH_AsyncIRQHandler after it sets DataReadyFlag.
+ *            The next chunk of 255 blocks is started from there, so the CPU is free until the
+ *            callback, \ref SDH_IS_BUSY or \ref SDH_WaitAsync report the end of the data.
+ *            The callback runs in interrupt context, e.g. to give an RTOS semaphore.
+ *            The CMD12 stop command (cards without CMD23) is sent by \ref SDH_WaitAsync,
+ *            or else by the next SDH_Read/SDH_Write/SDH_Erase/asynchronous call.
+ *            If the card is removed, the next of these calls ends the transfer with
+ *            \ref SDH_NO_SD_CARD, and a time-out in \ref SDH_WaitAsync with
+ *            \ref SDH_ERR_TIMEOUT; pfnCallback is then called from task context.
+ */
+uint32_t SDH_ReadAsync(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount,
+                       SDH_CALLBACK_T pfnCallback, void *pvArg)
+{
+    return SDH_XferSubmit(sdh, pu8BufAddr, u32StartSec, u32SecCount, FALSE, pfnCallback, pvArg);
+}
+
+/**
+ *  @brief  This function use to start writing data to SD card without waiting for it.
+ *
+ *  @param[in]    sdh           Select SDH0 or SDH1.
+ *  @param[in]    pu8BufAddr    The buffer to send the data to SD card. Must stay valid until the end.
+ *  @param[in]    u32StartSec   The start write sector address.
+ *  @param[in]    u32SecCount   The the write sector number of data.
+ *  @param[in]    pfnCallback   Called from \ref SDH_AsyncIRQHandler when the transfer is done. Can be NULL.
+ *  @param[in]    pvArg         Argument passed to pfnCallback.
+ *
+ *  @return   \ref Successful : Transfer started. pfnCallback will be called exactly once. \n
+ *            Any error of \ref SDH_Write : Transfer not started, pfnCallback will not be called.
+ *
+ *  @details  As \ref SDH_ReadAsync. The callback comes when the card has taken the data; it may
+ *            still be programming it. The next command, or \ref SDH_WaitAsync, waits for that.
+ */
+uint32_t SDH_WriteAsync(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount,
+                        SDH_CALLBACK_T pfnCallback, void *pvArg)
+{
+    return SDH_XferSubmit(sdh, pu8BufAddr, u32StartSec, u32SecCount, TRUE, pfnCallback, pvArg);
+}
+
+/**
+ *  @brief  This function use to wait for the asynchronous transfer to finish.
+ *
+ *  @param[in]    sdh           Select SDH0 or SDH1.
+ *
+ *  @return   Status of the transfer started by \ref SDH_ReadAsync / \ref SDH_WriteAsync,
+ *            \ref SDH_NO_SD_CARD if the card was removed, or \ref SDH_ERR_TIMEOUT if it did not
+ *            finish. Returns at once with the last status if no transfer is in progress.
+ *
+ *  @details  Sends the stop command, or deselects the card after an error, if the transfer
+ *            still needs it. After a write, also waits until the card has programmed the data.
+ *            Call from task context, not from the completion callback.
+ */
+uint32_t SDH_WaitAsync(SDH_T *sdh)
+{
+    uint32_t status, u32Left;
+    uint32_t u32TimeOutCount = SDH_TIMEOUT_CNT;
+    SDH_INFO_T *pSD;
+
+    if(sdh == SDH0)
     {
-        sdh->CMDARG = u32StartSec;
+        pSD = &SD0;
     }
     else
     {
-        sdh->CMDARG = u32StartSec * SDH_BLOCK_SIZE;  /* set start address for SD CMD */
+        pSD = &SD1;
     }
 
-    sdh->DMASA = (uint32_t)pu8BufAddr;
-    loop = u32SecCount / 255ul;   /* the maximum block count is 0xFF=255 for register SDCR[BLK_CNT] */
-    for(i = 0ul; i < loop; i++)
+    /* the time-out is per chunk, like SDH_Read */
+    u32Left = pSD->XferLeft;
+    while(pSD->AsyncBusy)
     {
-        pSD->DataReadyFlag = (uint8_t)FALSE;
-        reg = sdh->CTL & 0xff00c080;
-        reg = reg | 0xff0000ul;   /* set BLK_CNT to 0xFF=255 */
-        if(!bIsSendCmd)
+        if(pSD->IsCardInsert == FALSE)
         {
-            sdh->CTL = reg | (25ul << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DOEN_Msk);
-            bIsSendCmd = TRUE;
+            return SDH_XferAbort(sdh, pSD);
         }
-        else
+        if(pSD->XferLeft != u32Left)
         {
-            sdh->CTL = reg | SDH_CTL_DOEN_Msk;
+            u32Left = pSD->XferLeft;
+            u32TimeOutCount = SDH_TIMEOUT_CNT;
         }
-
-        u32TimeOutCount = SDH_TIMEOUT_CNT;
-        while(!pSD->DataReadyFlag)
+        if(--u32TimeOutCount == 0)
         {
-            if(pSD->IsCardInsert == FALSE)
-            {
-                return SDH_NO_SD_CARD;
-            }
-            if(--u32TimeOutCount == 0)
+            pSD->i32ErrCode = SDH_ERR_TIMEOUT;
+            pSD->AsyncBusy = (unsigned char)FALSE;
+            pSD->XferStatus = SDH_XferStop(sdh, pSD, SDH_ERR_TIMEOUT);
+            if(pSD->pfnCallback != NULL)
             {
-                pSD->i32ErrCode = SDH_ERR_TIMEOUT;
-                break;
+                pSD->pfnCallback(sdh, SDH_ERR_TIMEOUT, pSD->pvCallbackArg);
             }
+            return SDH_ERR_TIMEOUT;
         }
+    }
 
-        if((sdh->INTSTS & SDH_INTSTS_CRCIF_Msk) != 0ul)
-        {
-            sdh->INTSTS = SDH_INTSTS_CRCIF_Msk;
-            return SDH_CRC_ERROR;
-        }
+    if(pSD->IsCardInsert == FALSE)
+    {
+        return SDH_XferAbort(sdh, pSD);
     }
 
-    loop = u32SecCount % 255ul;
-    if(loop != 0ul)
+    status = SDH_XferEnd(sdh, pSD);
+    if((status == Successful) && pSD->IsSelected && (SDH_CheckRB(sdh) != Successful))
     {
-        pSD->DataReadyFlag = (uint8_t)FALSE;
-        reg = (sdh->CTL & 0xff00c080) | (loop << 16);
-        if(!bIsSendCmd)
-        {
-            sdh->CTL = reg | (25ul << 8) | (SDH_CTL_COEN_Msk | SDH_CTL_RIEN_Msk | SDH_CTL_DOEN_Msk);
-            bIsSendCmd = TRUE;
-        }
-        else
-        {
-            sdh->CTL = reg | SDH_CTL_DOEN_Msk;
-        }
+        status = SDH_ERR_TIMEOUT;
+    }
 
-        u32TimeOutCount = SDH_TIMEOUT_CNT;
-        while(!pSD->DataReadyFlag)
-        {
-            if(pSD->IsCardInsert == FALSE)
-            {
-                return SDH_NO_SD_CARD;
-            }
-            if(--u32TimeOutCount == 0)
-            {
-                pSD->i32ErrCode = SDH_ERR_TIMEOUT;
-                break;
-            }
-        }
+    return status;
+}
 
-        if((sdh->INTSTS & SDH_INTSTS_CRCIF_Msk) != 0ul)
-        {
-            sdh->INTSTS = SDH_INTSTS_CRCIF_Msk;
-            return SDH_CRC_ERROR;
-        }
+/**
+ *  @brief  This function use to advance an asynchronous transfer from the SDH interrupt.
+ *
+ *  @param[in]    sdh           Select SDH0 or SDH1.
+ *
+ *  @return None
+ *
+ *  @details  Call from SDHx_IRQHandler after setting DataReadyFlag on SDH_INTSTS_BLKDIF,
+ *            before SDH_INTSTS_CRCIF is cleared. Does nothing unless \ref SDH_ReadAsync or
+ *            \ref SDH_WriteAsync started a transfer. It only checks the CRC and starts the
+ *            next chunk; nothing here waits for the card. At the end of the data, the callback
+ *            is called and a CMD12 stop command or deselect is left to \ref SDH_WaitAsync.
+ */
+void SDH_AsyncIRQHandler(SDH_T *sdh)
+{
+    uint32_t status;
+    SDH_INFO_T *pSD;
+
+    if(sdh == SDH0)
+    {
+        pSD = &SD0;
+    }
+    else
+    {
+        pSD = &SD1;
     }
-    sdh->INTSTS = SDH_INTSTS_CRCIF_Msk;
 
-    if(SDH_SDCmdAndRsp(sdh, 12ul, 0ul, 0ul))       /* stop command */
+    if(!pSD->AsyncBusy || !pSD->DataReadyFlag)
     {
-        return SDH_CRC7_ERROR;
+        return;
     }
 
-    if(SDH_CheckRB(sdh) != Successful)
+    status = SDH_XferCheck(sdh, pSD);
+    if((status == Successful) && (pSD->XferLeft != 0ul))
     {
-        return SDH_ERR_TIMEOUT;
+        SDH_XferChunk(sdh, pSD, 0ul);
+        return;
     }
 
-    SDH_SDCommand(sdh, 7ul, 0ul);
-    sdh->CTL |= SDH_CTL_CLK8OEN_Msk;
-    u32TimeOutCount = SDH_TIMEOUT_CNT;
-    while((sdh->CTL & SDH_CTL_CLK8OEN_Msk) == SDH_CTL_CLK8OEN_Msk)
+    pSD->XferLeft = 0ul;
+    if(pSD->XferStop || (status != Successful))
     {
-        if(--u32TimeOutCount == 0)
+        pSD->XferEndPending = (unsigned char)TRUE;
+    }
+    else
+    {
+        sdh->INTSTS = SDH_INTSTS_CRCIF_Msk;
+    }
+    pSD->XferStatus = status;
+    pSD->AsyncBusy = (unsigned char)FALSE;
+
+    if(pSD->pfnCallback != NULL)
+    {
+        pSD->pfnCallback(sdh, status, pSD->pvCallbackArg);
+    }
+}
+
+/**
+ *  @brief  This function use to erase a range of sectors on SD card.
+ *
+ *  @param[in]    sdh           Select SDH0 or SDH1.
+ *  @param[in]    u32StartSec   The first sector to erase.
+ *  @param[in]    u32SecCount   The number of sectors to erase.
+ *
+ *  @return   \ref SDH_SELECT_ERROR : u32SecCount is zero. \n
+ *            \ref SDH_BUSY : An asynchronous transfer is in progress. \n
+ *            \ref SDH_ERR_TIMEOUT : Card stays busy. \n
+ *            \ref Successful : Erase command accepted and finished.
+ *
+ *  @details  Sends ERASE_WR_BLK_START/END and ERASE (CMD32/33/38, CMD35/36/38 for MMC).
+ *            Erased sectors read back as all 0s or all 1s depending on the card.
+ */
+uint32_t SDH_Erase(SDH_T *sdh, uint32_t u32StartSec, uint32_t u32SecCount)
+{
+    uint32_t status, u32Start, u32End;
+    uint32_t u32CmdStart = 32ul, u32CmdEnd = 33ul;
+    SDH_INFO_T *pSD;
+
+    if(sdh == SDH0)
+    {
+        pSD = &SD0;
+    }
+    else
+    {
+        pSD = &SD1;
+    }
+
+    pSD->i32ErrCode = 0;
+
+    if(u32SecCount == 0ul)
+    {
+        return SDH_SELECT_ERROR;
+    }
+
+    u32Start = u32StartSec;
+    u32End = u32StartSec + u32SecCount - 1ul;
+    if((pSD->CardType != SDH_TYPE_SD_HIGH) && (pSD->CardType != SDH_TYPE_EMMC))
+    {
+        u32Start *= SDH_BLOCK_SIZE;
+        u32End *= SDH_BLOCK_SIZE;
+    }
+    if((pSD->CardType == SDH_TYPE_MMC) || (pSD->CardType == SDH_TYPE_EMMC))
+    {
+        u32CmdStart = 35ul;
+        u32CmdEnd = 36ul;
+    }
+
+    if(pSD->IsCardInsert == FALSE)
+    {
+        return SDH_XferAbort(sdh, pSD);
+    }
+
+    if(pSD->AsyncBusy)
+    {
+        return SDH_BUSY;
+    }
+
+    if((status = SDH_SelectCard(sdh, pSD)) != Successful)
+    {
+        return status;
+    }
+
+    if(((status = SDH_SDCmdAndRsp(sdh, u32CmdStart, u32Start, 0ul)) == Successful) &&
+            ((status = SDH_SDCmdAndRsp(sdh, u32CmdEnd, u32End, 0ul)) == Successful) &&
+            ((status = SDH_SDCmdAndRsp(sdh, 38ul, 0ul, 0ul)) == Successful))
+    {
+        /* the card holds DAT0 low until the erase is done */
+        if(SDH_CheckRB(sdh) != Successful)
         {
-            pSD->i32ErrCode = SDH_ERR_TIMEOUT;
-            break;
+            status = SDH_ERR_TIMEOUT;
         }
     }
 
-    if(pSD->i32ErrCode != 0)
-        return Fail;
+    if(status == SDH_NO_SD_CARD)
+    {
+        SDH_XferAbort(sdh, pSD);
+    }
+    else if(status != Successful)
+    {
+        SDH_DeselectCard(sdh, pSD);
+    }
 
-    return Successful;
+    return status;
 }
 
 /*@}*/ /* end of group SDH_EXPORTED_FUNCTIONS */
@@ -0,0 +1,49 @@
+/*
+ * NuMicro.h for the host build of the USB Host library.
+ *
+ * Pulls in the real USBH (OHCI) and HSUSBH (EHCI) register layouts and
+ * points the library at the register model of usbh_sim.c instead of the
+ * peripheral addresses. The NVIC enables and PRIMASK are simulated too,
+ * so the interrupt handlers run only where the library lets them, and
+ * the MSC device lock is a mutex of the simulated scheduler.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __NUMICRO_H__
+#define __NUMICRO_H__
+
+#include <stdint.h>
+
+#define __I         volatile const
+#define __O         volatile
+#define __IO        volatile
+#define __ALIGNED(x)        __attribute__((aligned(x)))
+#define __STATIC_INLINE     static inline
+
+#include "usbh_reg.h"
+#include "hsusbh_reg.h"
+
+/* Register window of usbh_sim.c: EHCI at +0, OHCI at +0x1000 */
+extern uint8_t *g_pu8UsbhSimRegs;
+#define USBH_EHCI_REGS      ((HSUSBH_T *)g_pu8UsbhSimRegs)
+#define USBH_OHCI_REGS      ((USBH_T *)(g_pu8UsbhSimRegs + 0x1000))
+
+void usbh_sim_irq_enable(int ehci, int enable);
+#define ENABLE_OHCI_IRQ()   usbh_sim_irq_enable(0, 1)
+#define DISABLE_OHCI_IRQ()  usbh_sim_irq_enable(0, 0)
+#define ENABLE_EHCI_IRQ()   usbh_sim_irq_enable(1, 1)
+#define DISABLE_EHCI_IRQ()  usbh_sim_irq_enable(1, 0)
+
+/* MSC per-device lock on the mutex of the simulated scheduler */
+#define USBH_MSC_LOCK_T             usbh_sim_mutex_t
+#define USBH_MSC_LOCK_INIT(lock)    usbh_sim_mutex_init(lock)
+#define USBH_MSC_LOCK_DEINIT(lock)
+#define USBH_MSC_LOCK(lock)         usbh_sim_mutex_lock(lock)
+#define USBH_MSC_UNLOCK(lock)       usbh_sim_mutex_unlock(lock)
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+#endif /* __NUMICRO_H__ */
@@ -0,0 +1,298 @@
+/*
+ * HID, CDC and UAC driver tests on the simulated EHCI and OHCI.
+ *
+ * An HS hub on root port 1 carries an FS mouse, an HS CDC ACM loopback and
+ * an FS microphone, so the mouse and the microphone go through split
+ * transactions (interrupt QH and siTD). A second mouse and microphone
+ * sit on root port 2, which only OHCI serves. Reports, looped bytes and
+ * audio packets must all arrive, at the rate the endpoints ask for.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "NuMicro.h"
+#include "usbh_lib.h"
+#include "usbh_cdc.h"
+#include "usbh_hid.h"
+#include "usbh_uac.h"
+#include "usbh_sim.h"
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+#define MAX_DEV     2
+
+static uint32_t s_live_base[SIM_DESC_TYPES];
+
+/* What the callbacks saw, per device in list order */
+static struct usbhid_dev *s_hid[MAX_DEV];
+static int s_hid_reports[MAX_DEV], s_hid_errors;
+static uint8_t s_hid_last[MAX_DEV][8];
+
+static uint8_t s_cdc_rx[8192];
+static int s_cdc_rx_len;
+
+static struct uac_dev_t *s_uac[MAX_DEV];
+static uint32_t s_uac_bytes[MAX_DEV];
+
+static void settle(uint64_t us)
+{
+    uint64_t end = usbh_sim_time_us() + us;
+
+    while (usbh_sim_time_us() < end)
+    {
+        usbh_pooling_hubs();
+        usbh_sim_sleep_us(10000);
+    }
+}
+
+static int wait_configured(vdev_t **devs, int n, uint64_t limit_us)
+{
+    uint64_t end = usbh_sim_time_us() + limit_us;
+    int i, done;
+
+    for (;;)
+    {
+        usbh_pooling_hubs();
+        for (i = 0, done = 0; i < n; i++)
+            done += devs[i]->config != 0;
+        if (done == n)
+            return 0;
+        if (usbh_sim_time_us() > end)
+            return -1;
+        usbh_sim_sleep_us(10000);
+    }
+}
+
+static int live_at_base(void)
+{
+    const usbh_sim_stats_t *st = usbh_sim_stats();
+    int i;
+
+    for (i = 0; i < SIM_DESC_TYPES; i++)
+    {
+        if (st->live[i] != s_live_base[i])
+        {
+            printf("  descriptor type %d: %u live, %u after init\n",
+                   i, st->live[i], s_live_base[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void hid_read(struct usbhid_dev *hdev, uint16_t ep_addr, int status, uint8_t *rdata, uint32_t data_len)
+{
+    int i;
+
+    if (status != 0)
+    {
+        s_hid_errors++;
+        return;
+    }
+    for (i = 0; i < MAX_DEV; i++)
+    {
+        if (s_hid[i] == hdev)
+        {
+            s_hid_reports[i]++;
+            memcpy(s_hid_last[i], rdata, data_len < 8 ? data_len : 8);
+        }
+    }
+}
+
+static void cdc_rx(struct cdc_dev_t *cdev, uint8_t *rdata, int data_len)
+{
+    if (s_cdc_rx_len + data_len <= (int)sizeof(s_cdc_rx))
+        memcpy(s_cdc_rx + s_cdc_rx_len, rdata, data_len);
+    s_cdc_rx_len += data_len;
+}
+
+static int uac_in(struct uac_dev_t *dev, uint8_t *data, int len)
+{
+    int i;
+
+    for (i = 0; i < MAX_DEV; i++)
+        if (s_uac[i] == dev)
+            s_uac_bytes[i] += len;
+    return 0;
+}
+
+/* Which of the two mouse models a library device is */
+static vdev_t *hid_vdev(struct usbhid_dev *hdev, vdev_t *fs, vdev_t *ls)
+{
+    return ((IFACE_T *)hdev->iface)->udev->speed == SPEED_LOW ? ls : fs;
+}
+
+static void test_hid(vdev_t *fs, vdev_t *ls)
+{
+    static const uint8_t rep[4] = { 0x01, 0x05, 0xFB, 0x00 };
+    struct usbhid_dev *hdev;
+    vdev_t *mice[MAX_DEV];
+    uint32_t polls[MAX_DEV];
+    int i, n;
+
+    for (n = 0, hdev = usbh_hid_get_device_list(); hdev && n < MAX_DEV; hdev = hdev->next)
+    {
+        s_hid[n] = hdev;
+        mice[n] = hid_vdev(hdev, fs, ls);
+        CHECK(usbh_hid_start_int_read(hdev, 0, hid_read) == 0);
+        n++;
+    }
+    CHECK(n == 2);
+
+    for (i = 0; i < n; i++)
+    {
+        polls[i] = mice[i]->int_polls;
+        vdev_hid_push(mice[i], rep, 4);
+        vdev_hid_push(mice[i], rep, 4);
+        vdev_hid_push(mice[i], rep, 4);
+    }
+    settle(1000000);
+
+    /* both endpoints have bInterval 8: 8 ms on full and low speed */
+    for (i = 0; i < n; i++)
+    {
+        polls[i] = mice[i]->int_polls - polls[i];
+        printf("  %s mouse: %d reports, %u polls in 1 s\n",
+               mice[i] == ls ? "LS (OHCI)" : "FS (split)", s_hid_reports[i], polls[i]);
+        CHECK(s_hid_reports[i] == 3);
+        CHECK(memcmp(s_hid_last[i], rep, 4) == 0);
+        CHECK(polls[i] >= 110 && polls[i] <= 130);
+        CHECK(mice[i]->toggle_errors == 0);
+    }
+    CHECK(s_hid_errors == 0);
+}
+
+static void test_cdc(vdev_t *acm)
+{
+    struct cdc_dev_t *cdev = usbh_cdc_get_device_list();
+    struct line_coding_t lc;
+    uint8_t tx[4096];
+    uint64_t end;
+    int i;
+
+    CHECK(cdev != NULL);
+    if (cdev == NULL)
+        return;
+    CHECK(usbh_cdc_get_line_coding(cdev, &lc) == 0);
+    lc.baud = 115200;
+    CHECK(usbh_cdc_set_line_coding(cdev, &lc) == 0);
+    CHECK(usbh_cdc_set_control_line_state(cdev, 1, 1) == 0);
+
+    for (i = 0; i < (int)sizeof(tx); i++)
+        tx[i] = (uint8_t)(i * 7);
+    s_cdc_rx_len = 0;
+    for (i = 0; i < (int)sizeof(tx); i += 512)
+    {
+        CHECK(usbh_cdc_send_data(cdev, tx + i, 512) == 0);
+        end = usbh_sim_time_us() + 100000;
+        while (s_cdc_rx_len < i + 512 && usbh_sim_time_us() < end)
+        {
+            if (!cdev->rx_busy)
+                usbh_cdc_start_to_receive_data(cdev, cdc_rx);
+            usbh_sim_sleep_us(125);
+        }
+    }
+    CHECK(s_cdc_rx_len == (int)sizeof(tx));
+    CHECK(memcmp(s_cdc_rx, tx, sizeof(tx)) == 0);
+    CHECK(vdev_cdc_looped(acm) == sizeof(tx));
+    CHECK(acm->toggle_errors == 0);
+}
+
+static void test_uac(vdev_t *split, vdev_t *ohci)
+{
+    struct uac_dev_t *uac;
+    vdev_t *mics[MAX_DEV];
+    int i, n;
+
+    for (n = 0, uac = usbh_uac_get_device_list(); uac && n < MAX_DEV; uac = uac->next)
+    {
+        s_uac[n] = uac;
+        mics[n] = uac->udev->parent ? split : ohci;
+        CHECK(usbh_uac_start_audio_in(uac, uac_in) == 0);
+        n++;
+    }
+    CHECK(n == 2);
+
+    settle(1000000);
+    for (i = 0; i < n; i++)
+    {
+        printf("  mic %s: %u packets, %u bytes, longest gap %u frames\n",
+               mics[i] == split ? "behind hub (siTD)" : "on OHCI (ISO TD)",
+               vdev_uac_packets(mics[i]), s_uac_bytes[i], vdev_uac_max_gap(mics[i]));
+        /* one 96 byte packet a frame, after a few frames of setting up */
+        CHECK(vdev_uac_packets(mics[i]) >= 990);
+        CHECK(s_uac_bytes[i] >= 990 * 96);
+        CHECK(vdev_uac_max_gap(mics[i]) <= 1);
+    }
+    for (i = 0; i < n; i++)
+        CHECK(usbh_uac_stop_audio_in(s_uac[i]) == 0);
+    settle(100000);
+}
+
+static void run(void *arg)
+{
+    const usbh_sim_stats_t *st = usbh_sim_stats();
+    vdev_t *hub = vdev_hub_new(4);
+    vdev_t *devs[6];
+
+    devs[0] = hub;
+    devs[1] = vdev_hid_mouse_new(VDEV_SPEED_FULL);
+    devs[2] = vdev_cdc_acm_new(VDEV_SPEED_HIGH);
+    devs[3] = vdev_uac_mic_new();
+    devs[4] = vdev_hid_mouse_new(VDEV_SPEED_LOW);
+    devs[5] = vdev_uac_mic_new();
+    vdev_hub_attach(hub, 1, devs[1]);
+    vdev_hub_attach(hub, 2, devs[2]);
+    vdev_hub_attach(hub, 3, devs[3]);
+
+    usbh_core_init();
+    usbh_hid_init();
+    usbh_cdc_init();
+    usbh_uac_init();
+    memcpy(s_live_base, st->live, sizeof(s_live_base));
+
+    usbh_sim_attach(0, hub);
+    usbh_sim_attach(1, devs[4]);
+    CHECK(wait_configured(devs, 5, 5000000) == 0);
+
+    test_hid(devs[1], devs[4]);
+    test_cdc(devs[2]);
+
+    /* the second microphone takes the OHCI only port from the mouse */
+    usbh_sim_detach(1);
+    settle(100000);
+    usbh_sim_attach(1, devs[5]);
+    CHECK(wait_configured(devs + 5, 1, 2000000) == 0);
+    test_uac(devs[3], devs[5]);
+
+    usbh_sim_detach(0);
+    usbh_sim_detach(1);
+    settle(200000);
+    CHECK(live_at_base());
+    CHECK(st->double_frees == 0);
+    CHECK(st->stale_refs == 0);
+    CHECK(st->topology_errors == 0);
+    CHECK(st->obj_size_errors == 0);
+    CHECK(st->obj_bytes == 0);
+    printf("  descriptor peak: QH %u qTD %u siTD %u ED %u TD %u\n", st->peak[SIM_QH],
+           st->peak[SIM_QTD], st->peak[SIM_SITD], st->peak[SIM_ED], st->peak[SIM_TD]);
+}
+
+int main(void)
+{
+    CHECK(usbh_sim_run(run, NULL, 60000000ULL) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
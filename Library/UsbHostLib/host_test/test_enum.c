@@ -0,0 +1,236 @@
+/*
+ * Enumeration tests for src_core on the simulated EHCI and OHCI.
+ *
+ * Devices are plugged into the root ports directly and behind an HS hub.
+ * The tests check that every device gets configured through the right
+ * controller, that the hub status endpoint is polled at its bInterval,
+ * and that unplugging returns every QH/qTD/ED/TD to the pools without
+ * the controllers ever reaching a freed descriptor.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "NuMicro.h"
+#include "usbh_lib.h"
+#include "usbh_sim.h"
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+static uint32_t s_live_base[SIM_DESC_TYPES];
+
+static int s_conn, s_disconn;
+
+static void on_conn(struct udev_t *udev, int param)
+{
+    s_conn++;
+}
+
+static void on_disconn(struct udev_t *udev, int param)
+{
+    s_disconn++;
+}
+
+/* Poll the hubs the way the samples do until all devices are configured */
+static int wait_configured(vdev_t **devs, int n, uint64_t limit_us)
+{
+    uint64_t end = usbh_sim_time_us() + limit_us;
+    int i, done;
+
+    for (;;)
+    {
+        usbh_pooling_hubs();
+        for (i = 0, done = 0; i < n; i++)
+            done += devs[i]->config != 0;
+        if (done == n)
+            return 0;
+        if (usbh_sim_time_us() > end)
+            return -1;
+        usbh_sim_sleep_us(10000);
+    }
+}
+
+static void settle(uint64_t us)
+{
+    uint64_t end = usbh_sim_time_us() + us;
+
+    while (usbh_sim_time_us() < end)
+    {
+        usbh_pooling_hubs();
+        usbh_sim_sleep_us(10000);
+    }
+}
+
+static int live_at_base(void)
+{
+    const usbh_sim_stats_t *st = usbh_sim_stats();
+    int i;
+
+    for (i = 0; i < SIM_DESC_TYPES; i++)
+    {
+        if (st->live[i] != s_live_base[i])
+        {
+            printf("  descriptor type %d: %u live, %u after init\n",
+                   i, st->live[i], s_live_base[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void report(const char *what, const usbh_sim_stats_t *a, const usbh_sim_stats_t *b)
+{
+    printf("  %-24s %6llu reg rd %5llu reg wr %5llu irq %6llu QH %5llu ED %5llu xact\n", what,
+           (unsigned long long)(b->reg_reads - a->reg_reads),
+           (unsigned long long)(b->reg_writes - a->reg_writes),
+           (unsigned long long)(b->ehci_irqs - a->ehci_irqs + b->ohci_irqs - a->ohci_irqs),
+           (unsigned long long)(b->qh_visits - a->qh_visits),
+           (unsigned long long)(b->ed_visits - a->ed_visits),
+           (unsigned long long)(b->transactions - a->transactions));
+}
+
+static void test_hs_root(void)
+{
+    vdev_t *disk = vdev_msc_new(VDEV_SPEED_HIGH, 2048);
+    usbh_sim_stats_t before = *usbh_sim_stats();
+
+    usbh_sim_attach(0, disk);
+    CHECK(wait_configured(&disk, 1, 2000000) == 0);
+    CHECK(disk->addr != 0);
+    CHECK(disk->config == 1);
+    CHECK(s_conn == 1);
+    CHECK(usbh_sim_stats()->ohci_irqs == before.ohci_irqs);
+    report("HS disk on root", &before, usbh_sim_stats());
+
+    usbh_sim_detach(0);
+    settle(100000);
+    CHECK(s_disconn == 1);
+    CHECK(live_at_base());
+    vdev_free(disk);
+}
+
+static void test_fs_root(void)
+{
+    vdev_t *mouse = vdev_hid_mouse_new(VDEV_SPEED_FULL);
+    vdev_t *ls = vdev_hid_mouse_new(VDEV_SPEED_LOW);
+    usbh_sim_stats_t before = *usbh_sim_stats();
+
+    /* port 0 goes to OHCI after the EHCI reset finds no HS chirp */
+    usbh_sim_attach(0, mouse);
+    CHECK(wait_configured(&mouse, 1, 2000000) == 0);
+    CHECK(usbh_sim_stats()->ed_visits > before.ed_visits);
+    report("FS mouse on root", &before, usbh_sim_stats());
+
+    before = *usbh_sim_stats();
+    usbh_sim_attach(1, ls);
+    CHECK(wait_configured(&ls, 1, 2000000) == 0);
+    report("LS mouse on root port 2", &before, usbh_sim_stats());
+
+    usbh_sim_detach(0);
+    usbh_sim_detach(1);
+    settle(100000);
+    CHECK(s_disconn == 3);
+    CHECK(live_at_base());
+
+    /* and back again on the same port */
+    usbh_sim_attach(0, mouse);
+    CHECK(wait_configured(&mouse, 1, 2000000) == 0);
+    usbh_sim_detach(0);
+    settle(100000);
+    CHECK(live_at_base());
+    vdev_free(mouse);
+    vdev_free(ls);
+}
+
+static void test_hub(void)
+{
+    vdev_t *hub = vdev_hub_new(4);
+    vdev_t *devs[4];
+    usbh_sim_stats_t before = *usbh_sim_stats();
+    uint32_t polls;
+    uint64_t t0;
+    int i, gone;
+
+    devs[0] = hub;
+    devs[1] = vdev_hid_mouse_new(VDEV_SPEED_FULL);
+    devs[2] = vdev_msc_new(VDEV_SPEED_HIGH, 2048);
+    devs[3] = vdev_hid_mouse_new(VDEV_SPEED_LOW);
+    vdev_hub_attach(hub, 1, devs[1]);
+    vdev_hub_attach(hub, 2, devs[2]);
+    vdev_hub_attach(hub, 4, devs[3]);
+
+    usbh_sim_attach(0, hub);
+    CHECK(wait_configured(devs, 4, 5000000) == 0);
+    CHECK(usbh_sim_stats()->topology_errors == before.topology_errors);
+    CHECK(usbh_sim_stats()->ohci_irqs == before.ohci_irqs);
+    report("HS hub, FS+HS+LS below", &before, usbh_sim_stats());
+
+    /* The status endpoint has bInterval 12: 2^11 microframes, 256 ms */
+    polls = hub->int_polls;
+    t0 = usbh_sim_time_us();
+    settle(2000000);
+    polls = hub->int_polls - polls;
+    printf("  hub status polls: %u in %llu ms\n", polls,
+           (unsigned long long)(usbh_sim_time_us() - t0) / 1000);
+    CHECK(polls >= 6 && polls <= 10);
+
+    /* a device on a hub port goes and comes back */
+    before = *usbh_sim_stats();
+    gone = s_disconn;
+    vdev_hub_detach(hub, 4);
+    settle(600000);
+    CHECK(s_disconn == gone + 1);
+    vdev_hub_attach(hub, 4, devs[3]);
+    CHECK(wait_configured(devs, 4, 2000000) == 0);
+    report("LS replug behind hub", &before, usbh_sim_stats());
+
+    for (i = 0; i < 4; i++)
+        CHECK(devs[i]->toggle_errors == 0);
+
+    usbh_sim_detach(0);
+    settle(100000);
+    CHECK(live_at_base());
+    vdev_free(devs[1]);
+    vdev_free(devs[2]);
+    vdev_free(devs[3]);
+    vdev_free(hub);
+}
+
+static void run(void *arg)
+{
+    const usbh_sim_stats_t *st = usbh_sim_stats();
+
+    usbh_core_init();
+    usbh_install_conn_callback(on_conn, on_disconn);
+    memcpy(s_live_base, st->live, sizeof(s_live_base));
+
+    test_hs_root();
+    test_fs_root();
+    test_hub();
+
+    CHECK(st->double_frees == 0);
+    CHECK(st->stale_refs == 0);
+    CHECK(st->topology_errors == 0);
+    CHECK(st->obj_size_errors == 0);
+    CHECK(st->obj_bytes == 0);
+    printf("  descriptor peak: QH %u qTD %u ED %u TD %u\n",
+           st->peak[SIM_QH], st->peak[SIM_QTD], st->peak[SIM_ED], st->peak[SIM_TD]);
+}
+
+int main(void)
+{
+    CHECK(usbh_sim_run(run, NULL, 60000000ULL) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
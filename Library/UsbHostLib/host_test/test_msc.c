@@ -0,0 +1,390 @@
+/*
+ * Mass storage tests for src_msc on the simulated EHCI and OHCI.
+ *
+ * An HS disk on root port 1 goes through EHCI, an FS disk on root port 2
+ * through OHCI. Data written with usbh_umas_write() has to land in the
+ * disk image and read back unchanged, also when the disk NAKs for a
+ * while after each command. Two tasks then read two HS disks behind a
+ * hub at the same time, and two tasks share one disk through the MSC
+ * device lock; a disk pulled while a task waits on it must fail that
+ * task, not leave it to the transfer timeout. The throughput figures are
+ * simulated bus time, not a measurement on the M460.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "NuMicro.h"
+#include "usbh_lib.h"
+#include "usbh_sim.h"
+#include "usb.h"
+#include "msc.h"
+
+#define HS_DRV          3
+#define FS_DRV          4
+#define DISK_SECTORS    (16UL * 1024 * 1024 / 512)
+#define CHUNK_SECTORS   64
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+static uint32_t s_au32Buf[2][CHUNK_SECTORS * 512 / 4];
+static uint32_t s_live_base[SIM_DESC_TYPES];
+
+extern MSC_T *g_msc_list;
+
+/* One reader or writer task */
+typedef struct
+{
+    int drv;
+    vdev_t *disk;
+    uint32_t lba;
+    int chunks;
+    int write;
+    uint32_t buf[CHUNK_SECTORS * 512 / 4];
+    uint64_t us;
+    int ret;
+} job_t;
+
+static void fill(uint8_t *p, size_t len, uint32_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        p[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+static int wait_disk(int drv, uint64_t limit_us)
+{
+    uint64_t end = usbh_sim_time_us() + limit_us;
+
+    while (usbh_umas_disk_status(drv) != 0)
+    {
+        if (usbh_sim_time_us() > end)
+            return -1;
+        usbh_pooling_hubs();
+        usbh_sim_sleep_us(10000);
+    }
+    return 0;
+}
+
+static void settle(uint64_t us)
+{
+    uint64_t end = usbh_sim_time_us() + us;
+
+    while (usbh_sim_time_us() < end)
+    {
+        usbh_pooling_hubs();
+        usbh_sim_sleep_us(10000);
+    }
+}
+
+static void check_rw(int drv, vdev_t *disk, uint32_t lba, int count, uint32_t seed)
+{
+    uint8_t *wr = (uint8_t *)s_au32Buf[0], *rd = (uint8_t *)s_au32Buf[1];
+
+    fill(wr, count * 512, seed);
+    CHECK(usbh_umas_write(drv, lba, count, wr) == 0);
+    CHECK(memcmp(vdev_msc_image(disk) + lba * 512, wr, count * 512) == 0);
+    memset(rd, 0, count * 512);
+    CHECK(usbh_umas_read(drv, lba, count, rd) == 0);
+    CHECK(memcmp(rd, wr, count * 512) == 0);
+}
+
+/* Read 1 MB in CHUNK_SECTORS pieces and report the simulated rate */
+static void seq_read(const char *what, int drv, vdev_t *disk)
+{
+    usbh_sim_stats_t a = *usbh_sim_stats();
+    const usbh_sim_stats_t *b = usbh_sim_stats();
+    uint32_t cmds = vdev_msc_commands(disk), lba;
+    uint64_t t0 = usbh_sim_time_us(), us;
+    int ok = 1;
+
+    for (lba = 0; lba < 2048; lba += CHUNK_SECTORS)
+        ok &= usbh_umas_read(drv, lba, CHUNK_SECTORS, (uint8_t *)s_au32Buf[1]) == 0;
+    CHECK(ok);
+    us = usbh_sim_time_us() - t0;
+    cmds = vdev_msc_commands(disk) - cmds;
+
+    printf("  %-22s %6.2f MB/s  %5.1f reg acc/KB  %5.1f irq/cmd  %5.1f qTD/cmd  %5.1f TD/cmd\n",
+           what, 1024.0 * 1024 / (double)us,
+           (double)(b->reg_reads - a.reg_reads + b->reg_writes - a.reg_writes) / 1024,
+           (double)(b->ehci_irqs - a.ehci_irqs + b->ohci_irqs - a.ohci_irqs) / cmds,
+           (double)(b->qtd_retired - a.qtd_retired) / cmds,
+           (double)(b->td_retired - a.td_retired) / cmds);
+}
+
+static void job_run(void *arg)
+{
+    job_t *j = arg;
+    uint64_t t0 = usbh_sim_time_us();
+    int i, ret;
+
+    j->ret = 0;
+    for (i = 0; i < j->chunks && j->ret == 0; i++)
+    {
+        uint8_t *p = (uint8_t *)j->buf;
+        uint32_t lba = j->lba + i * CHUNK_SECTORS;
+
+        if (j->write)
+        {
+            fill(p, CHUNK_SECTORS * 512, lba);
+            ret = usbh_umas_write(j->drv, lba, CHUNK_SECTORS, p);
+            if (ret == 0 && memcmp(vdev_msc_image(j->disk) + lba * 512, p, CHUNK_SECTORS * 512))
+                ret = -1;
+        }
+        else
+        {
+            ret = usbh_umas_read(j->drv, lba, CHUNK_SECTORS, p);
+            if (ret == 0 && memcmp(vdev_msc_image(j->disk) + lba * 512, p, CHUNK_SECTORS * 512))
+                ret = -1;
+        }
+        j->ret = ret;
+    }
+    j->us = usbh_sim_time_us() - t0;
+}
+
+static double mbps(const job_t *j)
+{
+    return (double)j->chunks * CHUNK_SECTORS * 512 / (double)j->us;
+}
+
+static usbh_sim_mutex_t *drive_lock(int drv)
+{
+    MSC_T *msc;
+
+    for (msc = g_msc_list; msc != NULL; msc = msc->next)
+        if (msc->drv_no == drv)
+            return &msc->root_msc->lock;
+    return NULL;
+}
+
+static void test_hs_disk(vdev_t *disk)
+{
+    uint32_t naks;
+
+    CHECK(wait_disk(HS_DRV, 3000000) == 0);
+    check_rw(HS_DRV, disk, 0, 1, 1);
+    check_rw(HS_DRV, disk, 100, CHUNK_SECTORS, 2);
+    check_rw(HS_DRV, disk, DISK_SECTORS - 7, 7, 3);
+    /* past the end: the disk fails the command, the driver reports it */
+    CHECK(usbh_umas_read(HS_DRV, DISK_SECTORS, 1, (uint8_t *)s_au32Buf[1]) != 0);
+    check_rw(HS_DRV, disk, 200, 3, 4);
+
+    seq_read("HS disk, EHCI", HS_DRV, disk);
+
+    /* 2 ms of NAKs after every command, the QH keeps retrying */
+    naks = usbh_sim_stats()->naks;
+    vdev_msc_latency(disk, 2000);
+    check_rw(HS_DRV, disk, 300, 16, 5);
+    CHECK(usbh_sim_stats()->naks > naks);
+    seq_read("HS disk, 2 ms latency", HS_DRV, disk);
+    vdev_msc_latency(disk, 0);
+    CHECK(disk->toggle_errors == 0);
+}
+
+static void test_fs_disk(vdev_t *disk)
+{
+    CHECK(wait_disk(FS_DRV, 3000000) == 0);
+    check_rw(FS_DRV, disk, 0, 1, 11);
+    check_rw(FS_DRV, disk, 1000, CHUNK_SECTORS, 12);
+    seq_read("FS disk, OHCI", FS_DRV, disk);
+    CHECK(disk->toggle_errors == 0);
+}
+
+/*
+ * Pull a disk while one task waits for its data and a second one waits
+ * for the device lock: the disk NAKs for 2 s after each command, the 5 s
+ * transfer timeout is far away. Both have to fail at once, and the MSC
+ * instance must live until they are out of the driver.
+ */
+static void pull_under_io(const char *what, int drv, vdev_t *disk, vdev_t *hub, int port)
+{
+    static job_t j[2];
+    usbh_sim_task_t *t[2];
+    uint64_t t0;
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        j[i].drv = drv;
+        j[i].disk = disk;
+        j[i].lba = i * CHUNK_SECTORS;
+        j[i].chunks = 1;
+        j[i].write = 0;
+    }
+    vdev_msc_latency(disk, 2000000);
+    t[0] = usbh_sim_task_create(job_run, &j[0]);
+    t[1] = usbh_sim_task_create(job_run, &j[1]);
+    usbh_sim_sleep_us(50000);
+
+    t0 = usbh_sim_time_us();
+    if (hub)
+        vdev_hub_detach(hub, port);
+    else
+        usbh_sim_detach(port);
+    while ((!usbh_sim_task_done(t[0]) || !usbh_sim_task_done(t[1])) &&
+            usbh_sim_time_us() - t0 < 3000000)
+    {
+        usbh_pooling_hubs();
+        usbh_sim_sleep_us(10000);
+    }
+    CHECK(usbh_sim_task_done(t[0]) && usbh_sim_task_done(t[1]));
+    usbh_sim_task_join(t[0]);
+    usbh_sim_task_join(t[1]);
+    printf("  %s pulled under 2 reads: both failed after %.1f ms\n", what,
+           (double)(usbh_sim_time_us() - t0) / 1000);
+    CHECK(j[0].ret != 0 && j[1].ret != 0);
+    CHECK(usbh_umas_disk_status(drv) != 0);
+    vdev_msc_latency(disk, 0);
+}
+
+/*
+ * Two HS disks behind an HS hub on root port 1: 1 MB from each, first
+ * one at a time and then from two tasks at once.
+ */
+static void test_parallel(void)
+{
+    static job_t ja, jb;
+    const usbh_sim_stats_t *st = usbh_sim_stats();
+    vdev_t *hub = vdev_hub_new(4);
+    vdev_t *da = vdev_msc_new(VDEV_SPEED_HIGH, DISK_SECTORS);
+    vdev_t *db = vdev_msc_new(VDEV_SPEED_HIGH, DISK_SECTORS);
+    usbh_sim_task_t *ta, *tb;
+    usbh_sim_mutex_t *lock;
+    uint32_t contended;
+    uint64_t t0, us;
+
+    vdev_hub_attach(hub, 1, da);
+    vdev_hub_attach(hub, 2, db);
+    usbh_sim_attach(0, hub);
+    CHECK(wait_disk(HS_DRV, 5000000) == 0);
+    CHECK(wait_disk(FS_DRV, 5000000) == 0);
+
+    /* which drive number went to which disk */
+    fill((uint8_t *)s_au32Buf[0], 512, 31);
+    CHECK(usbh_umas_write(HS_DRV, 0, 1, (uint8_t *)s_au32Buf[0]) == 0);
+    ja.drv = HS_DRV;
+    jb.drv = FS_DRV;
+    ja.disk = memcmp(vdev_msc_image(da), s_au32Buf[0], 512) == 0 ? da : db;
+    jb.disk = ja.disk == da ? db : da;
+    ja.lba = jb.lba = 0;
+    ja.chunks = jb.chunks = 2048 / CHUNK_SECTORS;
+    ja.write = jb.write = 0;
+
+    job_run(&ja);
+    CHECK(ja.ret == 0);
+    us = ja.us;
+
+    t0 = usbh_sim_time_us();
+    ta = usbh_sim_task_create(job_run, &ja);
+    tb = usbh_sim_task_create(job_run, &jb);
+    usbh_sim_task_join(ta);
+    usbh_sim_task_join(tb);
+    CHECK(ja.ret == 0);
+    CHECK(jb.ret == 0);
+    printf("  2 HS disks behind hub: one alone %.2f MB/s; together %.2f + %.2f MB/s, "
+           "2 MB in %.1f ms\n", 1024.0 * 1024 / (double)us, mbps(&ja), mbps(&jb),
+           (double)(usbh_sim_time_us() - t0) / 1000);
+    /* the two async QHs share the microframes, neither task starves */
+    CHECK(ja.us < 3 * us && jb.us < 3 * us);
+
+    /* two tasks on one disk, different regions, through the device lock */
+    lock = drive_lock(HS_DRV);
+    CHECK(lock != NULL);
+    contended = lock ? lock->contended : 0;
+    jb = ja;
+    ja.write = jb.write = 1;
+    ja.chunks = jb.chunks = 8;
+    jb.lba = 4096;
+    ta = usbh_sim_task_create(job_run, &ja);
+    tb = usbh_sim_task_create(job_run, &jb);
+    usbh_sim_task_join(ta);
+    usbh_sim_task_join(tb);
+    CHECK(ja.ret == 0);
+    CHECK(jb.ret == 0);
+    CHECK(lock != NULL && lock->contended > contended);
+    CHECK(ja.disk->toggle_errors == 0 && jb.disk->toggle_errors == 0);
+
+    pull_under_io("HS disk behind hub", FS_DRV, jb.disk == da ? db : da,
+                  hub, jb.disk == da ? 2 : 1);
+    CHECK(usbh_umas_disk_status(HS_DRV) == 0);
+
+    usbh_sim_detach(0);
+    settle(100000);
+    CHECK(memcmp(st->live, s_live_base, sizeof(s_live_base)) == 0);
+    vdev_free(da);
+    vdev_free(db);
+    vdev_free(hub);
+}
+
+static void run(void *arg)
+{
+    const usbh_sim_stats_t *st = usbh_sim_stats();
+    vdev_t *hs = vdev_msc_new(VDEV_SPEED_HIGH, DISK_SECTORS);
+    vdev_t *fs = vdev_msc_new(VDEV_SPEED_FULL, DISK_SECTORS);
+
+    uint32_t mem;
+
+    usbh_core_init();
+    usbh_umas_init();
+    memcpy(s_live_base, st->live, sizeof(s_live_base));
+    mem = usbh_memory_used();
+
+    usbh_sim_attach(0, hs);
+    test_hs_disk(hs);
+    usbh_sim_attach(1, fs);
+    test_fs_disk(fs);
+
+    /* and the first disk still works with the second one plugged in */
+    check_rw(HS_DRV, hs, 500, CHUNK_SECTORS, 21);
+    check_rw(FS_DRV, fs, 500, CHUNK_SECTORS, 22);
+
+    usbh_sim_detach(0);
+    usbh_sim_detach(1);
+    settle(100000);
+    CHECK(usbh_umas_disk_status(HS_DRV) != 0);
+    CHECK(usbh_umas_disk_status(FS_DRV) != 0);
+    CHECK(memcmp(st->live, s_live_base, sizeof(s_live_base)) == 0);
+    vdev_free(hs);
+    vdev_free(fs);
+
+    test_parallel();
+
+    /* on OHCI the ED is only taken off the lists at the next frame */
+    fs = vdev_msc_new(VDEV_SPEED_FULL, DISK_SECTORS);
+    usbh_sim_attach(1, fs);
+    CHECK(wait_disk(HS_DRV, 3000000) == 0);
+    pull_under_io("FS disk on OHCI", HS_DRV, fs, NULL, 1);
+    settle(100000);
+    CHECK(memcmp(st->live, s_live_base, sizeof(s_live_base)) == 0);
+    vdev_free(fs);
+
+    /* every UTR and MSC instance went back */
+    CHECK(usbh_memory_used() == mem);
+    CHECK(st->double_frees == 0);
+    CHECK(st->stale_refs == 0);
+    CHECK(st->topology_errors == 0);
+    CHECK(st->obj_size_errors == 0);
+    CHECK(st->obj_bytes == 0);
+}
+
+int main(void)
+{
+    CHECK(usbh_sim_run(run, NULL, 120000000ULL) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
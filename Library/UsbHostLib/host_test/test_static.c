@@ -0,0 +1,239 @@
+/*
+ * STATIC_MEMORY_ALLOC tests on the simulated EHCI and OHCI.
+ *
+ * The library is built a second time with STATIC_MEMORY_ALLOC=1 and
+ * linked with malloc, calloc, realloc and free wrapped. After
+ * usbh_core_init() and the class driver inits, no heap call may come
+ * from anywhere: devices are plugged in one by one, their class
+ * transfers are started, and then all of them work behind a hub at
+ * once. The arena use per device is printed in host sizes, which are
+ * larger than on the M460 (64-bit pointers).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "NuMicro.h"
+#include "usbh_lib.h"
+#include "usbh_cdc.h"
+#include "usbh_hid.h"
+#include "usbh_uac.h"
+#include "usbh_sim.h"
+
+#define HS_DRV          3
+#define DISK_SECTORS    2048
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+/* Heap trap, armed after the library is initialised */
+static int s_trap, s_heap_calls;
+static void *s_heap_caller;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+static void heap_call(void *caller)
+{
+    if (s_trap && s_heap_calls++ == 0)
+        s_heap_caller = caller;
+}
+
+void *__wrap_malloc(size_t size)
+{
+    heap_call(__builtin_return_address(0));
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    heap_call(__builtin_return_address(0));
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    heap_call(__builtin_return_address(0));
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void *p)
+{
+    heap_call(__builtin_return_address(0));
+    __real_free(p);
+}
+
+static int s_hid_reports, s_cdc_rx_len;
+static uint32_t s_uac_bytes;
+static uint8_t s_buf[2][16 * 512];
+
+static void hid_read(struct usbhid_dev *hdev, uint16_t ep_addr, int status, uint8_t *rdata, uint32_t data_len)
+{
+    if (status == 0)
+        s_hid_reports++;
+}
+
+static void cdc_rx(struct cdc_dev_t *cdev, uint8_t *rdata, int data_len)
+{
+    s_cdc_rx_len += data_len;
+}
+
+static int uac_in(struct uac_dev_t *dev, uint8_t *data, int len)
+{
+    s_uac_bytes += len;
+    return 0;
+}
+
+static void settle(uint64_t us)
+{
+    uint64_t end = usbh_sim_time_us() + us;
+
+    while (usbh_sim_time_us() < end)
+    {
+        usbh_pooling_hubs();
+        usbh_sim_sleep_us(10000);
+    }
+}
+
+static int wait_configured(vdev_t **devs, int n, uint64_t limit_us)
+{
+    uint64_t end = usbh_sim_time_us() + limit_us;
+    int i, done;
+
+    for (;;)
+    {
+        usbh_pooling_hubs();
+        for (i = 0, done = 0; i < n; i++)
+            done += devs[i]->config != 0;
+        if (done == n)
+            return 0;
+        if (usbh_sim_time_us() > end)
+            return -1;
+        usbh_sim_sleep_us(10000);
+    }
+}
+
+/* Start the class transfers of whatever is connected, as an application would */
+static void start_class(void)
+{
+    struct usbhid_dev *hdev;
+    struct cdc_dev_t *cdev;
+    struct uac_dev_t *uac;
+
+    for (hdev = usbh_hid_get_device_list(); hdev; hdev = hdev->next)
+        CHECK(usbh_hid_start_int_read(hdev, 0, hid_read) == 0);
+    for (cdev = usbh_cdc_get_device_list(); cdev; cdev = cdev->next)
+        CHECK(usbh_cdc_start_to_receive_data(cdev, cdc_rx) == 0);
+    for (uac = usbh_uac_get_device_list(); uac; uac = uac->next)
+        CHECK(usbh_uac_start_audio_in(uac, uac_in) == 0);
+}
+
+/* Plug one device into root port 1 alone and report what it takes */
+static void footprint(const char *what, vdev_t *d)
+{
+    const usbh_sim_stats_t *st = usbh_sim_stats();
+    uint32_t enum_peak;
+
+    usbh_sim_reset_peaks();
+    usbh_sim_attach(0, d);
+    CHECK(wait_configured(&d, 1, 3000000) == 0);
+    settle(100000);
+    enum_peak = st->obj_peak_blocks;
+    start_class();
+    settle(100000);
+    printf("  %-12s %3u blocks connected, %3u in use, peak %3u; QH %u qTD %u siTD %u ED %u TD %u\n",
+           what, enum_peak, st->obj_blocks, st->obj_peak_blocks, st->peak[SIM_QH],
+           st->peak[SIM_QTD], st->peak[SIM_SITD], st->peak[SIM_ED], st->peak[SIM_TD]);
+    usbh_sim_detach(0);
+    settle(200000);
+    CHECK(st->obj_bytes == 0);
+}
+
+static void run(void *arg)
+{
+    const usbh_sim_stats_t *st = usbh_sim_stats();
+    vdev_t *hub = vdev_hub_new(4);
+    vdev_t *devs[5];
+    uint8_t tx[512];
+    int i;
+
+    devs[0] = hub;
+    devs[1] = vdev_msc_new(VDEV_SPEED_HIGH, DISK_SECTORS);
+    devs[2] = vdev_hid_mouse_new(VDEV_SPEED_FULL);
+    devs[3] = vdev_cdc_acm_new(VDEV_SPEED_HIGH);
+    devs[4] = vdev_uac_mic_new();
+    for (i = 0; i < (int)sizeof(tx); i++)
+        tx[i] = (uint8_t)i;
+    printf("  arena blocks of %d bytes, host sizes\n", USBH_SIM_MEM_BLOCK);
+
+    usbh_core_init();
+    usbh_umas_init();
+    usbh_hid_init();
+    usbh_cdc_init();
+    usbh_uac_init();
+    s_trap = 1;
+
+    footprint("hub", hub);
+    footprint("HS disk", devs[1]);
+    footprint("FS mouse", devs[2]);
+    footprint("HS CDC ACM", devs[3]);
+    footprint("FS mic", devs[4]);
+
+    /* everything at once, behind the hub */
+    for (i = 1; i < 5; i++)
+        vdev_hub_attach(hub, i, devs[i]);
+    usbh_sim_reset_peaks();
+    usbh_sim_attach(0, hub);
+    CHECK(wait_configured(devs, 5, 5000000) == 0);
+    while (usbh_umas_disk_status(HS_DRV) != 0 && usbh_sim_time_us() < 20000000)
+        settle(10000);
+    start_class();
+
+    memset(s_buf[0], 0x5A, sizeof(s_buf[0]));
+    CHECK(usbh_umas_write(HS_DRV, 8, 16, s_buf[0]) == 0);
+    CHECK(usbh_umas_read(HS_DRV, 8, 16, s_buf[1]) == 0);
+    CHECK(memcmp(s_buf[0], s_buf[1], sizeof(s_buf[0])) == 0);
+    CHECK(usbh_cdc_send_data(usbh_cdc_get_device_list(), tx, sizeof(tx)) == 0);
+    vdev_hid_push(devs[2], (const uint8_t *)"\x01\x02\x03\x00", 4);
+    settle(500000);
+    CHECK(s_hid_reports == 1);
+    CHECK(s_cdc_rx_len == (int)sizeof(tx));
+    CHECK(s_uac_bytes > 0);
+    printf("  all behind hub: %u blocks in use, peak %u; QH %u qTD %u siTD %u\n",
+           st->obj_blocks, st->obj_peak_blocks, st->peak[SIM_QH], st->peak[SIM_QTD],
+           st->peak[SIM_SITD]);
+
+    usbh_sim_detach(0);
+    settle(200000);
+    CHECK(st->obj_bytes == 0);
+    s_trap = 0;
+
+    if (s_heap_calls)
+        printf("  %d heap calls after init, first from %p\n", s_heap_calls, s_heap_caller);
+    CHECK(s_heap_calls == 0);
+    CHECK(st->double_frees == 0);
+    CHECK(st->stale_refs == 0);
+    CHECK(st->obj_size_errors == 0);
+    for (i = 0; i < 5; i++)
+        vdev_free(devs[i]);
+}
+
+int main(void)
+{
+    CHECK(usbh_sim_run(run, NULL, 60000000ULL) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
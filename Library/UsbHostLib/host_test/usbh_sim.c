@@ -0,0 +1,1796 @@
+/*
+ * EHCI and OHCI register models, simulated time and cooperative tasks.
+ *
+ * The register window g_pu8UsbhSimRegs is a PROT_NONE mapping of a memfd
+ * that is also mapped read/write for the models. A library access faults,
+ * the SIGSEGV handler opens the page and sets the trap flag, and SIGTRAP
+ * closes it again after the one instruction. Reads see the model state,
+ * writes are replayed through ehci_write()/ohci_write() so write-1-to-clear
+ * bits, self-clearing commands and port state machines behave as on the
+ * chip.
+ *
+ * The controllers keep 32-bit descriptor pointers, so the binary is linked
+ * non-PIE, malloc is kept off mmap and task stacks are MAP_32BIT.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define _GNU_SOURCE
+#include <malloc.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "NuMicro.h"
+#include "usb.h"
+#include "ehci.h"
+#include "ohci.h"
+#include "usbh_sim.h"
+
+extern void EHCI_IRQHandler(void);
+extern void OHCI_IRQHandler(void);
+
+#define REGS_SIZE           0x2000
+#define OHCI_BASE           0x1000
+#define PAGE                0x1000
+#define STACK_SIZE          (256 * 1024)
+
+/* Trapped reads without a yield that make up one microframe of polling */
+#define POLL_READS_PER_UFRAME   1000
+
+/* Wall clock guard against a library loop that never yields */
+#define WATCHDOG_S          120
+
+#define PTR(a)              ((void *)(uintptr_t)(a))
+#define ADDR(p)             ((uint32_t)(uintptr_t)(p))
+#define LINK(a)             PTR((a) & ~0x1FU)
+
+uint8_t *g_pu8UsbhSimRegs;              /* library view, always trapping */
+static uint8_t *s_regs;                 /* model view */
+
+#define E_OFF(m)            offsetof(HSUSBH_T, m)
+#define O_OFF(m)            (OHCI_BASE + offsetof(USBH_T, m))
+#define REG(off)            (*(volatile uint32_t *)(s_regs + (off)))
+#define EREG(m)             REG(E_OFF(m))
+#define OREG(m)             REG(O_OFF(m))
+#define UPSCR(p)            REG(E_OFF(UPSCR[0]) + 4 * (p))
+#define RHPORT(p)           REG(O_OFF(HcRhPortStatus[0]) + 4 * (p))
+
+#define ROOT_PORTS          2
+#define OHCI_RESET_US       10000
+
+static usbh_sim_stats_t s_stats;
+static int s_ready, s_verbose;
+
+/*---------------------------------------------------------------------------*/
+/* Tasks and time                                                            */
+/*---------------------------------------------------------------------------*/
+
+struct usbh_sim_task
+{
+    ucontext_t ctx;
+    void (*fn)(void *);
+    void *arg;
+    int done;
+    uint64_t wake_us;
+    uint32_t primask;
+    usbh_sim_task_t *next;
+};
+
+static usbh_sim_task_t *s_tasks, *s_cur, *s_main;
+static ucontext_t s_sched_ctx, s_host_ctx;
+static void *s_sched_stack;
+static uint64_t s_now, s_limit;
+static int s_timed_out;
+static uint32_t s_poll_reads;
+
+static uint32_t s_primask;
+static int s_in_isr;
+static int s_irq_en[2];                 /* NVIC enables, [0] OHCI, [1] EHCI */
+
+static void hw_step(void);
+static void deliver_irqs(void);
+
+static void *low_alloc(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+    if (p == MAP_FAILED)
+    {
+        perror("usbh_sim: mmap");
+        exit(2);
+    }
+    return p;
+}
+
+uint64_t usbh_sim_time_us(void)
+{
+    return s_now;
+}
+
+/* Give up the CPU until wake_us. Outside a task, or in an interrupt
+ * handler, there is nobody to switch to and the hardware runs in place. */
+static void sim_yield(uint64_t wake_us)
+{
+    usbh_sim_task_t *t = s_cur;
+
+    if (t == NULL || s_in_isr)
+    {
+        do
+            hw_step();
+        while (s_now < wake_us);
+        return;
+    }
+    if (s_primask)
+        s_stats.masked_yields++;
+    t->wake_us = wake_us;
+    t->primask = s_primask;
+    s_poll_reads = 0;
+    swapcontext(&t->ctx, &s_sched_ctx);
+    s_primask = t->primask;
+}
+
+void usbh_sim_sleep_us(uint64_t us)
+{
+    sim_yield(s_now + us);
+}
+
+uint32_t get_ticks(void)
+{
+    if (s_cur && !s_in_isr)
+        sim_yield(s_now);
+    return (uint32_t)(s_now / 10000);
+}
+
+void delay_us(int usec)
+{
+    sim_yield(s_now + (usec > 0 ? (uint64_t)usec : 0));
+}
+
+static void task_entry(void)
+{
+    usbh_sim_task_t *t = s_cur;
+
+    t->fn(t->arg);
+    t->done = 1;
+    swapcontext(&t->ctx, &s_sched_ctx);
+}
+
+usbh_sim_task_t *usbh_sim_task_create(void (*fn)(void *), void *arg)
+{
+    usbh_sim_task_t *t = calloc(1, sizeof(*t)), **pp;
+
+    t->fn = fn;
+    t->arg = arg;
+    t->wake_us = s_now;
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = low_alloc(STACK_SIZE);
+    t->ctx.uc_stack.ss_size = STACK_SIZE;
+    t->ctx.uc_link = NULL;
+    makecontext(&t->ctx, task_entry, 0);
+    for (pp = &s_tasks; *pp; pp = &(*pp)->next)
+        ;
+    *pp = t;
+    return t;
+}
+
+int usbh_sim_task_done(usbh_sim_task_t *t)
+{
+    return t->done;
+}
+
+void usbh_sim_task_join(usbh_sim_task_t *t)
+{
+    while (!t->done)
+        sim_yield(s_now + USBH_SIM_UFRAME_US);
+}
+
+static void sched_loop(void)
+{
+    usbh_sim_task_t *t;
+
+    while (!s_main->done)
+    {
+        if (s_now >= s_limit)
+        {
+            s_timed_out = 1;
+            break;
+        }
+        hw_step();
+        deliver_irqs();
+        for (t = s_tasks; t; t = t->next)
+        {
+            if (t->done || t->wake_us > s_now)
+                continue;
+            s_cur = t;
+            s_primask = t->primask;
+            swapcontext(&s_sched_ctx, &t->ctx);
+            s_cur = NULL;
+            s_primask = 0;
+            deliver_irqs();
+        }
+    }
+}
+
+static void sim_init(void);
+
+int usbh_sim_run(void (*main_fn)(void *), void *arg, uint64_t limit_us)
+{
+    sim_init();
+    s_main = usbh_sim_task_create(main_fn, arg);
+    s_limit = s_now + limit_us;
+    s_timed_out = 0;
+
+    getcontext(&s_sched_ctx);
+    s_sched_ctx.uc_stack.ss_sp = s_sched_stack;
+    s_sched_ctx.uc_stack.ss_size = STACK_SIZE;
+    s_sched_ctx.uc_link = &s_host_ctx;
+    makecontext(&s_sched_ctx, sched_loop, 0);
+    swapcontext(&s_host_ctx, &s_sched_ctx);
+
+    return s_timed_out ? -1 : 0;
+}
+
+void usbh_sim_mutex_init(usbh_sim_mutex_t *m)
+{
+    memset(m, 0, sizeof(*m));
+}
+
+void usbh_sim_mutex_lock(usbh_sim_mutex_t *m)
+{
+    if (m->owner && m->owner == s_cur)
+    {
+        m->count++;
+        return;
+    }
+    if (m->owner)
+        m->contended++;
+    while (m->owner)
+        sim_yield(s_now);
+    m->owner = s_cur;
+    m->count = 1;
+}
+
+void usbh_sim_mutex_unlock(usbh_sim_mutex_t *m)
+{
+    if (m->count > 0 && --m->count == 0)
+        m->owner = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Interrupts                                                                */
+/*---------------------------------------------------------------------------*/
+
+static int ehci_irq_pending(void)
+{
+    return (EREG(USTSR) & EREG(UIENR) & 0x3F) != 0;
+}
+
+static int ohci_irq_pending(void)
+{
+    uint32_t en = OREG(HcInterruptEnable);
+
+    return (en & USBH_HcInterruptEnable_MIE_Msk) && (OREG(HcInterruptStatus) & en & 0x7F);
+}
+
+static void deliver_irqs(void)
+{
+    uint32_t primask;
+
+    if (!s_ready || s_in_isr || s_primask)
+        return;
+    primask = s_primask;
+    s_in_isr = 1;
+    if (s_irq_en[1] && ehci_irq_pending())
+    {
+        s_stats.ehci_irqs++;
+        EHCI_IRQHandler();
+    }
+    if (s_irq_en[0] && ohci_irq_pending())
+    {
+        s_stats.ohci_irqs++;
+        OHCI_IRQHandler();
+    }
+    s_in_isr = 0;
+    s_primask = primask;
+}
+
+void usbh_sim_irq_enable(int ehci, int enable)
+{
+    s_irq_en[ehci ? 1 : 0] = enable;
+    if (enable && s_cur)
+        deliver_irqs();
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return s_primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+    s_primask = priMask & 1;
+    if (!s_primask && s_cur)
+        deliver_irqs();
+}
+
+void __disable_irq(void)
+{
+    s_primask = 1;
+}
+
+void __enable_irq(void)
+{
+    __set_PRIMASK(0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Descriptor bookkeeping                                                    */
+/*---------------------------------------------------------------------------*/
+
+#define LIVE_SLOTS          1024
+
+static struct
+{
+    uint32_t addr;                      /* 0: empty */
+    uint8_t type;
+} s_live[LIVE_SLOTS];
+
+static unsigned live_hash(uint32_t a)
+{
+    return ((a >> 5) * 2654435761u) >> 22;
+}
+
+static int live_find(uint32_t a)
+{
+    unsigned i = live_hash(a);
+
+    while (s_live[i].addr)
+    {
+        if (s_live[i].addr == a)
+            return (int)i;
+        i = (i + 1) & (LIVE_SLOTS - 1);
+    }
+    return -1;
+}
+
+static void desc_alloc(void *p, int type)
+{
+    uint32_t a = ADDR(p);
+    unsigned i;
+    int k;
+
+    if (p == NULL)
+        return;
+    k = live_find(a);
+    if (k >= 0)
+    {
+        /* handed out twice without a free */
+        s_stats.live[s_live[k].type]--;
+        s_live[k].type = (uint8_t)type;
+    }
+    else
+    {
+        for (i = live_hash(a); s_live[i].addr; i = (i + 1) & (LIVE_SLOTS - 1))
+            ;
+        s_live[i].addr = a;
+        s_live[i].type = (uint8_t)type;
+    }
+    if (++s_stats.live[type] > s_stats.peak[type])
+        s_stats.peak[type] = s_stats.live[type];
+}
+
+static void desc_free(void *p, int type)
+{
+    unsigned i, j, h;
+    int k = live_find(ADDR(p));
+
+    if (k < 0 || s_live[k].type != type)
+    {
+        s_stats.double_frees++;
+        return;
+    }
+    s_stats.live[type]--;
+
+    /* backward shift deletion keeps the probe chains intact */
+    i = (unsigned)k;
+    for (j = (i + 1) & (LIVE_SLOTS - 1); s_live[j].addr; j = (j + 1) & (LIVE_SLOTS - 1))
+    {
+        h = live_hash(s_live[j].addr);
+        if (((j - h) & (LIVE_SLOTS - 1)) >= ((j - i) & (LIVE_SLOTS - 1)))
+        {
+            s_live[i] = s_live[j];
+            i = j;
+        }
+    }
+    s_live[i].addr = 0;
+}
+
+/* The controller is about to use p as a descriptor of this type */
+static int desc_ok(const void *p, int type)
+{
+    int k = live_find(ADDR(p));
+
+    if (p == NULL || k < 0 || s_live[k].type != type)
+    {
+        s_stats.stale_refs++;
+        return 0;
+    }
+    return 1;
+}
+
+/* Allocator hooks, linked in with -Wl,--wrap */
+#define WRAP_ALLOC(fn, type, ...)                                           \
+    void *__real_alloc_##fn(__VA_ARGS__);                                   \
+    void __real_free_##fn(void *p);                                         \
+    void __wrap_free_##fn(void *p)                                          \
+    {                                                                       \
+        desc_free(p, type);                                                 \
+        __real_free_##fn(p);                                                \
+    }
+
+WRAP_ALLOC(ehci_QH, SIM_QH, void)
+WRAP_ALLOC(ehci_qTD, SIM_QTD, void *utr)
+WRAP_ALLOC(ehci_iTD, SIM_ITD, void)
+WRAP_ALLOC(ehci_siTD, SIM_SITD, void)
+WRAP_ALLOC(ohci_ED, SIM_ED, void)
+WRAP_ALLOC(ohci_TD, SIM_TD, void *utr)
+
+void *__wrap_alloc_ehci_QH(void)
+{
+    void *p = __real_alloc_ehci_QH();
+
+    desc_alloc(p, SIM_QH);
+    return p;
+}
+
+void *__wrap_alloc_ehci_qTD(void *utr)
+{
+    void *p = __real_alloc_ehci_qTD(utr);
+
+    desc_alloc(p, SIM_QTD);
+    return p;
+}
+
+void *__wrap_alloc_ehci_iTD(void)
+{
+    void *p = __real_alloc_ehci_iTD();
+
+    desc_alloc(p, SIM_ITD);
+    return p;
+}
+
+void *__wrap_alloc_ehci_siTD(void)
+{
+    void *p = __real_alloc_ehci_siTD();
+
+    desc_alloc(p, SIM_SITD);
+    return p;
+}
+
+void *__wrap_alloc_ohci_ED(void)
+{
+    void *p = __real_alloc_ohci_ED();
+
+    desc_alloc(p, SIM_ED);
+    return p;
+}
+
+void *__wrap_alloc_ohci_TD(void *utr)
+{
+    void *p = __real_alloc_ohci_TD(utr);
+
+    desc_alloc(p, SIM_TD);
+    return p;
+}
+
+/* Driver objects are counted, and poisoned when freed so a use after free
+ * faults. The size passed to usbh_free_mem() has to match the allocation. */
+#define MEM_BLOCKS(size)    ((size) > USBH_SIM_MEM_BLOCK ? \
+                             ((size) + USBH_SIM_MEM_BLOCK - 1) / USBH_SIM_MEM_BLOCK : 1)
+#define OBJ_SLOTS           1024
+
+static struct
+{
+    void *p;
+    int size;
+} s_obj[OBJ_SLOTS];
+
+void *__real_usbh_alloc_mem(int size);
+void *__wrap_usbh_alloc_mem(int size)
+{
+    void *p = __real_usbh_alloc_mem(size);
+    int i;
+
+    if (p == NULL)
+        return NULL;
+    for (i = 0; i < OBJ_SLOTS && s_obj[i].p != NULL; i++)
+        ;
+    if (i < OBJ_SLOTS)
+    {
+        s_obj[i].p = p;
+        s_obj[i].size = size;
+    }
+    s_stats.obj_bytes += size;
+    s_stats.obj_blocks += MEM_BLOCKS(size);
+    if (s_stats.obj_bytes > s_stats.obj_peak_bytes)
+        s_stats.obj_peak_bytes = s_stats.obj_bytes;
+    if (s_stats.obj_blocks > s_stats.obj_peak_blocks)
+        s_stats.obj_peak_blocks = s_stats.obj_blocks;
+    return p;
+}
+
+static void obj_release(void *p, int size)
+{
+    int i;
+
+    for (i = 0; i < OBJ_SLOTS && s_obj[i].p != p; i++)
+        ;
+    if (i == OBJ_SLOTS)
+    {
+        s_stats.double_frees++;
+        return;
+    }
+    if (size != s_obj[i].size)
+        s_stats.obj_size_errors++;
+    memset(p, 0xA5, s_obj[i].size);
+    s_stats.obj_bytes -= s_obj[i].size;
+    s_stats.obj_blocks -= MEM_BLOCKS(s_obj[i].size);
+    s_obj[i].p = NULL;
+}
+
+void __real_usbh_free_mem(void *p, int size);
+void __wrap_usbh_free_mem(void *p, int size)
+{
+    if (p != NULL)
+        obj_release(p, size);
+    __real_usbh_free_mem(p, size);
+}
+
+/* free_device() frees the descriptor buffer inside mem_alloc.c */
+void __real_free_device(UDEV_T *udev);
+void __wrap_free_device(UDEV_T *udev)
+{
+    if (udev != NULL && udev->cfd_buff != NULL)
+        obj_release(udev->cfd_buff, MAX_DESC_BUFF_SIZE);
+    __real_free_device(udev);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Root ports and device routing                                             */
+/*---------------------------------------------------------------------------*/
+
+static vdev_t *s_root[ROOT_PORTS];
+static uint64_t s_ohci_reset_done[ROOT_PORTS];
+
+typedef struct
+{
+    vdev_t *dev;
+    vdev_t *tt_hub;                     /* HS hub translating for an FS/LS device */
+    int tt_port;
+} route_t;
+
+static int ehci_owns(int p)
+{
+    return (EREG(UCFGR) & HSUSBH_UCFGR_CF_Msk) && !(UPSCR(p) & HSUSBH_UPSCR_PO_Msk);
+}
+
+static void ports_update(void)
+{
+    uint32_t v, ccs;
+    int p, ehci;
+
+    for (p = 0; p < ROOT_PORTS; p++)
+    {
+        ehci = ehci_owns(p);
+
+        v = UPSCR(p);
+        ccs = (s_root[p] && ehci && (v & HSUSBH_UPSCR_PP_Msk)) ? 1 : 0;
+        if ((v & HSUSBH_UPSCR_CCS_Msk) != ccs)
+        {
+            v = (v & ~HSUSBH_UPSCR_CCS_Msk) | ccs | HSUSBH_UPSCR_CSC_Msk;
+            if (!ccs)
+                v &= ~(HSUSBH_UPSCR_PE_Msk | HSUSBH_UPSCR_SUSPEND_Msk);
+            EREG(USTSR) |= HSUSBH_USTSR_PCD_Msk;
+        }
+        v &= ~HSUSBH_UPSCR_LSTS_Msk;
+        if (ccs && !(v & HSUSBH_UPSCR_PE_Msk))
+            v |= (s_root[p]->speed == VDEV_SPEED_LOW ? 1UL : 2UL) << HSUSBH_UPSCR_LSTS_Pos;
+        UPSCR(p) = v;
+
+        v = RHPORT(p);
+        ccs = (s_root[p] && !ehci && (v & USBH_HcRhPortStatus_PPS_Msk)) ? 1 : 0;
+        if ((v & USBH_HcRhPortStatus_CCS_Msk) != ccs)
+        {
+            v = (v & ~USBH_HcRhPortStatus_CCS_Msk) | ccs | USBH_HcRhPortStatus_CSC_Msk;
+            if (!ccs)
+                v &= ~(USBH_HcRhPortStatus_PES_Msk | USBH_HcRhPortStatus_PSS_Msk |
+                       USBH_HcRhPortStatus_PRS_Msk);
+            OREG(HcInterruptStatus) |= USBH_HcInterruptStatus_RHSC_Msk;
+        }
+        v &= ~USBH_HcRhPortStatus_LSDA_Msk;
+        if (ccs && s_root[p]->speed == VDEV_SPEED_LOW)
+            v |= USBH_HcRhPortStatus_LSDA_Msk;
+        RHPORT(p) = v;
+    }
+}
+
+void usbh_sim_attach(int port, vdev_t *d)
+{
+    sim_init();
+    s_root[port] = d;
+    d->parent = NULL;
+    d->port = 0;
+    vdev_bus_reset(d);
+    ports_update();
+}
+
+void usbh_sim_detach(int port)
+{
+    s_root[port] = NULL;
+    /* a disconnect hands a companion-owned port back to EHCI */
+    if (EREG(UCFGR) & HSUSBH_UCFGR_CF_Msk)
+        UPSCR(port) &= ~HSUSBH_UPSCR_PO_Msk;
+    ports_update();
+}
+
+static vdev_t *find_below(vdev_t *d, int addr, vdev_t *tt, int tt_port, route_t *r)
+{
+    vdev_t *c, *found;
+    int port;
+
+    if (d->addr == addr)
+    {
+        r->dev = d;
+        r->tt_hub = tt;
+        r->tt_port = tt_port;
+        return d;
+    }
+    if (!d->nports || !d->config)
+        return NULL;
+    for (port = 1; port <= d->nports; port++)
+    {
+        c = d->child[port];
+        if (!c || !vdev_hub_port_enabled(d, port))
+            continue;
+        if (tt == NULL && d->speed == VDEV_SPEED_HIGH && c->speed != VDEV_SPEED_HIGH)
+            found = find_below(c, addr, d, port, r);
+        else
+            found = find_below(c, addr, tt, tt_port, r);
+        if (found)
+            return found;
+    }
+    return NULL;
+}
+
+static int route(int ehci, int addr, route_t *r)
+{
+    int p;
+
+    memset(r, 0, sizeof(*r));
+    for (p = 0; p < ROOT_PORTS; p++)
+    {
+        if (!s_root[p] || ehci_owns(p) != ehci)
+            continue;
+        if (ehci && !(UPSCR(p) & HSUSBH_UPSCR_PE_Msk))
+            continue;
+        if (!ehci && !(RHPORT(p) & USBH_HcRhPortStatus_PES_Msk))
+            continue;
+        if (find_below(s_root[p], addr, NULL, 0, r))
+            return 1;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* EHCI                                                                      */
+/*---------------------------------------------------------------------------*/
+
+static int s_usbint, s_uerrint;
+
+static void ehci_reset(void)
+{
+    int p;
+
+    EREG(UCMDR) = 0x00080000;
+    EREG(USTSR) = HSUSBH_USTSR_HCHalted_Msk;
+    EREG(UIENR) = 0;
+    EREG(UFINDR) = 0;
+    EREG(UPFLBAR) = 0;
+    EREG(UCALAR) = 0;
+    EREG(UCFGR) = 0;
+    for (p = 0; p < ROOT_PORTS; p++)
+        UPSCR(p) = HSUSBH_UPSCR_PO_Msk;
+    s_usbint = s_uerrint = 0;
+    ports_update();
+}
+
+static void ehci_port_write(int p, uint32_t o, uint32_t v)
+{
+    uint32_t n = o;
+    vdev_t *d = s_root[p];
+
+    n &= ~(v & (HSUSBH_UPSCR_CSC_Msk | HSUSBH_UPSCR_PEC_Msk | HSUSBH_UPSCR_OCC_Msk));
+    if (!(v & HSUSBH_UPSCR_PE_Msk))
+        n &= ~HSUSBH_UPSCR_PE_Msk;
+    n = (n & ~HSUSBH_UPSCR_PP_Msk) | (v & HSUSBH_UPSCR_PP_Msk);
+    n = (n & ~HSUSBH_UPSCR_PO_Msk) | (v & HSUSBH_UPSCR_PO_Msk);
+    if ((v & HSUSBH_UPSCR_SUSPEND_Msk) && (n & HSUSBH_UPSCR_PE_Msk))
+        n |= HSUSBH_UPSCR_SUSPEND_Msk;
+    n = (n & ~HSUSBH_UPSCR_FPR_Msk) | (v & HSUSBH_UPSCR_FPR_Msk);
+    if ((o & HSUSBH_UPSCR_FPR_Msk) && !(v & HSUSBH_UPSCR_FPR_Msk))
+        n &= ~HSUSBH_UPSCR_SUSPEND_Msk;
+
+    if (!(o & HSUSBH_UPSCR_PRST_Msk) && (v & HSUSBH_UPSCR_PRST_Msk))
+    {
+        n |= HSUSBH_UPSCR_PRST_Msk;
+        n &= ~HSUSBH_UPSCR_PE_Msk;
+        if (d)
+            vdev_bus_reset(d);
+    }
+    else if ((o & HSUSBH_UPSCR_PRST_Msk) && !(v & HSUSBH_UPSCR_PRST_Msk))
+    {
+        /* end of reset: only a high-speed device finishes the chirp */
+        n &= ~HSUSBH_UPSCR_PRST_Msk;
+        if (d && ehci_owns(p) && (n & HSUSBH_UPSCR_CCS_Msk) && d->speed == VDEV_SPEED_HIGH)
+            n |= HSUSBH_UPSCR_PE_Msk;
+    }
+    UPSCR(p) = n;
+    ports_update();
+}
+
+static void ehci_write(uint32_t off, uint32_t old, uint32_t v)
+{
+    uint32_t n;
+    int p;
+
+    switch (off)
+    {
+        case E_OFF(UCMDR):
+            if (v & HSUSBH_UCMDR_HCRST_Msk)
+            {
+                ehci_reset();
+                return;
+            }
+            EREG(UCMDR) = v;
+            n = EREG(USTSR) & ~(HSUSBH_USTSR_HCHalted_Msk | HSUSBH_USTSR_PSS_Msk | HSUSBH_USTSR_ASS_Msk);
+            if (!(v & HSUSBH_UCMDR_RUN_Msk))
+                n |= HSUSBH_USTSR_HCHalted_Msk;
+            if (v & HSUSBH_UCMDR_PSEN_Msk)
+                n |= HSUSBH_USTSR_PSS_Msk;
+            if (v & HSUSBH_UCMDR_ASEN_Msk)
+                n |= HSUSBH_USTSR_ASS_Msk;
+            EREG(USTSR) = n;
+            return;
+
+        case E_OFF(USTSR):
+            EREG(USTSR) = old & ~(v & 0x3F);
+            return;
+
+        case E_OFF(UFINDR):
+            EREG(UFINDR) = v & HSUSBH_UFINDR_FI_Msk;
+            return;
+
+        case E_OFF(UIENR):
+        case E_OFF(UPFLBAR):
+        case E_OFF(UCALAR):
+        case E_OFF(UASSTR):
+        case E_OFF(USBPCR0):
+        case E_OFF(USBPCR1):
+            REG(off) = v;
+            return;
+
+        case E_OFF(UCFGR):
+            EREG(UCFGR) = v & HSUSBH_UCFGR_CF_Msk;
+            if (!(old & HSUSBH_UCFGR_CF_Msk) && (v & HSUSBH_UCFGR_CF_Msk))
+            {
+                for (p = 0; p < ROOT_PORTS; p++)
+                    UPSCR(p) &= ~HSUSBH_UPSCR_PO_Msk;
+            }
+            ports_update();
+            return;
+
+        case E_OFF(UPSCR[0]):
+        case E_OFF(UPSCR[1]):
+            ehci_port_write((int)(off - E_OFF(UPSCR[0])) / 4, old, v);
+            return;
+    }
+    REG(off) = old;
+}
+
+/* Copy between a qTD style page list and buf, advancing the current
+ * offset in bptr[0] and C_Page in the token when commit is set */
+static void qtd_copy(uint32_t *bptr, uint32_t *tok, uint8_t *buf, int n, int to_mem, int commit)
+{
+    int page = (int)((*tok >> 12) & 7);
+    uint32_t off = bptr[0] & 0xFFF;
+    uint8_t *p;
+    int chunk;
+
+    while (n > 0 && page < 5)
+    {
+        p = PTR((bptr[page] & ~0xFFFU) + off);
+        chunk = (int)(PAGE - off) < n ? (int)(PAGE - off) : n;
+        if (to_mem)
+            memcpy(p, buf, chunk);
+        else
+            memcpy(buf, p, chunk);
+        buf += chunk;
+        n -= chunk;
+        off += chunk;
+        if (off == PAGE)
+        {
+            off = 0;
+            page++;
+        }
+    }
+    if (commit)
+    {
+        bptr[0] = (bptr[0] & ~0xFFFU) | off;
+        *tok = (*tok & ~(7U << 12)) | ((uint32_t)(page & 7) << 12);
+    }
+}
+
+static int ehci_qh_fetch(QH_T *qh)
+{
+    uint32_t next = qh->OL_Next_qTD, tok;
+    qTD_T *qtd;
+
+    if (next & QTD_LIST_END)
+        return 0;
+    qtd = LINK(next);
+    if (!desc_ok(qtd, SIM_QTD) || !(qtd->Token & QTD_STS_ACTIVE))
+        return 0;
+    qh->Curr_qTD = ADDR(qtd);
+    qh->OL_Next_qTD = qtd->Next_qTD;
+    qh->OL_Alt_Next_qTD = qtd->Alt_Next_qTD;
+    memcpy(qh->OL_Bptr, qtd->Bptr, sizeof(qh->OL_Bptr));
+    tok = qtd->Token;
+    if (!(qh->Chrst & QH_DTC))
+        tok = (tok & ~QTD_DT) | (qh->OL_Token & QTD_DT);
+    qh->OL_Token = tok;
+    s_stats.qtd_fetches++;
+    return 1;
+}
+
+static void ehci_qh_retire(QH_T *qh, uint32_t tok, int short_pkt)
+{
+    qTD_T *qtd = LINK(qh->Curr_qTD);
+
+    tok &= ~QTD_STS_ACTIVE;
+    qh->OL_Token = tok;
+    if (desc_ok(qtd, SIM_QTD))
+        qtd->Token = tok;
+    s_stats.qtd_retired++;
+    if (tok & QTD_IOC)
+        s_usbint = 1;
+    if (tok & QTD_STS_HALT)
+        s_uerrint = 1;
+    if (short_pkt && !(qh->OL_Alt_Next_qTD & QTD_LIST_END))
+        qh->OL_Next_qTD = qh->OL_Alt_Next_qTD;
+}
+
+static int qh_speed(uint32_t chrst)
+{
+    switch ((chrst >> 12) & 3)
+    {
+        case 2:
+            return VDEV_SPEED_HIGH;
+        case 1:
+            return VDEV_SPEED_LOW;
+    }
+    return VDEV_SPEED_FULL;
+}
+
+/* Look up the device of a QH and check its speed and TT fields */
+static int ehci_qh_route(QH_T *qh, route_t *r)
+{
+    int speed = qh_speed(qh->Chrst);
+
+    if (!route(1, qh->Chrst & 0x7F, r))
+        return 0;
+    if (r->dev->speed != speed)
+    {
+        s_stats.topology_errors++;
+        return 0;
+    }
+    if (speed != VDEV_SPEED_HIGH &&
+            (r->tt_hub == NULL ||
+             ((qh->Cap >> QH_HUB_ADDR_Pos) & 0x7F) != r->tt_hub->addr ||
+             (int)((qh->Cap >> QH_HUB_PORT_Pos) & 0x7F) != r->tt_port))
+    {
+        s_stats.topology_errors++;
+        return 0;
+    }
+    return 1;
+}
+
+/* One transaction from the overlay. Returns 1 if the bus was used. */
+static int ehci_qh_xact(QH_T *qh, int *hs_budget, int *fs_budget)
+{
+    uint8_t buf[1024];
+    uint32_t tok = qh->OL_Token, ptok;
+    uint32_t bptr[5];
+    int pid = (int)((tok >> 8) & 3), total = (int)QTD_TODO_LEN(tok);
+    int tog = (int)(tok >> 31);
+    int ep = (int)((qh->Chrst >> 8) & 0xF), mps = (int)((qh->Chrst >> 16) & 0x7FF);
+    int speed = qh_speed(qh->Chrst);
+    int n, est, cost, res, done = 0, short_pkt = 0, cerr;
+    route_t r;
+
+    if (mps > (int)sizeof(buf))
+        mps = sizeof(buf);
+    est = (pid == 2) ? 8 : (total < mps ? total : mps);
+    if (speed == VDEV_SPEED_HIGH)
+    {
+        cost = est + 20;
+        if (*hs_budget < cost)
+            return 0;
+        *hs_budget -= cost;
+    }
+    else
+    {
+        cost = (est + 13) * (speed == VDEV_SPEED_LOW ? 8 : 1);
+        if (*fs_budget < cost)
+            return 0;
+        *fs_budget -= cost;
+    }
+    s_stats.transactions++;
+
+    if (!ehci_qh_route(qh, &r))
+    {
+        /* no handshake: three strikes and the qTD halts */
+        cerr = (int)((tok >> 10) & 3);
+        tok |= QTD_STS_XactErr;
+        if (cerr > 1)
+        {
+            tok = (tok & ~QTD_ERR_COUNTER) | ((uint32_t)(cerr - 1) << 10);
+            qh->OL_Token = tok;
+            return 1;
+        }
+        tok = (tok & ~QTD_ERR_COUNTER) | QTD_STS_HALT;
+        ehci_qh_retire(qh, tok, 0);
+        return 1;
+    }
+
+    switch (pid)
+    {
+        case 2:                         /* SETUP */
+            qtd_copy(qh->OL_Bptr, &tok, buf, 8, 0, 1);
+            vdev_setup(r.dev, buf);
+            n = 8;
+            total = total > 8 ? total - 8 : 0;
+            done = (total == 0);
+            break;
+
+        case 0:                         /* OUT */
+            n = total < mps ? total : mps;
+            memcpy(bptr, qh->OL_Bptr, sizeof(bptr));
+            ptok = tok;
+            qtd_copy(bptr, &ptok, buf, n, 0, 1);
+            res = vdev_out(r.dev, ep, tog, buf, n);
+            if (res == VDEV_NAK)
+            {
+                s_stats.naks++;
+                return 0;
+            }
+            if (res == VDEV_STALL)
+            {
+                ehci_qh_retire(qh, tok | QTD_STS_HALT, 0);
+                return 1;
+            }
+            memcpy(qh->OL_Bptr, bptr, sizeof(bptr));
+            tok = ptok;
+            total -= n;
+            done = (total == 0);
+            break;
+
+        default:                        /* IN */
+            res = vdev_in(r.dev, ep, tog, buf, mps);
+            if (res == VDEV_NAK)
+            {
+                s_stats.naks++;
+                return 0;
+            }
+            if (res == VDEV_STALL)
+            {
+                ehci_qh_retire(qh, tok | QTD_STS_HALT, 0);
+                return 1;
+            }
+            n = res;
+            if (n > total)
+            {
+                ehci_qh_retire(qh, tok | QTD_STS_BABBLE | QTD_STS_HALT, 0);
+                return 1;
+            }
+            qtd_copy(qh->OL_Bptr, &tok, buf, n, 1, 1);
+            total -= n;
+            short_pkt = (n < mps);
+            done = (total == 0 || short_pkt);
+            break;
+    }
+
+    s_stats.bytes += n;
+    tog ^= 1;
+    tok = (tok & ~(QTD_DT | (0x7FFFU << QTD_TODO_LEN_Pos))) |
+          ((uint32_t)tog << 31) | ((uint32_t)total << QTD_TODO_LEN_Pos);
+    if (done)
+        ehci_qh_retire(qh, tok, short_pkt && total > 0);
+    else
+        qh->OL_Token = tok;
+    return 1;
+}
+
+static int ehci_qh_run(QH_T *qh, int *hs_budget, int *fs_budget)
+{
+    s_stats.qh_visits++;
+    if (qh->OL_Token & QTD_STS_HALT)
+        return 0;
+    if (!(qh->OL_Token & QTD_STS_ACTIVE) && !ehci_qh_fetch(qh))
+        return 0;
+    return ehci_qh_xact(qh, hs_budget, fs_budget);
+}
+
+static route_t *ehci_sitd_route(siTD_T *sitd, route_t *r)
+{
+    uint32_t ch = sitd->Chrst;
+
+    if (!route(1, ch & 0x7F, r))
+        return NULL;
+    if (r->dev->speed == VDEV_SPEED_HIGH || r->tt_hub == NULL ||
+            ((ch >> SITD_HUB_ADDR_Pos) & 0x7F) != r->tt_hub->addr ||
+            (int)((ch >> SITD_PORT_NUM_Pos) & 0x7F) != r->tt_port)
+    {
+        s_stats.topology_errors++;
+        return NULL;
+    }
+    return r;
+}
+
+static void ehci_itd_run(iTD_T *itd, int uf)
+{
+    uint8_t buf[1024];
+    uint32_t t = itd->Transaction[uf];
+    int dev = (int)ITD_DEV_ADDR(itd), ep = (int)ITD_EP_NUM(itd);
+    int in = (itd->Bptr[1] & ITD_DIR_IN) != 0, mps = (int)ITD_MAX_PKTSZ(itd);
+    int len = (int)ITD_XFER_LEN(t), pg = (int)((t >> ITD_PG_Pos) & 7), n;
+    uint8_t *p = PTR((itd->Bptr[pg] & ~0xFFFU) + (t & ITD_XFER_OFF_Msk));
+    route_t r;
+
+    if (!(t & ITD_STATUS_ACTIVE))
+        return;
+    t &= ~(ITD_STATUS_ACTIVE | (0xFFFU << ITD_XLEN_Pos));
+    if (!route(1, dev, &r) || r.dev->speed != VDEV_SPEED_HIGH)
+    {
+        t |= ITD_STATUS_XACT_ERR;
+        len = 0;
+    }
+    else if (in)
+    {
+        if (mps > (int)sizeof(buf))
+            mps = sizeof(buf);
+        n = vdev_in(r.dev, ep, -1, buf, mps);
+        if (n < 0)
+            n = 0;
+        if (n > len)
+        {
+            t |= ITD_STATUS_BABBLE;
+            n = len;
+        }
+        memcpy(p, buf, n);
+        len = n;
+    }
+    else
+    {
+        vdev_out(r.dev, ep, -1, p, len);
+    }
+    s_stats.transactions++;
+    s_stats.bytes += len;
+    itd->Transaction[uf] = t | ((uint32_t)len << ITD_XLEN_Pos);
+    if (t & ITD_IOC)
+        s_usbint = 1;
+    s_stats.itd_done++;
+}
+
+static void ehci_sitd_run(siTD_T *sitd, int uf)
+{
+    uint8_t buf[1024];
+    uint32_t st = sitd->StsCtrl, smask = sitd->Sched & 0xFF;
+    int ep = (int)((sitd->Chrst >> SITD_EP_NUM_Pos) & 0xF), total, n;
+    uint8_t *p = PTR(sitd->Bptr[0]);
+    route_t r;
+
+    if (!(st & SITD_STATUS_ACTIVE) || !(smask & (1U << uf)))
+        return;
+    /* the whole full-speed packet goes at the start-split microframe */
+    if ((smask & ((1U << uf) - 1)) != 0)
+        return;
+
+    total = (int)((st & SITD_XFER_CNT_Msk) >> SITD_XFER_CNT_Pos);
+    st &= ~(SITD_STATUS_ACTIVE | SITD_XFER_CNT_Msk);
+    if (!ehci_sitd_route(sitd, &r))
+    {
+        st |= SITD_STATUS_XFER_ERR;
+    }
+    else if (sitd->Chrst & SITD_XFER_IN)
+    {
+        n = vdev_in(r.dev, ep, -1, buf, total < (int)sizeof(buf) ? total : (int)sizeof(buf));
+        if (n < 0)
+            n = 0;
+        memcpy(p, buf, n);
+        total -= n;
+        s_stats.bytes += n;
+    }
+    else
+    {
+        vdev_out(r.dev, ep, -1, p, total);
+        s_stats.bytes += total;
+        total = 0;
+    }
+    s_stats.transactions++;
+    sitd->StsCtrl = st | ((uint32_t)total << SITD_XFER_CNT_Pos);
+    if (st & SITD_IOC)
+        s_usbint = 1;
+    s_stats.sitd_done++;
+}
+
+static int ehci_frame_list_size(void)
+{
+    return 1024 >> ((EREG(UCMDR) & HSUSBH_UCMDR_FLSZ_Msk) >> HSUSBH_UCMDR_FLSZ_Pos);
+}
+
+static void ehci_periodic(int uf)
+{
+    uint32_t *fl = PTR(EREG(UPFLBAR) & ~0xFFFU), link;
+    int idx = (int)(EREG(UFINDR) >> 3) & (ehci_frame_list_size() - 1);
+    int hs_budget = 6000, fs_budget = 188, hops;
+    QH_T *qh;
+    iTD_T *itd;
+    siTD_T *sitd;
+
+    if (fl == NULL)
+        return;
+    link = fl[idx];
+    for (hops = 0; link && !(link & 1) && hops < 256; hops++)
+    {
+        switch ((link >> 1) & 3)
+        {
+            case 0:
+                itd = LINK(link);
+                if (!desc_ok(itd, SIM_ITD))
+                    return;
+                ehci_itd_run(itd, uf);
+                link = itd->Next_Link;
+                break;
+            case 1:
+                qh = LINK(link);
+                if (!desc_ok(qh, SIM_QH))
+                    return;
+                if (qh->Cap & (1U << uf))
+                    ehci_qh_run(qh, &hs_budget, &fs_budget);
+                link = qh->HLink;
+                break;
+            case 2:
+                sitd = LINK(link);
+                if (!desc_ok(sitd, SIM_SITD))
+                    return;
+                ehci_sitd_run(sitd, uf);
+                link = sitd->Next_Link;
+                break;
+            default:                    /* FSTN: follow the normal path */
+                link = *(uint32_t *)PTR(link & ~0x1FU);
+                break;
+        }
+    }
+}
+
+static void ehci_async(void)
+{
+    uint32_t head = EREG(UCALAR) & ~0x1FU;
+    int hs_budget = 7500, fs_budget = 188, progress, hops;
+    QH_T *qh;
+
+    if (!head)
+        return;
+    do
+    {
+        progress = 0;
+        qh = PTR(head);
+        for (hops = 0; hops < 256; hops++)
+        {
+            if (!desc_ok(qh, SIM_QH))
+                return;
+            if (ehci_qh_run(qh, &hs_budget, &fs_budget))
+                progress = 1;
+            if (qh->HLink & QH_HLNK_END)
+                break;
+            qh = LINK(qh->HLink);
+            if (ADDR(qh) == head)
+                break;
+        }
+    }
+    while (progress);
+}
+
+static void ehci_uframe(void)
+{
+    uint32_t cmd = EREG(UCMDR), fr;
+
+    if (!(cmd & HSUSBH_UCMDR_RUN_Msk))
+        return;
+    if (cmd & HSUSBH_UCMDR_PSEN_Msk)
+        ehci_periodic((int)(EREG(UFINDR) & 7));
+    if (cmd & HSUSBH_UCMDR_ASEN_Msk)
+        ehci_async();
+    if (s_usbint)
+        EREG(USTSR) |= HSUSBH_USTSR_USBINT_Msk;
+    if (s_uerrint)
+        EREG(USTSR) |= HSUSBH_USTSR_UERRINT_Msk;
+    s_usbint = s_uerrint = 0;
+    if (cmd & HSUSBH_UCMDR_IAAD_Msk)
+    {
+        EREG(UCMDR) = cmd & ~HSUSBH_UCMDR_IAAD_Msk;
+        EREG(USTSR) |= HSUSBH_USTSR_IAA_Msk;
+    }
+    fr = (EREG(UFINDR) + 1) & HSUSBH_UFINDR_FI_Msk;
+    if ((fr & 7) == 0 && ((fr >> 3) & (ehci_frame_list_size() - 1)) == 0)
+        EREG(USTSR) |= HSUSBH_USTSR_FLR_Msk;
+    EREG(UFINDR) = fr;
+}
+
+/*---------------------------------------------------------------------------*/
+/* OHCI                                                                      */
+/*---------------------------------------------------------------------------*/
+
+static uint32_t s_done_head;
+
+static void ohci_reset(void)
+{
+    OREG(HcRevision) = 0x10;
+    OREG(HcControl) = 0;
+    OREG(HcCommandStatus) = 0;
+    OREG(HcInterruptStatus) = 0;
+    OREG(HcInterruptEnable) = 0;
+    OREG(HcInterruptDisable) = 0;
+    OREG(HcHCCA) = 0;
+    OREG(HcPeriodCurrentED) = 0;
+    OREG(HcControlHeadED) = 0;
+    OREG(HcControlCurrentED) = 0;
+    OREG(HcBulkHeadED) = 0;
+    OREG(HcBulkCurrentED) = 0;
+    OREG(HcDoneHead) = 0;
+    OREG(HcFmInterval) = 0x2EDF;
+    OREG(HcFmNumber) = 0;
+    s_done_head = 0;
+}
+
+static void ohci_port_write(int p, uint32_t o, uint32_t v)
+{
+    uint32_t n = o & ~(v & 0x1F0000);
+
+    if (v & USBH_HcRhPortStatus_CCS_Msk)            /* ClearPortEnable */
+        n &= ~USBH_HcRhPortStatus_PES_Msk;
+    if ((v & USBH_HcRhPortStatus_PES_Msk) && (n & USBH_HcRhPortStatus_CCS_Msk))
+        n |= USBH_HcRhPortStatus_PES_Msk;
+    if ((v & USBH_HcRhPortStatus_PSS_Msk) && (n & USBH_HcRhPortStatus_PES_Msk))
+        n |= USBH_HcRhPortStatus_PSS_Msk;
+    if ((v & USBH_HcRhPortStatus_POCI_Msk) && (n & USBH_HcRhPortStatus_PSS_Msk))
+        n = (n & ~USBH_HcRhPortStatus_PSS_Msk) | USBH_HcRhPortStatus_PSSC_Msk;
+    if ((v & USBH_HcRhPortStatus_PRS_Msk) && (n & USBH_HcRhPortStatus_CCS_Msk))
+    {
+        n = (n & ~USBH_HcRhPortStatus_PES_Msk) | USBH_HcRhPortStatus_PRS_Msk;
+        s_ohci_reset_done[p] = s_now + OHCI_RESET_US;
+        vdev_bus_reset(s_root[p]);
+    }
+    if (v & USBH_HcRhPortStatus_PPS_Msk)
+        n |= USBH_HcRhPortStatus_PPS_Msk;
+    if (v & USBH_HcRhPortStatus_LSDA_Msk)           /* ClearPortPower */
+        n &= ~(USBH_HcRhPortStatus_PPS_Msk | USBH_HcRhPortStatus_PES_Msk | USBH_HcRhPortStatus_PSS_Msk);
+    RHPORT(p) = n;
+    ports_update();
+}
+
+static void ohci_write(uint32_t off, uint32_t old, uint32_t v)
+{
+    uint32_t n;
+
+    switch (off)
+    {
+        case O_OFF(HcCommandStatus):
+            if (v & USBH_HcCommandStatus_HCR_Msk)
+            {
+                ohci_reset();
+                return;
+            }
+            OREG(HcCommandStatus) = old | (v & 0xE);
+            return;
+
+        case O_OFF(HcInterruptStatus):
+            OREG(HcInterruptStatus) = old & ~v;
+            return;
+
+        case O_OFF(HcInterruptEnable):
+            n = old | v;
+            OREG(HcInterruptEnable) = OREG(HcInterruptDisable) = n;
+            return;
+
+        case O_OFF(HcInterruptDisable):
+            n = old & ~v;
+            OREG(HcInterruptEnable) = OREG(HcInterruptDisable) = n;
+            return;
+
+        case O_OFF(HcControl):
+        case O_OFF(HcHCCA):
+        case O_OFF(HcPeriodCurrentED):
+        case O_OFF(HcControlHeadED):
+        case O_OFF(HcControlCurrentED):
+        case O_OFF(HcBulkHeadED):
+        case O_OFF(HcBulkCurrentED):
+        case O_OFF(HcFmInterval):
+        case O_OFF(HcPeriodicStart):
+        case O_OFF(HcLSThreshold):
+        case O_OFF(HcRhDescriptorA):
+        case O_OFF(HcRhDescriptorB):
+        case O_OFF(HcPhyControl):
+        case O_OFF(HcMiscControl):
+            REG(off) = v;
+            return;
+
+        case O_OFF(HcRhPortStatus[0]):
+        case O_OFF(HcRhPortStatus[1]):
+            ohci_port_write((int)(off - O_OFF(HcRhPortStatus[0])) / 4, old, v);
+            return;
+    }
+    REG(off) = old;
+}
+
+static int ed_idle(const ED_T *ed)
+{
+    return (ed->Info & ED_SKIP) || (ed->HeadP & ED_HEADP_HALT) ||
+           (ed->HeadP & ~0xFU) == (ed->TailP & ~0xFU);
+}
+
+static void ohci_td_retire(ED_T *ed, TD_T *td, int cc, int halt)
+{
+    td->Info = (td->Info & 0x03FFFFFF) | ((uint32_t)cc << 28);
+    ed->HeadP = (td->NextTD & ~0xFU) | (ed->HeadP & 0x2) | (halt ? ED_HEADP_HALT : 0);
+    td->NextTD = s_done_head;
+    s_done_head = ADDR(td);
+    s_stats.td_retired++;
+}
+
+/* One transaction for a general TD. Returns 1 if the bus was used. */
+static int ohci_ed_xact(ED_T *ed, int *budget)
+{
+    uint8_t buf[1024];
+    TD_T *td = PTR(ed->HeadP & ~0xFU);
+    uint32_t info = ed->Info, tinfo;
+    int ep = (int)((info >> ED_CTRL_EN_Pos) & 0xF), dir = (int)((info >> ED_CTRL_DIR_Pos) & 3);
+    int ls = (info & ED_SPEED_LOW) != 0, mps = (int)((info >> ED_CTRL_MPS_Pos) & 0x7FF);
+    int tog, remaining, n, est, cost, res, speed;
+    route_t r;
+
+    if (!desc_ok(td, SIM_TD))
+        return 0;
+    tinfo = td->Info;
+    if (dir != 1 && dir != 2)
+        dir = (int)((tinfo & TD_DP) >> 19);     /* 0 SETUP, 1 OUT, 2 IN */
+    tog = (tinfo & (1U << 25)) ? (int)((tinfo >> 24) & 1) : (int)((ed->HeadP >> 1) & 1);
+    remaining = td->CBP ? (int)(td->BE - td->CBP + 1) : 0;
+    if (mps > (int)sizeof(buf))
+        mps = sizeof(buf);
+
+    est = (dir == 0) ? 8 : (remaining < mps ? remaining : mps);
+    cost = (est + 13) * (ls ? 8 : 1);
+    if (*budget < cost)
+        return 0;
+    *budget -= cost;
+    s_stats.transactions++;
+
+    if (!route(0, (int)(info & ED_FUNC_ADDR_Msk), &r))
+    {
+        ohci_td_retire(ed, td, 5, 1);           /* DEVICE NOT RESPONDING */
+        return 1;
+    }
+    speed = r.dev->speed == VDEV_SPEED_HIGH ? VDEV_SPEED_FULL : r.dev->speed;
+    if (speed != (ls ? VDEV_SPEED_LOW : VDEV_SPEED_FULL))
+    {
+        s_stats.topology_errors++;
+        ohci_td_retire(ed, td, 5, 1);
+        return 1;
+    }
+
+    switch (dir)
+    {
+        case 0:                         /* SETUP */
+            vdev_setup(r.dev, PTR(td->CBP));
+            n = 8;
+            td->CBP = 0;
+            break;
+
+        case 1:                         /* OUT */
+            n = remaining < mps ? remaining : mps;
+            res = vdev_out(r.dev, ep, tog, n ? PTR(td->CBP) : buf, n);
+            if (res == VDEV_NAK)
+            {
+                s_stats.naks++;
+                return 0;
+            }
+            if (res == VDEV_STALL)
+            {
+                ohci_td_retire(ed, td, 4, 1);
+                return 1;
+            }
+            td->CBP = (n == remaining) ? 0 : td->CBP + n;
+            break;
+
+        default:                        /* IN */
+            res = vdev_in(r.dev, ep, tog, buf, mps);
+            if (res == VDEV_NAK)
+            {
+                s_stats.naks++;
+                return 0;
+            }
+            if (res == VDEV_STALL)
+            {
+                ohci_td_retire(ed, td, 4, 1);
+                return 1;
+            }
+            n = res;
+            if (n > remaining)
+            {
+                ohci_td_retire(ed, td, 8, 1);   /* DATA OVERRUN */
+                return 1;
+            }
+            if (n)
+                memcpy(PTR(td->CBP), buf, n);
+            if (n == remaining)
+                td->CBP = 0;
+            else
+                td->CBP += n;
+            break;
+    }
+
+    s_stats.bytes += n;
+    tog ^= 1;
+    td->Info = (td->Info & ~(3U << 24)) | ((uint32_t)(2 | tog) << 24);
+    ed->HeadP = (ed->HeadP & ~0x2U) | ((uint32_t)tog << 1);
+
+    if (td->CBP == 0)
+        ohci_td_retire(ed, td, 0, 0);
+    else if (dir == 2 && n < mps)
+    {
+        if (td->Info & TD_R)
+            ohci_td_retire(ed, td, 0, 0);
+        else
+            ohci_td_retire(ed, td, 9, 1);       /* DATA UNDERRUN */
+    }
+    return 1;
+}
+
+static void ohci_iso_ed(ED_T *ed, uint16_t fm)
+{
+    uint8_t buf[1024];
+    TD_T *td = PTR(ed->HeadP & ~0xFU);
+    uint32_t psw, start;
+    int16_t late;
+    int size, n, cc = 0;
+    route_t r;
+
+    if (!desc_ok(td, SIM_TD))
+        return;
+    late = (int16_t)(fm - (uint16_t)(td->Info & 0xFFFF));
+    if (late < 0)
+        return;
+    psw = td->PSW[0] & 0xFFFF;
+    if (late > 0)
+    {
+        td->PSW[0] = (td->PSW[0] & 0xFFFF0000) | (8U << 12);
+        ohci_td_retire(ed, td, 8, 0);
+        return;
+    }
+
+    start = ((psw & 0x1000) ? (td->BE & ~0xFFFU) : (td->CBP & ~0xFFFU)) + (psw & 0xFFF);
+    size = (int)(td->BE - start + 1);
+    if (size > (int)sizeof(buf))
+        size = sizeof(buf);
+    n = 0;
+    if (!route(0, (int)(ed->Info & ED_FUNC_ADDR_Msk), &r))
+    {
+        cc = 5;
+    }
+    else if (((ed->Info >> ED_CTRL_DIR_Pos) & 3) == 2)
+    {
+        n = vdev_in(r.dev, (int)((ed->Info >> ED_CTRL_EN_Pos) & 0xF), -1, buf, size);
+        if (n < 0)
+            n = 0;
+        memcpy(PTR(start), buf, n);
+        if (n < size)
+            cc = 9;
+    }
+    else
+    {
+        vdev_out(r.dev, (int)((ed->Info >> ED_CTRL_EN_Pos) & 0xF), -1, PTR(start), size);
+        n = 0;
+    }
+    s_stats.transactions++;
+    s_stats.bytes += n;
+    td->PSW[0] = (td->PSW[0] & 0xFFFF0000) | ((uint32_t)cc << 12) | (uint32_t)n;
+    ohci_td_retire(ed, td, 0, 0);
+}
+
+/* Returns 1 if some ED of the list had work */
+static int ohci_list(uint32_t head, int *budget)
+{
+    int work = 0, progress, hops;
+    ED_T *ed;
+
+    do
+    {
+        progress = 0;
+        for (ed = PTR(head & ~0xFU), hops = 0; ed && hops < 64; ed = PTR(ed->NextED & ~0xFU), hops++)
+        {
+            if (!desc_ok(ed, SIM_ED))
+                break;
+            s_stats.ed_visits++;
+            if (ed_idle(ed))
+                continue;
+            work = 1;
+            if (ohci_ed_xact(ed, budget))
+                progress = 1;
+        }
+    }
+    while (progress && *budget > 0);
+    return work;
+}
+
+static void ohci_periodic(HCCA_T *hcca, uint16_t fm, int *budget)
+{
+    ED_T *ed;
+    int hops;
+
+    for (ed = PTR(hcca->int_table[fm & 31] & ~0xFU), hops = 0; ed && hops < 64;
+            ed = PTR(ed->NextED & ~0xFU), hops++)
+    {
+        if (!desc_ok(ed, SIM_ED))
+            break;
+        s_stats.ed_visits++;
+        if (ed_idle(ed))
+            continue;
+        if (ed->Info & ED_FORMAT_ISO)
+        {
+            if (OREG(HcControl) & USBH_HcControl_IE_Msk)
+                ohci_iso_ed(ed, fm);
+        }
+        else
+        {
+            ohci_ed_xact(ed, budget);
+        }
+    }
+}
+
+static void ohci_frame(void)
+{
+    HCCA_T *hcca = PTR(OREG(HcHCCA) & ~0xFFU);
+    uint32_t ctl = OREG(HcControl);
+    uint16_t fm;
+    int budget = 1500;
+
+    if ((ctl & USBH_HcControl_HCFS_Msk) != HCFS_OPER)
+        return;
+    fm = (uint16_t)(OREG(HcFmNumber) + 1);
+    OREG(HcFmNumber) = fm;
+    if (hcca)
+    {
+        hcca->frame_no = fm;
+        hcca->pad1 = 0;
+    }
+    OREG(HcInterruptStatus) |= USBH_HcInterruptStatus_SF_Msk;
+
+    if (hcca && (ctl & USBH_HcControl_PLE_Msk))
+        ohci_periodic(hcca, fm, &budget);
+    if ((ctl & USBH_HcControl_CLE_Msk) && (OREG(HcCommandStatus) & USBH_HcCommandStatus_CLF_Msk))
+    {
+        if (!ohci_list(OREG(HcControlHeadED), &budget))
+            OREG(HcCommandStatus) &= ~USBH_HcCommandStatus_CLF_Msk;
+    }
+    if ((ctl & USBH_HcControl_BLE_Msk) && (OREG(HcCommandStatus) & USBH_HcCommandStatus_BLF_Msk))
+    {
+        if (!ohci_list(OREG(HcBulkHeadED), &budget))
+            OREG(HcCommandStatus) &= ~USBH_HcCommandStatus_BLF_Msk;
+    }
+
+    if (s_done_head && hcca && !(OREG(HcInterruptStatus) & USBH_HcInterruptStatus_WDH_Msk))
+    {
+        hcca->done_head = s_done_head;
+        s_done_head = 0;
+        OREG(HcInterruptStatus) |= USBH_HcInterruptStatus_WDH_Msk;
+    }
+}
+
+static void ohci_port_timers(void)
+{
+    int p;
+
+    for (p = 0; p < ROOT_PORTS; p++)
+    {
+        if (!(RHPORT(p) & USBH_HcRhPortStatus_PRS_Msk) || s_now < s_ohci_reset_done[p])
+            continue;
+        RHPORT(p) = (RHPORT(p) & ~USBH_HcRhPortStatus_PRS_Msk) |
+                    USBH_HcRhPortStatus_PES_Msk | USBH_HcRhPortStatus_PRSC_Msk;
+        OREG(HcInterruptStatus) |= USBH_HcInterruptStatus_RHSC_Msk;
+    }
+}
+
+/* One microframe of both controllers */
+static void hw_step(void)
+{
+    s_now += USBH_SIM_UFRAME_US;
+    ehci_uframe();
+    if ((s_now / USBH_SIM_UFRAME_US) % 8 == 0)
+    {
+        ohci_port_timers();
+        ohci_frame();
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Register traps                                                            */
+/*---------------------------------------------------------------------------*/
+
+static uint8_t s_snap[PAGE];
+static uint32_t s_trap_page, s_trap_off;
+static int s_trap_write;
+
+static void reg_write(uint32_t off, uint32_t old, uint32_t v)
+{
+    s_stats.reg_writes++;
+    if (off < OHCI_BASE)
+        ehci_write(off, old, v);
+    else
+        ohci_write(off, old, v);
+}
+
+static void on_segv(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uint8_t *a = si->si_addr;
+
+    if (a < g_pu8UsbhSimRegs || a >= g_pu8UsbhSimRegs + REGS_SIZE)
+    {
+        /* a real crash: let it happen with the default action */
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+    s_trap_off = (uint32_t)(a - g_pu8UsbhSimRegs) & ~3U;
+    s_trap_page = s_trap_off & ~(PAGE - 1);
+    s_trap_write = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+    if (!s_trap_write)
+    {
+        s_stats.reg_reads++;
+        /* a task spinning on a status bit lets the hardware run */
+        if (++s_poll_reads >= POLL_READS_PER_UFRAME)
+        {
+            s_poll_reads = 0;
+            s_stats.busy_uframes++;
+            hw_step();
+        }
+    }
+    memcpy(s_snap, s_regs + s_trap_page, PAGE);
+    mprotect(g_pu8UsbhSimRegs + s_trap_page, PAGE, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= 0x100;
+}
+
+static void on_trap(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uint32_t *cur = (uint32_t *)(s_regs + s_trap_page), *old = (uint32_t *)s_snap;
+    uint32_t val[PAGE / 4], idx[PAGE / 4];
+    uint32_t i, n = 0;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+    mprotect(g_pu8UsbhSimRegs + s_trap_page, PAGE, PROT_NONE);
+    if (!s_trap_write)
+        return;
+
+    /* Collect what the instruction stored before replaying any of it, the
+     * models update mirrored registers. The faulting word always counts,
+     * even if the value did not change. */
+    for (i = 0; i < PAGE / 4; i++)
+    {
+        if (s_trap_page + i * 4 != s_trap_off && cur[i] == old[i])
+            continue;
+        idx[n] = i;
+        val[n++] = cur[i];
+        cur[i] = old[i];
+    }
+    for (i = 0; i < n; i++)
+        reg_write(s_trap_page + idx[i] * 4, old[idx[i]], val[i]);
+}
+
+static void on_alarm(int sig)
+{
+    static const char msg[] = "usbh_sim: watchdog, the library spins without yielding\n";
+
+    (void)write(2, msg, sizeof(msg) - 1);
+    _exit(3);
+}
+
+static void sim_init(void)
+{
+    struct sigaction sa;
+    int fd;
+
+    if (s_ready)
+        return;
+
+    /* descriptors hold 32-bit pointers: keep every allocation low */
+    mallopt(M_MMAP_MAX, 0);
+
+    fd = memfd_create("usbh_regs", 0);
+    if (fd < 0 || ftruncate(fd, REGS_SIZE) < 0)
+    {
+        perror("usbh_sim: memfd");
+        exit(2);
+    }
+    g_pu8UsbhSimRegs = mmap(NULL, REGS_SIZE, PROT_NONE, MAP_SHARED | MAP_32BIT, fd, 0);
+    s_regs = mmap(NULL, REGS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (g_pu8UsbhSimRegs == MAP_FAILED || s_regs == MAP_FAILED)
+    {
+        perror("usbh_sim: mmap");
+        exit(2);
+    }
+    s_sched_stack = low_alloc(STACK_SIZE);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = on_segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = on_trap;
+    sigaction(SIGTRAP, &sa, NULL);
+    signal(SIGALRM, on_alarm);
+    alarm(WATCHDOG_S);
+
+    s_verbose = getenv("USBH_SIM_VERBOSE") != NULL;
+
+    REG(E_OFF(EHCVNR)) = 0x01000010;
+    REG(E_OFF(EHCSPR)) = 0x00000012;
+    ehci_reset();
+    ohci_reset();
+    OREG(HcRhDescriptorA) = 0x02000902;
+    s_ready = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+const usbh_sim_stats_t *usbh_sim_stats(void)
+{
+    return &s_stats;
+}
+
+void usbh_sim_reset_peaks(void)
+{
+    memcpy(s_stats.peak, s_stats.live, sizeof(s_stats.peak));
+    s_stats.obj_peak_bytes = s_stats.obj_bytes;
+    s_stats.obj_peak_blocks = s_stats.obj_blocks;
+}
+
+int usbh_sim_log(const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (!s_verbose)
+        return 0;
+    va_start(ap, fmt);
+    n = vprintf(fmt, ap);
+    va_end(ap);
+    return n;
+}
@@ -0,0 +1,115 @@
+/*
+ * Register level model of the M460 USB host controllers for host tests.
+ *
+ * The EHCI and OHCI register blocks live in a page the library cannot
+ * touch directly. Every access traps, is single-stepped and then handed
+ * to the controller model, so the library runs unmodified: it programs
+ * real QH/qTD/iTD/siTD and ED/TD lists, and the models walk them every
+ * microframe against the scripted devices of vdev.c.
+ *
+ * Time is simulated. The library runs in cooperative tasks; a task gives
+ * up the CPU in get_ticks(), delay_us() and usbh_sim_mutex_lock(), or
+ * after about a microframe of register polling. Interrupt handlers run
+ * when a task yields, or at once when it enables the interrupt or clears
+ * PRIMASK while the controller has one pending. A task is never
+ * preempted in the middle of plain C code.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef USBH_SIM_H
+#define USBH_SIM_H
+
+#include <stdint.h>
+
+#include "vdev.h"
+
+#define USBH_SIM_UFRAME_US  125
+
+/* Hardware descriptor types tracked by the allocator hooks */
+enum
+{
+    SIM_QH,
+    SIM_QTD,
+    SIM_ITD,
+    SIM_SITD,
+    SIM_ED,
+    SIM_TD,
+    SIM_DESC_TYPES
+};
+
+typedef struct
+{
+    /* CPU side */
+    uint64_t reg_reads;                 /* trapped register reads */
+    uint64_t reg_writes;                /* trapped register writes */
+    uint64_t ehci_irqs;                 /* EHCI_IRQHandler entries */
+    uint64_t ohci_irqs;                 /* OHCI_IRQHandler entries */
+    uint64_t busy_uframes;              /* microframes spent polling registers */
+    uint32_t masked_yields;             /* a task blocked with PRIMASK set */
+
+    /* Controller side */
+    uint64_t qh_visits;                 /* QHs the EHCI model looked at */
+    uint64_t qtd_fetches;               /* qTDs loaded into a QH overlay */
+    uint64_t qtd_retired;
+    uint64_t itd_done, sitd_done;       /* isochronous slots completed */
+    uint64_t ed_visits;                 /* EDs the OHCI model looked at */
+    uint64_t td_retired;
+    uint64_t transactions;              /* tokens sent on the bus */
+    uint64_t naks;
+    uint64_t bytes;                     /* payload bytes moved */
+
+    /* Descriptor bookkeeping */
+    uint32_t live[SIM_DESC_TYPES];      /* allocated and not yet freed */
+    uint32_t peak[SIM_DESC_TYPES];
+    uint32_t double_frees;              /* freed twice or never allocated */
+    uint32_t stale_refs;                /* controller reached a freed descriptor */
+    uint32_t topology_errors;           /* speed or TT fields that do not match the bus */
+
+    /* usbh_alloc_mem() objects, in host sizes; blocks as the static arena
+     * would count them with USBH_SIM_MEM_BLOCK byte blocks */
+    uint32_t obj_bytes, obj_peak_bytes;
+    uint32_t obj_blocks, obj_peak_blocks;
+    uint32_t obj_size_errors;           /* freed with another size than allocated */
+} usbh_sim_stats_t;
+
+#define USBH_SIM_MEM_BLOCK  64
+
+/* Run main_fn as the first task until it returns or limit_us of simulated
+ * time has passed. Returns 0, or -1 on the time limit. */
+int usbh_sim_run(void (*main_fn)(void *), void *arg, uint64_t limit_us);
+
+/* More tasks, for tests that drive the library from several threads */
+typedef struct usbh_sim_task usbh_sim_task_t;
+usbh_sim_task_t *usbh_sim_task_create(void (*fn)(void *), void *arg);
+int  usbh_sim_task_done(usbh_sim_task_t *t);
+void usbh_sim_task_join(usbh_sim_task_t *t);
+
+uint64_t usbh_sim_time_us(void);
+void usbh_sim_sleep_us(uint64_t us);
+
+/* Blocking recursive mutex on the simulated scheduler */
+typedef struct
+{
+    usbh_sim_task_t *owner;
+    int count;
+    uint32_t contended;                 /* lock calls that had to wait */
+} usbh_sim_mutex_t;
+
+void usbh_sim_mutex_init(usbh_sim_mutex_t *m);
+void usbh_sim_mutex_lock(usbh_sim_mutex_t *m);
+void usbh_sim_mutex_unlock(usbh_sim_mutex_t *m);
+
+/* Plug a device tree into root port 0 (EHCI, or OHCI after hand-off)
+ * or root port 1 (OHCI only), or pull it out */
+void usbh_sim_attach(int port, vdev_t *d);
+void usbh_sim_detach(int port);
+
+const usbh_sim_stats_t *usbh_sim_stats(void);
+
+/* Start the peak counters over from what is allocated now */
+void usbh_sim_reset_peaks(void);
+
+/* Library console output; quiet unless USBH_SIM_VERBOSE is set */
+int usbh_sim_log(const char *fmt, ...);
+
+#endif /* USBH_SIM_H */
@@ -0,0 +1,635 @@
+/*
+ * Device side of the bus for usbh_sim.c: the control pipe with the
+ * standard requests, data toggle and halt bookkeeping, descriptor
+ * building for the class models, and the hub model.
+ *
+ * The hub has a single TT. Port reset takes 10 ms of simulated time and
+ * is seen in GET_STATUS, as on a real hub; the status change endpoint
+ * NAKs until some port has a change bit set.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "vdev.h"
+#include "usbh_sim.h"
+
+#define PORT_CONNECTION     (1U << 0)
+#define PORT_ENABLE         (1U << 1)
+#define PORT_SUSPEND        (1U << 2)
+#define PORT_RESET          (1U << 4)
+#define PORT_POWER          (1U << 8)
+#define PORT_LOW_SPEED      (1U << 9)
+#define PORT_HIGH_SPEED     (1U << 10)
+
+#define HUB_RESET_US        10000
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/*---------------------------------------------------------------------------*/
+/* Descriptors                                                               */
+/*---------------------------------------------------------------------------*/
+
+vdev_t *vdev_new(const char *name, int speed, const vdev_ops_t *ops, void *priv)
+{
+    vdev_t *d = calloc(1, sizeof(*d));
+
+    d->name = name;
+    d->speed = speed;
+    d->ops = ops;
+    d->priv = priv;
+    return d;
+}
+
+void vdev_free(vdev_t *d)
+{
+    if (d)
+    {
+        free(d->priv);
+        free(d);
+    }
+}
+
+void vdev_desc_device(vdev_t *d, uint8_t cls, uint8_t sub, uint8_t proto, uint16_t pid)
+{
+    uint8_t *p = d->dev_desc;
+
+    memset(p, 0, sizeof(d->dev_desc));
+    p[0] = 18;
+    p[1] = 0x01;
+    p[2] = 0x00;                        /* bcdUSB 2.00 */
+    p[3] = 0x02;
+    p[4] = cls;
+    p[5] = sub;
+    p[6] = proto;
+    p[7] = (d->speed == VDEV_SPEED_LOW) ? 8 : 64;
+    p[8] = 0x16;                        /* idVendor 0x0416 */
+    p[9] = 0x04;
+    p[10] = (uint8_t)pid;
+    p[11] = (uint8_t)(pid >> 8);
+    p[12] = 0x00;                       /* bcdDevice 1.00 */
+    p[13] = 0x01;
+    p[17] = 1;                          /* bNumConfigurations */
+}
+
+void vdev_desc_config(vdev_t *d, uint8_t attr)
+{
+    uint8_t *p = d->cfg_desc;
+
+    memset(p, 0, sizeof(d->cfg_desc));
+    p[0] = 9;
+    p[1] = 0x02;
+    p[2] = 9;
+    p[5] = 1;                           /* bConfigurationValue */
+    p[7] = 0x80 | attr;
+    p[8] = 50;                          /* 100 mA */
+}
+
+void vdev_desc_add(vdev_t *d, const uint8_t *desc)
+{
+    uint8_t *p = d->cfg_desc;
+    int len = get16(p + 2);
+
+    if (len + desc[0] > VDEV_CFG_MAX)
+        return;
+    memcpy(p + len, desc, desc[0]);
+    len += desc[0];
+    p[2] = (uint8_t)len;
+    p[3] = (uint8_t)(len >> 8);
+    if (desc[1] == 0x04 && desc[3] == 0)    /* alternate 0 of a new interface */
+        p[4]++;
+}
+
+void vdev_desc_iface(vdev_t *d, int num, int alt, int neps, uint8_t cls, uint8_t sub, uint8_t proto)
+{
+    uint8_t desc[9] = { 9, 0x04, (uint8_t)num, (uint8_t)alt, (uint8_t)neps, cls, sub, proto, 0 };
+
+    vdev_desc_add(d, desc);
+}
+
+void vdev_desc_ep(vdev_t *d, uint8_t addr, uint8_t attr, uint16_t mps, uint8_t interval)
+{
+    uint8_t desc[7] = { 7, 0x05, addr, attr, (uint8_t)mps, (uint8_t)(mps >> 8), interval };
+
+    vdev_desc_add(d, desc);
+}
+
+/* Attributes of endpoint ep in direction in, from the configuration */
+static int ep_attr(vdev_t *d, int in, int ep)
+{
+    const uint8_t *p = d->cfg_desc;
+    int len = get16(p + 2), i;
+
+    for (i = 0; i + 2 <= len && p[i] >= 2; i += p[i])
+    {
+        if (p[i + 1] == 0x05 && (p[i + 2] & 0x0F) == ep && !!(p[i + 2] & 0x80) == in)
+            return p[i + 3] & 0x03;
+    }
+    return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Standard requests                                                         */
+/*---------------------------------------------------------------------------*/
+
+static void reset_endpoints(vdev_t *d)
+{
+    memset(d->toggle, 0, sizeof(d->toggle));
+    memset(d->halt, 0, sizeof(d->halt));
+}
+
+void vdev_bus_reset(vdev_t *d)
+{
+    d->addr = 0;
+    d->config = 0;
+    d->set_addr = -1;
+    d->ctrl_stage = 0;
+    memset(d->alt, 0, sizeof(d->alt));
+    reset_endpoints(d);
+    if (d->ops->reset)
+        d->ops->reset(d);
+}
+
+/* Reset the toggles of the endpoints of interface ifnum, any alternate */
+static void reset_iface_endpoints(vdev_t *d, int ifnum)
+{
+    const uint8_t *p = d->cfg_desc;
+    int len = get16(p + 2), i, cur = -1;
+
+    for (i = 0; i + 2 <= len && p[i] >= 2; i += p[i])
+    {
+        if (p[i + 1] == 0x04)
+            cur = p[i + 2];
+        else if (p[i + 1] == 0x05 && cur == ifnum)
+        {
+            d->toggle[p[i + 2] >> 7][p[i + 2] & 0x0F] = 0;
+            d->halt[p[i + 2] >> 7][p[i + 2] & 0x0F] = 0;
+        }
+    }
+}
+
+static int string_desc(int index, const char *s, uint8_t *data)
+{
+    int n = 2;
+
+    if (index == 0)
+    {
+        data[2] = 0x09;                 /* English (US) */
+        data[3] = 0x04;
+        n = 4;
+    }
+    else
+    {
+        for (; *s && n < 64; s++, n += 2)
+        {
+            data[n] = (uint8_t)*s;
+            data[n + 1] = 0;
+        }
+    }
+    data[0] = (uint8_t)n;
+    data[1] = 0x03;
+    return n;
+}
+
+/* Returns the data length, VDEV_STALL, or 1 << 16 when not a standard
+ * request the core answers */
+#define NOT_STD     (1 << 16)
+
+static int std_request(vdev_t *d, const uint8_t *s, uint8_t *data)
+{
+    int type = s[0] & 0x7F, req = s[1];
+    int value = get16(s + 2), index = get16(s + 4);
+
+    if ((s[0] & 0x60) != 0)
+        return NOT_STD;
+
+    switch (req)
+    {
+        case 0x00:                      /* GET_STATUS */
+            data[0] = data[1] = 0;
+            return 2;
+
+        case 0x01:                      /* CLEAR_FEATURE */
+            if (type == 0x02 && value == 0)
+            {
+                d->halt[index >> 7][index & 0x0F] = 0;
+                d->toggle[index >> 7][index & 0x0F] = 0;
+            }
+            return 0;
+
+        case 0x03:                      /* SET_FEATURE */
+            if (type == 0x02 && value == 0)
+                d->halt[index >> 7][index & 0x0F] = 1;
+            return 0;
+
+        case 0x05:                      /* SET_ADDRESS */
+            d->set_addr = value & 0x7F;
+            return 0;
+
+        case 0x06:                      /* GET_DESCRIPTOR */
+            if (type != 0x00)
+                return NOT_STD;
+            switch (value >> 8)
+            {
+                case 0x01:
+                    memcpy(data, d->dev_desc, 18);
+                    return 18;
+                case 0x02:
+                    memcpy(data, d->cfg_desc, get16(d->cfg_desc + 2));
+                    return get16(d->cfg_desc + 2);
+                case 0x03:
+                    return string_desc(value & 0xFF, d->name, data);
+            }
+            return VDEV_STALL;
+
+        case 0x08:                      /* GET_CONFIGURATION */
+            data[0] = d->config;
+            return 1;
+
+        case 0x09:                      /* SET_CONFIGURATION */
+            if (value > 1)
+                return VDEV_STALL;
+            d->config = (uint8_t)value;
+            memset(d->alt, 0, sizeof(d->alt));
+            reset_endpoints(d);
+            if (d->ops->reset)
+                d->ops->reset(d);
+            return 0;
+
+        case 0x0A:                      /* GET_INTERFACE */
+            data[0] = (index < 8) ? d->alt[index] : 0;
+            return 1;
+
+        case 0x0B:                      /* SET_INTERFACE */
+            if (index >= 8)
+                return VDEV_STALL;
+            d->alt[index] = (uint8_t)value;
+            reset_iface_endpoints(d, index);
+            if (d->ops->set_interface)
+                d->ops->set_interface(d, index, value);
+            return 0;
+    }
+    return VDEV_STALL;
+}
+
+static int do_request(vdev_t *d, uint8_t *data)
+{
+    int r = std_request(d, d->setup, data);
+
+    if (r == NOT_STD)
+        r = d->ops->control ? d->ops->control(d, d->setup, data) : VDEV_STALL;
+    if (r == VDEV_STALL)
+        d->bad_requests++;
+    return r;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Transactions                                                              */
+/*---------------------------------------------------------------------------*/
+
+static void check_toggle(vdev_t *d, int in, int ep, int toggle)
+{
+    if (toggle < 0)
+        return;
+    if (toggle != d->toggle[in][ep])
+        d->toggle_errors++;
+    d->toggle[in][ep] = (uint8_t)(toggle ^ 1);
+}
+
+int vdev_setup(vdev_t *d, const uint8_t *pkt)
+{
+    int wLength = get16(pkt + 6), r;
+
+    memcpy(d->setup, pkt, 8);
+    d->setups++;
+    d->toggle[0][0] = d->toggle[1][0] = 1;
+    d->ctrl_stall = 0;
+    d->ctrl_pos = 0;
+    d->ctrl_len = 0;
+    d->set_addr = -1;
+
+    if (pkt[0] & 0x80)
+    {
+        memset(d->ctrl_buf, 0, sizeof(d->ctrl_buf));
+        r = do_request(d, d->ctrl_buf);
+        if (r < 0)
+            d->ctrl_stall = 1;
+        else
+            d->ctrl_len = (r < wLength) ? r : wLength;
+        d->ctrl_stage = 1;
+    }
+    else
+    {
+        d->ctrl_stage = wLength ? 1 : 2;
+    }
+    return 0;
+}
+
+static int ctrl_in(vdev_t *d, int toggle, uint8_t *buf, int max)
+{
+    int n, r;
+
+    if (d->ctrl_stall || d->ctrl_stage == 0)
+        return VDEV_STALL;
+
+    if (d->setup[0] & 0x80)
+    {
+        /* data stage of an IN request */
+        n = d->ctrl_len - d->ctrl_pos;
+        if (n > max)
+            n = max;
+        memcpy(buf, d->ctrl_buf + d->ctrl_pos, n);
+        d->ctrl_pos += n;
+        check_toggle(d, 1, 0, toggle);
+        return n;
+    }
+
+    /* status stage of an OUT request, the request takes effect here */
+    if (toggle >= 0 && toggle != 1)
+        d->toggle_errors++;
+    r = do_request(d, d->ctrl_buf);
+    d->ctrl_stage = 0;
+    if (r < 0)
+    {
+        d->ctrl_stall = 1;
+        return VDEV_STALL;
+    }
+    if (d->set_addr >= 0)
+        d->addr = (uint8_t)d->set_addr;
+    d->set_addr = -1;
+    return 0;
+}
+
+static int ctrl_out(vdev_t *d, int toggle, const uint8_t *buf, int len)
+{
+    int wLength = get16(d->setup + 6);
+
+    if (d->ctrl_stall || d->ctrl_stage == 0)
+        return VDEV_STALL;
+
+    if (d->setup[0] & 0x80)
+    {
+        /* status stage of an IN request */
+        if (toggle >= 0 && toggle != 1)
+            d->toggle_errors++;
+        d->ctrl_stage = 0;
+        return 0;
+    }
+
+    if (d->ctrl_pos + len > wLength || d->ctrl_pos + len > (int)sizeof(d->ctrl_buf))
+        return VDEV_STALL;
+    memcpy(d->ctrl_buf + d->ctrl_pos, buf, len);
+    d->ctrl_pos += len;
+    check_toggle(d, 0, 0, toggle);
+    if (d->ctrl_pos == wLength)
+        d->ctrl_stage = 2;
+    return 0;
+}
+
+int vdev_in(vdev_t *d, int ep, int toggle, uint8_t *buf, int max)
+{
+    uint64_t now;
+    int r;
+
+    if (ep == 0)
+        return ctrl_in(d, toggle, buf, max);
+
+    d->in_tokens++;
+    if (ep_attr(d, 1, ep) == 3)
+    {
+        now = usbh_sim_time_us();
+        if (d->int_polls++ == 0)
+            d->first_poll_us = now;
+        d->last_poll_us = now;
+    }
+    if (d->halt[1][ep])
+        return VDEV_STALL;
+    r = d->ops->in ? d->ops->in(d, ep, buf, max) : VDEV_STALL;
+    if (r == VDEV_NAK)
+        d->naks++;
+    else if (r >= 0)
+        check_toggle(d, 1, ep, toggle);
+    return r;
+}
+
+int vdev_out(vdev_t *d, int ep, int toggle, const uint8_t *buf, int len)
+{
+    int r;
+
+    if (ep == 0)
+        return ctrl_out(d, toggle, buf, len);
+
+    d->out_tokens++;
+    if (d->halt[0][ep])
+        return VDEV_STALL;
+    r = d->ops->out ? d->ops->out(d, ep, buf, len) : VDEV_STALL;
+    if (r == VDEV_NAK)
+        d->naks++;
+    else if (r >= 0)
+        check_toggle(d, 0, ep, toggle);
+    return r;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Hub                                                                       */
+/*---------------------------------------------------------------------------*/
+
+static void hub_update(vdev_t *h)
+{
+    uint64_t now = usbh_sim_time_us();
+    vdev_t *c;
+    int port;
+
+    for (port = 1; port <= h->nports; port++)
+    {
+        if (!(h->port_status[port] & PORT_RESET) || now < h->reset_done_us[port])
+            continue;
+        h->port_status[port] &= (uint16_t)~PORT_RESET;
+        c = h->child[port];
+        if (c && (h->port_status[port] & PORT_CONNECTION))
+        {
+            h->port_status[port] |= PORT_ENABLE;
+            if (c->speed == VDEV_SPEED_HIGH)
+                h->port_status[port] |= PORT_HIGH_SPEED;
+            else if (c->speed == VDEV_SPEED_LOW)
+                h->port_status[port] |= PORT_LOW_SPEED;
+        }
+        h->port_change[port] |= PORT_RESET;
+    }
+}
+
+static int hub_control(vdev_t *h, const uint8_t *s, uint8_t *data)
+{
+    int value = get16(s + 2), port = get16(s + 4) & 0xFF;
+    uint16_t *st = &h->port_status[port];
+
+    if ((s[0] & 0x60) != 0x20)
+        return VDEV_STALL;
+
+    hub_update(h);
+
+    switch ((s[0] << 8) | s[1])
+    {
+        case 0xA006:                    /* GET_DESCRIPTOR hub */
+            memset(data, 0, 9);
+            data[0] = 9;
+            data[1] = 0x29;
+            data[2] = (uint8_t)h->nports;
+            data[3] = 0x09;             /* per-port power and over-current */
+            data[5] = 50;               /* 100 ms power-on to power-good */
+            data[6] = 100;
+            data[8] = 0xFF;
+            return 9;
+
+        case 0xA000:                    /* GET_STATUS hub */
+            memset(data, 0, 4);
+            return 4;
+
+        case 0x2001:                    /* CLEAR_FEATURE hub */
+            return 0;
+
+        case 0xA300:                    /* GET_STATUS port */
+            if (port < 1 || port > h->nports)
+                return VDEV_STALL;
+            data[0] = (uint8_t)*st;
+            data[1] = (uint8_t)(*st >> 8);
+            data[2] = (uint8_t)h->port_change[port];
+            data[3] = (uint8_t)(h->port_change[port] >> 8);
+            return 4;
+
+        case 0x2303:                    /* SET_FEATURE port */
+            if (port < 1 || port > h->nports)
+                return VDEV_STALL;
+            switch (value)
+            {
+                case 4:                 /* PORT_RESET */
+                    if (!(*st & PORT_CONNECTION))
+                        return 0;
+                    *st = (uint16_t)((*st & ~(PORT_ENABLE | PORT_LOW_SPEED | PORT_HIGH_SPEED)) | PORT_RESET);
+                    h->reset_done_us[port] = usbh_sim_time_us() + HUB_RESET_US;
+                    vdev_bus_reset(h->child[port]);
+                    return 0;
+                case 8:                 /* PORT_POWER */
+                    if (!(*st & PORT_POWER))
+                    {
+                        *st |= PORT_POWER;
+                        if (h->child[port])
+                        {
+                            *st |= PORT_CONNECTION;
+                            h->port_change[port] |= PORT_CONNECTION;
+                        }
+                    }
+                    return 0;
+                case 2:                 /* PORT_SUSPEND */
+                    *st |= PORT_SUSPEND;
+                    return 0;
+            }
+            return 0;
+
+        case 0x2301:                    /* CLEAR_FEATURE port */
+            if (port < 1 || port > h->nports)
+                return VDEV_STALL;
+            if (value >= 16 && value <= 20)
+                h->port_change[port] &= (uint16_t)~(1U << (value - 16));
+            else if (value == 1)
+                *st &= (uint16_t)~PORT_ENABLE;
+            else if (value == 2)
+                *st &= (uint16_t)~PORT_SUSPEND;
+            else if (value == 8)
+                *st = 0;
+            return 0;
+
+        case 0x2308:                    /* CLEAR_TT_BUFFER */
+        case 0x2309:                    /* RESET_TT */
+            return 0;
+    }
+    return VDEV_STALL;
+}
+
+static int hub_in(vdev_t *h, int ep, uint8_t *buf, int max)
+{
+    int port, map = 0;
+
+    if (ep != 1)
+        return VDEV_STALL;
+    hub_update(h);
+    for (port = 1; port <= h->nports; port++)
+    {
+        if (h->port_change[port])
+            map |= 1 << port;
+    }
+    if (!map)
+        return VDEV_NAK;
+    buf[0] = (uint8_t)map;
+    return 1;
+}
+
+static void hub_reset(vdev_t *h)
+{
+    /* a bus reset or configuration change powers all ports off */
+    if (h->config)
+        return;
+    memset(h->port_status, 0, sizeof(h->port_status));
+    memset(h->port_change, 0, sizeof(h->port_change));
+}
+
+static const vdev_ops_t s_hub_ops =
+{
+    hub_control, hub_in, NULL, hub_reset, NULL
+};
+
+vdev_t *vdev_hub_new(int nports)
+{
+    vdev_t *h = vdev_new("vhub", VDEV_SPEED_HIGH, &s_hub_ops, NULL);
+
+    if (nports > VDEV_MAX_PORTS)
+        nports = VDEV_MAX_PORTS;
+    h->nports = nports;
+    vdev_desc_device(h, 0x09, 0x00, 0x01, 0x0009);
+    vdev_desc_config(h, 0x40);
+    vdev_desc_iface(h, 0, 0, 1, 0x09, 0x00, 0x00);
+    vdev_desc_ep(h, 0x81, 0x03, 1, 12);     /* 2^11 microframes = 256 ms */
+    return h;
+}
+
+int vdev_hub_port_enabled(vdev_t *h, int port)
+{
+    if (port < 1 || port > h->nports)
+        return 0;
+    hub_update(h);
+    return (h->port_status[port] & PORT_ENABLE) != 0;
+}
+
+void vdev_hub_attach(vdev_t *h, int port, vdev_t *d)
+{
+    if (port < 1 || port > h->nports)
+        return;
+    h->child[port] = d;
+    d->parent = h;
+    d->port = port;
+    vdev_bus_reset(d);
+    if (h->port_status[port] & PORT_POWER)
+    {
+        h->port_status[port] |= PORT_CONNECTION;
+        h->port_change[port] |= PORT_CONNECTION;
+    }
+}
+
+void vdev_hub_detach(vdev_t *h, int port)
+{
+    vdev_t *d;
+
+    if (port < 1 || port > h->nports || !(d = h->child[port]))
+        return;
+    h->child[port] = NULL;
+    d->parent = NULL;
+    if (h->port_status[port] & PORT_CONNECTION)
+    {
+        h->port_status[port] &= PORT_POWER;
+        h->port_change[port] |= PORT_CONNECTION;
+    }
+}
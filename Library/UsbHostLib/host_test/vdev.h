@@ -0,0 +1,137 @@
+/*
+ * Scripted USB devices for the host controller models of usbh_sim.c.
+ *
+ * Every device answers the standard requests from its descriptors and
+ * checks the data toggles it is sent and sends. The class models are an
+ * HS hub with a single TT, a Bulk-Only mass storage disk in memory, a
+ * boot protocol mouse, a CDC ACM loopback and a UAC 1.0 microphone.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef VDEV_H
+#define VDEV_H
+
+#include <stdint.h>
+
+/* Same order as SPEED_E of usb.h */
+#define VDEV_SPEED_LOW      0
+#define VDEV_SPEED_FULL     1
+#define VDEV_SPEED_HIGH     2
+
+/* Handshakes other than ACK */
+#define VDEV_NAK            (-1)
+#define VDEV_STALL          (-2)
+
+#define VDEV_MAX_PORTS      7
+#define VDEV_CFG_MAX        256
+
+typedef struct vdev vdev_t;
+
+typedef struct
+{
+    /* Class or vendor request on ep0. For IN requests fill data and
+     * return its length, for OUT requests data holds the wLength bytes
+     * of the data stage. Return VDEV_STALL to refuse. */
+    int (*control)(vdev_t *d, const uint8_t *setup, uint8_t *data);
+    /* IN token on endpoint ep: up to max bytes into buf, or a handshake */
+    int (*in)(vdev_t *d, int ep, uint8_t *buf, int max);
+    /* OUT data on endpoint ep: 0 to ACK, or a handshake */
+    int (*out)(vdev_t *d, int ep, const uint8_t *buf, int len);
+    /* Bus reset, SET_CONFIGURATION or SET_INTERFACE */
+    void (*reset)(vdev_t *d);
+    void (*set_interface)(vdev_t *d, int ifnum, int alt);
+} vdev_ops_t;
+
+struct vdev
+{
+    const char *name;
+    int speed;                          /* VDEV_SPEED_* */
+    uint8_t dev_desc[18];
+    uint8_t cfg_desc[VDEV_CFG_MAX];     /* whole configuration */
+    const vdev_ops_t *ops;
+    void *priv;                         /* class model state */
+
+    /* Bus state */
+    uint8_t addr;
+    uint8_t config;
+    uint8_t alt[8];
+    uint8_t toggle[2][16];              /* [IN][ep]: next DATA0/1 */
+    uint8_t halt[2][16];
+
+    /* Control pipe */
+    uint8_t setup[8];
+    uint8_t ctrl_buf[1024];
+    int ctrl_len, ctrl_pos;
+    int ctrl_stage;                     /* 0 idle, 1 data, 2 status */
+    int ctrl_stall;
+    int set_addr;                       /* address to take after the status stage */
+
+    /* Topology: upstream hub (NULL on a root port) and its port 1..n */
+    vdev_t *parent;
+    int port;
+
+    /* Hub model */
+    int nports;
+    vdev_t *child[VDEV_MAX_PORTS + 1];  /* [1..nports] */
+    uint16_t port_status[VDEV_MAX_PORTS + 1];
+    uint16_t port_change[VDEV_MAX_PORTS + 1];
+    uint64_t reset_done_us[VDEV_MAX_PORTS + 1];
+
+    /* Counters */
+    uint32_t setups;                    /* SETUP packets */
+    uint32_t in_tokens, out_tokens;     /* non-control endpoints */
+    uint32_t naks;
+    uint32_t toggle_errors;             /* DATA0/1 out of sequence */
+    uint32_t bad_requests;              /* requests the device stalled */
+    uint32_t int_polls;                 /* IN tokens on the interrupt endpoint */
+    uint64_t first_poll_us, last_poll_us;
+};
+
+/* Class models. Each returns a detached device. */
+vdev_t *vdev_hub_new(int nports);
+vdev_t *vdev_msc_new(int speed, uint32_t sectors);
+vdev_t *vdev_hid_mouse_new(int speed);
+vdev_t *vdev_cdc_acm_new(int speed);
+vdev_t *vdev_uac_mic_new(void);
+void vdev_free(vdev_t *d);
+
+/* Plug into / pull from a downstream port of a hub model */
+void vdev_hub_attach(vdev_t *hub, int port, vdev_t *d);
+void vdev_hub_detach(vdev_t *hub, int port);
+/* Whether packets for downstream devices pass through the port */
+int  vdev_hub_port_enabled(vdev_t *hub, int port);
+
+/* Mass storage: the disk image, and a delay between a CBW and its data */
+uint8_t *vdev_msc_image(vdev_t *d);
+void vdev_msc_latency(vdev_t *d, uint32_t cmd_us);
+uint32_t vdev_msc_commands(vdev_t *d);
+
+/* Mouse: queue an input report for the interrupt endpoint */
+void vdev_hid_push(vdev_t *d, const uint8_t *report, int len);
+
+/* CDC: bytes looped back so far */
+uint32_t vdev_cdc_looped(vdev_t *d);
+
+/* Microphone: isochronous packets sent, and the highest count of frames
+ * in a row that had no IN token while streaming */
+uint32_t vdev_uac_packets(vdev_t *d);
+uint32_t vdev_uac_max_gap(vdev_t *d);
+
+/* Descriptor building for the class models: device descriptor, then the
+ * configuration header followed by interfaces, class descriptors and
+ * endpoints in order. wTotalLength and bNumInterfaces follow. */
+vdev_t *vdev_new(const char *name, int speed, const vdev_ops_t *ops, void *priv);
+void vdev_desc_device(vdev_t *d, uint8_t cls, uint8_t sub, uint8_t proto, uint16_t pid);
+void vdev_desc_config(vdev_t *d, uint8_t attr);
+void vdev_desc_iface(vdev_t *d, int num, int alt, int neps, uint8_t cls, uint8_t sub, uint8_t proto);
+void vdev_desc_ep(vdev_t *d, uint8_t addr, uint8_t attr, uint16_t mps, uint8_t interval);
+void vdev_desc_add(vdev_t *d, const uint8_t *desc);
+
+/* Bus side, called by the host controller models. toggle is the DATA
+ * PID of the packet (-1 for isochronous). */
+void vdev_bus_reset(vdev_t *d);
+int  vdev_setup(vdev_t *d, const uint8_t *pkt);
+int  vdev_in(vdev_t *d, int ep, int toggle, uint8_t *buf, int max);
+int  vdev_out(vdev_t *d, int ep, int toggle, const uint8_t *buf, int len);
+
+#endif /* VDEV_H */
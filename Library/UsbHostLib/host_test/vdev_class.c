@@ -0,0 +1,597 @@
+/*
+ * Class models on top of vdev.c: a Bulk-Only mass storage disk, a boot
+ * mouse, a CDC ACM loopback and a UAC 1.0 microphone.
+ *
+ * They follow their class specifications closely enough for the
+ * library's class drivers to enumerate and use them, and count what a
+ * test needs to check throughput and scheduling.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "vdev.h"
+#include "usbh_sim.h"
+
+#define SECTOR_SIZE     512
+
+static uint32_t get32be(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put32be(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void put32le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static int bulk_mps(int speed)
+{
+    return speed == VDEV_SPEED_HIGH ? 512 : 64;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Mass storage, Bulk-Only Transport with a SCSI disk                        */
+/*---------------------------------------------------------------------------*/
+
+enum { MSC_CBW, MSC_DATA_IN, MSC_DATA_OUT, MSC_CSW };
+
+typedef struct
+{
+    uint8_t *image;
+    uint32_t sectors;
+    uint32_t latency_us;
+    uint32_t commands;
+
+    int state;
+    uint32_t tag, residue;
+    uint8_t status;
+    uint8_t sense_key, asc;
+    uint64_t ready_us;                  /* no data or CSW before this */
+
+    uint8_t resp[64];
+    uint8_t *data;                      /* data stage buffer */
+    uint32_t data_len, data_pos;
+} msc_t;
+
+static int msc_control(vdev_t *d, const uint8_t *s, uint8_t *data)
+{
+    msc_t *m = d->priv;
+
+    if (s[0] == 0xA1 && s[1] == 0xFE)   /* GET_MAX_LUN */
+    {
+        data[0] = 0;
+        return 1;
+    }
+    if (s[0] == 0x21 && s[1] == 0xFF)   /* Bulk-Only Mass Storage Reset */
+    {
+        m->state = MSC_CBW;
+        return 0;
+    }
+    return VDEV_STALL;
+}
+
+static void msc_fail(msc_t *m, uint8_t key, uint8_t asc)
+{
+    m->status = 1;
+    m->sense_key = key;
+    m->asc = asc;
+}
+
+/* Decode a CBW and set up the data stage */
+static void msc_command(vdev_t *d, const uint8_t *cbw)
+{
+    msc_t *m = d->priv;
+    const uint8_t *cb = cbw + 15;
+    uint32_t dlen = cbw[8] | (cbw[9] << 8) | (cbw[10] << 16) | ((uint32_t)cbw[11] << 24);
+    uint32_t lba, cnt, avail = 0;
+    int in = (cbw[12] & 0x80) != 0;
+
+    m->commands++;
+    m->tag = cbw[4] | (cbw[5] << 8) | (cbw[6] << 16) | ((uint32_t)cbw[7] << 24);
+    m->status = 0;
+    m->data = m->resp;
+    memset(m->resp, 0, sizeof(m->resp));
+
+    switch (cb[0])
+    {
+        case 0x00:                      /* TEST UNIT READY */
+            break;
+
+        case 0x03:                      /* REQUEST SENSE */
+            m->resp[0] = 0x70;
+            m->resp[2] = m->sense_key;
+            m->resp[7] = 10;
+            m->resp[12] = m->asc;
+            m->sense_key = m->asc = 0;
+            avail = 18;
+            break;
+
+        case 0x12:                      /* INQUIRY */
+            m->resp[1] = 0x80;          /* removable */
+            m->resp[2] = 0x04;
+            m->resp[3] = 0x02;
+            m->resp[4] = 31;
+            memcpy(m->resp + 8, "NUVOTON VIRTUAL DISK    1.00", 28);
+            avail = 36;
+            break;
+
+        case 0x1A:                      /* MODE SENSE(6) */
+            m->resp[0] = 3;
+            avail = 4;
+            break;
+
+        case 0x5A:                      /* MODE SENSE(10) */
+            m->resp[1] = 6;
+            avail = 8;
+            break;
+
+        case 0x1E:                      /* PREVENT ALLOW MEDIUM REMOVAL */
+            break;
+
+        case 0x23:                      /* READ FORMAT CAPACITIES */
+            m->resp[3] = 8;
+            put32be(m->resp + 4, m->sectors);
+            put32be(m->resp + 8, SECTOR_SIZE);
+            m->resp[8] = 0x02;          /* formatted media */
+            avail = 12;
+            break;
+
+        case 0x25:                      /* READ CAPACITY(10) */
+            put32be(m->resp, m->sectors - 1);
+            put32be(m->resp + 4, SECTOR_SIZE);
+            avail = 8;
+            break;
+
+        case 0x28:                      /* READ(10) */
+        case 0x2A:                      /* WRITE(10) */
+            lba = get32be(cb + 2);
+            cnt = (uint32_t)((cb[7] << 8) | cb[8]);
+            if (lba + cnt > m->sectors)
+            {
+                msc_fail(m, 0x05, 0x21);        /* LBA out of range */
+                break;
+            }
+            m->data = m->image + (size_t)lba * SECTOR_SIZE;
+            avail = cnt * SECTOR_SIZE;
+            break;
+
+        default:
+            msc_fail(m, 0x05, 0x20);            /* invalid command */
+            break;
+    }
+
+    m->data_len = avail < dlen ? avail : dlen;
+    m->data_pos = 0;
+    m->residue = dlen - m->data_len;
+    m->ready_us = usbh_sim_time_us() + m->latency_us;
+    if (dlen == 0)
+        m->state = MSC_CSW;
+    else
+        m->state = in ? MSC_DATA_IN : MSC_DATA_OUT;
+}
+
+static int msc_in(vdev_t *d, int ep, uint8_t *buf, int max)
+{
+    msc_t *m = d->priv;
+    uint32_t n;
+
+    if (ep != 1)
+        return VDEV_STALL;
+    if (usbh_sim_time_us() < m->ready_us)
+        return VDEV_NAK;
+
+    if (m->state == MSC_DATA_IN)
+    {
+        n = m->data_len - m->data_pos;
+        if (n > (uint32_t)max)
+            n = (uint32_t)max;
+        memcpy(buf, m->data + m->data_pos, n);
+        m->data_pos += n;
+        /* a short packet ends the data stage early */
+        if (m->data_pos == m->data_len)
+            m->state = MSC_CSW;
+        return (int)n;
+    }
+    if (m->state == MSC_CSW)
+    {
+        put32le(buf, 0x53425355);
+        put32le(buf + 4, m->tag);
+        put32le(buf + 8, m->residue);
+        buf[12] = m->status;
+        m->state = MSC_CBW;
+        return 13;
+    }
+    return VDEV_NAK;
+}
+
+static int msc_out(vdev_t *d, int ep, const uint8_t *buf, int len)
+{
+    msc_t *m = d->priv;
+    uint32_t n;
+
+    if (ep != 2)
+        return VDEV_STALL;
+
+    if (m->state == MSC_CBW)
+    {
+        if (len != 31 || buf[0] != 0x55 || buf[1] != 0x53 || buf[2] != 0x42 || buf[3] != 0x43)
+        {
+            d->bad_requests++;
+            return VDEV_STALL;
+        }
+        msc_command(d, buf);
+        return 0;
+    }
+    if (m->state == MSC_DATA_OUT)
+    {
+        if (usbh_sim_time_us() < m->ready_us)
+            return VDEV_NAK;
+        n = m->data_len - m->data_pos;
+        if (n > (uint32_t)len)
+            n = (uint32_t)len;
+        memcpy(m->data + m->data_pos, buf, n);
+        m->data_pos += (uint32_t)len;
+        if (m->data_pos >= m->data_len)
+            m->state = MSC_CSW;
+        return 0;
+    }
+    return VDEV_NAK;
+}
+
+static void msc_reset(vdev_t *d)
+{
+    msc_t *m = d->priv;
+
+    m->state = MSC_CBW;
+}
+
+static const vdev_ops_t s_msc_ops =
+{
+    msc_control, msc_in, msc_out, msc_reset, NULL
+};
+
+vdev_t *vdev_msc_new(int speed, uint32_t sectors)
+{
+    msc_t *m = calloc(1, sizeof(*m));
+    vdev_t *d = vdev_new("vdisk", speed, &s_msc_ops, m);
+
+    m->sectors = sectors;
+    m->image = calloc(sectors, SECTOR_SIZE);
+    vdev_desc_device(d, 0x00, 0x00, 0x00, 0x0017);
+    vdev_desc_config(d, 0x00);
+    vdev_desc_iface(d, 0, 0, 2, 0x08, 0x06, 0x50);
+    vdev_desc_ep(d, 0x81, 0x02, (uint16_t)bulk_mps(speed), 0);
+    vdev_desc_ep(d, 0x02, 0x02, (uint16_t)bulk_mps(speed), 0);
+    return d;
+}
+
+uint8_t *vdev_msc_image(vdev_t *d)
+{
+    return ((msc_t *)d->priv)->image;
+}
+
+void vdev_msc_latency(vdev_t *d, uint32_t cmd_us)
+{
+    ((msc_t *)d->priv)->latency_us = cmd_us;
+}
+
+uint32_t vdev_msc_commands(vdev_t *d)
+{
+    return ((msc_t *)d->priv)->commands;
+}
+
+/*---------------------------------------------------------------------------*/
+/* HID boot mouse                                                            */
+/*---------------------------------------------------------------------------*/
+
+#define HID_QUEUE       16
+
+typedef struct
+{
+    uint8_t report[HID_QUEUE][8];
+    uint8_t len[HID_QUEUE];
+    int head, count;
+} hid_t;
+
+static const uint8_t s_mouse_report_desc[] =
+{
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01,
+    0x95, 0x03, 0x75, 0x01, 0x81, 0x02, 0x95, 0x01, 0x75, 0x05,
+    0x81, 0x01, 0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x09, 0x38,
+    0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x03, 0x81, 0x06,
+    0xC0, 0xC0
+};
+
+static int hid_control(vdev_t *d, const uint8_t *s, uint8_t *data)
+{
+    switch ((s[0] << 8) | s[1])
+    {
+        case 0x8106:                    /* GET_DESCRIPTOR, HID report */
+            if (s[3] != 0x22)
+                return VDEV_STALL;
+            memcpy(data, s_mouse_report_desc, sizeof(s_mouse_report_desc));
+            return sizeof(s_mouse_report_desc);
+        case 0xA101:                    /* GET_REPORT */
+            memset(data, 0, 4);
+            return 4;
+        case 0xA102:                    /* GET_IDLE */
+        case 0xA103:                    /* GET_PROTOCOL */
+            data[0] = 0;
+            return 1;
+        case 0x2109:                    /* SET_REPORT */
+        case 0x210A:                    /* SET_IDLE */
+        case 0x210B:                    /* SET_PROTOCOL */
+            return 0;
+    }
+    return VDEV_STALL;
+}
+
+static int hid_in(vdev_t *d, int ep, uint8_t *buf, int max)
+{
+    hid_t *h = d->priv;
+    int n;
+
+    if (ep != 1)
+        return VDEV_STALL;
+    if (h->count == 0)
+        return VDEV_NAK;
+    n = h->len[h->head] < max ? h->len[h->head] : max;
+    memcpy(buf, h->report[h->head], n);
+    h->head = (h->head + 1) % HID_QUEUE;
+    h->count--;
+    return n;
+}
+
+static const vdev_ops_t s_hid_ops =
+{
+    hid_control, hid_in, NULL, NULL, NULL
+};
+
+vdev_t *vdev_hid_mouse_new(int speed)
+{
+    uint8_t hid_desc[9] = { 9, 0x21, 0x11, 0x01, 0x00, 0x01, 0x22, sizeof(s_mouse_report_desc), 0 };
+    vdev_t *d = vdev_new("vmouse", speed, &s_hid_ops, calloc(1, sizeof(hid_t)));
+
+    vdev_desc_device(d, 0x00, 0x00, 0x00, 0x0018);
+    vdev_desc_config(d, 0x20);
+    vdev_desc_iface(d, 0, 0, 1, 0x03, 0x01, 0x02);
+    vdev_desc_add(d, hid_desc);
+    /* 8 ms at every speed: 2^(7-1) microframes on high speed */
+    vdev_desc_ep(d, 0x81, 0x03, 4, speed == VDEV_SPEED_HIGH ? 7 : 8);
+    return d;
+}
+
+void vdev_hid_push(vdev_t *d, const uint8_t *report, int len)
+{
+    hid_t *h = d->priv;
+    int i;
+
+    if (h->count == HID_QUEUE)
+        return;
+    i = (h->head + h->count) % HID_QUEUE;
+    if (len > 8)
+        len = 8;
+    memcpy(h->report[i], report, len);
+    h->len[i] = (uint8_t)len;
+    h->count++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* CDC ACM loopback                                                          */
+/*---------------------------------------------------------------------------*/
+
+#define CDC_FIFO        4096
+
+typedef struct
+{
+    uint8_t line_coding[7];
+    uint8_t fifo[CDC_FIFO];
+    int head, count;
+    uint32_t looped;
+} cdc_t;
+
+static int cdc_control(vdev_t *d, const uint8_t *s, uint8_t *data)
+{
+    cdc_t *c = d->priv;
+
+    switch ((s[0] << 8) | s[1])
+    {
+        case 0x2120:                    /* SET_LINE_CODING */
+            memcpy(c->line_coding, data, 7);
+            return 0;
+        case 0xA121:                    /* GET_LINE_CODING */
+            memcpy(data, c->line_coding, 7);
+            return 7;
+        case 0x2122:                    /* SET_CONTROL_LINE_STATE */
+            return 0;
+    }
+    return VDEV_STALL;
+}
+
+static int cdc_in(vdev_t *d, int ep, uint8_t *buf, int max)
+{
+    cdc_t *c = d->priv;
+    int n, i;
+
+    if (ep != 1)                        /* no serial state notifications */
+        return ep == 3 ? VDEV_NAK : VDEV_STALL;
+    if (c->count == 0)
+        return VDEV_NAK;
+    n = c->count < max ? c->count : max;
+    for (i = 0; i < n; i++)
+        buf[i] = c->fifo[(c->head + i) % CDC_FIFO];
+    c->head = (c->head + n) % CDC_FIFO;
+    c->count -= n;
+    c->looped += (uint32_t)n;
+    return n;
+}
+
+static int cdc_out(vdev_t *d, int ep, const uint8_t *buf, int len)
+{
+    cdc_t *c = d->priv;
+    int i;
+
+    if (ep != 2)
+        return VDEV_STALL;
+    if (c->count + len > CDC_FIFO)
+        return VDEV_NAK;
+    for (i = 0; i < len; i++)
+        c->fifo[(c->head + c->count + i) % CDC_FIFO] = buf[i];
+    c->count += len;
+    return 0;
+}
+
+static const vdev_ops_t s_cdc_ops =
+{
+    cdc_control, cdc_in, cdc_out, NULL, NULL
+};
+
+vdev_t *vdev_cdc_acm_new(int speed)
+{
+    static const uint8_t header[] = { 5, 0x24, 0x00, 0x10, 0x01 };
+    static const uint8_t call_mgmt[] = { 5, 0x24, 0x01, 0x00, 0x01 };
+    static const uint8_t acm[] = { 4, 0x24, 0x02, 0x02 };
+    static const uint8_t cdc_union[] = { 5, 0x24, 0x06, 0x00, 0x01 };
+    cdc_t *c = calloc(1, sizeof(*c));
+    vdev_t *d = vdev_new("vacm", speed, &s_cdc_ops, c);
+
+    put32le(c->line_coding, 115200);
+    c->line_coding[6] = 8;
+    vdev_desc_device(d, 0x02, 0x00, 0x00, 0x0019);
+    vdev_desc_config(d, 0x00);
+    vdev_desc_iface(d, 0, 0, 1, 0x02, 0x02, 0x01);
+    vdev_desc_add(d, header);
+    vdev_desc_add(d, call_mgmt);
+    vdev_desc_add(d, acm);
+    vdev_desc_add(d, cdc_union);
+    vdev_desc_ep(d, 0x83, 0x03, 8, speed == VDEV_SPEED_HIGH ? 8 : 16);
+    vdev_desc_iface(d, 1, 0, 2, 0x0A, 0x00, 0x00);
+    vdev_desc_ep(d, 0x81, 0x02, (uint16_t)bulk_mps(speed), 0);
+    vdev_desc_ep(d, 0x02, 0x02, (uint16_t)bulk_mps(speed), 0);
+    return d;
+}
+
+uint32_t vdev_cdc_looped(vdev_t *d)
+{
+    return ((cdc_t *)d->priv)->looped;
+}
+
+/*---------------------------------------------------------------------------*/
+/* UAC 1.0 microphone, full speed, 48 kHz 16-bit mono                        */
+/*---------------------------------------------------------------------------*/
+
+#define UAC_PKT         96
+
+typedef struct
+{
+    uint32_t packets;
+    uint32_t max_gap;
+    uint64_t last_frame;
+    uint16_t sample;
+} uac_t;
+
+static int uac_control(vdev_t *d, const uint8_t *s, uint8_t *data)
+{
+    int len = s[6] | (s[7] << 8);
+
+    if ((s[0] & 0x60) != 0x20)
+        return VDEV_STALL;
+    if (s[0] & 0x80)
+    {
+        /* GET_CUR/MIN/MAX/RES of volume, mute or sampling frequency */
+        memset(data, 0, len);
+        if (len == 3)
+        {
+            data[0] = 0x80;             /* 48000 */
+            data[1] = 0xBB;
+        }
+        return len;
+    }
+    return 0;
+}
+
+static int uac_in(vdev_t *d, int ep, uint8_t *buf, int max)
+{
+    uac_t *u = d->priv;
+    uint64_t frame = usbh_sim_time_us() / 1000;
+    int i, n = max < UAC_PKT ? max : UAC_PKT;
+
+    if (ep != 1 || d->alt[1] != 1)
+        return VDEV_STALL;
+    if (u->packets && frame > u->last_frame + 1 && frame - u->last_frame - 1 > u->max_gap)
+        u->max_gap = (uint32_t)(frame - u->last_frame - 1);
+    u->last_frame = frame;
+    u->packets++;
+    for (i = 0; i + 1 < n; i += 2, u->sample++)
+    {
+        buf[i] = (uint8_t)u->sample;
+        buf[i + 1] = (uint8_t)(u->sample >> 8);
+    }
+    return n;
+}
+
+static void uac_set_interface(vdev_t *d, int ifnum, int alt)
+{
+    uac_t *u = d->priv;
+
+    /* a new stream starts the gap measurement over */
+    if (ifnum == 1)
+        u->packets = 0;
+}
+
+static const vdev_ops_t s_uac_ops =
+{
+    uac_control, uac_in, NULL, NULL, uac_set_interface
+};
+
+vdev_t *vdev_uac_mic_new(void)
+{
+    static const uint8_t ac_header[] = { 9, 0x24, 0x01, 0x00, 0x01, 39, 0, 1, 1 };
+    static const uint8_t input_term[] = { 12, 0x24, 0x02, 1, 0x01, 0x02, 0, 1, 0, 0, 0, 0 };
+    static const uint8_t feature[] = { 9, 0x24, 0x06, 2, 1, 1, 0x03, 0x00, 0 };
+    static const uint8_t output_term[] = { 9, 0x24, 0x03, 3, 0x01, 0x01, 0, 2, 0 };
+    static const uint8_t as_general[] = { 7, 0x24, 0x01, 3, 1, 0x01, 0x00 };
+    static const uint8_t format[] = { 11, 0x24, 0x02, 1, 1, 2, 16, 1, 0x80, 0xBB, 0x00 };
+    static const uint8_t iso_ep[] = { 9, 0x05, 0x81, 0x05, UAC_PKT, 0, 1, 0, 0 };
+    static const uint8_t cs_ep[] = { 7, 0x25, 0x01, 0x01, 0, 0, 0 };
+    vdev_t *d = vdev_new("vmic", VDEV_SPEED_FULL, &s_uac_ops, calloc(1, sizeof(uac_t)));
+
+    vdev_desc_device(d, 0x00, 0x00, 0x00, 0x001A);
+    vdev_desc_config(d, 0x00);
+    vdev_desc_iface(d, 0, 0, 0, 0x01, 0x01, 0x00);
+    vdev_desc_add(d, ac_header);
+    vdev_desc_add(d, input_term);
+    vdev_desc_add(d, feature);
+    vdev_desc_add(d, output_term);
+    vdev_desc_iface(d, 1, 0, 0, 0x01, 0x02, 0x00);
+    vdev_desc_iface(d, 1, 1, 1, 0x01, 0x02, 0x00);
+    vdev_desc_add(d, as_general);
+    vdev_desc_add(d, format);
+    vdev_desc_add(d, iso_ep);
+    vdev_desc_add(d, cs_ep);
+    return d;
+}
+
+uint32_t vdev_uac_packets(vdev_t *d)
+{
+    return ((uac_t *)d->priv)->packets;
+}
+
+uint32_t vdev_uac_max_gap(vdev_t *d)
+{
+    return ((uac_t *)d->priv)->max_gap;
+}
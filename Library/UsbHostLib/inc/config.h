@@ -18,10 +18,23 @@
 #define HCLK_MHZ               192          /* used for loop-delay. must be larger than 
                                                true HCLK clock MHz                        */
 
+#ifndef USBH_OHCI_REGS
+#define USBH_OHCI_REGS         USBH         /* OHCI register block. May be overridden to
+                                               run the stack on a software model.         */
+#endif
+#ifndef USBH_EHCI_REGS
+#define USBH_EHCI_REGS         HSUSBH       /* EHCI register block. May be overridden to
+                                               run the stack on a software model.         */
+#endif
+
+#ifndef ENABLE_OHCI_IRQ
 #define ENABLE_OHCI_IRQ()      NVIC_EnableIRQ(USBH_IRQn)
 #define DISABLE_OHCI_IRQ()     NVIC_DisableIRQ(USBH_IRQn)
+#endif
+#ifndef ENABLE_EHCI_IRQ
 #define ENABLE_EHCI_IRQ()      NVIC_EnableIRQ(HSUSBH_IRQn)
 #define DISABLE_EHCI_IRQ()     NVIC_DisableIRQ(HSUSBH_IRQn)
+#endif
 
 #define ENABLE_OHCI                         /* Enable OHCI host controller                */
 #define ENABLE_EHCI                         /* Enable EHCI host controller                */
@@ -49,9 +62,45 @@
 /*   Memory allocation settings                                                           */
 /*----------------------------------------------------------------------------------------*/
 
+#ifndef STATIC_MEMORY_ALLOC
 #define STATIC_MEMORY_ALLOC    0       /* pre-allocate static memory blocks. No dynamic memory aloocation.
                                           But the maximum number of connected devices and transfers are
                                           limited.  */
+#endif
+
+#if STATIC_MEMORY_ALLOC
+/* Static arenas used instead of heap when STATIC_MEMORY_ALLOC is 1. Devices and UTRs come from
+   fixed object pools. Interfaces, descriptor buffers and class driver objects come from a block
+   arena, each allocation takes ceil(size / USBH_MEM_BLOCK_SIZE) contiguous blocks.
+
+   Arena blocks (64 bytes) per connected device on the M460. The sizes are those of the
+   32-bit build; the allocations were traced in host_test/test_static.c.
+
+       object                              bytes   blocks
+       cfd_buff, every device                512        8
+       IFACE_T, every interface              632       10
+       MSC_T, every LUN                      704       11   one more while probing
+       CDC_DEV_T                             628       10
+       HID RP_INFO_T, every report item       72        2
+       HID interrupt-in buffer     wMaxPacketSize       1   usually
+       UAC stream buffer           wMaxPacketSize x IF_PER_UTR x NUM_UTR
+       ISO_EP_T, EHCI iso endpoint            28        1
+
+       device                        connected   streaming   UTRs in use
+       hub                               18          18          1
+       MSC disk, one LUN                 29 (40)     29          1 per command
+       HID mouse, 5 report items         28          29          1
+       CDC ACM, 2 interfaces             38          38          2 + 1 per send
+       UAC mic, 96 byte packets          28          52 (53)     2
+
+   (40) is the peak while the disk is probed, (53) is the mic on EHCI. Every device also takes one UDEV_T from the
+   MAX_UDEV_NUM pool, and a control transfer takes one UTR while it runs.
+   usbh_memory_used() reports the peak usage of every arena.                             */
+#define MAX_UDEV_NUM           8       /*!< Maximum number of connected devices, including hubs      */
+#define MAX_UTR_NUM            32      /*!< Maximum number of concurrently allocated UTRs            */
+#define USBH_MEM_BLOCK_SIZE    64      /*!< Block arena allocate unit size, must be multiple of 32    */
+#define USBH_MEM_BLOCK_NUM     512     /*!< Number of blocks in block arena                          */
+#endif
 
 #define MAX_UDEV_DRIVER        8       /*!< Maximum number of registered drivers                      */
 #define MAX_ALT_PER_IFACE      8       /*!< maximum number of alternative interfaces per interface    */
@@ -62,9 +111,28 @@
    are all allocated from this pool. Allocated unit size is determined by MEM_POOL_UNIT_SIZE.
    May allocate one or more units depend on hardware descriptor type.                                 */
 
+#ifndef MEM_POOL_UNIT_SIZE
 #define MEM_POOL_UNIT_SIZE     64      /*!< A fixed hard coding setting. Do not change it!            */
+#endif
 #define MEM_POOL_UNIT_NUM     256      /*!< Increase this or heap size if memory allocate failed.     */
 
+/*----------------------------------------------------------------------------------------*/
+/*   Mass storage class driver settings                                                   */
+/*----------------------------------------------------------------------------------------*/
+
+/* Per-device MSC command lock. All LUN instances of one mass storage device share a lock,
+   so commands to the same device are issued in order, while different devices can be
+   accessed in parallel from different tasks. Map these to RTOS mutex calls if the USB
+   disks are accessed by more than one task. The mutex must be recursive: the probe holds
+   it while FATFS mounts the new drive. Default is no locking (single task).             */
+#ifndef USBH_MSC_LOCK_T
+#define USBH_MSC_LOCK_T            int
+#define USBH_MSC_LOCK_INIT(lock)   (*(lock) = 0)
+#define USBH_MSC_LOCK_DEINIT(lock)
+#define USBH_MSC_LOCK(lock)
+#define USBH_MSC_UNLOCK(lock)
+#endif
+
 /*----------------------------------------------------------------------------------------*/
 /*   Re-defined staff for various compiler                                                */
 /*----------------------------------------------------------------------------------------*/
@@ -0,0 +1,28 @@
+/**************************************************************************//**
+ * @file     usbh_mem.h
+ * @version  V1.00
+ * @brief    USB Host library private header, included by the library sources only.
+ *
+ * @copyright SPDX-License-Identifier: Apache-2.0
+ * @copyright Copyright (C) 2021 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+#ifndef _USBH_MEM_H_
+#define _USBH_MEM_H_
+
+/// @cond HIDDEN_SYMBOLS
+
+#include "config.h"
+
+#if STATIC_MEMORY_ALLOC
+/*
+ *  Static memory mode must not touch the heap. Any malloc/free left in a library module
+ *  is turned into an undefined symbol, so the image fails to link. Include this header
+ *  after all other headers. Applications including usb.h keep their own malloc/free.
+ */
+#define malloc(size)    usbh_malloc_not_allowed_in_STATIC_MEMORY_ALLOC(size)
+#define free(ptr)       usbh_free_not_allowed_in_STATIC_MEMORY_ALLOC(ptr)
+#endif
+
+/// @endcond HIDDEN_SYMBOLS
+
+#endif  /* _USBH_MEM_H_ */
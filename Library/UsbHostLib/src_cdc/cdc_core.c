@@ -16,6 +16,7 @@
 #include "usb.h"
 #include "usbh_lib.h"
 #include "usbh_cdc.h"
+#include "usbh_mem.h"
 
 /** @addtogroup LIBRARY Library
   @{
@@ -281,11 +282,11 @@ static void  cdc_bulk_in_irq(UTR_T *utr)
     if(utr->status)
     {
         CDC_DBGMSG("cdc_bulk_in_irq - has error: 0x%x\n", utr->status);
-        return;
     }
-
-    if(cdev->rx_func)
+    else if(cdev->rx_func)
+    {
         cdev->rx_func(cdev, utr->buff, utr->xfer_len);
+    }
 
     free_utr(utr);
     cdev->utr_rx = NULL;
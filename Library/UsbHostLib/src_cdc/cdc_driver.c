@@ -16,6 +16,7 @@
 #include "usb.h"
 #include "usbh_lib.h"
 #include "usbh_cdc.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -15,6 +15,7 @@
 
 #include "usb.h"
 #include "hub.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -360,7 +361,7 @@ static void ehci_suspend(void)
 static void ehci_resume(void)
 {
     if(_ehci->UPSCR[0] & 0x1)
-        _ehci->UPSCR[0] = (HSUSBH->UPSCR[0] & ~HSUSBH_UPSCR_SUSPEND_Msk) | HSUSBH_UPSCR_FPR_Msk;
+        _ehci->UPSCR[0] = (_ehci->UPSCR[0] & ~HSUSBH_UPSCR_SUSPEND_Msk) | HSUSBH_UPSCR_FPR_Msk;
 }
 
 static void ehci_shutdown(void)
@@ -427,12 +428,28 @@ static void move_qh_to_remove_list(QH_T *qh)
     }
 }
 
+/*
+ *  The QH lists are shared by every task doing transfers and by the IAAD
+ *  interrupt, so they are only changed with PRIMASK set.
+ */
 static void remove_queue_head(QH_T *qh)
 {
-    DISABLE_EHCI_IRQ();
+    uint32_t irq_state = __get_PRIMASK();
+
+    __disable_irq();
     move_qh_to_remove_list(qh);
-    ENABLE_EHCI_IRQ();
     _ehci->UCMDR |= HSUSBH_UCMDR_IAAD_Msk;
+    __set_PRIMASK(irq_state);
+}
+
+static void link_async_qh(QH_T *qh)
+{
+    uint32_t irq_state = __get_PRIMASK();
+
+    __disable_irq();
+    qh->HLink = _H_qh->HLink;
+    _H_qh->HLink = QH_HLNK_QH(qh);
+    __set_PRIMASK(irq_state);
 }
 
 static void append_to_qtd_list_of_QH(QH_T *qh, qTD_T *qtd)
@@ -662,10 +679,7 @@ static int ehci_ctrl_xfer(UTR_T *utr)
     /* Link QH and start asynchronous transfer                                            */
     /*------------------------------------------------------------------------------------*/
     if(is_new_qh)
-    {
-        qh->HLink = _H_qh->HLink;
-        _H_qh->HLink = QH_HLNK_QH(qh);
-    }
+        link_async_qh(qh);
 
     /*  Start transfer */
     _ehci->UCMDR |= HSUSBH_UCMDR_ASEN_Msk;      /* start asynchronous transfer            */
@@ -782,8 +796,7 @@ static int ehci_bulk_xfer(UTR_T *utr)
         if(utr->ep->bToggle)
             qh->OL_Token |= QTD_DT;
 
-        qh->HLink = _H_qh->HLink;
-        _H_qh->HLink = QH_HLNK_QH(qh);
+        link_async_qh(qh);
     }
 
     /*  Start transfer */
@@ -798,7 +811,8 @@ static int ehci_int_xfer(UTR_T *utr)
     EP_INFO_T  *ep = utr->ep;
     QH_T       *qh, *iqh;
     qTD_T      *qtd, *dummy_qtd;
-    uint32_t   token;
+    uint32_t   token, irq_state;
+    int        interval;
 
     dummy_qtd = alloc_ehci_qTD(NULL);     /* allocate a new dummy qTD                    */
     if(dummy_qtd == NULL)
@@ -849,12 +863,23 @@ static int ehci_int_xfer(UTR_T *utr)
         /*
          *  link QH
          */
-        if(udev->speed == SPEED_HIGH)       /* get head node of this interval             */
-            iqh = get_int_tree_head_node(ep->bInterval);
-        else
-            iqh = get_int_tree_head_node(ep->bInterval * 8);
+        if(udev->speed == SPEED_HIGH)       /* bInterval n is 2^(n-1) micro-frames        */
+        {
+            interval = ep->bInterval;
+            if(interval < 1)
+                interval = 1;
+            if(interval > 16)
+                interval = 16;
+            interval = 0x1 << (interval - 1);
+        }
+        else                                /* bInterval is in frames                     */
+            interval = ep->bInterval * 8;
+        iqh = get_int_tree_head_node(interval);   /* get head node of this interval       */
+        irq_state = __get_PRIMASK();
+        __disable_irq();
         qh->HLink = iqh->HLink;             /* Add to list of the same interval           */
         iqh->HLink = QH_HLNK_QH(qh);
+        __set_PRIMASK(irq_state);
 
         dummy_qtd = qtd;
     }
@@ -969,7 +994,7 @@ static int visit_qtd(qTD_T *qtd)
 static void scan_asynchronous_list()
 {
     QH_T    *qh, *qh_tmp;
-    qTD_T   *q_pre, *qtd, *qtd_tmp;
+    qTD_T   *q_pre = NULL, *qtd, *qtd_tmp;
     UTR_T   *utr;
 
     qh =  QH_PTR(_H_qh->HLink);
@@ -15,6 +15,7 @@
 
 #include "usb.h"
 #include "hub.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -222,7 +223,7 @@ void scan_isochronous_list(void)
                 else
                 {
                     p = ITD_PTR(_PFList[frnidx]);     /* find the preceding iTD            */
-                    while((ITD_PTR(p->Next_Link) != itd) && (p != NULL))
+                    while((p != NULL) && (ITD_PTR(p->Next_Link) != itd))
                     {
                         p = ITD_PTR(p->Next_Link);
                     }
@@ -280,7 +281,7 @@ void scan_isochronous_list(void)
                 else
                 {
                     sp = SITD_PTR(_PFList[frnidx]);   /* find the preceding siTD           */
-                    while((SITD_PTR(sp->Next_Link) != sitd) && (sp != NULL))
+                    while((sp != NULL) && (SITD_PTR(sp->Next_Link) != sitd))
                     {
                         sp = SITD_PTR(sp->Next_Link);
                     }
@@ -649,13 +650,13 @@ static void  write_sitd_info(UTR_T *utr, siTD_T *sitd)
         sitd->Bptr[1] |= scnt;                  /* Transaction count (T-Count)            */
     }
 
-    if(sitd->fidx == IF_PER_UTR)
+    sitd->StsCtrl = (xlen << SITD_XFER_CNT_Pos) | SITD_STATUS_ACTIVE;
+
+    if(sitd->fidx == IF_PER_UTR - 1)        /* interrupt on the last frame of the UTR     */
     {
-        sitd->Sched |= SITD_IOC;
+        sitd->StsCtrl |= SITD_IOC;
     }
 
-    sitd->StsCtrl = (xlen << SITD_XFER_CNT_Pos) | SITD_STATUS_ACTIVE;
-
     sitd->BackLink = SITD_LIST_END;
 }
 
@@ -797,6 +798,7 @@ int ehci_quit_iso_xfer(UTR_T *utr, EP_INFO_T *ep)
 {
     ISO_EP_T   *iso_ep;
     iTD_T      *itd, *itd_next, *p;
+    siTD_T     *sitd, *sitd_next, *sp;
     uint32_t   frnidx;
     uint32_t   now_frame;
 
@@ -859,7 +861,7 @@ int ehci_quit_iso_xfer(UTR_T *utr, EP_INFO_T *ep)
         else
         {
             p = ITD_PTR(_PFList[frnidx]);   /* find the preceding iTD                     */
-            while((ITD_PTR(p->Next_Link) != itd) && (p != NULL))
+            while((p != NULL) && (ITD_PTR(p->Next_Link) != itd))
             {
                 p = ITD_PTR(p->Next_Link);
             }
@@ -878,14 +880,76 @@ int ehci_quit_iso_xfer(UTR_T *utr, EP_INFO_T *ep)
 
         if(utr->td_cnt == 0)                /* All iTD of this UTR done                   */
         {
+            utr->status = USBH_ERR_ABORT;
             utr->bIsTransferDone = 1;
             if(utr->func)
                 utr->func(utr);
-            utr->status = USBH_ERR_ABORT;
         }
         free_ehci_iTD(itd);
         itd = itd_next;
     }
+    iso_ep->itd_list = NULL;
+
+    sitd = iso_ep->sitd_list;               /* get the first siTD from iso_ep's siTD list */
+
+    while(sitd != NULL)                     /* traverse all siTDs of sitd list            */
+    {
+        sitd_next = sitd->next;             /* remember the next siTD                     */
+        utr = sitd->utr;
+
+        /*--------------------------------------------------------------------------------*/
+        /*  Remove this siTD from period frame list                                       */
+        /*--------------------------------------------------------------------------------*/
+        frnidx = sitd->sched_frnidx;
+
+        /*
+         *  Prevent to race with Host Controller. If the siTD to be removed is located in
+         *  current or next frame, wait until HC passed through it.
+         */
+        while(1)
+        {
+            now_frame = (_ehci->UFINDR >> 3) & 0x3FF;
+            if((now_frame == frnidx) || (((now_frame + 1) % 1024) == frnidx))
+                continue;
+            break;
+        }
+
+        if(_PFList[frnidx] == SITD_HLNK_SITD(sitd))
+        {
+            /* is the first entry, just change to next     */
+            _PFList[frnidx] = sitd->Next_Link;
+        }
+        else
+        {
+            sp = SITD_PTR(_PFList[frnidx]);     /* find the preceding siTD                */
+            while((sp != NULL) && (SITD_PTR(sp->Next_Link) != sitd))
+            {
+                sp = SITD_PTR(sp->Next_Link);
+            }
+
+            if(sp == NULL)                  /* link list out of control!                  */
+            {
+                USB_error("ehci_quit_iso_xfer - An siTD lost reference to periodic frame list! 0x%x on %d\n", (int)sitd, frnidx);
+            }
+            else                            /* remove siTD from list                      */
+            {
+                sp->Next_Link = sitd->Next_Link;
+            }
+        }
+
+        utr->td_cnt--;
+
+        if(utr->td_cnt == 0)                /* All siTD of this UTR done                  */
+        {
+            utr->status = USBH_ERR_ABORT;
+            utr->bIsTransferDone = 1;
+            if(utr->func)
+                utr->func(utr);
+        }
+        free_ehci_siTD(sitd);
+        sitd = sitd_next;
+    }
+    iso_ep->sitd_list = NULL;
 
     /*
      *  Remove iso_ep from iso_ep_list
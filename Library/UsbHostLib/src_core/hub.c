@@ -16,6 +16,7 @@
 #include "usb.h"
 #include "usbh_lib.h"
 #include "hub.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -200,7 +201,7 @@ int hub_probe(IFACE_T *iface)
 {
     UDEV_T      *udev = iface->udev;
     ALT_IFACE_T *aif = iface->aif;
-    EP_INFO_T   *ep;
+    EP_INFO_T   *ep = NULL;
     HUB_DEV_T   *hub;
     UTR_T       *utr;
     uint32_t    read_len;
@@ -579,6 +580,7 @@ static int  hub_polling(void)
             if(hub->sc_bitmap & 0x1)
                 hub_status_change(hub);
 
+            ret = 0;
             for(port = 1; port <= hub->bNbrPorts; port++)
             {
                 if(hub->sc_bitmap & (1 << port))
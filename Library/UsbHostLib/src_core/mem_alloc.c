@@ -14,6 +14,7 @@
 #include "NuMicro.h"
 
 #include "usb.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -44,6 +45,26 @@ static volatile int  _device_addr;
 
 static  int  _sidx = 0;;
 
+#if STATIC_MEMORY_ALLOC
+static UDEV_T   _udev_pool[MAX_UDEV_NUM];
+static uint8_t  _udev_used[MAX_UDEV_NUM];
+static UTR_T    _utr_pool[MAX_UTR_NUM];
+static uint8_t  _utr_used[MAX_UTR_NUM];
+
+#ifdef __ICCARM__
+#pragma data_alignment=32
+static uint8_t  _blk_pool[USBH_MEM_BLOCK_NUM][USBH_MEM_BLOCK_SIZE];
+#else
+static uint8_t  _blk_pool[USBH_MEM_BLOCK_NUM][USBH_MEM_BLOCK_SIZE] __attribute__((aligned(32)));
+#endif
+static uint16_t _blk_run[USBH_MEM_BLOCK_NUM];     /* 0: free; otherwise number of blocks of the
+                                                     allocation this block belongs to */
+
+static int  _udev_cnt, _udev_max_cnt;
+static int  _utr_cnt, _utr_max_cnt;
+static int  _blk_cnt, _blk_max_cnt;
+#endif
+
 /*--------------------------------------------------------------------------*/
 /*   Memory alloc/free recording                                            */
 /*--------------------------------------------------------------------------*/
@@ -73,26 +94,148 @@ void usbh_memory_init(void)
 
     memset(_dev_addr_pool, 0, sizeof(_dev_addr_pool));
     _device_addr = 1;
+
+#if STATIC_MEMORY_ALLOC
+    memset(_udev_used, 0, sizeof(_udev_used));
+    memset(_utr_used, 0, sizeof(_utr_used));
+    memset(_blk_run, 0, sizeof(_blk_run));
+    _udev_cnt = _udev_max_cnt = 0;
+    _utr_cnt = _utr_max_cnt = 0;
+    _blk_cnt = _blk_max_cnt = 0;
+#endif
 }
 
 uint32_t  usbh_memory_used(void)
 {
+#if STATIC_MEMORY_ALLOC
+    printf("USB static memory: %d/%d, device: %d/%d (max %d), UTR: %d/%d (max %d), block: %d/%d (max %d)\n",
+           _mem_pool_used, MEM_POOL_UNIT_NUM, _udev_cnt, MAX_UDEV_NUM, _udev_max_cnt,
+           _utr_cnt, MAX_UTR_NUM, _utr_max_cnt, _blk_cnt, USBH_MEM_BLOCK_NUM, _blk_max_cnt);
+    printf("USB object memory used: %d (max %d)\n", _usbh_mem_used, _usbh_max_mem_used);
+#else
     printf("USB static memory: %d/%d, heap used: %d\n", _mem_pool_used, MEM_POOL_UNIT_NUM, _usbh_mem_used);
+#endif
     return _usbh_mem_used;
 }
 
 static void  memory_counter(int size)
 {
+    uint32_t irq_state = __get_PRIMASK();
+
+    __disable_irq();
     _usbh_mem_used += size;
     if(_usbh_mem_used > _usbh_max_mem_used)
         _usbh_max_mem_used = _usbh_mem_used;
+    __set_PRIMASK(irq_state);
+}
+
+#if STATIC_MEMORY_ALLOC
+
+static int  static_obj_alloc(uint8_t *used, int num, int *cnt, int *max_cnt)
+{
+    uint32_t irq_state = __get_PRIMASK();
+    int    i;
+
+    __disable_irq();
+
+    for(i = 0; i < num; i++)
+    {
+        if(used[i] == 0)
+        {
+            used[i] = 1;
+            if(++(*cnt) > *max_cnt)
+                *max_cnt = *cnt;
+            __set_PRIMASK(irq_state);
+            return i;
+        }
+    }
+    __set_PRIMASK(irq_state);
+    return -1;
+}
+
+static void static_obj_free(uint8_t *used, int idx, int *cnt)
+{
+    uint32_t irq_state = __get_PRIMASK();
+
+    __disable_irq();
+    if(used[idx])
+    {
+        used[idx] = 0;
+        (*cnt)--;
+    }
+    __set_PRIMASK(irq_state);
+}
+
+static void * static_blk_alloc(int size)
+{
+    uint32_t irq_state = __get_PRIMASK();
+    int    i, j, nblk;
+
+    nblk = (size + USBH_MEM_BLOCK_SIZE - 1) / USBH_MEM_BLOCK_SIZE;
+    if(nblk == 0)
+        nblk = 1;
+
+    __disable_irq();
+
+    for(i = 0; i + nblk <= USBH_MEM_BLOCK_NUM; )
+    {
+        for(j = 0; j < nblk; j++)
+        {
+            if(_blk_run[i + j] != 0)
+                break;
+        }
+
+        if(j >= nblk)
+        {
+            /* found nblk free contiguous blocks */
+            for(j = 0; j < nblk; j++)
+                _blk_run[i + j] = nblk;
+            _blk_cnt += nblk;
+            if(_blk_cnt > _blk_max_cnt)
+                _blk_max_cnt = _blk_cnt;
+            __set_PRIMASK(irq_state);
+            return &_blk_pool[i];
+        }
+
+        /* skip over the allocation in the way */
+        i += j + _blk_run[i + j];
+    }
+    __set_PRIMASK(irq_state);
+    return NULL;
+}
+
+static void static_blk_free(void *p)
+{
+    uint32_t irq_state = __get_PRIMASK();
+    int    i, j, nblk;
+
+    i = ((uint32_t)p - (uint32_t)&_blk_pool[0]) / USBH_MEM_BLOCK_SIZE;
+    if(((uint32_t)p < (uint32_t)&_blk_pool[0]) || (i >= USBH_MEM_BLOCK_NUM) ||
+            ((uint32_t)p != (uint32_t)&_blk_pool[i]))
+    {
+        USB_error("usbh_free_mem 0x%x - not found!\n", (int)p);
+        return;
+    }
+
+    __disable_irq();
+    nblk = _blk_run[i];
+    for(j = 0; j < nblk; j++)
+        _blk_run[i + j] = 0;
+    _blk_cnt -= nblk;
+    __set_PRIMASK(irq_state);
 }
 
+#endif  /* STATIC_MEMORY_ALLOC */
+
 void * usbh_alloc_mem(int size)
 {
     void  *p;
 
+#if STATIC_MEMORY_ALLOC
+    p = static_blk_alloc(size);
+#else
     p = malloc(size);
+#endif
     if(p == NULL)
     {
         USB_error("usbh_alloc_mem failed! %d\n", size);
@@ -106,7 +249,11 @@ void * usbh_alloc_mem(int size)
 
 void usbh_free_mem(void *p, int size)
 {
+#if STATIC_MEMORY_ALLOC
+    static_blk_free(p);
+#else
     free(p);
+#endif
     memory_counter(0 - size);
 }
 
@@ -118,7 +265,14 @@ UDEV_T * alloc_device(void)
 {
     UDEV_T  *udev;
 
+#if STATIC_MEMORY_ALLOC
+    int     idx;
+
+    idx = static_obj_alloc(_udev_used, MAX_UDEV_NUM, &_udev_cnt, &_udev_max_cnt);
+    udev = (idx < 0) ? NULL : &_udev_pool[idx];
+#else
     udev = malloc(sizeof(*udev));
+#endif
     if(udev == NULL)
     {
         USB_error("alloc_device failed!\n");
@@ -162,8 +316,12 @@ void free_device(UDEV_T *udev)
             d = d->next;
         }
     }
+#if STATIC_MEMORY_ALLOC
+    static_obj_free(_udev_used, udev - &_udev_pool[0], &_udev_cnt);
+#else
     free(udev);
-    memory_counter(-sizeof(*udev));
+#endif
+    memory_counter(0 - (int)sizeof(*udev));
 }
 
 int  alloc_dev_address(void)
@@ -200,7 +358,19 @@ UTR_T * alloc_utr(UDEV_T *udev)
 {
     UTR_T  *utr;
 
+#if STATIC_MEMORY_ALLOC
+    int    idx;
+
+    idx = static_obj_alloc(_utr_used, MAX_UTR_NUM, &_utr_cnt, &_utr_max_cnt);
+    utr = (idx < 0) ? NULL : &_utr_pool[idx];
+#else
+    uint32_t irq_state = __get_PRIMASK();
+
+    /* UTRs are allocated from every task doing transfers; the heap may not be */
+    __disable_irq();
     utr = malloc(sizeof(*utr));
+    __set_PRIMASK(irq_state);
+#endif
     if(utr == NULL)
     {
         USB_error("alloc_utr failed!\n");
@@ -215,11 +385,22 @@ UTR_T * alloc_utr(UDEV_T *udev)
 
 void free_utr(UTR_T *utr)
 {
+#if !STATIC_MEMORY_ALLOC
+    uint32_t irq_state;
+#endif
+
     if(utr == NULL)
         return;
 
     mem_debug("[FREE] [UTR] - 0x%x\n", (int)utr);
+#if STATIC_MEMORY_ALLOC
+    static_obj_free(_utr_used, utr - &_utr_pool[0], &_utr_cnt);
+#else
+    irq_state = __get_PRIMASK();
+    __disable_irq();
     free(utr);
+    __set_PRIMASK(irq_state);
+#endif
     memory_counter(0 - (int)sizeof(*utr));
 }
 
@@ -16,6 +16,7 @@
 #include "usb.h"
 #include "hub.h"
 #include "ohci.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -15,6 +15,7 @@
 
 #include "usb.h"
 #include "hub.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -39,8 +40,8 @@ void  usbh_core_init()
     DISABLE_EHCI_IRQ();
     DISABLE_OHCI_IRQ();
 
-    _ohci = USBH;
-    _ehci = HSUSBH;
+    _ohci = USBH_OHCI_REGS;
+    _ehci = USBH_EHCI_REGS;
 
     memset(_drivers, 0, sizeof(_drivers));
 
@@ -690,6 +691,12 @@ static int  usbh_parse_endpoint(ALT_IFACE_T *alt, int ep_idx, uint8_t *desc_buff
         len -= ep_desc->bLength;
     }
 
+    if(len <= 0)
+    {
+        USB_error("ERR DESCRIPTOR EP not found\n");
+        return USBH_ERR_DESCRIPTOR;         /* fewer endpoints than bNumEndpoints         */
+    }
+
     USB_vdebug("Descriptor Found - Alt: %d, Endpoint 0x%x, remaining len: %d\n", alt->ifd->bAlternateSetting, ep_desc->bEndpointAddress, len);
 
     alt->ep[ep_idx].bEndpointAddress = ep_desc->bEndpointAddress;
@@ -715,7 +722,7 @@ static int  usbh_parse_endpoint(ALT_IFACE_T *alt, int ep_idx, uint8_t *desc_buff
 static int  usbh_parse_interface(UDEV_T *udev, uint8_t *desc_buff, int len)
 {
     int         i, matched, parsed_len = 0;
-    DESC_HDR_T  *hdr;
+    DESC_HDR_T  *hdr = NULL;
     DESC_IF_T   *if_desc;
     IFACE_T     *iface = NULL;
     int         ret;
@@ -15,6 +15,7 @@
 #include "usb.h"
 #include "usbh_lib.h"
 #include "usbh_hid.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -51,7 +52,7 @@ static int hid_probe(IFACE_T *iface)
     UDEV_T       *udev = iface->udev;
     ALT_IFACE_T  *aif = iface->aif;
     DESC_IF_T    *ifd;
-    EP_INFO_T    *ep;
+    EP_INFO_T    *ep = NULL;
     HID_DEV_T    *hdev, *p;
     int          i;
 
@@ -15,6 +15,7 @@
 #include "usb.h"
 #include "usbh_lib.h"
 #include "usbh_hid.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -833,6 +834,8 @@ int hid_parse_mouse_reports(HID_DEV_T *hdev, uint8_t *data, int data_len)
                 s_val = (signed char)usage_val;
             else if(report->report_size <= 16)
                 s_val = (signed short)usage_val;
+            else
+                s_val = (signed)usage_val;
 
             if(report->data_usage == USAGE_ID_X)
             {
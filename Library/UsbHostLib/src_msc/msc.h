@@ -95,6 +95,11 @@ typedef struct msc_t
     uint8_t     max_lun;
     uint8_t     lun;                     /* MSC lun of this instance                      */
     uint8_t     root;                    /* root instance?                                */
+    struct msc_t  *root_msc;             /* root instance of this device, owner of lock   */
+    USBH_MSC_LOCK_T  lock;               /* device command lock, valid in root instance   */
+    uint32_t    tag;                     /* CBW tag counter, valid in root instance       */
+    volatile uint8_t  detached;          /* device is going, valid in root instance       */
+    volatile uint8_t  users;             /* API calls in progress, valid in root instance */
     struct bulk_cb_wrap  cmd_blk;        /* MSC Bulk-only command block                   */
     struct bulk_cs_wrap  cmd_status;     /* MSC Bulk-only command status                  */
     uint8_t     scsi_buff[SCSI_BUFF_LEN];/* buffer for SCSI commands                      */
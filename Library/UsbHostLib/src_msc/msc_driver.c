@@ -17,6 +17,7 @@
 #include "msc.h"
 #include "ff.h"
 #include "diskio.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -67,8 +68,37 @@ static MSC_T * find_msc_by_drive(int drv_no)
     return NULL;
 }
 
+/*
+ *  Look up a drive for an API call and count the call in, so msc_disconnect()
+ *  does not free the instance under it. Every msc_get() needs a msc_put().
+ */
+static MSC_T * msc_get(int drv_no)
+{
+    uint32_t irq_state = __get_PRIMASK();
+    MSC_T    *msc;
+
+    __disable_irq();
+    msc = find_msc_by_drive(drv_no);
+    if(msc != NULL)
+        msc->root_msc->users++;
+    __set_PRIMASK(irq_state);
+    return msc;
+}
+
+static void msc_put(MSC_T *msc)
+{
+    uint32_t irq_state = __get_PRIMASK();
+
+    __disable_irq();
+    msc->root_msc->users--;
+    __set_PRIMASK(irq_state);
+}
+
 static void msc_list_add(MSC_T *msc)
 {
+    uint32_t irq_state = __get_PRIMASK();
+
+    __disable_irq();
     if(g_msc_list == NULL)
     {
         msc->next = NULL;
@@ -79,12 +109,15 @@ static void msc_list_add(MSC_T *msc)
         msc->next = g_msc_list;
         g_msc_list = msc;
     }
+    __set_PRIMASK(irq_state);
 }
 
 static void msc_list_remove(MSC_T *msc)
 {
+    uint32_t irq_state = __get_PRIMASK();
     MSC_T   *p;
 
+    __disable_irq();
     if(g_msc_list == msc)
     {
         g_msc_list = msc->next;
@@ -102,6 +135,7 @@ static void msc_list_remove(MSC_T *msc)
             p->next = msc->next;
         }
     }
+    __set_PRIMASK(irq_state);
 }
 
 static void get_max_lun(MSC_T *msc)
@@ -138,6 +172,8 @@ void msc_reset(MSC_T *msc)
 
     msc_debug_msg("Reset MSC device...\n");
 
+    USBH_MSC_LOCK(&msc->root_msc->lock);
+
     ret = usbh_ctrl_xfer(udev, REQ_TYPE_OUT | REQ_TYPE_CLASS_DEV | REQ_TYPE_TO_IFACE,
                          0xFF, 0, msc->iface->if_num, 0, NULL, &read_len, 100);
     if(ret < 0)
@@ -146,6 +182,8 @@ void msc_reset(MSC_T *msc)
     }
     usbh_clear_halt(udev, msc->ep_bulk_out->bEndpointAddress);
     usbh_clear_halt(udev, msc->ep_bulk_in->bEndpointAddress);
+
+    USBH_MSC_UNLOCK(&msc->root_msc->lock);
 }
 
 static int  msc_inquiry(MSC_T *msc)
@@ -256,10 +294,12 @@ int  usbh_umas_read(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
 
     //msc_debug_msg("usbh_umas_read - %d, %d\n", sec_no, sec_cnt);
 
-    msc = find_msc_by_drive(drv_no);
+    msc = msc_get(drv_no);
     if(msc == NULL)
         return UMAS_ERR_DRIVE_NOT_FOUND;
 
+    USBH_MSC_LOCK(&msc->root_msc->lock);
+
     cmd_blk = &msc->cmd_blk;
 
     //msc_debug_msg("read sector 0x%x\n", sector_no);
@@ -277,6 +317,10 @@ int  usbh_umas_read(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
     cmd_blk->CDB[8]  = sec_cnt & 0xFF;
 
     ret = run_scsi_command(msc, buff, sec_cnt * 512, 1, 500);
+
+    USBH_MSC_UNLOCK(&msc->root_msc->lock);
+    msc_put(msc);
+
     if(ret != 0)
     {
         msc_debug_msg("usbh_umas_read failed! [%d]\n", ret);
@@ -305,10 +349,12 @@ int  usbh_umas_write(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
 
     //msc_debug_msg("usbh_umas_write - %d, %d\n", sec_no, sec_cnt);
 
-    msc = find_msc_by_drive(drv_no);
+    msc = msc_get(drv_no);
     if(msc == NULL)
         return UMAS_ERR_DRIVE_NOT_FOUND;
 
+    USBH_MSC_LOCK(&msc->root_msc->lock);
+
     cmd_blk = &msc->cmd_blk;
     memset((uint8_t *) & (msc->cmd_blk), 0, sizeof(msc->cmd_blk));
 
@@ -324,6 +370,10 @@ int  usbh_umas_write(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
     cmd_blk->CDB[8]  = sec_cnt & 0xFF;
 
     ret = run_scsi_command(msc, buff, sec_cnt * 512, 0, 500);
+
+    USBH_MSC_UNLOCK(&msc->root_msc->lock);
+    msc_put(msc);
+
     if(ret < 0)
     {
         msc_debug_msg("usbh_umas_write failed!\n");
@@ -346,32 +396,42 @@ int  usbh_umas_write(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
 int  usbh_umas_ioctl(int drv_no, int cmd, void *buff)
 {
     MSC_T   *msc;
+    int     ret = RES_OK;
 
-    msc = find_msc_by_drive(drv_no);
+    msc = msc_get(drv_no);
     if(msc == NULL)
         return UMAS_ERR_DRIVE_NOT_FOUND;
 
+    USBH_MSC_LOCK(&msc->root_msc->lock);
+
     switch(cmd)
     {
         case CTRL_SYNC:
-            return RES_OK;
+            break;
 
         case GET_SECTOR_COUNT:
             *(uint32_t *)buff = msc->uTotalSectorN;
-            return RES_OK;
+            break;
 
         case GET_SECTOR_SIZE:
             *(uint32_t *)buff = msc->nSectorSize;
-            return RES_OK;
+            break;
 
         case GET_BLOCK_SIZE:
             *(uint32_t *)buff = msc->nSectorSize;
-            return RES_OK;
+            break;
 
             //case CTRL_ERASE_SECTOR:
-            //    return RES_OK;
+            //    break;
+
+        default:
+            ret = UMAS_ERR_IVALID_PARM;
+            break;
     }
-    return UMAS_ERR_IVALID_PARM;
+
+    USBH_MSC_UNLOCK(&msc->root_msc->lock);
+    msc_put(msc);
+    return ret;
 }
 
 /**
@@ -382,8 +442,12 @@ int  usbh_umas_ioctl(int drv_no, int cmd, void *buff)
  */
 int  usbh_umas_disk_status(int drv_no)
 {
-    if(find_msc_by_drive(drv_no) == NULL)
+    MSC_T   *msc;
+
+    msc = msc_get(drv_no);
+    if(msc == NULL)
         return STA_NODISK;
+    msc_put(msc);
     return 0;
 }
 
@@ -402,11 +466,15 @@ int  usbh_umas_reset_disk(int drv_no)
 
     usbh_pooling_hubs();
 
-    msc = find_msc_by_drive(drv_no);
+    msc = msc_get(drv_no);
     if(msc == NULL)
         return UMAS_ERR_DRIVE_NOT_FOUND;
 
+    /* wait for the command in progress; the reset disconnects this instance */
+    USBH_MSC_LOCK(&msc->root_msc->lock);
     udev = msc->iface->udev;
+    USBH_MSC_UNLOCK(&msc->root_msc->lock);
+    msc_put(msc);
 
     usbh_reset_device(udev);
 
@@ -509,6 +577,7 @@ disk_found:
             break;
         }
         memcpy(try_msc, msc, sizeof(*msc));
+        try_msc->root = 0;              /* shares lock and tag of the root instance */
     }
 
     if(bHasMedia)
@@ -525,7 +594,7 @@ static int msc_probe(IFACE_T *iface)
     ALT_IFACE_T   *aif = iface->aif;
     DESC_IF_T     *ifd;
     MSC_T         *msc;
-    int           i;
+    int           i, ret;
 
     ifd = aif->ifd;
 
@@ -569,18 +638,54 @@ static int msc_probe(IFACE_T *iface)
     }
 
     msc->iface = iface;
+    msc->root = 1;
+    msc->root_msc = msc;
+    msc->tag = 0x10e24388;
+    USBH_MSC_LOCK_INIT(&msc->lock);
 
     msc_debug_msg("USB Mass Storage device found. Iface:%d, Alt Iface:%d, bep_in:0x%x, bep_out:0x%x\n", ifd->bInterfaceNumber, ifd->bAlternateSetting, msc->ep_bulk_in->bEndpointAddress, msc->ep_bulk_out->bEndpointAddress);
 
     get_max_lun(msc);
 
-    return umass_init_device(msc);
+    /* LUN 0 is already in the list when the next LUNs are probed */
+    USBH_MSC_LOCK(&msc->lock);
+    ret = umass_init_device(msc);
+    USBH_MSC_UNLOCK(&msc->lock);
+    if(ret < 0)
+    {
+        /* No LUN has been added to MSC device list, root instance is still private. */
+        USBH_MSC_LOCK_DEINIT(&msc->lock);
+        usbh_free_mem(msc, sizeof(*msc));
+    }
+    return ret;
 }
 
 static void msc_disconnect(IFACE_T *iface)
 {
+    uint32_t irq_state = __get_PRIMASK();
     int    i;
-    MSC_T  *msc_p, *msc;
+    MSC_T  *msc_p, *msc, *gone = NULL, *root = NULL;
+
+    /*
+     *  Take the instances of this device off the MSC device list, so no new API call
+     *  finds them, and mark the device going, so no new transfer is queued to it.
+     */
+    __disable_irq();
+    msc = g_msc_list;
+    while(msc != NULL)
+    {
+        msc_p = msc->next;
+        if(msc->iface == iface)
+        {
+            msc_list_remove(msc);
+            msc->next = gone;
+            gone = msc;
+            root = msc->root_msc;
+            root->detached = 1;
+        }
+        msc = msc_p;
+    }
+    __set_PRIMASK(irq_state);
 
     /*
      *  Remove any hardware EP/QH from Host Controller hardware list.
@@ -592,20 +697,34 @@ static void msc_disconnect(IFACE_T *iface)
     }
 
     /*
-     *  unmount drive and remove it from MSC device list
+     *  The aborted transfers fail with USBH_ERR_DISCONNECTED. Wait for the API calls
+     *  still holding an instance to return before freeing it.
      */
-    msc = g_msc_list;
+    if(root != NULL)
+    {
+        while(root->users)
+            delay_us(1000);
+        USBH_MSC_LOCK(&root->lock);
+        USBH_MSC_UNLOCK(&root->lock);
+    }
+
+    /*
+     *  unmount drives and free the instances, the root one last
+     */
+    msc = gone;
     while(msc != NULL)
     {
         msc_p = msc->next;
-        if(msc->iface == iface)
-        {
-            fatfs_drive_free(msc->drv_no);
-            msc_list_remove(msc);
+        fatfs_drive_free(msc->drv_no);
+        if(msc != root)
             usbh_free_mem(msc, sizeof(*msc));
-        }
         msc = msc_p;
     }
+    if(root != NULL)
+    {
+        USBH_MSC_LOCK_DEINIT(&root->lock);
+        usbh_free_mem(root, sizeof(*root));
+    }
 }
 
 UDEV_DRV_T  msc_driver =
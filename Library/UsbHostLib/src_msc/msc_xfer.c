@@ -15,8 +15,7 @@
 #include "diskio.h"                // FATFS header
 #include "usb.h"
 #include "msc.h"
-
-static int __tag = 0x10e24388;
+#include "usbh_mem.h"
 
 static void bulk_xfer_done(UTR_T *utr)
 {
@@ -27,7 +26,10 @@ int msc_bulk_transfer(MSC_T *msc, EP_INFO_T *ep, uint8_t *data_buff, int data_le
 {
     UTR_T     *utr;
     uint32_t  t0;
-    int       ret;
+    int       ret, quit = 0;
+
+    if(msc->root_msc->detached)
+        return USBH_ERR_DISCONNECTED;
 
     utr = alloc_utr(msc->iface->udev);
     if(!utr)
@@ -42,7 +44,10 @@ int msc_bulk_transfer(MSC_T *msc, EP_INFO_T *ep, uint8_t *data_buff, int data_le
 
     ret = usbh_bulk_xfer(utr);
     if(ret < 0)
+    {
+        free_utr(utr);
         return ret;
+    }
 
     t0 = get_ticks();
     while(utr->bIsTransferDone == 0)
@@ -53,10 +58,21 @@ int msc_bulk_transfer(MSC_T *msc, EP_INFO_T *ep, uint8_t *data_buff, int data_le
             free_utr(utr);
             return USBH_ERR_TIMEOUT;
         }
+        /*
+         *  msc_disconnect() has removed the endpoints, the host controller is going to
+         *  abort this UTR. Quit it once more in case it was queued after that.
+         */
+        if(msc->root_msc->detached && !quit)
+        {
+            usbh_quit_utr(utr);
+            quit = 1;
+        }
     }
     ret = utr->status;
-    free_utr(utr);
+    if((ret < 0) && msc->root_msc->detached)
+        ret = USBH_ERR_DISCONNECTED;
     msc_debug_msg("    <BULK> status: %d, xfer_len: %d\n", utr->status, utr->xfer_len);
+    free_utr(utr);
 
     return ret;
 }
@@ -68,7 +84,7 @@ static int  do_scsi_command(MSC_T *msc, uint8_t *buff, uint32_t data_len, int bI
     struct bulk_cs_wrap  *cmd_status = &msc->cmd_status;   /* MSC Bulk-only command status  */
 
     cmd_blk->Signature = MSC_CB_SIGN;
-    cmd_blk->Tag = __tag++;
+    cmd_blk->Tag = msc->root_msc->tag++;
     cmd_blk->DataTransferLength = data_len;
     cmd_blk->Lun = msc->lun;
 
@@ -17,6 +17,7 @@
 #include "usbh_lib.h"
 #include "usbh_uac.h"
 #include "uac.h"
+#include "usbh_mem.h"
 
 /** @addtogroup LIBRARY Library
   @{
@@ -80,7 +81,7 @@ static int  uac_probe(IFACE_T *iface)
     DESC_IF_T    *ifd;
     UAC_DEV_T    *uac, *p;
     uint8_t      bAlternateSetting;
-    int          ret;
+    int          ret = 0;
 
     ifd = aif->ifd;
 
@@ -16,6 +16,7 @@
 #include "usbh_lib.h"
 #include "usbh_uac.h"
 #include "uac.h"
+#include "usbh_mem.h"
 
 /// @cond HIDDEN_SYMBOLS
 
@@ -98,6 +98,10 @@ information. */
 /* SD Card Test Task Priorities */
 #define mainLED_TOGGLE_TASK_PRIORITY            ( tskIDLE_PRIORITY + 2UL )
 #define mainSDCARD_TASK_PRIORITY                ( tskIDLE_PRIORITY + 3UL )
+#define mainLOG_TASK_PRIORITY                   ( tskIDLE_PRIORITY + 2UL )
+
+/* Period of the log task, which shares volume 0 with the SD Card task */
+#define mainLOG_PERIOD_MS                       ( 1000UL )
 
 /* Test buffer size */
 #define TEST_BUFFER_SIZE                        ( 512 )
@@ -117,6 +121,7 @@ static void prvSetupHardware( void );
 /* SD Card test tasks */
 static void vSDCardTestTask( void *pvParameters );
 static void vLEDToggleTask( void *pvParameters );
+static void vLogTask( void *pvParameters );
 
 /* SD Card interrupt handler */
 void SDH0_IRQHandler(void);
@@ -368,6 +373,7 @@ static void vSDCardTestTask( void *pvParameters )
     FATFS fs;           /* FatFs file system object */
     FIL file;           /* File object */
     FRESULT res;        /* FatFs function result */
+    BaseType_t xMounted = pdFALSE;
     UINT bytesWritten, bytesRead;
     char testData[TEST_BUFFER_SIZE];
     char readBuffer[TEST_BUFFER_SIZE];
@@ -404,19 +410,25 @@ static void vSDCardTestTask( void *pvParameters )
             continue;
         }
         
-        /* Mount the file system */
-        printf("[SD Card Task] Mounting file system...\n");
-        res = f_mount(&fs, "0:", 1);  /* Mount volume 0 */
-        
-        if( res != FR_OK )
+        /* Mount the file system once, the log task uses it as well. A card
+           that is swapped is mounted again by the next file function. */
+        if( xMounted == pdFALSE )
         {
-            printf("[SD Card Task] ERROR: Mount failed (res=%d)\n", res);
-            vTaskDelay( pdMS_TO_TICKS( 5000 ) );
-            continue;
+            printf("[SD Card Task] Mounting file system...\n");
+            res = f_mount(&fs, "0:", 1);  /* Mount volume 0 */
+
+            if( res != FR_OK )
+            {
+                printf("[SD Card Task] ERROR: Mount failed (res=%d)\n", res);
+                vTaskDelay( pdMS_TO_TICKS( 5000 ) );
+                continue;
+            }
+
+            printf("[SD Card Task] File system mounted successfully.\n");
+            xMounted = pdTRUE;
+            xTaskCreate( vLogTask, "Log", configMINIMAL_STACK_SIZE * 5, NULL, mainLOG_TASK_PRIORITY, NULL );
         }
         
-        printf("[SD Card Task] File system mounted successfully.\n");
-        
         /* Prepare test data */
         for( i = 0; i < TEST_BUFFER_SIZE; i++ )
         {
@@ -484,9 +496,6 @@ static void vSDCardTestTask( void *pvParameters )
             printf("[SD Card Task] ERROR: File open for read failed (res=%d)\n", res);
         }
         
-        /* Unmount file system */
-        f_mount(NULL, "0:", 0);
-        
         printf("[SD Card Task] Test cycle completed. Waiting 10 seconds...\n\n");
         
         /* Wait before next test cycle */
@@ -494,6 +503,46 @@ static void vSDCardTestTask( void *pvParameters )
     }
 }
 
+/*-----------------------------------------------------------*/
+/* Log Task Implementation                                  */
+/*-----------------------------------------------------------*/
+/*
+ * Appends a line to 0:log.txt every mainLOG_PERIOD_MS while the SD Card
+ * task works on 0:test.txt. ff.c and ffsystem.c are built with
+ * FF_FS_REENTRANT, so the volume mutex orders the calls of both tasks,
+ * and FF_FS_LOCK keeps a file from being opened twice for writing.
+ */
+static void vLogTask( void *pvParameters )
+{
+    FIL file;
+    FRESULT res;
+    UINT bytesWritten;
+    char line[48];
+    uint32_t loopCount = 0;
+    int len;
+
+    ( void ) pvParameters;
+
+    for( ;; )
+    {
+        vTaskDelay( pdMS_TO_TICKS( mainLOG_PERIOD_MS ) );
+
+        len = snprintf(line, sizeof(line), "tick %lu, loop %lu\r\n",
+                       (unsigned long)xTaskGetTickCount(), (unsigned long)loopCount++);
+
+        res = f_open(&file, "0:log.txt", FA_OPEN_APPEND | FA_WRITE);
+        if( res == FR_OK )
+        {
+            res = f_write(&file, line, (UINT)len, &bytesWritten);
+            if( f_close(&file) != FR_OK )
+                res = FR_DISK_ERR;
+        }
+
+        if( (res != FR_OK) || ((loopCount % 60) == 0) )
+            printf("[Log Task] loop=%lu, res=%d\n", (unsigned long)loopCount, res);
+    }
+}
+
 /*-----------------------------------------------------------*/
 /* SD Card Interrupt Handler                                */
 /*-----------------------------------------------------------*/
@@ -536,6 +585,9 @@ void SDH0_IRQHandler(void)
             memset(&SD0, 0, sizeof(SDH_INFO_T));
         }
 
+        /* Drop what diskio.c caches of the card */
+        disk_media_change(0);
+
         SDH0->INTSTS = SDH_INTSTS_CDIF_Msk;
     }
 
@@ -50,7 +50,8 @@
 
 #define LWIP_RAND                       xTaskGetTickCount
 #define LWIP_DNS                        1
-#define LWIP_POSIX_SOCKETS_IO_NAMES     1
+#define LWIP_SOCKET                     0   /* mbedTLS runs on netconn, see net_sockets.c */
+#define LWIP_SO_RCVTIMEO                1
 #define SO_REUSE                        1
 #if defined ( __GNUC__ ) && !(__CC_ARM) && !(__ICCARM__) && !defined(__ARMCC_VERSION)
 #define LWIP_TIMEVAL_PRIVATE            0
@@ -71,16 +72,12 @@
 #define PBUF_POOL_SIZE                  32
 
 /* ---------- Checksum options ---------- */
+#ifndef LWIP_USING_HW_CHECKSUM
 #define LWIP_USING_HW_CHECKSUM          0
+#endif
 #if (LWIP_USING_HW_CHECKSUM == 1)
-#define CHECKSUM_GEN_IP                 0
-#define CHECKSUM_GEN_UDP                0
-#define CHECKSUM_GEN_TCP                0
-#define CHECKSUM_GEN_ICMP               0
-#define CHECKSUM_CHECK_IP               0
-#define CHECKSUM_CHECK_UDP              0
-#define CHECKSUM_CHECK_TCP              0
-#define CHECKSUM_CHECK_ICMP             0
+/* GMAC checksum offload engine takes over per interface, see low_level_init() */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
 #endif
 
 #endif /* __LWIPOPTS_H__ */
@@ -1,5 +1,5 @@
 /*
- *  TCP/IP or UDP/IP networking functions
+ *  TCP/IP networking functions on the lwIP netconn API
  *
  *  Copyright (C) 2006-2015, ARM Limited, All Rights Reserved
  *  SPDX-License-Identifier: Apache-2.0
@@ -19,10 +19,19 @@
  *  This file is part of mbed TLS (https://tls.mbed.org)
  */
 
-/* Enable definition of getaddrinfo() even when compiling with -std=c99. Must
- * be set before config.h, which pulls in glibc's features.h indirectly.
- * Harmless on other platforms. */
-#define _POSIX_C_SOURCE 200112L
+/*
+ * The BSD socket layer is not used. Received records are copied straight
+ * from the pbuf chain of the netconn into the mbedTLS input buffer, and
+ * outgoing records go to netconn_write() without the socket mutex, select()
+ * and errno handling of lwip_read()/lwip_write().
+ *
+ * Outgoing data is still copied once into TCP segments (NETCONN_COPY):
+ * mbedTLS reuses its output buffer as soon as the send callback returns,
+ * so it cannot be handed to TCP by reference.
+ *
+ * mbedtls_net_context.fd is an index into a small table of netconns.
+ * Only MBEDTLS_NET_PROTO_TCP is supported.
+ */
 
 #if !defined(MBEDTLS_CONFIG_FILE)
 #include "mbedtls_config.h"
@@ -40,513 +49,388 @@
 #endif
 
 #include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
 
 #include <string.h>
-
-#if defined ( __GNUC__ ) && !(__CC_ARM) && !(__ICCARM__) && !defined(__ARMCC_VERSION)
-#include <sys/select.h> // for struct timeval
-#endif
-//#include <sys/types.h>
-//#include <sys/socket.h>
-//#include <netinet/in.h>
-//#include <arpa/inet.h>
-//#include <sys/time.h>
-//#include <unistd.h>
-//#include <signal.h>
-//#include <fcntl.h>
-//#include <netdb.h>
-//#include <errno.h>
+#include <stdlib.h>
 
 #include "lwip/opt.h"
 #include "lwip/arch.h"
 #include "lwip/api.h"
-//#include "lwip/tcpip.h"
-//#include "lwip/ip_addr.h"
-#include "lwip/netdb.h"
-#include "lwip/sockets.h"
-
-
-#define IS_EINTR( ret ) ( ( ret ) == EINTR )
+#include "lwip/ip.h"
+#include "lwip/tcp.h"
+#include "lwip/sys.h"
 
-#include <stdio.h>
 
-#include <time.h>
-
-#include <stdint.h>
-
-
-/*
- * Initialize a context
- */
-void mbedtls_net_init( mbedtls_net_context *ctx )
-{
-    ctx->fd = -1;
-}
+#ifndef MBEDTLS_NET_MAX_CONN
+#define MBEDTLS_NET_MAX_CONN    4       /* listening and connected contexts */
+#endif
 
-/*
- * Initiate a TCP connection with host:port and the given protocol
- */
-int mbedtls_net_connect( mbedtls_net_context *ctx, const char *host,
-                         const char *port, int proto )
+static struct net_conn
 {
-    int ret;
-    struct addrinfo hints, *addr_list, *cur;
+    struct netconn *conn;
+    struct netbuf *rxbuf;               /* received data not yet passed to mbedTLS */
+    u16_t rxoff;                        /* bytes of rxbuf already passed */
+    u8_t eof;                           /* the peer has closed its side */
+} s_asNetConn[MBEDTLS_NET_MAX_CONN];
 
-    /* Do name resolution with both IPv6 and IPv4 */
-    memset( &hints, 0, sizeof( hints ) );
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = proto == MBEDTLS_NET_PROTO_UDP ? SOCK_DGRAM : SOCK_STREAM;
-    hints.ai_protocol = proto == MBEDTLS_NET_PROTO_UDP ? IPPROTO_UDP : IPPROTO_TCP;
 
-    if( getaddrinfo( host, port, &hints, &addr_list ) != 0 )
-        return( MBEDTLS_ERR_NET_UNKNOWN_HOST );
+static int net_alloc(struct netconn *conn)
+{
+    int i;
+    SYS_ARCH_DECL_PROTECT(lev);
 
-    /* Try the sockaddrs until a connection succeeds */
-    ret = MBEDTLS_ERR_NET_UNKNOWN_HOST;
-    for( cur = addr_list; cur != NULL; cur = cur->ai_next )
+    SYS_ARCH_PROTECT(lev);
+    for(i = 0; i < MBEDTLS_NET_MAX_CONN; i++)
     {
-        ctx->fd = (int) socket( cur->ai_family, cur->ai_socktype,
-                            cur->ai_protocol );
-        if( ctx->fd < 0 )
-        {
-            ret = MBEDTLS_ERR_NET_SOCKET_FAILED;
-            continue;
-        }
-
-        if( connect( ctx->fd, cur->ai_addr, (socklen_t)cur->ai_addrlen ) == 0 )
+        if(s_asNetConn[i].conn == NULL)
         {
-            ret = 0;
+            s_asNetConn[i].conn = conn;
+            s_asNetConn[i].rxbuf = NULL;
+            s_asNetConn[i].rxoff = 0;
+            s_asNetConn[i].eof = 0;
             break;
         }
-
-        close( ctx->fd );
-        ret = MBEDTLS_ERR_NET_CONNECT_FAILED;
     }
+    SYS_ARCH_UNPROTECT(lev);
 
-    freeaddrinfo( addr_list );
-
-    return( ret );
+    return (i < MBEDTLS_NET_MAX_CONN) ? i : -1;
 }
 
-/*
- * Create a listening socket on bind_ip:port
- */
-int mbedtls_net_bind( mbedtls_net_context *ctx, const char *bind_ip, const char *port, int proto )
+static struct net_conn *net_get(const void *ctx)
 {
-    int n, ret;
-    struct addrinfo hints, *addr_list, *cur;
-
-    /* Bind to IPv6 and/or IPv4, but only in the desired protocol */
-    memset( &hints, 0, sizeof( hints ) );
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = proto == MBEDTLS_NET_PROTO_UDP ? SOCK_DGRAM : SOCK_STREAM;
-    hints.ai_protocol = proto == MBEDTLS_NET_PROTO_UDP ? IPPROTO_UDP : IPPROTO_TCP;
-    if( bind_ip == NULL )
-        hints.ai_flags = AI_PASSIVE;
-
-    if( getaddrinfo( bind_ip, port, &hints, &addr_list ) != 0 )
-        return( MBEDTLS_ERR_NET_UNKNOWN_HOST );
-
-    /* Try the sockaddrs until a binding succeeds */
-    ret = MBEDTLS_ERR_NET_UNKNOWN_HOST;
-    for( cur = addr_list; cur != NULL; cur = cur->ai_next )
-    {
-        ctx->fd = (int) socket( cur->ai_family, cur->ai_socktype,
-                            cur->ai_protocol );
-        if( ctx->fd < 0 )
-        {
-            ret = MBEDTLS_ERR_NET_SOCKET_FAILED;
-            continue;
-        }
+    int fd = ((const mbedtls_net_context *) ctx)->fd;
 
-        n = 1;
-        if( setsockopt( ctx->fd, SOL_SOCKET, SO_REUSEADDR,
-                        (const char *) &n, sizeof( n ) ) != 0 )
-        {
-            close( ctx->fd );
-            ret = MBEDTLS_ERR_NET_SOCKET_FAILED;
-            continue;
-        }
+    if(fd < 0 || fd >= MBEDTLS_NET_MAX_CONN || s_asNetConn[fd].conn == NULL)
+        return NULL;
 
-        if( bind( ctx->fd, cur->ai_addr, (socklen_t)cur->ai_addrlen ) != 0 )
-        {
-            close( ctx->fd );
-            ret = MBEDTLS_ERR_NET_BIND_FAILED;
-            continue;
-        }
+    return &s_asNetConn[fd];
+}
 
-        /* Listen only makes sense for TCP */
-        if( proto == MBEDTLS_NET_PROTO_TCP )
-        {
-            if( listen( ctx->fd, MBEDTLS_NET_LISTEN_BACKLOG ) != 0 )
-            {
-                close( ctx->fd );
-                ret = MBEDTLS_ERR_NET_LISTEN_FAILED;
-                continue;
-            }
-        }
-        /* Bind was successful */
-        ret = 0;
-        break;
-    }
+static int net_port(const char *port)
+{
+    int n = atoi(port);
 
-    freeaddrinfo( addr_list );
+    return (n > 0 && n <= 0xFFFF) ? n : -1;
+}
 
-    return( ret );
 
+/*
+ * Initialize a context
+ */
+void mbedtls_net_init(mbedtls_net_context *ctx)
+{
+    ctx->fd = -1;
 }
 
 /*
- * Check if the requested operation would be blocking on a non-blocking socket
- * and thus 'failed' with a negative return value.
- *
- * Note: on a blocking socket this function always returns 0!
+ * Initiate a TCP connection with host:port and the given protocol
  */
-static int net_would_block( const mbedtls_net_context *ctx )
+int mbedtls_net_connect(mbedtls_net_context *ctx, const char *host,
+                        const char *port, int proto)
 {
-    int err = errno;
+    struct netconn *conn;
+    ip_addr_t addr;
+    int n = net_port(port);
+
+    if(proto != MBEDTLS_NET_PROTO_TCP || n < 0)
+        return(MBEDTLS_ERR_NET_BAD_INPUT_DATA);
+
+    if(netconn_gethostbyname(host, &addr) != ERR_OK)
+        return(MBEDTLS_ERR_NET_UNKNOWN_HOST);
 
-    /*
-     * Never return 'WOULD BLOCK' on a non-blocking socket
-     */
-    if( ( fcntl( ctx->fd, F_GETFL , 0) & O_NONBLOCK ) != O_NONBLOCK )
+    if((conn = netconn_new(NETCONN_TCP)) == NULL)
+        return(MBEDTLS_ERR_NET_SOCKET_FAILED);
+
+    if(netconn_connect(conn, &addr, (u16_t)n) != ERR_OK)
     {
-        errno = err;
-        return( 0 );
+        netconn_delete(conn);
+        return(MBEDTLS_ERR_NET_CONNECT_FAILED);
     }
 
-    switch( errno = err )
+    if((ctx->fd = net_alloc(conn)) < 0)
     {
-#if defined EAGAIN
-        case EAGAIN:
-#endif
-#if defined EWOULDBLOCK && EWOULDBLOCK != EAGAIN
-        case EWOULDBLOCK:
-#endif
-            return( 1 );
+        netconn_close(conn);
+        netconn_delete(conn);
+        return(MBEDTLS_ERR_NET_SOCKET_FAILED);
     }
-    return( 0 );
-}
 
+    return(0);
+}
 
 /*
- * Accept a connection from a remote client
+ * Create a listening socket on bind_ip:port
  */
-int mbedtls_net_accept( mbedtls_net_context *bind_ctx,
-                        mbedtls_net_context *client_ctx,
-                        void *client_ip, size_t buf_size, size_t *ip_len )
+int mbedtls_net_bind(mbedtls_net_context *ctx, const char *bind_ip, const char *port, int proto)
 {
-    int ret;
-    int type;
+    struct netconn *conn;
+    ip_addr_t addr;
+    int n = net_port(port);
 
-    struct sockaddr_storage client_addr;
+    if(proto != MBEDTLS_NET_PROTO_TCP || n < 0)
+        return(MBEDTLS_ERR_NET_BAD_INPUT_DATA);
 
-#if defined(__socklen_t_defined) || defined(_SOCKLEN_T) ||  \
-    defined(_SOCKLEN_T_DECLARED) || defined(__DEFINED_socklen_t)
-    socklen_t n = (socklen_t) sizeof( client_addr );
-    socklen_t type_len = (socklen_t) sizeof( type );
-#else
-    int n = (int) sizeof( client_addr );
-    int type_len = (int) sizeof( type );
+    if(bind_ip == NULL)
+        ip_addr_set_any(0, &addr);
+    else if(!ipaddr_aton(bind_ip, &addr))
+        return(MBEDTLS_ERR_NET_UNKNOWN_HOST);
+
+    if((conn = netconn_new(NETCONN_TCP)) == NULL)
+        return(MBEDTLS_ERR_NET_SOCKET_FAILED);
+
+#if SO_REUSE
+    ip_set_option(conn->pcb.tcp, SOF_REUSEADDR);
 #endif
 
-    /* Is this a TCP or UDP socket? */
-    if( getsockopt( bind_ctx->fd, SOL_SOCKET, SO_TYPE,
-                    (void *) &type, (socklen_t *)&type_len ) != 0 ||
-        ( type != SOCK_STREAM && type != SOCK_DGRAM ) )
+    if(netconn_bind(conn, &addr, (u16_t)n) != ERR_OK)
     {
-        return( MBEDTLS_ERR_NET_ACCEPT_FAILED );
+        netconn_delete(conn);
+        return(MBEDTLS_ERR_NET_BIND_FAILED);
     }
 
-    if( type == SOCK_STREAM )
+    if(netconn_listen_with_backlog(conn, MBEDTLS_NET_LISTEN_BACKLOG) != ERR_OK)
     {
-        /* TCP: actual accept() */
-        ret = client_ctx->fd = (int) accept( bind_ctx->fd,
-                                             (struct sockaddr *) &client_addr, (socklen_t *)&n );
+        netconn_delete(conn);
+        return(MBEDTLS_ERR_NET_LISTEN_FAILED);
     }
-    else
-    {
-        /* UDP: wait for a message, but keep it in the queue */
-        char buf[1] = { 0 };
 
-        ret = (int) recvfrom( bind_ctx->fd, buf, sizeof( buf ), MSG_PEEK,
-                        (struct sockaddr *) &client_addr, (socklen_t *)&n );
+    if((ctx->fd = net_alloc(conn)) < 0)
+    {
+        netconn_delete(conn);
+        return(MBEDTLS_ERR_NET_SOCKET_FAILED);
     }
 
-    if( ret < 0 )
-    {
-        if( net_would_block( bind_ctx ) != 0 )
-            return( MBEDTLS_ERR_SSL_WANT_READ );
+    return(0);
+}
 
-        return( MBEDTLS_ERR_NET_ACCEPT_FAILED );
-    }
+/*
+ * Accept a connection from a remote client
+ */
+int mbedtls_net_accept(mbedtls_net_context *bind_ctx,
+                       mbedtls_net_context *client_ctx,
+                       void *client_ip, size_t buf_size, size_t *ip_len)
+{
+    struct net_conn *listen = net_get(bind_ctx);
+    struct netconn *conn;
+    ip_addr_t addr;
+    u16_t port;
 
-    /* UDP: hijack the listening socket to communicate with the client,
-     * then bind a new socket to accept new connections */
-    if( type != SOCK_STREAM )
-    {
-        struct sockaddr_storage local_addr;
-        int one = 1;
-
-        if( connect( bind_ctx->fd, (struct sockaddr *) &client_addr, n ) != 0 )
-            return( MBEDTLS_ERR_NET_ACCEPT_FAILED );
-
-        client_ctx->fd = bind_ctx->fd;
-        bind_ctx->fd   = -1; /* In case we exit early */
-
-        n = sizeof( struct sockaddr_storage );
-        if( getsockname( client_ctx->fd,
-                         (struct sockaddr *) &local_addr, (socklen_t *)&n ) != 0 ||
-            ( bind_ctx->fd = (int) socket( local_addr.ss_family,
-                                           SOCK_DGRAM, IPPROTO_UDP ) ) < 0 ||
-            setsockopt( bind_ctx->fd, SOL_SOCKET, SO_REUSEADDR,
-                        (const char *) &one, sizeof( one ) ) != 0 )
-        {
-            return( MBEDTLS_ERR_NET_SOCKET_FAILED );
-        }
+    if(listen == NULL)
+        return(MBEDTLS_ERR_NET_INVALID_CONTEXT);
 
-        if( bind( bind_ctx->fd, (struct sockaddr *) &local_addr, n ) != 0 )
-        {
-            return( MBEDTLS_ERR_NET_BIND_FAILED );
-        }
+    if(netconn_accept(listen->conn, &conn) != ERR_OK)
+        return(MBEDTLS_ERR_NET_ACCEPT_FAILED);
+
+    if((client_ctx->fd = net_alloc(conn)) < 0)
+    {
+        netconn_close(conn);
+        netconn_delete(conn);
+        return(MBEDTLS_ERR_NET_ACCEPT_FAILED);
     }
 
-    if( client_ip != NULL )
+    if(client_ip != NULL && netconn_peer(conn, &addr, &port) == ERR_OK)
     {
-        if( client_addr.ss_family == AF_INET )
+        if(IP_IS_V4(&addr))
         {
-            struct sockaddr_in *addr4 = (struct sockaddr_in *) &client_addr;
-            *ip_len = sizeof( addr4->sin_addr.s_addr );
+            *ip_len = sizeof(ip4_addr_t);
 
-            if( buf_size < *ip_len )
-                return( MBEDTLS_ERR_NET_BUFFER_TOO_SMALL );
+            if(buf_size < *ip_len)
+                return(MBEDTLS_ERR_NET_BUFFER_TOO_SMALL);
 
-            memcpy( client_ip, &addr4->sin_addr.s_addr, *ip_len );
+            memcpy(client_ip, ip_2_ip4(&addr), *ip_len);
         }
+#if LWIP_IPV6
         else
         {
-#if LWIP_IPV6
-            struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *) &client_addr;
-            *ip_len = sizeof( addr6->sin6_addr.s6_addr );
+            *ip_len = sizeof(ip6_addr_t);
 
-            if( buf_size < *ip_len )
-                return( MBEDTLS_ERR_NET_BUFFER_TOO_SMALL );
+            if(buf_size < *ip_len)
+                return(MBEDTLS_ERR_NET_BUFFER_TOO_SMALL);
 
-            memcpy( client_ip, &addr6->sin6_addr.s6_addr, *ip_len);
-#endif
+            memcpy(client_ip, ip_2_ip6(&addr)->addr, *ip_len);
         }
+#endif
     }
 
-    return( 0 );
+    return(0);
 }
 
 /*
  * Set the socket blocking or non-blocking
  */
-int mbedtls_net_set_block( mbedtls_net_context *ctx )
+int mbedtls_net_set_block(mbedtls_net_context *ctx)
 {
     return 0;
 }
 
-int mbedtls_net_set_nonblock( mbedtls_net_context *ctx )
+int mbedtls_net_set_nonblock(mbedtls_net_context *ctx)
 {
     return 0;
 }
 
 /*
- * Check if data is available on the socket
+ * Wait for the next netbuf if none is pending. timeout is in ms, 0 waits forever.
+ * The end of the stream is reported on every call after it: netconn_recv()
+ * only returns ERR_CLSD once.
  */
-
-int mbedtls_net_poll( mbedtls_net_context *ctx, uint32_t rw, uint32_t timeout )
+static int net_fill(struct net_conn *nc, uint32_t timeout)
 {
-    int ret;
-    struct timeval tv;
-
-    fd_set read_fds;
-    fd_set write_fds;
+    err_t err;
 
-    int fd = ctx->fd;
+    if(nc->rxbuf != NULL)
+        return(0);
 
-    if( fd < 0 )
-        return( MBEDTLS_ERR_NET_INVALID_CONTEXT );
+    if(nc->eof)
+        return(MBEDTLS_ERR_SSL_CONN_EOF);
 
-#if defined(__has_feature)
-#if __has_feature(memory_sanitizer)
-    /* Ensure that memory sanitizers consider read_fds and write_fds as
-     * initialized even on platforms such as Glibc/x86_64 where FD_ZERO
-     * is implemented in assembly. */
-    memset( &read_fds, 0, sizeof( read_fds ) );
-    memset( &write_fds, 0, sizeof( write_fds ) );
-#endif
+#if LWIP_SO_RCVTIMEO
+    netconn_set_recvtimeout(nc->conn, (u32_t)timeout);
 #endif
+    err = netconn_recv(nc->conn, &nc->rxbuf);
+    nc->rxoff = 0;
 
-    FD_ZERO( &read_fds );
-    if( rw & MBEDTLS_NET_POLL_READ )
+    switch(err)
     {
-        rw &= ~MBEDTLS_NET_POLL_READ;
-        FD_SET( fd, &read_fds );
+        case ERR_OK:
+            return(0);
+        case ERR_TIMEOUT:
+        case ERR_WOULDBLOCK:
+            return(MBEDTLS_ERR_SSL_TIMEOUT);
+        case ERR_CLSD:
+            nc->eof = 1;
+            return(MBEDTLS_ERR_SSL_CONN_EOF);
+        case ERR_RST:
+        case ERR_ABRT:
+            return(MBEDTLS_ERR_NET_CONN_RESET);
+        default:
+            return(MBEDTLS_ERR_NET_RECV_FAILED);
     }
+}
 
-    FD_ZERO( &write_fds );
-    if( rw & MBEDTLS_NET_POLL_WRITE )
-    {
-        rw &= ~MBEDTLS_NET_POLL_WRITE;
-        FD_SET( fd, &write_fds );
-    }
+/*
+ * Check if data is available on the socket
+ */
+int mbedtls_net_poll(mbedtls_net_context *ctx, uint32_t rw, uint32_t timeout)
+{
+    struct net_conn *nc = net_get(ctx);
+    int ret = 0;
 
-    if( rw != 0 )
-        return( MBEDTLS_ERR_NET_BAD_INPUT_DATA );
+    if(nc == NULL)
+        return(MBEDTLS_ERR_NET_INVALID_CONTEXT);
 
-    tv.tv_sec  = timeout / 1000;
-    tv.tv_usec = ( timeout % 1000 ) * 1000;
+    if(rw & ~(MBEDTLS_NET_POLL_READ | MBEDTLS_NET_POLL_WRITE))
+        return(MBEDTLS_ERR_NET_BAD_INPUT_DATA);
+
+    /* netconn_write() blocks until the data is queued, so writing is always possible */
+    if(rw & MBEDTLS_NET_POLL_WRITE)
+        ret |= MBEDTLS_NET_POLL_WRITE;
 
-    do
+    if(rw & MBEDTLS_NET_POLL_READ)
     {
-        ret = select( fd + 1, &read_fds, &write_fds, NULL,
-                      timeout == (uint32_t) -1 ? NULL : &tv );
+        /* Don't wait if writing is possible anyway; timeout 0 polls, -1 waits forever */
+        uint32_t wait = (ret != 0) ? 1 : (timeout == (uint32_t) - 1) ? 0 : (timeout == 0) ? 1 : timeout;
+        int err = net_fill(nc, wait);
+
+        if(err == 0 || err == MBEDTLS_ERR_SSL_CONN_EOF)
+            ret |= MBEDTLS_NET_POLL_READ;
+        else if(err != MBEDTLS_ERR_SSL_TIMEOUT)
+            return(MBEDTLS_ERR_NET_POLL_FAILED);
     }
-    while( IS_EINTR( ret ) );
 
-    if( ret < 0 )
-        return( MBEDTLS_ERR_NET_POLL_FAILED );
-
-    ret = 0;
-    if( FD_ISSET( fd, &read_fds ) )
-        ret |= MBEDTLS_NET_POLL_READ;
-    if( FD_ISSET( fd, &write_fds ) )
-        ret |= MBEDTLS_NET_POLL_WRITE;
-
-    return( ret );
+    return(ret);
 }
 
 /*
  * Portable usleep helper
  */
-void mbedtls_net_usleep( unsigned long usec )
+void mbedtls_net_usleep(unsigned long usec)
 {
-
-    struct timeval tv;
-    tv.tv_sec  = usec / 1000000;
-#if defined(__unix__) || defined(__unix) || \
-    ( defined(__APPLE__) && defined(__MACH__) )
-    tv.tv_usec = (suseconds_t) usec % 1000000;
-#else
-    tv.tv_usec = usec % 1000000;
-#endif
-    select( 0, NULL, NULL, NULL, &tv );
-
+    sys_msleep((u32_t)((usec + 999) / 1000));
 }
 
 /*
- * Read at most 'len' characters
+ * Read at most 'len' characters, blocking for at most 'timeout' ms
  */
-int mbedtls_net_recv( void *ctx, unsigned char *buf, size_t len )
+int mbedtls_net_recv_timeout(void *ctx, unsigned char *buf,
+                             size_t len, uint32_t timeout)
 {
+    struct net_conn *nc = net_get(ctx);
+    u16_t n;
     int ret;
-    int fd = ((mbedtls_net_context *) ctx)->fd;
 
-    if( fd < 0 )
-        return( MBEDTLS_ERR_NET_INVALID_CONTEXT );
+    if(nc == NULL)
+        return(MBEDTLS_ERR_NET_INVALID_CONTEXT);
 
-    ret = (int) read( fd, buf, len );
+    if((ret = net_fill(nc, timeout)) != 0)
+        return (ret == MBEDTLS_ERR_SSL_CONN_EOF) ? 0 : ret;
 
-    if( ret < 0 )
-    {
-        if( net_would_block( ctx ) != 0 )
-            return( MBEDTLS_ERR_SSL_WANT_READ );
-
-
-        if( errno == EPIPE || errno == ECONNRESET )
-            return( MBEDTLS_ERR_NET_CONN_RESET );
-
-        if( errno == EINTR )
-            return( MBEDTLS_ERR_SSL_WANT_READ );
+    /* Straight from the pbuf chain into the mbedTLS buffer */
+    n = (u16_t)LWIP_MIN(len, (size_t)(netbuf_len(nc->rxbuf) - nc->rxoff));
+    n = netbuf_copy_partial(nc->rxbuf, buf, n, nc->rxoff);
+    nc->rxoff += n;
 
-        return( MBEDTLS_ERR_NET_RECV_FAILED );
+    if(nc->rxoff >= netbuf_len(nc->rxbuf))
+    {
+        netbuf_delete(nc->rxbuf);
+        nc->rxbuf = NULL;
     }
 
-    return( ret );
+    return((int)n);
 }
 
 /*
- * Read at most 'len' characters, blocking for at most 'timeout' ms
+ * Read at most 'len' characters
  */
-int mbedtls_net_recv_timeout( void *ctx, unsigned char *buf,
-                              size_t len, uint32_t timeout )
+int mbedtls_net_recv(void *ctx, unsigned char *buf, size_t len)
 {
-    int ret;
-    struct timeval tv;
-    fd_set read_fds;
-    int fd = ((mbedtls_net_context *) ctx)->fd;
+    int ret = mbedtls_net_recv_timeout(ctx, buf, len, 0);
 
-    if( fd < 0 )
-        return( MBEDTLS_ERR_NET_INVALID_CONTEXT );
-
-    FD_ZERO( &read_fds );
-    FD_SET( fd, &read_fds );
-
-    tv.tv_sec  = timeout / 1000;
-    tv.tv_usec = ( timeout % 1000 ) * 1000;
-
-    ret = select( fd + 1, &read_fds, NULL, NULL, timeout == 0 ? NULL : &tv );
-
-    /* Zero fds ready means we timed out */
-    if( ret == 0 )
-        return( MBEDTLS_ERR_SSL_TIMEOUT );
-
-    if( ret < 0 )
-    {
-
-        if( errno == EINTR )
-            return( MBEDTLS_ERR_SSL_WANT_READ );
-
-        return( MBEDTLS_ERR_NET_RECV_FAILED );
-    }
-
-    /* This call will not block */
-    return( mbedtls_net_recv( ctx, buf, len ) );
+    return (ret == MBEDTLS_ERR_SSL_TIMEOUT) ? MBEDTLS_ERR_SSL_WANT_READ : ret;
 }
 
 /*
  * Write at most 'len' characters
  */
-int mbedtls_net_send( void *ctx, const unsigned char *buf, size_t len )
+int mbedtls_net_send(void *ctx, const unsigned char *buf, size_t len)
 {
-    int ret;
-    int fd = ((mbedtls_net_context *) ctx)->fd;
-
-    if( fd < 0 )
-        return( MBEDTLS_ERR_NET_INVALID_CONTEXT );
+    struct net_conn *nc = net_get(ctx);
+    size_t written = 0;
+    err_t err;
 
-    ret = (int) write( fd, buf, len );
+    if(nc == NULL)
+        return(MBEDTLS_ERR_NET_INVALID_CONTEXT);
 
-    if( ret < 0 )
-    {
-        if( net_would_block( ctx ) != 0 )
-            return( MBEDTLS_ERR_SSL_WANT_WRITE );
+    err = netconn_write_partly(nc->conn, buf, len, NETCONN_COPY, &written);
 
-        if( errno == EPIPE || errno == ECONNRESET )
-            return( MBEDTLS_ERR_NET_CONN_RESET );
+    if(err == ERR_OK)
+        return((int)written);
 
-        if( errno == EINTR )
-            return( MBEDTLS_ERR_SSL_WANT_WRITE );
+    if(err == ERR_WOULDBLOCK)
+        return(MBEDTLS_ERR_SSL_WANT_WRITE);
 
-        return( MBEDTLS_ERR_NET_SEND_FAILED );
-    }
+    if(err == ERR_RST || err == ERR_ABRT || err == ERR_CLSD)
+        return(MBEDTLS_ERR_NET_CONN_RESET);
 
-    return( ret );
+    return(MBEDTLS_ERR_NET_SEND_FAILED);
 }
 
 /*
  * Gracefully close the connection
  */
-void mbedtls_net_free( mbedtls_net_context *ctx )
+void mbedtls_net_free(mbedtls_net_context *ctx)
 {
-    if( ctx->fd == -1 )
+    struct net_conn *nc = net_get(ctx);
+
+    if(nc == NULL)
         return;
 
-    shutdown( ctx->fd, 2 );
-    close( ctx->fd );
+    if(nc->rxbuf != NULL)
+        netbuf_delete(nc->rxbuf);
+    nc->rxbuf = NULL;
+
+    netconn_close(nc->conn);
+    netconn_delete(nc->conn);
+    nc->conn = NULL;
 
     ctx->fd = -1;
 }
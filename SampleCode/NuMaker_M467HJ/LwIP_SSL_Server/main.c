@@ -187,6 +187,9 @@ static void prvSetupHardware(void)
                     CLK_AHBCLK0_GPECKEN_Msk | CLK_AHBCLK0_GPFCKEN_Msk | CLK_AHBCLK0_GPGCKEN_Msk | CLK_AHBCLK0_GPHCKEN_Msk;
     CLK->AHBCLK1 |= CLK_AHBCLK1_GPICKEN_Msk | CLK_AHBCLK1_GPJCKEN_Msk;
 
+    /* Enable CRPT module clock for the mbedTLS AES accelerator */
+    CLK_EnableModuleClock(CRPT_MODULE);
+
     /* Init UART for printf */
     UART_Init();
 }
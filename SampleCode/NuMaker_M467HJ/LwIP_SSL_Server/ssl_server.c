@@ -20,6 +20,7 @@
 #include "lwip/opt.h"
 #include "lwip/arch.h"
 #include "lwip/api.h"
+#include "lwip/sys.h"
 
 #if !defined(MBEDTLS_CONFIG_FILE)
 #include "mbedtls/config.h"
@@ -62,6 +63,10 @@
 #include "mbedtls/ssl_cache.h"
 #endif
 
+#if defined(MBEDTLS_SSL_TICKET_C)
+#include "mbedtls/ssl_ticket.h"
+#endif
+
 #include <string.h>
 
 #define SERVER_PORT "443"
@@ -77,6 +82,24 @@
 #define SSLSERVER_THREAD_PRIO    ( tskIDLE_PRIORITY + 2UL )
 #define SSLSERVER_THREAD_STACKSIZE  2000
 
+/* Session resumption.
+ * MBEDTLS_HAVE_TIME is not available on this board, so cache entries are
+ * evicted in FIFO order (MBEDTLS_SSL_CACHE_DEFAULT_MAX_ENTRIES in
+ * mbedtls_config.h) and the ticket key is renewed every
+ * SSL_TICKET_ROTATE_CNT issued tickets instead of by its lifetime. The
+ * previous key still opens tickets until the next renewal, so a ticket
+ * stays valid for at least SSL_TICKET_ROTATE_CNT more tickets. */
+#define SSL_TICKET_CIPHER       MBEDTLS_CIPHER_AES_256_GCM
+#define SSL_TICKET_LIFETIME     86400
+#define SSL_TICKET_ROTATE_CNT   64
+
+/* Print the handshake statistics every SSL_STATS_INTERVAL connections.
+ * Drive the server from a host with mbedTLS programs/ssl/ssl_client2, e.g.
+ *   ssl_client2 server_addr=192.168.1.2 server_port=443 auth_mode=none
+ *               reconnect=100 reco_delay=0 tickets=1
+ * (tickets=0 exercises the session cache, reconnect=0 full handshakes). */
+#define SSL_STATS_INTERVAL      10
+
 #if defined(MBEDTLS_CHECK_PARAMS)
 #include "mbedtls/platform_util.h"
 void mbedtls_param_failed(const char *failure_condition,
@@ -109,10 +132,106 @@ mbedtls_pk_context pkey;
 #if defined(MBEDTLS_SSL_CACHE_C)
 mbedtls_ssl_cache_context cache;
 #endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+/* Current and previous ticket key */
+mbedtls_ssl_ticket_context ticket_ctx[2];
+#endif
+
+/* Handshake statistics */
+static uint8_t  s_u8Resumed;
+static uint32_t s_u32FullCnt, s_u32FullMs;
+static uint32_t s_u32ResumeCnt, s_u32ResumeMs;
+#if defined(MBEDTLS_SSL_TICKET_C)
+static uint8_t  s_u8TicketCur;
+static uint32_t s_u32TicketCnt;
+#endif
+
+#if defined(MBEDTLS_SSL_CACHE_C)
+static int ssl_cache_get(void *data, unsigned char const *session_id,
+                         size_t session_id_len, mbedtls_ssl_session *session)
+{
+    int ret = mbedtls_ssl_cache_get(data, session_id, session_id_len, session);
+
+    if(ret == 0)
+        s_u8Resumed = 1;
+
+    return ret;
+}
+#endif
+
+#if defined(MBEDTLS_SSL_TICKET_C)
+static int ssl_ticket_write(void *p_ticket, const mbedtls_ssl_session *session,
+                            unsigned char *start, const unsigned char *end,
+                            size_t *tlen, uint32_t *lifetime)
+{
+    mbedtls_ssl_ticket_context *ctx = p_ticket;
+    int ret = mbedtls_ssl_ticket_write(&ctx[s_u8TicketCur], session, start, end, tlen, lifetime);
+
+    if(ret == 0)
+        s_u32TicketCnt++;
+
+    return ret;
+}
+
+static int ssl_ticket_parse(void *p_ticket, mbedtls_ssl_session *session,
+                            unsigned char *buf, size_t len)
+{
+    mbedtls_ssl_ticket_context *ctx = p_ticket;
+    int ret = mbedtls_ssl_ticket_parse(&ctx[s_u8TicketCur], session, buf, len);
+
+    /* An unknown key name leaves the ticket as it was: try the previous key */
+    if(ret == MBEDTLS_ERR_SSL_SESSION_TICKET_EXPIRED)
+        ret = mbedtls_ssl_ticket_parse(&ctx[s_u8TicketCur ^ 1], session, buf, len);
+
+    if(ret == 0)
+        s_u8Resumed = 1;
+
+    return ret;
+}
+
+static int ssl_ticket_rotate(void)
+{
+    /* The tickets of the previous key become undecryptable and their
+     * clients fall back to a full handshake */
+    s_u8TicketCur ^= 1;
+    mbedtls_ssl_ticket_free(&ticket_ctx[s_u8TicketCur]);
+    mbedtls_ssl_ticket_init(&ticket_ctx[s_u8TicketCur]);
+
+    return mbedtls_ssl_ticket_setup(&ticket_ctx[s_u8TicketCur], mbedtls_ctr_drbg_random, &ctr_drbg,
+                                    SSL_TICKET_CIPHER, SSL_TICKET_LIFETIME);
+}
+#endif
+
+static void ssl_stats_update(uint32_t u32Ms)
+{
+    uint32_t u32Total;
+
+    if(s_u8Resumed)
+    {
+        s_u32ResumeCnt++;
+        s_u32ResumeMs += u32Ms;
+    }
+    else
+    {
+        s_u32FullCnt++;
+        s_u32FullMs += u32Ms;
+    }
+
+    u32Total = s_u32FullCnt + s_u32ResumeCnt;
+    if((u32Total % SSL_STATS_INTERVAL) != 0)
+        return;
+
+    mbedtls_printf("  . Handshakes: full %u (avg %u ms), resumed %u (avg %u ms)\n",
+                   (unsigned int)s_u32FullCnt,
+                   (unsigned int)(s_u32FullCnt ? s_u32FullMs / s_u32FullCnt : 0),
+                   (unsigned int)s_u32ResumeCnt,
+                   (unsigned int)(s_u32ResumeCnt ? s_u32ResumeMs / s_u32ResumeCnt : 0));
+}
 
 static void ssl_main(void *arg)
 {
     int ret, len;
+    uint32_t u32Start;
     mbedtls_net_context listen_fd, client_fd;
     const char *pers = "ssl_server";
 
@@ -122,6 +241,10 @@ static void ssl_main(void *arg)
     mbedtls_ssl_config_init(&conf);
 #if defined(MBEDTLS_SSL_CACHE_C)
     mbedtls_ssl_cache_init(&cache);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_init(&ticket_ctx[0]);
+    mbedtls_ssl_ticket_init(&ticket_ctx[1]);
 #endif
     mbedtls_x509_crt_init(&srvcert);
     mbedtls_pk_init(&pkey);
@@ -132,7 +255,6 @@ static void ssl_main(void *arg)
     mbedtls_debug_set_threshold(DEBUG_LEVEL);
 #endif
 
-#if 0
     /*
      * 1. Seed the RNG
      */
@@ -148,7 +270,6 @@ static void ssl_main(void *arg)
     }
 
     mbedtls_printf(" ok\n");
-#endif
 
     /*
      * 2. Load the certificates and private RSA key
@@ -222,10 +343,25 @@ static void ssl_main(void *arg)
 
 #if defined(MBEDTLS_SSL_CACHE_C)
     mbedtls_ssl_conf_session_cache(&conf, &cache,
-                                   mbedtls_ssl_cache_get,
+                                   ssl_cache_get,
                                    mbedtls_ssl_cache_set);
 #endif
 
+#if defined(MBEDTLS_SSL_TICKET_C)
+    /* Both keys are set up, the previous one has no tickets yet */
+    if((ret = mbedtls_ssl_ticket_setup(&ticket_ctx[0], mbedtls_ctr_drbg_random, &ctr_drbg,
+                                       SSL_TICKET_CIPHER, SSL_TICKET_LIFETIME)) != 0 ||
+            (ret = mbedtls_ssl_ticket_setup(&ticket_ctx[1], mbedtls_ctr_drbg_random, &ctr_drbg,
+                                            SSL_TICKET_CIPHER, SSL_TICKET_LIFETIME)) != 0)
+    {
+        mbedtls_printf(" failed\n  ! mbedtls_ssl_ticket_setup returned %d\n\n", ret);
+        goto exit;
+    }
+
+    mbedtls_ssl_conf_session_tickets_cb(&conf, ssl_ticket_write,
+                                        ssl_ticket_parse, ticket_ctx);
+#endif
+
     mbedtls_ssl_conf_ca_chain(&conf, srvcert.next, NULL);
     if((ret = mbedtls_ssl_conf_own_cert(&conf, &srvcert, &pkey)) != 0)
     {
@@ -255,6 +391,18 @@ reset:
 
     mbedtls_ssl_session_reset(&ssl);
 
+#if defined(MBEDTLS_SSL_TICKET_C)
+    if(s_u32TicketCnt >= SSL_TICKET_ROTATE_CNT)
+    {
+        s_u32TicketCnt = 0;
+        if((ret = ssl_ticket_rotate()) != 0)
+        {
+            mbedtls_printf("  ! mbedtls_ssl_ticket_setup returned %d\n\n", ret);
+            goto exit;
+        }
+    }
+#endif
+
     /*
      * 3. Wait until a client connects
      */
@@ -278,6 +426,9 @@ reset:
     mbedtls_printf("  . Performing the SSL/TLS handshake...");
     fflush(stdout);
 
+    s_u8Resumed = 0;
+    u32Start = sys_now();
+
     while((ret = mbedtls_ssl_handshake(&ssl)) != 0)
     {
         if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
@@ -287,7 +438,9 @@ reset:
         }
     }
 
-    mbedtls_printf(" ok\n");
+    mbedtls_printf(" ok (%s)\n", s_u8Resumed ? "resumed" : "full");
+
+    ssl_stats_update(sys_now() - u32Start);
 
     /*
      * 6. Read the HTTP Request
@@ -396,6 +549,10 @@ exit:
     mbedtls_ssl_config_free(&conf);
 #if defined(MBEDTLS_SSL_CACHE_C)
     mbedtls_ssl_cache_free(&cache);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_free(&ticket_ctx[0]);
+    mbedtls_ssl_ticket_free(&ticket_ctx[1]);
 #endif
     mbedtls_ctr_drbg_free(&ctr_drbg);
     mbedtls_entropy_free(&entropy);
@@ -101,11 +101,63 @@ fs_free(struct fs_file *file)
 }
 
 /*-----------------------------------------------------------------------------------*/
-struct fs_file *
-fs_open(const char *name)
+#ifdef FS_HASH_BUCKETS
+/* Seeded FNV-1a, must match fs_hash() in makefsdata.py */
+static u32_t
+fs_hash(const char *name, u32_t seed)
+{
+    u32_t h = 0x811C9DC5UL ^ seed;
+
+    while(*name)
+    {
+        h ^= (u8_t)*name++;
+        h = (h * 0x01000193UL) & 0xFFFFFFFFUL;
+    }
+    return h;
+}
+
+static const struct fsdata_index *
+fs_lookup(const char *name)
+{
+    const struct fsdata_index *idx;
+    u32_t disp;
+
+    disp = fs_hash_disp[fs_hash(name, 0) % FS_HASH_BUCKETS];
+    idx = &fs_hash_table[fs_hash(name, disp) % FS_NUMFILES];
+
+    /* The index is perfect for known names only, so confirm the hit */
+    if(strcmp(name, (const char *)idx->file->name))
+    {
+        return NULL;
+    }
+    return idx;
+}
+#else /* FS_HASH_BUCKETS */
+static const struct fsdata_file *
+fs_lookup_list(const char *name)
+{
+    const struct fsdata_file *f;
+
+    for(f = FS_ROOT; f != NULL; f = f->next)
+    {
+        if(!strcmp(name, (char *)f->name))
+        {
+            return f;
+        }
+    }
+    return NULL;
+}
+#endif /* FS_HASH_BUCKETS */
+
+/*-----------------------------------------------------------------------------------*/
+static struct fs_file *
+fs_open_file(const char *name, int gzip)
 {
     struct fs_file *file;
     const struct fsdata_file *f;
+#ifdef FS_HASH_BUCKETS
+    const struct fsdata_index *idx;
+#endif /* FS_HASH_BUCKETS */
 
     file = fs_malloc();
     if(file == NULL)
@@ -122,29 +174,49 @@ fs_open(const char *name)
     file->is_custom_file = 0;
 #endif /* LWIP_HTTPD_CUSTOM_FILES */
 
-    for(f = FS_ROOT; f != NULL; f = f->next)
+#ifdef FS_HASH_BUCKETS
+    idx = fs_lookup(name);
+    f = (idx == NULL) ? NULL : (gzip ? idx->gzip : idx->file);
+#else /* FS_HASH_BUCKETS */
+    f = gzip ? NULL : fs_lookup_list(name);
+#endif /* FS_HASH_BUCKETS */
+
+    if(f != NULL)
     {
-        if(!strcmp(name, (char *)f->name))
-        {
-            file->data = (const char *)f->data;
-            file->len = f->len;
-            file->index = f->len;
-            file->pextension = NULL;
-            file->http_header_included = f->http_header_included;
+        file->data = (const char *)f->data;
+        file->len = f->len;
+        file->index = f->len;
+        file->pextension = NULL;
+        file->http_header_included = f->http_header_included;
 #if HTTPD_PRECALCULATED_CHECKSUM
-            file->chksum_count = f->chksum_count;
-            file->chksum = f->chksum;
+        file->chksum_count = f->chksum_count;
+        file->chksum = f->chksum;
 #endif /* HTTPD_PRECALCULATED_CHECKSUM */
 #if LWIP_HTTPD_FILE_STATE
-            file->state = fs_state_init(file, name);
+        file->state = fs_state_init(file, name);
 #endif /* #if LWIP_HTTPD_FILE_STATE */
-            return file;
-        }
+        return file;
     }
     fs_free(file);
     return NULL;
 }
 
+/*-----------------------------------------------------------------------------------*/
+struct fs_file *
+fs_open(const char *name)
+{
+    return fs_open_file(name, 0);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/* Open the gzip-compressed variant of a file. Returns NULL if there is none,
+ * the caller then falls back to fs_open(). */
+struct fs_file *
+fs_open_gzip(const char *name)
+{
+    return fs_open_file(name, 1);
+}
+
 /*-----------------------------------------------------------------------------------*/
 void
 fs_close(struct fs_file *file)
@@ -1,22 +1,26 @@
+/* Generated by makefsdata.py from fs/, do not edit. */
+
 static const unsigned char data_404_html[] =
 {
-/* /404.html (10 chars) */
+/* /404.html (12 chars) */
 0x2f,0x34,0x30,0x34,0x2e,0x68,0x74,0x6d,0x6c,0x00,0x00,0x00,
 
 /* HTTP header */
-/* "HTTP/1.0 404 File not found
-" (29 bytes) */
-0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x30,0x20,0x34,0x30,0x34,0x20,0x46,0x69,0x6c,
+/* "HTTP/1.1 404 File not found\r\n" (29 bytes) */
+0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x31,0x20,0x34,0x30,0x34,0x20,0x46,0x69,0x6c,
 0x65,0x20,0x6e,0x6f,0x74,0x20,0x66,0x6f,0x75,0x6e,0x64,0x0d,0x0a,
-/* "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)
-" (63 bytes) */
+/* "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)\r\n" (63 bytes) */
 0x53,0x65,0x72,0x76,0x65,0x72,0x3a,0x20,0x6c,0x77,0x49,0x50,0x2f,0x31,0x2e,0x33,
 0x2e,0x31,0x20,0x28,0x68,0x74,0x74,0x70,0x3a,0x2f,0x2f,0x73,0x61,0x76,0x61,0x6e,
 0x6e,0x61,0x68,0x2e,0x6e,0x6f,0x6e,0x67,0x6e,0x75,0x2e,0x6f,0x72,0x67,0x2f,0x70,
 0x72,0x6f,0x6a,0x65,0x63,0x74,0x73,0x2f,0x6c,0x77,0x69,0x70,0x29,0x0d,0x0a,
-/* "Content-type: text/html
-
-" (27 bytes) */
+/* "Content-Length: 703\r\n" (21 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x4c,0x65,0x6e,0x67,0x74,0x68,0x3a,0x20,
+0x37,0x30,0x33,0x0d,0x0a,
+/* "Vary: Accept-Encoding\r\n" (23 bytes) */
+0x56,0x61,0x72,0x79,0x3a,0x20,0x41,0x63,0x63,0x65,0x70,0x74,0x2d,0x45,0x6e,0x63,
+0x6f,0x64,0x69,0x6e,0x67,0x0d,0x0a,
+/* "Content-type: text/html\r\n\r\n" (27 bytes) */
 0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x74,0x79,0x70,0x65,0x3a,0x20,0x74,0x65,
 0x78,0x74,0x2f,0x68,0x74,0x6d,0x6c,0x0d,0x0a,0x0d,0x0a,
 /* raw file data (703 bytes) */
@@ -72,19 +76,18 @@ static const unsigned char data_img_m4_jpg[] =
 0x2f,0x69,0x6d,0x67,0x2f,0x6d,0x34,0x2e,0x6a,0x70,0x67,0x00,
 
 /* HTTP header */
-/* "HTTP/1.0 200 OK
-" (17 bytes) */
-0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x30,0x20,0x32,0x30,0x30,0x20,0x4f,0x4b,0x0d,
+/* "HTTP/1.1 200 OK\r\n" (17 bytes) */
+0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x31,0x20,0x32,0x30,0x30,0x20,0x4f,0x4b,0x0d,
 0x0a,
-/* "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)
-" (63 bytes) */
+/* "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)\r\n" (63 bytes) */
 0x53,0x65,0x72,0x76,0x65,0x72,0x3a,0x20,0x6c,0x77,0x49,0x50,0x2f,0x31,0x2e,0x33,
 0x2e,0x31,0x20,0x28,0x68,0x74,0x74,0x70,0x3a,0x2f,0x2f,0x73,0x61,0x76,0x61,0x6e,
 0x6e,0x61,0x68,0x2e,0x6e,0x6f,0x6e,0x67,0x6e,0x75,0x2e,0x6f,0x72,0x67,0x2f,0x70,
 0x72,0x6f,0x6a,0x65,0x63,0x74,0x73,0x2f,0x6c,0x77,0x69,0x70,0x29,0x0d,0x0a,
-/* "Content-type: image/jpeg
-
-" (28 bytes) */
+/* "Content-Length: 84874\r\n" (23 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x4c,0x65,0x6e,0x67,0x74,0x68,0x3a,0x20,
+0x38,0x34,0x38,0x37,0x34,0x0d,0x0a,
+/* "Content-type: image/jpeg\r\n\r\n" (28 bytes) */
 0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x74,0x79,0x70,0x65,0x3a,0x20,0x69,0x6d,
 0x61,0x67,0x65,0x2f,0x6a,0x70,0x65,0x67,0x0d,0x0a,0x0d,0x0a,
 /* raw file data (84874 bytes) */
@@ -5401,19 +5404,21 @@ static const unsigned char data_index_html[] =
 0x2f,0x69,0x6e,0x64,0x65,0x78,0x2e,0x68,0x74,0x6d,0x6c,0x00,
 
 /* HTTP header */
-/* "HTTP/1.0 200 OK
-" (17 bytes) */
-0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x30,0x20,0x32,0x30,0x30,0x20,0x4f,0x4b,0x0d,
+/* "HTTP/1.1 200 OK\r\n" (17 bytes) */
+0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x31,0x20,0x32,0x30,0x30,0x20,0x4f,0x4b,0x0d,
 0x0a,
-/* "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)
-" (63 bytes) */
+/* "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)\r\n" (63 bytes) */
 0x53,0x65,0x72,0x76,0x65,0x72,0x3a,0x20,0x6c,0x77,0x49,0x50,0x2f,0x31,0x2e,0x33,
 0x2e,0x31,0x20,0x28,0x68,0x74,0x74,0x70,0x3a,0x2f,0x2f,0x73,0x61,0x76,0x61,0x6e,
 0x6e,0x61,0x68,0x2e,0x6e,0x6f,0x6e,0x67,0x6e,0x75,0x2e,0x6f,0x72,0x67,0x2f,0x70,
 0x72,0x6f,0x6a,0x65,0x63,0x74,0x73,0x2f,0x6c,0x77,0x69,0x70,0x29,0x0d,0x0a,
-/* "Content-type: text/html
-
-" (27 bytes) */
+/* "Content-Length: 2404\r\n" (22 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x4c,0x65,0x6e,0x67,0x74,0x68,0x3a,0x20,
+0x32,0x34,0x30,0x34,0x0d,0x0a,
+/* "Vary: Accept-Encoding\r\n" (23 bytes) */
+0x56,0x61,0x72,0x79,0x3a,0x20,0x41,0x63,0x63,0x65,0x70,0x74,0x2d,0x45,0x6e,0x63,
+0x6f,0x64,0x69,0x6e,0x67,0x0d,0x0a,
+/* "Content-type: text/html\r\n\r\n" (27 bytes) */
 0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x74,0x79,0x70,0x65,0x3a,0x20,0x74,0x65,
 0x78,0x74,0x2f,0x68,0x74,0x6d,0x6c,0x0d,0x0a,0x0d,0x0a,
 /* raw file data (2404 bytes) */
@@ -5570,12 +5575,306 @@ static const unsigned char data_index_html[] =
 0x74,0x6d,0x6c,0x3e
 };
 
-const struct fsdata_file file_404_html[] = {{NULL, data_404_html, data_404_html + 10, sizeof(data_404_html) - 10}};
+static const unsigned char data_404_html_gz[] =
+{
+/* /404.html (12 chars) */
+0x2f,0x34,0x30,0x34,0x2e,0x68,0x74,0x6d,0x6c,0x00,0x00,0x00,
+
+/* HTTP header */
+/* "HTTP/1.1 404 File not found\r\n" (29 bytes) */
+0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x31,0x20,0x34,0x30,0x34,0x20,0x46,0x69,0x6c,
+0x65,0x20,0x6e,0x6f,0x74,0x20,0x66,0x6f,0x75,0x6e,0x64,0x0d,0x0a,
+/* "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)\r\n" (63 bytes) */
+0x53,0x65,0x72,0x76,0x65,0x72,0x3a,0x20,0x6c,0x77,0x49,0x50,0x2f,0x31,0x2e,0x33,
+0x2e,0x31,0x20,0x28,0x68,0x74,0x74,0x70,0x3a,0x2f,0x2f,0x73,0x61,0x76,0x61,0x6e,
+0x6e,0x61,0x68,0x2e,0x6e,0x6f,0x6e,0x67,0x6e,0x75,0x2e,0x6f,0x72,0x67,0x2f,0x70,
+0x72,0x6f,0x6a,0x65,0x63,0x74,0x73,0x2f,0x6c,0x77,0x69,0x70,0x29,0x0d,0x0a,
+/* "Content-Length: 450\r\n" (21 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x4c,0x65,0x6e,0x67,0x74,0x68,0x3a,0x20,
+0x34,0x35,0x30,0x0d,0x0a,
+/* "Content-Encoding: gzip\r\n" (24 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x45,0x6e,0x63,0x6f,0x64,0x69,0x6e,0x67,
+0x3a,0x20,0x67,0x7a,0x69,0x70,0x0d,0x0a,
+/* "Vary: Accept-Encoding\r\n" (23 bytes) */
+0x56,0x61,0x72,0x79,0x3a,0x20,0x41,0x63,0x63,0x65,0x70,0x74,0x2d,0x45,0x6e,0x63,
+0x6f,0x64,0x69,0x6e,0x67,0x0d,0x0a,
+/* "Content-type: text/html\r\n\r\n" (27 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x74,0x79,0x70,0x65,0x3a,0x20,0x74,0x65,
+0x78,0x74,0x2f,0x68,0x74,0x6d,0x6c,0x0d,0x0a,0x0d,0x0a,
+/* raw file data (450 bytes) */
+0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x6d,0x52,0xc1,0x6e,0x9c,0x30,
+0x10,0x3d,0x97,0xaf,0x18,0xb9,0x6a,0x4f,0x5d,0xec,0xac,0x48,0x55,0x35,0x86,0x4b,
+0xa4,0x48,0x95,0xba,0x6d,0xd4,0x4d,0x95,0xb3,0xc1,0x03,0xb8,0x05,0x9b,0x9a,0x61,
+0x29,0x3f,0xd5,0x6f,0xac,0x0d,0xbb,0xda,0x1c,0x82,0x64,0x61,0x8f,0xdf,0xcc,0xbc,
+0xf7,0xc6,0x89,0x6c,0xa9,0xef,0x0a,0xd9,0xa2,0xd2,0x85,0xec,0x91,0x14,0xb4,0x44,
+0xc3,0x0e,0xff,0x4c,0xe6,0x94,0xb3,0x7b,0x67,0x09,0x2d,0xed,0x9e,0x96,0x01,0x19,
+0x54,0xdb,0x29,0x67,0x84,0x7f,0x89,0xc7,0xc4,0x3b,0xa8,0x5a,0xe5,0x47,0xa4,0x7c,
+0x36,0x56,0xbb,0x79,0xdc,0xdd,0xec,0x6f,0xf7,0xac,0x90,0x64,0xa8,0xc3,0xe2,0xdb,
+0x74,0x30,0x95,0x77,0xff,0xe0,0x41,0xf5,0xa6,0x5b,0xe0,0x90,0x7d,0x14,0x70,0x44,
+0x6f,0x70,0x84,0xc3,0xfd,0x4f,0xc9,0x37,0x98,0xe4,0x6b,0xfb,0x44,0x96,0x4e,0x2f,
+0x50,0x36,0x95,0xeb,0x9c,0xcf,0xd9,0xdc,0x1a,0x0a,0x5d,0x63,0xb3,0x9c,0x95,0x9d,
+0xaa,0x7e,0xb3,0x22,0x49,0x20,0x7c,0x92,0x54,0xd9,0x21,0xcc,0x46,0x53,0x9b,0xb3,
+0x1b,0x21,0xde,0x85,0x1b,0x80,0xed,0x2a,0x16,0x09,0x04,0x3c,0x9c,0x54,0x67,0x1a,
+0x1b,0xd8,0xba,0x21,0x32,0xd2,0x17,0xfc,0x27,0xc1,0x8a,0x08,0xbd,0x64,0x04,0xc9,
+0x1e,0xeb,0x9c,0x45,0xe1,0x9f,0x39,0x9f,0xe7,0x39,0xb5,0xd3,0xc9,0x91,0xb3,0x69,
+0xe5,0x7a,0x1e,0x72,0x4d,0xdf,0xc0,0xe8,0xab,0x9c,0xa5,0x3c,0x6c,0x79,0x9f,0xa5,
+0xbf,0x86,0x86,0x41,0xe9,0xbc,0xc6,0x40,0x54,0x30,0x50,0x5d,0xe0,0x78,0xc8,0xa0,
+0x54,0xd6,0xa2,0x0f,0xa4,0xa3,0xb0,0x97,0x91,0x20,0x52,0x6d,0x1c,0x83,0xea,0x60,
+0x35,0x27,0x7f,0x3e,0x86,0xcd,0x0b,0x72,0xb7,0x42,0x5c,0xb5,0xb4,0xfb,0x42,0xd6,
+0xc1,0x74,0x38,0x3b,0xf2,0xb6,0xae,0x85,0x88,0x80,0x67,0x2c,0x61,0x44,0x7f,0x42,
+0x0f,0x1a,0x7b,0x17,0x9a,0x8c,0xa8,0xc1,0x59,0xf8,0x3a,0x7f,0x79,0x04,0x65,0x35,
+0x3c,0x78,0xc4,0x1f,0x4f,0xdf,0x8f,0x92,0xc7,0x02,0xd1,0xe2,0x7d,0x91,0xbc,0xd9,
+0x6a,0x66,0x22,0x83,0x1d,0x3c,0xaa,0x06,0xc1,0x3a,0x82,0xda,0x4d,0x56,0x5f,0x01,
+0xc3,0xfa,0x03,0x38,0x3a,0xef,0x97,0x0f,0x40,0x2d,0xc2,0x10,0xa1,0x8b,0x9b,0x40,
+0x79,0x04,0x1f,0xde,0x06,0x8e,0x64,0x6c,0x03,0xb3,0x1a,0xaf,0x15,0x62,0x7b,0x6a,
+0xcd,0xb8,0x65,0x6f,0xec,0x52,0x58,0x4b,0xf2,0xa1,0xb8,0xf8,0xbd,0xa9,0x0f,0xeb,
+0xac,0xf1,0xbd,0x2d,0xc7,0xe1,0xee,0x35,0x63,0xd6,0xc0,0x36,0x4c,0xbe,0xce,0x3b,
+0x0c,0x3f,0x49,0x24,0x3f,0x87,0xd6,0x77,0xfb,0x1f,0x08,0x00,0xe3,0xcb,0xbf,0x02,
+0x00,0x00
+};
 
-const struct fsdata_file file_img_m4_jpg[] = {{file_404_html, data_img_m4_jpg, data_img_m4_jpg + 12, sizeof(data_img_m4_jpg) - 12}};
+static const unsigned char data_index_html_gz[] =
+{
+/* /index.html (12 chars) */
+0x2f,0x69,0x6e,0x64,0x65,0x78,0x2e,0x68,0x74,0x6d,0x6c,0x00,
 
-const struct fsdata_file file_index_html[] = {{file_img_m4_jpg, data_index_html, data_index_html + 12, sizeof(data_index_html) - 12}};
+/* HTTP header */
+/* "HTTP/1.1 200 OK\r\n" (17 bytes) */
+0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x31,0x20,0x32,0x30,0x30,0x20,0x4f,0x4b,0x0d,
+0x0a,
+/* "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)\r\n" (63 bytes) */
+0x53,0x65,0x72,0x76,0x65,0x72,0x3a,0x20,0x6c,0x77,0x49,0x50,0x2f,0x31,0x2e,0x33,
+0x2e,0x31,0x20,0x28,0x68,0x74,0x74,0x70,0x3a,0x2f,0x2f,0x73,0x61,0x76,0x61,0x6e,
+0x6e,0x61,0x68,0x2e,0x6e,0x6f,0x6e,0x67,0x6e,0x75,0x2e,0x6f,0x72,0x67,0x2f,0x70,
+0x72,0x6f,0x6a,0x65,0x63,0x74,0x73,0x2f,0x6c,0x77,0x69,0x70,0x29,0x0d,0x0a,
+/* "Content-Length: 1245\r\n" (22 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x4c,0x65,0x6e,0x67,0x74,0x68,0x3a,0x20,
+0x31,0x32,0x34,0x35,0x0d,0x0a,
+/* "Content-Encoding: gzip\r\n" (24 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x45,0x6e,0x63,0x6f,0x64,0x69,0x6e,0x67,
+0x3a,0x20,0x67,0x7a,0x69,0x70,0x0d,0x0a,
+/* "Vary: Accept-Encoding\r\n" (23 bytes) */
+0x56,0x61,0x72,0x79,0x3a,0x20,0x41,0x63,0x63,0x65,0x70,0x74,0x2d,0x45,0x6e,0x63,
+0x6f,0x64,0x69,0x6e,0x67,0x0d,0x0a,
+/* "Content-type: text/html\r\n\r\n" (27 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x74,0x79,0x70,0x65,0x3a,0x20,0x74,0x65,
+0x78,0x74,0x2f,0x68,0x74,0x6d,0x6c,0x0d,0x0a,0x0d,0x0a,
+/* raw file data (1245 bytes) */
+0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x8d,0x56,0xed,0x6e,0xdb,0x36,
+0x14,0xfd,0x9f,0xa7,0xb8,0xd0,0xb0,0x21,0x01,0x2c,0x4b,0x71,0x9d,0x22,0x58,0x6d,
+0x03,0xae,0x13,0x37,0xc6,0xe6,0xc6,0x8b,0x9d,0x76,0x7f,0x69,0x89,0xb6,0xb8,0x48,
+0xa4,0x46,0x52,0x71,0xbc,0x87,0x2a,0x86,0x3e,0xe1,0x0e,0x29,0x5b,0x56,0xb7,0x14,
+0x98,0x01,0x03,0xfc,0xb8,0xe4,0x3d,0xe7,0xdc,0x0f,0xea,0x6c,0x90,0xd9,0x22,0x1f,
+0x0d,0x32,0xce,0xd2,0xd1,0xa0,0xe0,0x96,0x51,0x66,0x6d,0x19,0xf2,0x3f,0x2b,0xf1,
+0x3c,0x0c,0x26,0x4a,0x5a,0x2e,0x6d,0xb8,0xda,0x97,0x3c,0xa0,0xa4,0x9e,0x0d,0x03,
+0xcb,0x5f,0x6c,0xe4,0x0e,0xbe,0xa3,0x24,0x63,0xda,0x70,0x3b,0xdc,0x09,0x99,0xaa,
+0x9d,0x09,0x2f,0x7b,0x57,0xbd,0x60,0x34,0xb0,0xc2,0xe6,0x7c,0xf4,0xb1,0x9a,0x8b,
+0x44,0xab,0x2f,0x34,0x65,0x85,0xc8,0xf7,0x34,0xef,0xbf,0x8d,0x69,0xc9,0xb5,0xe0,
+0x86,0xe6,0x93,0xc7,0x41,0x54,0x9b,0x0d,0x22,0xef,0xfe,0x6c,0xb0,0x56,0xe9,0x9e,
+0xd6,0xdb,0x44,0xe5,0x4a,0x0f,0x83,0x5d,0x26,0x2c,0xbc,0x3a,0x67,0xc3,0x60,0x9d,
+0xb3,0xe4,0x29,0x18,0x9d,0x9d,0x11,0x7e,0x03,0xcb,0xd6,0x39,0xa7,0x9d,0x48,0x6d,
+0x36,0x0c,0x2e,0xe3,0xf8,0x47,0xec,0x10,0xd5,0x5b,0xee,0x12,0x00,0xd0,0xf4,0xcc,
+0x72,0xb1,0x95,0x40,0xab,0x4a,0x87,0x28,0x3d,0xda,0x5f,0xc7,0xc1,0xc8,0x99,0x1e,
+0x4f,0x80,0xb2,0xe6,0x9b,0x61,0xe0,0x88,0xff,0x1c,0x45,0xbb,0xdd,0xae,0x2b,0xab,
+0x67,0x65,0x95,0xec,0x26,0xaa,0x88,0x70,0x56,0x14,0x5b,0x32,0x3a,0x19,0x06,0xdd,
+0x08,0xc3,0xa8,0xe8,0x77,0xff,0x28,0xb7,0x01,0xad,0x95,0x4e,0x39,0x80,0xc6,0x01,
+0xb1,0x1c,0x18,0xe7,0x7d,0x5a,0x33,0x29,0xb9,0x06,0x68,0x47,0xac,0xbd,0x02,0x92,
+0xac,0xc6,0x08,0xd6,0x90,0x3a,0xb2,0xfa,0x30,0xc5,0xa0,0x05,0xee,0x2a,0x8e,0x4f,
+0x5c,0xb2,0xde,0x68,0xb0,0x81,0xe8,0x74,0x50,0xe4,0x87,0xcd,0x26,0x8e,0x9d,0xc1,
+0x67,0xbe,0x26,0xc3,0xf5,0x33,0xd7,0x94,0xf2,0x42,0xc1,0x89,0xe1,0x29,0x29,0x49,
+0xbf,0xee,0x66,0x0b,0x62,0x32,0xa5,0xa9,0xe6,0xfc,0x61,0x75,0xbf,0x1c,0x44,0xee,
+0x02,0x27,0x71,0xaf,0xb9,0xb6,0x3c,0x8e,0x88,0x56,0x19,0xa7,0x26,0x4a,0x3e,0x3c,
+0xa6,0x0e,0x8f,0x30,0xc4,0xe8,0x4d,0x2f,0x5c,0x0b,0x4b,0x85,0xdb,0x76,0xc1,0xd7,
+0x2a,0xcf,0xe1,0xb2,0xf1,0x36,0xd6,0xc5,0x17,0x9a,0x28,0x8d,0x10,0x7d,0x09,0xe7,
+0xfd,0x29,0x70,0x6a,0xde,0x01,0x15,0x9b,0xd1,0xcd,0x72,0x41,0x8d,0x1b,0x21,0x8d,
+0xd5,0x55,0x62,0x05,0x0e,0x21,0x5b,0x3c,0x42,0x23,0xe4,0x36,0xe7,0x61,0xa9,0x79,
+0x22,0x8c,0xdb,0xd8,0xe4,0x8a,0x59,0x2c,0x86,0xa5,0x12,0xe0,0x5c,0x49,0xb8,0x3e,
+0x9f,0x2e,0x1e,0x2f,0x3a,0x64,0x99,0xde,0x72,0x0b,0xa7,0x1b,0xa5,0x69,0xa6,0x56,
+0x1d,0x9a,0xc9,0xb4,0xc2,0x9d,0x82,0xe5,0x9d,0x93,0x1b,0x77,0x2d,0x70,0x9a,0xaa,
+0x00,0x4a,0x56,0x96,0xb9,0x48,0x98,0xf3,0x69,0xba,0x9e,0x68,0x9b,0x9f,0xae,0xa4,
+0xa1,0xaa,0x24,0xab,0xa8,0x17,0xc7,0x34,0xbf,0xfb,0xab,0xe3,0x8f,0x6f,0x38,0xb3,
+0x95,0x86,0xc1,0x65,0xf7,0xfa,0x93,0xdb,0x7d,0xd3,0x7d,0xfb,0xc9,0x05,0x87,0x9f,
+0xdc,0xa8,0x92,0x6b,0x8f,0x94,0x9e,0x55,0x6e,0xd9,0x16,0x94,0xc3,0x7e,0xfc,0xf7,
+0xc4,0x99,0x5f,0xc6,0x57,0x18,0x78,0xfb,0x93,0x99,0xe5,0x85,0x1f,0x57,0x4e,0x1d,
+0x86,0xc4,0x04,0x04,0xbb,0x27,0xb5,0xa1,0x12,0x59,0x8d,0x0b,0x0c,0xea,0x48,0x89,
+0x84,0xff,0x8b,0x0b,0x7f,0x49,0x38,0x14,0x87,0x18,0x99,0xd8,0x66,0x24,0x8a,0xc2,
+0x89,0xb2,0xf7,0x45,0xc7,0x12,0x0b,0x26,0xc6,0x8a,0xc4,0xd0,0x7a,0x4f,0xb7,0xcb,
+0x1b,0xba,0x7b,0x3f,0xa7,0x3e,0xfd,0xf2,0xc9,0x9f,0xbd,0x9d,0xae,0xa8,0xdf,0x75,
+0xd3,0xee,0x31,0xee,0x51,0xf9,0x5a,0x0a,0x8c,0x0d,0x59,0x88,0x23,0xf9,0x8e,0x4c,
+0xc1,0xb4,0xa5,0x4d,0x25,0xeb,0x48,0xb1,0x34,0xad,0xe3,0x9c,0xa9,0x82,0xd7,0x7a,
+0x32,0x99,0x70,0xd3,0xf1,0x07,0xda,0x6a,0x96,0x5a,0x3d,0x83,0xf2,0x51,0xd1,0xcb,
+0xb8,0x07,0xc7,0xef,0x29,0xad,0x58,0x1e,0x36,0x8e,0x50,0x09,0x4f,0x8e,0xf3,0x34,
+0x67,0x26,0xa3,0x02,0x79,0xab,0xf7,0x3e,0xa0,0x89,0x82,0x5a,0xc6,0x2a,0x0d,0x25,
+0x3c,0xf6,0xab,0xcb,0x9e,0x3b,0xbe,0x7c,0x18,0xcf,0xbd,0x01,0x82,0x85,0x8a,0x2a,
+0x1a,0x49,0x51,0x99,0x3e,0xa0,0xee,0xfe,0xfa,0x5a,0xf8,0x46,0xad,0xd7,0x7e,0x4e,
+0x71,0xda,0x34,0x48,0xbe,0xf1,0x69,0xaa,0xb2,0x44,0xd2,0xd6,0xbc,0xa7,0x42,0x17,
+0x3b,0xa6,0x39,0xa0,0xa7,0xcc,0x72,0xac,0x69,0x55,0x41,0x6c,0xb7,0x77,0x8f,0x02,
+0x0b,0xe1,0x28,0x1c,0x0b,0x8d,0x54,0xbc,0x5f,0x8d,0x2f,0x1c,0x55,0x48,0x80,0x8c,
+0x3a,0x09,0x98,0xa6,0xc2,0x61,0x62,0x79,0xbe,0xef,0x20,0xd5,0x09,0xe9,0x53,0x22,
+0xe9,0xb8,0x93,0xc2,0x5d,0x53,0xf3,0xe3,0x49,0xa5,0x5d,0xf0,0xb4,0xeb,0xad,0x9a,
+0x17,0x08,0x2b,0x94,0xfc,0x8f,0x94,0x0d,0xb8,0xdb,0x17,0x9c,0xb0,0x3c,0xbc,0x97,
+0xe8,0x9c,0x8d,0xb3,0x79,0x4d,0xe1,0xfc,0xf7,0xfb,0xf9,0xc5,0x29,0x52,0x70,0x04,
+0x5c,0x96,0x27,0xae,0x55,0xc8,0x0d,0x42,0x21,0x2d,0x4a,0xc3,0x2d,0x6e,0x35,0x2b,
+0x6a,0x04,0x42,0x42,0xcb,0xc2,0xcb,0x47,0x1b,0xad,0x0a,0x48,0xce,0xd1,0x22,0x91,
+0x9f,0xc0,0xec,0x60,0x40,0xe6,0xd0,0xc9,0xdc,0xe2,0x36,0x93,0xe4,0x9b,0x9c,0xf3,
+0xa0,0x79,0x5a,0x25,0xdc,0x5b,0x42,0x29,0x46,0x2c,0x71,0x42,0x90,0x82,0x48,0xae,
+0x7f,0x3b,0xb9,0x27,0x8b,0x47,0xdf,0x03,0x3c,0x20,0xf0,0x29,0x33,0xc4,0x2b,0x37,
+0x2e,0xe9,0x4f,0x53,0x4a,0x41,0x1f,0x48,0x0f,0xd1,0x38,0x65,0x7c,0x7d,0xdf,0xf9,
+0xe2,0x66,0x0e,0x9d,0x45,0x93,0x55,0x69,0x83,0xe7,0x3b,0x19,0xbc,0xfa,0x9e,0x84,
+0xa5,0xab,0x9d,0xba,0xce,0xda,0x60,0x84,0x4c,0xf2,0x2a,0x75,0xc4,0x0f,0x0d,0xa0,
+0xef,0x2a,0x0a,0x6d,0x3a,0x37,0x3e,0x67,0xde,0xfa,0xae,0xb7,0xf8,0x3c,0xef,0x20,
+0x7f,0x5c,0xbf,0xf2,0xcb,0x8d,0xbb,0xc7,0xf1,0x03,0x1a,0x50,0xbf,0xd9,0x58,0x2e,
+0x66,0xd1,0xec,0xeb,0xb2,0x43,0x3d,0xdf,0xdb,0xb0,0xf2,0x5b,0xc5,0xd2,0x10,0xcb,
+0x1d,0xba,0x6a,0xac,0x66,0x5f,0x27,0x1d,0x7a,0x5c,0xbe,0xa7,0xbb,0x25,0xdd,0xaf,
+0x3e,0xd4,0xe3,0xe9,0x61,0xec,0x92,0x9e,0x41,0x60,0x94,0x8b,0xcf,0xf3,0xc6,0x57,
+0x92,0xab,0xe4,0x89,0xce,0x1f,0x56,0x93,0x8b,0x6e,0xeb,0xc9,0xfa,0x7f,0x3a,0x80,
+0xac,0x3a,0x95,0xa6,0x16,0x49,0x06,0x47,0x2c,0x57,0xdb,0xb6,0x1c,0x2d,0x35,0x4e,
+0x94,0x0e,0x66,0x78,0xfe,0x4a,0x74,0x1a,0x54,0x26,0x54,0x3b,0x68,0x75,0xdd,0x02,
+0xd7,0x16,0xad,0x7e,0x2a,0x96,0xe3,0x07,0x1a,0xdf,0x4c,0x6a,0x46,0xbd,0xa3,0x45,
+0xcb,0xe0,0x66,0x3c,0xe9,0xbe,0x0e,0x14,0x3d,0x9f,0x23,0x59,0xad,0x9b,0xd3,0x4a,
+0x57,0x2d,0x15,0x34,0x6e,0x43,0xbe,0xca,0xaa,0x58,0x23,0x15,0xb7,0x5c,0x72,0x0f,
+0x8a,0xce,0x57,0x0f,0x1f,0x3f,0x5c,0x38,0x58,0x87,0x90,0xd7,0x69,0x7c,0x2a,0x30,
+0xdf,0x3d,0xb8,0x4c,0xf4,0xbe,0xac,0x3b,0x1a,0x50,0xa5,0xfc,0x38,0xed,0x7e,0x23,
+0x68,0xab,0x79,0xd4,0x4f,0x34,0xfe,0x87,0xed,0x9f,0xe4,0xda,0x94,0xef,0x5e,0x7b,
+0xbd,0xfd,0x42,0xfd,0xc5,0x11,0xf9,0x8f,0x12,0x7c,0xa1,0x9c,0x9d,0x0d,0xa2,0xc3,
+0x92,0xff,0xb8,0xfa,0x07,0xdc,0x73,0xfa,0x07,0x64,0x09,0x00,0x00
+};
+
+#if HTTPD_PRECALCULATED_CHECKSUM
+
+static const struct fsdata_chksum chksums_404_html[] =
+{
+{0, 0x953b, 163},
+{163, 0x16d9, 703},
+};
+
+static const struct fsdata_chksum chksums_img_m4_jpg[] =
+{
+{0, 0x56c2, 131},
+{131, 0x41f6, 1460},
+{1591, 0x060f, 1460},
+{3051, 0x0d88, 1460},
+{4511, 0xcfc5, 1460},
+{5971, 0x5ba6, 1460},
+{7431, 0x7dbe, 1460},
+{8891, 0xef4b, 1460},
+{10351, 0xb5c5, 1460},
+{11811, 0x0226, 1460},
+{13271, 0xc995, 1460},
+{14731, 0xa7e0, 1460},
+{16191, 0xad52, 1460},
+{17651, 0x3495, 1460},
+{19111, 0x675f, 1460},
+{20571, 0x879e, 1460},
+{22031, 0x8e8c, 1460},
+{23491, 0x4427, 1460},
+{24951, 0xa3f2, 1460},
+{26411, 0xca0c, 1460},
+{27871, 0x591d, 1460},
+{29331, 0xc8ad, 1460},
+{30791, 0x3050, 1460},
+{32251, 0x8305, 1460},
+{33711, 0xa78d, 1460},
+{35171, 0x2056, 1460},
+{36631, 0x9d30, 1460},
+{38091, 0x2be8, 1460},
+{39551, 0x7842, 1460},
+{41011, 0x5ae3, 1460},
+{42471, 0x1b70, 1460},
+{43931, 0x42a2, 1460},
+{45391, 0x7551, 1460},
+{46851, 0x8d3b, 1460},
+{48311, 0x8682, 1460},
+{49771, 0x2fa7, 1460},
+{51231, 0x1965, 1460},
+{52691, 0x3660, 1460},
+{54151, 0xea27, 1460},
+{55611, 0x2081, 1460},
+{57071, 0xa7e9, 1460},
+{58531, 0x2ece, 1460},
+{59991, 0xf477, 1460},
+{61451, 0x15e7, 1460},
+{62911, 0x2652, 1460},
+{64371, 0xf5b2, 1460},
+{65831, 0x6717, 1460},
+{67291, 0x2c7b, 1460},
+{68751, 0x6a15, 1460},
+{70211, 0x5394, 1460},
+{71671, 0x8ff4, 1460},
+{73131, 0x069c, 1460},
+{74591, 0x6e8c, 1460},
+{76051, 0x051b, 1460},
+{77511, 0xe5db, 1460},
+{78971, 0x6af3, 1460},
+{80431, 0x973d, 1460},
+{81891, 0xb73c, 1460},
+{83351, 0x4a68, 1460},
+{84811, 0x54bc, 194},
+};
+
+static const struct fsdata_chksum chksums_index_html[] =
+{
+{0, 0x085b, 152},
+{152, 0xae70, 1460},
+{1612, 0xedb6, 944},
+};
+
+static const struct fsdata_chksum chksums_404_html_gz[] =
+{
+{0, 0xb978, 187},
+{187, 0x0a3a, 450},
+};
+
+static const struct fsdata_chksum chksums_index_html_gz[] =
+{
+{0, 0x4a7d, 176},
+{176, 0x62f8, 1245},
+};
+
+#endif /* HTTPD_PRECALCULATED_CHECKSUM */
+
+const struct fsdata_file file_404_html_gz[] = {{NULL, data_404_html_gz, data_404_html_gz + 12, sizeof(data_404_html_gz) - 12, 1,
+#if HTTPD_PRECALCULATED_CHECKSUM
+2, chksums_404_html_gz,
+#endif /* HTTPD_PRECALCULATED_CHECKSUM */
+}};
+
+const struct fsdata_file file_index_html_gz[] = {{NULL, data_index_html_gz, data_index_html_gz + 12, sizeof(data_index_html_gz) - 12, 1,
+#if HTTPD_PRECALCULATED_CHECKSUM
+2, chksums_index_html_gz,
+#endif /* HTTPD_PRECALCULATED_CHECKSUM */
+}};
+
+const struct fsdata_file file_404_html[] = {{NULL, data_404_html, data_404_html + 12, sizeof(data_404_html) - 12, 1,
+#if HTTPD_PRECALCULATED_CHECKSUM
+2, chksums_404_html,
+#endif /* HTTPD_PRECALCULATED_CHECKSUM */
+}};
+
+const struct fsdata_file file_img_m4_jpg[] = {{file_404_html, data_img_m4_jpg, data_img_m4_jpg + 12, sizeof(data_img_m4_jpg) - 12, 1,
+#if HTTPD_PRECALCULATED_CHECKSUM
+60, chksums_img_m4_jpg,
+#endif /* HTTPD_PRECALCULATED_CHECKSUM */
+}};
+
+const struct fsdata_file file_index_html[] = {{file_img_m4_jpg, data_index_html, data_index_html + 12, sizeof(data_index_html) - 12, 1,
+#if HTTPD_PRECALCULATED_CHECKSUM
+3, chksums_index_html,
+#endif /* HTTPD_PRECALCULATED_CHECKSUM */
+}};
 
 #define FS_ROOT file_index_html
 
 #define FS_NUMFILES 3
+
+/* Perfect hash index, see fs_hash() in fs.c */
+#define FS_HASH_BUCKETS 1
+
+static const u16_t fs_hash_disp[FS_HASH_BUCKETS] = {5};
+
+static const struct fsdata_index fs_hash_table[FS_NUMFILES] =
+{
+    {file_index_html, file_index_html_gz},
+    {file_img_m4_jpg, NULL},
+    {file_404_html, file_404_html_gz},
+};
@@ -48,4 +48,12 @@ struct fsdata_file
 #endif /* HTTPD_PRECALCULATED_CHECKSUM */
 };
 
+/** Perfect hash index slot emitted by makefsdata.py: the file and its
+ * gzip-compressed variant (NULL if the file is not worth compressing). */
+struct fsdata_index
+{
+    const struct fsdata_file *file;
+    const struct fsdata_file *gzip;
+};
+
 #endif /* __FSDATA_H__ */
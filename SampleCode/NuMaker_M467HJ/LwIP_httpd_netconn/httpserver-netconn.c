@@ -4,138 +4,351 @@
 #include "lwip/opt.h"
 #include "lwip/arch.h"
 #include "lwip/api.h"
+#include "lwip/def.h"
+#include "lwip/sys.h"
 #include "fs.h"
 #include "string.h"
 #include "httpserver-netconn.h"
 
 
 /* Private typedef -----------------------------------------------------------*/
+/* Per-worker state: the request reassembly buffer */
+struct http_worker
+{
+    u16_t len;
+    char req[HTTP_REQ_MAX + 1];
+};
+
 /* Private define ------------------------------------------------------------*/
 #define WEBSERVER_THREAD_PRIO    ( tskIDLE_PRIORITY + 2UL )
-#define WEBSERVER_THREAD_STACKSIZE  200
+#define WEBSERVER_THREAD_STACKSIZE  256
+/* Longest request path served from fsdata */
+#define HTTP_URI_MAX                64
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+/* Served requests and response bytes handed to TCP, for benchmarking e.g. with
+   ab -k -c 4 -n 1000 -H "Accept-Encoding: gzip" http://<board ip>/index.html */
 u32_t nPageHits = 0;
+u32_t nBytesSent = 0;
+
+static struct http_worker s_asWorker[HTTP_WORKER_NUM];
+/* Accepted connections, from the accept thread to the workers */
+static sys_mbox_t s_mbConn;
+/* Workers currently holding a client connection */
+static u8_t s_u8Busy = 0;
 
 
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
 
+/**
+  * @brief  Copy the path of a "GET /path HTTP/1.x" request line
+  * @param  buf: request data, not NUL terminated
+  * @param  buflen: request length
+  * @param  uri: destination buffer of HTTP_URI_MAX bytes
+  * @retval Path length, or -1 if the path does not fit
+  */
+static int http_parse_uri(const char *buf, u16_t buflen, char *uri)
+{
+    const char *p = buf + 4;
+    const char *end = buf + buflen;
+    int len = 0;
+
+    while((p < end) && (*p != ' ') && (*p != '?') && (*p != '\r'))
+    {
+        if(len == HTTP_URI_MAX - 1)
+            return -1;
+        uri[len++] = *p++;
+    }
+    uri[len] = '\0';
+
+    return len;
+}
+
+/**
+  * @brief  Check if a request header contains a token
+  * @param  buf: request data, not NUL terminated
+  * @param  buflen: request length
+  * @param  name: header name including the colon, e.g. "Accept-Encoding:"
+  * @param  token: value to look for, e.g. "gzip"
+  * @retval 1 if found, 0 otherwise
+  */
+static int http_header_has(const char *buf, u16_t buflen, const char *name, const char *token)
+{
+    const char *line = buf;
+    const char *end = buf + buflen;
+    const char *eol;
+    size_t n = strlen(name);
+
+    while(line < end)
+    {
+        eol = lwip_strnstr(line, "\r\n", (size_t)(end - line));
+        if(eol == NULL)
+            eol = end;
+
+        if(((size_t)(eol - line) > n) && (lwip_strnicmp(line, name, n) == 0))
+            return (lwip_strnstr(line + n, token, (size_t)(eol - line) - n) != NULL);
+
+        line = eol + 2;
+    }
+
+    return 0;
+}
+
+/**
+  * @brief  Answer one complete request
+  * @param  conn: pointer on connection structure
+  * @param  buf: request line and headers, up to and including the empty line
+  * @param  buflen: request length
+  * @retval 1 to keep the connection open for the next request, 0 to close it
+  */
+static int http_server_respond(struct netconn *conn, const char *buf, u16_t buflen)
+{
+    struct fs_file * file;
+    char uri[HTTP_URI_MAX];
+    int gzip;
+    const char *eol;
+    err_t err;
+
+    /* Is this an HTTP GET command? (only check the first 5 chars, since
+    there are other formats for GET, and we're keeping it very simple )*/
+    if((buflen < 5) || (strncmp(buf, "GET /", 5) != 0))
+        return 0;
+
+    gzip = http_header_has(buf, buflen, "Accept-Encoding:", "gzip");
+    file = NULL;
+
+    if(http_parse_uri(buf, buflen, uri) > 0)
+    {
+        /* Load index page for the site root */
+        if(strcmp(uri, "/") == 0)
+            strcpy(uri, "/index.html");
+
+        /* Prefer the pre-compressed variant when the client accepts it */
+        if(gzip)
+            file = fs_open_gzip(uri);
+        if(file == NULL)
+            file = fs_open(uri);
+    }
+
+    if(file == NULL)
+    {
+        /* Load Error page */
+        if(gzip)
+            file = fs_open_gzip("/404.html");
+        if(file == NULL)
+            file = fs_open("/404.html");
+    }
+
+    if(file == NULL)
+        return 0;
+
+    err = netconn_write(conn, (const unsigned char*)(file->data), (size_t)file->len, NETCONN_NOCOPY);
+    nBytesSent += (u32_t)file->len;
+    nPageHits++;
+    fs_close(file);
+
+    if(err != ERR_OK)
+        return 0;
+
+    /* Responses carry Content-Length, so HTTP/1.1 clients may reuse the
+       connection unless they asked otherwise. HTTP/1.0 clients are closed. */
+    eol = lwip_strnstr(buf, "\r\n", buflen);
+    if((eol == NULL) || (lwip_strnstr(buf, " HTTP/1.1", (size_t)(eol - buf)) == NULL))
+        return 0;
+
+    return !http_header_has(buf, buflen, "Connection:", "close");
+}
+
+/**
+  * @brief  Answer every complete request in the reassembly buffer
+  * @param  conn: pointer on connection structure
+  * @param  w: worker owning the buffer
+  * @retval 1 to keep the connection open, 0 to close it
+  */
+static int http_server_process(struct netconn *conn, struct http_worker *w)
+{
+    char *end;
+    u16_t used;
+
+    /* Pipelined requests are answered in order */
+    while((end = lwip_strnstr(w->req, "\r\n\r\n", w->len)) != NULL)
+    {
+        used = (u16_t)(end + 4 - w->req);
+
+        if(!http_server_respond(conn, w->req, used))
+            return 0;
+
+        w->len -= used;
+        memmove(w->req, w->req + used, w->len);
+        w->req[w->len] = '\0';
+    }
+
+    /* A request header that does not fit the buffer is not served */
+    return (w->len < HTTP_REQ_MAX);
+}
+
 /**
   * @brief serve tcp connection
   * @param conn: pointer on connection structure
+  * @param w: worker serving the connection
   * @retval None
   */
-void http_server_serve(struct netconn *conn)
+static void http_server_serve(struct netconn *conn, struct http_worker *w)
 {
     struct netbuf *inbuf;
-    char* buf;
-    u16_t buflen;
-    struct fs_file * file;
+    char *data;
+    u16_t len, copy;
+    u32_t idle = 0;
+    int keep = 1;
+    err_t err;
 
-    /* Read the data from the port, blocking if nothing yet there.
-     We assume the request (the part we care about) is in one netbuf */
-    netconn_recv(conn, &inbuf);
+    w->len = 0;
+    w->req[0] = '\0';
+    netconn_set_recvtimeout(conn, HTTP_KEEPALIVE_POLL_MS);
 
-    if(inbuf != NULL)
+    while(keep)
     {
-        if(netconn_err(conn) == ERR_OK)
+        err = netconn_recv(conn, &inbuf);
+        if(err == ERR_TIMEOUT)
         {
-            netbuf_data(inbuf, (void**)&buf, &buflen);
+            /* Drop idle clients early when every worker is taken, so that
+               connections waiting in the accept queue get served */
+            idle += HTTP_KEEPALIVE_POLL_MS;
+            if((idle >= HTTP_KEEPALIVE_MS) ||
+                    ((s_u8Busy >= HTTP_WORKER_NUM) && (idle >= HTTP_KEEPALIVE_BUSY_MS)))
+                break;
+            continue;
+        }
+        if(err != ERR_OK)
+            break;
+
+        idle = 0;
 
-            /* Is this an HTTP GET command? (only check the first 5 chars, since
-            there are other formats for GET, and we're keeping it very simple )*/
-            if((buflen >= 5) && (strncmp(buf, "GET /", 5) == 0))
+        /* Requests may span netbufs and segments, collect them in w->req */
+        do
+        {
+            netbuf_data(inbuf, (void**)&data, &len);
+
+            while(keep && (len > 0))
             {
-                /* Check if request to get m4.jpg */
-                if(strncmp((char const *)buf, "GET /img/m4.jpg", 15) == 0)
-                {
-                    /* Check if request to get M4 banner */
-                    file = fs_open("/img/m4.jpg");
-                    netconn_write(conn, (const unsigned char*)(file->data), (size_t)file->len, NETCONN_NOCOPY);
-                    fs_close(file);
-                }
-                else if((strncmp(buf, "GET /index.html", 15) == 0) || (strncmp(buf, "GET / ", 6) == 0))
-                {
-                    /* Load index page */
-                    file = fs_open("/index.html");
-                    netconn_write(conn, (const unsigned char*)(file->data), (size_t)file->len, NETCONN_NOCOPY);
-                    fs_close(file);
-                }
-                else
-                {
-                    /* Load Error page */
-                    file = fs_open("/404.html");
-                    netconn_write(conn, (const unsigned char*)(file->data), (size_t)file->len, NETCONN_NOCOPY);
-                    fs_close(file);
-                }
+                copy = LWIP_MIN(len, HTTP_REQ_MAX - w->len);
+                MEMCPY(w->req + w->len, data, copy);
+                w->len += copy;
+                w->req[w->len] = '\0';
+                data += copy;
+                len -= copy;
+
+                keep = http_server_process(conn, w);
             }
         }
+        while(keep && (netbuf_next(inbuf) >= 0));
+
+        /* Delete the buffer (netconn_recv gives us ownership,
+         so we have to make sure to deallocate the buffer) */
+        netbuf_delete(inbuf);
     }
-    /* Close the connection (server closes in HTTP) */
-    netconn_close(conn);
 
-    /* Delete the buffer (netconn_recv gives us ownership,
-     so we have to make sure to deallocate the buffer) */
-    netbuf_delete(inbuf);
+    /* Close the connection */
+    netconn_close(conn);
 }
 
 
 /**
-  * @brief  http server thread
-  * @param arg: pointer on argument(not used here)
+  * @brief  http server worker thread
+  * @param arg: pointer on worker state
   * @retval None
   */
-static void http_server_netconn_thread(void *arg)
+static void http_server_worker_thread(void *arg)
 {
-    struct netconn *conn, *newconn;
-    err_t err;
+    struct http_worker *w = (struct http_worker *)arg;
+    void *msg;
+    struct netconn *newconn;
+    SYS_ARCH_DECL_PROTECT(lev);
 
-    /* Create a new TCP connection handle */
-    conn = netconn_new(NETCONN_TCP);
-
-    if(conn != NULL)
+    while(1)
     {
-        /* Bind to port 80 (HTTP) with default IP address */
-        err = netconn_bind(conn, NULL, 80);
+        sys_arch_mbox_fetch(&s_mbConn, &msg, 0);
+        newconn = (struct netconn *)msg;
 
-        if(err == ERR_OK)
-        {
-            /* Put the connection into LISTEN state */
-            netconn_listen(conn);
+        SYS_ARCH_PROTECT(lev);
+        s_u8Busy++;
+        SYS_ARCH_UNPROTECT(lev);
 
-            while(1)
-            {
-                /* accept any incoming connection */
-                netconn_accept(conn, &newconn);
+        /* serve connection */
+        http_server_serve(newconn, w);
 
-                if(newconn)
-                {
-                    /* serve connection */
-                    http_server_serve(newconn);
+        /* delete connection */
+        netconn_delete(newconn);
 
-                    /* delete connection */
-                    netconn_delete(newconn);
-                }
-            }
-        }
-        else
-        {
-            printf("can not bind netconn");
-        }
+        SYS_ARCH_PROTECT(lev);
+        s_u8Busy--;
+        SYS_ARCH_UNPROTECT(lev);
     }
-    else
+}
+
+/**
+  * @brief  http server accept thread
+  * @param arg: pointer on the listening connection
+  * @retval None
+  */
+static void http_server_netconn_thread(void *arg)
+{
+    struct netconn *conn = (struct netconn *)arg;
+    struct netconn *newconn;
+
+    while(1)
     {
-        printf("can not create netconn");
+        /* Only this thread waits on the listening connection. The mailbox
+           holds HTTP_WORKER_NUM connections; once it is full, further ones
+           wait in the accept queue of conn. */
+        if(netconn_accept(conn, &newconn) == ERR_OK)
+        {
+            sys_mbox_post(&s_mbConn, newconn);
+        }
     }
 }
 
 /**
-  * @brief  Initialize the HTTP server (start its thread)
+  * @brief  Initialize the HTTP server (start its accept and worker threads)
   * @param  none
   * @retval None
   */
 void http_server_netconn_init()
 {
-    sys_thread_new("HTTP", http_server_netconn_thread, NULL, WEBSERVER_THREAD_STACKSIZE, WEBSERVER_THREAD_PRIO);
+    struct netconn *conn;
+    int i;
+
+    /* Create a new TCP connection handle */
+    conn = netconn_new(NETCONN_TCP);
+
+    if(conn == NULL)
+    {
+        printf("can not create netconn");
+        return;
+    }
+
+    /* Bind to port 80 (HTTP) with default IP address */
+    if(netconn_bind(conn, NULL, 80) != ERR_OK)
+    {
+        printf("can not bind netconn");
+        netconn_delete(conn);
+        return;
+    }
+
+    /* Put the connection into LISTEN state */
+    netconn_listen(conn);
+
+    if(sys_mbox_new(&s_mbConn, HTTP_WORKER_NUM) != ERR_OK)
+    {
+        printf("can not create mailbox");
+        netconn_delete(conn);
+        return;
+    }
+
+    for(i = 0; i < HTTP_WORKER_NUM; i++)
+    {
+        sys_thread_new("HTTP", http_server_worker_thread, &s_asWorker[i], WEBSERVER_THREAD_STACKSIZE, WEBSERVER_THREAD_PRIO);
+    }
+    sys_thread_new("HTTP_ACCEPT", http_server_netconn_thread, conn, WEBSERVER_THREAD_STACKSIZE, WEBSERVER_THREAD_PRIO);
 }
@@ -1,6 +1,27 @@
 #ifndef __HTTPSERVER_NETCONN_H__
 #define __HTTPSERVER_NETCONN_H__
 
+/* Number of worker threads, i.e. clients served concurrently */
+#ifndef HTTP_WORKER_NUM
+#define HTTP_WORKER_NUM             4
+#endif
+
+/* Request reassembly buffer per worker, must hold one request header block */
+#ifndef HTTP_REQ_MAX
+#define HTTP_REQ_MAX                768
+#endif
+
+/* Keep-alive idle timeout, and the shorter one used while all workers are busy */
+#ifndef HTTP_KEEPALIVE_MS
+#define HTTP_KEEPALIVE_MS           5000
+#endif
+#ifndef HTTP_KEEPALIVE_BUSY_MS
+#define HTTP_KEEPALIVE_BUSY_MS      200
+#endif
+#ifndef HTTP_KEEPALIVE_POLL_MS
+#define HTTP_KEEPALIVE_POLL_MS      100
+#endif
+
 void http_server_netconn_init(void);
 
 #endif /* __HTTPSERVER_NETCONN_H__ */
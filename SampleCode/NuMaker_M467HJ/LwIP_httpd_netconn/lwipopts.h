@@ -65,21 +65,23 @@
 #define DEFAULT_UDP_RECVMBOX_SIZE       16
 #define DEFAULT_RAW_RECVMBOX_SIZE       16
 
+/* Keep-alive HTTP workers: the listener, one connection per worker and
+   browser connections waiting to be accepted */
+#define LWIP_SO_RCVTIMEO                1
+#define MEMP_NUM_NETCONN                12
+#define MEMP_NUM_TCP_PCB                12
+
 #define MEM_SIZE                        30000
 #define MEMP_NUM_PBUF                   64
 #define PBUF_POOL_SIZE                  32
 
 /* ---------- Checksum options ---------- */
+#ifndef LWIP_USING_HW_CHECKSUM
 #define LWIP_USING_HW_CHECKSUM          0
+#endif
 #if (LWIP_USING_HW_CHECKSUM == 1)
-#define CHECKSUM_GEN_IP                 0
-#define CHECKSUM_GEN_UDP                0
-#define CHECKSUM_GEN_TCP                0
-#define CHECKSUM_GEN_ICMP               0
-#define CHECKSUM_CHECK_IP               0
-#define CHECKSUM_CHECK_UDP              0
-#define CHECKSUM_CHECK_TCP              0
-#define CHECKSUM_CHECK_ICMP             0
+/* GMAC checksum offload engine takes over per interface, see low_level_init() */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
 #endif
 
 #endif /* __LWIPOPTS_H__ */
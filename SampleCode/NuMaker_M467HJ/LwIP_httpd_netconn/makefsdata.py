@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+#
+# Generate fsdata.c for the LwIP_httpd_netconn sample.
+#
+# usage: python makefsdata.py [-d fs] [-o fsdata.c] [--mss 1460] [--no-gzip]
+#
+# Every file below the web root becomes a struct fsdata_file with its HTTP
+# header included. In addition to the original FS_ROOT list this emits
+#  - a gzip variant (Content-Encoding: gzip) of each compressible file whose
+#    compressed size is smaller, selected by fs_open_gzip(),
+#  - a perfect-hash index (FS_HASH_BUCKETS, fs_hash_disp[], fs_hash_table[])
+#    looked up by fs_open() with a single string compare,
+#  - per-MSS checksum tables under HTTPD_PRECALCULATED_CHECKSUM.
+#
+# The hash must stay identical to fs_hash() in fs.c (FNV-1a, seeded).
+#
+import argparse
+import gzip
+import os
+import re
+import struct
+import sys
+
+SERVER = "Server: lwIP/1.3.1 (http://savannah.nongnu.org/projects/lwip)"
+
+MIME = {
+    ".html": "text/html", ".htm": "text/html", ".shtml": "text/html",
+    ".css": "text/css", ".js": "application/javascript",
+    ".json": "application/json", ".xml": "text/xml", ".txt": "text/plain",
+    ".svg": "image/svg+xml", ".ico": "image/x-icon",
+    ".gif": "image/gif", ".png": "image/png", ".jpg": "image/jpeg",
+    ".jpeg": "image/jpeg", ".bmp": "image/bmp", ".class": "application/octet-stream",
+}
+
+COMPRESSIBLE = (".html", ".htm", ".shtml", ".css", ".js", ".json", ".xml",
+                ".txt", ".svg", ".ico")
+
+
+def fs_hash(name, seed):
+    h = (0x811C9DC5 ^ seed) & 0xFFFFFFFF
+    for c in name:
+        h ^= c
+        h = (h * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+def build_index(names):
+    """Hash-and-displace: returns (bucket count, displacements, slot per name)."""
+    n = len(names)
+    nbuckets = max(1, (n + 3) // 4)
+    buckets = [[] for _ in range(nbuckets)]
+    for i, name in enumerate(names):
+        buckets[fs_hash(name, 0) % nbuckets].append(i)
+
+    disp = [0] * nbuckets
+    slot_of = [None] * n
+    used = [False] * n
+    for b in sorted(range(nbuckets), key=lambda x: -len(buckets[x])):
+        if not buckets[b]:
+            continue
+        for d in range(1, 0x10000):
+            slots = [fs_hash(names[i], d) % n for i in buckets[b]]
+            if len(set(slots)) == len(slots) and not any(used[s] for s in slots):
+                break
+        else:
+            sys.exit("makefsdata: no perfect hash found")
+        disp[b] = d
+        for i, s in zip(buckets[b], slots):
+            slot_of[i] = s
+            used[s] = True
+    return nbuckets, disp, slot_of
+
+
+def chksum(data):
+    """~inet_chksum() of a little-endian target, as lwIP makefsdata emits it."""
+    if len(data) & 1:
+        data += b"\0"
+    acc = sum(struct.unpack("<%dH" % (len(data) // 2), data))
+    while acc >> 16:
+        acc = (acc & 0xFFFF) + (acc >> 16)
+    return acc
+
+
+def http_header(path, length, encoding, vary):
+    ext = os.path.splitext(path)[1].lower()
+    if os.path.basename(path).startswith("404"):
+        lines = ["HTTP/1.1 404 File not found"]
+    else:
+        lines = ["HTTP/1.1 200 OK"]
+    lines.append(SERVER)
+    lines.append("Content-Length: %d" % length)
+    if encoding:
+        lines.append("Content-Encoding: %s" % encoding)
+    if vary:
+        lines.append("Vary: Accept-Encoding")
+    lines.append("Content-type: %s" % MIME.get(ext, "text/plain"))
+    return [l + "\r\n" for l in lines[:-1]] + [lines[-1] + "\r\n\r\n"]
+
+
+def c_bytes(data):
+    out = []
+    for i in range(0, len(data), 16):
+        out.append(",".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return out
+
+
+def c_comment(s):
+    return s.replace("\r", "\\r").replace("\n", "\\n").replace("*/", "*\\/")
+
+
+class Entry:
+    def __init__(self, path, body, encoding, vary):
+        self.path = path
+        self.var = re.sub(r"[^A-Za-z0-9]", "_", path.lstrip("/"))
+        if encoding:
+            self.var += "_gz"
+        self.body = body
+        self.header = http_header(path, len(body), encoding, vary)
+
+    def emit_data(self, out):
+        name = self.path.encode() + b"\0"
+        self.name_len = (len(name) + 3) & ~3
+        name = name.ljust(self.name_len, b"\0")
+        hdr = "".join(self.header).encode()
+        self.hdr_len = len(hdr)
+
+        out.append("static const unsigned char data_%s[] =" % self.var)
+        out.append("{")
+        out.append("/* %s (%d chars) */" % (self.path, self.name_len))
+        out += c_bytes(name)
+        out.append("")
+        out.append("/* HTTP header */")
+        for line in self.header:
+            out.append('/* "%s" (%d bytes) */' % (c_comment(line), len(line)))
+            out += c_bytes(line.encode())
+        out.append("/* raw file data (%d bytes) */" % len(self.body))
+        out += c_bytes(self.body)
+        out[-1] = out[-1].rstrip(",")
+        out.append("};")
+        out.append("")
+
+    def emit_chksum(self, out, mss):
+        data = "".join(self.header).encode() + self.body
+        table = [(0, chksum(data[:self.hdr_len]), self.hdr_len)]
+        for off in range(self.hdr_len, len(data), mss):
+            chunk = data[off:off + mss]
+            table.append((off, chksum(chunk), len(chunk)))
+        self.chksum_count = len(table)
+        out.append("static const struct fsdata_chksum chksums_%s[] =" % self.var)
+        out.append("{")
+        out += ["{%d, 0x%04x, %d}," % t for t in table]
+        out.append("};")
+        out.append("")
+
+    def emit_file(self, out, next_var):
+        out.append("const struct fsdata_file file_%s[] = {{%s, data_%s, data_%s + %d, sizeof(data_%s) - %d, 1,"
+                   % (self.var, next_var, self.var, self.var, self.name_len, self.var, self.name_len))
+        out.append("#if HTTPD_PRECALCULATED_CHECKSUM")
+        out.append("%d, chksums_%s," % (self.chksum_count, self.var))
+        out.append("#endif /* HTTPD_PRECALCULATED_CHECKSUM */")
+        out.append("}};")
+        out.append("")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Generate fsdata.c")
+    ap.add_argument("-d", "--dir", default="fs", help="web root (default: fs)")
+    ap.add_argument("-o", "--output", default="fsdata.c")
+    ap.add_argument("--mss", type=int, default=1460,
+                    help="checksum chunk size, TCP_MSS of the target")
+    ap.add_argument("--no-gzip", action="store_true")
+    args = ap.parse_args()
+
+    paths = []
+    for root, dirs, files in os.walk(args.dir):
+        dirs.sort()
+        for f in sorted(files):
+            full = os.path.join(root, f)
+            paths.append("/" + os.path.relpath(full, args.dir).replace(os.sep, "/"))
+    paths.sort()
+    if not paths:
+        sys.exit("makefsdata: no files in %s" % args.dir)
+
+    plain, packed = [], []
+    wire_plain = wire_best = 0
+    for path in paths:
+        with open(os.path.join(args.dir, path.lstrip("/")), "rb") as fp:
+            body = fp.read()
+        gz = None
+        if not args.no_gzip and path.lower().endswith(COMPRESSIBLE):
+            data = gzip.compress(body, 9, mtime=0)
+            if len(data) < len(body):
+                gz = Entry(path, data, "gzip", True)
+        plain.append(Entry(path, body, None, gz is not None))
+        packed.append(gz)
+        wire_plain += len(body)
+        wire_best += len(gz.body) if gz else len(body)
+
+    out = ["/* Generated by makefsdata.py from %s/, do not edit. */" % os.path.basename(os.path.normpath(args.dir)), ""]
+    entries = plain + [e for e in packed if e]
+    for e in entries:
+        e.emit_data(out)
+
+    out.append("#if HTTPD_PRECALCULATED_CHECKSUM")
+    out.append("")
+    for e in entries:
+        e.emit_chksum(out, args.mss)
+    out.append("#endif /* HTTPD_PRECALCULATED_CHECKSUM */")
+    out.append("")
+
+    for e in packed:
+        if e:
+            e.emit_file(out, "NULL")
+
+    next_var = "NULL"
+    for e in plain:
+        e.emit_file(out, next_var)
+        next_var = "file_" + e.var
+
+    out.append("#define FS_ROOT %s" % next_var)
+    out.append("")
+    out.append("#define FS_NUMFILES %d" % len(plain))
+    out.append("")
+
+    nbuckets, disp, slot_of = build_index([p.encode() for p in paths])
+    table = [None] * len(plain)
+    for i, s in enumerate(slot_of):
+        table[s] = i
+    out.append("/* Perfect hash index, see fs_hash() in fs.c */")
+    out.append("#define FS_HASH_BUCKETS %d" % nbuckets)
+    out.append("")
+    out.append("static const u16_t fs_hash_disp[FS_HASH_BUCKETS] = {%s};"
+               % ", ".join(str(d) for d in disp))
+    out.append("")
+    out.append("static const struct fsdata_index fs_hash_table[FS_NUMFILES] =")
+    out.append("{")
+    for i in table:
+        out.append("    {file_%s, %s}," % (plain[i].var,
+                                           "file_" + packed[i].var if packed[i] else "NULL"))
+    out.append("};")
+
+    with open(args.output, "w", newline="\n") as fp:
+        fp.write("\n".join(out) + "\n")
+
+    print("%d files, %d gzip variants, payload %d bytes plain / %d bytes with gzip"
+          % (len(plain), sum(1 for e in packed if e), wire_plain, wire_best))
+
+
+if __name__ == "__main__":
+    main()
@@ -70,16 +70,12 @@
 #define PBUF_POOL_SIZE                  32
 
 /* ---------- Checksum options ---------- */
+#ifndef LWIP_USING_HW_CHECKSUM
 #define LWIP_USING_HW_CHECKSUM          0
+#endif
 #if (LWIP_USING_HW_CHECKSUM == 1)
-#define CHECKSUM_GEN_IP                 0
-#define CHECKSUM_GEN_UDP                0
-#define CHECKSUM_GEN_TCP                0
-#define CHECKSUM_GEN_ICMP               0
-#define CHECKSUM_CHECK_IP               0
-#define CHECKSUM_CHECK_UDP              0
-#define CHECKSUM_CHECK_TCP              0
-#define CHECKSUM_CHECK_ICMP             0
+/* GMAC checksum offload engine takes over per interface, see low_level_init() */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
 #endif
 
 #endif /* __LWIPOPTS_H__ */
@@ -8,6 +8,9 @@
 #include "lwip/opt.h"
 #include "lwip/arch.h"
 #include "lwip/api.h"
+#include "lwip/sys.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include "string.h"
 #include "tftp.h"
 
@@ -15,21 +18,64 @@
 #define TFTP_THREAD_PRIO    ( tskIDLE_PRIORITY + 2UL )
 #define TFTP_THREAD_STACKSIZE  200
 
+/* Options requested from the server, 0 to omit */
+#ifndef TFTP_REQ_BLKSIZE
+#define TFTP_REQ_BLKSIZE        TFTP_MAX_BLKSIZE
+#endif
+#ifndef TFTP_REQ_WINDOWSIZE
+#define TFTP_REQ_WINDOWSIZE     TFTP_MAX_WINDOWSIZE
+#endif
+
 #ifndef MIN
-#define MIN(a, b)   (a) < (b) ? (a) : (b)
+#define MIN(a, b)   ((a) < (b) ? (a) : (b))
 #endif
 
 static struct netconn *conn;
 static unsigned short server_port = TFTP_PORT;
 static ip_addr_t server_addr;
 
-#define FILE_LEN        2048
-static uint32_t flen = FILE_LEN;
-static uint8_t file[FILE_LEN];
+static uint32_t flen = TFTP_FILE_LEN;
 
 char *file_name = "test.txt";   // File name to put or get
 char *tftp_mode = "octet";      // Could be "octet", "netascii", or "mail"
 
+/* Transfer parameters, from the server's OACK or the RFC 1350 defaults */
+static uint16_t blksize = TFTP_BLOCK_LENGTH;
+static uint16_t windowsize = 1;
+
+/* Put: blocks tx_base..tx_next-1 are in flight, tx_last is the final (short) block */
+static uint32_t tx_base, tx_next, tx_last;
+static uint32_t tx_restart;     // window already restarted on a repeated ACK of tx_base - 1
+
+/* Get: last in-order block, blocks since the last ACK, gap already reported */
+static uint32_t rx_blk;
+static uint16_t rx_count;
+static uint8_t rx_gap;
+static uint32_t rx_ack_time;    // when the last ACK was sent
+static uint32_t rx_errors;
+
+static uint32_t start_time;
+
+
+/* The test file content is its offset modulo 256 */
+static void file_read(uint32_t offset, uint8_t *buf, uint16_t len)
+{
+    while(len--)
+        *buf++ = (uint8_t)offset++;
+}
+
+static uint32_t file_verify(uint32_t offset, const uint8_t *buf, uint16_t len)
+{
+    uint32_t errors = 0;
+
+    while(len--)
+    {
+        if(*buf++ != (uint8_t)offset++)
+            errors++;
+    }
+    return errors;
+}
+
 void send_ack(uint16_t blk)
 {
     struct netbuf *nbuf;
@@ -44,6 +90,7 @@ void send_ack(uint16_t blk)
     }
     *(uint16_t *)data = lwip_htons(TFTP_OPCODE_ACK);
     *(uint16_t *)(data + 2) = lwip_htons(blk);
+    rx_ack_time = sys_now();
 
     /* Send the packet */
     netconn_sendto(conn, nbuf, &server_addr, server_port);
@@ -52,7 +99,7 @@ void send_ack(uint16_t blk)
     netbuf_delete(nbuf);
 }
 
-void send_data(uint16_t blk, uint8_t *buf, uint16_t len)
+void send_data(uint16_t blk, uint32_t offset, uint16_t len)
 {
     struct netbuf *nbuf;
     char *data;
@@ -66,7 +113,7 @@ void send_data(uint16_t blk, uint8_t *buf, uint16_t len)
     }
     *(uint16_t *)data = lwip_htons(TFTP_OPCODE_DATA);
     *(uint16_t *)(data + 2) = lwip_htons(blk);
-    memcpy(data + 4, (void *)buf, len);
+    file_read(offset, (uint8_t *)data + 4, len);
     /* Send the packet */
     netconn_sendto(conn, nbuf, &server_addr, server_port);
 
@@ -99,21 +146,36 @@ void send_err(uint16_t err)
     netbuf_delete(nbuf);
 }
 
-void send_rrq(void)
+void send_request(uint16_t op)
 {
     struct netbuf *nbuf;
+    char opt[40];
     char *data;
+    int len = 0;
+
+    /* RFC 2347 options: "blksize\0<n>\0windowsize\0<n>\0" */
+#if TFTP_REQ_BLKSIZE
+    len += sprintf(opt + len, "blksize") + 1;
+    len += sprintf(opt + len, "%u", TFTP_REQ_BLKSIZE) + 1;
+#endif
+#if TFTP_REQ_WINDOWSIZE
+    len += sprintf(opt + len, "windowsize") + 1;
+    len += sprintf(opt + len, "%u", TFTP_REQ_WINDOWSIZE) + 1;
+#endif
+
     /* Prepare data */
     if((nbuf = netbuf_new()) == NULL)
         return;
-    if((data = netbuf_alloc(nbuf, 2 + strlen(file_name) + strlen(tftp_mode) + 2)) == NULL)       // op 2, two string and two terminators
+    if((data = netbuf_alloc(nbuf, 2 + strlen(file_name) + strlen(tftp_mode) + 2 + len)) == NULL)     // op 2, two string and two terminators, options
     {
         netbuf_delete(nbuf);
         return;
     }
-    *(uint16_t *)data = lwip_htons(TFTP_OPCODE_RRQ);
+    *(uint16_t *)data = lwip_htons(op);
     strcpy(data + 2, file_name);
     strcpy(data + 2 + strlen(file_name) + 1, tftp_mode);
+    memcpy(data + 2 + strlen(file_name) + strlen(tftp_mode) + 2, opt, len);
+
     /* Send the packet */
     netconn_sendto(conn, nbuf, &server_addr, server_port);
 
@@ -121,27 +183,100 @@ void send_rrq(void)
     netbuf_delete(nbuf);
 }
 
+void send_rrq(void)
+{
+    send_request(TFTP_OPCODE_RRQ);
+}
+
 void send_wrq(void)
 {
-    struct netbuf *nbuf;
-    char *data;
-    /* Prepare data */
-    if((nbuf = netbuf_new()) == NULL)
-        return;
-    if((data = netbuf_alloc(nbuf, 2 + strlen(file_name) + strlen(tftp_mode) + 2)) == NULL)       // op 2, two string and two terminators
+    send_request(TFTP_OPCODE_WRQ);
+}
+
+/* Return the string following the one at p, or NULL at the end of the packet */
+static char *next_str(char *p, char *end)
+{
+    while((p < end) && *p)
+        p++;
+    return (p < end) ? p + 1 : NULL;
+}
+
+/**
+  * @brief Apply the options acknowledged by the server
+  * @param payload OACK packet
+  * @param len OACK length
+  * @retval 0 on success, -1 if the server answered with an option or value we did not ask for
+  */
+static int parse_oack(uint8_t *payload, uint16_t len)
+{
+    char *p = (char *)payload + 2;
+    char *end = (char *)payload + len;
+    char *name, *val;
+    unsigned long v;
+
+    blksize = TFTP_BLOCK_LENGTH;
+    windowsize = 1;
+
+    while(p < end)
     {
-        netbuf_delete(nbuf);
-        return;
+        name = p;
+        if((val = next_str(name, end)) == NULL)
+            return -1;
+        if((p = next_str(val, end)) == NULL)
+            return -1;
+        v = strtoul(val, NULL, 10);
+
+        if(!lwip_stricmp(name, "blksize") && TFTP_REQ_BLKSIZE &&
+                (v >= TFTP_MIN_BLKSIZE) && (v <= TFTP_REQ_BLKSIZE))
+            blksize = (uint16_t)v;
+        else if(!lwip_stricmp(name, "windowsize") && TFTP_REQ_WINDOWSIZE &&
+                (v >= 1) && (v <= TFTP_REQ_WINDOWSIZE))
+            windowsize = (uint16_t)v;
+        else
+            return -1;
     }
-    *(uint16_t *)data = lwip_htons(TFTP_OPCODE_WRQ);
-    strcpy(data + 2, file_name);
-    strcpy(data + 2 + strlen(file_name) + 1, tftp_mode);
+    return 0;
+}
 
-    /* Send the packet */
-    netconn_sendto(conn, nbuf, &server_addr, server_port);
+/* Send the blocks of the current window that are not in flight yet */
+static void send_window(void)
+{
+    uint32_t offset;
 
-    /* Free the buffer */
-    netbuf_delete(nbuf);
+    while((tx_next < tx_base + windowsize) && (tx_next <= tx_last))
+    {
+        offset = (tx_next - 1) * blksize;
+        send_data((uint16_t)tx_next, offset, MIN(flen - offset, blksize));
+        tx_next++;
+    }
+}
+
+/* First answer to a put request: start sending the file */
+static void start_put(void)
+{
+    tx_base = tx_next = 1;
+    tx_restart = 0;
+    tx_last = flen / blksize + 1;
+    send_window();
+}
+
+/* First answer to a get request: reset the receive window */
+static void start_get(void)
+{
+    rx_blk = 0;
+    rx_count = 0;
+    rx_gap = 0;
+    rx_errors = 0;
+}
+
+static void print_done(uint32_t bytes)
+{
+    uint32_t ms = sys_now() - start_time;
+
+    printf("\nDone, %u bytes in %u ms (blksize %u, windowsize %u)\n",
+           (unsigned int)bytes, (unsigned int)ms, blksize, windowsize);
+    if(ms)
+        printf("%u kbit/s\n", (unsigned int)(bytes * 8 / ms));
 }
 
 /**
@@ -153,52 +288,67 @@ static void tftp_thread(void *arg)
 {
     err_t err;
     struct netbuf *nbuf;
-    uint8_t *data, *payload;
+    uint8_t *payload;
     ip_addr_t *get_addr;
     unsigned short get_port;
     uint16_t payload_len;
 
     uint16_t state = TFTP_STATE_IDLE;
-    uint16_t op, blk = 0;
-    int retry, remain;
+    uint16_t op;
+    int retry = 0;
     char c = 0;
-    int done = 0;
+    int done = 1;   // set 1 to prompt for the next transfer
     int first = 1;  // set 1 for resend first wrq/rrq request on timeout, otherwise resend ack/data
 
 
     /* Configure tftp server IP address */
     IP4_ADDR(&server_addr, 192, 168, 1, 2);
 
-    /* Create a new UDP connection handle */
-    conn = netconn_new(NETCONN_UDP);
-    if(conn == NULL)
-    {
-        printf("netconn_new() failed\n");
-        while(1);
-    }
-
-    printf("Select your option 1)get, 2)put\n");
     while(1)
     {
-        c = getchar();
-        if(c == '1' || c == '2')
-            break;
-    }
-    if(c == '1')
-    {
-        printf("You select get file from server\n");
-        state = TFTP_STATE_RRQ;
-        send_rrq();
-    }
-    else
-    {
-        printf("You select put file to server\n");
-        state = TFTP_STATE_WRQ;
-        send_wrq();
-    }
+        if(done)
+        {
+            printf("Select your option 1)get, 2)put\n");
+            while(1)
+            {
+                c = getchar();
+                if(c == '1' || c == '2')
+                    break;
+            }
+            /* Each transfer gets a new connection and local port, late
+               packets of the previous one must not be taken for its answer */
+            if(conn != NULL)
+                netconn_delete(conn);
+            conn = netconn_new(NETCONN_UDP);
+            if(conn == NULL)
+            {
+                printf("netconn_new() failed\n");
+                while(1);
+            }
+
+            /* Set Rx timeout */
+            netconn_set_recvtimeout(conn, TFTP_TIMEOUT);
+
+            /* A new transfer starts at the server's well-known port */
+            server_port = TFTP_PORT;
+            first = 1;
+            done = 0;
+            retry = 0;
+            start_time = sys_now();
+            if(c == '1')
+            {
+                printf("You select get file from server\n");
+                state = TFTP_STATE_RRQ;
+                send_rrq();
+            }
+            else
+            {
+                printf("You select put file to server\n");
+                state = TFTP_STATE_WRQ;
+                send_wrq();
+            }
+        }
 
-    while(!done)
-    {
         err = netconn_recv(conn, &nbuf);
         if(err == ERR_TIMEOUT)
         {
@@ -223,8 +373,10 @@ static void tftp_thread(void *arg)
                 }
                 else
                 {
-                    printf("Timeout, resend data %d\n", retry);
-                    send_data(blk, (void *)data, MIN(remain, TFTP_BLOCK_LENGTH));
+                    printf("Timeout, resend ack %d\n", retry);
+                    send_ack((uint16_t)rx_blk);
+                    rx_count = 0;
+                    rx_gap = 0;
                 }
                 continue;
             }
@@ -237,8 +389,10 @@ static void tftp_thread(void *arg)
                 }
                 else
                 {
-                    printf("Timeout, resend ack %d\n", retry);
-                    send_ack(blk);
+                    /* Go back to the first unacknowledged block */
+                    printf("Timeout, resend data %d\n", retry);
+                    tx_next = tx_base;
+                    send_window();
                 }
                 continue;
             }
@@ -256,8 +410,7 @@ static void tftp_thread(void *arg)
         /* Get the payload and length */
         netbuf_data(nbuf, (void**)&payload, &payload_len);
 
-        op = lwip_ntohs(*(uint16_t *)payload);
-        if(memcmp(get_addr, &server_addr, sizeof(ip_addr_t)))
+        if((payload_len < 2) || memcmp(get_addr, &server_addr, sizeof(ip_addr_t)))
         {
             // Ignore everything not coming from server.
             // Server may select other port to complete the service, so check address only
@@ -265,10 +418,42 @@ static void tftp_thread(void *arg)
             continue;
         }
 
+        op = lwip_ntohs(*(uint16_t *)payload);
+
         switch(op)
         {
+            case TFTP_OPCODE_OACK:
+                if(!first)
+                {
+                    /* Duplicate OACK, our first ACK or DATA got lost */
+                    if(state == TFTP_STATE_RRQ)
+                        send_ack(0);
+                    break;
+                }
+                // Server may select other port to complete the service
+                server_port = get_port;
+                first = 0;
+                if(parse_oack(payload, payload_len) < 0)
+                {
+                    printf("Bad OACK\n");
+                    send_err(TFTP_ERROR_OPTION);
+                    state = TFTP_STATE_IDLE;
+                    done = 1;
+                }
+                else if(state == TFTP_STATE_RRQ)
+                {
+                    /* Acknowledge the options with block 0 */
+                    start_get();
+                    send_ack(0);
+                }
+                else
+                {
+                    start_put();
+                }
+                break;
+
             case TFTP_OPCODE_DATA:
-                if(state != TFTP_STATE_RRQ)
+                if((state != TFTP_STATE_RRQ) || (payload_len < 4))
                 {
                     send_err(TFTP_ERROR_ILLEGAL_OPERATION);
                     state = TFTP_STATE_IDLE;
@@ -277,54 +462,66 @@ static void tftp_thread(void *arg)
                 else
                 {
                     uint16_t new_blk = lwip_ntohs(*(uint16_t *)(payload + 2));
+                    uint16_t len = payload_len - 4;
 
-                    if(new_blk == blk)
+                    if(first)
                     {
-                        /* Last ACK lost */
-                        send_ack(blk);
+                        /* Server ignored the options, RFC 1350 lock-step transfer */
+                        server_port = get_port;
+                        first = 0;
+                        blksize = TFTP_BLOCK_LENGTH;
+                        windowsize = 1;
+                        start_get();
                     }
-                    else if(new_blk == blk + 1)
+
+                    if(new_blk == (uint16_t)(rx_blk + 1))
                     {
-                        int i;
-                        uint8_t *c = payload + 4;
+                        rx_gap = 0;
+                        rx_errors += file_verify(rx_blk * blksize, payload + 4, len);
+                        rx_blk++;
 
-                        if(first)
+                        if(len < blksize)
                         {
-                            // Server may select other port to complete the service
-                            server_port = get_port;
-                            first = 0;
+                            /* This is the last data packet, all done */
+                            send_ack((uint16_t)rx_blk);
+                            print_done(rx_blk * blksize - blksize + len);
+                            if(rx_errors)
+                                printf("%u bytes differ from the test pattern\n", (unsigned int)rx_errors);
+                            done = 1;
+                            state = TFTP_STATE_IDLE;
                         }
-                        // Dump received data */
-                        for(i = 0; i < payload_len - 4; i++)
+                        else if(++rx_count >= windowsize)
                         {
-                            if((i & 0xF) == 0)
-                                printf("\n");
-                            printf("%02x ", *c++);
+                            /* End of window */
+                            send_ack((uint16_t)rx_blk);
+                            rx_count = 0;
                         }
-
-                        blk = new_blk;
-                        send_ack(blk);
-                        if(payload_len < TFTP_BLOCK_LENGTH + 4)
+                    }
+                    else if((uint16_t)(new_blk - (uint16_t)rx_blk - 1) < 0x8000)
+                    {
+                        /* A block of this window was lost. Acknowledge the
+                           last in-order block once, the server restarts after it. */
+                        if(!rx_gap)
                         {
-                            /* This is the last data packet, all done */
-                            printf("Done\n");
-                            done = 1;
-                            state = TFTP_STATE_IDLE;
+                            send_ack((uint16_t)rx_blk);
+                            rx_count = 0;
+                            rx_gap = 1;
                         }
                     }
-                    else
+                    else if((sys_now() - rx_ack_time) >= TFTP_TIMEOUT / 2)
                     {
-                        /* Wrong ack # */
-                        printf("Unknown ID number\n");
-                        send_err(TFTP_ERROR_UNKNOWN_ID);
-                        state = TFTP_STATE_IDLE;
-                        done = 1;
+                        /* An old block: our last ACK was lost and the server
+                           went back on timeout. Blocks that were already on
+                           their way when we acknowledged are ignored, repeating
+                           the ACK for them would restart the window again. */
+                        send_ack((uint16_t)rx_blk);
+                        rx_count = 0;
                     }
                 }
                 break;
 
             case TFTP_OPCODE_ACK:
-                if(state != TFTP_STATE_WRQ)
+                if((state != TFTP_STATE_WRQ) || (payload_len < 4))
                 {
                     send_err(TFTP_ERROR_ILLEGAL_OPERATION);
                     state = TFTP_STATE_IDLE;
@@ -333,6 +530,7 @@ static void tftp_thread(void *arg)
                 else
                 {
                     uint16_t new_blk = lwip_ntohs(*(uint16_t *)(payload + 2));
+                    uint16_t acked;
 
                     if(first)
                     {
@@ -346,48 +544,48 @@ static void tftp_thread(void *arg)
                         }
                         else
                         {
-                            // Server may select other port to complete the service
+                            /* Server ignored the options, RFC 1350 lock-step transfer */
                             server_port = get_port;
-                            remain = flen;
-                            data = file;
-                            blk++;
-                            new_blk++; // add to avoid enter " if(new_blk == (blk - 1)) "
-                            printf(".");
                             first = 0;
-                            send_data(blk, data, MIN(remain, TFTP_BLOCK_LENGTH));
+                            blksize = TFTP_BLOCK_LENGTH;
+                            windowsize = 1;
+                            start_put();
                         }
+                        break;
                     }
-                    if(new_blk == (blk - 1))
+
+                    /* Blocks newly acknowledged by this ACK */
+                    acked = (uint16_t)(new_blk - (uint16_t)(tx_base - 1));
+                    if(acked == 0)
                     {
-                        /* Last packet was lost */
-                        send_data(blk, data, MIN(remain, TFTP_BLOCK_LENGTH));
+                        /* The server lost a block of the window */
+                        if(tx_restart != tx_base)
+                        {
+                            /* Once per window, more copies of this ACK come
+                               from blocks that were already on their way */
+                            tx_restart = tx_base;
+                            tx_next = tx_base;
+                            send_window();
+                        }
                     }
-                    else if(new_blk == blk)
+                    else if(acked <= tx_next - tx_base)
                     {
-                        remain -= TFTP_BLOCK_LENGTH;
-                        if(remain < 0)  /* Still need to send a 0 data packet if remain is 0 */
+                        tx_base += acked;
+                        if(tx_base > tx_last)
                         {
                             /* All done */
-                            printf("\nDone\n");
+                            print_done(flen);
                             done = 1;
                             state = TFTP_STATE_IDLE;
                         }
                         else
                         {
-                            blk++;
-                            data += TFTP_BLOCK_LENGTH;
-                            printf(".");
-                            send_data(blk, data, MIN(remain, TFTP_BLOCK_LENGTH));
+                            /* RFC 7440: the next window starts after the acknowledged block */
+                            tx_next = tx_base;
+                            send_window();
                         }
                     }
-                    else
-                    {
-                        /* Wrong ack # */
-                        printf("Unknown ID number\n");
-                        send_err(TFTP_ERROR_UNKNOWN_ID);
-                        state = TFTP_STATE_IDLE;
-                        done = 1;
-                    }
+                    /* Otherwise a stale ACK of an earlier window, ignore it */
                 }
                 break;
             case TFTP_OPCODE_ERROR:
@@ -407,7 +605,6 @@ static void tftp_thread(void *arg)
 
         netbuf_delete(nbuf);
     }
-    while(1);
 }
 
 /**
@@ -417,9 +614,5 @@ static void tftp_thread(void *arg)
   */
 void tftp_client_init(void)
 {
-    int i;
-
-    for(i = 0; i < FILE_LEN; i++)
-        file[i] = i & 0xFF;
     sys_thread_new("TFTP", tftp_thread, NULL, TFTP_THREAD_STACKSIZE, TFTP_THREAD_PRIO);
 }
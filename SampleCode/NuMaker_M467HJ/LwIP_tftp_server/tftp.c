@@ -8,6 +8,9 @@
 #include "lwip/opt.h"
 #include "lwip/arch.h"
 #include "lwip/api.h"
+#include "lwip/sys.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include "string.h"
 #include "tftp.h"
 
@@ -16,17 +19,57 @@
 #define TFTP_THREAD_STACKSIZE  200
 
 #ifndef MIN
-#define MIN(a, b)   (a) < (b) ? (a) : (b)
+#define MIN(a, b)   ((a) < (b) ? (a) : (b))
 #endif
 
+/* Options accepted in a request */
+#define TFTP_OPT_BLKSIZE        0x01
+#define TFTP_OPT_WINDOWSIZE     0x02
+
 static struct netconn *conn;
 static unsigned short client_port;
 static ip_addr_t client_addr;
 
-#define FILE_LEN        2048
-static uint32_t flen = FILE_LEN;
-static uint8_t file[FILE_LEN];
+static uint32_t flen = TFTP_FILE_LEN;
+
+/* Transfer parameters, negotiated per request */
+static uint16_t blksize = TFTP_BLOCK_LENGTH;
+static uint16_t windowsize = 1;
+static uint8_t opts;
+static uint8_t oack;        // OACK sent, not yet answered by the client
+
+/* RRQ: blocks tx_base..tx_next-1 are in flight, tx_last is the final (short) block */
+static uint32_t tx_base, tx_next, tx_last;
+static uint32_t tx_restart;     // window already restarted on a repeated ACK of tx_base - 1
+
+/* WRQ: last in-order block, blocks since the last ACK, gap already reported */
+static uint32_t rx_blk;
+static uint16_t rx_count;
+static uint8_t rx_gap;
+static uint32_t rx_ack_time;    // when the last ACK was sent
+static uint32_t rx_errors;
+
+static uint32_t start_time;
+
 
+/* The test file content is its offset modulo 256 */
+static void file_read(uint32_t offset, uint8_t *buf, uint16_t len)
+{
+    while(len--)
+        *buf++ = (uint8_t)offset++;
+}
+
+static uint32_t file_verify(uint32_t offset, const uint8_t *buf, uint16_t len)
+{
+    uint32_t errors = 0;
+
+    while(len--)
+    {
+        if(*buf++ != (uint8_t)offset++)
+            errors++;
+    }
+    return errors;
+}
 
 void send_ack(uint16_t blk)
 {
@@ -43,6 +86,7 @@ void send_ack(uint16_t blk)
     }
     *(uint16_t *)data = lwip_htons(op);
     *(uint16_t *)(data + 2) = lwip_htons(blk);
+    rx_ack_time = sys_now();
 
     /* Send the packet */
     netconn_sendto(conn, nbuf, &client_addr, client_port);
@@ -51,7 +95,7 @@ void send_ack(uint16_t blk)
     netbuf_delete(nbuf);
 }
 
-void send_data(uint16_t blk, uint8_t *buf, uint16_t len)
+void send_data(uint16_t blk, uint32_t offset, uint16_t len)
 {
     struct netbuf *nbuf;
     char *data;
@@ -65,7 +109,7 @@ void send_data(uint16_t blk, uint8_t *buf, uint16_t len)
     }
     *(uint16_t *)data = lwip_htons(TFTP_OPCODE_DATA);
     *(uint16_t *)(data + 2) = lwip_htons(blk);
-    memcpy(data + 4, (void *)buf, len);
+    file_read(offset, (uint8_t *)data + 4, len);
     /* Send the packet */
     netconn_sendto(conn, nbuf, &client_addr, client_port);
 
@@ -98,6 +142,115 @@ void send_err(ip_addr_t *addr, unsigned short port, uint16_t err)
     netbuf_delete(nbuf);
 }
 
+void send_oack(void)
+{
+    struct netbuf *nbuf;
+    char opt[40];
+    char *data;
+    int len = 0;
+
+    /* "blksize\0<n>\0windowsize\0<n>\0", accepted options only */
+    if(opts & TFTP_OPT_BLKSIZE)
+    {
+        len += sprintf(opt + len, "blksize") + 1;
+        len += sprintf(opt + len, "%u", blksize) + 1;
+    }
+    if(opts & TFTP_OPT_WINDOWSIZE)
+    {
+        len += sprintf(opt + len, "windowsize") + 1;
+        len += sprintf(opt + len, "%u", windowsize) + 1;
+    }
+
+    /* Prepare data */
+    if((nbuf = netbuf_new()) == NULL)
+        return;
+    if((data = netbuf_alloc(nbuf, len + 2)) == NULL)    // op 2, options
+    {
+        netbuf_delete(nbuf);
+        return;
+    }
+    *(uint16_t *)data = lwip_htons(TFTP_OPCODE_OACK);
+    memcpy(data + 2, opt, len);
+    /* Send the packet */
+    netconn_sendto(conn, nbuf, &client_addr, client_port);
+
+    /* Free the buffer */
+    netbuf_delete(nbuf);
+}
+
+/* Return the string following the one at p, or NULL at the end of the packet */
+static char *next_str(char *p, char *end)
+{
+    while((p < end) && *p)
+        p++;
+    return (p < end) ? p + 1 : NULL;
+}
+
+/**
+  * @brief Parse RFC 2348 blksize and RFC 7440 windowsize of a RRQ/WRQ
+  * @param payload request packet
+  * @param len request length
+  * @retval None, sets blksize, windowsize and the accepted options in opts
+  */
+static void parse_options(uint8_t *payload, uint16_t len)
+{
+    char *p = (char *)payload + 2;
+    char *end = (char *)payload + len;
+    char *name, *val;
+    unsigned long v;
+
+    blksize = TFTP_BLOCK_LENGTH;
+    windowsize = 1;
+    opts = 0;
+
+    /* Skip file name and mode, this sample does not check them */
+    if((p = next_str(p, end)) == NULL)
+        return;
+    if((p = next_str(p, end)) == NULL)
+        return;
+
+    while(p < end)
+    {
+        name = p;
+        if((val = next_str(name, end)) == NULL)
+            break;
+        if((p = next_str(val, end)) == NULL)
+            break;
+        v = strtoul(val, NULL, 10);
+
+        /* Unknown or out of range options are simply not acknowledged */
+        if(!lwip_stricmp(name, "blksize") && (v >= TFTP_MIN_BLKSIZE))
+        {
+            blksize = MIN(v, TFTP_MAX_BLKSIZE);
+            opts |= TFTP_OPT_BLKSIZE;
+        }
+        else if(!lwip_stricmp(name, "windowsize") && (v >= 1))
+        {
+            windowsize = MIN(v, TFTP_MAX_WINDOWSIZE);
+            opts |= TFTP_OPT_WINDOWSIZE;
+        }
+    }
+}
+
+/* Send the blocks of the current window that are not in flight yet */
+static void send_window(void)
+{
+    uint32_t offset;
+
+    while((tx_next < tx_base + windowsize) && (tx_next <= tx_last))
+    {
+        offset = (tx_next - 1) * blksize;
+        send_data((uint16_t)tx_next, offset, MIN(flen - offset, blksize));
+        tx_next++;
+    }
+}
+
+static void print_done(uint32_t bytes)
+{
+    printf("Done, %u bytes in %u ms (blksize %u, windowsize %u)\n",
+           (unsigned int)bytes, (unsigned int)(sys_now() - start_time), blksize, windowsize);
+}
+
 /**
   * @brief TFTP server thread
   * @param arg pointer on argument(not used here)
@@ -108,14 +261,14 @@ static void tftp_thread(void *arg)
 
     err_t err;
     struct netbuf *nbuf;
-    uint8_t *data, *payload;
+    uint8_t *payload;
     ip_addr_t *get_addr;
     unsigned short get_port;
     uint16_t payload_len;
 
     uint16_t state = TFTP_STATE_IDLE;
-    uint16_t op, blk;
-    int retry, remain;
+    uint16_t op;
+    int retry = 0;
 
 
     /* Create a new UDP connection handle */
@@ -154,18 +307,26 @@ static void tftp_thread(void *arg)
                 continue;
             }
             /* Packet was likely lost */
-            if(state == TFTP_STATE_RRQ)
+            if(oack)
+            {
+                printf("Timeout, resend OACK %d\n", retry);
+                send_oack();
+            }
+            else if(state == TFTP_STATE_RRQ)
             {
+                /* Go back to the first unacknowledged block */
                 printf("Timeout, resend data %d\n", retry);
-                send_data(blk, (void *)data, MIN(remain, TFTP_BLOCK_LENGTH));
-                continue;
+                tx_next = tx_base;
+                send_window();
             }
             else
             {
                 printf("Timeout, resend ack %d\n", retry);
-                send_ack(blk);
-                continue;
+                send_ack((uint16_t)rx_blk);
+                rx_count = 0;
+                rx_gap = 0;
             }
+            continue;
         }
         else if(err != ERR_OK)
         {
@@ -180,6 +341,12 @@ static void tftp_thread(void *arg)
         /* Get the payload and length */
         netbuf_data(nbuf, (void**)&payload, &payload_len);
 
+        if(payload_len < 4)
+        {
+            netbuf_delete(nbuf);
+            continue;
+        }
+
         op = lwip_ntohs(*(uint16_t *)payload);
 
         switch(op)
@@ -191,25 +358,44 @@ static void tftp_thread(void *arg)
                     /* New request comes in, save client's address and port number */
                     memcpy((void *)&client_addr, get_addr, sizeof(ip_addr_t));
                     client_port = get_port;
-                    /* This sample does not check file name and mode */
+                    parse_options(payload, payload_len);
+                    oack = (opts != 0);
+                    start_time = sys_now();
+
                     if(op == TFTP_OPCODE_RRQ)
                     {
                         printf("Received RRQ\n");
-                        blk = 1;
-                        data = file;
-                        remain = flen;
+                        tx_base = tx_next = 1;
+                        tx_restart = 0;
+                        tx_last = flen / blksize + 1;
                         state = TFTP_STATE_RRQ;
-                        send_data(blk, data, MIN(remain, TFTP_BLOCK_LENGTH));
+                        /* With options the client acknowledges the OACK with block 0 first */
+                        if(oack)
+                            send_oack();
+                        else
+                            send_window();
                     }
                     else
                     {
                         printf("Received WRQ\n");
-                        /* ACK for WRQ must be 0 */
-                        blk = 0;
+                        rx_blk = 0;
+                        rx_count = 0;
+                        rx_gap = 0;
+                        rx_errors = 0;
                         state = TFTP_STATE_WRQ;
-                        send_ack(blk);
+                        /* OACK replaces the ACK of block 0 */
+                        if(oack)
+                            send_oack();
+                        else
+                            send_ack(0);
                     }
                 }
+                else if((get_port == client_port) && !memcmp(get_addr, &client_addr, sizeof(ip_addr_t)))
+                {
+                    /* The same request again, our OACK got lost */
+                    if(oack)
+                        send_oack();
+                }
                 else
                 {
                     /* Be patient, one client at a time.  */
@@ -225,39 +411,50 @@ static void tftp_thread(void *arg)
                 else
                 {
                     uint16_t new_blk = lwip_ntohs(*(uint16_t *)(payload + 2));
+                    uint16_t len = payload_len - 4;
 
-                    if(new_blk == blk)
-                    {
-                        /* Last ACK lost */
-                        send_ack(blk);
-                    }
-                    if(new_blk == blk + 1)
+                    if(new_blk == (uint16_t)(rx_blk + 1))
                     {
-                        int i;
-                        uint8_t *c = payload + 4;
-                        // Dump received data */
-                        for(i = 0; i < payload_len - 4; i++)
-                        {
-                            if((i & 0xF) == 0)
-                                printf("\n");
-                            printf("%02x ", *c++);
-                        }
+                        oack = 0;
+                        rx_gap = 0;
+                        rx_errors += file_verify(rx_blk * blksize, payload + 4, len);
+                        rx_blk++;
 
-                        blk = new_blk;
-                        send_ack(blk);
-                        if(payload_len < TFTP_BLOCK_LENGTH + 4)
+                        if(len < blksize)
                         {
                             /* This is the last data packet, all done */
-                            printf("Done\n");
+                            send_ack((uint16_t)rx_blk);
+                            print_done(rx_blk * blksize - blksize + len);
+                            if(rx_errors)
+                                printf("%u bytes differ from the test pattern\n", (unsigned int)rx_errors);
                             state = TFTP_STATE_IDLE;
                         }
+                        else if(++rx_count >= windowsize)
+                        {
+                            /* End of window */
+                            send_ack((uint16_t)rx_blk);
+                            rx_count = 0;
+                        }
                     }
-                    else
+                    else if((uint16_t)(new_blk - (uint16_t)rx_blk - 1) < 0x8000)
+                    {
+                        /* A block of this window was lost. Acknowledge the
+                           last in-order block once, the client restarts after it. */
+                        if(!rx_gap)
+                        {
+                            send_ack((uint16_t)rx_blk);
+                            rx_count = 0;
+                            rx_gap = 1;
+                        }
+                    }
+                    else if((sys_now() - rx_ack_time) >= TFTP_TIMEOUT / 2)
                     {
-                        /* Wrong ack # */
-                        printf("Unknown ID number\n");
-                        send_err(get_addr, get_port, TFTP_ERROR_UNKNOWN_ID);
-                        state = TFTP_STATE_IDLE;
+                        /* An old block: our last ACK was lost and the client
+                           went back on timeout. Blocks that were already on
+                           their way when we acknowledged are ignored, repeating
+                           the ACK for them would restart the window again. */
+                        send_ack((uint16_t)rx_blk);
+                        rx_count = 0;
                     }
                 }
                 break;
@@ -270,36 +467,39 @@ static void tftp_thread(void *arg)
                 else
                 {
                     uint16_t new_blk = lwip_ntohs(*(uint16_t *)(payload + 2));
+                    /* Blocks newly acknowledged by this ACK */
+                    uint16_t acked = (uint16_t)(new_blk - (uint16_t)(tx_base - 1));
 
-                    if(new_blk == (blk - 1))
+                    oack = 0;
+                    if(acked == 0)
                     {
-                        /* Last packet was lost */
-                        send_data(blk, data, MIN(remain, TFTP_BLOCK_LENGTH));
+                        /* ACK of the OACK, or the client lost a block of the window */
+                        if(tx_restart != tx_base)
+                        {
+                            /* Once per window, more copies of this ACK come
+                               from blocks that were already on their way */
+                            tx_restart = tx_base;
+                            tx_next = tx_base;
+                            send_window();
+                        }
                     }
-                    else if(new_blk == blk)
+                    else if(acked <= tx_next - tx_base)
                     {
-                        remain -= TFTP_BLOCK_LENGTH;
-                        if(remain < 0)  /* Still need to send a 0 data packet if remain is 0 */
+                        tx_base += acked;
+                        if(tx_base > tx_last)
                         {
                             /* All done */
-                            printf("\nDone\n");
+                            print_done(flen);
                             state = TFTP_STATE_IDLE;
                         }
                         else
                         {
-                            blk++;
-                            data += TFTP_BLOCK_LENGTH;
-                            printf(".");
-                            send_data(blk, data, MIN(remain, TFTP_BLOCK_LENGTH));
+                            /* RFC 7440: the next window starts after the acknowledged block */
+                            tx_next = tx_base;
+                            send_window();
                         }
                     }
-                    else
-                    {
-                        /* Wrong ack # */
-                        printf("Unknown ID number\n");
-                        send_err(get_addr, get_port, TFTP_ERROR_UNKNOWN_ID);
-                        state = TFTP_STATE_IDLE;
-                    }
+                    /* Otherwise a stale ACK of an earlier window, ignore it */
                 }
                 break;
             case TFTP_OPCODE_ERROR:
@@ -307,6 +507,7 @@ static void tftp_thread(void *arg)
                 if((get_port == client_port) || !memcmp(get_addr, &client_addr, sizeof(ip_addr_t)))
                 {
                     state = TFTP_STATE_IDLE;
+                    oack = 0;
                     printf("Received ERR: %d\n", lwip_ntohs(*(uint16_t *)(payload + 2)));
                 }
                 break;
@@ -317,6 +518,7 @@ static void tftp_thread(void *arg)
                     printf("Received unknown op code\n");
                     send_err(get_addr, get_port, TFTP_ERROR_ILLEGAL_OPERATION);
                     state = TFTP_STATE_IDLE;
+                    oack = 0;
                 }
                 break;
         }
@@ -332,9 +534,5 @@ static void tftp_thread(void *arg)
   */
 void tftp_server_init(void)
 {
-    int i;
-
-    for(i = 0; i < FILE_LEN; i++)
-        file[i] = i & 0xFF;
     sys_thread_new("TFTP", tftp_thread, NULL, TFTP_THREAD_STACKSIZE, TFTP_THREAD_PRIO);
 }
@@ -14,11 +14,20 @@
 #define TFTP_OPCODE_DATA        3
 #define TFTP_OPCODE_ACK         4
 #define TFTP_OPCODE_ERROR       5
+#define TFTP_OPCODE_OACK        6       // RFC 2347 option acknowledgment
 
 #define TFTP_PORT               69
 #define TFTP_TIMEOUT            500    //msec
 #define TFTP_MAX_RETRIES        5
-#define TFTP_BLOCK_LENGTH       512
+#define TFTP_BLOCK_LENGTH       512     // Default block size without options
+
+#define TFTP_MIN_BLKSIZE        8       // RFC 2348 lower bound
+#define TFTP_MAX_BLKSIZE        1468    // Largest block that fits an Ethernet frame
+#define TFTP_MAX_WINDOWSIZE     8       // RFC 7440 blocks in flight, bounded by pbuf pool and EMAC Rx ring
+
+#ifndef TFTP_FILE_LEN
+#define TFTP_FILE_LEN           2048    // Size of the test pattern file, raise to benchmark
+#endif
 
 enum tftp_error
 {
@@ -29,7 +38,8 @@ enum tftp_error
     TFTP_ERROR_ILLEGAL_OPERATION,   // 4
     TFTP_ERROR_UNKNOWN_ID,          // 5
     TFTP_ERROR_FILE_EXISTS,         // 6
-    TFTP_ERROR_NO_SUCH_USER         // 7
+    TFTP_ERROR_NO_SUCH_USER,        // 7
+    TFTP_ERROR_OPTION               // 8, RFC 2347 option negotiation failed
 };
 
 enum tftp_state
@@ -20,6 +20,12 @@
 #define PCM_BUFFER_SIZE        (1152)
 #define FILE_IO_BUFFER_SIZE    (4096)
 
+/* Cluster link map for fast seek, 2 items per file fragment plus 2. A file
+   in more fragments falls back to the normal seek. */
+#define MP3_CLMT_ITEMS         (64)
+/* Time seeks with and without the cluster link map before playing */
+#define MP3_SEEK_BENCH         0
+
 struct mp3Header
 {
     unsigned int sync : 11;
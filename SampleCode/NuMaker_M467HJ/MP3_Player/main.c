@@ -90,6 +90,9 @@ void SDH0_IRQHandler(void)
             SDH_Probe(SDH0);
         }
 
+        /* The SD cache must not keep sectors of the previous card */
+        disk_media_change(0);
+
         SDH0->INTSTS = SDH_INTSTS_CDIF_Msk;
     }
 
@@ -27,6 +27,7 @@
 #include "config.h"
 #include "diskio.h"
 #include "ff.h"
+#include "ffclmt.h"
 #include "mad.h"
 
 #define MP3_FILE    "0:\\test.mp3"
@@ -57,6 +58,19 @@ uint32_t aPCMBuffer[2][PCM_BUFFER_SIZE] = {0};
 unsigned char MadInputBuffer[FILE_IO_BUFFER_SIZE + MAD_BUFFER_GUARD];
 // audio information structure
 struct AudioInfoObject audioInfo;
+// cluster link map of the open MP3 file
+DWORD mp3Clmt[MP3_CLMT_ITEMS];
+
+// Build the cluster link map of the open MP3 file so seeks and cluster
+// changes do not walk the FAT. Too fragmented files use the normal seek.
+static void MP3_FastSeek(void)
+{
+    FRESULT res;
+
+    res = f_clmt_attach(&mp3FileObject, mp3Clmt, MP3_CLMT_ITEMS);
+    if(res == FR_NOT_ENOUGH_CORE)
+        printf("Fast seek off, file needs %d link map items\r\n", (int)mp3Clmt[0]);
+}
 
 // Parse MP3 header and get some informations
 void MP3_ParseHeaderInfo(uint8_t *pFileName)
@@ -68,6 +82,7 @@ void MP3_ParseHeaderInfo(uint8_t *pFileName)
     if(res == FR_OK)
     {
         printf("file is opened!!\r\n");
+        MP3_FastSeek();
         f_stat((void *)pFileName, &Finfo);
         audioInfo.playFileSize = Finfo.fsize;
 
@@ -107,6 +122,69 @@ void MP3_ParseHeaderInfo(uint8_t *pFileName)
     printf("=====================\r\n");
 }
 
+#if MP3_SEEK_BENCH
+#define SEEK_BENCH_COUNT    64
+
+// Average cycles of a seek to a random sector plus a one sector read
+static uint32_t MP3_SeekCycles(uint32_t u32Size)
+{
+    uint32_t i, u32Ofs, u32Start, u32Total = 0, u32Seed = 1;
+    UINT br;
+
+    for(i = 0; i < SEEK_BENCH_COUNT; i++)
+    {
+        u32Seed = u32Seed * 1103515245 + 12345;
+        u32Ofs = ((u32Seed >> 8) % (u32Size / 512)) * 512;
+
+        u32Start = DWT->CYCCNT;
+        f_lseek(&mp3FileObject, u32Ofs);
+        f_read(&mp3FileObject, (char *)(&MadInputBuffer[0]), 512, &br);
+        u32Total += DWT->CYCCNT - u32Start;
+    }
+
+    return u32Total / SEEK_BENCH_COUNT;
+}
+
+// Compare the seek latency with and without the cluster link map
+void MP3_SeekBench(uint8_t *pFileName)
+{
+    uint32_t u32Normal, u32Fast, u32Size;
+
+    if(f_open(&mp3FileObject, (void *)pFileName, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+        return;
+
+    u32Size = f_size(&mp3FileObject);
+    if(u32Size < 512)
+    {
+        f_close(&mp3FileObject);
+        return;
+    }
+
+    /* Enable the cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    u32Normal = MP3_SeekCycles(u32Size);
+
+    printf("====[Seek]==========\r\n");
+    printf("FileSize = %d\r\n", u32Size);
+    printf("Normal seek = %d us\r\n", u32Normal / (SystemCoreClock / 1000000));
+    if(f_clmt_attach(&mp3FileObject, mp3Clmt, MP3_CLMT_ITEMS) == FR_OK)
+    {
+        u32Fast = MP3_SeekCycles(u32Size);
+        printf("Fast seek = %d us, %d link map items\r\n", u32Fast / (SystemCoreClock / 1000000), (int)mp3Clmt[0]);
+    }
+    else
+    {
+        printf("Fast seek = n/a, file needs %d link map items\r\n", (int)mp3Clmt[0]);
+    }
+    printf("=====================\r\n");
+
+    f_close(&mp3FileObject);
+}
+#endif
+
 // Enable I2S TX with PDMA function
 void StartPlay(void)
 {
@@ -175,6 +253,10 @@ void MP3Player(void)
     /* Parse MP3 header */
     MP3_ParseHeaderInfo((uint8_t *)MP3_FILE);
 
+#if MP3_SEEK_BENCH
+    MP3_SeekBench((uint8_t *)MP3_FILE);
+#endif
+
     /* First the structures used by libmad must be initialized. */
     mad_stream_init(&Stream);
     mad_frame_init(&Frame);
@@ -187,6 +269,7 @@ void MP3Player(void)
         printf("Open file error: %s\n", MP3_FILE);
         return;
     }
+    MP3_FastSeek();
 
 #if (!NAU8822)
     /* Reset NAU88L25 codec */
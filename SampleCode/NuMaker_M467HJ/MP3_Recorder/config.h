@@ -41,6 +41,14 @@ If user wants to implement stereo mode, the sampling rate and bit rate can reach
 #define PCM_BUFFER_SIZE        2304
 #define FILE_IO_BUFFER_SIZE    4096
 
+/* The MP3 file is reserved contiguously for this many seconds and written
+   in whole buffers through ffstream.c. A longer recording goes on with
+   f_write(), the unused part of the reserve is freed when it is closed. */
+#define REC_PREALLOC_SECONDS   600
+#define REC_STREAM_BUFFER_SIZE (16 * 1024)
+/* Print the worst and average Write_MP3() time after each recording */
+#define REC_WRITE_BENCH        0
+
 struct mp3Header
 {
     unsigned int sync : 11;
@@ -96,6 +104,7 @@ void NAU8822_Setup(void);
 
 void Recorder_Init(void);
 void MP3Recorder(void);
+void Recorder_Close(void);
 int32_t Write_MP3(long bytes, void *buffer, void *config);
 
 int32_t mp3CountV1L3Headers(unsigned char *pu8Bytes, size_t size);
@@ -100,6 +100,9 @@ void SDH0_IRQHandler(void)
             SDH_Probe(SDH0);
         }
 
+        /* The SD cache must not keep sectors of the previous card */
+        disk_media_change(0);
+
         SDH0->INTSTS = SDH_INTSTS_CDIF_Msk;
     }
 
@@ -377,6 +380,9 @@ int main(void)
 
         if(SD0.IsCardInsert == TRUE)
         {
+            /* Bound the time written sectors stay in the SD cache only */
+            disk_cache_flush_aged();
+
 #ifdef REC_IN_RT
 
             /* Inform users about microSD card usage */
@@ -477,7 +483,7 @@ int main(void)
                 /* Close encoder */
                 shine_close(s);
 
-                f_close(&mp3FileObject);
+                Recorder_Close();
 
                 printf(" Done !\n\n");
 
@@ -13,6 +13,7 @@
 #include "config.h"
 #include "diskio.h"
 #include "ff.h"
+#include "ffstream.h"
 #include "l3.h"
 
 /*---------------------------------------------------------------------------*/
@@ -24,6 +25,14 @@ shine_t        s;
 int32_t        samples_per_pass;
 FIL            mp3FileObject;
 size_t         ReturnSize;
+FSTREAM        mp3Stream;
+
+/* Word aligned for the SDH DMA */
+static uint32_t s_au32StreamBuf[REC_STREAM_BUFFER_SIZE / 4];
+
+#if REC_WRITE_BENCH
+static uint32_t s_u32WriteMax, s_u32WriteTotal, s_u32WriteCount;
+#endif
 
 /*---------------------------------------------------------------------------*/
 /* Functions                                                                 */
@@ -31,7 +40,21 @@ size_t         ReturnSize;
 /* Write out the MP3 file */
 int32_t Write_MP3(long bytes, void *buffer, void *config)
 {
-    f_write(&mp3FileObject, buffer, bytes, &ReturnSize);
+    UINT bw;
+#if REC_WRITE_BENCH
+    uint32_t u32Start = DWT->CYCCNT, u32Us;
+#endif
+
+    if(f_stream_write(&mp3Stream, buffer, (UINT)bytes, &bw) != FR_OK)
+        bytes = (long)bw;
+
+#if REC_WRITE_BENCH
+    u32Us = (DWT->CYCCNT - u32Start) / (SystemCoreClock / 1000000);
+    if(u32Us > s_u32WriteMax)
+        s_u32WriteMax = u32Us;
+    s_u32WriteTotal += u32Us;
+    s_u32WriteCount++;
+#endif
 
     if(i32Cnt++ >= (bytes / 10))
     {
@@ -90,7 +113,9 @@ void Recorder_Init(void)
     /* Enable RX threshold level interrupt */
     I2S_EnableInt(I2S0, I2S_IEN_RXTHIEN_Msk);
 
-    res = f_open(&mp3FileObject, MP3_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+    res = f_stream_open(&mp3Stream, &mp3FileObject, MP3_FILE,
+                        (FSIZE_t)REC_PREALLOC_SECONDS * REC_BIT_RATE * 1000 / 8,
+                        s_au32StreamBuf, sizeof(s_au32StreamBuf));
 
     if(res != FR_OK)
     {
@@ -98,6 +123,17 @@ void Recorder_Init(void)
         return;
     }
 
+    if(f_stream_reserved(&mp3Stream) == 0)
+        printf("No contiguous space for %d seconds, writing cluster by cluster\n", REC_PREALLOC_SECONDS);
+
+#if REC_WRITE_BENCH
+    /* Enable the cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    s_u32WriteMax = s_u32WriteTotal = s_u32WriteCount = 0;
+#endif
+
     set_defaults(&config);
 
     if(REC_FORMAT == I2S_MONO)
@@ -150,3 +186,21 @@ void MP3Recorder(void)
 
     g_u32BuffPos = 0;
 }
+
+/* Write the buffered frames and set the file size */
+void Recorder_Close(void)
+{
+    if(f_stream_close(&mp3Stream) != FR_OK)
+        printf("\nClose file error!\n");
+
+#if REC_WRITE_BENCH
+    if(s_u32WriteCount)
+    {
+        printf("\n====[Write_MP3]=====\r\n");
+        printf("Calls = %lu\r\n", (unsigned long)s_u32WriteCount);
+        printf("Worst = %lu us, average = %lu us\r\n", (unsigned long)s_u32WriteMax,
+               (unsigned long)(s_u32WriteTotal / s_u32WriteCount));
+        printf("=====================\r\n");
+    }
+#endif
+}
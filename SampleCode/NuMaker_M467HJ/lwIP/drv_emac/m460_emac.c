@@ -15,6 +15,7 @@
 #include <netif/ethernetif.h>
 #include <netif/etharp.h>
 #include <lwip/sys.h>
+#include <lwip/tcpip.h>
 
 #if (LWIP_USING_HW_CHECKSUM == 1)
 #define USING_HW_CHECKSUM
@@ -23,19 +24,58 @@
 static synopGMACdevice GMACdev = {0};
 static DmaDesc tx_desc[TRANSMIT_DESC_SIZE] __attribute__((aligned(32))) = {0};
 static DmaDesc rx_desc[RECEIVE_DESC_SIZE] __attribute__((aligned(32))) = {0};
-static PKT_FRAME_T tx_buf[TRANSMIT_DESC_SIZE] __attribute__((aligned(32))) = {0};
-static PKT_FRAME_T rx_buf[RECEIVE_DESC_SIZE] __attribute__((aligned(32))) = {0};
+static PKT_FRAME_T tx_buf[TRANSMIT_DESC_SIZE] EMAC_DMA_BUF_ATTR __attribute__((aligned(32))) = {0};
+static PKT_FRAME_T rx_buf[RECEIVE_DESC_SIZE] EMAC_DMA_BUF_ATTR __attribute__((aligned(32))) = {0};
+static struct pbuf *tx_pbuf[TRANSMIT_DESC_SIZE] = {0};  // pbuf referenced by the last descriptor of a zero-copy frame
+static u32 tx_clean = 0;                                // oldest queued tx descriptor not yet cleaned
+static u32 tx_pending = 0;                              // number of queued tx descriptors not yet cleaned
+static volatile u32 tx_waiting = 0;                     // a sender is blocked on a full tx ring
+static struct tcpip_callback_msg *tx_clean_msg = NULL;  // runs EMAC_CleanTxRing() in tcpip_thread after tx complete
+static volatile u32 tx_clean_posted = 0;                // tx_clean_msg posted and not yet run
+static volatile u32 rx_int_off = 0;                     // rx interrupt is off until the rx thread turns it on
+static EMAC_CONFIG_T s_sConfig = {TRANSMIT_DESC_SIZE, RECEIVE_DESC_SIZE, EMAC_RX_SMALL_SIZE};
+static EMAC_POOL_STATS_T s_asRxPoolStats[2] = {0};
+
+static void EMAC_TxCleanCallback(void *arg);
+
+#define GMAC_ADDR_AE    0x80000000      // (AE) address enable of GmacAddrNHigh, N > 0
+
+typedef struct
+{
+    u8 au8Mac[6];
+    u8 u8Slot;                          // perfect match register index, 0 if in the hash table
+    u8 u8Ref;                           // groups mapped onto this address, 0 for a free entry
+} EMAC_MCAST_ENTRY_T;
+
+static EMAC_MCAST_ENTRY_T s_asMcast[EMAC_MCAST_FILTER_NUM] = {0};
+static u8 s_au8HashRef[64] = {0};       // addresses in each hash bin
+static u32 s_u32SlotUsed = 0;           // bitmap of perfect match registers in use
+static u32 s_u32McastOverflow = 0;      // addresses added beyond the table
+#ifdef TIME_STAMPING
+static u32 s_u32McastAll = 1;           // pass all multicast, PTP event and peer delay messages are multicast
+#else
+static u32 s_u32McastAll = 0;           // pass all multicast
+#endif
 extern sys_sem_t xRxSemaphore;
+extern sys_sem_t xTxSemaphore;
 extern struct netif *_netif;
 
 struct nu_emac_lwip_pbuf
 {
     struct pbuf_custom p;           // lwip pbuf
-    PKT_FRAME_T *psPktFrameDataBuf; // emac descriptor
+    PKT_FRAME_T *psPktFrameDataBuf; // emac descriptor, NULL for a small pool pbuf
+};
+
+struct nu_emac_lwip_small_pbuf
+{
+    struct nu_emac_lwip_pbuf hdr;
+    u8 au8Buf[EMAC_RX_SMALL_SIZE];  // copied frame
 };
 
 typedef struct nu_emac_lwip_pbuf *nu_emac_lwip_pbuf_t;
+typedef struct nu_emac_lwip_small_pbuf *nu_emac_lwip_small_pbuf_t;
 LWIP_MEMPOOL_DECLARE(emac_rx, RECEIVE_DESC_SIZE, sizeof(struct nu_emac_lwip_pbuf), "EMAC0 RX PBUF pool");
+LWIP_MEMPOOL_DECLARE(emac_rx_small, EMAC_RX_SMALL_NUM, sizeof(struct nu_emac_lwip_small_pbuf), "EMAC0 RX small PBUF pool");
 
 
 static void EMAC_ModuleInit(void)
@@ -59,6 +99,23 @@ static void EMAC_ModuleInit(void)
     SET_EMAC0_PPS_PB6();
 }
 
+/**
+  * Set ring sizes and the rx copy break. Must be called before EMAC_Open(), values out of
+  * range are clipped to the compile time limits.
+  * @param[in] psConfig  Configuration to use.
+  */
+void EMAC_Config(const EMAC_CONFIG_T *psConfig)
+{
+    s_sConfig = *psConfig;
+
+    if((s_sConfig.u32TxDescNum == 0) || (s_sConfig.u32TxDescNum > TRANSMIT_DESC_SIZE))
+        s_sConfig.u32TxDescNum = TRANSMIT_DESC_SIZE;
+    if((s_sConfig.u32RxDescNum == 0) || (s_sConfig.u32RxDescNum > RECEIVE_DESC_SIZE))
+        s_sConfig.u32RxDescNum = RECEIVE_DESC_SIZE;
+    if(s_sConfig.u32RxCopyBreak > EMAC_RX_SMALL_SIZE)
+        s_sConfig.u32RxCopyBreak = EMAC_RX_SMALL_SIZE;
+}
+
 void EMAC_Open(uint8_t *macaddr)
 {
     int32_t ret = 0;
@@ -99,11 +156,11 @@ void EMAC_Open(uint8_t *macaddr)
     }
 
     /* Set up the tx and rx descriptor queue/ring */
-    synopGMAC_setup_tx_desc_queue(&GMACdev, &tx_desc[0], TRANSMIT_DESC_SIZE, RINGMODE);
+    synopGMAC_setup_tx_desc_queue(&GMACdev, &tx_desc[0], s_sConfig.u32TxDescNum, RINGMODE);
     synopGMAC_init_tx_desc_base(&GMACdev);  // Program the transmit descriptor base address in to DmaTxBase addr
     TR("DmaTxBaseAddr = %08x\n", synopGMACReadReg(GMACdev.DmaBase, DmaTxBaseAddr));
 
-    synopGMAC_setup_rx_desc_queue(&GMACdev, &rx_desc[0], RECEIVE_DESC_SIZE, RINGMODE);
+    synopGMAC_setup_rx_desc_queue(&GMACdev, &rx_desc[0], s_sConfig.u32RxDescNum, RINGMODE);
     synopGMAC_init_rx_desc_base(&GMACdev); // Program the transmit descriptor base address in to DmaTxBase addr
     TR("DmaTxBaseAddr = %08x\n", synopGMACReadReg(GMACdev.DmaBase, DmaRxBaseAddr));
 
@@ -112,7 +169,19 @@ void EMAC_Open(uint8_t *macaddr)
 
     /* Initialize the mac interface */
     synopGMAC_mac_init(&GMACdev);
-    synopGMAC_promisc_enable(&GMACdev);
+
+    /* Filter on destination address: own unicast, broadcast, and multicast by perfect match
+       registers or hash table. Multicast addresses are added by EMAC_AddMulticastFilter(). */
+    synopGMAC_write_hash_table_high(&GMACdev, 0);
+    synopGMAC_write_hash_table_low(&GMACdev, 0);
+    synopGMAC_multicast_hash_filter_enable(&GMACdev);
+    synopGMAC_hash_perfect_filter_enable(&GMACdev);
+    if(s_u32McastAll)
+        synopGMAC_multicast_enable(&GMACdev);
+
+    /* MMC counters are only read for statistics */
+    synopGMACWriteReg(GMACdev.MacBase, GmacMmcIntrMaskRx, 0xFFFFFFFF);
+    synopGMACWriteReg(GMACdev.MacBase, GmacMmcIntrMaskTx, 0xFFFFFFFF);
 
     synopGMAC_pause_control(&GMACdev); // This enables the pause control in Full duplex mode of operation
 
@@ -122,7 +191,13 @@ void EMAC_Open(uint8_t *macaddr)
     synopGMAC_rx_tcpip_chksum_drop_enable(&GMACdev); // This is default configuration, DMA drops the packets if error in encapsulated ethernet payload
 #endif
 
-    for(i = 0; i < RECEIVE_DESC_SIZE; i ++)
+    synopGMAC_set_rx_int_wdt(&GMACdev, EMAC_RX_INT_WDT);
+
+    /* Without it, sent pbufs are only released by the next transmit */
+    if(tx_clean_msg == NULL)
+        tx_clean_msg = tcpip_callbackmsg_new(EMAC_TxCleanCallback, NULL);
+
+    for(i = 0; i < s_sConfig.u32RxDescNum; i ++)
     {
         synopGMAC_set_rx_qptr(&GMACdev, (u32)&rx_buf[i], PKT_FRAME_BUF_SIZE, 0);
     }
@@ -143,8 +218,11 @@ void EMAC_Open(uint8_t *macaddr)
     else
         synopGMAC_set_mode(&GMACdev, 1); // 1: 100Mbps, 2: 10Mbps
 
-    /* Initial zero_copy rx pool */
+    /* Initial zero_copy and copy break rx pools */
     memp_init_pool(&memp_emac_rx);
+    memp_init_pool(&memp_emac_rx_small);
+    s_asRxPoolStats[EMAC_RX_POOL_LARGE].u32Size = s_sConfig.u32RxDescNum;
+    s_asRxPoolStats[EMAC_RX_POOL_SMALL].u32Size = EMAC_RX_SMALL_NUM;
 
     NVIC_SetPriority(EMAC0_TXRX_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1);
     NVIC_EnableIRQ(EMAC0_TXRX_IRQn);
@@ -231,7 +309,8 @@ void EMAC0_IRQHandler(void)
         if(interrupt & synopGMACDmaRxNormal)
         {
             TR("%s:: Rx Normal \n", __FUNCTION__);
-            u32GmacDmaIE &= ~DmaIntRxNormMask;  // disable RX interrupt
+            GMACdev.synopGMACNetStats.rx_interrupts++;
+            rx_int_off = 1;  // disable RX interrupt
         }
         if(interrupt & synopGMACDmaRxAbnormal)
         {
@@ -261,6 +340,18 @@ void EMAC0_IRQHandler(void)
     {
         TR("%s::Finished Normal Transmission \n", __FUNCTION__);
         synop_handle_transmit_over(&GMACdev);//Do whatever you want after the transmission is over
+        if(tx_waiting)
+        {
+            tx_waiting = 0;
+            xSemaphoreGiveFromISR(xTxSemaphore, &xHigherPriorityTaskWoken);
+        }
+        else if((tx_clean_msg != NULL) && !tx_clean_posted)
+        {
+            /* Release the sent pbufs now: TCP does not retransmit a segment whose pbuf is still referenced */
+            tx_clean_posted = 1;
+            if(tcpip_callbackmsg_trycallback_fromisr(tx_clean_msg) != ERR_OK)
+                tx_clean_posted = 0;
+        }
     }
 
     if(interrupt & synopGMACDmaTxAbnormal)
@@ -284,12 +375,24 @@ void EMAC0_IRQHandler(void)
         }
     }
 
+    /* Rx interrupt stays off while the rx thread drains or polls the ring */
+    if(rx_int_off)
+        u32GmacDmaIE &= ~DmaIntRxNormMask;
+
     /* Enable the interrrupt before returning from ISR*/
     synopGMAC_enable_interrupt(&GMACdev, u32GmacDmaIE);
 
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
+/* Account a buffer taken from (or given back to) a rx pool. Called with SYS_ARCH_PROTECT held. */
+static void EMAC_RxPoolTake(EMAC_POOL_STATS_T *psStats)
+{
+    psStats->u32Used++;
+    if(psStats->u32Used > psStats->u32HighWater)
+        psStats->u32HighWater = psStats->u32Used;
+}
+
 void nu_emac_pbuf_free(struct pbuf *p)
 {
     nu_emac_lwip_pbuf_t my_buf = (nu_emac_lwip_pbuf_t)p;
@@ -297,56 +400,473 @@ void nu_emac_pbuf_free(struct pbuf *p)
 
     SYS_ARCH_DECL_PROTECT(old_level);
     SYS_ARCH_PROTECT(old_level);
-    status = synopGMAC_set_rx_qptr(&GMACdev, (u32)my_buf->psPktFrameDataBuf, PKT_FRAME_BUF_SIZE, 0);
-    if(status < 0)
+    if(my_buf->psPktFrameDataBuf == NULL)
     {
-        TR0("synopGMAC_set_rx_qptr: status < 0!!\n");
+        /* Small pool pbuf, its DMA buffer was given back on reception */
+        s_asRxPoolStats[EMAC_RX_POOL_SMALL].u32Used--;
+        memp_free_pool(&memp_emac_rx_small, my_buf);
+    }
+    else
+    {
+        status = synopGMAC_set_rx_qptr(&GMACdev, (u32)my_buf->psPktFrameDataBuf, PKT_FRAME_BUF_SIZE, 0);
+        if(status < 0)
+        {
+            TR0("synopGMAC_set_rx_qptr: status < 0!!\n");
+        }
+        s_asRxPoolStats[EMAC_RX_POOL_LARGE].u32Used--;
+        memp_free_pool(&memp_emac_rx, my_buf);
     }
-    memp_free_pool(&memp_emac_rx, my_buf);
     SYS_ARCH_UNPROTECT(old_level);
 }
 
-uint32_t EMAC_ReceivePkt(void)
+/* Give a frame buffer straight back to the rx ring */
+static void EMAC_RxRecycle(PKT_FRAME_T *psPktFrame)
 {
-    uint32_t len = 0;
+    SYS_ARCH_DECL_PROTECT(old_level);
+    SYS_ARCH_PROTECT(old_level);
+    synopGMAC_set_rx_qptr(&GMACdev, (u32)psPktFrame, PKT_FRAME_BUF_SIZE, 0);
+    SYS_ARCH_UNPROTECT(old_level);
+}
+
+/* Copy a short frame into the small pool and recycle its DMA buffer. Returns NULL if the pool is empty. */
+static struct pbuf *EMAC_RxCopyBreak(PKT_FRAME_T *psPktFrame, uint32_t len)
+{
+    nu_emac_lwip_small_pbuf_t my_pbuf;
+    EMAC_POOL_STATS_T *psStats = &s_asRxPoolStats[EMAC_RX_POOL_SMALL];
+
+    SYS_ARCH_DECL_PROTECT(old_level);
+    SYS_ARCH_PROTECT(old_level);
+    my_pbuf = (nu_emac_lwip_small_pbuf_t)memp_malloc_pool(&memp_emac_rx_small);
+    if(my_pbuf == NULL)
+        psStats->u32Starved++;
+    else
+        EMAC_RxPoolTake(psStats);
+    SYS_ARCH_UNPROTECT(old_level);
+
+    if(my_pbuf == NULL)
+        return NULL;
+
+    memcpy(my_pbuf->au8Buf, psPktFrame, len);
+    EMAC_RxRecycle(psPktFrame);
+
+    my_pbuf->hdr.p.custom_free_function = nu_emac_pbuf_free;
+    my_pbuf->hdr.psPktFrameDataBuf      = NULL;
+
+    return pbuf_alloced_custom(PBUF_RAW,
+                               len,
+                               PBUF_REF,
+                               &my_pbuf->hdr.p,
+                               my_pbuf->au8Buf,
+                               EMAC_RX_SMALL_SIZE);
+}
+
+/* Hand the DMA buffer of a frame to lwIP without copying. Returns NULL if the pool is empty. */
+static struct pbuf *EMAC_RxZeroCopy(PKT_FRAME_T *psPktFrame, uint32_t len)
+{
+    nu_emac_lwip_pbuf_t my_pbuf;
+    EMAC_POOL_STATS_T *psStats = &s_asRxPoolStats[EMAC_RX_POOL_LARGE];
+
+    SYS_ARCH_DECL_PROTECT(old_level);
+    SYS_ARCH_PROTECT(old_level);
+    my_pbuf = (nu_emac_lwip_pbuf_t)memp_malloc_pool(&memp_emac_rx);
+    if(my_pbuf != NULL)
+    {
+        EMAC_RxPoolTake(psStats);
+        /* Every DMA buffer is now held by lwIP and the ring is empty */
+        if(psStats->u32Used == psStats->u32Size)
+            psStats->u32Starved++;
+    }
+    SYS_ARCH_UNPROTECT(old_level);
+
+    if(my_pbuf == NULL)
+        return NULL;
+
+    my_pbuf->p.custom_free_function = nu_emac_pbuf_free;
+    my_pbuf->psPktFrameDataBuf      = psPktFrame;
+
+    return pbuf_alloced_custom(PBUF_RAW,
+                               len,
+                               PBUF_REF,
+                               &my_pbuf->p,
+                               psPktFrame,
+                               PKT_FRAME_BUF_SIZE);
+}
+
+static int EMAC_IsBroadcast(const u8 *pu8Mac)
+{
+    return (pu8Mac[0] & pu8Mac[1] & pu8Mac[2] & pu8Mac[3] & pu8Mac[4] & pu8Mac[5]) == 0xFF;
+}
+
+/* Find a tracked multicast address. Returns NULL if not found. */
+static EMAC_MCAST_ENTRY_T *EMAC_McastFind(const u8 *pu8Mac)
+{
+    u32 i;
+
+    for(i = 0; i < EMAC_MCAST_FILTER_NUM; i++)
+    {
+        if((s_asMcast[i].u8Ref != 0) && (memcmp(s_asMcast[i].au8Mac, pu8Mac, 6) == 0))
+            return &s_asMcast[i];
+    }
+    return NULL;
+}
+
+/* Check a received multicast destination against the joined addresses */
+static int EMAC_McastMatch(const u8 *pu8Mac)
+{
+    int match;
+
+    SYS_ARCH_DECL_PROTECT(old_level);
+    SYS_ARCH_PROTECT(old_level);
+    match = s_u32McastAll || s_u32McastOverflow || (EMAC_McastFind(pu8Mac) != NULL);
+    if(match)
+        GMACdev.synopGMACNetStats.rx_multicast++;
+    SYS_ARCH_UNPROTECT(old_level);
+
+    return match;
+}
+
+/* Take one frame off the rx ring. Returns its length, 0 if the ring is empty, or -1 for a dropped bad frame. */
+int32_t EMAC_ReceivePkt(void)
+{
+    int32_t len;
     PKT_FRAME_T* psPktFrame;
-    struct pbuf *pbuf;
+    struct pbuf *pbuf = NULL;
+    uint32_t u32Pool = EMAC_RX_POOL_LARGE;
+
+    len = synop_handle_received_data(&GMACdev, &psPktFrame);
+    if(len < 0)
+    {
+        /* Receive error, or a checksum error with DT set. The descriptor is reset already. */
+        GMACdev.synopGMACNetStats.rx_dropped++;
+        if(GMACdev.rx_csum_err)
+            GMACdev.synopGMACNetStats.rx_csum_sw_dropped++;
+        EMAC_RxRecycle(psPktFrame);
+        return -1;
+    }
 
-    if((len = synop_handle_received_data(&GMACdev, &psPktFrame)) > 0)
+    if(len > 0)
     {
-        nu_emac_lwip_pbuf_t my_pbuf  = (nu_emac_lwip_pbuf_t)memp_malloc_pool(&memp_emac_rx);
-        if(my_pbuf != NULL)
+#if defined(USING_HW_CHECKSUM)
+        /* lwIP does not verify what the offload engine checks, so bad frames end here */
+        if(GMACdev.rx_csum_err)
         {
-            my_pbuf->p.custom_free_function = nu_emac_pbuf_free;
-            my_pbuf->psPktFrameDataBuf      = psPktFrame;
-
-            pbuf = pbuf_alloced_custom(PBUF_RAW,
-                                       len,
-                                       PBUF_REF,
-                                       &my_pbuf->p,
-                                       psPktFrame,
-                                       PKT_FRAME_BUF_SIZE);
-            if(pbuf == NULL)
-            {
-                printf("%s : failed to alloted\n", __func__);
-            }
-            else if(_netif->input(pbuf, _netif) != ERR_OK)
+            GMACdev.synopGMACNetStats.rx_dropped++;
+            GMACdev.synopGMACNetStats.rx_csum_sw_dropped++;
+            EMAC_RxRecycle(psPktFrame);
+            return len;
+        }
+#endif
+
+        if(psPktFrame->au8Buf[0] & 0x01)
+        {
+            /* Multicast or broadcast. A multicast frame may have passed only by a hash collision. */
+            if(!EMAC_IsBroadcast(psPktFrame->au8Buf) && !EMAC_McastMatch(psPktFrame->au8Buf))
             {
-                LWIP_DEBUGF(NETIF_DEBUG, ("ethernetif_input: Input error\n"));
-                pbuf_free(pbuf);
+                GMACdev.synopGMACNetStats.rx_mcast_sw_dropped++;
+                EMAC_RxRecycle(psPktFrame);
+                return len;
             }
         }
+
+        if((uint32_t)len <= s_sConfig.u32RxCopyBreak)
+        {
+            pbuf = EMAC_RxCopyBreak(psPktFrame, len);
+            u32Pool = EMAC_RX_POOL_SMALL;
+        }
+
+        /* Long frame, or small pool ran dry */
+        if(pbuf == NULL)
+        {
+            pbuf = EMAC_RxZeroCopy(psPktFrame, len);
+            u32Pool = EMAC_RX_POOL_LARGE;
+        }
+
+        if(pbuf == NULL)
+        {
+            /* Cannot happen while the pool is as large as the ring, but never lose the buffer */
+            s_asRxPoolStats[EMAC_RX_POOL_LARGE].u32Dropped++;
+            EMAC_RxRecycle(psPktFrame);
+        }
+        else if(ethernetif_rx_post(pbuf) != ERR_OK)
+        {
+            LWIP_DEBUGF(NETIF_DEBUG, ("ethernetif_input: Input error\n"));
+            s_asRxPoolStats[u32Pool].u32Dropped++;
+            pbuf_free(pbuf);
+        }
+    }
+
+    return len;
+}
+
+/* GMAC hash bin of an address: upper 6 bits of the bit reversed Ethernet CRC32 */
+static u32 EMAC_HashBin(const u8 *pu8Mac)
+{
+    u32 crc = 0xFFFFFFFF, bin = 0;
+    u32 i, j;
+
+    for(i = 0; i < 6; i++)
+    {
+        crc ^= pu8Mac[i];
+        for(j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    }
+    crc = ~crc;
+
+    for(i = 0; i < 6; i++)
+        bin |= ((crc >> i) & 1) << (5 - i);
+
+    return bin;
+}
+
+static void EMAC_WriteHashTable(void)
+{
+    u32 hash[2] = {0, 0};
+    u32 i;
+
+    for(i = 0; i < 64; i++)
+    {
+        if(s_au8HashRef[i] != 0)
+            hash[i >> 5] |= (1UL << (i & 31));
+    }
+    synopGMAC_write_hash_table_high(&GMACdev, hash[1]);
+    synopGMAC_write_hash_table_low(&GMACdev, hash[0]);
+}
+
+/* Program perfect match register u32Slot (1 ~ 15), or disable it if pu8Mac is NULL */
+static void EMAC_WritePerfect(u32 u32Slot, const u8 *pu8Mac)
+{
+    u32 u32High = GmacAddr0High + u32Slot * 8;
+
+    if(pu8Mac == NULL)
+    {
+        synopGMACWriteReg(GMACdev.MacBase, u32High, 0);
+        return;
+    }
+    synopGMAC_set_mac_addr(&GMACdev, u32High, u32High + 4, (u8 *)pu8Mac);
+    synopGMACSetBits(GMACdev.MacBase, u32High, GMAC_ADDR_AE);
+}
+
+/**
+  * Let the GMAC receive frames sent to a multicast address. Matches lwIP igmp/mld mac filter
+  * actions, so an address added n times is removed after n calls to EMAC_DelMulticastFilter().
+  * @param[in] pu8Mac  Multicast MAC address.
+  * @return 0. If the address table is full the GMAC passes all multicast frames instead.
+  */
+int32_t EMAC_AddMulticastFilter(const uint8_t *pu8Mac)
+{
+    EMAC_MCAST_ENTRY_T *psEntry;
+    u32 i;
+
+    SYS_ARCH_DECL_PROTECT(old_level);
+    SYS_ARCH_PROTECT(old_level);
+
+    if((psEntry = EMAC_McastFind(pu8Mac)) != NULL)
+    {
+        psEntry->u8Ref++;
+        SYS_ARCH_UNPROTECT(old_level);
+        return 0;
+    }
+
+    for(i = 0, psEntry = NULL; i < EMAC_MCAST_FILTER_NUM; i++)
+    {
+        if(s_asMcast[i].u8Ref == 0)
+        {
+            psEntry = &s_asMcast[i];
+            break;
+        }
+    }
+
+    if(psEntry == NULL)
+    {
+        /* Out of entries, stop filtering multicast until the table frees up */
+        if((s_u32McastOverflow++ == 0) && !s_u32McastAll)
+            synopGMAC_multicast_enable(&GMACdev);
+        SYS_ARCH_UNPROTECT(old_level);
+        return 0;
+    }
+
+    memcpy(psEntry->au8Mac, pu8Mac, 6);
+    psEntry->u8Ref  = 1;
+    psEntry->u8Slot = 0;
+
+    for(i = 1; i <= EMAC_PERFECT_FILTER_NUM; i++)
+    {
+        if(!(s_u32SlotUsed & (1UL << i)))
+        {
+            s_u32SlotUsed |= (1UL << i);
+            psEntry->u8Slot = i;
+            EMAC_WritePerfect(i, pu8Mac);
+            break;
+        }
+    }
+
+    if(psEntry->u8Slot == 0)
+    {
+        s_au8HashRef[EMAC_HashBin(pu8Mac)]++;
+        EMAC_WriteHashTable();
+    }
+
+    SYS_ARCH_UNPROTECT(old_level);
+    return 0;
+}
+
+/**
+  * Drop a multicast address added by EMAC_AddMulticastFilter().
+  * @param[in] pu8Mac  Multicast MAC address.
+  * @return 0 on success, -1 if the address was never added.
+  */
+int32_t EMAC_DelMulticastFilter(const uint8_t *pu8Mac)
+{
+    EMAC_MCAST_ENTRY_T *psEntry;
+
+    SYS_ARCH_DECL_PROTECT(old_level);
+    SYS_ARCH_PROTECT(old_level);
+
+    if((psEntry = EMAC_McastFind(pu8Mac)) == NULL)
+    {
+        /* One of the addresses which did not fit into the table */
+        if(s_u32McastOverflow > 0)
+        {
+            if((--s_u32McastOverflow == 0) && !s_u32McastAll)
+                synopGMAC_multicast_disable(&GMACdev);
+            SYS_ARCH_UNPROTECT(old_level);
+            return 0;
+        }
+        SYS_ARCH_UNPROTECT(old_level);
+        return -1;
+    }
+
+    if(--psEntry->u8Ref == 0)
+    {
+        if(psEntry->u8Slot != 0)
+        {
+            s_u32SlotUsed &= ~(1UL << psEntry->u8Slot);
+            EMAC_WritePerfect(psEntry->u8Slot, NULL);
+        }
         else
         {
-            printf("LWIP_MEMPOOL_ALLOC < 0!!\n");
+            s_au8HashRef[EMAC_HashBin(pu8Mac)]--;
+            EMAC_WriteHashTable();
         }
     }
-    else
+
+    SYS_ARCH_UNPROTECT(old_level);
+    return 0;
+}
+
+/**
+  * Get multicast filtering counters.
+  * Frames dropped by the hardware are derived from the MMC good multicast frame counter, which
+  * counts frames before address filtering. Pause frames (01:80:c2:00:00:01) are in it too and
+  * are taken out with the MMC pause frame counter.
+  * @param[out] psStats  Counters.
+  */
+void EMAC_GetMcastStats(EMAC_MCAST_STATS_T *psStats)
+{
+    u32 u32Total = synopGMACReadReg(GMACdev.MacBase, GmacMmcRxMcFramesG) -
+                   synopGMACReadReg(GMACdev.MacBase, GmacMmcRxPauseFrames);
+
+    psStats->u32Passed    = GMACdev.synopGMACNetStats.rx_multicast;
+    psStats->u32SwDropped = GMACdev.synopGMACNetStats.rx_mcast_sw_dropped;
+    psStats->u32HwDropped = u32Total - psStats->u32Passed - psStats->u32SwDropped;
+}
+
+/**
+  * Get receive checksum error counters.
+  * The MMC counters see every frame the offload engine checked, whether the GMAC dropped it
+  * (DmaDisableDropTcpCs clear) or passed it to the driver to drop.
+  * @param[out] psStats  Counters.
+  */
+void EMAC_GetCsumStats(EMAC_CSUM_STATS_T *psStats)
+{
+    psStats->u32IpHeader  = synopGMACReadReg(GMACdev.MacBase, GmacMmcRxIpV4HdrErrFrames);
+    psStats->u32Tcp       = synopGMACReadReg(GMACdev.MacBase, GmacMmcRxTcpErrorFrames);
+    psStats->u32Udp       = synopGMACReadReg(GMACdev.MacBase, GmacMmcRxUdpErrorFrames);
+    psStats->u32Icmp      = synopGMACReadReg(GMACdev.MacBase, GmacMmcRxIcmpErrorFrames);
+    psStats->u32SwDropped = GMACdev.synopGMACNetStats.rx_csum_sw_dropped;
+}
+
+/**
+  * Get usage counters of a rx pool.
+  * @param[in] u32Pool  EMAC_RX_POOL_LARGE or EMAC_RX_POOL_SMALL.
+  * @return Counters of the pool, updated in place.
+  */
+const EMAC_POOL_STATS_T* EMAC_GetRxPoolStats(uint32_t u32Pool)
+{
+    return &s_asRxPoolStats[(u32Pool == EMAC_RX_POOL_SMALL) ? EMAC_RX_POOL_SMALL : EMAC_RX_POOL_LARGE];
+}
+
+/* Turn the rx interrupt back on once the rx thread is done with the ring. */
+void EMAC_EnableRxInt(void)
+{
+    NVIC_DisableIRQ(EMAC0_TXRX_IRQn);
+    rx_int_off = 0;
+    synopGMAC_enable_interrupt(&GMACdev, DmaIntEnable);
+    NVIC_EnableIRQ(EMAC0_TXRX_IRQn);
+}
+
+/* Release pbufs of tx descriptors already reclaimed from DMA by the interrupt handler. */
+static void EMAC_CleanTxRing(void)
+{
+    DmaDesc *txdesc;
+
+    while(tx_pending > 0)
     {
-        synopGMAC_enable_interrupt(&GMACdev, DmaIntEnable);
+        txdesc = GMACdev.TxDesc + tx_clean;
+        if(synopGMAC_is_desc_owned_by_dma(txdesc) || !synopGMAC_is_desc_empty(txdesc))
+            break;
+
+        if(tx_pbuf[tx_clean] != NULL)
+        {
+            pbuf_free(tx_pbuf[tx_clean]);
+            tx_pbuf[tx_clean] = NULL;
+        }
+        tx_clean = (tx_clean + 1) % GMACdev.TxDescCount;
+        tx_pending--;
     }
+}
 
-    return len;
+/* Runs in tcpip_thread, posted by the transmit complete interrupt */
+static void EMAC_TxCleanCallback(void *arg)
+{
+    (void)arg;
+
+    tx_clean_posted = 0;
+    EMAC_CleanTxRing();
+}
+
+/**
+  * Block the caller until the tx ring has a free descriptor.
+  * The sender is woken up by the transmit complete interrupt.
+  * @param[in] timeout_ms  Longest time to wait in milliseconds.
+  * @return 0 if a descriptor is free, -1 on timeout.
+  */
+int32_t EMAC_WaitTxSpace(uint32_t timeout_ms)
+{
+    GMACdev.synopGMACNetStats.tx_ring_full++;
+
+    /* Arm the wake-up before checking, so a completion in between is not missed */
+    tx_waiting = 1;
+    EMAC_CleanTxRing();
+    if(tx_pending < GMACdev.TxDescCount)
+    {
+        tx_waiting = 0;
+        return 0;
+    }
+
+    if(sys_arch_sem_wait(&xTxSemaphore, timeout_ms) == SYS_ARCH_TIMEOUT)
+    {
+        tx_waiting = 0;
+        GMACdev.synopGMACNetStats.tx_ring_timeout++;
+        return -1;
+    }
+
+    return 0;
+}
+
+struct net_device_stats* EMAC_GetStats(void)
+{
+    return &GMACdev.synopGMACNetStats;
 }
 
 uint8_t* EMAC_AllocatePktBuf(void)
@@ -368,8 +888,114 @@ int32_t EMAC_TransmitPkt(uint8_t *pbuf, uint32_t len)
 #else
         offload_needed = 0;
 #endif
-        return synopGMAC_xmit_frames(&GMACdev, pbuf, len, offload_needed, 0);
+        EMAC_CleanTxRing();
+        if(synopGMAC_xmit_frames(&GMACdev, pbuf, len, offload_needed, 0) < 0)
+            return -1;
+        tx_pending++;
+        return 0;
     }
 
     return -1;
 }
+
+/**
+  * Transmit a pbuf chain without copying it.
+  * Each pbuf of the chain is mapped onto its own tx descriptor. A pbuf which GMAC DMA cannot
+  * reach (e.g. PBUF_ROM data in flash), or whose data may change once this call returns
+  * (PBUF_REF), is copied into the bounce buffer of its descriptor.
+  * The chain is referenced until DMA is done with it, and released in tcpip_thread after the
+  * transmit complete interrupt, or by a later call.
+  * If the ring has not enough free descriptors for the chain, the whole frame is copied into
+  * one bounce buffer instead.
+  * @param[in] p  pbuf chain holding the frame.
+  * @return 0 on success, -1 if no tx descriptor is available.
+  *         The caller may wait with EMAC_WaitTxSpace() and try again.
+  *         -2 if a descriptor the driver counted as free is still in use. Nothing is queued
+  *         and waiting will not help, the frame should be dropped.
+  */
+int32_t EMAC_TransmitPbuf(struct pbuf *p)
+{
+    struct pbuf *q;
+    u32 offload_needed, nseg, first_idx, pending, len = 0;
+    s32 idx = -1;
+    u8 *buf;
+
+    SYS_ARCH_DECL_PROTECT(old_level);
+
+#if defined(USING_HW_CHECKSUM)
+    offload_needed = 1;
+#else
+    offload_needed = 0;
+#endif
+
+    EMAC_CleanTxRing();
+
+    for(q = p, nseg = 0; q != NULL; q = q->next)
+    {
+        if(q->len > 0)
+            nseg++;
+    }
+
+    if(nseg == 0)
+        return 0;               /* Nothing to send */
+
+    if(tx_pending >= GMACdev.TxDescCount)
+        return -1;
+
+    if(nseg > GMACdev.TxDescCount - tx_pending)
+    {
+        /* Ring is short of descriptors. Fall back to copy the frame into one bounce buffer. */
+        buf = EMAC_AllocatePktBuf();
+        for(q = p; q != NULL; q = q->next)
+        {
+            memcpy(&buf[len], q->payload, q->len);
+            len += q->len;
+        }
+        return EMAC_TransmitPkt(buf, len);
+    }
+
+    /* The frame is referenced by its last descriptor until transmitted */
+    pbuf_ref(p);
+
+    SYS_ARCH_PROTECT(old_level);
+    first_idx = GMACdev.TxNext;
+    pending = tx_pending;
+    for(q = p; q != NULL; q = q->next)
+    {
+        if(q->len == 0)
+            continue;           /* An empty descriptor would look like a free one */
+
+        nseg--;
+        if(!PBUF_NEEDS_COPY(q) && EMAC_IS_DMA_ELIGIBLE(q->payload, q->len))
+        {
+            buf = q->payload;
+        }
+        else
+        {
+            buf = EMAC_AllocatePktBuf();
+            memcpy(buf, q->payload, q->len);
+        }
+
+        idx = synopGMAC_set_tx_qptr_seg(&GMACdev, (u32)buf, q->len, (len == 0), (nseg == 0), offload_needed, 0);
+        if(idx < 0)
+        {
+            /* DMA has not seen any of it, the first descriptor is still ours */
+            synopGMAC_cancel_tx_qptr_seg(&GMACdev, first_idx);
+            tx_pending = pending;
+            SYS_ARCH_UNPROTECT(old_level);
+            pbuf_free(p);
+            return -2;
+        }
+        len += q->len;
+        tx_pending++;
+    }
+
+    tx_pbuf[idx] = p;
+
+    synopGMAC_set_tx_owner(&GMACdev, first_idx);
+    SYS_ARCH_UNPROTECT(old_level);
+
+    synopGMAC_resume_dma_tx(&GMACdev);
+
+    return 0;
+}
@@ -12,9 +12,98 @@
 #include "NuMicro.h"
 #include "synopGMAC_network_interface.h"
 
+/* GMAC DMA can only access SRAM. Frame data outside of it has to be copied before transmitted. */
+#ifndef EMAC_DMA_SRAM_SIZE
+#define EMAC_DMA_SRAM_SIZE      0x80000
+#endif
+#define EMAC_IS_DMA_ELIGIBLE(addr, len)     (((uint32_t)(addr) >= SRAM_BASE) && \
+                                             ((uint32_t)(addr) + (len) <= SRAM_BASE + EMAC_DMA_SRAM_SIZE))
+
+/* How long a sender blocks on a full tx ring before the frame is dropped */
+#ifndef EMAC_TX_WAIT_MS
+#define EMAC_TX_WAIT_MS         10
+#endif
+
+/* Rx interrupt watchdog in units of 256 HCLK cycles (max 255). 0 raises one interrupt per frame. */
+#ifndef EMAC_RX_INT_WDT
+#define EMAC_RX_INT_WDT         0
+#endif
+
+/* Small rx pool. A frame up to the copy break length is copied into it and its DMA buffer is
+   given back to the ring at once, instead of being held by lwIP for a 64 byte ACK. */
+#ifndef EMAC_RX_SMALL_SIZE
+#define EMAC_RX_SMALL_SIZE      128
+#endif
+#ifndef EMAC_RX_SMALL_NUM
+#define EMAC_RX_SMALL_NUM       32
+#endif
+
+/* Attribute placing the DMA frame buffers, e.g. __attribute__((section(".sram2"))) for another SRAM bank */
+#ifndef EMAC_DMA_BUF_ATTR
+#define EMAC_DMA_BUF_ATTR
+#endif
+
+typedef struct
+{
+    uint32_t u32TxDescNum;      /*!< Tx descriptors in use, 1 ~ TRANSMIT_DESC_SIZE */
+    uint32_t u32RxDescNum;      /*!< Rx descriptors in use, 1 ~ RECEIVE_DESC_SIZE */
+    uint32_t u32RxCopyBreak;    /*!< Rx frames up to this length use the small pool, 0 ~ EMAC_RX_SMALL_SIZE. 0 disables it */
+} EMAC_CONFIG_T;
+
+typedef struct
+{
+    uint32_t u32Size;           /*!< Buffers in the pool */
+    uint32_t u32Used;           /*!< Buffers held by lwIP */
+    uint32_t u32HighWater;      /*!< Most buffers held by lwIP at once */
+    uint32_t u32Starved;        /*!< Times a frame found the pool empty */
+    uint32_t u32Dropped;        /*!< Frames dropped for lack of a buffer or refused by lwIP */
+} EMAC_POOL_STATS_T;
+
+#define EMAC_RX_POOL_LARGE      0   /*!< Zero-copy pool of full size DMA buffers (memp_emac_rx) */
+#define EMAC_RX_POOL_SMALL      1   /*!< Copy break pool (memp_emac_rx_small) */
+
+/* Multicast addresses tracked by the rx filter. The first EMAC_PERFECT_FILTER_NUM get a perfect
+   match address register (GmacAddr1 ~), the others share the 64-bin hash table. */
+#ifndef EMAC_MCAST_FILTER_NUM
+#define EMAC_MCAST_FILTER_NUM   16
+#endif
+#ifndef EMAC_PERFECT_FILTER_NUM
+#define EMAC_PERFECT_FILTER_NUM 4
+#endif
+
+typedef struct
+{
+    uint32_t u32Passed;         /*!< Multicast frames handed to lwIP */
+    uint32_t u32HwDropped;      /*!< Multicast frames dropped by the GMAC address filter */
+    uint32_t u32SwDropped;      /*!< Multicast frames passed by a hash collision and dropped by the driver */
+} EMAC_MCAST_STATS_T;
+
+/* Receive checksum errors. With DmaDisableDropTcpCs clear (the default) the GMAC drops bad
+   frames itself and only its MMC counters see them; with it set the driver drops them. */
+typedef struct
+{
+    uint32_t u32IpHeader;       /*!< IPv4 header checksum errors, MMC */
+    uint32_t u32Tcp;            /*!< TCP checksum errors, MMC */
+    uint32_t u32Udp;            /*!< UDP checksum errors, MMC */
+    uint32_t u32Icmp;           /*!< ICMP checksum errors, MMC */
+    uint32_t u32SwDropped;      /*!< Frames with a checksum error dropped by the driver */
+} EMAC_CSUM_STATS_T;
+
+struct pbuf;
+
+void EMAC_Config(const EMAC_CONFIG_T *psConfig);
 void EMAC_Open(uint8_t *macaddr);
-uint32_t EMAC_ReceivePkt(void);
+int32_t  EMAC_ReceivePkt(void);
+void     EMAC_EnableRxInt(void);
 int32_t  EMAC_TransmitPkt(uint8_t *pbuf, uint32_t len);
 uint8_t* EMAC_AllocatePktBuf(void);
+int32_t  EMAC_TransmitPbuf(struct pbuf *p);
+int32_t  EMAC_WaitTxSpace(uint32_t timeout_ms);
+struct net_device_stats* EMAC_GetStats(void);
+const EMAC_POOL_STATS_T* EMAC_GetRxPoolStats(uint32_t u32Pool);
+int32_t  EMAC_AddMulticastFilter(const uint8_t *pu8Mac);
+int32_t  EMAC_DelMulticastFilter(const uint8_t *pu8Mac);
+void     EMAC_GetMcastStats(EMAC_MCAST_STATS_T *psStats);
+void     EMAC_GetCsumStats(EMAC_CSUM_STATS_T *psStats);
 
 #endif  /* __M460_EMAC_H__ */
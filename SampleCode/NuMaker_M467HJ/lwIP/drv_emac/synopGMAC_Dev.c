@@ -1635,6 +1635,101 @@ s32 synopGMAC_set_tx_qptr(synopGMACdevice *gmacdev, u32 Buffer1, u32 Length1, u3
     return txnext;
 }
 
+/**
+  * Populate one tx desc structure with a segment of a frame spread over several descriptors.
+  * This is the scatter-gather variant of synopGMAC_set_tx_qptr(). The caller marks the first and
+  * the last segment of the frame. Every segment but the first is handed over to DMA right away,
+  * the first one is left to the caller, who passes it to synopGMAC_set_tx_owner() after the whole
+  * frame is queued, so that DMA never starts on a partially queued frame.
+  * Checksum offloading and timestamp control only take effect in the first segment.
+  * @param[in] pointer to synopGMACdevice.
+  * @param[in] Dma-able buffer1 pointer.
+  * @param[in] length of buffer1 (Max is 2048).
+  * @param[in] u32 non-zero if this is the first segment of the frame.
+  * @param[in] u32 non-zero if this is the last segment of the frame.
+  * @param[in] u32 indicating whether the checksum offloading in HW/SW.
+  * @param[in] u32 indicating whether to timestamp the frame.
+  * \return returns present tx descriptor index on success. Negative value if error.
+  */
+s32 synopGMAC_set_tx_qptr_seg(synopGMACdevice *gmacdev, u32 Buffer1, u32 Length1, u32 first, u32 last, u32 offload_needed, u32 ts)
+{
+    u32  txnext      = gmacdev->TxNext;
+#ifdef CACHE_ON
+    DmaDesc *txdesc = (DmaDesc *)((u32)(gmacdev->TxNextDesc) | UNCACHEABLE);
+#else
+    DmaDesc *txdesc = gmacdev->TxNextDesc;
+#endif
+    if(!synopGMAC_is_desc_empty(txdesc))
+        return -1;
+
+    (gmacdev->BusyTxDesc)++; //busy tx descriptor is incremented by one as it will be handed over to DMA
+
+    txdesc->length |= ((Length1 << DescSize1Shift) & DescSize1Mask);
+
+    if(first)
+        txdesc->status |= (DescTxFirst | (ts == 1 ? DescTxTSEnable : 0));
+    if(last)
+        txdesc->status |= (DescTxLast | DescTxIntEnable);
+
+    txdesc->buffer1 = Buffer1;
+
+    if(first && offload_needed)
+        synopGMAC_tx_checksum_offload_tcp_pseudo(gmacdev, txdesc);
+    else
+        synopGMAC_tx_checksum_offload_bypass(gmacdev, txdesc);
+
+    if(!first)
+        txdesc->status |= DescOwnByDma;
+
+    gmacdev->TxNext = synopGMAC_is_last_tx_desc(gmacdev, txdesc) ? 0 : txnext + 1;
+    gmacdev->TxNextDesc = synopGMAC_is_last_tx_desc(gmacdev, txdesc) ? gmacdev->TxDesc : (txdesc + 1);
+
+    TR("(seg)%02d %08x %08x %08x %08x %08x\n", txnext, (u32)txdesc, txdesc->status, txdesc->length, txdesc->buffer1, txdesc->buffer2);
+    return txnext;
+}
+
+/**
+  * Hand the first tx descriptor of a scatter-gather frame over to DMA.
+  * @param[in] pointer to synopGMACdevice.
+  * @param[in] index of the tx descriptor returned by synopGMAC_set_tx_qptr_seg() for the first segment.
+  * \return returns void.
+  */
+void synopGMAC_set_tx_owner(synopGMACdevice *gmacdev, u32 index)
+{
+#ifdef CACHE_ON
+    DmaDesc *txdesc = (DmaDesc *)((u32)(gmacdev->TxDesc + index) | UNCACHEABLE);
+#else
+    DmaDesc *txdesc = gmacdev->TxDesc + index;
+#endif
+    txdesc->status |= DescOwnByDma;
+}
+
+/**
+  * Take back the tx descriptors of a scatter-gather frame that could not be queued completely.
+  * Descriptors from index up to TxNext are reset and TxNext goes back to index. Must be called
+  * before synopGMAC_set_tx_owner() for the frame, so DMA stops at its first descriptor.
+  * @param[in] pointer to synopGMACdevice.
+  * @param[in] index TxNext had before the first segment of the frame was queued.
+  * \return returns void.
+  */
+void synopGMAC_cancel_tx_qptr_seg(synopGMACdevice *gmacdev, u32 index)
+{
+    DmaDesc *txdesc;
+
+    while(gmacdev->TxNext != index)
+    {
+        gmacdev->TxNext = (gmacdev->TxNext == 0) ? gmacdev->TxDescCount - 1 : gmacdev->TxNext - 1;
+#ifdef CACHE_ON
+        txdesc = (DmaDesc *)((u32)(gmacdev->TxDesc + gmacdev->TxNext) | UNCACHEABLE);
+#else
+        txdesc = gmacdev->TxDesc + gmacdev->TxNext;
+#endif
+        synopGMAC_tx_desc_init_ring(txdesc, gmacdev->TxNext == gmacdev->TxDescCount - 1);
+        (gmacdev->BusyTxDesc)--;
+    }
+    gmacdev->TxNextDesc = gmacdev->TxDesc + index;
+}
+
 /**
   * Prepares the descriptor to receive packets.
   * The descriptor is allocated with the valid buffer addresses (sk_buff address) and the length fields
@@ -1675,7 +1770,7 @@ s32 synopGMAC_set_rx_qptr(synopGMACdevice *gmacdev, u32 Buffer1, u32 Length1, u3
     rxdesc->buffer2 = 0;
     //rxdesc->data2 = 0;
 
-    if((rxnext % MODULO_INTERRUPT) != 0)
+    if(((rxnext % MODULO_INTERRUPT) != 0) || (gmacdev->RxIntWdt != 0))
         rxdesc->length |= RxDisIntCompl;
 
     rxdesc->status = DescOwnByDma;
@@ -1812,6 +1907,22 @@ void synopGMAC_enable_interrupt(synopGMACdevice *gmacdev, u32 interrupts)
     return;
 }
 
+/**
+  * Coalesce receive interrupts with the receive interrupt watchdog.
+  * With a non zero value the completion interrupt is disabled in every rx descriptor queued
+  * afterwards, and the receive interrupt is raised once the watchdog expires after a frame.
+  * Should be called before the rx descriptors are handed to DMA.
+  * @param[in] pointer to synopGMACdevice.
+  * @param[in] watchdog in units of 256 HCLK cycles (max 255), 0 disables coalescing.
+  * \return returns void.
+  */
+void synopGMAC_set_rx_int_wdt(synopGMACdevice *gmacdev, u32 riwt)
+{
+    gmacdev->RxIntWdt = riwt & 0xFF;
+    synopGMACWriteReg(gmacdev->DmaBase, DmaRxIntWdt, gmacdev->RxIntWdt);
+    return;
+}
+
 void synopGMAC_get_ie(synopGMACdevice *gmacdev)
 {
     synopGMACReadReg(gmacdev->DmaBase, DmaInterrupt);
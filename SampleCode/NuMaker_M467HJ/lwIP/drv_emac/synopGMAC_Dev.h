@@ -54,8 +54,12 @@ enum GMACPhyBase
 #define DMABASE 0x1000          // Dma base address starts with an offset 0x1000
 
 
-#define TRANSMIT_DESC_SIZE          16 //Tx Descriptors needed in the Descriptor pool/queue
-#define RECEIVE_DESC_SIZE           32 //Rx Descriptors needed in the Descriptor pool/queue
+#ifndef TRANSMIT_DESC_SIZE
+#define TRANSMIT_DESC_SIZE          16 //Tx Descriptors needed in the Descriptor pool/queue, upper limit of EMAC_Config()
+#endif
+#ifndef RECEIVE_DESC_SIZE
+#define RECEIVE_DESC_SIZE           32 //Rx Descriptors needed in the Descriptor pool/queue, upper limit of EMAC_Config()
+#endif
 
 #define ETHERNET_HEADER             14  //6 byte Dest addr, 6 byte Src addr, 2 byte length/type
 #define ETHERNET_CRC                 4  //Ethernet CRC
@@ -128,6 +132,8 @@ struct net_device_stats
     u32 tx_ip_header_errors;
     u32 tx_ip_payload_errors;
     u32 collisions;
+    u32 tx_ring_full;          /* transmit found no free descriptor and had to wait */
+    u32 tx_ring_timeout;       /* frame dropped because the ring stayed full */
     u32 rx_bytes;
     u32 rx_packets;
     u32 rx_errors;
@@ -138,6 +144,14 @@ struct net_device_stats
     u32 rx_over_errors;
     u32 rx_ip_header_errors;
     u32 rx_ip_payload_errors;
+    u32 rx_interrupts;         /* receive interrupts that woke the rx thread */
+    u32 rx_polls;              /* passes of the rx thread over the rx ring */
+    u32 rx_budget_exhausted;   /* passes which stopped at the budget with frames left */
+    u32 rx_poll_mode;          /* switches from interrupt to polling mode */
+    u32 rx_multicast;          /* multicast frames passed by the GMAC address filter */
+    u32 rx_mcast_sw_dropped;   /* multicast frames passed by a hash collision and dropped by the driver */
+    u32 rx_ring_full;          /* frames dropped because tcpip_thread had ETH_RX_RING_SIZE frames queued */
+    u32 rx_csum_sw_dropped;    /* frames with a checksum error dropped by the driver */
     volatile u32 ts_int;
 };
 
@@ -169,6 +183,8 @@ typedef struct synopGMACDeviceStruct
     DmaDesc *RxBusyDesc;           /* Rx Descriptor address corresponding to the index TxBusy */
     DmaDesc *RxNextDesc;           /* Rx Descriptor address corresponding to the index RxNext */
 
+    u32  RxIntWdt;                 /* Rx interrupt watchdog in units of 256 HCLK, 0 for an interrupt per frame */
+
     struct net_device_stats synopGMACNetStats;
 
     /*Phy related stuff*/
@@ -183,6 +199,7 @@ typedef struct synopGMACDeviceStruct
     u32 tx_subsec;
     u32 rx_sec;
     u32 rx_subsec;
+    u32 rx_csum_err;     /* Checksum offload engine found an error in the last received frame */
 
     u32 GMAC_Power_down;
     u8 mac_addr[8];
@@ -666,6 +683,7 @@ enum DmaRegisters
     DmaControl        = 0x0018,    /* CSR6 - Dma Operation Mode Register                */
     DmaInterrupt      = 0x001C,    /* CSR7 - Interrupt enable                           */
     DmaMissedFr       = 0x0020,    /* CSR8 - Missed Frame & Buffer overflow Counter     */
+    DmaRxIntWdt       = 0x0024,    /* CSR9 - Receive Interrupt Watchdog Timer           */
     DmaTxCurrDesc     = 0x0048,    /*      - Current host Tx Desc Register              */
     DmaRxCurrDesc     = 0x004C,    /*      - Current host Rx Desc Register              */
     DmaTxCurrAddr     = 0x0050,    /* CSR20 - Current host transmit buffer address      */
@@ -1640,6 +1658,9 @@ void synopGMAC_get_desc_data(DmaDesc *desc, u32 *Status, u32 *Buffer1, u32 *Leng
 s32 synopGMAC_get_tx_qptr(synopGMACdevice *gmacdev, u32 *Status, u32 *Buffer1, u32 *Length1, u32 *Data1, u32 *Ext_Status, u32 *Time_Stamp_High, u32 *Time_Stamp_low);
 
 s32 synopGMAC_set_tx_qptr(synopGMACdevice *gmacdev, u32 Buffer1, u32 Length1, u32 Data1, u32 offload_needed, u32 ts);
+s32 synopGMAC_set_tx_qptr_seg(synopGMACdevice *gmacdev, u32 Buffer1, u32 Length1, u32 first, u32 last, u32 offload_needed, u32 ts);
+void synopGMAC_set_tx_owner(synopGMACdevice *gmacdev, u32 index);
+void synopGMAC_cancel_tx_qptr_seg(synopGMACdevice *gmacdev, u32 index);
 s32 synopGMAC_set_rx_qptr(synopGMACdevice *gmacdev, u32 Buffer1, u32 Length1, u32 Data1);
 
 s32 synopGMAC_get_rx_qptr(synopGMACdevice *gmacdev, u32 *Status, u32 *Buffer1, u32 *Length1, u32 *Data1, u32 *Ext_Status, u32 *Time_Stamp_High, u32 *Time_Stamp_low);
@@ -1648,6 +1669,7 @@ void synopGMAC_clear_interrupt(synopGMACdevice *gmacdev);
 u32 synopGMAC_get_interrupt_type(synopGMACdevice *gmacdev);
 u32 synopGMAC_get_interrupt_mask(synopGMACdevice *gmacdev);
 void synopGMAC_enable_interrupt(synopGMACdevice *gmacdev, u32 interrupts);
+void synopGMAC_set_rx_int_wdt(synopGMACdevice *gmacdev, u32 riwt);
 void synopGMAC_disable_interrupt_all(synopGMACdevice *gmacdev);
 void synopGMAC_disable_interrupt(synopGMACdevice *gmacdev, u32 interrupts);
 void synopGMAC_enable_dma_rx(synopGMACdevice *gmacdev);
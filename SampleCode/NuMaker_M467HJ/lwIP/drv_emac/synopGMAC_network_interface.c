@@ -343,6 +343,13 @@ void synop_handle_transmit_over(synopGMACdevice *gmacdev)
         {
             TR("Finished Transmit at Tx Descriptor %d for buffer = %08x whose status is %08x \n", desc_index, dma_addr1, status);
 
+            /* A scatter-gather frame spans several descriptors, only the last one has its status */
+            if (!(status & DescTxLast))
+            {
+                gmacdev->synopGMACNetStats.tx_bytes += length1;
+                continue;
+            }
+
             if (synopGMAC_is_tx_ipv4header_checksum_error(gmacdev, status))
             {
                 TR("Harware Failed to Insert IPV4 Header Checksum\n");
@@ -382,6 +389,82 @@ void synop_handle_transmit_over(synopGMACdevice *gmacdev)
     while (desc_index >= 0);
 }
 
+/**
+ * Decode the checksum offload status of a received frame.
+ * Counts IP header and payload checksum errors and sets gmacdev->rx_csum_err.
+ * @param[in] pointer to synopGMACdevice.
+ * @param[in] RDES0 of the frame.
+ * @param[in] RDES4 of the frame.
+ * \return void.
+ */
+static void synop_rx_csum_status(synopGMACdevice *gmacdev, u32 status, u32 ext_status)
+{
+    TR("Checksum Offloading will be done now\n");
+    gmacdev->rx_csum_err = 0;
+
+    if (synopGMAC_is_ext_status(gmacdev, status))  // extended status present indicates that the RDES4 need to be probed
+    {
+        TR("Extended Status present\n");
+        if (synopGMAC_ES_is_IP_header_error(gmacdev, ext_status))      // IP header (IPV4) checksum error
+        {
+            //Linux Kernel doesnot care for ipv4 header checksum. So we will simply proceed by printing a warning ....
+            TR("(EXTSTS)Error in IP header error\n");
+            gmacdev->synopGMACNetStats.rx_ip_header_errors++;
+            gmacdev->rx_csum_err = 1;
+        }
+        if (synopGMAC_ES_is_rx_checksum_bypassed(gmacdev, ext_status))  // Hardware engine bypassed the checksum computation/checking
+        {
+            TR("(EXTSTS)Hardware bypassed checksum computation\n");
+        }
+        if (synopGMAC_ES_is_IP_payload_error(gmacdev, ext_status))      // IP payload checksum is in error (UDP/TCP/ICMP checksum error)
+        {
+            TR("(EXTSTS) Error in EP payload\n");
+            gmacdev->synopGMACNetStats.rx_ip_payload_errors++;
+            gmacdev->rx_csum_err = 1;
+        }
+    }
+    else     // No extended status. So relevant information is available in the status itself
+    {
+        if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxNoChkError)
+        {
+            TR("Ip header and TCP/UDP payload checksum Bypassed <Chk Status = 4>  \n");
+        }
+        if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxIpHdrChkError)
+        {
+            //Linux Kernel doesnot care for ipv4 header checksum. So we will simply proceed by printing a warning ....
+            TR(" Error in 16bit IPV4 Header Checksum <Chk Status = 6>  \n");
+            gmacdev->synopGMACNetStats.rx_ip_header_errors++;
+            gmacdev->rx_csum_err = 1;
+        }
+        if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxLenLT600)
+        {
+            TR("IEEE 802.3 type frame with Length field Lesss than 0x0600 <Chk Status = 0> \n");
+        }
+        if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxIpHdrPayLoadChkBypass)
+        {
+            TR("Ip header and TCP/UDP payload checksum Bypassed <Chk Status = 1>\n");
+        }
+        if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxChkBypass)
+        {
+            TR("Ip header and TCP/UDP payload checksum Bypassed <Chk Status = 3>  \n");
+        }
+        if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxPayLoadChkError)
+        {
+            TR(" TCP/UDP payload checksum Error <Chk Status = 5>  \n");
+            gmacdev->synopGMACNetStats.rx_ip_payload_errors++;
+            gmacdev->rx_csum_err = 1;
+        }
+        if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxIpHdrPayLoadChkError)
+        {
+            //Linux Kernel doesnot care for ipv4 header checksum. So we will simply proceed by printing a warning ....
+            TR(" Both IP header and Payload Checksum Error <Chk Status = 7>  \n");
+            gmacdev->synopGMACNetStats.rx_ip_header_errors++;
+            gmacdev->synopGMACNetStats.rx_ip_payload_errors++;
+            gmacdev->rx_csum_err = 1;
+        }
+    }
+}
+
 /**
  * Function to Receive a packet from the interface.
  * After Receiving a packet, DMA transfers the received packet to the system memory
@@ -391,7 +474,8 @@ void synop_handle_transmit_over(synopGMACdevice *gmacdev)
  *  - Updataes the networking interface statistics
  *  - Keeps track of the rx descriptors
  * @param[in] pointer to net_device structure.
- * \return void.
+ * @param[out] buffer of the frame, also set for a bad frame.
+ * \return frame length, 0 if no frame is ready, -1 for a bad frame whose buffer has to be given back.
  * \note This function runs in interrupt context.
  */
 extern DmaDesc *prevtx;   // for CRC test
@@ -436,64 +520,8 @@ s32 synop_handle_received_data(synopGMACdevice *gmacdev, PKT_FRAME_T **ppsPktFra
                 When CHECKSUM_UNNECESSARY is set kernel bypasses the checksum computation.
             */
 
-            TR("Checksum Offloading will be done now\n");
+            synop_rx_csum_status(gmacdev, status, ext_status);
 
-            if (synopGMAC_is_ext_status(gmacdev, status))  // extended status present indicates that the RDES4 need to be probed
-            {
-                TR("Extended Status present\n");
-                if (synopGMAC_ES_is_IP_header_error(gmacdev, ext_status))      // IP header (IPV4) checksum error
-                {
-                    //Linux Kernel doesnot care for ipv4 header checksum. So we will simply proceed by printing a warning ....
-                    TR("(EXTSTS)Error in IP header error\n");
-                    gmacdev->synopGMACNetStats.rx_ip_header_errors++;
-                }
-                if (synopGMAC_ES_is_rx_checksum_bypassed(gmacdev, ext_status))  // Hardware engine bypassed the checksum computation/checking
-                {
-                    TR("(EXTSTS)Hardware bypassed checksum computation\n");
-                }
-                if (synopGMAC_ES_is_IP_payload_error(gmacdev, ext_status))      // IP payload checksum is in error (UDP/TCP/ICMP checksum error)
-                {
-                    TR("(EXTSTS) Error in EP payload\n");
-                    gmacdev->synopGMACNetStats.rx_ip_payload_errors++;
-                }
-            }
-            else     // No extended status. So relevant information is available in the status itself
-            {
-                if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxNoChkError)
-                {
-                    TR("Ip header and TCP/UDP payload checksum Bypassed <Chk Status = 4>  \n");
-                }
-                if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxIpHdrChkError)
-                {
-                    //Linux Kernel doesnot care for ipv4 header checksum. So we will simply proceed by printing a warning ....
-                    TR(" Error in 16bit IPV4 Header Checksum <Chk Status = 6>  \n");
-                    gmacdev->synopGMACNetStats.rx_ip_header_errors++;
-                }
-                if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxLenLT600)
-                {
-                    TR("IEEE 802.3 type frame with Length field Lesss than 0x0600 <Chk Status = 0> \n");
-                }
-                if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxIpHdrPayLoadChkBypass)
-                {
-                    TR("Ip header and TCP/UDP payload checksum Bypassed <Chk Status = 1>\n");
-                }
-                if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxChkBypass)
-                {
-                    TR("Ip header and TCP/UDP payload checksum Bypassed <Chk Status = 3>  \n");
-                }
-                if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxPayLoadChkError)
-                {
-                    TR(" TCP/UDP payload checksum Error <Chk Status = 5>  \n");
-                    gmacdev->synopGMACNetStats.rx_ip_payload_errors++;
-                }
-                if (synopGMAC_is_rx_checksum_error(gmacdev, status) == RxIpHdrPayLoadChkError)
-                {
-                    //Linux Kernel doesnot care for ipv4 header checksum. So we will simply proceed by printing a warning ....
-                    TR(" Both IP header and Payload Checksum Error <Chk Status = 7>  \n");
-                    gmacdev->synopGMACNetStats.rx_ip_header_errors++;
-                    gmacdev->synopGMACNetStats.rx_ip_payload_errors++;
-                }
-            }
             *ppsPktFrame = (PKT_FRAME_T *)dma_addr1;
 #if 0
 #ifdef CACHE_ON
@@ -535,6 +563,13 @@ s32 synop_handle_received_data(synopGMACdevice *gmacdev, PKT_FRAME_T **ppsPktFra
             gmacdev->synopGMACNetStats.rx_crc_errors    += synopGMAC_is_rx_crc(status);
             gmacdev->synopGMACNetStats.rx_frame_errors  += synopGMAC_is_frame_dribbling_errors(status);
             gmacdev->synopGMACNetStats.rx_length_errors += synopGMAC_is_rx_frame_length_errors(status);
+            /* With DT set, checksum errors end here too: ES covers RDES4 */
+            gmacdev->rx_csum_err = 0;
+            if (synopGMAC_is_ext_status(gmacdev, status))
+                synop_rx_csum_status(gmacdev, status, ext_status);
+            /* The descriptor is already reset, the caller has to give the buffer back */
+            *ppsPktFrame = (PKT_FRAME_T *)dma_addr1;
+            return -1;
         }
 
     } //    /*Handle the Receive Descriptors*/
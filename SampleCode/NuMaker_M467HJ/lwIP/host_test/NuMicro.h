@@ -0,0 +1,69 @@
+/*
+ * NuMicro.h for the host build of the lwIP port.
+ *
+ * Only what the EMAC driver, m460_mii.c, sys_arch.c and ethernetif.c use
+ * from the device headers. The GMAC register block is not memory: the
+ * driver reaches it through synopGMACReadReg()/synopGMACWriteReg(), which
+ * lwip_sim.c implements on top of its register model, so EMAC_BASE is only
+ * a tag. The NVIC and BASEPRI are simulated by lwip_sim.c, so the EMAC
+ * interrupt handler runs only when sys_arch_protect() lets it.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __NUMICRO_H__
+#define __NUMICRO_H__
+
+#include <stdint.h>
+
+#define __I         volatile const
+#define __O         volatile
+#define __IO        volatile
+
+#define BIT4        0x00000010UL
+#define BIT5        0x00000020UL
+
+extern uint32_t SystemCoreClock;
+
+/* GMAC register block of lwip_sim.c, MAC at +0, DMA at +0x1000 */
+#define EMAC_BASE           0x40012000UL
+
+/* Everything the host build links lies below 4 GB and is reachable by the model's DMA */
+#define SRAM_BASE           0x00000000UL
+#define EMAC_DMA_SRAM_SIZE  0xFFFFFFFFUL
+
+typedef enum
+{
+    EMAC0_TXRX_IRQn = 66,
+} IRQn_Type;
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+
+uint32_t __get_BASEPRI(void);
+void __set_BASEPRI(uint32_t basePri);
+void __set_BASEPRI_MAX(uint32_t basePri);
+
+#define __ISB()     __asm__ volatile("" ::: "memory")
+#define __DSB()     __asm__ volatile("" ::: "memory")
+#define __DMB()     __asm__ volatile("" ::: "memory")
+
+/* Clocks, resets and pins need nothing on the model */
+#define EMAC0_RST                   0
+#define EMAC0_MODULE                0
+#define SYS_ResetModule(u32ModuleIndex)         ((void)(u32ModuleIndex))
+#define CLK_EnableModuleClock(u32ModuleIdx)     ((void)(u32ModuleIdx))
+
+#define SET_EMAC0_RMII_MDC_PE8()
+#define SET_EMAC0_RMII_MDIO_PE9()
+#define SET_EMAC0_RMII_TXD0_PE10()
+#define SET_EMAC0_RMII_TXD1_PE11()
+#define SET_EMAC0_RMII_TXEN_PE12()
+#define SET_EMAC0_RMII_REFCLK_PC8()
+#define SET_EMAC0_RMII_RXD0_PC7()
+#define SET_EMAC0_RMII_RXD1_PC6()
+#define SET_EMAC0_RMII_CRSDV_PA7()
+#define SET_EMAC0_RMII_RXERR_PA6()
+#define SET_EMAC0_PPS_PB6()
+
+#endif /* __NUMICRO_H__ */
@@ -0,0 +1,58 @@
+/*
+ * FreeRTOS.h for the host build of the lwIP port.
+ *
+ * The kernel API used by sys_arch.c, the driver and the sample threads,
+ * mapped onto the scheduler of lwip_sim.c. FreeRTOSConfig.h comes from
+ * the sample directory, so priorities and the tick rate are the ones the
+ * board runs with.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef long            BaseType_t;
+typedef unsigned long   UBaseType_t;
+typedef uint32_t        TickType_t;
+
+#define portBASE_TYPE   long
+typedef TickType_t      portTickType;
+
+#include "FreeRTOSConfig.h"
+
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_RATE_MS        ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portTICK_PERIOD_MS      portTICK_RATE_MS
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define errQUEUE_FULL           pdFALSE
+#define errQUEUE_EMPTY          pdFALSE
+
+#define tskIDLE_PRIORITY        ((UBaseType_t)0U)
+
+typedef struct rtos_sim_task    *TaskHandle_t;
+typedef struct rtos_sim_queue   *QueueHandle_t;
+typedef QueueHandle_t           SemaphoreHandle_t;
+typedef TaskHandle_t            xTaskHandle;
+typedef QueueHandle_t           xQueueHandle;
+typedef SemaphoreHandle_t       xSemaphoreHandle;
+typedef void (*TaskFunction_t)(void *);
+
+/* configASSERT() of FreeRTOSConfig.h ends here */
+void rtos_sim_fatal(const char *what);
+#define taskDISABLE_INTERRUPTS()    rtos_sim_fatal("configASSERT")
+
+void rtos_sim_yield_from_isr(BaseType_t xSwitchRequired);
+#define portYIELD_FROM_ISR(x)       rtos_sim_yield_from_isr(x)
+#define portEND_SWITCHING_ISR(x)    rtos_sim_yield_from_isr(x)
+
+void *pvPortMalloc(size_t xSize);
+void vPortFree(void *pv);
+
+#endif /* INC_FREERTOS_H */
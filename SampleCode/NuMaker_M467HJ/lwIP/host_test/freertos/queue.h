@@ -0,0 +1,25 @@
+/*
+ * queue.h for the host build of the lwIP port, see FreeRTOS.h.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef INC_QUEUE_H
+#define INC_QUEUE_H
+
+#include "FreeRTOS.h"
+
+QueueHandle_t rtos_sim_queue_create(UBaseType_t uxQueueLength, UBaseType_t uxItemSize, int iMutex);
+BaseType_t rtos_sim_queue_send(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait);
+BaseType_t rtos_sim_queue_send_isr(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken);
+BaseType_t rtos_sim_queue_receive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait);
+
+#define xQueueCreate(len, size)                 rtos_sim_queue_create((len), (size), 0)
+#define xQueueSend(q, item, wait)               rtos_sim_queue_send((q), (item), (wait))
+#define xQueueSendToBack(q, item, wait)         rtos_sim_queue_send((q), (item), (wait))
+#define xQueueSendFromISR(q, item, woken)       rtos_sim_queue_send_isr((q), (item), (woken))
+#define xQueueReceive(q, buf, wait)             rtos_sim_queue_receive((q), (buf), (wait))
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue);
+void vQueueDelete(QueueHandle_t xQueue);
+
+#endif /* INC_QUEUE_H */
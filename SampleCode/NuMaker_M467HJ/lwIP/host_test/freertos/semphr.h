@@ -0,0 +1,28 @@
+/*
+ * semphr.h for the host build of the lwIP port, see FreeRTOS.h.
+ *
+ * Semaphores are queues of zero size items, as in FreeRTOS. A mutex
+ * starts given and has no priority inheritance.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef INC_SEMPHR_H
+#define INC_SEMPHR_H
+
+#include "queue.h"
+
+#define vSemaphoreCreateBinary(xSemaphore)                              \
+    do {                                                                \
+        (xSemaphore) = rtos_sim_queue_create(1, 0, 0);                  \
+        if ((xSemaphore) != NULL)                                       \
+            rtos_sim_queue_send((xSemaphore), NULL, 0);                 \
+    } while (0)
+
+#define xSemaphoreCreateBinary()                rtos_sim_queue_create(1, 0, 0)
+#define xSemaphoreCreateMutex()                 rtos_sim_queue_create(1, 0, 1)
+#define xSemaphoreTake(s, wait)                 rtos_sim_queue_receive((s), NULL, (wait))
+#define xSemaphoreGive(s)                       rtos_sim_queue_send((s), NULL, 0)
+#define xSemaphoreGiveFromISR(s, woken)         rtos_sim_queue_send_isr((s), NULL, (woken))
+#define vSemaphoreDelete(s)                     vQueueDelete(s)
+
+#endif /* INC_SEMPHR_H */
@@ -0,0 +1,30 @@
+/*
+ * task.h for the host build of the lwIP port, see FreeRTOS.h.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+#include "FreeRTOS.h"
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName, uint16_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask);
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+void vTaskDelay(TickType_t xTicksToDelay);
+void vTaskSuspend(TaskHandle_t xTaskToSuspend);
+void vTaskResume(TaskHandle_t xTaskToResume);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+void rtos_sim_task_yield(void);
+#define taskYIELD()             rtos_sim_task_yield()
+
+/* Tasks only switch where they block or wake a higher priority task, and
+   the EMAC interrupt is held off by BASEPRI like on the chip */
+void rtos_sim_enter_critical(void);
+void rtos_sim_exit_critical(void);
+#define taskENTER_CRITICAL()    rtos_sim_enter_critical()
+#define taskEXIT_CRITICAL()     rtos_sim_exit_critical()
+
+#endif /* INC_TASK_H */
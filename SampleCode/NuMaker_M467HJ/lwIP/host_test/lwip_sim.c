@@ -0,0 +1,1429 @@
+/*
+ * Simulated time, FreeRTOS scheduler and GMAC for host tests of the lwIP port.
+ *
+ * The GMAC model implements synopGMACReadReg()/synopGMACWriteReg() in
+ * place of synopGMAC_plat.c. Its DMA walks the 8 word descriptor rings
+ * the driver builds, inserts and checks checksums like the M460 offload
+ * engine, and puts frames on a full duplex wire with one PHY that always
+ * links up at 100 Mbit/s full duplex. See lwip_sim.h.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define _GNU_SOURCE
+#include <malloc.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "NuMicro.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "synopGMAC_Dev.h"
+#include "lwip_sim.h"
+
+#define STACK_SIZE          (256 * 1024)
+#define WATCHDOG_S          300
+#define TICK_NS             (LWIP_SIM_S / configTICK_RATE_HZ)
+#define NEVER               UINT64_MAX
+
+#define REGS_SIZE           0x2000
+#define REG(off)            s_regs[(off) / 4]
+#define DMA(off)            REG(DMABASE + (off))
+#define PTR(a)              ((void *)(uintptr_t)(a))
+
+#define EMAC_IRQ_PRIO       ((uint32_t)s_irq_prio << 4)
+#define ISR_STORM_RUNS      1000
+
+uint32_t SystemCoreClock = 200000000;
+
+void EMAC0_IRQHandler(void);
+
+static lwip_sim_stats_t s_stats;
+static int s_verbose;
+
+/*---------------------------------------------------------------------------*/
+/* Tasks and time                                                            */
+/*---------------------------------------------------------------------------*/
+
+enum { T_READY, T_BLOCKED, T_SUSPENDED, T_DONE };
+
+struct rtos_sim_task
+{
+    ucontext_t ctx;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    unsigned prio;
+    int state;
+    uint64_t seq;                       /* FIFO order among equal priorities */
+    uint64_t wake_ns;                   /* timeout of a blocked task */
+    struct rtos_sim_queue *wait_q;
+    int wait_send, timed_out;
+    uint32_t basepri;
+    int critical;
+    uint64_t cpu_ns;                    /* host CPU time run */
+    struct rtos_sim_task *next;
+};
+
+struct rtos_sim_queue
+{
+    uint8_t *buf;
+    UBaseType_t len, size, count, head;
+};
+
+typedef struct
+{
+    uint64_t t, seq;
+    void (*fn)(void *);
+    void *arg;
+} event_t;
+
+static struct rtos_sim_task *s_tasks, *s_cur, *s_main, *s_last;
+static ucontext_t s_sched_ctx, s_host_ctx;
+static void *s_sched_stack;
+static uint64_t s_now, s_limit, s_seq;
+static int s_result;
+
+static event_t *s_ev;
+static size_t s_nev, s_evcap;
+
+static uint32_t s_basepri;
+static int s_critical, s_in_isr, s_irq_en;
+static uint32_t s_irq_prio;
+
+static int gmac_irq_line(void);
+
+static void *low_alloc(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+    if (p == MAP_FAILED)
+    {
+        perror("lwip_sim: mmap");
+        exit(2);
+    }
+    return p;
+}
+
+void rtos_sim_fatal(const char *what)
+{
+    fflush(stdout);
+    fprintf(stderr, "lwip_sim: %s at %llu ns in %s\n", what, (unsigned long long)s_now,
+            s_in_isr ? "EMAC0_IRQHandler" : s_cur ? s_cur->name : "the scheduler");
+    exit(2);
+}
+
+void lwip_sim_assert(const char *msg, const char *file, int line)
+{
+    char buf[256];
+
+    snprintf(buf, sizeof(buf), "assertion \"%s\" failed at %s:%d", msg, file, line);
+    rtos_sim_fatal(buf);
+}
+
+uint64_t lwip_sim_time_ns(void)
+{
+    return s_now;
+}
+
+const lwip_sim_stats_t *lwip_sim_stats(void)
+{
+    return &s_stats;
+}
+
+void lwip_sim_event_at(uint64_t t_ns, void (*fn)(void *), void *arg)
+{
+    size_t i = s_nev++, up;
+    event_t e = { t_ns < s_now ? s_now : t_ns, s_seq++, fn, arg };
+
+    if (s_nev > s_evcap)
+    {
+        s_evcap = s_evcap ? 2 * s_evcap : 256;
+        s_ev = realloc(s_ev, s_evcap * sizeof(*s_ev));
+    }
+    for (; i > 0; i = up)
+    {
+        up = (i - 1) / 2;
+        if (s_ev[up].t < e.t || (s_ev[up].t == e.t && s_ev[up].seq < e.seq))
+            break;
+        s_ev[i] = s_ev[up];
+    }
+    s_ev[i] = e;
+}
+
+static event_t event_pop(void)
+{
+    event_t top = s_ev[0], last = s_ev[--s_nev];
+    size_t i = 0, c;
+
+    for (;;)
+    {
+        c = 2 * i + 1;
+        if (c >= s_nev)
+            break;
+        if (c + 1 < s_nev && (s_ev[c + 1].t < s_ev[c].t ||
+                              (s_ev[c + 1].t == s_ev[c].t && s_ev[c + 1].seq < s_ev[c].seq)))
+            c++;
+        if (last.t < s_ev[c].t || (last.t == s_ev[c].t && last.seq < s_ev[c].seq))
+            break;
+        s_ev[i] = s_ev[c];
+        i = c;
+    }
+    s_ev[i] = last;
+    return top;
+}
+
+static uint64_t host_cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * LWIP_SIM_S + (uint64_t)ts.tv_nsec;
+}
+
+/* Host CPU time of a task switch there and back, with its measurement:
+ * taken off every run of a task */
+static uint64_t s_switch_ns;
+static ucontext_t s_cal_ctx;
+
+static void cal_task(void)
+{
+    for (;;)
+        swapcontext(&s_cal_ctx, &s_host_ctx);
+}
+
+/* 100 switches to a task that does nothing */
+static uint64_t cal_round(void)
+{
+    uint64_t round = 0, cpu;
+    int j;
+
+    for (j = 0; j < 100; j++)
+    {
+        cpu = host_cpu_ns();
+        swapcontext(&s_host_ctx, &s_cal_ctx);
+        round += host_cpu_ns() - cpu;
+    }
+    return round;
+}
+
+/* The fastest of ten rounds */
+static void cal_switch(void)
+{
+    int i;
+
+    getcontext(&s_cal_ctx);
+    s_cal_ctx.uc_stack.ss_sp = low_alloc(STACK_SIZE);
+    s_cal_ctx.uc_stack.ss_size = STACK_SIZE;
+    makecontext(&s_cal_ctx, cal_task, 0);
+    for (s_switch_ns = ~0ULL, i = 0; i < 10; i++)
+    {
+        uint64_t round = cal_round() / 100;
+
+        if (round < s_switch_ns)
+            s_switch_ns = round;
+    }
+}
+
+uint64_t lwip_sim_task_cpu_ns(const char *name)
+{
+    struct rtos_sim_task *t;
+    uint64_t ns = 0;
+
+    for (t = s_tasks; t; t = t->next)
+    {
+        if (strcmp(t->name, name) == 0)
+            ns += t->cpu_ns;
+    }
+    return ns;
+}
+
+const char *lwip_sim_task_name(void)
+{
+    return s_cur && !s_in_isr ? s_cur->name : NULL;
+}
+
+/* Highest priority ready task, first come first served among equals */
+static struct rtos_sim_task *pick(void)
+{
+    struct rtos_sim_task *t, *best = NULL;
+
+    for (t = s_tasks; t; t = t->next)
+    {
+        if (t->state == T_READY &&
+            (!best || t->prio > best->prio || (t->prio == best->prio && t->seq < best->seq)))
+            best = t;
+    }
+    return best;
+}
+
+static void make_ready(struct rtos_sim_task *t)
+{
+    t->state = T_READY;
+    t->seq = s_seq++;
+    t->wait_q = NULL;
+}
+
+/* Back to the scheduler; BASEPRI and the critical nesting belong to the task */
+static void task_switch(void)
+{
+    struct rtos_sim_task *t = s_cur;
+
+    t->basepri = s_basepri;
+    t->critical = s_critical;
+    swapcontext(&t->ctx, &s_sched_ctx);
+    s_basepri = t->basepri;
+    s_critical = t->critical;
+}
+
+/* Let a higher priority task run, unless an interrupt handler or BASEPRI holds it off */
+static void preempt_check(void)
+{
+    struct rtos_sim_task *t;
+
+    if (s_cur == NULL || s_in_isr || s_basepri != 0)
+        return;
+    t = pick();
+    if (t && t->prio > s_cur->prio)
+        task_switch();
+}
+
+/* Run the EMAC interrupt handler while its line is pending and not masked */
+static void irq_check(void)
+{
+    int runs = 0;
+
+    if (s_in_isr)
+        return;
+    while (s_irq_en && (s_basepri == 0 || EMAC_IRQ_PRIO < s_basepri) && gmac_irq_line())
+    {
+        if (++runs > ISR_STORM_RUNS)
+        {
+            s_stats.isr_storms++;
+            break;
+        }
+        s_in_isr = 1;
+        s_stats.irqs++;
+        EMAC0_IRQHandler();
+        s_in_isr = 0;
+    }
+}
+
+/* After anything that may raise the interrupt or ready a task */
+static void sim_poll(void)
+{
+    irq_check();
+    preempt_check();
+}
+
+static uint64_t tick_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+        return NEVER;
+    return (s_now / TICK_NS + ticks) * TICK_NS;
+}
+
+/* Block the running task on q, or only until wake_ns. Returns -1 on timeout. */
+static int task_block(struct rtos_sim_queue *q, int sender, uint64_t wake_ns)
+{
+    struct rtos_sim_task *t = s_cur;
+
+    if (t == NULL || s_in_isr)
+        rtos_sim_fatal("blocking call outside a task");
+    if (s_basepri != 0)
+        s_stats.masked_blocks++;
+    t->state = T_BLOCKED;
+    t->seq = s_seq++;
+    t->wait_q = q;
+    t->wait_send = sender;
+    t->timed_out = 0;
+    t->wake_ns = wake_ns;
+    task_switch();
+    return t->timed_out ? -1 : 0;
+}
+
+static void task_entry(void)
+{
+    struct rtos_sim_task *t = s_cur;
+
+    t->fn(t->arg);
+    t->state = T_DONE;
+    swapcontext(&t->ctx, &s_sched_ctx);
+}
+
+static struct rtos_sim_task *task_new(TaskFunction_t fn, void *arg, const char *name, unsigned prio)
+{
+    struct rtos_sim_task *t = calloc(1, sizeof(*t)), **pp;
+
+    t->fn = fn;
+    t->arg = arg;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "task");
+    t->prio = prio < configMAX_PRIORITIES ? prio : configMAX_PRIORITIES - 1;
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = low_alloc(STACK_SIZE);
+    t->ctx.uc_stack.ss_size = STACK_SIZE;
+    t->ctx.uc_link = NULL;
+    makecontext(&t->ctx, task_entry, 0);
+    for (pp = &s_tasks; *pp; pp = &(*pp)->next)
+        ;
+    *pp = t;
+    make_ready(t);
+    return t;
+}
+
+static uint64_t next_wake(void)
+{
+    struct rtos_sim_task *t;
+    uint64_t next = s_nev ? s_ev[0].t : NEVER;
+
+    for (t = s_tasks; t; t = t->next)
+    {
+        if (t->state == T_BLOCKED && t->wake_ns < next)
+            next = t->wake_ns;
+    }
+    return next;
+}
+
+static void report_blocked(const char *why)
+{
+    struct rtos_sim_task *t;
+
+    fflush(stdout);
+    fprintf(stderr, "lwip_sim: %s at %llu ns, tasks:", why, (unsigned long long)s_now);
+    for (t = s_tasks; t; t = t->next)
+    {
+        if (t->state == T_BLOCKED || t->state == T_SUSPENDED)
+            fprintf(stderr, " %s(%s)", t->name, t->state == T_BLOCKED ? "blocked" : "suspended");
+    }
+    fprintf(stderr, "\n");
+}
+
+static void sched_loop(void)
+{
+    struct rtos_sim_task *t;
+    uint64_t next, cpu;
+
+    while (s_main->state != T_DONE)
+    {
+        t = pick();
+        if (t)
+        {
+            if (t != s_last)
+                s_stats.switches++;
+            s_last = s_cur = t;
+            s_basepri = t->basepri;
+            s_critical = t->critical;
+            cpu = host_cpu_ns();
+            swapcontext(&s_sched_ctx, &t->ctx);
+            cpu = host_cpu_ns() - cpu;
+            t->cpu_ns += cpu > s_switch_ns ? cpu - s_switch_ns : 0;
+            s_cur = NULL;
+            s_basepri = 0;
+            s_critical = 0;
+            irq_check();
+            continue;
+        }
+
+        /* Every task is blocked: time moves on to what comes first */
+        next = next_wake();
+        if (next == NEVER)
+        {
+            report_blocked("every task is blocked for good");
+            s_result = -1;
+            break;
+        }
+        if (next > s_limit)
+        {
+            report_blocked("time limit");
+            s_result = -1;
+            break;
+        }
+        if (next > s_now)
+            s_now = next;
+        for (t = s_tasks; t; t = t->next)
+        {
+            if (t->state == T_BLOCKED && t->wake_ns <= s_now)
+            {
+                t->timed_out = 1;
+                make_ready(t);
+            }
+        }
+        while (s_nev && s_ev[0].t <= s_now)
+        {
+            event_t e = event_pop();
+
+            e.fn(e.arg);
+            irq_check();
+        }
+    }
+}
+
+static void sim_init(void);
+
+int lwip_sim_run(void (*main_fn)(void *), void *arg, unsigned prio, uint64_t limit_ns)
+{
+    sim_init();
+    s_main = task_new(main_fn, arg, "main", prio);
+    s_limit = s_now + limit_ns;
+    s_result = 0;
+
+    getcontext(&s_sched_ctx);
+    s_sched_ctx.uc_stack.ss_sp = s_sched_stack;
+    s_sched_ctx.uc_stack.ss_size = STACK_SIZE;
+    s_sched_ctx.uc_link = &s_host_ctx;
+    makecontext(&s_sched_ctx, sched_loop, 0);
+    swapcontext(&s_host_ctx, &s_sched_ctx);
+
+    return s_result;
+}
+
+void lwip_sim_sleep_until(uint64_t t_ns)
+{
+    if (t_ns > s_now)
+        task_block(NULL, 0, t_ns);
+}
+
+/*---------------------------------------------------------------------------*/
+/* FreeRTOS                                                                  */
+/*---------------------------------------------------------------------------*/
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName, uint16_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+    struct rtos_sim_task *t = task_new(pxTaskCode, pvParameters, pcName, (unsigned)uxPriority);
+
+    if (pxCreatedTask)
+        *pxCreatedTask = t;
+    preempt_check();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    struct rtos_sim_task *t = xTaskToDelete ? xTaskToDelete : s_cur;
+
+    t->state = T_DONE;
+    if (t == s_cur)
+        task_switch();
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    if (xTicksToDelay == 0)
+        rtos_sim_task_yield();
+    else
+        task_block(NULL, 0, tick_deadline(xTicksToDelay));
+}
+
+void vTaskSuspend(TaskHandle_t xTaskToSuspend)
+{
+    struct rtos_sim_task *t = xTaskToSuspend ? xTaskToSuspend : s_cur;
+
+    t->state = T_SUSPENDED;
+    t->wait_q = NULL;
+    if (t == s_cur)
+        task_switch();
+}
+
+void vTaskResume(TaskHandle_t xTaskToResume)
+{
+    if (xTaskToResume->state == T_SUSPENDED)
+    {
+        make_ready(xTaskToResume);
+        preempt_check();
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(s_now / TICK_NS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_cur;
+}
+
+void rtos_sim_task_yield(void)
+{
+    if (s_cur == NULL || s_in_isr)
+        return;
+    s_cur->seq = s_seq++;
+    task_switch();
+}
+
+void rtos_sim_enter_critical(void)
+{
+    s_basepri = configMAX_SYSCALL_INTERRUPT_PRIORITY;
+    s_critical++;
+}
+
+void rtos_sim_exit_critical(void)
+{
+    if (s_critical > 0 && --s_critical == 0)
+        __set_BASEPRI(0);
+}
+
+/* The switch a handler asks for is made when it returns, see irq_check() callers */
+void rtos_sim_yield_from_isr(BaseType_t xSwitchRequired)
+{
+}
+
+void *pvPortMalloc(size_t xSize)
+{
+    return malloc(xSize);
+}
+
+void vPortFree(void *pv)
+{
+    free(pv);
+}
+
+QueueHandle_t rtos_sim_queue_create(UBaseType_t uxQueueLength, UBaseType_t uxItemSize, int iMutex)
+{
+    struct rtos_sim_queue *q = calloc(1, sizeof(*q));
+
+    q->len = uxQueueLength;
+    q->size = uxItemSize;
+    if (uxItemSize)
+        q->buf = calloc(uxQueueLength, uxItemSize);
+    q->count = iMutex ? 1 : 0;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    free(xQueue->buf);
+    free(xQueue);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    return xQueue->count;
+}
+
+static int queue_put(struct rtos_sim_queue *q, const void *item)
+{
+    if (q->count == q->len)
+        return 0;
+    if (q->size)
+        memcpy(q->buf + ((q->head + q->count) % q->len) * q->size, item, q->size);
+    q->count++;
+    return 1;
+}
+
+static int queue_get(struct rtos_sim_queue *q, void *buf)
+{
+    if (q->count == 0)
+        return 0;
+    if (q->size)
+        memcpy(buf, q->buf + q->head * q->size, q->size);
+    q->head = (q->head + 1) % q->len;
+    q->count--;
+    return 1;
+}
+
+/* Ready the best task waiting on q to send (sender = 1) or to receive */
+static struct rtos_sim_task *queue_wake(struct rtos_sim_queue *q, int sender)
+{
+    struct rtos_sim_task *t, *best = NULL;
+
+    for (t = s_tasks; t; t = t->next)
+    {
+        if (t->state == T_BLOCKED && t->wait_q == q && t->wait_send == sender &&
+            (!best || t->prio > best->prio || (t->prio == best->prio && t->seq < best->seq)))
+            best = t;
+    }
+    if (best)
+        make_ready(best);
+    return best;
+}
+
+static void check_wait(TickType_t xTicksToWait)
+{
+    if (xTicksToWait != 0 && (s_cur == NULL || s_in_isr))
+        rtos_sim_fatal("queue wait outside a task");
+}
+
+BaseType_t rtos_sim_queue_send(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    uint64_t wake = tick_deadline(xTicksToWait);
+
+    check_wait(xTicksToWait);
+    for (;;)
+    {
+        if (queue_put(xQueue, pvItemToQueue))
+        {
+            queue_wake(xQueue, 0);
+            preempt_check();
+            return pdPASS;
+        }
+        if (xTicksToWait == 0 || task_block(xQueue, 1, wake) < 0)
+            return errQUEUE_FULL;
+    }
+}
+
+BaseType_t rtos_sim_queue_send_isr(QueueHandle_t xQueue, const void *pvItemToQueue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    struct rtos_sim_task *t;
+
+    if (!queue_put(xQueue, pvItemToQueue))
+        return errQUEUE_FULL;
+    t = queue_wake(xQueue, 0);
+    if (t && pxHigherPriorityTaskWoken && (s_cur == NULL || t->prio > s_cur->prio))
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    return pdPASS;
+}
+
+BaseType_t rtos_sim_queue_receive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    uint64_t wake = tick_deadline(xTicksToWait);
+
+    check_wait(xTicksToWait);
+    for (;;)
+    {
+        if (queue_get(xQueue, pvBuffer))
+        {
+            queue_wake(xQueue, 1);
+            preempt_check();
+            return pdPASS;
+        }
+        if (xTicksToWait == 0 || task_block(xQueue, 0, wake) < 0)
+            return errQUEUE_EMPTY;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/* NVIC and BASEPRI                                                          */
+/*---------------------------------------------------------------------------*/
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    s_irq_prio = priority;
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    s_irq_en = 1;
+    sim_poll();
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    s_irq_en = 0;
+}
+
+uint32_t __get_BASEPRI(void)
+{
+    return s_basepri;
+}
+
+void __set_BASEPRI(uint32_t basePri)
+{
+    uint32_t old = s_basepri;
+
+    s_basepri = basePri & 0xF0;
+    if (s_basepri == 0 || (old != 0 && s_basepri > old))
+        sim_poll();
+}
+
+void __set_BASEPRI_MAX(uint32_t basePri)
+{
+    basePri &= 0xF0;
+    if (basePri != 0 && (s_basepri == 0 || basePri < s_basepri))
+        s_basepri = basePri;
+}
+
+/*---------------------------------------------------------------------------*/
+/* GMAC and PHY                                                              */
+/*---------------------------------------------------------------------------*/
+
+#define DMA_NORMAL      (DmaIntTxCompleted | DmaIntTxNoBuffer | DmaIntRxCompleted | DmaIntEarlyRx)
+#define DMA_ABNORMAL    (DmaIntTxStopped | DmaIntTxJabberTO | DmaIntRcvOverflow | DmaIntTxUnderflow | \
+                         DmaIntRxNoBuffer | DmaIntRxStopped | DmaIntRxWdogTO | DmaIntEarlyTx | DmaIntBusError)
+
+#define PHY_ID1         0x0022
+#define PHY_ID2         0x1561
+
+static uint32_t s_regs[REGS_SIZE / 4];
+static uint16_t s_phy[32];
+static uint32_t s_tx_cur, s_rx_cur;     /* descriptors the DMA looks at next */
+static int s_tx_busy;
+static uint32_t s_gen, s_wdt_gen;       /* stale events after a reset or a rearm */
+static uint8_t s_tx_frame[2048];
+static int s_tx_len;
+static uint32_t s_tx_last;
+
+static void wire_send(int dir, const uint8_t *frame, int len, uint64_t end_ns);
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint32_t sum16(const uint8_t *p, int len, uint32_t sum)
+{
+    for (; len > 1; p += 2, len -= 2)
+        sum += get16(p);
+    if (len)
+        sum += (uint32_t)p[0] << 8;
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+static uint32_t pseudo_sum(const uint8_t *ip, uint8_t proto, int len)
+{
+    return sum16(ip + 12, 8, 0) + proto + (uint32_t)len;
+}
+
+/* Offset of the checksum in a TCP, UDP or ICMP header, or -1 */
+static int csum_offset(uint8_t proto)
+{
+    return proto == 6 ? 16 : proto == 17 ? 6 : proto == 1 ? 2 : -1;
+}
+
+static uint64_t wire_ns(int len)
+{
+    int bytes = (len + 4 < 64 ? 64 : len + 4) + 8 + 12;
+
+    return (uint64_t)bytes * 8 * LWIP_SIM_S / LWIP_SIM_LINK_BPS;
+}
+
+static void gmac_reset(void)
+{
+    memset(s_regs, 0, sizeof(s_regs));
+    REG(GmacVersion) = 0x00001037;
+    s_tx_cur = s_rx_cur = 0;
+    s_tx_busy = 0;
+    s_gen++;
+    s_wdt_gen++;
+}
+
+static uint32_t dma_status(void)
+{
+    uint32_t st = DMA(DmaStatus) & ~(DmaIntNormal | DmaIntAbnormal);
+    uint32_t ie = DMA(DmaInterrupt);
+
+    if (st & ie & DMA_NORMAL)
+        st |= DmaIntNormal;
+    if (st & ie & DMA_ABNORMAL)
+        st |= DmaIntAbnormal;
+    return st;
+}
+
+static int gmac_irq_line(void)
+{
+    uint32_t st = dma_status(), ie = DMA(DmaInterrupt);
+
+    return ((st & DmaIntNormal) && (ie & DmaIeNormal)) || ((st & DmaIntAbnormal) && (ie & DmaIeAbnormal));
+}
+
+static uint16_t phy_read(int reg)
+{
+    switch (reg)
+    {
+    case 1:
+        return 0x7809 | 0x0004 | 0x0020;        /* capabilities, link up, autonegotiation done */
+    case 2:
+        return PHY_ID1;
+    case 3:
+        return PHY_ID2;
+    case 5:
+        return 0x4000 | 0x0100 | 0x0001;       /* ack, 100 full duplex, 802.3 */
+    default:
+        return s_phy[reg];
+    }
+}
+
+static void phy_write(int reg, uint16_t val)
+{
+    /* reset and autonegotiation restart complete at once */
+    if (reg == 0)
+        val &= ~(0x8000 | 0x0200);
+    s_phy[reg] = val;
+}
+
+static void mdio(uint32_t addr)
+{
+    int pa = (addr & GmiiDevMask) >> GmiiDevShift, reg = (addr & GmiiRegMask) >> GmiiRegShift;
+
+    if (addr & GmiiWrite)
+    {
+        if (pa == DEFAULT_PHY_BASE)
+            phy_write(reg, (uint16_t)REG(GmacGmiiData));
+    }
+    else
+        REG(GmacGmiiData) = pa == DEFAULT_PHY_BASE ? phy_read(reg) : 0xFFFF;
+    REG(GmacGmiiAddr) = addr & ~GmiiBusy;
+}
+
+static uint32_t tx_next(uint32_t a)
+{
+    DmaDesc *d = PTR(a);
+
+    return (d->status & TxDescEndOfRing) ? DMA(DmaTxBaseAddr) : a + sizeof(DmaDesc);
+}
+
+static uint32_t rx_next(uint32_t a)
+{
+    DmaDesc *d = PTR(a);
+
+    return (d->length & RxDescEndOfRing) ? DMA(DmaRxBaseAddr) : a + sizeof(DmaDesc);
+}
+
+/* Checksum insertion of the offload engine. The engine does not touch the
+ * payload of an IP fragment, only its header. */
+static void tx_csum(uint8_t *f, int len, uint32_t cis)
+{
+    uint8_t *ip = f + 14, *pl;
+    int ihl, tot, off;
+    uint32_t sum;
+    uint16_t c;
+
+    if (cis == DescTxCisBypass || len < 34 || get16(f + 12) != 0x0800)
+        return;
+    ihl = (ip[0] & 0x0F) * 4;
+    tot = get16(ip + 2);
+    if ((ip[0] >> 4) != 4 || ihl < 20 || tot < ihl || 14 + tot > len)
+        return;
+    put16(ip + 10, 0);
+    put16(ip + 10, fold(sum16(ip, ihl, 0)));
+    if (cis == DescTxCisIpv4HdrCs || (get16(ip + 6) & 0x3FFF))
+        return;
+
+    pl = ip + ihl;
+    off = csum_offset(ip[9]);
+    if (off < 0 || tot - ihl < off + 2)
+        return;
+    if (cis == DescTxCisTcpPseudoCs)
+        put16(pl + off, 0);
+    sum = sum16(pl, tot - ihl, 0);
+    if (cis == DescTxCisTcpPseudoCs && ip[9] != 1)
+        sum += pseudo_sum(ip, ip[9], tot - ihl);
+    c = fold(sum);
+    if (ip[9] == 17 && c == 0)
+        c = 0xFFFF;
+    put16(pl + off, c);
+    s_stats.tx_csum_inserted++;
+}
+
+static void tx_fetch(void);
+
+static void tx_done(void *arg)
+{
+    uint32_t a = s_tx_cur;
+    DmaDesc *d;
+
+    if ((uint32_t)(uintptr_t)arg != s_gen)
+        return;
+    for (;;)
+    {
+        d = PTR(a);
+        d->status &= ~DescOwnByDma;
+        if (a == s_tx_last)
+            break;
+        a = tx_next(a);
+    }
+    if (d->status & DescTxIntEnable)
+        DMA(DmaStatus) |= DmaIntTxCompleted;
+    s_tx_cur = tx_next(a);
+    s_stats.tx_frames++;
+    s_stats.tx_bytes += s_tx_len;
+    wire_send(LWIP_SIM_TO_PEER, s_tx_frame, s_tx_len, s_now);
+    s_tx_busy = 0;
+    tx_fetch();
+}
+
+/* Gather the next frame the driver handed over and start sending it */
+static void tx_fetch(void)
+{
+    uint32_t a = s_tx_cur, n;
+    DmaDesc *d = PTR(a), *first = d;
+    int len = 0;
+
+    if (s_tx_busy || !(DMA(DmaControl) & DmaTxStart) || a == 0)
+        return;
+    if (!(d->status & DescOwnByDma))
+    {
+        DMA(DmaStatus) |= DmaIntTxNoBuffer;
+        return;
+    }
+    for (;;)
+    {
+        d = PTR(a);
+        if (!(d->status & DescOwnByDma))
+        {
+            /* the first descriptor is handed over last, so this is a driver bug */
+            rtos_sim_fatal("tx frame ends in a descriptor the DMA does not own");
+        }
+        n = d->length & DescSize1Mask;
+        if (len + n > sizeof(s_tx_frame))
+            rtos_sim_fatal("tx frame too long");
+        memcpy(s_tx_frame + len, PTR(d->buffer1), n);
+        len += n;
+        if (d->status & DescTxLast)
+            break;
+        a = tx_next(a);
+    }
+    tx_csum(s_tx_frame, len, first->status & DescTxCisMask);
+    s_tx_len = len;
+    s_tx_last = a;
+    s_tx_busy = 1;
+    lwip_sim_event_at(s_now + wire_ns(len), tx_done, (void *)(uintptr_t)s_gen);
+}
+
+static int perfect_match(const uint8_t *da, int from)
+{
+    uint32_t hi, lo;
+    int i;
+
+    for (i = from; i < 16; i++)
+    {
+        hi = REG(GmacAddr0High + 8 * i);
+        lo = REG(GmacAddr0Low + 8 * i);
+        if (i > 0 && !(hi & 0x80000000))
+            continue;
+        if (da[0] == (uint8_t)lo && da[1] == (uint8_t)(lo >> 8) && da[2] == (uint8_t)(lo >> 16) &&
+            da[3] == (uint8_t)(lo >> 24) && da[4] == (uint8_t)hi && da[5] == (uint8_t)(hi >> 8))
+            return 1;
+    }
+    return 0;
+}
+
+static int hash_match(const uint8_t *da)
+{
+    uint32_t crc = 0xFFFFFFFF, bin = 0;
+    int i, j;
+
+    for (i = 0; i < 6; i++)
+    {
+        crc ^= da[i];
+        for (j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    }
+    crc = ~crc;
+    for (i = 0; i < 6; i++)
+        bin |= ((crc >> i) & 1) << (5 - i);
+    return (REG(bin < 32 ? GmacHashLow : GmacHashHigh) >> (bin & 31)) & 1;
+}
+
+static int rx_filter(const uint8_t *f)
+{
+    uint32_t ff = REG(GmacFrameFilter);
+    static const uint8_t bcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+    if (ff & (GmacFilterOff | GmacPromiscuousMode))
+        return 1;
+    if (memcmp(f, bcast, 6) == 0)
+        return !(ff & GmacBroadcastDisable);
+    if (f[0] & 1)
+    {
+        if (ff & GmacMulticastFilterOff)
+            return 1;
+        if (ff & GmacMcastHashFilter)
+            return hash_match(f) || ((ff & GmacHashPerfectFilter) && perfect_match(f, 1));
+        return perfect_match(f, 1);
+    }
+    if (ff & GmacUcastHashFilter)
+        return hash_match(f) || ((ff & GmacHashPerfectFilter) && perfect_match(f, 0));
+    return perfect_match(f, 0);
+}
+
+/* Receive side of the offload engine: RDES4 for the frame, MMC counters updated */
+static uint32_t rx_csum(const uint8_t *f, int len)
+{
+    const uint8_t *ip = f + 14, *pl;
+    uint32_t ext = DescRxPtpIPV4, sum;
+    int ihl, tot, off, ok;
+
+    if (len >= 54 && get16(f + 12) == 0x86DD)
+    {
+        /* IPv6 payloads pass as good, the tests do not send any */
+        REG(GmacMmcRxIpV6FramesG)++;
+        return DescRxPtpIPV6;
+    }
+    if (len < 34 || get16(f + 12) != 0x0800)
+        return 0;
+
+    ihl = (ip[0] & 0x0F) * 4;
+    tot = get16(ip + 2);
+    if ((ip[0] >> 4) != 4 || ihl < 20 || tot < ihl || 14 + tot > len || fold(sum16(ip, ihl, 0)) != 0)
+    {
+        REG(GmacMmcRxIpV4HdrErrFrames)++;
+        return ext | DescRxIpHeaderError;
+    }
+    REG(GmacMmcRxIpV4FramesG)++;
+    if (get16(ip + 6) & 0x3FFF)
+    {
+        REG(GmacMmcRxIpV4FragFrames)++;
+        return ext;
+    }
+
+    pl = ip + ihl;
+    off = csum_offset(ip[9]);
+    if (off < 0 || tot - ihl < off + 2)
+    {
+        REG(GmacMmcRxIpV4NoPayFrames)++;
+        return ext;
+    }
+    if (ip[9] == 17 && get16(pl + 6) == 0)
+    {
+        REG(GmacMmcRxIpV4UdpChkDsblFrames)++;
+        return ext | DescRxIpPayloadUDP;
+    }
+    sum = sum16(pl, tot - ihl, 0);
+    if (ip[9] != 1)
+        sum += pseudo_sum(ip, ip[9], tot - ihl);
+    ok = fold(sum) == 0;
+    switch (ip[9])
+    {
+    case 6:
+        REG(ok ? GmacMmcRxTcpFramesG : GmacMmcRxTcpErrorFrames)++;
+        ext |= DescRxIpPayloadTCP;
+        break;
+    case 17:
+        REG(ok ? GmacMmcRxUdpFramesG : GmacMmcRxUdpErrorFrames)++;
+        ext |= DescRxIpPayloadUDP;
+        break;
+    default:
+        REG(ok ? GmacMmcRxIcmpFramesG : GmacMmcRxIcmpErrorFrames)++;
+        ext |= DescRxIpPayloadICMP;
+        break;
+    }
+    return ok ? ext : ext | DescRxIpPayloadError;
+}
+
+static void rx_wdt(void *arg)
+{
+    if ((uint32_t)(uintptr_t)arg == s_wdt_gen)
+        DMA(DmaStatus) |= DmaIntRxCompleted;
+}
+
+/* A frame off the wire */
+static void rx_frame(const uint8_t *f, int len)
+{
+    static const uint8_t pause_da[6] = { 0x01, 0x80, 0xC2, 0x00, 0x00, 0x01 };
+    uint32_t ext = 0, st, wdt;
+    DmaDesc *d;
+
+    if (!(REG(GmacConfig) & GmacRx) || !(DMA(DmaControl) & DmaRxStart) || s_rx_cur == 0)
+        return;
+    REG(GmacMmcRxFrameCountGb)++;
+    REG(GmacMmcRxOctetCountGb) += len + 4;
+    if (f[0] & 1)
+        REG(memcmp(f, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0 ? GmacMmcRxBcFramesG : GmacMmcRxMcFramesG)++;
+    else
+        REG(GmacMmcRxUcFramesG)++;
+    if (memcmp(f, pause_da, 6) == 0 && get16(f + 12) == 0x8808)
+    {
+        REG(GmacMmcRxPauseFrames)++;
+        return;
+    }
+    if (!rx_filter(f))
+    {
+        s_stats.rx_filtered++;
+        return;
+    }
+    if (REG(GmacConfig) & GmacRxIpcOffload)
+    {
+        ext = rx_csum(f, len);
+        if ((ext & (DescRxIpHeaderError | DescRxIpPayloadError)) && !(DMA(DmaControl) & DmaDisableDropTcpCs))
+        {
+            s_stats.rx_csum_dropped++;
+            return;
+        }
+    }
+
+    d = PTR(s_rx_cur);
+    if (!(d->status & DescOwnByDma))
+    {
+        DMA(DmaStatus) |= DmaIntRxNoBuffer;
+        REG(GmacMmcRxFifoOverFlow)++;
+        s_stats.rx_no_desc++;
+        return;
+    }
+    if ((uint32_t)len + 4 > (d->length & DescSize1Mask))
+        rtos_sim_fatal("rx buffer too short for a frame");
+    memcpy(PTR(d->buffer1), f, len);
+    memset((uint8_t *)PTR(d->buffer1) + len, 0, 4);
+
+    st = ((uint32_t)(len + 4) << DescFrameLengthShift) | DescRxFirst | DescRxLast;
+    if (get16(f + 12) >= 0x0600)
+        st |= DescRxFrameEther;
+    if (REG(GmacConfig) & GmacRxIpcOffload)
+        st |= DescRxEXTsts;
+    if (ext & (DescRxIpHeaderError | DescRxIpPayloadError))
+        st |= DescError;
+    d->extstatus = ext;
+    d->status = st;
+    s_rx_cur = rx_next(s_rx_cur);
+    s_stats.rx_frames++;
+    s_stats.rx_bytes += len;
+
+    wdt = DMA(DmaRxIntWdt) & 0xFF;
+    if (!(d->length & RxDisIntCompl) || wdt == 0)
+    {
+        s_wdt_gen++;
+        DMA(DmaStatus) |= DmaIntRxCompleted;
+    }
+    else
+        lwip_sim_event_at(s_now + (uint64_t)wdt * 256 * LWIP_SIM_S / SystemCoreClock,
+                          rx_wdt, (void *)(uintptr_t)++s_wdt_gen);
+}
+
+uint32_t gmac_sim_mmc(uint32_t offset)
+{
+    return REG(offset);
+}
+
+void plat_delay(u32 delay)
+{
+}
+
+u32 synopGMACReadReg(u32 RegBase, u32 RegOffset)
+{
+    u32 a = RegBase + RegOffset - EMAC_BASE;
+
+    if (a >= REGS_SIZE)
+        rtos_sim_fatal("GMAC register read out of range");
+    if (a == DMABASE + DmaStatus)
+        return dma_status();
+    if (a == DMABASE + DmaTxCurrDesc)
+        return s_tx_cur;
+    if (a == DMABASE + DmaRxCurrDesc)
+        return s_rx_cur;
+    return REG(a);
+}
+
+void synopGMACWriteReg(u32 RegBase, u32 RegOffset, u32 RegData)
+{
+    u32 a = RegBase + RegOffset - EMAC_BASE, old;
+
+    if (a >= REGS_SIZE)
+        rtos_sim_fatal("GMAC register write out of range");
+    old = REG(a);
+    switch (a)
+    {
+    case GmacGmiiAddr:
+        if (RegData & GmiiBusy)
+            mdio(RegData);
+        else
+            REG(a) = RegData;
+        break;
+    case GmacInterruptStatus:
+        break;
+    case DMABASE + DmaBusMode:
+        if (RegData & DmaResetOn)
+            gmac_reset();
+        else
+            REG(a) = RegData;
+        break;
+    case DMABASE + DmaTxPollDemand:
+        tx_fetch();
+        break;
+    case DMABASE + DmaRxPollDemand:
+        break;
+    case DMABASE + DmaRxBaseAddr:
+        REG(a) = s_rx_cur = RegData;
+        break;
+    case DMABASE + DmaTxBaseAddr:
+        REG(a) = s_tx_cur = RegData;
+        break;
+    case DMABASE + DmaStatus:
+        REG(a) &= ~(RegData & 0x1FFFF);
+        break;
+    case DMABASE + DmaControl:
+        REG(a) = RegData;
+        if ((RegData & DmaTxStart) && !(old & DmaTxStart))
+            tx_fetch();
+        break;
+    default:
+        REG(a) = RegData;
+        break;
+    }
+    sim_poll();
+}
+
+void synopGMACSetBits(u32 RegBase, u32 RegOffset, u32 BitPos)
+{
+    synopGMACWriteReg(RegBase, RegOffset, synopGMACReadReg(RegBase, RegOffset) | BitPos);
+}
+
+void synopGMACClearBits(u32 RegBase, u32 RegOffset, u32 BitPos)
+{
+    synopGMACWriteReg(RegBase, RegOffset, synopGMACReadReg(RegBase, RegOffset) & ~BitPos);
+}
+
+bool synopGMACCheckBits(u32 RegBase, u32 RegOffset, u32 BitPos)
+{
+    return (synopGMACReadReg(RegBase, RegOffset) & BitPos) != 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Wire                                                                      */
+/*---------------------------------------------------------------------------*/
+
+struct wire_frame
+{
+    int dir, len;
+    uint8_t data[LWIP_SIM_FRAME_MAX];
+};
+
+static uint64_t s_delay, s_board_link_free;
+static lwip_sim_hook_t s_hook;
+static void (*s_peer_rx)(const uint8_t *frame, int len);
+
+void lwip_sim_wire_delay(uint64_t one_way_ns)
+{
+    s_delay = one_way_ns;
+}
+
+void lwip_sim_wire_hook(lwip_sim_hook_t hook)
+{
+    s_hook = hook;
+}
+
+void lwip_sim_wire_peer(void (*rx)(const uint8_t *frame, int len))
+{
+    s_peer_rx = rx;
+}
+
+static void wire_arrive(void *arg)
+{
+    struct wire_frame *w = arg;
+
+    if (w->dir == LWIP_SIM_TO_BOARD)
+        rx_frame(w->data, w->len);
+    else if (s_peer_rx)
+        s_peer_rx(w->data, w->len);
+    free(w);
+}
+
+/* A frame has left its sender at end_ns */
+static void wire_send(int dir, const uint8_t *frame, int len, uint64_t end_ns)
+{
+    struct wire_frame *w = malloc(sizeof(*w));
+
+    if (len > LWIP_SIM_FRAME_MAX)
+        rtos_sim_fatal("frame too long for the wire");
+    w->dir = dir;
+    w->len = len;
+    memcpy(w->data, frame, len);
+    if (s_hook && (!s_hook(dir, w->data, &w->len) || w->len <= 0))
+    {
+        s_stats.wire_dropped++;
+        free(w);
+        return;
+    }
+    if (w->len > LWIP_SIM_FRAME_MAX)
+        rtos_sim_fatal("wire hook made a frame too long");
+    lwip_sim_event_at(end_ns + s_delay, wire_arrive, w);
+}
+
+void lwip_sim_wire_to_board(const uint8_t *frame, int len)
+{
+    uint64_t start = s_board_link_free > s_now ? s_board_link_free : s_now;
+
+    s_board_link_free = start + wire_ns(len);
+    wire_send(LWIP_SIM_TO_BOARD, frame, len, s_board_link_free);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Console                                                                   */
+/*---------------------------------------------------------------------------*/
+
+static lwip_sim_console_t s_console;
+static char s_line[256];
+static int s_line_len;
+static struct rtos_sim_queue *s_stdin;
+
+void lwip_sim_console_hook(lwip_sim_console_t hook)
+{
+    s_console = hook;
+}
+
+int lwip_sim_printf(const char *fmt, ...)
+{
+    char buf[512];
+    va_list ap;
+    int n, i;
+
+    va_start(ap, fmt);
+    n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (s_verbose)
+        fputs(buf, stdout);
+    for (i = 0; buf[i]; i++)
+    {
+        if (buf[i] == '\n' || s_line_len == (int)sizeof(s_line) - 1)
+        {
+            s_line[s_line_len] = 0;
+            s_line_len = 0;
+            if (s_console)
+                s_console(s_line);
+        }
+        if (buf[i] != '\n' && buf[i] != '\r')
+            s_line[s_line_len++] = buf[i];
+    }
+    return n;
+}
+
+int lwip_sim_getchar(void)
+{
+    int c;
+
+    rtos_sim_queue_receive(s_stdin, &c, portMAX_DELAY);
+    return c;
+}
+
+void lwip_sim_console_input(int c)
+{
+    if (rtos_sim_queue_send(s_stdin, &c, 0) != pdPASS)
+        rtos_sim_fatal("console input overflow");
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void on_alarm(int sig)
+{
+    static const char msg[] = "lwip_sim: watchdog, a task spins without blocking\n";
+
+    (void)write(2, msg, sizeof(msg) - 1);
+    _exit(3);
+}
+
+static void sim_init(void)
+{
+    /* descriptors hold 32-bit pointers: keep every allocation low */
+    mallopt(M_MMAP_MAX, 0);
+
+    s_sched_stack = low_alloc(STACK_SIZE);
+    cal_switch();
+    s_stdin = rtos_sim_queue_create(64, sizeof(int), 0);
+    signal(SIGALRM, on_alarm);
+    alarm(WATCHDOG_S);
+
+    s_verbose = getenv("LWIP_SIM_VERBOSE") != NULL;
+    gmac_reset();
+}
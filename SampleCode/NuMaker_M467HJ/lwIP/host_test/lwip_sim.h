@@ -0,0 +1,115 @@
+/*
+ * Simulated time, FreeRTOS scheduler and GMAC for host tests of the lwIP port.
+ *
+ * The board side is the real port: ethernetif.c, sys_arch.c and the EMAC
+ * driver, on top of a register model of the GMAC (lwip_sim.c) that walks
+ * the descriptor rings the driver builds. Its frames go out on a simulated
+ * 100 Mbit/s full duplex wire to whatever the test puts on the other end.
+ *
+ * Time is simulated in nanoseconds and the CPU is infinitely fast: tasks
+ * run until they block, and time only moves on when every task is blocked.
+ * Measured times are therefore wire time, link delay and the protocol
+ * timers of lwIP, never processing time. The scheduler is preemptive by
+ * priority like FreeRTOS, and the EMAC interrupt runs as soon as it is
+ * pending and not masked by BASEPRI.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef LWIP_SIM_H
+#define LWIP_SIM_H
+
+#include <stdint.h>
+
+#define LWIP_SIM_US         1000ULL
+#define LWIP_SIM_MS         1000000ULL
+#define LWIP_SIM_S          1000000000ULL
+
+/* Link rate of the simulated wire and PHY */
+#define LWIP_SIM_LINK_BPS   100000000ULL
+
+/* Largest frame on the wire, without FCS */
+#define LWIP_SIM_FRAME_MAX  1536
+
+/* Directions on the wire */
+#define LWIP_SIM_TO_PEER    0       /* sent by the GMAC */
+#define LWIP_SIM_TO_BOARD   1       /* sent by the far end */
+
+typedef struct
+{
+    /* CPU side */
+    uint64_t irqs;                  /* EMAC0_IRQHandler() entries */
+    uint64_t switches;              /* task switches */
+    uint32_t masked_blocks;         /* a task blocked with BASEPRI raised */
+    uint32_t isr_storms;            /* interrupt still pending after many handler runs */
+
+    /* GMAC side */
+    uint64_t tx_frames, tx_bytes;   /* frames the GMAC put on the wire */
+    uint64_t rx_frames, rx_bytes;   /* frames written to an rx descriptor */
+    uint64_t rx_no_desc;            /* frames lost, the DMA found no free rx descriptor */
+    uint64_t rx_filtered;           /* frames dropped by the address filter */
+    uint64_t rx_csum_dropped;       /* frames dropped by the checksum engine (DT = 0) */
+    uint64_t tx_csum_inserted;      /* TCP/UDP/ICMP checksums inserted on transmit */
+
+    /* Wire */
+    uint64_t wire_dropped;          /* frames dropped by the wire hook */
+} lwip_sim_stats_t;
+
+/* Run main_fn as a task of priority prio until it returns or limit_ns of
+ * simulated time has passed. Returns 0, or -1 on the time limit or when
+ * every task is blocked for good. */
+int lwip_sim_run(void (*main_fn)(void *), void *arg, unsigned prio, uint64_t limit_ns);
+
+uint64_t lwip_sim_time_ns(void);
+const lwip_sim_stats_t *lwip_sim_stats(void);
+
+/* Call fn(arg) from the scheduler, outside of any task, at time t_ns */
+void lwip_sim_event_at(uint64_t t_ns, void (*fn)(void *), void *arg);
+
+/* Block the calling task until t_ns, with no regard to ticks */
+void lwip_sim_sleep_until(uint64_t t_ns);
+
+/* Name of the running task, NULL in the interrupt handler and outside of
+ * tasks */
+const char *lwip_sim_task_name(void);
+/* Host CPU time the tasks of that name have run so far: the processing
+ * time the simulated clock leaves out, to compare code paths by. The
+ * interrupt handler counts for the task it interrupts, the task switches
+ * of the simulator do not. */
+uint64_t lwip_sim_task_cpu_ns(const char *name);
+
+/* Wire. The hook sees every frame before it is delivered and may change
+ * it (up to LWIP_SIM_FRAME_MAX bytes); it returns 0 to drop the frame. */
+typedef int (*lwip_sim_hook_t)(int dir, uint8_t *frame, int *len);
+
+void lwip_sim_wire_delay(uint64_t one_way_ns);
+void lwip_sim_wire_hook(lwip_sim_hook_t hook);
+/* Receiver of the frames the GMAC sends, called from the scheduler */
+void lwip_sim_wire_peer(void (*rx)(const uint8_t *frame, int len));
+/* Send a frame to the GMAC, serialised behind frames already on the way */
+void lwip_sim_wire_to_board(const uint8_t *frame, int len);
+
+/* GMAC model */
+uint32_t gmac_sim_mmc(uint32_t offset);
+
+/* LWIP_PLATFORM_ASSERT() of the host build: report and exit */
+void lwip_sim_assert(const char *msg, const char *file, int line);
+
+/* Console of the board: printf() of the sample code and getchar() */
+typedef void (*lwip_sim_console_t)(const char *line);
+
+int lwip_sim_printf(const char *fmt, ...) __attribute__((format(__printf__, 1, 2)));
+void lwip_sim_console_hook(lwip_sim_console_t hook);
+int lwip_sim_getchar(void);
+void lwip_sim_console_input(int c);
+
+/* Board code built with LWIP_SIM_CONSOLE: stdio.h comes first, so that its
+ * inline getchar() still reads the host's stdin and only the calls of the
+ * board are renamed. Function-like, so that format(printf, ...) attributes
+ * keep their meaning. */
+#ifdef LWIP_SIM_CONSOLE
+#include <stdio.h>
+#define printf(...)         lwip_sim_printf(__VA_ARGS__)
+#define getchar()           lwip_sim_getchar()
+#endif
+
+#endif /* LWIP_SIM_H */
@@ -0,0 +1,11 @@
+/*
+ * Host build of LwIP_SSL_Server: MBEDTLS_USER_CONFIG_FILE on top of the
+ * sample's mbedtls_config.h.
+ *
+ * aes_alt.c drives the CRPT engine, which this harness does not model, so
+ * AES runs in software here. The entropy source stays
+ * MBEDTLS_ENTROPY_HARDWARE_ALT, mbedtls_hardware_poll() is in tls_peer.c.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#undef MBEDTLS_AES_ALT
@@ -0,0 +1,665 @@
+/*
+ * TCP and UDP far end for the benchmarks of the lwIP samples, see
+ * perf_peer.h.
+ *
+ * Everything runs from lwip_sim events: frames from the board and the
+ * retransmission timer. Sequence numbers of the connection are kept
+ * relative to our ISS: 0 is the SYN, 1 + n data byte n and 1 + tx_len the
+ * FIN.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip_sim.h"
+#include "perf_peer.h"
+
+#define TCP_FIN         0x01
+#define TCP_SYN         0x02
+#define TCP_RST         0x04
+#define TCP_PSH         0x08
+#define TCP_ACK         0x10
+
+#define PEER_MSS        1460
+#define PEER_WND        65535
+#define RTO_NS          (250 * LWIP_SIM_MS)
+#define POLL_NS         (50 * LWIP_SIM_US)
+#define TX_MAX          (4 * 1024 * 1024)
+#define RING            (128 * 1024)        /* more than PEER_WND, a power of 2 */
+
+extern uint8_t my_mac_addr[6];
+
+enum { T_CLOSED, T_LISTEN, T_SYN_SENT, T_SYN_RCVD, T_OPEN };
+
+static struct
+{
+    int state, closing, dupacks;
+    uint16_t lport, rport, mss;
+    uint32_t iss, rcv_nxt;
+    uint32_t una, nxt, max;         /* relative to iss; max is the highest nxt so far */
+    uint32_t wnd;                   /* the board's window */
+    uint32_t adv;                   /* the window we announced last */
+    int reading;                    /* perf_tcp_read() was called */
+    unsigned gen;
+} s_t;
+
+static perf_tcp_t s_res;
+static perf_udp_t s_udp;
+
+static uint8_t s_tx[TX_MAX];
+static uint8_t s_rx[PERF_RX_KEEP];
+static uint8_t s_ring[RING];
+
+static uint8_t s_peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 };
+static uint8_t s_peer_ip[4], s_board_ip[4];
+static uint16_t s_port = 40000, s_ip_id = 1;
+static uint32_t s_conns;
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return ((uint32_t)get16(p) << 16) | get16(p + 2);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, (uint16_t)(v >> 16));
+    put16(p + 2, (uint16_t)v);
+}
+
+static uint32_t sum16(const uint8_t *p, int len, uint32_t sum)
+{
+    for (; len > 1; p += 2, len -= 2)
+        sum += get16(p);
+    if (len)
+        sum += (uint32_t)p[0] << 8;
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Frames                                                                    */
+/*---------------------------------------------------------------------------*/
+
+/* Ethernet and IPv4 header for len bytes of protocol proto, returns the
+ * start of the protocol header */
+static uint8_t *ip_frame(uint8_t *f, uint8_t proto, int len)
+{
+    uint8_t *ip = f + 14;
+
+    memcpy(f, my_mac_addr, 6);
+    memcpy(f + 6, s_peer_mac, 6);
+    put16(f + 12, 0x0800);
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    put16(ip + 2, (uint16_t)(20 + len));
+    put16(ip + 4, s_ip_id++);
+    ip[8] = 64;
+    ip[9] = proto;
+    memcpy(ip + 12, s_peer_ip, 4);
+    memcpy(ip + 16, s_board_ip, 4);
+    put16(ip + 10, fold(sum16(ip, 20, 0)));
+    return ip + 20;
+}
+
+static uint32_t pseudo_sum(uint8_t proto, int len)
+{
+    return sum16(s_peer_ip, 4, sum16(s_board_ip, 4, 0)) + proto + len;
+}
+
+/* Room left in our receive window */
+static uint32_t rcv_wnd(void)
+{
+    return s_t.reading ? PEER_WND - (s_res.rx_bytes - s_res.rx_read) : PEER_WND;
+}
+
+static void send_tcp(uint8_t flags, uint32_t seq, const uint8_t *data, int len)
+{
+    uint8_t f[LWIP_SIM_FRAME_MAX];
+    int hlen = (flags & TCP_SYN) ? 24 : 20;
+    uint8_t *tcp = ip_frame(f, 6, hlen + len);
+
+    put16(tcp, s_t.lport);
+    put16(tcp + 2, s_t.rport);
+    put32(tcp + 4, seq);
+    put32(tcp + 8, (flags & TCP_ACK) ? s_t.rcv_nxt : 0);
+    tcp[12] = (uint8_t)((hlen / 4) << 4);
+    tcp[13] = flags;
+    s_t.adv = rcv_wnd();
+    put16(tcp + 14, (uint16_t)s_t.adv);
+    put16(tcp + 16, 0);
+    put16(tcp + 18, 0);
+    if (flags & TCP_SYN)
+    {
+        tcp[20] = 2;
+        tcp[21] = 4;
+        put16(tcp + 22, PEER_MSS);
+    }
+    if (len)
+        memcpy(tcp + hlen, data, len);
+    put16(tcp + 16, fold(sum16(tcp, hlen + len, pseudo_sum(6, hlen + len))));
+    lwip_sim_wire_to_board(f, 34 + hlen + len);
+}
+
+static void send_ack(void)
+{
+    send_tcp(TCP_ACK, s_t.iss + s_t.nxt, NULL, 0);
+}
+
+void perf_udp_send(uint16_t sport, uint16_t dport, const void *data, int len)
+{
+    uint8_t f[LWIP_SIM_FRAME_MAX];
+    uint8_t *udp = ip_frame(f, 17, 8 + len);
+    uint16_t sum;
+
+    put16(udp, sport);
+    put16(udp + 2, dport);
+    put16(udp + 4, (uint16_t)(8 + len));
+    put16(udp + 6, 0);
+    memcpy(udp + 8, data, len);
+    sum = fold(sum16(udp, 8 + len, pseudo_sum(17, 8 + len)));
+    put16(udp + 6, sum ? sum : 0xFFFF);
+    lwip_sim_wire_to_board(f, 42 + len);
+}
+
+static void arp(int op, const uint8_t *mac, const uint8_t *ip)
+{
+    static const uint8_t bcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, none[6];
+    uint8_t f[42];
+
+    memcpy(f, op == 1 ? bcast : mac, 6);
+    memcpy(f + 6, s_peer_mac, 6);
+    put16(f + 12, 0x0806);
+    put16(f + 14, 1);
+    put16(f + 16, 0x0800);
+    f[18] = 6;
+    f[19] = 4;
+    put16(f + 20, (uint16_t)op);
+    memcpy(f + 22, s_peer_mac, 6);
+    memcpy(f + 28, s_peer_ip, 4);
+    memcpy(f + 32, op == 1 ? none : mac, 6);
+    memcpy(f + 38, ip, 4);
+    lwip_sim_wire_to_board(f, sizeof(f));
+}
+
+void perf_peer_arp(void)
+{
+    arp(1, NULL, s_board_ip);
+}
+
+/*---------------------------------------------------------------------------*/
+/* TCP                                                                       */
+/*---------------------------------------------------------------------------*/
+
+static void on_timeout(void *arg);
+
+static void arm(void)
+{
+    s_t.gen++;
+    lwip_sim_event_at(lwip_sim_time_ns() + RTO_NS, on_timeout, (void *)(uintptr_t)s_t.gen);
+}
+
+static void disarm(void)
+{
+    s_t.gen++;
+}
+
+/* Send what the board's window allows, then the FIN once all data is out */
+static void try_send(void)
+{
+    uint32_t end = 1 + s_res.tx_len, limit = s_t.una + s_t.wnd, n;
+
+    if (s_t.state != T_OPEN)
+        return;
+    while (s_t.nxt < end && s_t.nxt < limit)
+    {
+        n = end - s_t.nxt;
+        if (n > s_t.mss)
+            n = s_t.mss;
+        if (n > limit - s_t.nxt)
+            n = limit - s_t.nxt;
+        if (s_t.nxt < s_t.max)
+            s_res.retransmits++;
+        send_tcp(TCP_ACK | (s_t.nxt + n == end ? TCP_PSH : 0), s_t.iss + s_t.nxt, s_tx + s_t.nxt - 1, (int)n);
+        s_t.nxt += n;
+    }
+    if (s_t.closing && s_t.nxt == end)
+    {
+        if (s_t.max > end)
+            s_res.retransmits++;
+        send_tcp(TCP_ACK | TCP_FIN, s_t.iss + end, NULL, 0);
+        s_t.nxt++;
+    }
+    if (s_t.nxt > s_t.max)
+    {
+        s_t.max = s_t.nxt;
+        arm();
+    }
+}
+
+static void on_timeout(void *arg)
+{
+    uint32_t end = 1 + s_res.tx_len;
+
+    if ((unsigned)(uintptr_t)arg != s_t.gen)
+        return;
+    switch (s_t.state)
+    {
+    case T_SYN_SENT:
+        s_res.retransmits++;
+        send_tcp(TCP_SYN, s_t.iss, NULL, 0);
+        break;
+    case T_SYN_RCVD:
+        s_res.retransmits++;
+        send_tcp(TCP_SYN | TCP_ACK, s_t.iss, NULL, 0);
+        break;
+    case T_OPEN:
+        /* Go back to the oldest unacknowledged byte. A closed window
+           gets a probe of one byte. */
+        s_t.nxt = s_t.una;
+        if (s_t.wnd == 0 && s_t.una < end)
+        {
+            s_res.retransmits++;
+            send_tcp(TCP_ACK, s_t.iss + s_t.una, s_tx + s_t.una - 1, 1);
+            s_t.nxt = s_t.una + 1;
+            if (s_t.nxt > s_t.max)
+                s_t.max = s_t.nxt;
+        }
+        else
+            try_send();
+        if (s_t.una == s_t.max && (s_t.wnd != 0 || s_t.una >= end))
+            return;
+        break;
+    default:
+        return;
+    }
+    arm();
+}
+
+static void closed(void)
+{
+    s_t.state = T_CLOSED;
+    s_res.closed_ns = lwip_sim_time_ns();
+    disarm();
+}
+
+static uint16_t syn_mss(const uint8_t *tcp, int hlen)
+{
+    int i = 20;
+
+    while (i + 1 < hlen && tcp[i] != 0)
+    {
+        if (tcp[i] == 1)
+        {
+            i++;
+            continue;
+        }
+        if (tcp[i] == 2 && tcp[i + 1] == 4 && i + 4 <= hlen)
+            return get16(tcp + i + 2);
+        if (tcp[i + 1] < 2)
+            break;
+        i += tcp[i + 1];
+    }
+    return 536;
+}
+
+static void established(uint16_t win)
+{
+    s_t.state = T_OPEN;
+    s_t.una = 1;
+    s_t.wnd = win;
+    s_res.established = 1;
+    s_res.mss = s_t.mss;
+    s_res.est_ns = lwip_sim_time_ns();
+    disarm();
+}
+
+static void on_ack(uint32_t ack, uint16_t win, int len, uint8_t flags)
+{
+    uint32_t rel = ack - s_t.iss, end = 1 + s_res.tx_len;
+
+    if (rel > s_t.una && rel <= s_t.max)
+    {
+        s_t.una = rel;
+        s_t.dupacks = 0;
+        if (s_t.nxt < s_t.una)
+            s_t.nxt = s_t.una;
+        s_res.tx_acked = (s_t.una < end ? s_t.una : end) - 1;
+        s_res.fin_acked = s_t.una > end;
+        s_res.last_ack_ns = lwip_sim_time_ns();
+        if (s_t.una < s_t.max)
+            arm();
+        else
+            disarm();
+    }
+    else if (rel == s_t.una && len == 0 && !(flags & TCP_FIN) && win == s_t.wnd && s_t.una < s_t.max)
+    {
+        /* Three duplicate ACKs: go back and send the window again */
+        if (++s_t.dupacks == 3)
+            s_t.nxt = s_t.una;
+    }
+    if (rel == s_t.una)
+    {
+        if (win == 0 && s_t.wnd != 0)
+            s_res.zero_windows++;
+        s_t.wnd = win;
+        /* keep probing a closed window with data waiting */
+        if (win == 0 && s_t.una < end && s_t.una == s_t.max)
+            arm();
+    }
+}
+
+static void on_tcp(const uint8_t *tcp, int tlen)
+{
+    int hlen = (tcp[12] >> 4) * 4, len = tlen - hlen;
+    uint8_t flags = tcp[13];
+    uint32_t seq = get32(tcp + 4), ack = get32(tcp + 8);
+    uint16_t win = get16(tcp + 14);
+    uint64_t now = lwip_sim_time_ns();
+    uint32_t keep, i;
+
+    if (hlen < 20 || len < 0)
+        return;
+    if (flags & TCP_RST)
+    {
+        if (s_t.state != T_CLOSED && s_t.state != T_LISTEN)
+        {
+            s_res.reset = 1;
+            closed();
+        }
+        return;
+    }
+
+    switch (s_t.state)
+    {
+    case T_LISTEN:
+        if ((flags & (TCP_SYN | TCP_ACK)) != TCP_SYN)
+            return;
+        s_t.rport = get16(tcp);
+        s_t.rcv_nxt = seq + 1;
+        s_t.mss = syn_mss(tcp, hlen);
+        s_t.state = T_SYN_RCVD;
+        s_t.nxt = s_t.max = 1;
+        s_res.syn_ns = now;
+        send_tcp(TCP_SYN | TCP_ACK, s_t.iss, NULL, 0);
+        arm();
+        return;
+    case T_SYN_SENT:
+        if ((flags & (TCP_SYN | TCP_ACK)) != (TCP_SYN | TCP_ACK) || ack != s_t.iss + 1)
+            return;
+        s_t.rcv_nxt = seq + 1;
+        s_t.mss = syn_mss(tcp, hlen);
+        established(win);
+        send_ack();
+        try_send();
+        return;
+    case T_SYN_RCVD:
+        if (flags & TCP_SYN)
+        {
+            send_tcp(TCP_SYN | TCP_ACK, s_t.iss, NULL, 0);
+            return;
+        }
+        if (!(flags & TCP_ACK) || ack != s_t.iss + 1)
+            return;
+        established(win);
+        break;
+    case T_OPEN:
+        break;
+    default:
+        return;
+    }
+
+    if (flags & TCP_ACK)
+        on_ack(ack, win, len, flags);
+
+    if (len > 0 || (flags & TCP_FIN))
+    {
+        if (seq == s_t.rcv_nxt && !s_res.fin_rcvd && (uint32_t)len <= rcv_wnd())
+        {
+            if (len > 0)
+            {
+                for (i = 0; i < (uint32_t)len; i++)
+                    s_ring[(s_res.rx_bytes + i) % RING] = tcp[hlen + i];
+                keep = s_res.rx_bytes < PERF_RX_KEEP ? PERF_RX_KEEP - s_res.rx_bytes : 0;
+                memcpy(s_rx + s_res.rx_bytes, tcp + hlen, (uint32_t)len < keep ? (uint32_t)len : keep);
+                if (s_res.rx_bytes == 0)
+                    s_res.first_rx_ns = now;
+                s_res.last_rx_ns = now;
+                s_res.rx_bytes += len;
+                s_t.rcv_nxt += len;
+            }
+            if (flags & TCP_FIN)
+            {
+                s_t.rcv_nxt++;
+                s_res.fin_rcvd = 1;
+            }
+        }
+        else
+            s_res.out_of_order++;
+        send_ack();
+    }
+
+    try_send();
+    if (s_res.fin_rcvd && s_res.fin_acked && !s_res.closed_ns)
+        closed();
+}
+
+/* A new connection record */
+static void tcp_reset(uint16_t lport, uint16_t rport)
+{
+    disarm();
+    memset(&s_res, 0, sizeof(s_res));
+    s_t.closing = 0;
+    s_t.dupacks = 0;
+    s_t.lport = lport;
+    s_t.rport = rport;
+    s_t.mss = 536;
+    s_t.iss = 0x10000000u + 0x01000000u * ++s_conns;
+    s_t.una = s_t.nxt = s_t.max = 0;
+    s_t.wnd = 0;
+    s_t.reading = 0;
+}
+
+void perf_tcp_connect(uint16_t port)
+{
+    tcp_reset(s_port++, port);
+    s_t.state = T_SYN_SENT;
+    s_t.nxt = s_t.max = 1;
+    s_res.syn_ns = lwip_sim_time_ns();
+    send_tcp(TCP_SYN, s_t.iss, NULL, 0);
+    arm();
+}
+
+void perf_tcp_listen(uint16_t port)
+{
+    tcp_reset(port, 0);
+    s_t.state = T_LISTEN;
+}
+
+void perf_tcp_write(const void *data, uint32_t len)
+{
+    if (s_res.tx_len + len > TX_MAX || s_t.closing)
+    {
+        fprintf(stderr, "perf_peer: write past the send buffer or after close\n");
+        exit(2);
+    }
+    if (data)
+        memcpy(s_tx + s_res.tx_len, data, len);
+    else
+        memset(s_tx + s_res.tx_len, 0, len);
+    s_res.tx_len += len;
+    try_send();
+}
+
+void perf_tcp_close(void)
+{
+    s_t.closing = 1;
+    try_send();
+}
+
+uint32_t perf_tcp_read(void *buf, uint32_t len)
+{
+    uint8_t *p = buf;
+    uint32_t n = 0;
+
+    s_t.reading = 1;
+    while (n < len && s_res.rx_read < s_res.rx_bytes)
+        p[n++] = s_ring[s_res.rx_read++ % RING];
+    /* announce the window once it is half open again */
+    if (n && s_t.state == T_OPEN && s_t.adv < PEER_WND / 2 && rcv_wnd() >= PEER_WND / 2)
+        send_ack();
+    return n;
+}
+
+const perf_tcp_t *perf_tcp(void)
+{
+    return &s_res;
+}
+
+const uint8_t *perf_tcp_rx_data(void)
+{
+    return s_rx;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Waits                                                                     */
+/*---------------------------------------------------------------------------*/
+
+static int wait(int (*done)(uint32_t), uint32_t n, uint64_t limit_ns)
+{
+    uint64_t end = lwip_sim_time_ns() + limit_ns;
+
+    while (!done(n))
+    {
+        if (s_res.reset || lwip_sim_time_ns() >= end)
+            return -1;
+        lwip_sim_sleep_until(lwip_sim_time_ns() + POLL_NS);
+    }
+    return 0;
+}
+
+static int is_established(uint32_t n)
+{
+    return s_res.established;
+}
+
+static int has_rx(uint32_t n)
+{
+    return s_res.rx_bytes >= n;
+}
+
+static int is_acked(uint32_t n)
+{
+    return s_res.tx_acked == s_res.tx_len;
+}
+
+static int has_fin(uint32_t n)
+{
+    return s_res.fin_rcvd;
+}
+
+static int is_closed(uint32_t n)
+{
+    return s_res.closed_ns && !s_res.reset;
+}
+
+static int has_udp(uint32_t n)
+{
+    return s_udp.rx >= n;
+}
+
+int perf_tcp_wait_established(uint64_t limit_ns)
+{
+    return wait(is_established, 0, limit_ns);
+}
+
+int perf_tcp_wait_rx(uint32_t n, uint64_t limit_ns)
+{
+    return wait(has_rx, n, limit_ns);
+}
+
+int perf_tcp_wait_acked(uint64_t limit_ns)
+{
+    return wait(is_acked, 0, limit_ns);
+}
+
+int perf_tcp_wait_fin(uint64_t limit_ns)
+{
+    return wait(has_fin, 0, limit_ns);
+}
+
+int perf_tcp_wait_closed(uint64_t limit_ns)
+{
+    return wait(is_closed, 0, limit_ns);
+}
+
+const perf_udp_t *perf_udp(void)
+{
+    return &s_udp;
+}
+
+int perf_udp_wait_rx(uint32_t n, uint64_t limit_ns)
+{
+    return wait(has_udp, n, limit_ns);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void peer_rx(const uint8_t *f, int len)
+{
+    const uint8_t *ip = f + 14, *l4;
+    int ihl, tot;
+
+    if (len < 14)
+        return;
+    if (get16(f + 12) == 0x0806)
+    {
+        if (len >= 42 && get16(f + 20) == 1 && memcmp(f + 38, s_peer_ip, 4) == 0)
+            arp(2, f + 22, f + 28);
+        return;
+    }
+    if (len < 34 || get16(f + 12) != 0x0800 || memcmp(ip + 16, s_peer_ip, 4) ||
+            (get16(ip + 6) & 0x3FFF))
+        return;
+    ihl = (ip[0] & 0x0F) * 4;
+    tot = get16(ip + 2);
+    if (tot > len - 14 || tot < ihl + 8)
+        return;
+    l4 = ip + ihl;
+
+    if (ip[9] == 17)
+    {
+        s_udp.rx++;
+        s_udp.rx_bytes += get16(l4 + 4) - 8;
+        s_udp.last_rx_ns = lwip_sim_time_ns();
+    }
+    else if (ip[9] == 6 && tot >= ihl + 20 && get16(l4 + 2) == s_t.lport &&
+             (s_t.state == T_LISTEN || get16(l4) == s_t.rport))
+        on_tcp(l4, tot - ihl);
+}
+
+void perf_peer_init(const uint8_t peer_ip[4], const uint8_t board_ip[4])
+{
+    memcpy(s_peer_ip, peer_ip, 4);
+    memcpy(s_board_ip, board_ip, 4);
+    s_peer_mac[5] = peer_ip[3];
+    lwip_sim_wire_peer(peer_rx);
+}
@@ -0,0 +1,87 @@
+/*
+ * TCP and UDP far end for the benchmarks of the lwIP samples.
+ *
+ * A small TCP of its own on raw frames of the simulated wire, enough to
+ * drive lwiperf, the echo servers and the web servers of the samples: one
+ * connection at a time, opened actively or passively, MSS 1460, a 65535
+ * byte window without scaling and an ACK for every segment received.
+ * Received data is kept for perf_tcp_rx_data() and perf_tcp_read(). Lost
+ * segments are sent again from the oldest unacknowledged byte on three
+ * duplicate ACKs or a 250 ms timeout. There is no congestion control, so
+ * the board's window and the wire are the only limits. UDP datagrams are
+ * sent from and counted at any port.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef PERF_PEER_H
+#define PERF_PEER_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    int established;                /* handshake complete */
+    int fin_rcvd, fin_acked;        /* the board closed, our FIN was acknowledged */
+    int reset;                      /* the board sent RST */
+    uint16_t mss;                   /* announced by the board */
+    uint32_t tx_len, tx_acked;      /* bytes written and acknowledged by the board */
+    uint32_t rx_bytes;              /* bytes received in order */
+    uint32_t rx_read;               /* of those, taken by perf_tcp_read() */
+    uint32_t retransmits;           /* segments sent again */
+    uint32_t out_of_order;          /* segments from the board that were not next */
+    uint32_t zero_windows;          /* ACKs of the board closing its window */
+    uint64_t syn_ns, est_ns;        /* SYN sent or received, handshake complete */
+    uint64_t first_rx_ns, last_rx_ns;   /* first and latest data from the board */
+    uint64_t last_ack_ns;           /* latest ACK of new data */
+    uint64_t closed_ns;             /* both FINs acknowledged, or RST */
+} perf_tcp_t;
+
+typedef struct
+{
+    uint32_t rx, rx_bytes;          /* datagrams and payload bytes from the board */
+    uint64_t last_rx_ns;
+} perf_udp_t;
+
+/* Take the wire: lwip_sim_wire_peer() */
+void perf_peer_init(const uint8_t peer_ip[4], const uint8_t board_ip[4]);
+
+/* Ask the board for its address so its first packet does not wait for ARP */
+void perf_peer_arp(void);
+
+/* Open a connection to port of the board, or accept the next one the board
+ * opens to port. Either starts a new connection record. */
+void perf_tcp_connect(uint16_t port);
+void perf_tcp_listen(uint16_t port);
+
+/* Queue len bytes to send, NULL for zeros. FIN follows the queued data
+ * after perf_tcp_close(). */
+void perf_tcp_write(const void *data, uint32_t len);
+void perf_tcp_close(void);
+
+const perf_tcp_t *perf_tcp(void);
+
+/* The first bytes received, up to PERF_RX_KEEP of them */
+#define PERF_RX_KEEP    (256 * 1024)
+const uint8_t *perf_tcp_rx_data(void);
+
+/* Take up to len received bytes, returns how many. Once it is called, the
+ * window we announce is what is left of the 65535 bytes after the bytes not
+ * yet read, so a slow reader slows the board down like a real receiver. */
+uint32_t perf_tcp_read(void *buf, uint32_t len);
+
+/* Block the calling task until the connection is established, rx_bytes
+ * reaches n, everything written is acknowledged, the board has closed its
+ * side, or both sides are closed. Return 0, or -1 when limit_ns passes
+ * first or the board resets the connection. */
+int perf_tcp_wait_established(uint64_t limit_ns);
+int perf_tcp_wait_rx(uint32_t n, uint64_t limit_ns);
+int perf_tcp_wait_acked(uint64_t limit_ns);
+int perf_tcp_wait_fin(uint64_t limit_ns);
+int perf_tcp_wait_closed(uint64_t limit_ns);
+
+/* UDP */
+void perf_udp_send(uint16_t sport, uint16_t dport, const void *data, int len);
+const perf_udp_t *perf_udp(void);
+int perf_udp_wait_rx(uint32_t n, uint64_t limit_ns);
+
+#endif /* PERF_PEER_H */
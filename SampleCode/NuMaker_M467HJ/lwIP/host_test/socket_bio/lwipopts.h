@@ -0,0 +1,19 @@
+/*
+ * LwIP_SSL_Server as it was built before net_sockets.c moved to netconn:
+ * the same lwipopts.h with the BSD socket layer back on. test_net_sockets
+ * runs against it with the socket net_sockets.c of that time, kept here,
+ * to compare the two. That file only has _POSIX_C_SOURCE made conditional,
+ * the host build defines it already.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef SOCKET_BIO_LWIPOPTS_H
+#define SOCKET_BIO_LWIPOPTS_H
+
+#include "../../../LwIP_SSL_Server/lwipopts.h"
+
+#undef LWIP_SOCKET
+#undef LWIP_SO_RCVTIMEO
+#define LWIP_POSIX_SOCKETS_IO_NAMES     1
+
+#endif /* SOCKET_BIO_LWIPOPTS_H */
@@ -0,0 +1,472 @@
+/*
+ * Checksum offload tests of the lwIP port on the simulated GMAC.
+ *
+ * The board runs the LwIP_TCP_EchoServer configuration with
+ * LWIP_USING_HW_CHECKSUM=1. The test is the far end of the wire and sends
+ * raw frames: good ones, and ones with a bad IPv4 header, TCP, UDP or ICMP
+ * checksum. Bad frames must be dropped and counted, first by the GMAC (DT
+ * clear, as EMAC_Open() leaves it) and then by the driver (DT set), which
+ * must give their buffers back to the rx ring and go on draining it. Every
+ * frame the board sends must carry good checksums, including the fragments
+ * of an echo reply too large for one frame, whose payload the GMAC does not
+ * touch.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "lwip/udp.h"
+#include "lwip/tcp.h"
+#include "netif/ethernetif.h"
+#include "m460_emac.h"
+#include "lwip_sim.h"
+
+#define PEER_IP         { 192, 168, 1, 100 }
+#define BOARD_IP        { 192, 168, 1, 2 }
+#define ECHO_PORT       7
+#define HTTP_PORT       80
+#define BIG_PING        3000
+
+/* mainCHECK_TASK_PRIORITY of the sample, above RX_THREAD_PRIO */
+#define MAIN_PRIO       3
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+u8 my_mac_addr[6] = DEFAULT_MAC0_ADDRESS;
+
+static const uint8_t s_peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x64 };
+static const uint8_t s_peer_ip[4] = PEER_IP;
+static const uint8_t s_board_ip[4] = BOARD_IP;
+
+static struct netif s_netif;
+static uint16_t s_ip_id = 1, s_sport = 40000;
+
+/* What the far end saw */
+static int s_echo_replies, s_udp_replies, s_synacks, s_udp_rx;
+static int s_tx_bad_ip, s_tx_bad_l4, s_tx_no_l4;
+static uint8_t s_frag_buf[BIG_PING + 64];
+static int s_frag_bytes, s_frag_total, s_big_replies, s_big_bad;
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint32_t sum16(const uint8_t *p, int len, uint32_t sum)
+{
+    for (; len > 1; p += 2, len -= 2)
+        sum += get16(p);
+    if (len)
+        sum += (uint32_t)p[0] << 8;
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/* Checksum of a TCP, UDP or ICMP message carried by the IPv4 header ip */
+static uint16_t l4_sum(const uint8_t *ip, uint8_t proto, const uint8_t *msg, int len)
+{
+    uint32_t sum = sum16(msg, len, 0);
+
+    if (proto != 1)
+        sum += sum16(ip + 12, 8, 0) + proto + (uint32_t)len;
+    return fold(sum);
+}
+
+static int l4_offset(uint8_t proto)
+{
+    return proto == 6 ? 16 : proto == 17 ? 6 : 2;
+}
+
+/* Ethernet and IPv4 headers around msg. frag is the flags and offset field. */
+static int ip_frame(uint8_t *f, uint8_t proto, const uint8_t *msg, int len, uint16_t id, uint16_t frag)
+{
+    uint8_t *ip = f + 14;
+
+    memcpy(f, my_mac_addr, 6);
+    memcpy(f + 6, s_peer_mac, 6);
+    put16(f + 12, 0x0800);
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    put16(ip + 2, (uint16_t)(20 + len));
+    put16(ip + 4, id);
+    put16(ip + 6, frag);
+    ip[8] = 64;
+    ip[9] = proto;
+    memcpy(ip + 12, s_peer_ip, 4);
+    memcpy(ip + 16, s_board_ip, 4);
+    put16(ip + 10, fold(sum16(ip, 20, 0)));
+    memcpy(ip + 20, msg, len);
+    return 14 + 20 + len;
+}
+
+/* A whole datagram in one frame with its checksum filled in */
+static int datagram(uint8_t *f, uint8_t proto, uint8_t *msg, int len)
+{
+    int off = l4_offset(proto);
+
+    put16(msg + off, 0);
+    len = ip_frame(f, proto, msg, len, s_ip_id++, 0);
+    put16(f + 34 + off, l4_sum(f + 14, proto, f + 34, len - 34));
+    return len;
+}
+
+static int ping(uint8_t *f, int len)
+{
+    uint8_t msg[1480];
+    int i;
+
+    memset(msg, 0, 8);
+    msg[0] = 8;
+    put16(msg + 4, 0x1234);
+    put16(msg + 6, (uint16_t)s_ip_id);
+    for (i = 8; i < len; i++)
+        msg[i] = (uint8_t)i;
+    return datagram(f, 1, msg, len);
+}
+
+static int udp(uint8_t *f, int len)
+{
+    uint8_t msg[1480];
+    int i;
+
+    put16(msg, s_sport);
+    put16(msg + 2, ECHO_PORT);
+    put16(msg + 4, (uint16_t)len);
+    for (i = 8; i < len; i++)
+        msg[i] = (uint8_t)('a' + i % 26);
+    return datagram(f, 17, msg, len);
+}
+
+static int syn(uint8_t *f)
+{
+    uint8_t msg[20];
+
+    memset(msg, 0, sizeof(msg));
+    put16(msg, s_sport++);
+    put16(msg + 2, HTTP_PORT);
+    put16(msg + 4, 0x1000);
+    msg[12] = 5 << 4;
+    msg[13] = 0x02;
+    put16(msg + 14, 8192);
+    return datagram(f, 6, msg, sizeof(msg));
+}
+
+enum { BAD_IP, BAD_TCP, BAD_UDP, BAD_ICMP };
+
+/* Flip bits of the checksum the frame was built with */
+static void corrupt(uint8_t *f, int what)
+{
+    uint8_t *ip = f + 14;
+
+    if (what == BAD_IP)
+        ip[10] ^= 0x5A;
+    else
+        ip[20 + l4_offset(ip[9])] ^= 0x5A;
+}
+
+static int bad_frame(uint8_t *f, int what)
+{
+    int len = what == BAD_TCP ? syn(f) : what == BAD_UDP ? udp(f, 64) : ping(f, 64);
+
+    corrupt(f, what);
+    return len;
+}
+
+static void arp(int op, const uint8_t *mac, const uint8_t *ip)
+{
+    uint8_t f[42];
+
+    memcpy(f, op == 1 ? (const uint8_t *)"\xff\xff\xff\xff\xff\xff" : mac, 6);
+    memcpy(f + 6, s_peer_mac, 6);
+    put16(f + 12, 0x0806);
+    put16(f + 14, 1);
+    put16(f + 16, 0x0800);
+    f[18] = 6;
+    f[19] = 4;
+    put16(f + 20, (uint16_t)op);
+    memcpy(f + 22, s_peer_mac, 6);
+    memcpy(f + 28, s_peer_ip, 4);
+    memcpy(f + 32, op == 1 ? (const uint8_t *)"\0\0\0\0\0\0" : mac, 6);
+    memcpy(f + 38, ip, 4);
+    lwip_sim_wire_to_board(f, sizeof(f));
+}
+
+/* Answer a SYN-ACK with a reset, so the board does not retransmit it */
+static void tcp_reset(const uint8_t *ip, const uint8_t *seg)
+{
+    uint8_t f[64], msg[20];
+
+    memset(msg, 0, sizeof(msg));
+    memcpy(msg, seg + 2, 2);
+    memcpy(msg + 2, seg, 2);
+    memcpy(msg + 4, seg + 8, 4);
+    msg[12] = 5 << 4;
+    msg[13] = 0x04;
+    lwip_sim_wire_to_board(f, datagram(f, 6, msg, sizeof(msg)));
+}
+
+static void big_reply_fragment(const uint8_t *ip, int ihl, int tot)
+{
+    int off = (get16(ip + 6) & 0x1FFF) * 8, len = tot - ihl;
+
+    if (off + len > (int)sizeof(s_frag_buf))
+        return;
+    memcpy(s_frag_buf + off, ip + ihl, len);
+    s_frag_bytes += len;
+    if (!(get16(ip + 6) & 0x2000))
+        s_frag_total = off + len;
+    if (s_frag_total && s_frag_bytes == s_frag_total)
+    {
+        s_big_replies++;
+        if (s_frag_buf[0] != 0 || s_frag_total != BIG_PING || fold(sum16(s_frag_buf, s_frag_total, 0)) != 0)
+            s_big_bad++;
+        s_frag_bytes = s_frag_total = 0;
+    }
+}
+
+/* Everything the GMAC sends */
+static void peer_rx(const uint8_t *f, int len)
+{
+    const uint8_t *ip = f + 14, *msg;
+    int ihl, tot, off;
+
+    if (get16(f + 12) == 0x0806)
+    {
+        if (get16(f + 20) == 1 && memcmp(f + 38, s_peer_ip, 4) == 0)
+            arp(2, f + 22, f + 28);
+        return;
+    }
+    if (get16(f + 12) != 0x0800)
+        return;
+
+    ihl = (ip[0] & 0x0F) * 4;
+    tot = get16(ip + 2);
+    if (fold(sum16(ip, ihl, 0)) != 0)
+        s_tx_bad_ip++;
+    msg = ip + ihl;
+    if (get16(ip + 6) & 0x3FFF)
+    {
+        if (ip[9] == 1)
+            big_reply_fragment(ip, ihl, tot);
+        return;
+    }
+    if (ip[9] != 1 && ip[9] != 6 && ip[9] != 17)
+        return;
+    off = l4_offset(ip[9]);
+    if (get16(msg + off) == 0)
+        s_tx_no_l4++;
+    else if (l4_sum(ip, ip[9], msg, tot - ihl) != 0)
+        s_tx_bad_l4++;
+
+    if (ip[9] == 1 && msg[0] == 0)
+        s_echo_replies++;
+    else if (ip[9] == 17 && get16(msg) == ECHO_PORT)
+        s_udp_replies++;
+    else if (ip[9] == 6 && (msg[13] & 0x12) == 0x12)
+    {
+        s_synacks++;
+        tcp_reset(ip, msg);
+    }
+}
+
+/* Board side: UDP echo on port 7 and a TCP listener on port 80, in tcpip_thread */
+static void udp_echo(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    s_udp_rx++;
+    udp_sendto(pcb, p, addr, port);
+    pbuf_free(p);
+}
+
+static err_t board_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    tcp_abort(pcb);
+    return ERR_ABRT;
+}
+
+static void board_apps(void *arg)
+{
+    struct udp_pcb *u = udp_new();
+    struct tcp_pcb *t = tcp_new();
+
+    udp_bind(u, IP_ADDR_ANY, ECHO_PORT);
+    udp_recv(u, udp_echo, NULL);
+    tcp_bind(t, IP_ADDR_ANY, HTTP_PORT);
+    t = tcp_listen(t);
+    tcp_accept(t, board_accept);
+}
+
+static void settle(uint64_t ms)
+{
+    lwip_sim_sleep_until(lwip_sim_time_ns() + ms * LWIP_SIM_MS);
+}
+
+static void send_frame(uint8_t *f, int len)
+{
+    lwip_sim_wire_to_board(f, len);
+}
+
+/* Good frames of every kind get their answer */
+static void good_frames(const char *what)
+{
+    uint8_t f[1536];
+    int echo = s_echo_replies, udpr = s_udp_replies, syna = s_synacks;
+
+    send_frame(f, ping(f, 64));
+    send_frame(f, udp(f, 100));
+    send_frame(f, syn(f));
+    settle(20);
+    CHECK(s_echo_replies == echo + 1);
+    CHECK(s_udp_replies == udpr + 1);
+    CHECK(s_synacks == syna + 1);
+    printf("  %-28s echo %d, udp %d, syn-ack %d\n", what,
+           s_echo_replies - echo, s_udp_replies - udpr, s_synacks - syna);
+}
+
+/* One bad frame of every kind: no answer, and counted */
+static void bad_frames(const char *what, int hw_drop)
+{
+    const lwip_sim_stats_t *st = lwip_sim_stats();
+    EMAC_CSUM_STATS_T a, b;
+    uint8_t f[1536];
+    int echo = s_echo_replies, udpr = s_udp_replies, syna = s_synacks, rx = s_udp_rx;
+    uint64_t hw = st->rx_csum_dropped;
+    int i;
+
+    EMAC_GetCsumStats(&a);
+    for (i = BAD_IP; i <= BAD_ICMP; i++)
+        send_frame(f, bad_frame(f, i));
+    settle(20);
+    EMAC_GetCsumStats(&b);
+
+    CHECK(s_echo_replies == echo && s_udp_replies == udpr && s_synacks == syna && s_udp_rx == rx);
+    CHECK(b.u32IpHeader - a.u32IpHeader == 1);
+    CHECK(b.u32Tcp - a.u32Tcp == 1);
+    CHECK(b.u32Udp - a.u32Udp == 1);
+    CHECK(b.u32Icmp - a.u32Icmp == 1);
+    CHECK(st->rx_csum_dropped - hw == (hw_drop ? 4 : 0));
+    CHECK(b.u32SwDropped - a.u32SwDropped == (hw_drop ? 0 : 4));
+    printf("  %-28s ip %u tcp %u udp %u icmp %u, dropped by GMAC %llu, by driver %u\n", what,
+           b.u32IpHeader - a.u32IpHeader, b.u32Tcp - a.u32Tcp, b.u32Udp - a.u32Udp,
+           b.u32Icmp - a.u32Icmp, (unsigned long long)(st->rx_csum_dropped - hw),
+           b.u32SwDropped - a.u32SwDropped);
+}
+
+static void run(void *arg)
+{
+    const lwip_sim_stats_t *st = lwip_sim_stats();
+    ip4_addr_t ipaddr, netmask, gw;
+    EMAC_CSUM_STATS_T a, b;
+    uint8_t f[1536], msg[BIG_PING];
+    uint64_t no_desc;
+    int i, n, rx, big;
+
+    lwip_sim_wire_peer(peer_rx);
+    lwip_sim_wire_delay(10 * LWIP_SIM_US);
+
+    IP4_ADDR(&ipaddr, 192, 168, 1, 2);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gw, 192, 168, 1, 1);
+    tcpip_init(NULL, NULL);
+    netif_add(&s_netif, &ipaddr, &netmask, &gw, NULL, ethernetif_init, tcpip_input);
+    netif_set_default(&s_netif);
+    netif_set_up(&s_netif);
+    tcpip_callback(board_apps, NULL);
+    /* so the board knows the far end before its first answer */
+    arp(1, NULL, s_board_ip);
+    settle(10);
+
+    /* DT clear: the GMAC drops bad frames */
+    good_frames("good frames");
+    bad_frames("bad frames, DT clear", 1);
+
+    /* DT set: the driver drops them */
+    synopGMACSetBits(EMAC_BASE + DMABASE, DmaControl, DmaDisableDropTcpCs);
+    bad_frames("bad frames, DT set", 0);
+
+    /* More bad frames than rx descriptors: the ring must get every buffer back */
+    no_desc = st->rx_no_desc;
+    EMAC_GetCsumStats(&a);
+    for (i = 0; i < 2 * RECEIVE_DESC_SIZE; i++)
+        send_frame(f, bad_frame(f, BAD_UDP));
+    settle(20);
+    EMAC_GetCsumStats(&b);
+    CHECK(b.u32SwDropped - a.u32SwDropped == 2 * RECEIVE_DESC_SIZE);
+    CHECK(st->rx_no_desc == no_desc);
+    good_frames("good frames after the burst");
+
+    /* A good frame queued behind bad ones is taken in the same pass over the
+       ring: all three are in it before the one interrupt for them */
+    rx = s_udp_rx;
+    NVIC_DisableIRQ(EMAC0_TXRX_IRQn);
+    send_frame(f, bad_frame(f, BAD_UDP));
+    send_frame(f, bad_frame(f, BAD_UDP));
+    send_frame(f, udp(f, 100));
+    settle(1);
+    CHECK(s_udp_rx == rx);
+    NVIC_EnableIRQ(EMAC0_TXRX_IRQn);
+    settle(20);
+    CHECK(s_udp_rx == rx + 1);
+
+    /* A ping of BIG_PING bytes comes in three fragments and goes back in three */
+    msg[0] = 8;
+    msg[1] = 0;
+    put16(msg + 2, 0);
+    put16(msg + 4, 0x1234);
+    put16(msg + 6, 99);
+    for (i = 8; i < BIG_PING; i++)
+        msg[i] = (uint8_t)(i * 7);
+    put16(msg + 2, fold(sum16(msg, BIG_PING, 0)));
+    big = s_big_replies;
+    for (i = 0; i < BIG_PING; i += n)
+    {
+        n = BIG_PING - i > 1480 ? 1480 : BIG_PING - i;
+        send_frame(f, ip_frame(f, 1, msg + i, n, 0x7777, (uint16_t)((i / 8) | (i + n < BIG_PING ? 0x2000 : 0))));
+    }
+    settle(20);
+    CHECK(s_big_replies == big + 1);
+    CHECK(s_big_bad == 0);
+    printf("  %-28s %d reply, %d with a bad ICMP checksum\n", "fragmented echo",
+           s_big_replies - big, s_big_bad);
+
+    CHECK(s_tx_bad_ip == 0);
+    CHECK(s_tx_bad_l4 == 0);
+    CHECK(s_tx_no_l4 == 0);
+    CHECK(st->tx_csum_inserted > 0);
+    CHECK(st->masked_blocks == 0);
+    CHECK(st->isr_storms == 0);
+    printf("  board sent %llu frames, %llu checksums inserted by the GMAC, %d bad\n",
+           (unsigned long long)st->tx_frames, (unsigned long long)st->tx_csum_inserted,
+           s_tx_bad_ip + s_tx_bad_l4 + s_tx_no_l4);
+}
+
+int main(void)
+{
+    CHECK(lwip_sim_run(run, NULL, MAIN_PRIO, 10 * LWIP_SIM_S) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,694 @@
+/*
+ * mbedtls_net_*() of LwIP_SSL_Server on the simulated GMAC.
+ *
+ * Built against the sample's net_sockets.c on netconn, with a table of
+ * MBEDTLS_NET_MAX_CONN 3, the test checks
+ * - reads of any size from netbufs of one segment, and from the pbuf chain
+ *   TCP hands up when a lost segment fills a gap in front of queued ones,
+ * - mbedtls_net_recv_timeout() running out, and waiting forever on 0,
+ * - the peer closing, before and during a read,
+ * - mbedtls_net_accept() and mbedtls_net_connect() with the table full.
+ *
+ * Built with NET_BIO_BSD against the BSD socket net_sockets.c it replaced
+ * (socket_bio/), only the benchmark runs. For both it reports, in one
+ * board task,
+ * - mbedtls_net_recv() and mbedtls_net_send() moving 4 MB in the calls
+ *   mbedTLS makes for full records,
+ * - an HTTPS download of 1 MB from a TLS server over the BIO to
+ *   tls_peer.c, at 0 and 1 ms round trip time,
+ * with simulated throughput, the host CPU time of the board tasks and the
+ * peak RAM: lwIP heap and pools, the mbedTLS heap of the server task and
+ * the lwip_sock table the socket layer adds.
+ *
+ * Simulated time has no processing time, so throughput only shows the
+ * wire and the TCP settings, which both BIOs share. The host CPU time is
+ * x86-64 time of the same code: it compares the two, it does not predict
+ * the board.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "lwip/priv/memp_priv.h"
+#include "lwip/pool_prof.h"
+#include "netif/ethernetif.h"
+#include "m460_emac.h"
+
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+#include "test/certs.h"
+
+#include "lwip_sim.h"
+#include "perf_peer.h"
+#include "tls_peer.h"
+
+#if defined(NET_BIO_BSD)
+#include <sys/time.h>
+#include "lwip/priv/sockets_priv.h"
+#define BIO             "BSD sockets"
+#else
+#define BIO             "netconn"
+#endif
+
+/* mainCHECK_TASK_PRIORITY of the sample, and SSLSERVER_THREAD_PRIO of
+ * ssl_server.c for the board tasks */
+#define MAIN_PRIO       3
+#define BOARD_PRIO      2
+#define BOARD_STACK     2000
+
+#define TEST_PORT       7
+#define PEER_PORT       7000
+#define TLS_PORT        443
+
+#define RECORD          (16384 + 29)        /* TLS 1.2 AES-GCM record, header included */
+#define BIO_BYTES       (4 * 1024 * 1024)
+#define HTTPS_BYTES     (1024 * 1024)
+#define HTTPS_WRITE     4096
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+u8 my_mac_addr[6] = DEFAULT_MAC0_ADDRESS;
+
+static const uint8_t s_peer_ip[4] = { 192, 168, 1, 100 };
+static const uint8_t s_board_ip[4] = { 192, 168, 1, 2 };
+
+static struct netif s_netif;
+static mbedtls_net_context s_listen;
+static uint8_t s_data[64 * 1024];
+static unsigned char s_buf[RECORD];
+
+static void settle(uint64_t ms)
+{
+    lwip_sim_sleep_until(lwip_sim_time_ns() + ms * LWIP_SIM_MS);
+}
+
+static double mbit_s(uint64_t bytes, uint64_t ns)
+{
+    return ns ? bytes * 8.0 * 1000.0 / ns : 0;
+}
+
+/* Host CPU microseconds per MB */
+static double us_mb(uint64_t ns, uint64_t bytes)
+{
+    return bytes ? ns / 1e3 * (1024.0 * 1024.0) / bytes : 0;
+}
+
+#if !defined(NET_BIO_BSD)
+
+/*---------------------------------------------------------------------------*/
+/* Behaviour                                                                 */
+/*---------------------------------------------------------------------------*/
+
+static uint64_t ms_since(uint64_t t0)
+{
+    return (lwip_sim_time_ns() - t0) / LWIP_SIM_MS;
+}
+
+/* Peer actions at a later time, while the board blocks */
+static void peer_write(void *arg)
+{
+    perf_tcp_write(s_data, (uint32_t)(uintptr_t)arg);
+}
+
+static void peer_close(void *arg)
+{
+    perf_tcp_close();
+}
+
+/* The peer connects to TEST_PORT and the board accepts */
+static int accept_peer(mbedtls_net_context *ctx)
+{
+    uint8_t ip[16];
+    size_t ip_len = 0;
+    int ret;
+
+    perf_tcp_connect(TEST_PORT);
+    ret = mbedtls_net_accept(&s_listen, ctx, ip, sizeof(ip), &ip_len);
+    CHECK(ret == 0);
+    CHECK(ip_len == 4 && memcmp(ip, s_peer_ip, 4) == 0);
+    CHECK(perf_tcp_wait_established(LWIP_SIM_S) == 0);
+    return ret;
+}
+
+static void close_peer(mbedtls_net_context *ctx)
+{
+    mbedtls_net_free(ctx);
+    CHECK(ctx->fd == -1);
+    perf_tcp_close();
+    CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+}
+
+/* Every segment is a netbuf of one pbuf: a read returns what is asked for
+ * or the rest of the netbuf, whichever is less */
+static void test_segments(void)
+{
+    static const uint32_t ask[] = { 1, 7, 333, 999, 1001, TCP_MSS, 4000 };
+    mbedtls_net_context c;
+    uint32_t mss, pos = 0, end, len, want, i = 0;
+    int n;
+
+    mbedtls_net_init(&c);
+    if (accept_peer(&c) != 0)
+        return;
+    mss = perf_tcp()->mss;
+    CHECK(mss == TCP_MSS);
+    perf_tcp_write(s_data, 4000);
+
+    while (pos < 4000)
+    {
+        end = (pos / mss + 1) * mss;
+        if (end > 4000)
+            end = 4000;
+        len = ask[i++ % (sizeof(ask) / sizeof(ask[0]))];
+        want = len < end - pos ? len : end - pos;
+        n = mbedtls_net_recv(&c, s_buf, len);
+        CHECK(n == (int)want);
+        if (n <= 0)
+            break;
+        CHECK(memcmp(s_buf, s_data + pos, n) == 0);
+        pos += n;
+    }
+    CHECK(pos == 4000);
+    close_peer(&c);
+}
+
+/* Drop the first segment of a window's worth: the rest waits out of order
+ * until it is sent again, then TCP passes the whole window up as one pbuf
+ * chain, and reads cross from pbuf to pbuf */
+static int s_drop;
+
+static int drop_first_data(int dir, uint8_t *frame, int *len)
+{
+    const uint8_t *ip = frame + 14, *tcp;
+    int ihl, tot;
+
+    if (!s_drop || dir != LWIP_SIM_TO_BOARD || *len < 54 || frame[12] != 0x08 ||
+            frame[13] != 0x00 || ip[9] != 6)
+        return 1;
+    ihl = (ip[0] & 0x0F) * 4;
+    tot = (ip[2] << 8) | ip[3];
+    tcp = ip + ihl;
+    if (tot - ihl - (tcp[12] >> 4) * 4 <= 0)
+        return 1;
+    s_drop = 0;
+    return 0;
+}
+
+static void test_chain(void)
+{
+    mbedtls_net_context c;
+    uint32_t burst = TCP_WND;
+    int n;
+
+    mbedtls_net_init(&c);
+    if (accept_peer(&c) != 0)
+        return;
+    CHECK(burst >= 4 * TCP_MSS);
+
+    s_drop = 1;
+    lwip_sim_wire_hook(drop_first_data);
+    perf_tcp_write(s_data, burst);
+
+    /* inside the first pbuf, across the next two, then the rest */
+    n = mbedtls_net_recv(&c, s_buf, 100);
+    CHECK(n == 100);
+    CHECK(memcmp(s_buf, s_data, 100) == 0);
+    n = mbedtls_net_recv(&c, s_buf, 2 * TCP_MSS);
+    CHECK(n == 2 * TCP_MSS);
+    CHECK(memcmp(s_buf, s_data + 100, 2 * TCP_MSS) == 0);
+    n = mbedtls_net_recv(&c, s_buf, sizeof(s_buf));
+    CHECK(n == (int)burst - 100 - 2 * TCP_MSS);
+    CHECK(n > 0 && memcmp(s_buf, s_data + 100 + 2 * TCP_MSS, n) == 0);
+
+    lwip_sim_wire_hook(NULL);
+    CHECK(lwip_sim_stats()->wire_dropped == 1);
+    CHECK(perf_tcp()->retransmits > 0);
+
+    /* the data after it comes one segment at a time again */
+    perf_tcp_write(s_data, 10);
+    CHECK(mbedtls_net_recv(&c, s_buf, sizeof(s_buf)) == 10);
+    close_peer(&c);
+}
+
+static void test_timeout(void)
+{
+    mbedtls_net_context c;
+    uint64_t t0, ms;
+    int n;
+
+    mbedtls_net_init(&c);
+    if (accept_peer(&c) != 0)
+        return;
+
+    t0 = lwip_sim_time_ns();
+    n = mbedtls_net_recv_timeout(&c, s_buf, 100, 50);
+    ms = ms_since(t0);
+    CHECK(n == MBEDTLS_ERR_SSL_TIMEOUT);
+    /* in ticks, the first of them already begun */
+    CHECK(ms >= 49 && ms <= 50);
+
+    /* data before the timeout ends the wait early */
+    lwip_sim_event_at(lwip_sim_time_ns() + 20 * LWIP_SIM_MS, peer_write, (void *)(uintptr_t)10);
+    t0 = lwip_sim_time_ns();
+    n = mbedtls_net_recv_timeout(&c, s_buf, 100, 1000);
+    ms = ms_since(t0);
+    CHECK(n == 10);
+    CHECK(ms >= 20 && ms < 30);
+
+    /* mbedtls_net_recv() waits as long as it takes: the timeout of the
+       earlier call is not left behind */
+    lwip_sim_event_at(lwip_sim_time_ns() + 2 * LWIP_SIM_S, peer_write, (void *)(uintptr_t)10);
+    t0 = lwip_sim_time_ns();
+    n = mbedtls_net_recv(&c, s_buf, 100);
+    ms = ms_since(t0);
+    CHECK(n == 10);
+    CHECK(ms >= 2000);
+
+    /* a timeout of 0 on mbedtls_net_recv_timeout() waits as long too */
+    lwip_sim_event_at(lwip_sim_time_ns() + 2 * LWIP_SIM_S, peer_write, (void *)(uintptr_t)10);
+    t0 = lwip_sim_time_ns();
+    n = mbedtls_net_recv_timeout(&c, s_buf, 100, 0);
+    CHECK(n == 10);
+    CHECK(ms_since(t0) >= 2000);
+    close_peer(&c);
+}
+
+static void test_close(void)
+{
+    mbedtls_net_context c;
+    uint64_t t0;
+
+    /* data and FIN are in: the data, then end of stream for good */
+    mbedtls_net_init(&c);
+    if (accept_peer(&c) != 0)
+        return;
+    perf_tcp_write(s_data, 10);
+    perf_tcp_close();
+    settle(10);
+    CHECK(mbedtls_net_recv(&c, s_buf, 100) == 10);
+    CHECK(mbedtls_net_recv(&c, s_buf, 100) == 0);
+    CHECK(mbedtls_net_recv(&c, s_buf, 100) == 0);
+    CHECK(mbedtls_net_recv_timeout(&c, s_buf, 100, 50) == 0);
+    mbedtls_net_free(&c);
+    CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+
+    /* FIN while the board waits in a read */
+    if (accept_peer(&c) != 0)
+        return;
+    lwip_sim_event_at(lwip_sim_time_ns() + 30 * LWIP_SIM_MS, peer_close, NULL);
+    t0 = lwip_sim_time_ns();
+    CHECK(mbedtls_net_recv(&c, s_buf, 100) == 0);
+    CHECK(ms_since(t0) >= 30);
+    mbedtls_net_free(&c);
+    CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+}
+
+/* s_listen takes one of the MBEDTLS_NET_MAX_CONN entries */
+static void test_full_table(void)
+{
+    mbedtls_net_context a, b, c;
+    int fd;
+
+    mbedtls_net_init(&a);
+    mbedtls_net_init(&b);
+    mbedtls_net_init(&c);
+    CHECK(MBEDTLS_NET_MAX_CONN == 3);
+    if (accept_peer(&a) != 0 || accept_peer(&b) != 0)
+        return;
+
+    /* lwIP accepts, the table has no room: the board closes it again */
+    perf_tcp_connect(TEST_PORT);
+    CHECK(mbedtls_net_accept(&s_listen, &c, NULL, 0, NULL) == MBEDTLS_ERR_NET_ACCEPT_FAILED);
+    CHECK(c.fd == -1);
+    CHECK(perf_tcp_wait_fin(LWIP_SIM_S) == 0);
+    perf_tcp_close();
+    CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+
+    /* the same for a connection of the board */
+    perf_tcp_listen(PEER_PORT);
+    CHECK(mbedtls_net_connect(&c, "192.168.1.100", "7000", MBEDTLS_NET_PROTO_TCP) ==
+          MBEDTLS_ERR_NET_SOCKET_FAILED);
+    CHECK(c.fd == -1);
+    CHECK(perf_tcp_wait_fin(LWIP_SIM_S) == 0);
+    CHECK(perf_tcp()->established);
+    perf_tcp_close();
+    CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+
+    /* a free entry is taken again */
+    fd = a.fd;
+    mbedtls_net_free(&a);
+    if (accept_peer(&c) != 0)
+        return;
+    CHECK(c.fd == fd);
+    perf_tcp_write(s_data, 10);
+    CHECK(mbedtls_net_recv(&c, s_buf, 100) == 10);
+    close_peer(&c);
+    mbedtls_net_free(&b);
+    settle(100);
+}
+
+#endif /* !NET_BIO_BSD */
+
+/*---------------------------------------------------------------------------*/
+/* BIO alone                                                                 */
+/*---------------------------------------------------------------------------*/
+
+enum { BIO_RX, BIO_TX };
+
+static struct
+{
+    int dir;
+    volatile int done;
+    uint32_t bytes;
+    uint64_t done_ns;
+} s_bio;
+
+/* Read exactly len bytes, as mbedTLS does for a header and then a record */
+static int recv_all(mbedtls_net_context *ctx, unsigned char *buf, int len)
+{
+    int n, got = 0;
+
+    while (got < len)
+    {
+        if ((n = mbedtls_net_recv(ctx, buf + got, len - got)) <= 0)
+            return n;
+        got += n;
+    }
+    return got;
+}
+
+static void bio_task(void *arg)
+{
+    mbedtls_net_context c;
+    uint32_t n;
+    int ret;
+
+    mbedtls_net_init(&c);
+    if (mbedtls_net_accept(&s_listen, &c, NULL, 0, NULL) == 0)
+    {
+        if (s_bio.dir == BIO_RX)
+        {
+            while (recv_all(&c, s_buf, 5) == 5 && (ret = recv_all(&c, s_buf + 5, RECORD - 5)) > 0)
+                s_bio.bytes += 5 + ret;
+        }
+        else
+        {
+            while (s_bio.bytes < BIO_BYTES)
+            {
+                n = BIO_BYTES - s_bio.bytes < RECORD ? BIO_BYTES - s_bio.bytes : RECORD;
+                if ((ret = mbedtls_net_send(&c, s_data, n)) <= 0)
+                    break;
+                s_bio.bytes += ret;
+            }
+        }
+        s_bio.done_ns = lwip_sim_time_ns();
+        mbedtls_net_free(&c);
+    }
+    s_bio.done = 1;
+}
+
+static void bench_bio(int dir)
+{
+    uint64_t cpu = lwip_sim_task_cpu_ns("BIO"), tcpip = lwip_sim_task_cpu_ns(TCPIP_THREAD_NAME);
+    uint64_t t0, end = lwip_sim_time_ns() + 60 * LWIP_SIM_S;
+    static uint8_t sink[16384];
+
+    memset(&s_bio, 0, sizeof(s_bio));
+    s_bio.dir = dir;
+    sys_thread_new("BIO", bio_task, NULL, BOARD_STACK, BOARD_PRIO);
+    perf_tcp_connect(TEST_PORT);
+    CHECK(perf_tcp_wait_established(LWIP_SIM_S) == 0);
+    t0 = lwip_sim_time_ns();
+    if (dir == BIO_RX)
+    {
+        perf_tcp_write(NULL, BIO_BYTES - BIO_BYTES % RECORD);
+        perf_tcp_close();
+        while (!s_bio.done && lwip_sim_time_ns() < end)
+            settle(1);
+        CHECK(s_bio.bytes == BIO_BYTES - BIO_BYTES % RECORD);
+        CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+    }
+    else
+    {
+        while (!perf_tcp()->fin_rcvd && lwip_sim_time_ns() < end)
+        {
+            while (perf_tcp_read(sink, sizeof(sink)) != 0)
+                ;
+            lwip_sim_sleep_until(lwip_sim_time_ns() + 50 * LWIP_SIM_US);
+        }
+        while (perf_tcp_read(sink, sizeof(sink)) != 0)
+            ;
+        CHECK(perf_tcp()->rx_bytes == BIO_BYTES);
+        perf_tcp_close();
+        CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+        while (!s_bio.done && lwip_sim_time_ns() < end)
+            settle(1);
+    }
+    CHECK(s_bio.done);
+
+    printf("  mbedtls_net_%s() %u bytes in %u byte records: %.1f Mbit/s, host CPU "
+           "%.0f us/MB in the task, %.0f us/MB in tcpip_thread\n",
+           dir == BIO_RX ? "recv" : "send", (unsigned)s_bio.bytes, RECORD,
+           mbit_s(s_bio.bytes, s_bio.done_ns - t0),
+           us_mb(lwip_sim_task_cpu_ns("BIO") - cpu, s_bio.bytes),
+           us_mb(lwip_sim_task_cpu_ns(TCPIP_THREAD_NAME) - tcpip, s_bio.bytes));
+}
+
+/*---------------------------------------------------------------------------*/
+/* HTTPS download                                                            */
+/*---------------------------------------------------------------------------*/
+
+#define HTTPS_RUNS      2
+
+static struct
+{
+    int ret;
+    int served;
+    uint32_t bytes;
+} s_tls;
+
+/* A server like ssl_server.c that answers every request with HTTPS_BYTES,
+ * written HTTPS_WRITE at a time */
+static void tls_task(void *arg)
+{
+    static const char pers[] = "test_net_sockets";
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt crt;
+    mbedtls_pk_context key;
+    mbedtls_ssl_config cfg;
+    mbedtls_ssl_context ssl;
+    mbedtls_net_context c;
+    uint32_t sent;
+    int ret, i;
+
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_x509_crt_init(&crt);
+    mbedtls_pk_init(&key);
+    mbedtls_ssl_config_init(&cfg);
+    mbedtls_ssl_init(&ssl);
+    mbedtls_net_init(&c);
+
+    if ((ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                                     (const unsigned char *)pers, sizeof(pers) - 1)) != 0 ||
+            (ret = mbedtls_x509_crt_parse(&crt, (const unsigned char *)mbedtls_test_srv_crt,
+                                          mbedtls_test_srv_crt_len)) != 0 ||
+            (ret = mbedtls_pk_parse_key(&key, (const unsigned char *)mbedtls_test_srv_key,
+                                        mbedtls_test_srv_key_len, NULL, 0,
+                                        mbedtls_ctr_drbg_random, &drbg)) != 0 ||
+            (ret = mbedtls_ssl_config_defaults(&cfg, MBEDTLS_SSL_IS_SERVER,
+                                               MBEDTLS_SSL_TRANSPORT_STREAM,
+                                               MBEDTLS_SSL_PRESET_DEFAULT)) != 0)
+        goto done;
+    mbedtls_ssl_conf_rng(&cfg, mbedtls_ctr_drbg_random, &drbg);
+    if ((ret = mbedtls_ssl_conf_own_cert(&cfg, &crt, &key)) != 0 ||
+            (ret = mbedtls_ssl_setup(&ssl, &cfg)) != 0)
+        goto done;
+
+    for (i = 0; i < HTTPS_RUNS; i++)
+    {
+        if ((ret = mbedtls_net_accept(&s_listen, &c, NULL, 0, NULL)) != 0)
+            goto done;
+        mbedtls_ssl_set_bio(&ssl, &c, mbedtls_net_send, mbedtls_net_recv, NULL);
+        while ((ret = mbedtls_ssl_handshake(&ssl)) != 0)
+        {
+            if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+                goto done;
+        }
+        do
+            ret = mbedtls_ssl_read(&ssl, s_buf, sizeof(s_buf));
+        while (ret == MBEDTLS_ERR_SSL_WANT_READ);
+        if (ret <= 0)
+            goto done;
+        for (sent = 0; sent < HTTPS_BYTES; sent += ret)
+        {
+            while ((ret = mbedtls_ssl_write(&ssl, s_data, HTTPS_WRITE)) <= 0)
+            {
+                if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+                    goto done;
+            }
+        }
+        s_tls.bytes += sent;
+        while ((ret = mbedtls_ssl_close_notify(&ssl)) < 0)
+        {
+            if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+                goto done;
+        }
+        mbedtls_net_free(&c);
+        mbedtls_ssl_session_reset(&ssl);
+        s_tls.served++;
+    }
+    ret = 0;
+
+done:
+    s_tls.ret = ret;
+    mbedtls_net_free(&c);
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&cfg);
+    mbedtls_pk_free(&key);
+    mbedtls_x509_crt_free(&crt);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+}
+
+static void bench_https(void)
+{
+    static const char req[] = "GET / HTTP/1.0\r\n\r\n";
+    static const unsigned rtt_ms[HTTPS_RUNS] = { 0, 1 };
+    static unsigned char rx[16384];
+    uint64_t t0, t_first = 0, cpu, tcpip;
+    uint32_t got;
+    unsigned r;
+    int n;
+
+    memset(&s_tls, 0, sizeof(s_tls));
+    tls_heap_track("TLS");
+    sys_thread_new("TLS", tls_task, NULL, BOARD_STACK, BOARD_PRIO);
+    CHECK(tls_peer_init(0) == 0);
+
+    for (r = 0; r < HTTPS_RUNS; r++)
+    {
+        lwip_sim_wire_delay(rtt_ms[r] * LWIP_SIM_MS / 2);
+        cpu = lwip_sim_task_cpu_ns("TLS");
+        tcpip = lwip_sim_task_cpu_ns(TCPIP_THREAD_NAME);
+        t0 = lwip_sim_time_ns();
+        n = tls_peer_connect(TLS_PORT, 0);
+        CHECK(n == 0);
+        if (n != 0)
+            break;
+        CHECK(tls_peer_write(req, sizeof(req) - 1) == (int)sizeof(req) - 1);
+        for (got = 0; got < HTTPS_BYTES; got += n)
+        {
+            if ((n = tls_peer_read(rx, sizeof(rx))) <= 0)
+                break;
+            if (got == 0)
+                t_first = lwip_sim_time_ns();
+        }
+        CHECK(got == HTTPS_BYTES);
+        CHECK(tls_peer_read(rx, sizeof(rx)) == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY);
+        printf("  HTTPS %u KB at %u ms RTT: %.1f Mbit/s, %.1f ms from SYN; host CPU "
+               "%.0f us/MB in the TLS task, %.0f us/MB in tcpip_thread\n",
+               (unsigned)(got / 1024), rtt_ms[r], mbit_s(got, lwip_sim_time_ns() - t_first),
+               (lwip_sim_time_ns() - t0) / 1e6,
+               us_mb(lwip_sim_task_cpu_ns("TLS") - cpu, got),
+               us_mb(lwip_sim_task_cpu_ns(TCPIP_THREAD_NAME) - tcpip, got));
+        tls_peer_close();
+    }
+    lwip_sim_wire_delay(0);
+    settle(100);
+    CHECK(s_tls.ret == 0);
+    CHECK(s_tls.served == HTTPS_RUNS);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void print_ram(void)
+{
+    uint32_t i, pools = 0;
+
+    for (i = 0; i < MEMP_MAX; i++)
+    {
+        if (lwip_stats.memp[i] != NULL)
+            pools += lwip_stats.memp[i]->max * memp_pools[i]->size;
+    }
+    printf("  peak RAM, simulated run, host sizes\n");
+    printf("  lwIP heap %u of %u bytes, lwIP pools %u bytes, mbedTLS heap of the TLS task %u bytes\n",
+           (unsigned)lwip_stats.mem.max, (unsigned)MEM_SIZE, (unsigned)pools,
+           (unsigned)tls_heap_peak());
+#if defined(NET_BIO_BSD)
+    printf("  socket table lwip_sock[%u]: %u bytes\n", (unsigned)NUM_SOCKETS,
+           (unsigned)(NUM_SOCKETS * sizeof(struct lwip_sock)));
+#endif
+}
+
+static void run(void *arg)
+{
+    ip4_addr_t ipaddr, netmask, gw;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(s_data); i++)
+        s_data[i] = (uint8_t)(i * 131 + (i >> 8));
+
+    perf_peer_init(s_peer_ip, s_board_ip);
+    IP4_ADDR(&gw, 192, 168, 1, 1);
+    IP4_ADDR(&ipaddr, 192, 168, 1, 2);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    tcpip_init(NULL, NULL);
+    netif_add(&s_netif, &ipaddr, &netmask, &gw, NULL, ethernetif_init, tcpip_input);
+    netif_set_default(&s_netif);
+    netif_set_up(&s_netif);
+    perf_peer_arp();
+    settle(10);
+
+    mbedtls_net_init(&s_listen);
+    CHECK(mbedtls_net_bind(&s_listen, NULL, "7", MBEDTLS_NET_PROTO_TCP) == 0);
+
+#if !defined(NET_BIO_BSD)
+    test_segments();
+    test_chain();
+    test_timeout();
+    test_close();
+    test_full_table();
+#endif
+
+    printf("  LwIP_SSL_Server, mbedtls_net_*() on %s: TCP_MSS %u, TCP_WND %u, TCP_SND_BUF %u\n",
+           BIO, (unsigned)TCP_MSS, (unsigned)TCP_WND, (unsigned)TCP_SND_BUF);
+    pool_prof_reset();
+    bench_bio(BIO_RX);
+    bench_bio(BIO_TX);
+    mbedtls_net_free(&s_listen);
+    mbedtls_net_init(&s_listen);
+    CHECK(mbedtls_net_bind(&s_listen, NULL, "443", MBEDTLS_NET_PROTO_TCP) == 0);
+    bench_https();
+    mbedtls_net_free(&s_listen);
+    print_ram();
+
+    CHECK(lwip_sim_stats()->masked_blocks == 0);
+}
+
+int main(void)
+{
+    CHECK(lwip_sim_run(run, NULL, MAIN_PRIO, 600 * LWIP_SIM_S) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
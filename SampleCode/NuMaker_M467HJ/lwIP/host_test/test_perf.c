@@ -0,0 +1,466 @@
+/*
+ * Benchmarks of the lwIP samples on the simulated GMAC.
+ *
+ * Built once for each sample with a server, with its lwipopts.h and
+ * FreeRTOSConfig.h: the board runs the sample's server thread next to
+ * lwiperf, and perf_peer.c is the far end of the wire. For each
+ * configuration it reports
+ * - lwiperf TCP throughput into and out of the board, on the bare wire and
+ *   at 1 ms round trip time,
+ * - latency of the sample's server: TCP and UDP echo round trips, or the
+ *   time from SYN to the last byte of a page, and its throughput,
+ * - peak use of the heap, every lwIP pool and the EMAC rx pools over the
+ *   whole run, with the lwipopts.h figures pool_prof.c derives from them.
+ *
+ * All times are simulated: wire time at 100 Mbit/s, link delay and the
+ * timers of lwIP, with no processing time on either end. The figures
+ * compare configurations, they do not predict the board.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "lwip/stats.h"
+#include "lwip/pool_prof.h"
+#include "lwip/apps/lwiperf.h"
+#include "netif/ethernetif.h"
+#include "m460_emac.h"
+#include "lwip_sim.h"
+#include "perf_peer.h"
+
+#if defined(PERF_TCP_ECHOSERVER)
+#include "tcp_echoserver-netconn.h"
+#define SAMPLE          "LwIP_TCP_EchoServer"
+#elif defined(PERF_UDP_ECHOSERVER)
+#include "udp_echoserver-netconn.h"
+#define SAMPLE          "LwIP_UDP_EchoServer"
+#elif defined(PERF_HTTPD_NETCONN)
+#include "httpserver-netconn.h"
+#include "fs.h"
+#define SAMPLE          "LwIP_httpd_netconn"
+#elif defined(PERF_HTTPD_SOCKET)
+#include "httpserver-socket.h"
+#include "fs.h"
+#define SAMPLE          "LwIP_httpd_socket"
+#else
+#error "Build with the PERF_ define of a sample"
+#endif
+
+/* mainCHECK_TASK_PRIORITY of the sample, above RX_THREAD_PRIO */
+#define MAIN_PRIO       3
+
+#define SERVER_PORT     80
+#define IPERF_PORT      5001
+#define IPERF_BYTES     (2 * 1024 * 1024)
+#define IPERF_BLOCK     (128 * 1024)        /* iperf 2 repeats its header every 128 KB */
+#define ECHO_N          100
+#define UDP_BURST       256
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+u8 my_mac_addr[6] = DEFAULT_MAC0_ADDRESS;
+
+static const uint8_t s_peer_ip[4] = { 192, 168, 1, 100 };
+static const uint8_t s_board_ip[4] = { 192, 168, 1, 2 };
+
+static struct netif s_netif;
+static ip_addr_t s_peer_addr;
+
+/* pool_prof_report() goes to the board console, copied to stdout */
+static int s_report;
+
+static void console(const char *line)
+{
+    if (s_report)
+        printf("  %s\n", line);
+}
+
+static void settle(uint64_t ms)
+{
+    lwip_sim_sleep_until(lwip_sim_time_ns() + ms * LWIP_SIM_MS);
+}
+
+static double mbit_s(uint64_t bytes, uint64_t ns)
+{
+    return ns ? bytes * 8.0 * 1000.0 / ns : 0;
+}
+
+static double us(uint64_t ns)
+{
+    return ns / 1e3;
+}
+
+/*---------------------------------------------------------------------------*/
+/* lwiperf                                                                   */
+/*---------------------------------------------------------------------------*/
+
+static struct
+{
+    int reports;
+    enum lwiperf_report_type type;
+    uint32_t bytes, ms;
+} s_iperf;
+
+static void iperf_report(void *arg, enum lwiperf_report_type report_type,
+                         const ip_addr_t *local_addr, u16_t local_port, const ip_addr_t *remote_addr,
+                         u16_t remote_port, u32_t bytes_transferred, u32_t ms_duration,
+                         u32_t bandwidth_kbitpsec)
+{
+    s_iperf.reports++;
+    s_iperf.type = report_type;
+    s_iperf.bytes = bytes_transferred;
+    s_iperf.ms = ms_duration;
+}
+
+static void iperf_server(void *arg)
+{
+    lwiperf_start_tcp_server_default(iperf_report, NULL);
+}
+
+static void iperf_client(void *arg)
+{
+    lwiperf_start_tcp_client_default(&s_peer_addr, iperf_report, NULL);
+}
+
+static void print_tcp(const char *what, unsigned rtt_ms, uint64_t bytes, uint64_t ns)
+{
+    const perf_tcp_t *c = perf_tcp();
+
+    printf("  %-32s rtt %u ms %9llu bytes %7.2f Mbit/s, %u resent, %u zero windows\n",
+           what, rtt_ms, (unsigned long long)bytes, mbit_s(bytes, ns), c->retransmits,
+           c->zero_windows);
+}
+
+/* The peer sends, as an iperf 2 client with no options */
+static void iperf_rx(unsigned rtt_ms)
+{
+    const perf_tcp_t *c = perf_tcp();
+    uint8_t hdr[24] = { 0 };
+    uint32_t off;
+    int reports = s_iperf.reports;
+
+    hdr[7] = 1;                                 /* num_threads */
+    hdr[10] = IPERF_PORT >> 8;                  /* remote_port */
+    hdr[11] = IPERF_PORT & 0xFF;
+
+    perf_tcp_connect(IPERF_PORT);
+    CHECK(perf_tcp_wait_established(LWIP_SIM_S) == 0);
+    for (off = 0; off < IPERF_BYTES; off += IPERF_BLOCK)
+    {
+        perf_tcp_write(hdr, sizeof(hdr));
+        perf_tcp_write(NULL, IPERF_BLOCK - sizeof(hdr));
+    }
+    perf_tcp_close();
+    CHECK(perf_tcp_wait_closed(60 * LWIP_SIM_S) == 0);
+    settle(10);
+
+    CHECK(c->tx_acked == IPERF_BYTES);
+    CHECK(s_iperf.reports == reports + 1);
+    CHECK(s_iperf.type == LWIPERF_TCP_DONE_SERVER);
+    CHECK(s_iperf.bytes == IPERF_BYTES);
+    print_tcp("lwiperf to the board", rtt_ms, c->tx_acked, c->last_ack_ns - c->est_ns);
+}
+
+/* The board sends for the 10 s of lwiperf_start_tcp_client_default() */
+static void iperf_tx(unsigned rtt_ms)
+{
+    const perf_tcp_t *c = perf_tcp();
+    int reports = s_iperf.reports;
+
+    perf_tcp_listen(IPERF_PORT);
+    tcpip_callback(iperf_client, NULL);
+    CHECK(perf_tcp_wait_established(LWIP_SIM_S) == 0);
+    CHECK(perf_tcp_wait_fin(20 * LWIP_SIM_S) == 0);
+    perf_tcp_close();
+    CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+    settle(10);
+
+    CHECK(s_iperf.reports == reports + 1);
+    CHECK(s_iperf.type == LWIPERF_TCP_DONE_CLIENT);
+    CHECK(s_iperf.bytes == c->rx_bytes);
+    CHECK(c->out_of_order == 0);
+    print_tcp("lwiperf from the board", rtt_ms, c->rx_bytes, c->last_rx_ns - c->first_rx_ns);
+}
+
+/*---------------------------------------------------------------------------*/
+/* The sample's server                                                       */
+/*---------------------------------------------------------------------------*/
+
+struct lat
+{
+    unsigned n;
+    uint64_t min, max, sum;
+};
+
+static void lat_add(struct lat *l, uint64_t ns)
+{
+    if (l->n == 0 || ns < l->min)
+        l->min = ns;
+    if (ns > l->max)
+        l->max = ns;
+    l->sum += ns;
+    l->n++;
+}
+
+static void print_lat(const char *what, const struct lat *l)
+{
+    printf("  %-32s %4u x  min %8.1f us  avg %8.1f us  max %8.1f us\n", what, l->n,
+           us(l->min), l->n ? us(l->sum / l->n) : 0, us(l->max));
+}
+
+#if defined(PERF_TCP_ECHOSERVER)
+
+/* The server answers "nuvoton" with "Hello World!!" */
+static void server_start(void)
+{
+    tcp_echoserver_netconn_init();
+}
+
+static void server_bench(void)
+{
+    static const char pass[] = "Hello World!!";
+    const perf_tcp_t *c = perf_tcp();
+    struct lat l = { 0 }, conn = { 0 };
+    uint64_t t;
+    unsigned i;
+
+    perf_tcp_connect(SERVER_PORT);
+    CHECK(perf_tcp_wait_established(LWIP_SIM_S) == 0);
+    lat_add(&conn, c->est_ns - c->syn_ns);
+    print_lat("tcp connect", &conn);
+    for (i = 0; i < ECHO_N; i++)
+    {
+        t = lwip_sim_time_ns();
+        perf_tcp_write("nuvoton", 7);
+        if (perf_tcp_wait_rx((i + 1) * (sizeof(pass) - 1), LWIP_SIM_S) < 0)
+            break;
+        lat_add(&l, c->last_rx_ns - t);
+    }
+    CHECK(l.n == ECHO_N);
+    CHECK(memcmp(perf_tcp_rx_data() + (ECHO_N - 1) * (sizeof(pass) - 1), pass, sizeof(pass) - 1) == 0);
+    perf_tcp_close();
+    CHECK(perf_tcp_wait_closed(LWIP_SIM_S) == 0);
+    print_lat("tcp request, answer", &l);
+}
+
+#elif defined(PERF_UDP_ECHOSERVER)
+
+static void server_start(void)
+{
+    udp_echoserver_netconn_init();
+}
+
+static void server_bench(void)
+{
+    static uint8_t msg[1472];
+    const perf_udp_t *u = perf_udp();
+    struct lat l = { 0 };
+    uint32_t rx = u->rx, bytes = u->rx_bytes;
+    uint64_t t;
+    unsigned i;
+
+    for (i = 0; i < sizeof(msg); i++)
+        msg[i] = (uint8_t)i;
+    for (i = 0; i < ECHO_N; i++)
+    {
+        t = lwip_sim_time_ns();
+        perf_udp_send(5000, SERVER_PORT, msg, 64);
+        if (perf_udp_wait_rx(rx + i + 1, LWIP_SIM_S) < 0)
+            break;
+        lat_add(&l, u->last_rx_ns - t);
+    }
+    CHECK(l.n == ECHO_N);
+    CHECK(u->rx_bytes - bytes == ECHO_N * 64);
+    print_lat("udp echo, 64 bytes", &l);
+
+    /* Back to back at wire speed: what the recvmbox and pools keep up with */
+    rx = u->rx;
+    t = lwip_sim_time_ns();
+    for (i = 0; i < UDP_BURST; i++)
+        perf_udp_send(5000, SERVER_PORT, msg, sizeof(msg));
+    perf_udp_wait_rx(rx + UDP_BURST, LWIP_SIM_S);
+    settle(100);
+    CHECK(u->rx - rx > 0);
+    printf("  %-32s %4u x  %u echoed, %7.2f Mbit/s echoed\n", "udp burst, 1472 bytes",
+           UDP_BURST, u->rx - rx, mbit_s((uint64_t)(u->rx - rx) * sizeof(msg), u->last_rx_ns - t));
+}
+
+#else /* the web servers */
+
+static void server_start(void)
+{
+#if defined(PERF_HTTPD_NETCONN)
+    http_server_netconn_init();
+#else
+    http_server_socket_init();
+#endif
+}
+
+static int file_len(const char *name)
+{
+    struct fs_file *f = fs_open(name);
+    int len = f ? f->len : 0;
+
+    if (f)
+        fs_close(f);
+    return len;
+}
+
+/* HTTP/1.0 requests, one connection each, closed by the server */
+static void get(const char *path, int n)
+{
+    const perf_tcp_t *c = perf_tcp();
+    char req[64];
+    struct lat l = { 0 };
+    uint64_t bytes = 0, busy = 0;
+    int len = file_len(path), i;
+
+    snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\n\r\n", path);
+    for (i = 0; i < n; i++)
+    {
+        perf_tcp_connect(SERVER_PORT);
+        if (perf_tcp_wait_established(LWIP_SIM_S) < 0)
+            break;
+        perf_tcp_write(req, (uint32_t)strlen(req));
+        if (perf_tcp_wait_fin(5 * LWIP_SIM_S) < 0)
+            break;
+        perf_tcp_close();
+        if (perf_tcp_wait_closed(LWIP_SIM_S) < 0)
+            break;
+        CHECK(c->rx_bytes == (uint32_t)len);
+        CHECK(memcmp(perf_tcp_rx_data(), "HTTP/1.", 7) == 0);
+        lat_add(&l, c->last_rx_ns - c->syn_ns);
+        bytes += c->rx_bytes;
+        busy += c->closed_ns - c->syn_ns;
+    }
+    CHECK(l.n == (unsigned)n);
+    snprintf(req, sizeof(req), "GET %s (%d bytes)", path, len);
+    print_lat(req, &l);
+    printf("  %-32s %7.1f pages/s %7.2f Mbit/s\n", "", busy ? n * 1e9 / busy : 0, mbit_s(bytes, busy));
+}
+
+#if defined(PERF_HTTPD_NETCONN)
+/* HTTP/1.1 requests on one connection */
+static void get_keepalive(const char *path, int n)
+{
+    const perf_tcp_t *c = perf_tcp();
+    char req[80];
+    struct lat l = { 0 };
+    int len = file_len(path), i;
+    uint64_t t;
+
+    snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: board\r\n\r\n", path);
+    perf_tcp_connect(SERVER_PORT);
+    CHECK(perf_tcp_wait_established(LWIP_SIM_S) == 0);
+    for (i = 0; i < n; i++)
+    {
+        t = lwip_sim_time_ns();
+        perf_tcp_write(req, (uint32_t)strlen(req));
+        if (perf_tcp_wait_rx((uint32_t)(i + 1) * len, 5 * LWIP_SIM_S) < 0)
+            break;
+        lat_add(&l, c->last_rx_ns - t);
+    }
+    CHECK(l.n == (unsigned)n);
+    perf_tcp_close();
+    CHECK(perf_tcp_wait_closed(10 * LWIP_SIM_S) == 0);
+    snprintf(req, sizeof(req), "keep-alive GET %s", path);
+    print_lat(req, &l);
+}
+#endif
+
+static void server_bench(void)
+{
+    get("/index.html", 20);
+    get("/img/m4.jpg", 10);
+#if defined(PERF_HTTPD_NETCONN)
+    get_keepalive("/index.html", 20);
+#endif
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+
+static void print_pools(void)
+{
+    const EMAC_POOL_STATS_T *p;
+    const char *name[] = { "large", "small" };
+    uint32_t i;
+
+    printf("  peak use, simulated run\n");
+    /* end the line a server may have left open, it is not the report's */
+    lwip_sim_printf("\n");
+    s_report = 1;
+    pool_prof_report();
+    s_report = 0;
+    for (i = EMAC_RX_POOL_LARGE; i <= EMAC_RX_POOL_SMALL; i++)
+    {
+        p = EMAC_GetRxPoolStats(i);
+        printf("  EMAC rx %s pool: %u buffers, peak %u, starved %u, dropped %u\n", name[i],
+               (unsigned)p->u32Size, (unsigned)p->u32HighWater, (unsigned)p->u32Starved,
+               (unsigned)p->u32Dropped);
+    }
+    printf("  frames lost for lack of rx descriptors: %llu\n",
+           (unsigned long long)lwip_sim_stats()->rx_no_desc);
+}
+
+static void run(void *arg)
+{
+    ip4_addr_t ipaddr, netmask, gw;
+    static const unsigned rtt_ms[] = { 0, 1 };
+    unsigned r;
+
+    lwip_sim_console_hook(console);
+    perf_peer_init(s_peer_ip, s_board_ip);
+    IP4_ADDR(&s_peer_addr, s_peer_ip[0], s_peer_ip[1], s_peer_ip[2], s_peer_ip[3]);
+
+    IP4_ADDR(&gw, 192, 168, 1, 1);
+    IP4_ADDR(&ipaddr, 192, 168, 1, 2);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    tcpip_init(NULL, NULL);
+    netif_add(&s_netif, &ipaddr, &netmask, &gw, NULL, ethernetif_init, tcpip_input);
+    netif_set_default(&s_netif);
+    netif_set_up(&s_netif);
+    server_start();
+    tcpip_callback(iperf_server, NULL);
+    perf_peer_arp();
+    settle(10);
+    pool_prof_reset();
+
+    printf("  %s: TCP_MSS %u, TCP_WND %u, TCP_SND_BUF %u, PBUF_POOL_SIZE %u, MEM_SIZE %u\n",
+           SAMPLE, (unsigned)TCP_MSS, (unsigned)TCP_WND, (unsigned)TCP_SND_BUF,
+           (unsigned)PBUF_POOL_SIZE, (unsigned)MEM_SIZE);
+    printf("  simulated times\n");
+    for (r = 0; r < sizeof(rtt_ms) / sizeof(rtt_ms[0]); r++)
+    {
+        lwip_sim_wire_delay(rtt_ms[r] * LWIP_SIM_MS / 2);
+        iperf_rx(rtt_ms[r]);
+        iperf_tx(rtt_ms[r]);
+    }
+    lwip_sim_wire_delay(0);
+    server_bench();
+    settle(100);
+    print_pools();
+
+    CHECK(lwip_sim_stats()->masked_blocks == 0);
+}
+
+int main(void)
+{
+    CHECK(lwip_sim_run(run, NULL, MAIN_PRIO, 600 * LWIP_SIM_S) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
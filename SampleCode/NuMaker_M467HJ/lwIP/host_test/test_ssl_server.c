@@ -0,0 +1,217 @@
+/*
+ * Session resumption of LwIP_SSL_Server on the simulated GMAC.
+ *
+ * ssl_server.c runs unchanged in its own task, tls_peer.c connects to it
+ * the way the comment of the sample drives it with ssl_client2:
+ * - one client reconnecting 100 times with session tickets, and with the
+ *   session cache (tickets=0),
+ * - 16, 48 and 100 clients with tickets coming back one after the other,
+ *   twice, which is where renewing the ticket key shows.
+ * Full and resumed handshakes are told apart by the " ok (full)" and
+ * " ok (resumed)" the server prints. For each run the test reports the
+ * share of resumed handshakes, the host CPU time of the server task per
+ * full and per resumed connection, and the handshake statistics line of
+ * the sample; at the end the peak mbedTLS heap of the server task.
+ *
+ * Simulated time has no processing time: the milliseconds of the sample
+ * are the 1 ms round trips of the handshake. The host CPU time is x86-64
+ * time, to compare full and resumed handshakes by.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "netif/ethernetif.h"
+#include "m460_emac.h"
+
+#include "mbedtls/ssl.h"
+
+#include "lwip_sim.h"
+#include "perf_peer.h"
+#include "tls_peer.h"
+
+/* mainCHECK_TASK_PRIORITY of the sample */
+#define MAIN_PRIO       3
+
+#define TLS_PORT        443
+#define SERVER_TASK     "SSL"
+
+/* Rounds of the clients after the first, full handshakes */
+#define RETURNS         2
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+void ssl_server_socket_init(void);
+
+u8 my_mac_addr[6] = DEFAULT_MAC0_ADDRESS;
+
+static const uint8_t s_peer_ip[4] = { 192, 168, 1, 100 };
+static const uint8_t s_board_ip[4] = { 192, 168, 1, 2 };
+
+static struct netif s_netif;
+
+/* What the server printed about the last handshake: 1 resumed, 0 full,
+ * -1 nothing yet */
+static int s_resumed;
+static char s_stats[128];
+
+static struct
+{
+    uint32_t full, resumed;
+    uint64_t full_cpu, resumed_cpu;
+} s_run;
+
+static void console(const char *line)
+{
+    if (strstr(line, "handshake... ok (resumed)") != NULL)
+        s_resumed = 1;
+    else if (strstr(line, "handshake... ok (full)") != NULL)
+        s_resumed = 0;
+    else if (strstr(line, ". Handshakes:") != NULL)
+        snprintf(s_stats, sizeof(s_stats), "%s", line);
+}
+
+static void settle(uint64_t ms)
+{
+    lwip_sim_sleep_until(lwip_sim_time_ns() + ms * LWIP_SIM_MS);
+}
+
+/* One HTTPS request of client, offering its session. Returns what the
+ * server made of the handshake, or -1. */
+static int request(unsigned int client)
+{
+    static const char req[] = "GET / HTTP/1.0\r\n\r\n";
+    static unsigned char rx[1024];
+    uint64_t cpu = lwip_sim_task_cpu_ns(SERVER_TASK);
+    int n, got = 0;
+
+    s_resumed = -1;
+    tls_peer_client(client);
+    if ((n = tls_peer_connect(TLS_PORT, 1)) != 0)
+    {
+        printf("  client %u: handshake returned -0x%x\n", client, (unsigned)-n);
+        tls_peer_close();
+        return -1;
+    }
+    if (tls_peer_write(req, sizeof(req) - 1) != (int)sizeof(req) - 1)
+        s_resumed = -1;
+    while ((n = tls_peer_read(rx, sizeof(rx))) > 0)
+        got += n;
+    if (n != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY || got == 0)
+        s_resumed = -1;
+    tls_peer_close();
+    settle(1);
+
+    cpu = lwip_sim_task_cpu_ns(SERVER_TASK) - cpu;
+    if (s_resumed == 1)
+    {
+        s_run.resumed++;
+        s_run.resumed_cpu += cpu;
+    }
+    else if (s_resumed == 0)
+    {
+        s_run.full++;
+        s_run.full_cpu += cpu;
+    }
+    return s_resumed;
+}
+
+/* returns: the connections that offered a session */
+static void report(const char *name, uint32_t returns)
+{
+    printf("  %-32s full %3u, resumed %3u (%3u%% of %3u), host CPU %5.0f us full, %4.0f us resumed\n",
+           name, (unsigned)s_run.full, (unsigned)s_run.resumed,
+           (unsigned)(returns ? s_run.resumed * 100 / returns : 0), (unsigned)returns,
+           s_run.full ? s_run.full_cpu / 1e3 / s_run.full : 0,
+           s_run.resumed ? s_run.resumed_cpu / 1e3 / s_run.resumed : 0);
+    memset(&s_run, 0, sizeof(s_run));
+}
+
+/* ssl_client2 reconnect=100 tickets=0|1: the first handshake is full, the
+ * rest resume */
+static void test_reconnect(int tickets)
+{
+    unsigned int i;
+
+    CHECK(tls_peer_init(tickets) == 0);
+    CHECK(request(0) == 0);
+    for (i = 0; i < 100; i++)
+        CHECK(request(0) == 1);
+    report(tickets ? "reconnect=100 tickets=1" : "reconnect=100 tickets=0 (cache)", 100);
+}
+
+/* clients with tickets, each coming back RETURNS times after its first
+ * connection */
+static uint32_t returning_clients(unsigned int clients)
+{
+    char name[40];
+    unsigned int i, r;
+    uint32_t resumed;
+
+    CHECK(tls_peer_init(1) == 0);
+    for (i = 0; i < clients; i++)
+        CHECK(request(i) == 0);
+    for (r = 0; r < RETURNS; r++)
+    {
+        for (i = 0; i < clients; i++)
+            CHECK(request(i) >= 0);
+    }
+    resumed = s_run.resumed;
+    snprintf(name, sizeof(name), "%u clients, tickets=1, back %ux", clients, RETURNS);
+    report(name, clients * RETURNS);
+    return resumed;
+}
+
+static void run(void *arg)
+{
+    ip4_addr_t ipaddr, netmask, gw;
+
+    lwip_sim_console_hook(console);
+    perf_peer_init(s_peer_ip, s_board_ip);
+    IP4_ADDR(&gw, 192, 168, 1, 1);
+    IP4_ADDR(&ipaddr, 192, 168, 1, 2);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    tcpip_init(NULL, NULL);
+    netif_add(&s_netif, &ipaddr, &netmask, &gw, NULL, ethernetif_init, tcpip_input);
+    netif_set_default(&s_netif);
+    netif_set_up(&s_netif);
+    perf_peer_arp();
+    lwip_sim_wire_delay(LWIP_SIM_MS / 2);
+
+    tls_heap_track(SERVER_TASK);
+    ssl_server_socket_init();
+    settle(10);
+
+    printf("  LwIP_SSL_Server session resumption, 1 ms RTT\n");
+    test_reconnect(1);
+    test_reconnect(0);
+    /* Every ticket stays valid for as long as the server issues 64 more */
+    CHECK(returning_clients(16) == 16 * RETURNS);
+    CHECK(returning_clients(48) == 48 * RETURNS);
+    returning_clients(100);
+    printf("  sample: %s\n", s_stats);
+    printf("  peak mbedTLS heap of the server task %u bytes (host sizes)\n",
+           (unsigned)tls_heap_peak());
+
+    CHECK(lwip_sim_stats()->masked_blocks == 0);
+}
+
+int main(void)
+{
+    CHECK(lwip_sim_run(run, NULL, MAIN_PRIO, 600 * LWIP_SIM_S) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * Tests of the LwIP_tftp_client sample on the simulated GMAC.
+ *
+ * The board runs tftp.c of the sample with a 1 MB test file and is driven
+ * through its console, '1' to get and '2' to put; tftp_peer.c is the server
+ * at the far end of the wire. Every transfer is checked on both ends:
+ * length, content and the "Done" line of the board. The server caps the
+ * options the board asks for, so the same board runs lock-step RFC 1350,
+ * blksize only and windowed transfers, timed at several round trip times.
+ * Single frames of a windowed transfer are then lost in each direction to
+ * exercise the retransmissions of both sides.
+ *
+ * All times are simulated: wire time at 100 Mbit/s, link delay and the
+ * protocol timers, with no processing time on either end.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "netif/ethernetif.h"
+#include "m460_emac.h"
+#include "tftp.h"
+#include "lwip_sim.h"
+#include "tftp_peer.h"
+
+/* mainCHECK_TASK_PRIORITY of the sample, above RX_THREAD_PRIO */
+#define MAIN_PRIO       3
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+u8 my_mac_addr[6] = DEFAULT_MAC0_ADDRESS;
+
+/* the sample talks to its server at 192.168.1.2 */
+static const uint8_t s_peer_ip[4] = { 192, 168, 1, 2 };
+static const uint8_t s_board_ip[4] = { 192, 168, 1, 3 };
+
+static struct netif s_netif;
+
+/* what the server grants of the board's blksize 1468, windowsize 8 */
+static const struct
+{
+    const char *name;
+    uint16_t blksize, windowsize;
+} s_modes[] =
+{
+    { "RFC 1350",                   0,                0 },
+    { "blksize 1468",               TFTP_MAX_BLKSIZE, 0 },
+    { "blksize 1468, windowsize 8", TFTP_MAX_BLKSIZE, TFTP_MAX_WINDOWSIZE },
+};
+
+#define MODES           (sizeof(s_modes) / sizeof(s_modes[0]))
+#define WINDOWED        (MODES - 1)
+
+static const unsigned s_rtt_ms[] = { 1, 10, 50 };
+
+#define RTTS            (sizeof(s_rtt_ms) / sizeof(s_rtt_ms[0]))
+
+/* Board console */
+static int s_board_done, s_board_differ, s_board_timeouts;
+static unsigned s_board_bytes, s_board_blksize, s_board_windowsize;
+
+static void console(const char *line)
+{
+    unsigned ms;
+
+    if (sscanf(line, "Done, %u bytes in %u ms (blksize %u, windowsize %u)",
+               &s_board_bytes, &ms, &s_board_blksize, &s_board_windowsize) == 4)
+        s_board_done++;
+    else if (strstr(line, "differ"))
+        s_board_differ++;
+    else if (!strncmp(line, "Timeout", 7))
+        s_board_timeouts++;
+}
+
+static void settle(uint64_t ms)
+{
+    lwip_sim_sleep_until(lwip_sim_time_ns() + ms * LWIP_SIM_MS);
+}
+
+/* One transfer started from the board's console, checked on both ends.
+ * Returns its time in ns. */
+static uint64_t transfer(int get, uint16_t blksize, uint16_t windowsize)
+{
+    const tftp_peer_xfer_t *x;
+    int done = s_board_done, i;
+
+    tftp_peer_serve(TFTP_FILE_LEN, blksize, windowsize);
+    lwip_sim_console_input(get ? '1' : '2');
+    x = tftp_peer_wait(600 * LWIP_SIM_S);
+    /* the board finishes on its last block or the last ACK */
+    for (i = 0; i < 100 && s_board_done == done; i++)
+        settle(10);
+
+    CHECK(x->done && !x->failed);
+    CHECK(x->blksize == (blksize ? blksize : TFTP_BLOCK_LENGTH));
+    CHECK(x->windowsize == (windowsize ? windowsize : 1));
+    CHECK(x->bytes == TFTP_FILE_LEN);
+    CHECK(x->errors == 0);
+    CHECK(s_board_done == done + 1);
+    CHECK(s_board_bytes == TFTP_FILE_LEN);
+    CHECK(s_board_blksize == x->blksize);
+    CHECK(s_board_windowsize == x->windowsize);
+    CHECK(s_board_differ == 0);
+    /* let late retransmissions die out before the next request */
+    settle(TFTP_TIMEOUT * (TFTP_MAX_RETRIES + 2));
+    return x->end_ns - x->start_ns;
+}
+
+static double mbit_s(uint64_t ns)
+{
+    return ns ? TFTP_FILE_LEN * 8.0 * 1000.0 / ns : 0;
+}
+
+/* A windowed transfer with one frame lost. Data losses inside a window are
+ * repaired by the receiver's ACK of the last block before the gap; anything
+ * that leaves the receiver waiting costs a timeout. */
+static void lossy(const char *what, int get, int dir, uint16_t op, uint16_t blk, uint64_t clean_ns, int timeout)
+{
+    const tftp_peer_xfer_t *x;
+    int data_dir = get ? LWIP_SIM_TO_BOARD : LWIP_SIM_TO_PEER;
+    uint32_t blocks = TFTP_FILE_LEN / TFTP_MAX_BLKSIZE + 1;
+    uint64_t t, dropped = lwip_sim_stats()->wire_dropped;
+    int timeouts = s_board_timeouts;
+
+    tftp_peer_drop(dir, op, blk, 1);
+    t = transfer(get, TFTP_MAX_BLKSIZE, TFTP_MAX_WINDOWSIZE);
+    x = tftp_peer_wait(0);
+
+    CHECK(lwip_sim_stats()->wire_dropped == dropped + 1);
+    if (op == 3)
+        CHECK(x->data_sent[data_dir] > blocks);
+    /* one loss costs at most a window or two, the windows of both ends stay in step */
+    CHECK(x->data_sent[data_dir] <= blocks + 2 * TFTP_MAX_WINDOWSIZE);
+    if (timeout)
+        CHECK(t >= clean_ns + TFTP_TIMEOUT * LWIP_SIM_MS / 2);
+    else
+    {
+        /* repaired by the gap ACK: the sender restarts the window once */
+        CHECK(t < clean_ns + TFTP_TIMEOUT * LWIP_SIM_MS / 2);
+        CHECK(x->data_sent[data_dir] <= blocks + TFTP_MAX_WINDOWSIZE);
+    }
+    printf("  %-4s %-30s %7.1f ms, %u blocks sent again, %d timeouts on the board\n",
+           get ? "get" : "put", what, t / 1e6, x->data_sent[data_dir] - blocks,
+           s_board_timeouts - timeouts);
+}
+
+static void run(void *arg)
+{
+    ip4_addr_t ipaddr, netmask, gw;
+    uint64_t t[RTTS][2][MODES], clean[2];
+    unsigned r, m;
+    int get;
+
+    lwip_sim_console_hook(console);
+    tftp_peer_init(s_peer_ip, s_board_ip);
+
+    IP4_ADDR(&gw, 192, 168, 1, 1);
+    IP4_ADDR(&ipaddr, 192, 168, 1, 3);
+    IP4_ADDR(&netmask, 255, 255, 255, 0);
+    tcpip_init(NULL, NULL);
+    netif_add(&s_netif, &ipaddr, &netmask, &gw, NULL, ethernetif_init, tcpip_input);
+    netif_set_default(&s_netif);
+    netif_set_up(&s_netif);
+    tftp_client_init();
+    tftp_peer_arp();
+    settle(10);
+
+    printf("  1 MB, simulated times\n");
+    for (r = 0; r < RTTS; r++)
+    {
+        lwip_sim_wire_delay(s_rtt_ms[r] * LWIP_SIM_MS / 2);
+        for (get = 1; get >= 0; get--)
+        {
+            for (m = 0; m < MODES; m++)
+            {
+                t[r][get][m] = transfer(get, s_modes[m].blksize, s_modes[m].windowsize);
+                printf("  %-4s rtt %2u ms  %-28s %9.1f ms %7.2f Mbit/s\n", get ? "get" : "put",
+                       s_rtt_ms[r], s_modes[m].name, t[r][get][m] / 1e6, mbit_s(t[r][get][m]));
+            }
+            /* a window of 8 pays one round trip per 8 blocks of 1468 bytes */
+            CHECK(t[r][get][WINDOWED] * 4 < t[r][get][0]);
+            CHECK(t[r][get][1] < t[r][get][0]);
+        }
+    }
+    CHECK(s_board_timeouts == 0);
+
+    /* Losses at 10 ms. Windows are blocks 1-8, 9-16, ..., 97-104. */
+    lwip_sim_wire_delay(5 * LWIP_SIM_MS);
+    clean[0] = t[1][0][WINDOWED];
+    clean[1] = t[1][1][WINDOWED];
+    printf("  lost frames, rtt 10 ms, simulated times\n");
+    lossy("DATA 100 (mid window)", 1, LWIP_SIM_TO_BOARD, 3, 100, clean[1], 0);
+    lossy("DATA 104 (end of window)", 1, LWIP_SIM_TO_BOARD, 3, 104, clean[1], 1);
+    lossy("DATA 715 (last block)", 1, LWIP_SIM_TO_BOARD, 3, 715, clean[1], 1);
+    lossy("ACK 104", 1, LWIP_SIM_TO_PEER, 4, 104, clean[1], 1);
+    lossy("OACK", 1, LWIP_SIM_TO_BOARD, 6, 0, clean[1], 1);
+    lossy("DATA 100 (mid window)", 0, LWIP_SIM_TO_PEER, 3, 100, clean[0], 0);
+    lossy("DATA 104 (end of window)", 0, LWIP_SIM_TO_PEER, 3, 104, clean[0], 1);
+    lossy("DATA 715 (last block)", 0, LWIP_SIM_TO_PEER, 3, 715, clean[0], 1);
+    lossy("ACK 104", 0, LWIP_SIM_TO_BOARD, 4, 104, clean[0], 1);
+    lossy("OACK", 0, LWIP_SIM_TO_BOARD, 6, 0, clean[0], 1);
+
+    CHECK(lwip_sim_stats()->rx_no_desc == 0);
+    CHECK(lwip_sim_stats()->masked_blocks == 0);
+}
+
+int main(void)
+{
+    CHECK(lwip_sim_run(run, NULL, MAIN_PRIO, 3600 * LWIP_SIM_S) == 0);
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,652 @@
+/*
+ * TFTP far end for host tests of the TFTP samples, see tftp_peer.h.
+ *
+ * Everything runs from lwip_sim events: frames from the board and the
+ * retransmission timer. One transfer at a time. The window logic follows
+ * RFC 7440 like the samples: the receiver acknowledges the last block of
+ * each window, the last in-order block once when it sees a gap, and repeats
+ * its ACK on timeout or for old blocks long after it; the sender restarts
+ * the window after whatever block was acknowledged, for a repeated ACK only
+ * once.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "lwip_sim.h"
+#include "tftp_peer.h"
+
+#define OP_RRQ          1
+#define OP_WRQ          2
+#define OP_DATA         3
+#define OP_ACK          4
+#define OP_ERROR        5
+#define OP_OACK         6
+
+#define TFTP_PORT       69
+#define TIMEOUT_NS      (500 * LWIP_SIM_MS)
+#define MAX_RETRIES     5
+#define DEFAULT_BLKSIZE 512
+#define MAX_DROPS       8
+
+extern uint8_t my_mac_addr[6];
+
+enum { P_IDLE, P_LISTEN, P_REQ, P_XFER, P_DONE };
+
+static struct
+{
+    int state, sending, rrq, oack;
+    uint16_t lport, rport;
+    uint16_t req_blksize, req_windowsize;   /* client: asked for, server: accepted at most */
+    uint32_t flen;
+    uint32_t base, next, last;              /* sending */
+    uint32_t restart;                       /* window restarted on a repeated ACK of base - 1 */
+    uint32_t blk, count;                    /* receiving */
+    uint64_t ack_ns;                        /* when the last ACK was sent */
+    int gap, retries;
+    unsigned gen;
+} s_x;
+
+static tftp_peer_xfer_t s_res;
+
+static struct
+{
+    int dir, n;
+    uint16_t op, blk;
+} s_drop[MAX_DROPS];
+
+static uint8_t s_peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 };
+static uint8_t s_peer_ip[4], s_board_ip[4];
+static uint16_t s_port = 50000;
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint32_t sum16(const uint8_t *p, int len, uint32_t sum)
+{
+    for (; len > 1; p += 2, len -= 2)
+        sum += get16(p);
+    if (len)
+        sum += (uint32_t)p[0] << 8;
+    return sum;
+}
+
+static uint16_t fold(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Frames                                                                    */
+/*---------------------------------------------------------------------------*/
+
+static void send_udp(const uint8_t *msg, int len)
+{
+    uint8_t f[LWIP_SIM_FRAME_MAX];
+    uint8_t *ip = f + 14, *udp = ip + 20;
+    uint16_t sum;
+
+    memcpy(f, my_mac_addr, 6);
+    memcpy(f + 6, s_peer_mac, 6);
+    put16(f + 12, 0x0800);
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    put16(ip + 2, (uint16_t)(28 + len));
+    ip[8] = 64;
+    ip[9] = 17;
+    memcpy(ip + 12, s_peer_ip, 4);
+    memcpy(ip + 16, s_board_ip, 4);
+    put16(ip + 10, fold(sum16(ip, 20, 0)));
+    put16(udp, s_x.lport);
+    put16(udp + 2, s_x.rport);
+    put16(udp + 4, (uint16_t)(8 + len));
+    put16(udp + 6, 0);
+    memcpy(udp + 8, msg, len);
+    sum = fold(sum16(udp, 8 + len, sum16(ip + 12, 8, 0) + 17 + 8 + len));
+    put16(udp + 6, sum ? sum : 0xFFFF);
+    lwip_sim_wire_to_board(f, 42 + len);
+}
+
+static void arp(int op, const uint8_t *mac, const uint8_t *ip)
+{
+    static const uint8_t bcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, none[6];
+    uint8_t f[42];
+
+    memcpy(f, op == 1 ? bcast : mac, 6);
+    memcpy(f + 6, s_peer_mac, 6);
+    put16(f + 12, 0x0806);
+    put16(f + 14, 1);
+    put16(f + 16, 0x0800);
+    f[18] = 6;
+    f[19] = 4;
+    put16(f + 20, (uint16_t)op);
+    memcpy(f + 22, s_peer_mac, 6);
+    memcpy(f + 28, s_peer_ip, 4);
+    memcpy(f + 32, op == 1 ? none : mac, 6);
+    memcpy(f + 38, ip, 4);
+    lwip_sim_wire_to_board(f, sizeof(f));
+}
+
+void tftp_peer_arp(void)
+{
+    arp(1, NULL, s_board_ip);
+}
+
+/* TFTP payload of an IPv4 UDP frame, or NULL */
+static const uint8_t *tftp_payload(const uint8_t *f, int len, int *plen)
+{
+    const uint8_t *ip = f + 14;
+    int ihl;
+
+    if (len < 42 || get16(f + 12) != 0x0800 || ip[9] != 17 || (get16(ip + 6) & 0x3FFF))
+        return NULL;
+    ihl = (ip[0] & 0x0F) * 4;
+    *plen = get16(ip + ihl + 4) - 8;
+    return *plen >= 2 ? ip + ihl + 8 : NULL;
+}
+
+/* Wire hook: count DATA frames and drop the ones asked for */
+static int hook(int dir, uint8_t *frame, int *len)
+{
+    const uint8_t *m;
+    uint16_t op;
+    int plen, i;
+
+    if ((m = tftp_payload(frame, *len, &plen)) == NULL)
+        return 1;
+    op = get16(m);
+    if (op == OP_DATA)
+        s_res.data_sent[dir]++;
+    for (i = 0; i < MAX_DROPS; i++)
+    {
+        if (s_drop[i].n && s_drop[i].dir == dir && s_drop[i].op == op &&
+                (plen < 4 || (op != OP_DATA && op != OP_ACK) || get16(m + 2) == s_drop[i].blk))
+        {
+            s_drop[i].n--;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void tftp_peer_drop(int dir, uint16_t op, uint16_t blk, int n)
+{
+    int i;
+
+    for (i = 0; i < MAX_DROPS && s_drop[i].n; i++)
+        ;
+    if (i == MAX_DROPS)
+    {
+        fprintf(stderr, "tftp_peer: too many drop rules\n");
+        exit(2);
+    }
+    s_drop[i].dir = dir;
+    s_drop[i].op = op;
+    s_drop[i].blk = blk;
+    s_drop[i].n = n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Packets                                                                   */
+/*---------------------------------------------------------------------------*/
+
+static void send_ack(uint16_t blk)
+{
+    uint8_t m[4];
+
+    put16(m, OP_ACK);
+    put16(m + 2, blk);
+    send_udp(m, 4);
+    s_x.ack_ns = lwip_sim_time_ns();
+}
+
+static void send_error(uint16_t code)
+{
+    uint8_t m[8] = { 0, OP_ERROR, 0, 0, 'E', 'R', 'R', 0 };
+
+    put16(m + 2, code);
+    send_udp(m, sizeof(m));
+}
+
+static void send_block(uint32_t n)
+{
+    uint8_t m[4 + 1468];
+    uint32_t off = (n - 1) * s_res.blksize, i;
+    uint16_t len = (uint16_t)(s_x.flen - off < s_res.blksize ? s_x.flen - off : s_res.blksize);
+
+    put16(m, OP_DATA);
+    put16(m + 2, (uint16_t)n);
+    for (i = 0; i < len; i++)
+        m[4 + i] = (uint8_t)(off + i);
+    send_udp(m, 4 + len);
+}
+
+/* "blksize\0<n>\0windowsize\0<n>\0", options that are not 0 */
+static int options(uint8_t *p, uint16_t blksize, uint16_t windowsize)
+{
+    int len = 0;
+
+    if (blksize)
+        len += sprintf((char *)p + len, "blksize") + 1 + sprintf((char *)p + len + 8, "%u", blksize) + 1;
+    if (windowsize)
+        len += sprintf((char *)p + len, "windowsize") + 1 + sprintf((char *)p + len + 11, "%u", windowsize) + 1;
+    return len;
+}
+
+static void send_request(void)
+{
+    uint8_t m[128];
+    int len;
+
+    put16(m, s_x.rrq ? OP_RRQ : OP_WRQ);
+    len = 2 + sprintf((char *)m + 2, "test.txt") + 1;
+    len += sprintf((char *)m + len, "octet") + 1;
+    len += options(m + len, s_x.req_blksize, s_x.req_windowsize);
+    send_udp(m, len);
+}
+
+static void send_oack(void)
+{
+    uint8_t m[64];
+
+    put16(m, OP_OACK);
+    send_udp(m, 2 + options(m + 2, s_x.req_blksize ? s_res.blksize : 0,
+                             s_x.req_windowsize ? s_res.windowsize : 0));
+}
+
+/* Options of a request or OACK, from p to end. Returns -1 on a malformed list. */
+static int parse_options(const uint8_t *p, const uint8_t *end, unsigned long *blksize, unsigned long *windowsize)
+{
+    const char *name, *val;
+
+    *blksize = *windowsize = 0;
+    while (p < end)
+    {
+        name = (const char *)p;
+        val = memchr(name, 0, end - p);
+        if (val == NULL || ++val >= (const char *)end || memchr(val, 0, end - (const uint8_t *)val) == NULL)
+            return -1;
+        if (!strcasecmp(name, "blksize"))
+            *blksize = strtoul(val, NULL, 10);
+        else if (!strcasecmp(name, "windowsize"))
+            *windowsize = strtoul(val, NULL, 10);
+        p = (const uint8_t *)val + strlen(val) + 1;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Transfer                                                                  */
+/*---------------------------------------------------------------------------*/
+
+static void on_timeout(void *arg);
+
+static void arm(void)
+{
+    s_x.gen++;
+    lwip_sim_event_at(lwip_sim_time_ns() + TIMEOUT_NS, on_timeout, (void *)(uintptr_t)s_x.gen);
+}
+
+static void finish(int failed)
+{
+    s_x.state = P_DONE;
+    s_x.gen++;
+    s_res.failed = failed;
+    s_res.done = 1;
+    s_res.end_ns = lwip_sim_time_ns();
+}
+
+static void send_window(void)
+{
+    while (s_x.next < s_x.base + s_res.windowsize && s_x.next <= s_x.last)
+        send_block(s_x.next++);
+    arm();
+}
+
+static void start(int sending)
+{
+    s_x.state = P_XFER;
+    s_x.sending = sending;
+    s_x.base = s_x.next = 1;
+    s_x.restart = 0;
+    s_x.last = s_x.flen / s_res.blksize + 1;
+    s_x.blk = s_x.count = 0;
+    s_x.gap = 0;
+    if (sending)
+        send_window();
+    else
+        arm();
+}
+
+static void on_timeout(void *arg)
+{
+    if ((unsigned)(uintptr_t)arg != s_x.gen || s_x.state == P_DONE || s_x.state == P_LISTEN)
+        return;
+    s_res.timeouts++;
+    if (++s_x.retries > MAX_RETRIES)
+    {
+        finish(1);
+        return;
+    }
+    if (s_x.state == P_REQ)
+        send_request();
+    else if (s_x.oack)
+        send_oack();
+    else if (s_x.sending)
+        s_x.next = s_x.base;
+    else
+    {
+        send_ack((uint16_t)s_x.blk);
+        s_x.count = 0;
+        s_x.gap = 0;
+    }
+    if (s_x.sending && s_x.state == P_XFER && !s_x.oack)
+        send_window();
+    else
+        arm();
+}
+
+static void on_data(const uint8_t *m, int len)
+{
+    uint16_t n = get16(m + 2);
+    uint32_t off = s_x.blk * s_res.blksize;
+    int i;
+
+    len -= 4;
+    if (s_x.state == P_DONE)
+    {
+        /* Our last ACK got lost */
+        if (lwip_sim_time_ns() - s_x.ack_ns >= TIMEOUT_NS / 2)
+            send_ack((uint16_t)s_x.blk);
+        return;
+    }
+    s_x.oack = 0;
+    if (n == (uint16_t)(s_x.blk + 1))
+    {
+        for (i = 0; i < len; i++)
+            s_res.errors += m[4 + i] != (uint8_t)(off + i);
+        s_res.bytes += len;
+        s_x.blk++;
+        s_x.gap = 0;
+        s_x.retries = 0;
+        if (len < s_res.blksize)
+        {
+            send_ack((uint16_t)s_x.blk);
+            finish(0);
+            return;
+        }
+        if (++s_x.count >= s_res.windowsize)
+        {
+            send_ack((uint16_t)s_x.blk);
+            s_x.count = 0;
+        }
+        arm();
+    }
+    else if ((uint16_t)(n - (uint16_t)s_x.blk - 1) < 0x8000)
+    {
+        /* a gap: once, the sender restarts after the last in-order block */
+        if (!s_x.gap)
+        {
+            send_ack((uint16_t)s_x.blk);
+            s_x.count = 0;
+            s_x.gap = 1;
+        }
+    }
+    else if (lwip_sim_time_ns() - s_x.ack_ns >= TIMEOUT_NS / 2)
+    {
+        /* an old block long after our ACK: the ACK was lost */
+        send_ack((uint16_t)s_x.blk);
+        s_x.count = 0;
+    }
+}
+
+static void on_ack(uint16_t n)
+{
+    uint16_t acked = (uint16_t)(n - (uint16_t)(s_x.base - 1));
+
+    s_x.oack = 0;
+    if (acked == 0)
+    {
+        /* once per window, later copies are from blocks already on their way */
+        if (s_x.restart != s_x.base)
+        {
+            s_x.restart = s_x.base;
+            s_x.next = s_x.base;
+            send_window();
+        }
+    }
+    else if (acked <= s_x.next - s_x.base)
+    {
+        s_x.base += acked;
+        s_x.retries = 0;
+        s_res.bytes = (s_x.base - 1) * s_res.blksize;
+        if (s_x.base > s_x.last)
+        {
+            s_res.bytes = s_x.flen;
+            finish(0);
+        }
+        else
+        {
+            s_x.next = s_x.base;
+            send_window();
+        }
+    }
+}
+
+/* Server: a request of the board */
+static void on_request(const uint8_t *m, int len, uint16_t sport)
+{
+    const uint8_t *p = m + 2, *end = m + len;
+    unsigned long blksize, windowsize;
+
+    if (s_x.state != P_LISTEN)
+    {
+        /* The board lost our OACK or first packet and asks again */
+        if (s_x.state == P_XFER && sport == s_x.rport && s_x.oack)
+            send_oack();
+        return;
+    }
+    /* file name and mode */
+    if ((p = memchr(p, 0, end - p)) == NULL || (p = memchr(p + 1, 0, end - p - 1)) == NULL ||
+            parse_options(p + 1, end, &blksize, &windowsize) < 0)
+        return;
+
+    s_x.rrq = get16(m) == OP_RRQ;
+    s_x.rport = sport;
+    s_x.lport = s_port++;
+    s_res.start_ns = lwip_sim_time_ns();
+    s_res.blksize = DEFAULT_BLKSIZE;
+    s_res.windowsize = 1;
+    if (blksize >= 8 && s_x.req_blksize)
+        s_res.blksize = (uint16_t)(blksize < s_x.req_blksize ? blksize : s_x.req_blksize);
+    else
+        s_x.req_blksize = 0;
+    if (windowsize >= 1 && s_x.req_windowsize)
+        s_res.windowsize = (uint16_t)(windowsize < s_x.req_windowsize ? windowsize : s_x.req_windowsize);
+    else
+        s_x.req_windowsize = 0;
+    s_x.oack = s_x.req_blksize || s_x.req_windowsize;
+
+    if (s_x.oack)
+    {
+        /* An RRQ starts on the ACK of block 0, a WRQ on block 1 */
+        s_x.state = P_XFER;
+        s_x.sending = s_x.rrq;
+        s_x.base = s_x.next = 1;
+        s_x.restart = 0;
+        s_x.last = s_x.flen / s_res.blksize + 1;
+        s_x.blk = s_x.count = 0;
+        s_x.gap = 0;
+        send_oack();
+        arm();
+    }
+    else if (s_x.rrq)
+        start(1);
+    else
+    {
+        start(0);
+        send_ack(0);
+    }
+}
+
+/* Client: the first answer of the board's server */
+static void on_first(const uint8_t *m, int len, uint16_t sport)
+{
+    uint16_t op = get16(m);
+    unsigned long blksize, windowsize;
+
+    s_x.rport = sport;
+    s_x.retries = 0;
+    s_res.blksize = DEFAULT_BLKSIZE;
+    s_res.windowsize = 1;
+    if (op == OP_OACK)
+    {
+        if (parse_options(m + 2, m + len, &blksize, &windowsize) < 0 ||
+                (blksize && (blksize < 8 || blksize > s_x.req_blksize)) ||
+                (windowsize && windowsize > s_x.req_windowsize))
+        {
+            send_error(8);
+            finish(1);
+            return;
+        }
+        if (blksize)
+            s_res.blksize = (uint16_t)blksize;
+        if (windowsize)
+            s_res.windowsize = (uint16_t)windowsize;
+        start(!s_x.rrq);
+        if (s_x.rrq)
+            send_ack(0);
+    }
+    else if (op == OP_DATA && s_x.rrq)
+    {
+        start(0);
+        on_data(m, len);
+    }
+    else if (op == OP_ACK && !s_x.rrq && len >= 4 && get16(m + 2) == 0)
+        start(1);
+    else
+        finish(1);
+}
+
+static void peer_rx(const uint8_t *f, int len)
+{
+    const uint8_t *m, *ip = f + 14, *udp;
+    uint16_t op, dport, sport;
+    int plen;
+
+    if (get16(f + 12) == 0x0806)
+    {
+        if (get16(f + 20) == 1 && memcmp(f + 38, s_peer_ip, 4) == 0)
+            arp(2, f + 22, f + 28);
+        return;
+    }
+    if ((m = tftp_payload(f, len, &plen)) == NULL || memcmp(ip + 16, s_peer_ip, 4))
+        return;
+    udp = m - 8;
+    sport = get16(udp);
+    dport = get16(udp + 2);
+    op = get16(m);
+
+    if (dport == TFTP_PORT && (op == OP_RRQ || op == OP_WRQ))
+    {
+        on_request(m, plen, sport);
+        return;
+    }
+    if (dport != s_x.lport || s_x.state == P_IDLE || s_x.state == P_LISTEN)
+        return;
+    if (op == OP_ERROR)
+    {
+        if (s_x.state != P_DONE)
+            finish(1);
+        return;
+    }
+    if (s_x.state == P_REQ)
+    {
+        on_first(m, plen, sport);
+        return;
+    }
+    if (sport != s_x.rport)
+        return;
+    if (op == OP_OACK)
+    {
+        /* Our ACK of the OACK got lost */
+        if (s_x.state == P_XFER && !s_x.sending && s_x.blk == 0)
+            send_ack(0);
+    }
+    else if (op == OP_DATA && plen >= 4 && !s_x.sending)
+        on_data(m, plen);
+    else if (op == OP_ACK && plen >= 4 && s_x.sending && s_x.state == P_XFER)
+        on_ack(get16(m + 2));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void reset(uint32_t flen, uint16_t blksize, uint16_t windowsize)
+{
+    memset(&s_res, 0, sizeof(s_res));
+    s_x.gen++;
+    s_x.flen = flen;
+    s_x.req_blksize = blksize;
+    s_x.req_windowsize = windowsize;
+    s_x.oack = 0;
+    s_x.retries = 0;
+    s_x.lport = s_port++;
+    s_x.rport = TFTP_PORT;
+}
+
+static void client(int rrq, uint32_t flen, uint16_t blksize, uint16_t windowsize)
+{
+    reset(flen, blksize, windowsize);
+    s_x.rrq = rrq;
+    s_x.state = P_REQ;
+    s_res.start_ns = lwip_sim_time_ns();
+    send_request();
+    arm();
+}
+
+void tftp_peer_get(uint16_t blksize, uint16_t windowsize)
+{
+    client(1, 0, blksize, windowsize);
+}
+
+void tftp_peer_put(uint32_t flen, uint16_t blksize, uint16_t windowsize)
+{
+    client(0, flen, blksize, windowsize);
+}
+
+void tftp_peer_serve(uint32_t flen, uint16_t max_blksize, uint16_t max_windowsize)
+{
+    reset(flen, max_blksize, max_windowsize);
+    s_x.state = P_LISTEN;
+}
+
+const tftp_peer_xfer_t *tftp_peer_wait(uint64_t limit_ns)
+{
+    uint64_t end = lwip_sim_time_ns() + limit_ns;
+
+    while (!s_res.done && lwip_sim_time_ns() < end)
+        lwip_sim_sleep_until(lwip_sim_time_ns() + 10 * LWIP_SIM_MS);
+    return &s_res;
+}
+
+void tftp_peer_init(const uint8_t peer_ip[4], const uint8_t board_ip[4])
+{
+    memcpy(s_peer_ip, peer_ip, 4);
+    memcpy(s_board_ip, board_ip, 4);
+    s_peer_mac[5] = peer_ip[3];
+    lwip_sim_wire_peer(peer_rx);
+    lwip_sim_wire_hook(hook);
+}
@@ -0,0 +1,51 @@
+/*
+ * TFTP far end for host tests of the LwIP_tftp_server and LwIP_tftp_client
+ * samples.
+ *
+ * Speaks RFC 1350 with the RFC 2348 blksize and RFC 7440 windowsize options
+ * on raw frames of the simulated wire, as a client of the board's server or
+ * as the server of the board's client. The file is the samples' test
+ * pattern, each byte its offset modulo 256. Frames of either direction can
+ * be dropped by opcode and block number to force retransmissions.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TFTP_PEER_H
+#define TFTP_PEER_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    int done, failed;               /* finished, or gave up or got an ERROR */
+    uint16_t blksize, windowsize;   /* in effect, after negotiation */
+    uint32_t bytes;                 /* bytes sent and acknowledged, or received */
+    uint32_t errors;                /* received bytes that differ from the pattern */
+    uint64_t start_ns, end_ns;      /* request sent or received, transfer complete */
+    uint32_t timeouts;              /* retransmission timeouts of the far end */
+    uint32_t data_sent[2];          /* DATA frames on the wire, by lwip_sim direction */
+} tftp_peer_xfer_t;
+
+/* Take the wire: lwip_sim_wire_peer() and lwip_sim_wire_hook() */
+void tftp_peer_init(const uint8_t peer_ip[4], const uint8_t board_ip[4]);
+
+/* Ask the board for its address so its first packet does not wait for ARP */
+void tftp_peer_arp(void);
+
+/* Client of the board's server. blksize and windowsize are the options to
+ * request, 0 to leave them out. */
+void tftp_peer_get(uint16_t blksize, uint16_t windowsize);
+void tftp_peer_put(uint32_t flen, uint16_t blksize, uint16_t windowsize);
+
+/* Server for the next request of the board's client. Options are accepted
+ * up to max_blksize and max_windowsize, 0 ignores them. */
+void tftp_peer_serve(uint32_t flen, uint16_t max_blksize, uint16_t max_windowsize);
+
+/* Block the calling task until the transfer is over or limit_ns has passed */
+const tftp_peer_xfer_t *tftp_peer_wait(uint64_t limit_ns);
+
+/* Drop the next n frames with opcode op (and block number blk for DATA and
+ * ACK) going in direction dir */
+void tftp_peer_drop(int dir, uint16_t op, uint16_t blk, int n);
+
+#endif /* TFTP_PEER_H */
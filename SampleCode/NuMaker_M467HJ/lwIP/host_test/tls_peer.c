@@ -0,0 +1,269 @@
+/*
+ * TLS client for the host tests of the LwIP_SSL samples, see tls_peer.h.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mbedtls/build_info.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+
+#include "lwip_sim.h"
+#include "perf_peer.h"
+#include "tls_peer.h"
+
+#define POLL_NS         (50 * LWIP_SIM_US)
+#define RECV_LIMIT_NS   (10 * LWIP_SIM_S)
+#define HEAP_BUCKETS    4096
+
+static mbedtls_entropy_context s_entropy;
+static mbedtls_ctr_drbg_context s_drbg;
+static mbedtls_ssl_config s_conf;
+static mbedtls_ssl_context s_ssl;
+static mbedtls_ssl_session s_session[TLS_PEER_CLIENTS];
+static uint8_t s_have_session[TLS_PEER_CLIENTS];
+static unsigned int s_client;
+
+/*---------------------------------------------------------------------------*/
+/* Entropy                                                                   */
+/*---------------------------------------------------------------------------*/
+
+/* MBEDTLS_ENTROPY_HARDWARE_ALT: the TRNG of the board, here a fixed
+ * sequence so that runs repeat */
+int mbedtls_hardware_poll(void *data, unsigned char *output, size_t len, size_t *olen)
+{
+    static uint64_t x = 0x9E3779B97F4A7C15ULL;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        output[i] = (unsigned char)x;
+    }
+    *olen = len;
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Client                                                                    */
+/*---------------------------------------------------------------------------*/
+
+static int bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    if (perf_tcp()->reset)
+        return MBEDTLS_ERR_NET_CONN_RESET;
+    perf_tcp_write(buf, (uint32_t)len);
+    return (int)len;
+}
+
+static int bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    uint64_t end = lwip_sim_time_ns() + RECV_LIMIT_NS;
+    uint32_t n;
+
+    while ((n = perf_tcp_read(buf, (uint32_t)len)) == 0)
+    {
+        if (perf_tcp()->fin_rcvd)
+            return 0;
+        if (perf_tcp()->reset)
+            return MBEDTLS_ERR_NET_CONN_RESET;
+        if (lwip_sim_time_ns() >= end)
+            return MBEDTLS_ERR_NET_RECV_FAILED;
+        lwip_sim_sleep_until(lwip_sim_time_ns() + POLL_NS);
+    }
+    return (int)n;
+}
+
+int tls_peer_init(int tickets)
+{
+    static const char pers[] = "tls_peer";
+    unsigned int i;
+    int ret;
+
+    /* Again from the start on a second call */
+    mbedtls_ssl_free(&s_ssl);
+    mbedtls_ssl_config_free(&s_conf);
+    mbedtls_ctr_drbg_free(&s_drbg);
+    mbedtls_entropy_free(&s_entropy);
+    for (i = 0; i < TLS_PEER_CLIENTS; i++)
+        mbedtls_ssl_session_free(&s_session[i]);
+
+    mbedtls_entropy_init(&s_entropy);
+    mbedtls_ctr_drbg_init(&s_drbg);
+    mbedtls_ssl_config_init(&s_conf);
+    mbedtls_ssl_init(&s_ssl);
+    for (i = 0; i < TLS_PEER_CLIENTS; i++)
+        mbedtls_ssl_session_init(&s_session[i]);
+    memset(s_have_session, 0, sizeof(s_have_session));
+    s_client = 0;
+
+    if ((ret = mbedtls_ctr_drbg_seed(&s_drbg, mbedtls_entropy_func, &s_entropy,
+                                     (const unsigned char *)pers, sizeof(pers) - 1)) != 0)
+        return ret;
+    if ((ret = mbedtls_ssl_config_defaults(&s_conf, MBEDTLS_SSL_IS_CLIENT,
+                                           MBEDTLS_SSL_TRANSPORT_STREAM,
+                                           MBEDTLS_SSL_PRESET_DEFAULT)) != 0)
+        return ret;
+    mbedtls_ssl_conf_authmode(&s_conf, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_rng(&s_conf, mbedtls_ctr_drbg_random, &s_drbg);
+    mbedtls_ssl_conf_session_tickets(&s_conf, tickets ? MBEDTLS_SSL_SESSION_TICKETS_ENABLED :
+                                     MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+    if ((ret = mbedtls_ssl_setup(&s_ssl, &s_conf)) != 0)
+        return ret;
+    mbedtls_ssl_set_bio(&s_ssl, NULL, bio_send, bio_recv, NULL);
+    return 0;
+}
+
+void tls_peer_client(unsigned int client)
+{
+    s_client = client % TLS_PEER_CLIENTS;
+}
+
+int tls_peer_connect(uint16_t port, int resume)
+{
+    mbedtls_ssl_session *session = &s_session[s_client];
+    int ret;
+
+    if ((ret = mbedtls_ssl_session_reset(&s_ssl)) != 0)
+        return ret;
+    if (resume && s_have_session[s_client] && (ret = mbedtls_ssl_set_session(&s_ssl, session)) != 0)
+        return ret;
+
+    perf_tcp_connect(port);
+    if (perf_tcp_wait_established(LWIP_SIM_S) != 0)
+        return MBEDTLS_ERR_NET_CONNECT_FAILED;
+
+    while ((ret = mbedtls_ssl_handshake(&s_ssl)) != 0)
+    {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+            return ret;
+    }
+
+    /* A session can be exported once, right after its handshake */
+    mbedtls_ssl_session_free(session);
+    mbedtls_ssl_session_init(session);
+    s_have_session[s_client] = mbedtls_ssl_get_session(&s_ssl, session) == 0;
+    return 0;
+}
+
+int tls_peer_write(const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+    size_t done = 0;
+    int ret;
+
+    while (done < len)
+    {
+        ret = mbedtls_ssl_write(&s_ssl, p + done, len - done);
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+            continue;
+        if (ret < 0)
+            return ret;
+        done += (size_t)ret;
+    }
+    return (int)done;
+}
+
+int tls_peer_read(void *buf, size_t len)
+{
+    int ret;
+
+    do
+        ret = mbedtls_ssl_read(&s_ssl, buf, len);
+    while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+    return ret;
+}
+
+void tls_peer_close(void)
+{
+    if (!perf_tcp()->reset && !perf_tcp()->fin_rcvd)
+        mbedtls_ssl_close_notify(&s_ssl);
+    perf_tcp_close();
+    perf_tcp_wait_closed(LWIP_SIM_S);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Heap of one task                                                          */
+/*---------------------------------------------------------------------------*/
+
+void *__real_calloc(size_t n, size_t size);
+void __real_free(void *p);
+
+struct block
+{
+    void *p;
+    size_t size;
+    struct block *next;
+};
+
+static struct block *s_blocks[HEAP_BUCKETS];
+static const char *s_heap_task;
+static size_t s_heap_used, s_heap_peak;
+
+static struct block **bucket(const void *p)
+{
+    return &s_blocks[((uintptr_t)p >> 4) % HEAP_BUCKETS];
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+    const char *task = lwip_sim_task_name();
+    struct block *b;
+
+    if (p == NULL || s_heap_task == NULL || task == NULL || strcmp(task, s_heap_task) != 0)
+        return p;
+    if ((b = malloc(sizeof(*b))) == NULL)
+        return p;
+    b->p = p;
+    b->size = n * size;
+    b->next = *bucket(p);
+    *bucket(p) = b;
+    s_heap_used += b->size;
+    if (s_heap_used > s_heap_peak)
+        s_heap_peak = s_heap_used;
+    return p;
+}
+
+void __wrap_free(void *p)
+{
+    struct block **pb, *b;
+
+    if (p != NULL)
+    {
+        for (pb = bucket(p); (b = *pb) != NULL; pb = &b->next)
+        {
+            if (b->p == p)
+            {
+                *pb = b->next;
+                s_heap_used -= b->size;
+                __real_free(b);
+                break;
+            }
+        }
+    }
+    __real_free(p);
+}
+
+void tls_heap_track(const char *task)
+{
+    s_heap_task = task;
+    s_heap_peak = s_heap_used;
+}
+
+size_t tls_heap_peak(void)
+{
+    return s_heap_peak;
+}
+
+size_t tls_heap_used(void)
+{
+    return s_heap_used;
+}
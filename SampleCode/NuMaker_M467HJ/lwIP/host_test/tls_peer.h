@@ -0,0 +1,60 @@
+/*
+ * TLS client for the host tests of the LwIP_SSL samples.
+ *
+ * An mbedTLS client on the far end of the wire, over the TCP of
+ * perf_peer.c, like mbedTLS programs/ssl/ssl_client2 on a PC next to the
+ * board: TLS 1.2 with the sample's cipher suites, no certificate check
+ * (auth_mode=none), session tickets on or off, and the session of the
+ * last connection offered again for resumption on request. It can play
+ * up to TLS_PEER_CLIENTS clients one after the other, each with its own
+ * session. It runs in the calling task, which is the test's.
+ *
+ * Also here, because every SSL test needs them:
+ * - mbedtls_hardware_poll(), the entropy source of the sample's
+ *   mbedtls_config.h, from a fixed seed;
+ * - accounting of the calloc() and free() calls of one task, to give the
+ *   peak heap of mbedTLS on the board (linked with --wrap=calloc,free).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef TLS_PEER_H
+#define TLS_PEER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Set up the client, with or without session tickets. A second call
+ * starts over, without sessions. */
+int tls_peer_init(int tickets);
+
+/* Clients with a session of their own */
+#define TLS_PEER_CLIENTS    128
+
+/* The client of the connections from now on, client 0 after
+ * tls_peer_init() */
+void tls_peer_client(unsigned int client);
+
+/* Connect to port of the board and complete the handshake, offering the
+ * session of the client's previous connection when resume is set. Returns
+ * 0 or an mbedTLS error. */
+int tls_peer_connect(uint16_t port, int resume);
+
+/* Write all of len bytes, read up to len. Both return what mbedtls_ssl_*
+ * returns. */
+int tls_peer_write(const void *buf, size_t len);
+int tls_peer_read(void *buf, size_t len);
+
+/* Send close_notify, keep the session for the client's next
+ * tls_peer_connect() and close the TCP connection */
+void tls_peer_close(void);
+
+/* The board's host CPU time of mbedTLS is measured per task name: this
+ * is the test task the client runs in */
+#define TLS_PEER_TASK       "main"
+
+/* calloc() and free() of the tasks named task, from now on */
+void tls_heap_track(const char *task);
+size_t tls_heap_peak(void);
+size_t tls_heap_used(void);
+
+#endif /* TLS_PEER_H */
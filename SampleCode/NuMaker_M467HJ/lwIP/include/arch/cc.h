@@ -35,10 +35,14 @@
 #include "cpu.h"
 #include "stdio.h"
 #include "FreeRTOS.h"
+/* The host build of host_test sets it to 0 and takes the types from stdint.h */
+#ifndef LWIP_NO_STDINT_H
 #define LWIP_NO_STDINT_H 1
+#endif
 
 /*-------------data type------------------------------------------------------*/
 
+#if LWIP_NO_STDINT_H
 typedef unsigned   char    u8_t;    /* Unsigned 8 bit quantity         */
 typedef signed     char    s8_t;    /* Signed    8 bit quantity        */
 typedef unsigned   short   u16_t;   /* Unsigned 16 bit quantity        */
@@ -47,6 +51,10 @@ typedef unsigned   long    u32_t;   /* Unsigned 32 bit quantity        */
 typedef signed     long    s32_t;   /* Signed   32 bit quantity        */
 typedef u32_t mem_ptr_t;            /* Unsigned 32 bit quantity        */
 typedef u32_t sys_prot_t;
+#else
+#include <stdint.h>
+typedef uint32_t sys_prot_t;
+#endif
 
 /*----------------------------------------------------------------------------*/
 
@@ -84,12 +92,14 @@ typedef u32_t sys_prot_t;
 
 /*---define (sn)printf formatters for these lwip types, for lwip DEBUG/STATS--*/
 
+#if LWIP_NO_STDINT_H
 #define U16_F "4d"
 #define S16_F "4d"
 #define X16_F "4x"
 #define U32_F "8ld"
 #define S32_F "8ld"
 #define X32_F "8lx"
+#endif
 
 /*--------------macros--------------------------------------------------------*/
 #ifndef LWIP_PLATFORM_ASSERT
@@ -104,10 +114,31 @@ typedef u32_t sys_prot_t;
 #endif
 
 
+/* The host build of host_test takes errno from the C library instead */
+#ifndef LWIP_ERRNO_STDINCLUDE
 #define LWIP_PROVIDE_ERRNO  1
+#endif
 
 extern TickType_t xTaskGetTickCount( void );
 
 #define TCP_MSS                         1000
 //#define TCP_MSS                         1460
+
+/*--------------memory usage profiler, see lwip/pool_prof.h--------------------*/
+/* Off unless lwipopts.h sets it to 1. Comes after lwipopts.h and before the
+   defaults of opt.h, so the stats it needs win over the sample settings. */
+#ifndef LWIP_POOL_PROF
+#define LWIP_POOL_PROF                  0
+#endif
+
+#if LWIP_POOL_PROF
+#undef LWIP_STATS
+#define LWIP_STATS                      1
+#undef MEM_STATS
+#define MEM_STATS                       1
+#undef MEMP_STATS
+#define MEMP_STATS                      1
+#define LWIP_HOOK_FILENAME              "lwip/pool_prof.h"
+#endif
+
 #endif /* __CC_H__ */
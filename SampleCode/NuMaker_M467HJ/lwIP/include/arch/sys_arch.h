@@ -36,11 +36,18 @@
 #include "task.h"
 #include "queue.h"
 #include "semphr.h"
+#include "NuMicro.h"
 
 #define SYS_MBOX_NULL                   ( ( xQueueHandle ) NULL )
 #define SYS_SEM_NULL                    ( ( xSemaphoreHandle ) NULL )
 #define SYS_DEFAULT_THREAD_STACK_DEPTH  configMINIMAL_STACK_SIZE
 
+/* BASEPRI level of sys_arch_protect(). Interrupts of a numerically lower
+   priority are not masked while lwIP is in a critical region. */
+#ifndef SYS_ARCH_PROTECT_BASEPRI
+#define SYS_ARCH_PROTECT_BASEPRI        configMAX_SYSCALL_INTERRUPT_PRIORITY
+#endif
+
 typedef xSemaphoreHandle sys_sem_t;
 typedef xSemaphoreHandle sys_mutex_t;
 typedef xQueueHandle sys_mbox_t;
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2023 Nuvoton Technology Corp.
+ * Description:   lwIP heap and memory pool usage profiler
+ *
+ * Add "#define LWIP_POOL_PROF 1" to lwipopts.h. arch/cc.h then turns on
+ * MEM_STATS and MEMP_STATS and hooks mem_malloc()/mem_free()/mem_trim()
+ * through LWIP_HOOK_FILENAME to keep a histogram of heap allocations by
+ * size.
+ *
+ * Run the workload, then call pool_prof_report(). It prints the heap and
+ * per-pool peaks and failures, the allocation size histogram and, from
+ * those, a block of lwipopts.h overrides (MEM_SIZE, MEMP_NUM_xxx,
+ * PBUF_POOL_SIZE) and a lwippools.h for MEM_USE_POOLS. Every figure is a
+ * peak plus 25% headroom; a pool that failed is reported as exhausted and
+ * needs a second run with a bigger setting before its figure means much.
+ * pool_prof_reset() starts a new capture without rebooting.
+ */
+#ifndef __LWIP_POOL_PROF_H__
+#define __LWIP_POOL_PROF_H__
+
+#include "lwip/opt.h"
+
+#if LWIP_POOL_PROF
+
+#include "lwip/mem.h"
+
+#if !MEM_STATS || !MEMP_STATS
+#error "LWIP_POOL_PROF needs LWIP_STATS, MEM_STATS and MEMP_STATS"
+#endif
+
+void pool_prof_malloc(mem_size_t size, mem_size_t usable);
+void pool_prof_free(mem_size_t usable);
+void pool_prof_trim(mem_size_t old_usable, mem_size_t new_usable);
+
+void pool_prof_reset(void);
+void pool_prof_report(void);
+
+/* Only the heap allocator in mem.c has these hooks */
+#if !MEM_LIBC_MALLOC && !MEM_USE_POOLS
+#define LWIP_HOOK_MEM_MALLOC(size, usable)          pool_prof_malloc(size, usable)
+#define LWIP_HOOK_MEM_FREE(usable)                  pool_prof_free(usable)
+#define LWIP_HOOK_MEM_TRIM(old_usable, new_usable)  pool_prof_trim(old_usable, new_usable)
+#endif
+
+#endif /* LWIP_POOL_PROF */
+
+#endif /* __LWIP_POOL_PROF_H__ */
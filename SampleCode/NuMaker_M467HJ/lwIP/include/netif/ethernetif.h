@@ -30,5 +30,6 @@
 
 err_t ethernetif_init(struct netif *netif);
 err_t ethernetif_input(struct netif *netif);
+err_t ethernetif_rx_post(struct pbuf *p);
 
 #endif
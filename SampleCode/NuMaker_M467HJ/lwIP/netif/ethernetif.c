@@ -49,11 +49,17 @@
 #include "lwip/mem.h"
 #include "lwip/pbuf.h"
 #include "lwip/sys.h"
+#include "lwip/tcpip.h"
 #include <lwip/stats.h>
 #include <lwip/snmp.h>
 #include "netif/etharp.h"
 //#include "netif/ppp_oe.h"
-#include "m460_emac.h"
+/* MAC driver behind this netif. A host build may point it at a TAP or loopback
+   backend that provides the same EMAC_xxx() functions as m460_emac.h. */
+#ifndef ETHERNETIF_DRIVER_H
+#define ETHERNETIF_DRIVER_H     "m460_emac.h"
+#endif
+#include ETHERNETIF_DRIVER_H
 #include "string.h"
 
 /* Define those to better describe your network interface. */
@@ -83,11 +89,143 @@ struct ethernetif
  *        for this ethernetif
  */
 sys_sem_t xRxSemaphore = NULL;
+sys_sem_t xTxSemaphore = NULL;
 sys_thread_t xRxThread = NULL;
 static void eth_rx_thread_entry(void *parameter);
 void ethernetif_input(u16_t len, u8_t *buf, u32_t s, u32_t ns);
 extern u8 my_mac_addr[6];
 
+/* Frames queued from the rx thread to tcpip_thread when the netif input is
+   tcpip_input(). There is one producer (eth_rx_thread) and one consumer
+   (tcpip_thread), so the ring needs no lock, and frames do not take a
+   TCPIP_MSG_INPKT or a copy through the tcpip mailbox. Must be a power of 2;
+   0 hands every frame to tcpip_input(). */
+#ifndef ETH_RX_RING_SIZE
+#define ETH_RX_RING_SIZE    32
+#endif
+
+#if ETH_RX_RING_SIZE
+static struct pbuf *rx_ring[ETH_RX_RING_SIZE];
+static volatile u32_t rx_ring_head;         /* next slot to fill, eth_rx_thread only */
+static volatile u32_t rx_ring_tail;         /* next slot to drain, tcpip_thread only */
+static volatile u32_t rx_ring_pending;      /* rx_ring_msg posted and not yet run */
+static struct tcpip_callback_msg *rx_ring_msg;
+
+/* Runs in tcpip_thread */
+static void eth_rx_ring_drain(void *arg)
+{
+    u32_t tail = rx_ring_tail;
+    struct pbuf *p;
+
+    /* Frames queued after this point post a new callback */
+    rx_ring_pending = 0;
+    __DMB();
+
+    while (tail != rx_ring_head)
+    {
+        __DMB();
+        p = rx_ring[tail & (ETH_RX_RING_SIZE - 1)];
+        rx_ring_tail = ++tail;
+
+        if (ethernet_input(p, _netif) != ERR_OK)
+            pbuf_free(p);
+    }
+}
+
+/* Runs in eth_rx_thread */
+static err_t eth_rx_ring_post(struct pbuf *p)
+{
+    u32_t head = rx_ring_head;
+
+    if (head - rx_ring_tail == ETH_RX_RING_SIZE)
+        return ERR_MEM;
+
+    rx_ring[head & (ETH_RX_RING_SIZE - 1)] = p;
+    __DMB();
+    rx_ring_head = head + 1;
+    __DMB();
+
+    if (!rx_ring_pending)
+    {
+        rx_ring_pending = 1;
+        /* The mailbox only fills up if tcpip_thread is behind; wait for it
+           instead of losing the wakeup */
+        while (tcpip_callbackmsg_trycallback(rx_ring_msg) != ERR_OK)
+            sys_msleep(1);
+    }
+
+    return ERR_OK;
+}
+#endif
+
+/**
+ * Hand a received frame to the stack, through the rx ring when the netif
+ * input is tcpip_input().
+ *
+ * @param p the frame, including the Ethernet header
+ * @return ERR_OK if the stack took p, otherwise the caller still owns it
+ */
+err_t
+ethernetif_rx_post(struct pbuf *p)
+{
+#if ETH_RX_RING_SIZE
+    if (_netif->input == tcpip_input)
+    {
+        if (eth_rx_ring_post(p) != ERR_OK)
+        {
+            EMAC_GetStats()->rx_ring_full++;
+            LINK_STATS_INC(link.drop);
+            return ERR_MEM;
+        }
+        return ERR_OK;
+    }
+#endif
+
+    return _netif->input(p, _netif);
+}
+
+#if LWIP_IGMP
+/* Map an IPv4 group to 01:00:5e + low 23 bits and program the GMAC address filter */
+static err_t
+igmp_mac_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action)
+{
+    const u8_t *ip = (const u8_t *)&group->addr;
+    u8_t mac[6] = {0x01, 0x00, 0x5e, 0, 0, 0};
+    int32_t ret;
+
+    mac[3] = ip[1] & 0x7f;
+    mac[4] = ip[2];
+    mac[5] = ip[3];
+
+    if (action == NETIF_ADD_MAC_FILTER)
+        ret = EMAC_AddMulticastFilter(mac);
+    else
+        ret = EMAC_DelMulticastFilter(mac);
+
+    return (ret == 0) ? ERR_OK : ERR_IF;
+}
+#endif
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+/* Map an IPv6 group to 33:33 + low 32 bits and program the GMAC address filter */
+static err_t
+mld_mac_filter(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action)
+{
+    const u8_t *ip = (const u8_t *)&group->addr[3];
+    u8_t mac[6] = {0x33, 0x33, 0, 0, 0, 0};
+    int32_t ret;
+
+    memcpy(&mac[2], ip, 4);
+
+    if (action == NETIF_ADD_MAC_FILTER)
+        ret = EMAC_AddMulticastFilter(mac);
+    else
+        ret = EMAC_DelMulticastFilter(mac);
+
+    return (ret == 0) ? ERR_OK : ERR_IF;
+}
+#endif
+
 static void
 low_level_init(struct netif *netif)
 {
@@ -107,16 +245,52 @@ low_level_init(struct netif *netif)
 
     /* device capabilities */
     netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
-#ifdef LWIP_IGMP
+#if LWIP_IGMP
     netif->flags |= NETIF_FLAG_IGMP;
+    netif_set_igmp_mac_filter(netif, igmp_mac_filter);
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+    netif->flags |= NETIF_FLAG_MLD6;
+    netif_set_mld_mac_filter(netif, mld_mac_filter);
+#endif
+
+#if (LWIP_USING_HW_CHECKSUM == 1) && LWIP_CHECKSUM_CTRL_PER_NETIF
+    /* GMAC inserts IPv4 header and TCP/UDP checksums, and drops frames failing them on receive.
+       The engine skips the payload of IP fragments both ways, so UDP and ICMP are still
+       checked by lwIP on the reassembled datagram, and ICMP checksums are made by lwIP:
+       a large echo reply is fragmented and would leave with checksum 0. It costs little,
+       lwIP adjusts the checksum of an echo request instead of summing the reply again. */
+    NETIF_SET_CHECKSUM_CTRL(netif, NETIF_CHECKSUM_CHECK_UDP |
+                            NETIF_CHECKSUM_GEN_ICMP | NETIF_CHECKSUM_CHECK_ICMP |
+                            NETIF_CHECKSUM_GEN_ICMP6 | NETIF_CHECKSUM_CHECK_ICMP6);
 #endif
 
     EMAC_Open(&my_mac_addr[0]);
 
+#if LWIP_IPV6
+    {
+        /* All-nodes ff02::1: lwIP never joins it through MLD, but router
+           advertisements and neighbor discovery arrive on it */
+        static const u8_t all_nodes[6] = {0x33, 0x33, 0x00, 0x00, 0x00, 0x01};
+
+        EMAC_AddMulticastFilter(all_nodes);
+    }
+#endif
+
     if (sys_sem_new(&xRxSemaphore, 0) != ERR_OK)
     {
         while (1);
     }
+    else if (sys_sem_new(&xTxSemaphore, 0) != ERR_OK)
+    {
+        while (1);
+    }
+#if ETH_RX_RING_SIZE
+    else if ((rx_ring_msg = tcpip_callbackmsg_new(eth_rx_ring_drain, NULL)) == NULL)
+    {
+        while (1);
+    }
+#endif
     else if ((xRxThread = sys_thread_new("eth_rx", eth_rx_thread_entry, NULL, RX_THREAD_STACKSIZE, RX_THREAD_PRIO)) == NULL)
     {
         while (1);
@@ -125,26 +299,59 @@ low_level_init(struct netif *netif)
     sys_arch_sem_wait(&xRxSemaphore, 0);
 }
 
+/* Frames handled per pass over the rx ring, so a flood cannot monopolize the CPU */
+#ifndef ETH_RX_BUDGET
+#define ETH_RX_BUDGET       16
+#endif
+
+/* Period of a pass while in polling mode */
+#ifndef ETH_RX_POLL_MS
+#define ETH_RX_POLL_MS      1
+#endif
+
+/* Fewer frames than this in a polling period switches back to interrupt mode */
+#ifndef ETH_RX_POLL_EXIT
+#define ETH_RX_POLL_EXIT    2
+#endif
+
 // Implement NAPI
+// The rx thread is woken up by the rx interrupt. If a pass uses up the whole budget the
+// thread switches to polling the ring every ETH_RX_POLL_MS with the interrupt off, and
+// goes back to interrupt mode once the frame rate drops.
 static void eth_rx_thread_entry(void *parameter)
 {
-    int len;
+    struct net_device_stats *stats = EMAC_GetStats();
+    u32_t timeout = 0;          /* 0: interrupt mode, wait forever */
+    int count;
 
     sys_sem_signal(&xRxSemaphore);
 
     while (1)
     {
-        if (sys_arch_sem_wait(&xRxSemaphore, 0) != SYS_ARCH_TIMEOUT)    // Wait forever
+        sys_arch_sem_wait(&xRxSemaphore, timeout);
+
+        for (count = 0; count < ETH_RX_BUDGET; count++)
+        {
+            if (EMAC_ReceivePkt() == 0)
+                break;
+        }
+        stats->rx_polls++;
+
+        if (count == ETH_RX_BUDGET)
         {
-            while (1)
+            stats->rx_budget_exhausted++;
+            if (timeout == 0)
             {
-                if ((len = EMAC_ReceivePkt()) <= 0)
-                {
-                    // Enable RX interrupt.
-                    break;
-                }
+                stats->rx_poll_mode++;
+                timeout = ETH_RX_POLL_MS;
             }
         }
+        else if ((timeout == 0) || (count < ETH_RX_POLL_EXIT))
+        {
+            // Enable RX interrupt.
+            timeout = 0;
+            EMAC_EnableRxInt();
+        }
     }
 }
 
@@ -158,39 +365,58 @@ static void eth_rx_thread_entry(void *parameter)
  * @return ERR_OK if the packet could be sent
  *         an err_t value if the packet couldn't be sent
  *
- * @note Returning ERR_MEM here if a DMA queue of your MAC is full can lead to
- *       strange results. You might consider waiting for space in the DMA queue
- *       to become availale since the stack doesn't retry to send a packet
- *       dropped because of memory failure (except for the TCP timers).
+ * @note If the tx ring is full the caller is blocked until the transmit complete
+ *       interrupt frees a descriptor. The frame is only dropped, and ERR_IF
+ *       returned, if no descriptor becomes free within EMAC_TX_WAIT_MS.
  */
 static err_t
 low_level_output(struct netif *netif, struct pbuf *p)
 {
+#ifdef TIME_STAMPING
     struct pbuf *q;
     u8_t *buf = NULL;
     u16_t len = 0;
 
     buf = EMAC_AllocatePktBuf();
+#else
+    int32_t ret;
+#endif
+    err_t err = ERR_OK;
 
 #if ETH_PAD_SIZE
     pbuf_header(p, -ETH_PAD_SIZE); /* drop the padding word */
 #endif
 
+#ifdef TIME_STAMPING
     for (q = p; q != NULL; q = q->next)
     {
         memcpy((u8_t *)&buf[len], q->payload, q->len);
         len = len + q->len;
     }
-#ifdef TIME_STAMPING
     ETH_trigger_tx(len, p->flags & PBUF_FLAG_GET_TXTS ? p : NULL);
 #else
-    EMAC_TransmitPkt(buf, len);
+    /* pbuf chain is handed to GMAC DMA directly, no copy */
+    while ((ret = EMAC_TransmitPbuf(p)) < 0)
+    {
+        /* Ring is full, wait for the transmit complete interrupt rather than dropping the frame */
+        if ((ret != -1) || (EMAC_WaitTxSpace(EMAC_TX_WAIT_MS) < 0))
+        {
+            err = ERR_IF;
+            break;
+        }
+    }
 #endif
 
 #if ETH_PAD_SIZE
     pbuf_header(p, ETH_PAD_SIZE); /* reclaim the padding word */
 #endif
 
+    if (err != ERR_OK)
+    {
+        LINK_STATS_INC(link.drop);
+        return err;
+    }
+
     LINK_STATS_INC(link.xmit);
 
     return ERR_OK;
@@ -288,7 +514,7 @@ ethernetif_input(u16_t len, u8_t *buf, u32_t s, u32_t ns)
     case ETHTYPE_PPPOE:
 #endif /* PPPOE_SUPPORT */
         /* full packet send to tcpip_thread to process */
-        if (_netif->input(p, _netif) != ERR_OK)
+        if (ethernetif_rx_post(p) != ERR_OK)
         {
             LWIP_DEBUGF(NETIF_DEBUG, ("ethernetif_input: IP input error\n"));
             pbuf_free(p);
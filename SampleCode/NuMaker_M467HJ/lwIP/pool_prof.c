@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2023 Nuvoton Technology Corp.
+ * Description:   lwIP heap and memory pool usage profiler
+ */
+#include <string.h>
+
+#include "lwip/opt.h"
+#include "lwip/pool_prof.h"
+
+#if LWIP_POOL_PROF
+
+#include "lwip/def.h"
+#include "lwip/memp.h"
+#include "lwip/stats.h"
+#include "lwip/sys.h"
+
+/* The pool counts in memp_std.h use these, as in memp.c */
+#include "netif/ppp/ppp_opts.h"
+
+/* Heap allocations are counted by usable size in these classes. The last
+ * one catches everything bigger than 2048. */
+static const mem_size_t class_limit[] =
+{
+    32, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, MEM_SIZE
+};
+
+#define NUM_CLASSES     LWIP_ARRAYSIZE(class_limit)
+
+struct size_class
+{
+    u32_t allocs;       /* successful mem_malloc() calls */
+    u32_t fails;        /* failed mem_malloc() calls, by requested size */
+    u16_t cur;          /* blocks in use */
+    u16_t peak;         /* highest cur */
+    mem_size_t largest; /* largest size requested */
+};
+
+static struct size_class classes[NUM_CLASSES];
+static u32_t trims;
+
+/* Option name and configured count of every pool in memp_std.h, indexed
+ * by memp_t. The count argument has to be stringized before it expands. */
+struct pool_cfg
+{
+    const char *name;
+    const char *opt;
+    u16_t num;
+};
+
+static const struct pool_cfg pool_cfg[MEMP_MAX] =
+{
+#define LWIP_MEMPOOL(name, num, size, desc)         { #name, #num, (num) },
+#define LWIP_PBUF_MEMPOOL(name, num, payload, desc) { #name, #num, (num) },
+#include "lwip/priv/memp_std.h"
+};
+
+static u8_t size_to_class(mem_size_t size)
+{
+    u8_t i;
+
+    for (i = 0; (i < NUM_CLASSES - 1) && (size > class_limit[i]); i++);
+
+    return i;
+}
+
+/* Peak plus 25% headroom */
+static u32_t headroom(u32_t peak)
+{
+    return peak + (peak + 3) / 4;
+}
+
+void pool_prof_malloc(mem_size_t size, mem_size_t usable)
+{
+    struct size_class *c;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if (usable == 0)
+    {
+        c = &classes[size_to_class(size)];
+        SYS_ARCH_PROTECT(lev);
+        c->fails++;
+        SYS_ARCH_UNPROTECT(lev);
+        return;
+    }
+
+    c = &classes[size_to_class(usable)];
+    SYS_ARCH_PROTECT(lev);
+    c->allocs++;
+    if (++c->cur > c->peak)
+        c->peak = c->cur;
+    if (size > c->largest)
+        c->largest = size;
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+void pool_prof_free(mem_size_t usable)
+{
+    struct size_class *c = &classes[size_to_class(usable)];
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    if (c->cur)
+        c->cur--;
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+/* A trimmed block is counted in the class of its new size from now on */
+void pool_prof_trim(mem_size_t old_usable, mem_size_t new_usable)
+{
+    struct size_class *o = &classes[size_to_class(old_usable)];
+    struct size_class *n = &classes[size_to_class(new_usable)];
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    trims++;
+    if (o != n)
+    {
+        if (o->cur)
+            o->cur--;
+        if (++n->cur > n->peak)
+            n->peak = n->cur;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+void pool_prof_reset(void)
+{
+    u32_t i;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    for (i = 0; i < NUM_CLASSES; i++)
+    {
+        classes[i].allocs = 0;
+        classes[i].fails = 0;
+        classes[i].peak = classes[i].cur;
+        classes[i].largest = 0;
+    }
+    trims = 0;
+
+    lwip_stats.mem.max = lwip_stats.mem.used;
+    lwip_stats.mem.err = 0;
+    for (i = 0; i < MEMP_MAX; i++)
+    {
+        if (lwip_stats.memp[i] != NULL)
+        {
+            lwip_stats.memp[i]->max = lwip_stats.memp[i]->used;
+            lwip_stats.memp[i]->err = 0;
+        }
+    }
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+void pool_prof_report(void)
+{
+    struct size_class snap[NUM_CLASSES];
+    struct stats_mem mem;
+    u32_t i, j, rec, total;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    memcpy(snap, classes, sizeof(snap));
+    mem = lwip_stats.mem;
+    SYS_ARCH_UNPROTECT(lev);
+
+    /* Heap: peak includes the per-block header, round up to 1 KB */
+    rec = (headroom(mem.max) + 1023) & ~1023UL;
+    LWIP_PLATFORM_DIAG(("\n== heap\n"));
+    LWIP_PLATFORM_DIAG(("MEM_SIZE %u  peak %u  failed %u  trims %u  -> %u%s\n",
+                        (unsigned)MEM_SIZE, (unsigned)mem.max, (unsigned)mem.err, (unsigned)trims,
+                        (unsigned)rec, mem.err ? "  (exhausted, rerun bigger)" : ""));
+
+    LWIP_PLATFORM_DIAG(("\n== pools\n"));
+    LWIP_PLATFORM_DIAG(("%-16s %-36s %5s %5s %5s\n", "pool", "option", "num", "peak", "fail"));
+    for (i = 0; i < MEMP_MAX; i++)
+    {
+        const struct stats_mem *s = lwip_stats.memp[i];
+
+        if (s == NULL)
+            continue;
+        LWIP_PLATFORM_DIAG(("%-16s %-36s %5u %5u %5u%s\n", pool_cfg[i].name, pool_cfg[i].opt,
+                            (unsigned)pool_cfg[i].num, (unsigned)s->max, (unsigned)s->err,
+                            s->err ? "  (exhausted, rerun bigger)" : ""));
+    }
+
+    LWIP_PLATFORM_DIAG(("\n== heap allocations by size\n"));
+    LWIP_PLATFORM_DIAG(("%6s %10s %8s %6s %8s\n", "<=", "allocs", "failed", "peak", "largest"));
+    for (i = 0; i < NUM_CLASSES; i++)
+    {
+        if ((snap[i].allocs == 0) && (snap[i].fails == 0) && (snap[i].peak == 0))
+            continue;
+        LWIP_PLATFORM_DIAG(("%6u %10u %8u %6u %8u\n", (unsigned)class_limit[i],
+                            (unsigned)snap[i].allocs, (unsigned)snap[i].fails,
+                            (unsigned)snap[i].peak, (unsigned)snap[i].largest));
+    }
+
+    /* lwipopts.h overrides, only for settings that should change */
+    LWIP_PLATFORM_DIAG(("\n/* lwipopts.h */\n"));
+    LWIP_PLATFORM_DIAG(("#define %-36s %u\n", "MEM_SIZE", (unsigned)(mem.err ? 2 * MEM_SIZE : rec)));
+    for (i = 0; i < MEMP_MAX; i++)
+    {
+        const struct stats_mem *s = lwip_stats.memp[i];
+
+        if (s == NULL)
+            continue;
+
+        /* IPv4 and IPv6 reassembly share MEMP_NUM_REASSDATA */
+        for (j = 0; j < i; j++)
+        {
+            if ((lwip_stats.memp[j] != NULL) && (strcmp(pool_cfg[j].opt, pool_cfg[i].opt) == 0))
+                break;
+        }
+        if (j < i)
+            continue;
+
+        rec = s->err ? 2 * pool_cfg[i].num : LWIP_MAX(headroom(s->max), 1);
+        if (rec != pool_cfg[i].num)
+            LWIP_PLATFORM_DIAG(("#define %-36s %u\n", pool_cfg[i].opt, (unsigned)rec));
+    }
+
+    /* MEM_USE_POOLS: one pool per used class, sized by the largest request
+     * seen and the peak number of blocks. Every pool costs a helper word
+     * per element on top of the size given. */
+    LWIP_PLATFORM_DIAG(("\n/* lwipopts.h: MEM_USE_POOLS 1, MEMP_USE_CUSTOM_POOLS 1 */\n"));
+    LWIP_PLATFORM_DIAG(("/* lwippools.h */\n"));
+    LWIP_PLATFORM_DIAG(("LWIP_MALLOC_MEMPOOL_START\n"));
+    total = 0;
+    for (i = 0; i < NUM_CLASSES; i++)
+    {
+        u32_t size;
+
+        if (snap[i].peak == 0)
+            continue;
+        /* after a reset, blocks still held count without a size */
+        size = LWIP_MEM_ALIGN_SIZE(snap[i].largest ? snap[i].largest : class_limit[i]);
+        rec = headroom(snap[i].peak) + (snap[i].fails ? snap[i].peak : 0);
+        total += rec * (size + LWIP_MEM_ALIGN_SIZE(sizeof(memp_t)));
+        LWIP_PLATFORM_DIAG(("LWIP_MALLOC_MEMPOOL(%u, %u)\n", (unsigned)rec, (unsigned)size));
+    }
+    LWIP_PLATFORM_DIAG(("LWIP_MALLOC_MEMPOOL_END\n"));
+    LWIP_PLATFORM_DIAG(("/* about %u bytes of pools in place of the heap */\n\n", (unsigned)total));
+}
+
+#endif /* LWIP_POOL_PROF */
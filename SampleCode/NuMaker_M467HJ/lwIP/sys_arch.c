@@ -162,10 +162,32 @@ err_t sys_mbox_trypost(sys_mbox_t *pxMailBox, void *pxMessageToPost)
     return xReturn;
 }
 
+/*---------------------------------------------------------------------------*
+ * Routine:  sys_mbox_trypost_fromisr
+ *---------------------------------------------------------------------------*
+ * Description:
+ *      Interrupt-safe sys_mbox_trypost(). Switches to the woken task, e.g.
+ *      tcpip_thread, on return from the interrupt.
+ * Inputs:
+ *      sys_mbox_t mbox         -- Handle of mailbox
+ *      void *msg               -- Pointer to data to post
+ * Outputs:
+ *      err_t                   -- ERR_OK if message posted, else ERR_MEM
+ *                                  if not.
+ *---------------------------------------------------------------------------*/
 err_t
 sys_mbox_trypost_fromisr(sys_mbox_t *q, void *msg)
 {
-    return sys_mbox_trypost(q, msg);
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+    if(xQueueSendFromISR(*q, &msg, &xHigherPriorityTaskWoken) != pdPASS)
+    {
+        SYS_STATS_INC(mbox.err);
+        return ERR_MEM;
+    }
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    return ERR_OK;
 }
 
 /*---------------------------------------------------------------------------*
@@ -518,13 +540,24 @@ sys_thread_t sys_thread_new(const char *pcName, void(*pxThread)(void *pvParamete
  *
  *      sys_arch_protect() is only required if your port is supporting an
  *      operating system.
+ *
+ *      Implemented by raising BASEPRI to SYS_ARCH_PROTECT_BASEPRI, so it is
+ *      callable from tasks and from interrupts that use the FreeRTOS FromISR
+ *      API, nests without a counter, and leaves interrupts with a higher
+ *      priority than configMAX_SYSCALL_INTERRUPT_PRIORITY (motor control,
+ *      ADC, ...) running. Such interrupts must not call lwIP.
  * Outputs:
- *      sys_prot_t              -- Previous protection level (not used here)
+ *      sys_prot_t              -- Previous BASEPRI value
  *---------------------------------------------------------------------------*/
 sys_prot_t sys_arch_protect(void)
 {
-    taskENTER_CRITICAL();
-    return (sys_prot_t) 1;
+    sys_prot_t xPrevious = __get_BASEPRI();
+
+    /* Only ever raises the masking level, so a nested call is a no-op */
+    __set_BASEPRI_MAX(SYS_ARCH_PROTECT_BASEPRI);
+    __ISB();
+
+    return xPrevious;
 }
 
 /*---------------------------------------------------------------------------*
@@ -536,12 +569,11 @@ sys_prot_t sys_arch_protect(void)
  *      sys_arch_protect() for more information. This function is only
  *      required if your port is supporting an operating system.
  * Inputs:
- *      sys_prot_t              -- Previous protection level (not used here)
+ *      sys_prot_t              -- BASEPRI value returned by sys_arch_protect()
  *---------------------------------------------------------------------------*/
 void sys_arch_unprotect(sys_prot_t xValue)
 {
-    (void) xValue;
-    taskEXIT_CRITICAL();
+    __set_BASEPRI(xValue);
 }
 
 /*
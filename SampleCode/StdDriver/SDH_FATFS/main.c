@@ -288,11 +288,15 @@ void get_line(char *buff, int len)
 
 }
 
+/* bt - cycles spent in SDH0_IRQHandler, in total and the longest single call */
+static uint32_t volatile s_u32IsrCycles;
+static uint32_t volatile s_u32IsrMax;
 
 void SDH0_IRQHandler(void)
 {
     unsigned int volatile isr;
     unsigned int volatile ier;
+    uint32_t u32Start = DWT->CYCCNT;
 
     // FMI data abort interrupt
     if(SDH0->GINTSTS & SDH_GINTSTS_DTAIF_Msk)
@@ -310,6 +314,8 @@ void SDH0_IRQHandler(void)
         // block down
         SD0.DataReadyFlag = TRUE;
         SDH0->INTSTS = SDH_INTSTS_BLKDIF_Msk;
+        // next chunk or end of SDH_ReadAsync/SDH_WriteAsync
+        SDH_AsyncIRQHandler(SDH0);
     }
 
     if((ier & SDH_INTEN_CDIEN_Msk) &&
@@ -374,6 +380,11 @@ void SDH0_IRQHandler(void)
         printf("***** ISR: response in timeout !\n");
         SDH0->INTSTS |= SDH_INTSTS_RTOIF_Msk;
     }
+
+    u32Start = DWT->CYCCNT - u32Start;
+    s_u32IsrCycles += u32Start;
+    if(u32Start > s_u32IsrMax)
+        s_u32IsrMax = u32Start;
 }
 
 void SYS_Init(void)
@@ -478,6 +489,91 @@ unsigned long get_fattime(void)
 }
 
 
+/*--------------------------------------------------------------------------*/
+/* bt - CPU load of a sustained read with SDH_Read and SDH_ReadAsync        */
+/*--------------------------------------------------------------------------*/
+
+static uint32_t volatile s_u32AsyncDone;
+
+static void read_done(SDH_T *sdh, uint32_t u32Status, void *pvArg)
+{
+    (void)sdh;
+    (void)u32Status;
+    (void)pvArg;
+
+    s_u32AsyncDone = 1;
+}
+
+static void print_load(const char *name, uint32_t u32KB, uint32_t u32Total, uint32_t u32Busy)
+{
+    uint32_t u32Ms = u32Total / (SystemCoreClock / 1000);
+    uint32_t u32Permille = (u32Total >= 1000) ? u32Busy / (u32Total / 1000) : 1000;
+
+    printf("%-13s %lu KB in %lu ms (%lu KB/s), CPU load %lu.%lu%%\n", name, u32KB, u32Ms,
+           u32Ms ? (u32KB * 1000 / u32Ms) : 0, u32Permille / 10, u32Permille % 10);
+}
+
+void read_bench(uint32_t u32Sec, uint32_t u32KB)
+{
+    uint32_t u32Left, u32Cnt, u32Start, u32Total, u32Busy, u32Status = Successful;
+    uint32_t u32Sec0 = u32Sec;
+
+    /* Enable the cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    /* SDH_Read spins until the data is in: all of the time is CPU time */
+    u32Start = DWT->CYCCNT;
+    for(u32Left = u32KB * 2; u32Left; u32Left -= u32Cnt, u32Sec += u32Cnt)
+    {
+        u32Cnt = (u32Left < BUFF_SIZE / 512) ? u32Left : BUFF_SIZE / 512;
+        if((u32Status = SDH_Read(SDH0, Buff, u32Sec, u32Cnt)) != Successful)
+            break;
+    }
+    u32Total = DWT->CYCCNT - u32Start;
+    if(u32Status != Successful)
+    {
+        printf("SDH_Read failed at sector %lu: 0x%lx\n", u32Sec, u32Status);
+        return;
+    }
+    print_load("SDH_Read", u32KB, u32Total, u32Total);
+
+    /* SDH_ReadAsync: CPU time is the submit and wait calls plus the interrupt handler.
+       The loop on s_u32AsyncDone stands for any other work of the application. */
+    s_u32IsrCycles = 0;
+    s_u32IsrMax = 0;
+    u32Busy = 0;
+    u32Sec = u32Sec0;
+    u32Start = DWT->CYCCNT;
+    for(u32Left = u32KB * 2; u32Left; u32Left -= u32Cnt, u32Sec += u32Cnt)
+    {
+        uint32_t u32Call = DWT->CYCCNT;
+
+        u32Cnt = (u32Left < BUFF_SIZE / 512) ? u32Left : BUFF_SIZE / 512;
+        s_u32AsyncDone = 0;
+        if((u32Status = SDH_ReadAsync(SDH0, Buff, u32Sec, u32Cnt, read_done, NULL)) != Successful)
+            break;
+        u32Busy += DWT->CYCCNT - u32Call;
+
+        while(!s_u32AsyncDone && SD0.IsCardInsert);
+
+        u32Call = DWT->CYCCNT;
+        u32Status = SDH_WaitAsync(SDH0);
+        u32Busy += DWT->CYCCNT - u32Call;
+        if(u32Status != Successful)
+            break;
+    }
+    u32Total = DWT->CYCCNT - u32Start;
+    if(u32Status != Successful)
+    {
+        printf("SDH_ReadAsync failed at sector %lu: 0x%lx\n", u32Sec, u32Status);
+        return;
+    }
+    print_load("SDH_ReadAsync", u32KB, u32Total, u32Busy + s_u32IsrCycles);
+    printf("longest SDH0_IRQHandler %lu us\n", s_u32IsrMax / (SystemCoreClock / 1000000));
+}
+
 static FIL file1, file2;        /* File objects */
 
 int main(void)
@@ -623,6 +719,12 @@ int main(void)
                         memset(Buff, (int)p1, BUFF_SIZE);
                         break;
 
+                    case 't' :  /* bt <sector> [<KB>] - Read test, CPU load of SDH_Read/SDH_ReadAsync */
+                        if(!xatoi(&ptr, &p2)) break;
+                        if(!xatoi(&ptr, &p3)) p3 = 10 * 1024;
+                        read_bench((uint32_t)p2, (uint32_t)p3);
+                        break;
+
                 }
                 break;
 
@@ -931,6 +1033,7 @@ int main(void)
                     _T("br <pd#> <sect> [<num>] - Read disk into working buffer\n")
                     _T("bw <pd#> <sect> [<num>] - Write working buffer into disk\n")
                     _T("bf <val> - Fill working buffer\n")
+                    _T("bt <sect> [<KB>] - Read <KB> (10 MB) from the card, CPU load of SDH_Read/SDH_ReadAsync\n")
                     _T("\n")
                     _T("fs - Show volume status\n")
                     _T("fl [<path>] - Show a directory\n")
@@ -0,0 +1,30 @@
+/*
+ * NuMicro.h for the host build of diskio.c.
+ *
+ * Pulls in the real SDH register layout and StdDriver declarations, with
+ * SDH0/SDH1 pointing at plain structures. disk_sim.c implements SDH_Read,
+ * SDH_Write and SDH_Erase on top of image files.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __NUMICRO_H__
+#define __NUMICRO_H__
+
+#include <stdint.h>
+
+#define __I         volatile const
+#define __O         volatile
+#define __IO        volatile
+
+#include "sdh_reg.h"
+
+extern SDH_T g_asSdhSim[2];
+#define SDH0        (&g_asSdhSim[0])
+#define SDH1        (&g_asSdhSim[1])
+
+#include "sdh.h"
+
+/* Clock for DISKIO_CACHE_TICK(), advanced by the tests */
+extern uint32_t g_u32SimTick;
+
+#endif /* __NUMICRO_H__ */
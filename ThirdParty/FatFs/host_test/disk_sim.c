@@ -0,0 +1,355 @@
+/*
+ * Simulated SDH controllers and USB mass storage drives over image files.
+ *
+ * The SDH model follows SDH_Read/SDH_Write in StdDriver/src/sdh.c as far
+ * as diskio.c can tell: a buffer that is not word aligned is counted and
+ * refused (the real DMA would silently drop the low address bits), a
+ * pulled card returns SDH_NO_SD_CARD. Erased sectors read back as 0.
+ *
+ * Transfers can be given a duration. It is added up in the statistics,
+ * and can also be slept, outside of any lock, so that threads on
+ * different drives overlap the way DMA and USB transfers do.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "NuMicro.h"
+#include "usbh_lib.h"
+#include "diskio.h"
+#include "disk_sim.h"
+
+#define SECTOR_SIZE     512
+
+typedef struct
+{
+    int attached;
+    int fd;                 /* image */
+    uint32_t sectors;
+    int removed;
+    int fail;
+    uint32_t cmd_us, sector_us;
+    int sleep;
+    disk_sim_stat_t stat;
+} sim_dev_t;
+
+SDH_T g_asSdhSim[2];
+SDH_INFO_T SD0, SD1;
+uint32_t g_u32SimTick;
+
+static sim_dev_t s_dev[DISK_SIM_DRIVES];
+static int s_iUsbBusy, s_iUsbMaxBusy;
+
+static int sim_open(sim_dev_t *dev, const char *image, uint32_t sectors)
+{
+    struct stat st;
+
+    if (dev->attached)
+        close(dev->fd);
+    memset(dev, 0, sizeof(*dev));
+    dev->fd = open(image, O_RDWR | O_CREAT | (sectors ? O_TRUNC : 0), 0644);
+    if (dev->fd < 0)
+        return -1;
+    dev->attached = 1;
+    if (sectors)
+    {
+        if (ftruncate(dev->fd, (off_t)sectors * SECTOR_SIZE) != 0)
+            return -1;
+    }
+    else
+    {
+        if (fstat(dev->fd, &st) != 0)
+            return -1;
+        sectors = (uint32_t)(st.st_size / SECTOR_SIZE);
+    }
+    dev->sectors = sectors;
+    return 0;
+}
+
+static void sim_close(sim_dev_t *dev)
+{
+    if (dev->attached)
+        close(dev->fd);
+    memset(dev, 0, sizeof(*dev));
+}
+
+static int sim_rw(sim_dev_t *dev, uint8_t *buf, uint32_t sector, uint32_t count, int write)
+{
+    ssize_t len = (ssize_t)count * SECTOR_SIZE;
+    off_t off = (off_t)sector * SECTOR_SIZE;
+
+    if ((sector >= dev->sectors) || (count > dev->sectors - sector))
+        return -1;
+    if (write)
+        return (pwrite(dev->fd, buf, (size_t)len, off) == len) ? 0 : -1;
+    return (pread(dev->fd, buf, (size_t)len, off) == len) ? 0 : -1;
+}
+
+static void sim_wait(sim_dev_t *dev, uint32_t count)
+{
+    uint32_t us = dev->cmd_us + dev->sector_us * count;
+
+    dev->stat.busy_us += us;
+    if (dev->sleep && us)
+        usleep(us);
+}
+
+static void sim_count(sim_dev_t *dev, const void *buf, uint32_t count, int write)
+{
+    if (write)
+    {
+        dev->stat.writes++;
+        dev->stat.wr_sectors += count;
+    }
+    else
+        dev->stat.reads++;
+    if (count > dev->stat.max_count)
+        dev->stat.max_count = count;
+    dev->stat.last_buf = buf;
+}
+
+/*-----------------------------------------------------------------------*/
+/* SDH                                                                   */
+/*-----------------------------------------------------------------------*/
+
+static int sdh_index(SDH_T *sdh)
+{
+    return (sdh == SDH0) ? 0 : 1;
+}
+
+static SDH_INFO_T *sdh_info(int port)
+{
+    return port ? &SD1 : &SD0;
+}
+
+int disk_sim_sd_attach(int port, const char *image, uint32_t sectors)
+{
+    SDH_INFO_T *pSD = sdh_info(port);
+
+    if (sim_open(&s_dev[port], image, sectors) != 0)
+        return -1;
+    memset(pSD, 0, sizeof(*pSD));
+    pSD->IsCardInsert = 1;
+    pSD->CardType = SDH_TYPE_SD_HIGH;
+    pSD->totalSectorN = s_dev[port].sectors;
+    pSD->diskSize = s_dev[port].sectors / 2;
+    pSD->sectorSize = SECTOR_SIZE;
+    return 0;
+}
+
+void disk_sim_sd_detach(int port)
+{
+    sim_close(&s_dev[port]);
+    memset(sdh_info(port), 0, sizeof(SDH_INFO_T));
+}
+
+void disk_sim_sd_remove(int port, int removed)
+{
+    s_dev[port].removed = removed;
+    sdh_info(port)->IsCardInsert = !removed;
+}
+
+static uint32_t sdh_xfer(SDH_T *sdh, uint8_t *buf, uint32_t sector, uint32_t count, int write)
+{
+    sim_dev_t *dev = &s_dev[sdh_index(sdh)];
+
+    if (count == 0)
+        return SDH_SELECT_ERROR;
+    sim_count(dev, buf, count, write);
+    if (!dev->attached || dev->removed)
+        return SDH_NO_SD_CARD;
+    if ((uintptr_t)buf & 3)
+    {
+        dev->stat.unaligned++;
+        return SDH_CRC_ERROR;
+    }
+    sim_wait(dev, count);
+    return sim_rw(dev, buf, sector, count, write) ? SDH_TIMEOUT : Successful;
+}
+
+uint32_t SDH_Read(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount)
+{
+    return sdh_xfer(sdh, pu8BufAddr, u32StartSec, u32SecCount, 0);
+}
+
+uint32_t SDH_Write(SDH_T *sdh, uint8_t *pu8BufAddr, uint32_t u32StartSec, uint32_t u32SecCount)
+{
+    return sdh_xfer(sdh, pu8BufAddr, u32StartSec, u32SecCount, 1);
+}
+
+uint32_t SDH_Erase(SDH_T *sdh, uint32_t u32StartSec, uint32_t u32SecCount)
+{
+    static const uint8_t zero[SECTOR_SIZE];
+    sim_dev_t *dev = &s_dev[sdh_index(sdh)];
+    uint32_t i;
+
+    if (u32SecCount == 0)
+        return SDH_SELECT_ERROR;
+    dev->stat.erases++;
+    if (!dev->attached || dev->removed)
+        return SDH_NO_SD_CARD;
+    for (i = 0; i < u32SecCount; i++)
+    {
+        if (sim_rw(dev, (uint8_t *)(uintptr_t)zero, u32StartSec + i, 1, 1))
+            return SDH_TIMEOUT;
+    }
+    return Successful;
+}
+
+/*-----------------------------------------------------------------------*/
+/* USB mass storage                                                      */
+/*-----------------------------------------------------------------------*/
+
+int disk_sim_usb_attach(int drv, const char *image, uint32_t sectors)
+{
+    return sim_open(&s_dev[drv], image, sectors);
+}
+
+void disk_sim_usb_detach(int drv)
+{
+    sim_close(&s_dev[drv]);
+}
+
+void disk_sim_usb_fail(int drv, int n)
+{
+    s_dev[drv].fail = n;
+}
+
+static sim_dev_t *usb_find(int drv_no)
+{
+    if ((drv_no < 3) || (drv_no >= DISK_SIM_DRIVES) || !s_dev[drv_no].attached)
+        return NULL;
+    return &s_dev[drv_no];
+}
+
+int usbh_pooling_hubs(void)
+{
+    return 0;
+}
+
+int usbh_umas_disk_status(int drv_no)
+{
+    return usb_find(drv_no) ? 0 : STA_NODISK;
+}
+
+/* All drives hang off one host controller: count the calls in progress */
+static void usb_enter(void)
+{
+    int busy = __atomic_add_fetch(&s_iUsbBusy, 1, __ATOMIC_SEQ_CST);
+    int max = __atomic_load_n(&s_iUsbMaxBusy, __ATOMIC_SEQ_CST);
+
+    while ((busy > max) && !__atomic_compare_exchange_n(&s_iUsbMaxBusy, &max, busy, 0,
+            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        ;
+}
+
+static void usb_leave(void)
+{
+    __atomic_sub_fetch(&s_iUsbBusy, 1, __ATOMIC_SEQ_CST);
+}
+
+static int umas_xfer(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff, int write)
+{
+    sim_dev_t *dev = usb_find(drv_no);
+    int ret;
+
+    if (dev == NULL)
+        return UMAS_ERR_DRIVE_NOT_FOUND;
+    usb_enter();
+    sim_count(dev, buff, (uint32_t)sec_cnt, write);
+    sim_wait(dev, (uint32_t)sec_cnt);
+    if (dev->fail)
+    {
+        dev->fail--;
+        ret = UMAS_ERR_IO;
+    }
+    else
+        ret = sim_rw(dev, buff, sec_no, (uint32_t)sec_cnt, write) ? UMAS_ERR_IO : UMAS_OK;
+    usb_leave();
+    return ret;
+}
+
+int usbh_umas_read(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
+{
+    return umas_xfer(drv_no, sec_no, sec_cnt, buff, 0);
+}
+
+int usbh_umas_write(int drv_no, uint32_t sec_no, int sec_cnt, uint8_t *buff)
+{
+    return umas_xfer(drv_no, sec_no, sec_cnt, buff, 1);
+}
+
+/* Same results as msc_driver.c, including the 32-bit stores */
+int usbh_umas_ioctl(int drv_no, int cmd, void *buff)
+{
+    sim_dev_t *dev = usb_find(drv_no);
+
+    if (dev == NULL)
+        return UMAS_ERR_DRIVE_NOT_FOUND;
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *(uint32_t *)buff = dev->sectors;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+    case GET_BLOCK_SIZE:
+        *(uint32_t *)buff = SECTOR_SIZE;
+        return RES_OK;
+    }
+    return UMAS_ERR_IVALID_PARM;
+}
+
+int usbh_umas_reset_disk(int drv_no)
+{
+    sim_dev_t *dev = usb_find(drv_no);
+
+    if (dev == NULL)
+        return UMAS_ERR_DRIVE_NOT_FOUND;
+    dev->stat.resets++;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+
+void disk_sim_latency(int drv, uint32_t cmd_us, uint32_t sector_us, int sleep)
+{
+    s_dev[drv].cmd_us = cmd_us;
+    s_dev[drv].sector_us = sector_us;
+    s_dev[drv].sleep = sleep;
+}
+
+int disk_sim_usb_max_busy(void)
+{
+    return __atomic_load_n(&s_iUsbMaxBusy, __ATOMIC_SEQ_CST);
+}
+
+int disk_sim_peek(int drv, uint32_t sector, void *buf)
+{
+    return sim_rw(&s_dev[drv], buf, sector, 1, 0);
+}
+
+int disk_sim_poke(int drv, uint32_t sector, const void *buf)
+{
+    return sim_rw(&s_dev[drv], (uint8_t *)(uintptr_t)buf, sector, 1, 1);
+}
+
+disk_sim_stat_t *disk_sim_stat(int drv)
+{
+    return &s_dev[drv].stat;
+}
+
+void disk_sim_reset_stat(void)
+{
+    int i;
+
+    for (i = 0; i < DISK_SIM_DRIVES; i++)
+        memset(&s_dev[i].stat, 0, sizeof(s_dev[i].stat));
+    s_iUsbMaxBusy = 0;
+}
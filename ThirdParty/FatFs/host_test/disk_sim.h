@@ -0,0 +1,53 @@
+/*
+ * Simulated SD cards (SDH0/SDH1) and USB mass storage drives for the host
+ * build of diskio.c. Every device is backed by a disk image file.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef DISK_SIM_H
+#define DISK_SIM_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t reads;         /* read calls */
+    uint32_t writes;        /* write calls */
+    uint32_t wr_sectors;    /* sectors written */
+    uint32_t erases;        /* SDH_Erase calls */
+    uint32_t resets;        /* usbh_umas_reset_disk calls */
+    uint32_t max_count;     /* most sectors in one call */
+    uint32_t unaligned;     /* SDH calls with a buffer the DMA cannot take */
+    uint64_t busy_us;       /* transfer time, see disk_sim_latency() */
+    const void *last_buf;   /* buffer of the last read/write call */
+} disk_sim_stat_t;
+
+/* Attach an SD card to SDH port 0/1. With sectors != 0 the image is
+ * created (or truncated) to that size, otherwise its size is used. */
+int  disk_sim_sd_attach(int port, const char *image, uint32_t sectors);
+void disk_sim_sd_detach(int port);
+void disk_sim_sd_remove(int port, int removed);     /* card pulled out */
+
+int  disk_sim_usb_attach(int drv, const char *image, uint32_t sectors);
+void disk_sim_usb_detach(int drv);
+void disk_sim_usb_fail(int drv, int n);             /* fail next n transfers */
+
+/* Devices are indexed by FatFs drive number: SDH port n is drive n. */
+#define DISK_SIM_DRIVES     10
+
+/* Time a transfer takes: cmd_us plus sector_us per sector, 0 for none.
+ * It is counted in busy_us, and with sleep also spent in real time. */
+void disk_sim_latency(int drv, uint32_t cmd_us, uint32_t sector_us, int sleep);
+
+/* Most usbh_umas_* transfers in progress at once since the last reset */
+int  disk_sim_usb_max_busy(void);
+
+/* Read or write one sector of the image, bypassing the simulated
+ * controller: what the card holds, or another card put in the slot */
+int  disk_sim_peek(int drv, uint32_t sector, void *buf);
+int  disk_sim_poke(int drv, uint32_t sector, const void *buf);
+
+disk_sim_stat_t *disk_sim_stat(int drv);
+void disk_sim_reset_stat(void);
+
+#endif /* DISK_SIM_H */
@@ -0,0 +1,29 @@
+/*
+ * FreeRTOS.h for the host build of FatFs with FF_FS_REENTRANT.
+ *
+ * Only what ffsystem.c and diskio.c use, on top of pthreads: mutexes that
+ * time out in ticks of 1 ms, and a scheduler lock that keeps the other
+ * ff_sys_lock() sections out. freertos_sim.c has the implementation.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef FREERTOS_SIM_H
+#define FREERTOS_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE         ((BaseType_t)0)
+#define pdTRUE          ((BaseType_t)1)
+
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+#define configSUPPORT_STATIC_ALLOCATION     0
+
+/* Mutexes alive, to check that nothing is created twice or leaked */
+int freertos_sim_mutexes(void);
+
+#endif /* FREERTOS_SIM_H */
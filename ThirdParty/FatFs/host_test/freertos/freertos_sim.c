@@ -0,0 +1,85 @@
+/*
+ * FreeRTOS mutex and scheduler lock API over pthreads, see FreeRTOS.h.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+struct sim_mutex
+{
+    pthread_mutex_t mutex;
+};
+
+static pthread_mutex_t s_sched = PTHREAD_MUTEX_INITIALIZER;
+static int s_iMutexes;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t m = malloc(sizeof(*m));
+
+    if (m == NULL)
+        return NULL;
+    pthread_mutex_init(&m->mutex, NULL);
+    __atomic_add_fetch(&s_iMutexes, 1, __ATOMIC_SEQ_CST);
+    return m;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+    pthread_mutex_destroy(&xSemaphore->mutex);
+    free(xSemaphore);
+    __atomic_sub_fetch(&s_iMutexes, 1, __ATOMIC_SEQ_CST);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += xTicksToWait / 1000;
+    ts.tv_nsec += (long)(xTicksToWait % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return (pthread_mutex_timedlock(&xSemaphore->mutex, &ts) == 0) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    return (pthread_mutex_unlock(&xSemaphore->mutex) == 0) ? pdTRUE : pdFALSE;
+}
+
+void vTaskSuspendAll(void)
+{
+    pthread_mutex_lock(&s_sched);
+}
+
+BaseType_t xTaskResumeAll(void)
+{
+    pthread_mutex_unlock(&s_sched);
+    return pdFALSE;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    static struct timespec t0;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if ((t0.tv_sec == 0) && (t0.tv_nsec == 0))
+        t0 = ts;
+    return (TickType_t)((ts.tv_sec - t0.tv_sec) * 1000 + (ts.tv_nsec - t0.tv_nsec) / 1000000);
+}
+
+int freertos_sim_mutexes(void)
+{
+    return __atomic_load_n(&s_iMutexes, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,18 @@
+/*
+ * semphr.h for the host build, see FreeRTOS.h.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef FREERTOS_SIM_SEMPHR_H
+#define FREERTOS_SIM_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+typedef struct sim_mutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
+
+#endif /* FREERTOS_SIM_SEMPHR_H */
@@ -0,0 +1,19 @@
+/*
+ * task.h for the host build, see FreeRTOS.h.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef FREERTOS_SIM_TASK_H
+#define FREERTOS_SIM_TASK_H
+
+#include "FreeRTOS.h"
+
+/* Host threads keep running: only other suspend sections are held off */
+void vTaskSuspendAll(void);
+BaseType_t xTaskResumeAll(void);
+
+/* Ticks of 1 ms since the first call */
+#define portTICK_PERIOD_MS  ((TickType_t)1)
+TickType_t xTaskGetTickCount(void);
+
+#endif /* FREERTOS_SIM_TASK_H */
@@ -0,0 +1,373 @@
+/*
+ * Host tests for the SD write-back cache in source/diskio.c, and the SD
+ * write count of an MP3 recorder style append with and without it.
+ *
+ * Built twice: test_cache with DISKIO_CACHE_SECTORS from the Makefile and
+ * DISKIO_CACHE_TICK() on g_u32SimTick in ms, test_nocache without the
+ * cache. The append writes 288 byte frames, a 64 kbps MP3 stream at
+ * 16 kHz, one every 36 ms of simulated time.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "disk_sim.h"
+
+#define DRV             0
+#define IMAGE_SECTORS   (64UL * 1024 * 1024 / 512)
+
+#define FRAME_BYTES     288
+#define FRAME_MS        36
+#define APPEND_BYTES    (2UL * 1024 * 1024)
+
+#ifndef DISKIO_CACHE_SECTORS
+#define DISKIO_CACHE_SECTORS    0
+#endif
+
+extern uint32_t g_u32SimTick;
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+static uint32_t s_au32Work[FF_MAX_SS];
+
+DWORD get_fattime(void)
+{
+    return ((DWORD)(2023 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
+
+static void fill(uint8_t *p, size_t len, uint32_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        p[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+static disk_sim_stat_t *stat(void)
+{
+    return disk_sim_stat(DRV);
+}
+
+#if DISKIO_CACHE_SECTORS
+
+#define SETS    (DISKIO_CACHE_SECTORS / DISKIO_CACHE_WAYS)
+
+static uint32_t s_au32Buf[2][16 * 512 / 4 + 1];
+
+static int on_card(DWORD sector, const uint8_t *data)
+{
+    uint8_t sec[512];
+
+    return (disk_sim_peek(DRV, sector, sec) == 0) && (memcmp(sec, data, 512) == 0);
+}
+
+/* Single sector writes stay in the cache until CTRL_SYNC, then go out in
+ * runs that end only where the set index wraps */
+static void test_write_back(void)
+{
+    uint8_t *wr = (uint8_t *)s_au32Buf[0], *rd = (uint8_t *)s_au32Buf[1] + 3;
+    uint8_t zero[512];
+    DWORD base = 100 * SETS + SETS / 2;
+    UINT i;
+    int ok = 1;
+
+    memset(zero, 0, sizeof(zero));
+    fill(wr, 16 * 512, 1);
+    disk_sim_reset_stat();
+
+    /* odd buffer: the cache copies, the card only sees its own lines */
+    for (i = 0; i < SETS; i++)
+        CHECK(disk_write(DRV, wr + i * 512 + 1, base + i, 1) == RES_OK);
+    CHECK(stat()->writes == 0);
+    CHECK(on_card(base, zero));
+
+    CHECK(disk_read(DRV, rd, base + 1, 2) == RES_OK);
+    CHECK(memcmp(rd, wr + 512 + 1, 2 * 512) == 0);
+    CHECK(stat()->reads == 0);
+
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(stat()->writes == 2);
+    CHECK(stat()->max_count == SETS / 2);
+    CHECK(stat()->unaligned == 0);
+    for (i = 0; i < SETS; i++)
+        ok &= on_card(base + i, wr + i * 512 + 1);
+    CHECK(ok);
+
+    /* nothing left to write */
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(stat()->writes == 2);
+}
+
+/* One more sector than ways in a set writes back the LRU line */
+static void test_evict(void)
+{
+    uint8_t *wr = (uint8_t *)s_au32Buf[0];
+    DWORD base = 200 * SETS + 3;
+    UINT i;
+    int ok = 1;
+
+    fill(wr, 16 * 512, 2);
+    disk_sim_reset_stat();
+
+    for (i = 0; i < DISKIO_CACHE_WAYS; i++)
+        CHECK(disk_write(DRV, wr + i * 512, base + i * SETS, 1) == RES_OK);
+    CHECK(stat()->writes == 0);
+
+    /* touch the first, the second becomes the LRU line */
+    CHECK(disk_read(DRV, (uint8_t *)s_au32Buf[1], base, 1) == RES_OK);
+    CHECK(disk_write(DRV, wr + i * 512, base + i * SETS, 1) == RES_OK);
+    CHECK(stat()->writes == 1);
+    CHECK(on_card(base + SETS, wr + 512));
+
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_OK);
+    for (i = 0; i <= DISKIO_CACHE_WAYS; i++)
+        ok &= on_card(base + i * SETS, wr + i * 512);
+    CHECK(ok);
+}
+
+/* Long transfers go to the card, consistent with dirty lines */
+static void test_bypass(void)
+{
+    uint8_t *wr = (uint8_t *)s_au32Buf[0], *rd = (uint8_t *)s_au32Buf[1];
+    uint8_t one[512];
+    DWORD base = 300 * SETS;
+
+    fill(wr, 16 * 512, 3);
+    fill(one, sizeof(one), 4);
+    CHECK(disk_write(DRV, wr, base, 16) == RES_OK);
+    disk_sim_reset_stat();
+
+    /* read merges the dirty line */
+    CHECK(disk_write(DRV, one, base + 5, 1) == RES_OK);
+    CHECK(disk_read(DRV, rd, base, 16) == RES_OK);
+    CHECK(stat()->reads == 1 && stat()->max_count == 16);
+    CHECK(memcmp(rd + 5 * 512, one, 512) == 0);
+    CHECK(memcmp(rd, wr, 5 * 512) == 0);
+    CHECK(memcmp(rd + 6 * 512, wr + 6 * 512, 10 * 512) == 0);
+
+    /* write replaces it */
+    CHECK(disk_write(DRV, wr, base, 16) == RES_OK);
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(stat()->writes == 1);
+    CHECK(on_card(base + 5, wr + 5 * 512));
+    CHECK(disk_read(DRV, rd, base + 5, 1) == RES_OK);
+    CHECK(memcmp(rd, wr + 5 * 512, 512) == 0);
+}
+
+static void test_trim(void)
+{
+    uint8_t one[512], zero[512];
+    DWORD range[2];
+
+    memset(zero, 0, sizeof(zero));
+    fill(one, sizeof(one), 5);
+    CHECK(disk_write(DRV, one, 400 * SETS, 1) == RES_OK);
+    disk_sim_reset_stat();
+
+    range[0] = 400 * SETS - 2;
+    range[1] = 400 * SETS + 2;
+    CHECK(disk_ioctl(DRV, CTRL_TRIM, range) == RES_OK);
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(stat()->erases == 1 && stat()->writes == 0);
+    CHECK(on_card(400 * SETS, zero));
+}
+
+/* Dirty lines are written back on the first call after they are
+ * DISKIO_CACHE_MAX_AGE old */
+static void test_age(void)
+{
+    uint8_t one[512];
+
+    fill(one, sizeof(one), 6);
+    g_u32SimTick = 5000;
+    CHECK(disk_write(DRV, one, 500 * SETS, 1) == RES_OK);
+    disk_sim_reset_stat();
+
+    g_u32SimTick += DISKIO_CACHE_MAX_AGE - 1;
+    CHECK(disk_read(DRV, (uint8_t *)s_au32Buf[1], 0, 1) == RES_OK);
+    CHECK(stat()->writes == 0);
+
+    g_u32SimTick++;
+    CHECK(disk_read(DRV, (uint8_t *)s_au32Buf[1], 0, 1) == RES_OK);
+    CHECK(stat()->writes == 1);
+    CHECK(on_card(500 * SETS, one));
+}
+
+/* With no further I/O, disk_cache_flush_aged() from a timer writes the
+ * lines back once they are DISKIO_CACHE_MAX_AGE old */
+static void test_flush_aged(void)
+{
+    uint8_t one[512];
+
+    fill(one, sizeof(one), 9);
+    g_u32SimTick = 20000;
+    CHECK(disk_write(DRV, one, 700 * SETS, 1) == RES_OK);
+    disk_sim_reset_stat();
+
+    g_u32SimTick += DISKIO_CACHE_MAX_AGE / 2;
+    CHECK(disk_cache_flush_aged() == RES_OK);
+    CHECK(stat()->writes == 0);
+
+    g_u32SimTick += DISKIO_CACHE_MAX_AGE / 2;
+    CHECK(disk_cache_flush_aged() == RES_OK);
+    CHECK(stat()->writes == 1);
+    CHECK(on_card(700 * SETS, one));
+
+    /* nothing left to do */
+    g_u32SimTick += DISKIO_CACHE_MAX_AGE;
+    CHECK(disk_cache_flush_aged() == RES_OK);
+    CHECK(stat()->writes == 1);
+}
+
+/* A card change drops the lines, clean and dirty, without writing them
+ * to the card that is in the slot now */
+static void test_media_change(void)
+{
+    uint8_t one[512], two[512];
+
+    fill(one, sizeof(one), 10);
+    fill(two, sizeof(two), 11);
+    CHECK(disk_write(DRV, one, 800 * SETS, 1) == RES_OK);
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(disk_read(DRV, (uint8_t *)s_au32Buf[1], 800 * SETS, 1) == RES_OK);
+    CHECK(disk_write(DRV, two, 800 * SETS + 1, 1) == RES_OK);
+
+    /* the card is swapped: the sectors change under the cache */
+    disk_sim_poke(DRV, 800 * SETS, two);
+    disk_media_change(DRV);
+    disk_sim_reset_stat();
+
+    g_u32SimTick += 10 * DISKIO_CACHE_MAX_AGE;
+    CHECK(disk_cache_flush_aged() == RES_OK);
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(stat()->writes == 0);
+    CHECK(disk_read(DRV, (uint8_t *)s_au32Buf[1], 800 * SETS, 1) == RES_OK);
+    CHECK(memcmp(s_au32Buf[1], two, 512) == 0);
+    CHECK(!on_card(800 * SETS + 1, two));
+}
+
+/* A failed write back keeps the data dirty */
+static void test_errors(void)
+{
+    uint8_t one[512];
+
+    fill(one, sizeof(one), 7);
+    CHECK(disk_write(DRV, one, 600 * SETS, 1) == RES_OK);
+
+    disk_sim_sd_remove(DRV, 1);
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_NOTRDY);
+    disk_sim_sd_remove(DRV, 0);
+
+    disk_sim_reset_stat();
+    CHECK(disk_ioctl(DRV, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(stat()->writes == 1);
+    CHECK(on_card(600 * SETS, one));
+}
+
+#endif /* DISKIO_CACHE_SECTORS */
+
+/* Append APPEND_BYTES in frames, f_sync every sync_ms (0: only f_close),
+ * and read the file back after a remount */
+static void append(const char *label, const char *name, uint32_t sync_ms)
+{
+    static uint8_t data[APPEND_BYTES];
+    static uint8_t back[APPEND_BYTES];
+    char path[24];
+    FATFS fs;
+    FIL fil;
+    uint32_t ofs, last_sync = 0, writes, sectors;
+    UINT bw, br;
+    int ok = 1;
+
+    fill(data, sizeof(data), 8);
+    snprintf(path, sizeof(path), "%u:/%s", DRV, name);
+
+    CHECK(f_mount(&fs, "0:", 1) == FR_OK);
+    g_u32SimTick = 0;
+    disk_sim_reset_stat();
+
+    CHECK(f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    for (ofs = 0; ofs < APPEND_BYTES; ofs += FRAME_BYTES)
+    {
+        UINT n = (APPEND_BYTES - ofs < FRAME_BYTES) ? APPEND_BYTES - ofs : FRAME_BYTES;
+
+        g_u32SimTick += FRAME_MS;
+        if ((f_write(&fil, data + ofs, n, &bw) != FR_OK) || (bw != n))
+            ok = 0;
+        if (sync_ms && (g_u32SimTick - last_sync >= sync_ms))
+        {
+            if (f_sync(&fil) != FR_OK)
+                ok = 0;
+            last_sync = g_u32SimTick;
+        }
+    }
+    CHECK(ok);
+    CHECK(f_close(&fil) == FR_OK);
+
+    writes = stat()->writes;
+    sectors = stat()->wr_sectors;
+    printf("%-28s %8u %10u %10.2f\n", label, (unsigned)writes, (unsigned)sectors,
+           (double)sectors / (writes ? writes : 1));
+
+    CHECK(f_mount(NULL, "0:", 0) == FR_OK);
+    CHECK(f_mount(&fs, "0:", 1) == FR_OK);
+    CHECK(f_open(&fil, path, FA_READ) == FR_OK);
+    CHECK(f_read(&fil, back, sizeof(back), &br) == FR_OK && br == sizeof(back));
+    CHECK(f_close(&fil) == FR_OK);
+    CHECK(memcmp(back, data, sizeof(data)) == 0);
+    CHECK(f_mount(NULL, "0:", 0) == FR_OK);
+}
+
+int main(void)
+{
+    if (disk_sim_sd_attach(DRV, DISKIO_CACHE_SECTORS ? "cache0.img" : "nocache0.img", IMAGE_SECTORS) != 0)
+    {
+        printf("cannot create disk image\n");
+        return 1;
+    }
+
+#if DISKIO_CACHE_SECTORS
+    test_write_back();
+    test_evict();
+    test_bypass();
+    test_trim();
+    test_age();
+    test_flush_aged();
+    test_media_change();
+    test_errors();
+#endif
+
+    CHECK(f_mkfs("0:", FM_ANY, 0, s_au32Work, sizeof(s_au32Work)) == FR_OK);
+
+#if DISKIO_CACHE_SECTORS
+    printf("\nSD write-back cache: %u sectors, %u ways, write back after %u ms\n",
+           DISKIO_CACHE_SECTORS, DISKIO_CACHE_WAYS, DISKIO_CACHE_MAX_AGE);
+#else
+    printf("\nno SD cache\n");
+#endif
+    printf("%-28s %8s %10s %10s\n", "2 MB in 288 byte frames", "SD writes", "sectors", "per write");
+    append("f_close only", "REC.MP3", 0);
+    append("f_sync every second", "REC_SYNC.MP3", 1000);
+    printf("\n");
+
+    disk_sim_sd_detach(DRV);
+
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
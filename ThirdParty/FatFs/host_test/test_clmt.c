@@ -0,0 +1,286 @@
+/*
+ * Host tests for source/ffclmt.c, and the seek cost with and without a
+ * cluster link map.
+ *
+ * Files are written interleaved with a filler file on a volume of 4 KB
+ * clusters, so every 64 KB of them is a separate fragment. The cost of a
+ * seek is counted in disk reads of a 512 byte f_read() right after it:
+ * exactly one without FAT lookups, plus one per FAT sector the normal seek
+ * has to walk through.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ff.h"
+#include "ffclmt.h"
+#include "diskio.h"
+#include "disk_sim.h"
+
+#define DRV             0
+#define IMAGE_SECTORS   (128UL * 1024 * 1024 / 512)
+#define CLUSTER         4096
+#define RUN             (64 * 1024)     /* fragment length */
+#define SEEKS           64
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+static uint32_t s_au32Work[FF_MAX_SS];
+static uint32_t s_au32Buf[RUN / 4];
+
+DWORD get_fattime(void)
+{
+    return ((DWORD)(2023 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
+
+/* Content of byte ofs of a test file, so any read can be checked */
+static uint8_t pattern(uint32_t ofs)
+{
+    uint32_t x = (ofs >> 2) * 2654435761u;
+
+    return (uint8_t)(x >> (8 * (ofs & 3)));
+}
+
+static void fill(uint8_t *p, uint32_t ofs, UINT len)
+{
+    UINT i;
+
+    for (i = 0; i < len; i++)
+        p[i] = pattern(ofs + i);
+}
+
+static int verify(const uint8_t *p, uint32_t ofs, UINT len)
+{
+    UINT i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (p[i] != pattern(ofs + i))
+            return 0;
+    }
+    return 1;
+}
+
+/* Write path in RUN sized pieces, each followed by one of the filler */
+static void write_fragmented(const char *path, uint32_t size)
+{
+    uint8_t *buf = (uint8_t *)s_au32Buf;
+    FIL fil, pad;
+    uint32_t ofs;
+    UINT n, bw;
+
+    CHECK(f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    CHECK(f_open(&pad, "0:/PAD.BIN", FA_OPEN_APPEND | FA_WRITE) == FR_OK);
+    for (ofs = 0; ofs < size; ofs += n)
+    {
+        n = (size - ofs < RUN) ? size - ofs : RUN;
+        fill(buf, ofs, n);
+        CHECK(f_write(&fil, buf, n, &bw) == FR_OK && bw == n);
+        CHECK(f_write(&pad, buf, CLUSTER, &bw) == FR_OK && bw == CLUSTER);
+    }
+    CHECK(f_close(&pad) == FR_OK);
+    CHECK(f_close(&fil) == FR_OK);
+}
+
+static uint32_t s_seed = 1;
+
+static uint32_t next_rand(void)
+{
+    s_seed = s_seed * 1103515245u + 12345u;
+    return s_seed >> 8;
+}
+
+/* SEEKS seeks to sector aligned offsets, each followed by a one sector
+ * read. Returns the disk reads taken. */
+static uint32_t seek_reads(FIL *fp, uint32_t size)
+{
+    uint8_t sec[512];
+    uint32_t i, ofs, reads;
+    UINT br;
+    int ok = 1;
+
+    disk_sim_reset_stat();
+    for (i = 0; i < SEEKS; i++)
+    {
+        ofs = (next_rand() % (size / 512)) * 512;
+        if ((f_lseek(fp, ofs) != FR_OK) || (f_read(fp, sec, sizeof(sec), &br) != FR_OK) ||
+                (br != sizeof(sec)) || !verify(sec, ofs, br))
+            ok = 0;
+    }
+    reads = disk_sim_stat(DRV)->reads;
+    CHECK(ok);
+
+    return reads;
+}
+
+/* Unaligned seeks and reads across fragment boundaries */
+static void test_read_back(FIL *fp, uint32_t size)
+{
+    uint8_t *buf = (uint8_t *)s_au32Buf;
+    uint32_t ofs;
+    UINT br;
+    int ok = 1;
+
+    for (ofs = RUN - 777; ofs < size; ofs += 3 * RUN + 13)
+    {
+        UINT n = (size - ofs < 2000) ? size - ofs : 2000;
+
+        if ((f_lseek(fp, ofs) != FR_OK) || (f_read(fp, buf + 1, n, &br) != FR_OK) ||
+                (br != n) || !verify(buf + 1, ofs, br))
+            ok = 0;
+    }
+    CHECK(ok);
+
+    /* a fast seek is clipped at the end of file */
+    CHECK(f_lseek(fp, size + 100) == FR_OK && f_tell(fp) == size);
+    CHECK(f_read(fp, buf, 1, &br) == FR_OK && br == 0);
+}
+
+static void test_attach(void)
+{
+    const uint32_t size = 10 * RUN + 100;      /* 11 fragments */
+    DWORD tbl[FF_CLMT_ITEMS(11)];
+    FIL fil;
+    UINT br;
+
+    write_fragmented("0:/ATTACH.BIN", size);
+
+    CHECK(f_open(&fil, "0:/ATTACH.BIN", FA_READ) == FR_OK);
+
+    /* too small: required size reported, normal seek still works */
+    CHECK(f_clmt_attach(&fil, tbl, FF_CLMT_ITEMS(10)) == FR_NOT_ENOUGH_CORE);
+    CHECK(tbl[0] == FF_CLMT_ITEMS(11));
+    CHECK(fil.cltbl == NULL);
+    test_read_back(&fil, size);
+
+    CHECK(f_clmt_attach(&fil, tbl, FF_CLMT_ITEMS(0) - 1) == FR_INVALID_PARAMETER);
+    CHECK(fil.cltbl == NULL);
+
+    CHECK(f_clmt_attach(&fil, tbl, FF_CLMT_ITEMS(11)) == FR_OK);
+    CHECK(fil.cltbl == tbl);
+    CHECK(tbl[0] == FF_CLMT_ITEMS(11));
+    CHECK(tbl[1] == RUN / CLUSTER);            /* first fragment length */
+    CHECK(tbl[FF_CLMT_ITEMS(11) - 1] == 0);
+    test_read_back(&fil, size);
+
+    f_clmt_detach(&fil);
+    CHECK(fil.cltbl == NULL);
+    CHECK(f_lseek(&fil, 5 * RUN) == FR_OK);
+    CHECK(f_read(&fil, (uint8_t *)s_au32Buf, 100, &br) == FR_OK && br == 100);
+    CHECK(verify((uint8_t *)s_au32Buf, 5 * RUN, 100));
+    CHECK(f_close(&fil) == FR_OK);
+
+    /* a table cannot follow a growing file */
+    CHECK(f_open(&fil, "0:/ATTACH.BIN", FA_READ | FA_WRITE) == FR_OK);
+    CHECK(f_clmt_attach(&fil, tbl, FF_CLMT_ITEMS(11)) == FR_DENIED);
+    CHECK(fil.cltbl == NULL);
+    CHECK(f_close(&fil) == FR_OK);
+}
+
+static void test_alloc(void)
+{
+    FIL fil;
+
+    /* fits the probe table: copied */
+    write_fragmented("0:/SMALL.BIN", 3 * RUN);
+    CHECK(f_open(&fil, "0:/SMALL.BIN", FA_READ) == FR_OK);
+    CHECK(f_clmt_alloc(&fil, 0) == FR_OK);
+    CHECK(fil.cltbl != NULL && fil.cltbl[0] == FF_CLMT_ITEMS(3));
+    test_read_back(&fil, 3 * RUN);
+    CHECK(f_close(&fil) == FR_OK);
+    f_clmt_free(&fil);
+    CHECK(fil.cltbl == NULL);
+
+    /* bigger than the probe: built again in the heap block */
+    write_fragmented("0:/LARGE.BIN", 40 * RUN);
+    CHECK(f_open(&fil, "0:/LARGE.BIN", FA_READ) == FR_OK);
+    CHECK(f_clmt_alloc(&fil, 0) == FR_OK);
+    CHECK(fil.cltbl != NULL && fil.cltbl[0] == FF_CLMT_ITEMS(40));
+    test_read_back(&fil, 40 * RUN);
+    f_clmt_free(&fil);
+
+    /* over the limit: normal seek */
+    CHECK(f_clmt_alloc(&fil, FF_CLMT_ITEMS(39)) == FR_NOT_ENOUGH_CORE);
+    CHECK(fil.cltbl == NULL);
+    test_read_back(&fil, 40 * RUN);
+    CHECK(f_close(&fil) == FR_OK);
+
+    /* an empty file has an empty table */
+    CHECK(f_open(&fil, "0:/EMPTY.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    CHECK(f_close(&fil) == FR_OK);
+    CHECK(f_open(&fil, "0:/EMPTY.BIN", FA_READ) == FR_OK);
+    CHECK(f_clmt_alloc(&fil, 0) == FR_OK);
+    CHECK(fil.cltbl != NULL && fil.cltbl[0] == FF_CLMT_ITEMS(0));
+    CHECK(f_lseek(&fil, 1000) == FR_OK && f_tell(&fil) == 0);
+    CHECK(f_close(&fil) == FR_OK);
+    f_clmt_free(&fil);
+}
+
+/* Seek cost against file size */
+static void bench(void)
+{
+    static const uint32_t size_kb[] = { 256, 1024, 4096, 16384 };
+    FIL fil;
+    uint32_t i, normal, fast, size;
+
+    printf("\n%10s %6s %14s %14s\n", "file size", "frags", "reads/seek", "with CLMT");
+    for (i = 0; i < sizeof(size_kb) / sizeof(size_kb[0]); i++)
+    {
+        size = size_kb[i] * 1024;
+        write_fragmented("0:/BENCH.BIN", size);
+        CHECK(f_open(&fil, "0:/BENCH.BIN", FA_READ) == FR_OK);
+
+        s_seed = i + 1;
+        normal = seek_reads(&fil, size);
+
+        CHECK(f_clmt_alloc(&fil, FF_CLMT_ITEMS(size / RUN)) == FR_OK);
+        s_seed = i + 1;
+        fast = seek_reads(&fil, size);
+        f_clmt_free(&fil);
+        CHECK(f_close(&fil) == FR_OK);
+
+        /* one data read per seek, no FAT access */
+        CHECK(fast == SEEKS);
+        CHECK(normal >= fast);
+        printf("%8u KB %6u %14.2f %14.2f\n", (unsigned)size_kb[i], (unsigned)(size / RUN),
+               (double)normal / SEEKS, (double)fast / SEEKS);
+
+        CHECK(f_unlink("0:/BENCH.BIN") == FR_OK);
+    }
+    printf("\n");
+}
+
+int main(void)
+{
+    FATFS fs;
+
+    if (disk_sim_sd_attach(DRV, "clmt0.img", IMAGE_SECTORS) != 0)
+    {
+        printf("cannot create disk image\n");
+        return 1;
+    }
+
+    CHECK(f_mkfs("0:", FM_FAT, CLUSTER, s_au32Work, sizeof(s_au32Work)) == FR_OK);
+    CHECK(f_mount(&fs, "0:", 1) == FR_OK);
+
+    test_attach();
+    test_alloc();
+    bench();
+
+    CHECK(f_mount(NULL, "0:", 0) == FR_OK);
+    disk_sim_sd_detach(DRV);
+
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
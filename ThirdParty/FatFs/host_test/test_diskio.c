@@ -0,0 +1,286 @@
+/*
+ * Host tests for source/diskio.c on simulated SD and USB disks.
+ *
+ * Drive 0 is an SD card on SDH0, drive 3 a USB disk, both backed by image
+ * files in the current directory. The tests go through the disk_* API
+ * directly and through FatFs on freshly formatted volumes.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "disk_sim.h"
+
+#define SD_DRV          0
+#define USB_DRV         3
+#define IMAGE_SECTORS   (64UL * 1024 * 1024 / 512)
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+/* Word aligned, with room to offset into it */
+static uint32_t s_au32Buf[2][16 * 512 / 4 + 1];
+static uint32_t s_au32Work[FF_MAX_SS];
+
+DWORD get_fattime(void)
+{
+    return ((DWORD)(2023 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
+
+static void fill(uint8_t *p, size_t len, uint32_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        p[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+static void test_sd_aligned(void)
+{
+    uint8_t *wr = (uint8_t *)s_au32Buf[0], *rd = (uint8_t *)s_au32Buf[1];
+    uint8_t sec[512];
+
+    fill(wr, 16 * 512, 1);
+    disk_sim_reset_stat();
+
+    /* all 16 sectors in one call, straight from the caller's buffer */
+    CHECK(disk_write(SD_DRV, wr, 100, 16) == RES_OK);
+    CHECK(disk_sim_stat(SD_DRV)->writes == 1);
+    CHECK(disk_sim_stat(SD_DRV)->max_count == 16);
+    CHECK(disk_sim_stat(SD_DRV)->last_buf == wr);
+
+    memset(rd, 0, 16 * 512);
+    CHECK(disk_read(SD_DRV, rd, 100, 16) == RES_OK);
+    CHECK(disk_sim_stat(SD_DRV)->reads == 1);
+    CHECK(disk_sim_stat(SD_DRV)->last_buf == rd);
+    CHECK(memcmp(wr, rd, 16 * 512) == 0);
+
+    CHECK(disk_sim_peek(SD_DRV, 115, sec) == 0);
+    CHECK(memcmp(sec, wr + 15 * 512, 512) == 0);
+    CHECK(disk_sim_stat(SD_DRV)->unaligned == 0);
+}
+
+static void test_sd_unaligned(void)
+{
+    uint8_t *wr = (uint8_t *)s_au32Buf[0] + 1, *rd = (uint8_t *)s_au32Buf[1] + 3;
+    uint8_t sec[512];
+    int i;
+
+    fill(wr, 7 * 512, 2);
+    disk_sim_reset_stat();
+
+    CHECK(disk_write(SD_DRV, wr, 200, 7) == RES_OK);
+    CHECK(disk_sim_stat(SD_DRV)->unaligned == 0);
+    CHECK(disk_sim_stat(SD_DRV)->max_count <= DISKIO_BOUNCE_SECTORS);
+    CHECK(disk_sim_stat(SD_DRV)->writes == (7 + DISKIO_BOUNCE_SECTORS - 1) / DISKIO_BOUNCE_SECTORS);
+
+    for (i = 0; i < 7; i++)
+    {
+        CHECK(disk_sim_peek(SD_DRV, 200 + i, sec) == 0);
+        CHECK(memcmp(sec, wr + i * 512, 512) == 0);
+    }
+
+    memset(rd, 0, 7 * 512);
+    CHECK(disk_read(SD_DRV, rd, 200, 7) == RES_OK);
+    CHECK(disk_sim_stat(SD_DRV)->unaligned == 0);
+    CHECK(memcmp(wr, rd, 7 * 512) == 0);
+}
+
+static void test_sd_ioctl(void)
+{
+    DWORD dw, range[2];
+    uint8_t sec[512], zero[512];
+    union
+    {
+        WORD w;
+        uint8_t guard[4];
+    } ss;
+
+    CHECK(disk_ioctl(SD_DRV, GET_SECTOR_COUNT, &dw) == RES_OK);
+    CHECK(dw == IMAGE_SECTORS);
+
+    memset(ss.guard, 0xA5, sizeof(ss.guard));
+    CHECK(disk_ioctl(SD_DRV, GET_SECTOR_SIZE, &ss.w) == RES_OK);
+    CHECK(ss.w == 512);
+    CHECK(ss.guard[2] == 0xA5 && ss.guard[3] == 0xA5);
+
+    CHECK(disk_ioctl(SD_DRV, GET_BLOCK_SIZE, &dw) == RES_OK);
+    CHECK(dw == DISKIO_SDH_BLOCK_SIZE);
+
+    CHECK(disk_ioctl(SD_DRV, CTRL_SYNC, NULL) == RES_OK);
+
+    /* sectors 100..115 hold data from test_sd_aligned */
+    memset(zero, 0, sizeof(zero));
+    range[0] = 102;
+    range[1] = 104;
+    disk_sim_reset_stat();
+    CHECK(disk_ioctl(SD_DRV, CTRL_TRIM, range) == RES_OK);
+    CHECK(disk_sim_stat(SD_DRV)->erases == 1);
+    CHECK(disk_sim_peek(SD_DRV, 102, sec) == 0 && memcmp(sec, zero, 512) == 0);
+    CHECK(disk_sim_peek(SD_DRV, 104, sec) == 0 && memcmp(sec, zero, 512) == 0);
+    CHECK(disk_sim_peek(SD_DRV, 105, sec) == 0 && memcmp(sec, zero, 512) != 0);
+    CHECK(disk_sim_peek(SD_DRV, 101, sec) == 0 && memcmp(sec, zero, 512) != 0);
+
+    range[0] = 10;
+    range[1] = 9;
+    CHECK(disk_ioctl(SD_DRV, CTRL_TRIM, range) == RES_PARERR);
+    CHECK(disk_ioctl(SD_DRV, CTRL_EJECT, NULL) == RES_PARERR);
+}
+
+static void test_sd_errors(void)
+{
+    uint8_t *buf = (uint8_t *)s_au32Buf[0];
+
+    CHECK(disk_status(SD_DRV) == 0);
+    CHECK(disk_status(1) == STA_NOINIT);    /* nothing on SDH1 */
+    CHECK(disk_status(2) == STA_NOINIT);    /* not mapped */
+    CHECK(disk_read(2, buf, 0, 1) == RES_PARERR);
+    CHECK(disk_read(SD_DRV, buf, 0, 0) == RES_PARERR);
+
+    disk_sim_sd_remove(SD_DRV, 1);
+    CHECK(disk_read(SD_DRV, buf, 0, 1) == RES_NOTRDY);
+    CHECK(disk_write(SD_DRV, buf + 1, 0, 3) == RES_NOTRDY);
+    disk_sim_sd_remove(SD_DRV, 0);
+
+    /* beyond the end of the card */
+    CHECK(disk_read(SD_DRV, buf, IMAGE_SECTORS - 1, 2) == RES_ERROR);
+}
+
+static void test_usb(void)
+{
+    uint8_t *wr = (uint8_t *)s_au32Buf[0] + 1, *rd = (uint8_t *)s_au32Buf[1] + 2;
+    DWORD dw;
+    union
+    {
+        WORD w;
+        uint8_t guard[4];
+    } ss;
+
+    CHECK(disk_initialize(USB_DRV) == 0);
+    CHECK(disk_status(USB_DRV + 1) == (STA_NOINIT | STA_NODISK));
+
+    /* any alignment and count goes straight through */
+    fill(wr, 12 * 512, 3);
+    disk_sim_reset_stat();
+    CHECK(disk_write(USB_DRV, wr, 50, 12) == RES_OK);
+    CHECK(disk_sim_stat(USB_DRV)->writes == 1);
+    CHECK(disk_sim_stat(USB_DRV)->max_count == 12);
+    CHECK(disk_sim_stat(USB_DRV)->last_buf == wr);
+    CHECK(disk_read(USB_DRV, rd, 50, 12) == RES_OK);
+    CHECK(disk_sim_stat(USB_DRV)->last_buf == rd);
+    CHECK(memcmp(wr, rd, 12 * 512) == 0);
+
+    /* one failure is retried after a reset, two are not */
+    disk_sim_reset_stat();
+    disk_sim_usb_fail(USB_DRV, 1);
+    CHECK(disk_read(USB_DRV, rd, 50, 1) == RES_OK);
+    CHECK(disk_sim_stat(USB_DRV)->resets == 1);
+    disk_sim_usb_fail(USB_DRV, 2);
+    CHECK(disk_write(USB_DRV, wr, 50, 1) == RES_ERROR);
+    CHECK(disk_sim_stat(USB_DRV)->resets == 2);
+    CHECK(disk_read(USB_DRV + 1, rd, 0, 1) == RES_NOTRDY);
+
+    CHECK(disk_ioctl(USB_DRV, GET_SECTOR_COUNT, &dw) == RES_OK);
+    CHECK(dw == IMAGE_SECTORS);
+    memset(ss.guard, 0xA5, sizeof(ss.guard));
+    CHECK(disk_ioctl(USB_DRV, GET_SECTOR_SIZE, &ss.w) == RES_OK);
+    CHECK(ss.w == 512);
+    CHECK(ss.guard[2] == 0xA5 && ss.guard[3] == 0xA5);
+    CHECK(disk_ioctl(USB_DRV, GET_BLOCK_SIZE, &dw) == RES_OK);
+    CHECK(dw == 1);
+    CHECK(disk_ioctl(USB_DRV, CTRL_SYNC, NULL) == RES_OK);
+    CHECK(disk_ioctl(USB_DRV + 1, GET_SECTOR_COUNT, &dw) == RES_NOTRDY);
+}
+
+/* Format, write a file in odd sized pieces from an unaligned buffer,
+ * remount and read it back. */
+static void test_fatfs(BYTE drv)
+{
+    static uint8_t data[300 * 1024 + 3];
+    static uint8_t back[sizeof(data)];
+    const uint8_t *src = data + 3;
+    const UINT len = sizeof(data) - 3;
+    const UINT piece[] = { 1, 511, 512, 513, 4096, 30000, 65536 };
+    char path[16];
+    FATFS fs;
+    FIL fil;
+    UINT done, n, bw, br, i;
+
+    snprintf(path, sizeof(path), "%u:", drv);
+    CHECK(f_mkfs(path, FM_ANY, 0, s_au32Work, sizeof(s_au32Work)) == FR_OK);
+    CHECK(f_mount(&fs, path, 1) == FR_OK);
+
+    fill(data, sizeof(data), drv + 10u);
+    disk_sim_reset_stat();
+
+    snprintf(path, sizeof(path), "%u:/DATA.BIN", drv);
+    CHECK(f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    for (done = 0, i = 0; done < len; done += bw, i++)
+    {
+        n = piece[i % (sizeof(piece) / sizeof(piece[0]))];
+        if (n > len - done)
+            n = len - done;
+        CHECK(f_write(&fil, src + done, n, &bw) == FR_OK && bw == n);
+        if (bw != n)
+            break;
+    }
+    CHECK(f_close(&fil) == FR_OK);
+
+    /* the large pieces went down as multi-sector transfers */
+    CHECK(disk_sim_stat(drv)->max_count > 1);
+    CHECK(disk_sim_stat(drv)->unaligned == 0);
+
+    snprintf(path, sizeof(path), "%u:", drv);
+    CHECK(f_mount(NULL, path, 0) == FR_OK);
+    CHECK(f_mount(&fs, path, 1) == FR_OK);
+
+    snprintf(path, sizeof(path), "%u:/DATA.BIN", drv);
+    memset(back, 0, sizeof(back));
+    CHECK(f_open(&fil, path, FA_READ) == FR_OK);
+    CHECK(f_size(&fil) == len);
+    CHECK(f_read(&fil, back + 1, len, &br) == FR_OK && br == len);
+    CHECK(f_close(&fil) == FR_OK);
+    CHECK(memcmp(back + 1, src, len) == 0);
+
+    snprintf(path, sizeof(path), "%u:", drv);
+    CHECK(f_mount(NULL, path, 0) == FR_OK);
+}
+
+int main(void)
+{
+    if ((disk_sim_sd_attach(SD_DRV, "sd0.img", IMAGE_SECTORS) != 0) ||
+            (disk_sim_usb_attach(USB_DRV, "usb3.img", IMAGE_SECTORS) != 0))
+    {
+        printf("cannot create disk images\n");
+        return 1;
+    }
+
+    test_sd_aligned();
+    test_sd_unaligned();
+    test_sd_ioctl();
+    test_sd_errors();
+    test_usb();
+    test_fatfs(SD_DRV);
+    test_fatfs(USB_DRV);
+
+    disk_sim_sd_detach(SD_DRV);
+    disk_sim_usb_detach(USB_DRV);
+
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,483 @@
+/*
+ * Host tests for FatFs built with FF_FS_REENTRANT and FF_FS_LOCK, over the
+ * FreeRTOS binding of source/ffsystem.c and the API shims in freertos/.
+ *
+ * Drive 0 is an SD card, drives 3 and 4 are USB disks. Threads stand in
+ * for tasks. The benchmark gives the simulated disks transfer times and
+ * runs a writer/reader on SD and one on USB at the same time, first with
+ * one application lock over all FatFs calls (what a build without
+ * FF_FS_REENTRANT needs), then with the per-volume locks of FatFs.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "disk_sim.h"
+
+#define IMAGE_SECTORS   (64UL * 1024 * 1024 / 512)
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        __atomic_add_fetch(&s_checks, 1, __ATOMIC_SEQ_CST);                 \
+        if (!(c)) {                                                         \
+            __atomic_add_fetch(&s_failures, 1, __ATOMIC_SEQ_CST);           \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+static const char *const s_apcVol[] = { "0:", "3:", "4:" };
+static FATFS s_asFs[3];
+static uint32_t s_au32Work[FF_MAX_SS];
+
+DWORD get_fattime(void)
+{
+    return ((DWORD)(2023 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Content of byte ofs of a test file, different for every seed */
+static uint8_t pattern(uint32_t ofs, uint32_t seed)
+{
+    uint32_t x = ((ofs >> 2) ^ seed) * 2654435761u;
+
+    return (uint8_t)(x >> (8 * (ofs & 3)));
+}
+
+/*-----------------------------------------------------------------------*/
+/* A task writing a file and reading it back                             */
+/*-----------------------------------------------------------------------*/
+
+typedef struct
+{
+    const char *path;
+    uint32_t size;
+    UINT chunk;
+    uint32_t seed;
+    pthread_mutex_t *app_lock;  /* held over every FatFs call, or NULL */
+    int ok;
+    double secs;
+} job_t;
+
+static void app_lock(job_t *j)
+{
+    if (j->app_lock)
+        pthread_mutex_lock(j->app_lock);
+}
+
+static void app_unlock(job_t *j)
+{
+    if (j->app_lock)
+        pthread_mutex_unlock(j->app_lock);
+}
+
+static void *write_verify(void *arg)
+{
+    job_t *j = arg;
+    uint8_t *buf = malloc(j->chunk);
+    double t0 = now();
+    uint32_t ofs;
+    UINT i, n, bw;
+    FRESULT res;
+    FIL fil;
+
+    j->ok = (buf != NULL);
+
+    app_lock(j);
+    res = f_open(&fil, j->path, FA_CREATE_ALWAYS | FA_WRITE);
+    app_unlock(j);
+    j->ok &= (res == FR_OK);
+    for (ofs = 0; j->ok && (ofs < j->size); ofs += n)
+    {
+        n = (j->size - ofs < j->chunk) ? j->size - ofs : j->chunk;
+        for (i = 0; i < n; i++)
+            buf[i] = pattern(ofs + i, j->seed);
+        app_lock(j);
+        res = f_write(&fil, buf, n, &bw);
+        app_unlock(j);
+        j->ok &= (res == FR_OK) && (bw == n);
+    }
+    app_lock(j);
+    res = f_close(&fil);
+    app_unlock(j);
+    j->ok &= (res == FR_OK);
+
+    app_lock(j);
+    res = f_open(&fil, j->path, FA_READ);
+    app_unlock(j);
+    j->ok &= (res == FR_OK);
+    for (ofs = 0; j->ok && (ofs < j->size); ofs += n)
+    {
+        n = (j->size - ofs < j->chunk) ? j->size - ofs : j->chunk;
+        app_lock(j);
+        res = f_read(&fil, buf, n, &bw);
+        app_unlock(j);
+        j->ok &= (res == FR_OK) && (bw == n);
+        for (i = 0; j->ok && (i < n); i++)
+            j->ok &= (buf[i] == pattern(ofs + i, j->seed));
+    }
+    app_lock(j);
+    res = f_close(&fil);
+    app_unlock(j);
+    j->ok &= (res == FR_OK);
+
+    j->secs = now() - t0;
+    free(buf);
+    return NULL;
+}
+
+/* Run the jobs in threads of their own, returns the time for all */
+static double run_jobs(job_t *jobs, int n)
+{
+    pthread_t th[4];
+    double t0 = now();
+    int i;
+
+    for (i = 0; i < n; i++)
+        pthread_create(&th[i], NULL, write_verify, &jobs[i]);
+    for (i = 0; i < n; i++)
+        pthread_join(th[i], NULL);
+    return now() - t0;
+}
+
+/*-----------------------------------------------------------------------*/
+
+static void test_mount(void)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        CHECK(f_mkfs(s_apcVol[i], FM_ANY, 0, s_au32Work, sizeof(s_au32Work)) == FR_OK);
+        CHECK(f_mount(&s_asFs[i], s_apcVol[i], 1) == FR_OK);
+    }
+
+    /* a mutex per volume, one for the USB host stack, one for the lock
+     * table and one for the cache of SDH0 */
+    CHECK(freertos_sim_mutexes() == 6);
+}
+
+/* Two tasks on one volume */
+static void test_same_volume(void)
+{
+    job_t jobs[2] =
+    {
+        { .path = "0:/A.BIN", .size = 1024 * 1024, .chunk = 3000, .seed = 1 },
+        { .path = "0:/B.BIN", .size = 1024 * 1024, .chunk = 1000, .seed = 2 },
+    };
+
+    run_jobs(jobs, 2);
+    CHECK(jobs[0].ok);
+    CHECK(jobs[1].ok);
+}
+
+/* Two USB drives, one host stack: the transfers must not overlap */
+static void test_usb_pair(void)
+{
+    job_t jobs[2] =
+    {
+        { .path = "3:/A.BIN", .size = 512 * 1024, .chunk = 4096, .seed = 3 },
+        { .path = "4:/A.BIN", .size = 512 * 1024, .chunk = 4096, .seed = 4 },
+    };
+
+    disk_sim_latency(3, 100, 10, 1);
+    disk_sim_latency(4, 100, 10, 1);
+    disk_sim_reset_stat();
+    run_jobs(jobs, 2);
+    CHECK(jobs[0].ok);
+    CHECK(jobs[1].ok);
+    CHECK(disk_sim_usb_max_busy() == 1);
+    disk_sim_latency(3, 0, 0, 0);
+    disk_sim_latency(4, 0, 0, 0);
+}
+
+static void test_file_locks(void)
+{
+    FIL a, b, fil[9];
+    char path[16];
+    int i;
+
+    CHECK(f_open(&a, "0:/L.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    CHECK(f_open(&b, "0:/L.BIN", FA_READ) == FR_LOCKED);
+    CHECK(f_open(&b, "0:/L.BIN", FA_WRITE) == FR_LOCKED);
+    CHECK(f_unlink("0:/L.BIN") == FR_LOCKED);
+    CHECK(f_rename("0:/L.BIN", "0:/M.BIN") == FR_LOCKED);
+    CHECK(f_close(&a) == FR_OK);
+
+    /* any number of readers, but no writer while one is there */
+    CHECK(f_open(&a, "0:/L.BIN", FA_READ) == FR_OK);
+    CHECK(f_open(&b, "0:/L.BIN", FA_READ) == FR_OK);
+    CHECK(f_open(&fil[0], "0:/L.BIN", FA_WRITE) == FR_LOCKED);
+    CHECK(f_close(&a) == FR_OK);
+    CHECK(f_unlink("0:/L.BIN") == FR_LOCKED);
+    CHECK(f_close(&b) == FR_OK);
+    CHECK(f_unlink("0:/L.BIN") == FR_OK);
+
+    /* the FF_FS_LOCK entries are shared by all volumes */
+    for (i = 0; i < 8; i++)
+    {
+        snprintf(path, sizeof(path), "%s/F%d.BIN", s_apcVol[i % 3], i);
+        CHECK(f_open(&fil[i], path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    }
+    CHECK(f_open(&fil[8], "4:/F8.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_TOO_MANY_OPEN_FILES);
+    for (i = 0; i < 8; i++)
+        CHECK(f_close(&fil[i]) == FR_OK);
+}
+
+/* Tasks on two volumes opening and closing at the same time */
+static void *open_close(void *arg)
+{
+    int k = (int)(intptr_t)arg;
+    const char *vol = s_apcVol[k % 2];
+    char own[16], shared[16];
+    FIL r, w;
+    int i, ok = 1;
+
+    snprintf(own, sizeof(own), "%s/W%d.BIN", vol, k);
+    snprintf(shared, sizeof(shared), "%s/R.BIN", vol);
+    for (i = 0; i < 500; i++)
+    {
+        ok &= (f_open(&r, shared, FA_READ) == FR_OK);
+        ok &= (f_open(&w, own, FA_OPEN_ALWAYS | FA_WRITE) == FR_OK);
+        ok &= (f_close(&w) == FR_OK);
+        ok &= (f_close(&r) == FR_OK);
+    }
+    CHECK(ok);
+    return NULL;
+}
+
+static void test_lock_table(void)
+{
+    pthread_t th[4];
+    FIL fil[8];
+    char path[16];
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        snprintf(path, sizeof(path), "%s/R.BIN", s_apcVol[i]);
+        CHECK(f_open(&fil[0], path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+        CHECK(f_close(&fil[0]) == FR_OK);
+    }
+    for (i = 0; i < 4; i++)
+        pthread_create(&th[i], NULL, open_close, (void *)(intptr_t)i);
+    for (i = 0; i < 4; i++)
+        pthread_join(th[i], NULL);
+
+    /* no entry lost or left behind */
+    for (i = 0; i < 8; i++)
+    {
+        snprintf(path, sizeof(path), "%s/G%d.BIN", s_apcVol[i % 3], i);
+        CHECK(f_open(&fil[i], path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    }
+    for (i = 0; i < 8; i++)
+        CHECK(f_close(&fil[i]) == FR_OK);
+}
+
+/* Tasks on two volumes racing for the last free entry */
+static const char *const s_apcLast[] = { "0:/LAST.BIN", "3:/LAST.BIN" };
+static FIL s_asLast[2];
+
+static void *open_last(void *arg)
+{
+    int k = (int)(intptr_t)arg;
+
+    return (void *)(intptr_t)f_open(&s_asLast[k], s_apcLast[k], FA_CREATE_ALWAYS | FA_WRITE);
+}
+
+static void test_last_entry(void)
+{
+    pthread_t th[2];
+    void *rc[2];
+    FIL fil[7];
+    char path[16];
+    int i, n, ok = 1, got = 0;
+    UINT bw;
+
+    for (i = 0; i < 7; i++)
+    {
+        snprintf(path, sizeof(path), "4:/H%d.BIN", i);
+        CHECK(f_open(&fil[i], path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    }
+
+    disk_sim_latency(0, 200, 10, 1);
+    disk_sim_latency(3, 200, 10, 1);
+    for (n = 0; n < 20; n++)
+    {
+        /* overwriting a file frees its clusters, which takes a while */
+        for (i = 0; i < 2; i++)
+        {
+            ok &= (f_open(&s_asLast[i], s_apcLast[i], FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+            ok &= (f_write(&s_asLast[i], s_au32Work, sizeof(s_au32Work), &bw) == FR_OK);
+            ok &= (f_close(&s_asLast[i]) == FR_OK);
+        }
+        for (i = 0; i < 2; i++)
+            pthread_create(&th[i], NULL, open_last, (void *)(intptr_t)i);
+        for (i = 0; i < 2; i++)
+            pthread_join(th[i], &rc[i]);
+
+        /* one gets the entry, the other is told the table is full */
+        for (i = 0; i < 2; i++)
+        {
+            if ((FRESULT)(intptr_t)rc[i] == FR_OK)
+            {
+                ok &= (f_close(&s_asLast[i]) == FR_OK);
+                got++;
+            }
+            else
+            {
+                ok &= ((FRESULT)(intptr_t)rc[i] == FR_TOO_MANY_OPEN_FILES);
+            }
+        }
+    }
+    CHECK(ok);
+    CHECK(got == 20);
+    disk_sim_latency(0, 0, 0, 0);
+    disk_sim_latency(3, 0, 0, 0);
+
+    for (i = 0; i < 7; i++)
+        CHECK(f_close(&fil[i]) == FR_OK);
+}
+
+/* disk_cache_flush_aged() from a timer task, outside the volume lock */
+static volatile int s_iTimerStop;
+
+static void *cache_timer(void *arg)
+{
+    int *flushes = arg;
+
+    while (!s_iTimerStop)
+    {
+        if (disk_cache_flush_aged() == RES_OK)
+            (*flushes)++;
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static void test_cache_timer(void)
+{
+    job_t job = { .path = "0:/T.BIN", .size = 1024 * 1024, .chunk = 300, .seed = 7 };
+    pthread_t th;
+    uint8_t buf[300];
+    int flushes = 0, i;
+    UINT bw;
+    FIL fil;
+
+    /* dirty lines, and no FatFs call after them */
+    memset(buf, 0x5A, sizeof(buf));
+    CHECK(f_open(&fil, "0:/T.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    CHECK(f_write(&fil, buf, sizeof(buf), &bw) == FR_OK);
+    CHECK(f_sync(&fil) == FR_OK);
+    for (i = 0; i < 4; i++)
+        CHECK(f_write(&fil, buf, sizeof(buf), &bw) == FR_OK);
+    disk_sim_reset_stat();
+
+    s_iTimerStop = 0;
+    pthread_create(&th, NULL, cache_timer, &flushes);
+    usleep(200 * 1000);
+    CHECK(disk_sim_stat(0)->writes == 0);
+    usleep(600 * 1000);
+    CHECK(disk_sim_stat(0)->writes > 0);
+    CHECK(f_close(&fil) == FR_OK);
+
+    /* a writer on the same card while the timer runs */
+    run_jobs(&job, 1);
+    CHECK(job.ok);
+    s_iTimerStop = 1;
+    pthread_join(th, NULL);
+    CHECK(flushes > 100);
+}
+
+/*-----------------------------------------------------------------------*/
+/* SD and USB in parallel                                                */
+/*-----------------------------------------------------------------------*/
+
+static void bench(void)
+{
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    const uint32_t size = 4 * 1024 * 1024;
+    job_t jobs[2];
+    double secs[2];
+    int mode;
+
+    /* about 20 MB/s for the card, 10 MB/s for the USB disk */
+    disk_sim_latency(0, 100, 25, 1);
+    disk_sim_latency(3, 250, 50, 1);
+
+    printf("\n%-12s %10s %10s %11s %10s\n", "", "SD0 MB/s", "USB3 MB/s", "total MB/s", "elapsed s");
+    for (mode = 0; mode < 2; mode++)
+    {
+        memset(jobs, 0, sizeof(jobs));
+        jobs[0].path = "0:/BENCH.BIN";
+        jobs[1].path = "3:/BENCH.BIN";
+        jobs[0].size = jobs[1].size = size;
+        jobs[0].chunk = jobs[1].chunk = 32 * 1024;
+        jobs[0].seed = 5;
+        jobs[1].seed = 6;
+        jobs[0].app_lock = jobs[1].app_lock = mode ? NULL : &lock;
+
+        secs[mode] = run_jobs(jobs, 2);
+        CHECK(jobs[0].ok);
+        CHECK(jobs[1].ok);
+        printf("%-12s %10.2f %10.2f %11.2f %10.3f\n", mode ? "per volume" : "one lock",
+               2.0 * size / 1e6 / jobs[0].secs, 2.0 * size / 1e6 / jobs[1].secs,
+               4.0 * size / 1e6 / secs[mode], secs[mode]);
+    }
+    printf("speedup %.2f\n\n", secs[0] / secs[1]);
+
+    /* the card finishes while the USB disk is busy */
+    CHECK(secs[1] < 0.85 * secs[0]);
+
+    disk_sim_latency(0, 0, 0, 0);
+    disk_sim_latency(3, 0, 0, 0);
+}
+
+int main(void)
+{
+    int i;
+
+    if ((disk_sim_sd_attach(0, "rt0.img", IMAGE_SECTORS) != 0) ||
+            (disk_sim_usb_attach(3, "rt3.img", IMAGE_SECTORS) != 0) ||
+            (disk_sim_usb_attach(4, "rt4.img", IMAGE_SECTORS) != 0))
+    {
+        printf("cannot create disk image\n");
+        return 1;
+    }
+
+    test_mount();
+    test_same_volume();
+    test_usb_pair();
+    test_file_locks();
+    test_lock_table();
+    test_last_entry();
+    test_cache_timer();
+    bench();
+
+    for (i = 0; i < 3; i++)
+        CHECK(f_mount(NULL, s_apcVol[i], 0) == FR_OK);
+    CHECK(freertos_sim_mutexes() == 3);
+
+    disk_sim_sd_detach(0);
+    disk_sim_usb_detach(3);
+    disk_sim_usb_detach(4);
+
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * Host tests for source/ffstream.c, and a recorder write benchmark.
+ *
+ * Drive 0 is an SD card formatted FAT32 with 32 KB clusters, like a
+ * typical SDHC card. The benchmark writes 288 byte frames (64 kbps MP3 at
+ * 16 kHz) through f_write() and through streams with buffers of several
+ * sizes. Time is the simulated card time: each command costs CMD_US, each
+ * sector SECTOR_US on top, so the numbers count disk traffic, not host
+ * speed.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ff.h"
+#include "ffclmt.h"
+#include "ffstream.h"
+#include "diskio.h"
+#include "disk_sim.h"
+
+#define DRV             0
+#define IMAGE_SECTORS   (2560UL * 1024 * 1024 / 512)
+#define CLUSTER         32768
+#define FRAME           288
+
+#define CMD_US          500     /* SD write: command and busy */
+#define SECTOR_US       25      /* 20 MB/s */
+
+static int s_checks, s_failures;
+
+#define CHECK(c)                                                            \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(c)) {                                                         \
+            s_failures++;                                                   \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c);    \
+        }                                                                   \
+    } while (0)
+
+static uint32_t s_au32Work[FF_MAX_SS];
+static uint32_t s_au32Stream[64 * 1024 / 4];
+static uint32_t s_au32Data[32 * 1024 / 4 + 1];
+
+DWORD get_fattime(void)
+{
+    return ((DWORD)(2023 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
+
+/* Content of byte ofs of a test file, so any read can be checked */
+static uint8_t pattern(uint32_t ofs)
+{
+    uint32_t x = (ofs >> 2) * 2654435761u;
+
+    return (uint8_t)(x >> (8 * (ofs & 3)));
+}
+
+static void fill(uint8_t *p, uint32_t ofs, UINT len)
+{
+    UINT i;
+
+    for (i = 0; i < len; i++)
+        p[i] = pattern(ofs + i);
+}
+
+static DWORD free_clusters(void)
+{
+    FATFS *fs;
+    DWORD n = 0;
+
+    CHECK(f_getfree("0:", &n, &fs) == FR_OK);
+    return n;
+}
+
+/* Size and content of a file written with the pattern */
+static int check_file(const char *path, uint32_t size)
+{
+    uint8_t *buf = (uint8_t *)s_au32Data;
+    uint32_t ofs;
+    UINT i, n, br;
+    FIL fil;
+    int ok;
+
+    if (f_open(&fil, path, FA_READ) != FR_OK)
+        return 0;
+    ok = (f_size(&fil) == size);
+    for (ofs = 0; ok && (ofs < size); ofs += n)
+    {
+        n = (size - ofs < 32768) ? size - ofs : 32768;
+        ok = (f_read(&fil, buf, n, &br) == FR_OK) && (br == n);
+        for (i = 0; ok && (i < n); i++)
+            ok = (buf[i] == pattern(ofs + i));
+    }
+    f_close(&fil);
+    return ok;
+}
+
+/* Write size bytes in FRAME pieces from an odd address */
+static int stream_frames(FSTREAM *st, uint32_t size)
+{
+    uint8_t *frame = (uint8_t *)s_au32Data + 1;
+    uint32_t ofs;
+    UINT n, bw;
+
+    for (ofs = 0; ofs < size; ofs += n)
+    {
+        n = (size - ofs < FRAME) ? size - ofs : FRAME;
+        fill(frame, ofs, n);
+        if ((f_stream_write(st, frame, n, &bw) != FR_OK) || (bw != n))
+            return 0;
+    }
+    return 1;
+}
+
+/* Number of fragments of a file, from its cluster link map */
+static UINT fragments(const char *path)
+{
+    DWORD tbl[FF_CLMT_ITEMS(8)];
+    FIL fil;
+    FRESULT res;
+
+    CHECK(f_open(&fil, path, FA_READ) == FR_OK);
+    res = f_clmt_attach(&fil, tbl, FF_CLMT_ITEMS(8));
+    f_close(&fil);
+    return (res == FR_OK || res == FR_NOT_ENOUGH_CORE) ? (UINT)(tbl[0] - 2) / 2 : 0;
+}
+
+/*-----------------------------------------------------------------------*/
+
+static void test_stream(void)
+{
+    const uint32_t size = 700000;
+    DWORD before = free_clusters();
+    disk_sim_stat_t *stat = disk_sim_stat(DRV);
+    FSTREAM st;
+    FIL fil;
+
+    CHECK(f_stream_open(&st, &fil, "0:/REC.MP3", 1024 * 1024, s_au32Stream, 8192) == FR_OK);
+    CHECK(f_stream_reserved(&st) == 1024 * 1024);
+    CHECK(free_clusters() == before - 1024 * 1024 / CLUSTER);
+
+    /* nothing but full buffers of data while recording */
+    disk_sim_reset_stat();
+    CHECK(stream_frames(&st, size));
+    CHECK(stat->writes == size / 8192);
+    CHECK(stat->wr_sectors == size / 8192 * 16);
+    CHECK(stat->reads == 0);
+
+    CHECK(f_stream_close(&st) == FR_OK);
+    CHECK(check_file("0:/REC.MP3", size));
+    CHECK(fragments("0:/REC.MP3") == 1);
+    CHECK(free_clusters() == before - (size + CLUSTER - 1) / CLUSTER);
+    CHECK(f_unlink("0:/REC.MP3") == FR_OK);
+}
+
+static void test_aligned(void)
+{
+    const uint32_t size = 40 * 8192;
+    disk_sim_stat_t *stat = disk_sim_stat(DRV);
+    uint8_t *data = (uint8_t *)s_au32Data;
+    uint32_t ofs;
+    FSTREAM st;
+    FIL fil;
+    UINT bw;
+
+    CHECK(f_stream_open(&st, &fil, "0:/ALIGNED.BIN", size, s_au32Stream, 4096) == FR_OK);
+
+    /* whole sectors of a word aligned buffer skip the stream buffer */
+    disk_sim_reset_stat();
+    for (ofs = 0; ofs < size; ofs += 8192)
+    {
+        fill(data, ofs, 8192);
+        CHECK(f_stream_write(&st, data, 8192, &bw) == FR_OK && bw == 8192);
+    }
+    CHECK(stat->writes == size / 8192);
+    CHECK(stat->max_count == 16);
+    CHECK(stat->last_buf == data);
+
+    /* filled up exactly: the file keeps the reserved size */
+    CHECK(f_stream_close(&st) == FR_OK);
+    CHECK(check_file("0:/ALIGNED.BIN", size));
+    CHECK(f_unlink("0:/ALIGNED.BIN") == FR_OK);
+}
+
+static void test_overflow(void)
+{
+    const uint32_t size = 200000;
+    FSTREAM st;
+    FIL fil, pad;
+    UINT bw;
+
+    /* a file right after the reserve makes the rest a second fragment */
+    CHECK(f_stream_open(&st, &fil, "0:/LONG.MP3", 50000, s_au32Stream, 8192) == FR_OK);
+    CHECK(f_stream_reserved(&st) == 2 * CLUSTER);
+    CHECK(f_open(&pad, "0:/PAD.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    CHECK(f_write(&pad, s_au32Data, 100, &bw) == FR_OK && bw == 100);
+    CHECK(f_close(&pad) == FR_OK);
+
+    CHECK(stream_frames(&st, size));
+    CHECK(f_stream_close(&st) == FR_OK);
+    CHECK(check_file("0:/LONG.MP3", size));
+    CHECK(fragments("0:/LONG.MP3") == 2);
+    CHECK(f_unlink("0:/LONG.MP3") == FR_OK);
+    CHECK(f_unlink("0:/PAD.BIN") == FR_OK);
+}
+
+static void test_edges(void)
+{
+    DWORD before = free_clusters();
+    FSTREAM st;
+    FIL fil;
+
+    /* closed without data: empty file, the reserve is given back */
+    CHECK(f_stream_open(&st, &fil, "0:/EMPTY.MP3", 1024 * 1024, s_au32Stream, 8192) == FR_OK);
+    CHECK(f_stream_close(&st) == FR_OK);
+    CHECK(check_file("0:/EMPTY.MP3", 0));
+    CHECK(free_clusters() == before);
+    CHECK(f_stream_close(&st) == FR_INVALID_OBJECT);
+
+    /* no contiguous run that long: plain f_write() */
+    CHECK(f_stream_open(&st, &fil, "0:/BIG.MP3", 0xC0000000, s_au32Stream, 8192) == FR_OK);
+    CHECK(f_stream_reserved(&st) == 0);
+    CHECK(stream_frames(&st, 100000));
+    CHECK(f_stream_close(&st) == FR_OK);
+    CHECK(check_file("0:/BIG.MP3", 100000));
+    CHECK(f_unlink("0:/BIG.MP3") == FR_OK);
+    CHECK(f_unlink("0:/EMPTY.MP3") == FR_OK);
+
+    CHECK(f_stream_open(&st, &fil, "0:/X.MP3", 4096, s_au32Stream, 1000) == FR_INVALID_PARAMETER);
+    CHECK(f_stream_open(&st, &fil, "0:/X.MP3", 4096, NULL, 8192) == FR_INVALID_PARAMETER);
+}
+
+/*-----------------------------------------------------------------------*/
+/* Recorder benchmark                                                    */
+/*-----------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t writes;
+    uint32_t close_us;
+} rec_result_t;
+
+static void record(UINT bufsize, uint32_t size, rec_result_t *r)
+{
+    uint8_t *frame = (uint8_t *)s_au32Data + 1;
+    disk_sim_stat_t *stat = disk_sim_stat(DRV);
+    uint64_t t;
+    uint32_t ofs, us;
+    FSTREAM st;
+    FIL fil;
+    UINT bw;
+    int ok = 1;
+
+    /* 0 for f_write() */
+    if (bufsize)
+        CHECK(f_stream_open(&st, &fil, "0:/BENCH.MP3", size, s_au32Stream, bufsize) == FR_OK);
+    else
+        CHECK(f_open(&fil, "0:/BENCH.MP3", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+
+    memset(r, 0, sizeof(*r));
+    disk_sim_latency(DRV, CMD_US, SECTOR_US, 0);
+    disk_sim_reset_stat();
+    for (ofs = 0; ofs < size; ofs += FRAME)
+    {
+        fill(frame, ofs, FRAME);
+        t = stat->busy_us;
+        if (bufsize)
+            ok &= (f_stream_write(&st, frame, FRAME, &bw) == FR_OK) && (bw == FRAME);
+        else
+            ok &= (f_write(&fil, frame, FRAME, &bw) == FR_OK) && (bw == FRAME);
+        us = (uint32_t)(stat->busy_us - t);
+        if (us > r->max_us)
+            r->max_us = us;
+    }
+    r->writes = stat->writes;
+    t = stat->busy_us;
+    CHECK((bufsize ? f_stream_close(&st) : f_close(&fil)) == FR_OK);
+    r->close_us = (uint32_t)(stat->busy_us - t);
+    r->total_us = stat->busy_us;
+    disk_sim_latency(DRV, 0, 0, 0);
+
+    CHECK(ok);
+    CHECK(check_file("0:/BENCH.MP3", size));
+    CHECK(f_unlink("0:/BENCH.MP3") == FR_OK);
+}
+
+static void bench(void)
+{
+    static const UINT bufsize[] = { 0, 4096, 16384, 65536 };
+    const uint32_t size = 16 * 1024 * 1024 / FRAME * FRAME;
+    rec_result_t r[4];
+    char name[24];     /* "stream 4194303 KB" */
+    int i;
+
+    printf("\n%u KB in %u byte frames, SD write %u us + %u us/sector\n",
+           (unsigned)(size / 1024), FRAME, CMD_US, SECTOR_US);
+    printf("%-14s %10s %10s %14s %10s\n", "", "SD writes", "MB/s", "worst call ms", "close ms");
+    for (i = 0; i < 4; i++)
+    {
+        record(bufsize[i], size, &r[i]);
+        if (bufsize[i])
+            snprintf(name, sizeof(name), "stream %u KB", bufsize[i] / 1024);
+        else
+            snprintf(name, sizeof(name), "f_write");
+        printf("%-14s %10u %10.2f %14.2f %10.2f\n", name, (unsigned)r[i].writes,
+               (double)size / r[i].total_us, r[i].max_us / 1000.0, r[i].close_us / 1000.0);
+    }
+    printf("\n");
+
+    /* a stream writes whole buffers only */
+    for (i = 1; i < 4; i++)
+        CHECK(r[i].writes == size / bufsize[i]);
+
+    /* f_write() pays a command per sector plus the FAT updates */
+    CHECK(r[0].writes > size / 512);
+    CHECK(r[1].total_us * 4 < r[0].total_us);
+}
+
+int main(void)
+{
+    FATFS fs;
+
+    if (disk_sim_sd_attach(DRV, "stream0.img", IMAGE_SECTORS) != 0)
+    {
+        printf("cannot create disk image\n");
+        return 1;
+    }
+
+    CHECK(f_mkfs("0:", FM_FAT32, CLUSTER, s_au32Work, sizeof(s_au32Work)) == FR_OK);
+    CHECK(f_mount(&fs, "0:", 1) == FR_OK);
+
+    test_stream();
+    test_aligned();
+    test_overflow();
+    test_edges();
+    bench();
+
+    CHECK(f_mount(NULL, "0:", 0) == FR_OK);
+    disk_sim_sd_detach(DRV);
+
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -1,225 +1,947 @@
 /*-----------------------------------------------------------------------*/
-/* Low level disk I/O module skeleton for FatFs     (C)ChaN, 2016        */
+/* Low level disk I/O module for FatFs on M460 SDH and USB mass storage  */
 /*-----------------------------------------------------------------------*/
-/* If a working storage control module is available, it should be        */
-/* attached to the FatFs via a glue function rather than modifying it.   */
-/* This is an example of glue functions to attach various exsisting      */
-/* storage control modules to the FatFs module with a defined API.       */
+/* Physical drive numbers follow the usbh_umas convention:               */
+/*   0, 1   SD card on SDH0, SDH1 (probed by SDH_Open_Disk/SDH_Probe)    */
+/*   3..    USB mass storage, numbers handed out by the USB host MSC     */
+/*          driver from USBDRV_0 (UsbHostLib/src_msc/msc.h)              */
+/*                                                                       */
+/* Build options, override on the compiler command line:                 */
+/*   DISKIO_SDH             map drives 0/1 to SDH0/SDH1 (default 1)      */
+/*   DISKIO_USBH            map drives 3.. to usbh_umas (default 0),     */
+/*                          needs the USB host library                   */
+/*   DISKIO_BOUNCE_SECTORS  bounce buffer size per SDH port (default 2)  */
+/*   DISKIO_SDH_BLOCK_SIZE  GET_BLOCK_SIZE for SD, in sectors (default   */
+/*                          8192, the 4 MB allocation unit of SDHC)      */
+/*   DISKIO_CACHE_SECTORS   write-back cache lines per SDH port, 0 for   */
+/*                          no cache (default 0)                         */
+/*   DISKIO_CACHE_WAYS      cache associativity (default 4)              */
+/*   DISKIO_CACHE_BYPASS    longer transfers skip the cache (default 4)  */
+/*   DISKIO_CACHE_MAX_AGE   write back once the oldest dirty sector is   */
+/*                          this many ms old (default 500)               */
+/*   DISKIO_CACHE_TICK()    ms clock (default: the FreeRTOS tick with    */
+/*                          FF_FS_REENTRANT, else the DWT cycle counter) */
+/*   DISKIO_CACHE_ADDR      word aligned address for the cache data,     */
+/*                          e.g. in HyperRAM (default: static array)     */
 /*-----------------------------------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
 
-#include "diskio.h"		/* FatFs lower layer API */
+#include "NuMicro.h"
+#include "ff.h"
+#include "diskio.h"     /* FatFs lower layer API */
 
-/* Definitions of physical drive number for each drive */
-#define DEV_RAM		0	/* Example: Map Ramdisk to physical drive 0 */
-#define DEV_MMC		1	/* Example: Map MMC/SD card to physical drive 1 */
-#define DEV_USB		2	/* Example: Map USB MSD to physical drive 2 */
+#ifndef DISKIO_SDH
+#define DISKIO_SDH              1
+#endif
 
+#ifndef DISKIO_USBH
+#define DISKIO_USBH             0
+#endif
 
+#ifndef DISKIO_BOUNCE_SECTORS
+#define DISKIO_BOUNCE_SECTORS   2
+#endif
+
+#ifndef DISKIO_SDH_BLOCK_SIZE
+#define DISKIO_SDH_BLOCK_SIZE   8192
+#endif
+
+#ifndef DISKIO_CACHE_SECTORS
+#define DISKIO_CACHE_SECTORS    0
+#endif
+
+#ifndef DISKIO_CACHE_WAYS
+#define DISKIO_CACHE_WAYS       4
+#endif
+
+#ifndef DISKIO_CACHE_BYPASS
+#define DISKIO_CACHE_BYPASS     4
+#endif
+
+#ifndef DISKIO_CACHE_MAX_AGE
+#define DISKIO_CACHE_MAX_AGE    500
+#endif
+
+#if DISKIO_CACHE_SECTORS % DISKIO_CACHE_WAYS
+#error "DISKIO_CACHE_SECTORS must be a multiple of DISKIO_CACHE_WAYS"
+#endif
+
+#if DISKIO_USBH
+#include "usbh_lib.h"
+#endif
+
+/* Definitions of physical drive number for each media */
+#define DEV_SD0         0
+#define DEV_SD1         1
+#define DEV_USB0        3       /* USBDRV_0 */
+
+#define SECTOR_SIZE     512
+
+
+#if DISKIO_SDH
 /*-----------------------------------------------------------------------*/
-/* Get Drive Status                                                      */
+/* SD card on SDH0/SDH1                                                  */
 /*-----------------------------------------------------------------------*/
+/* SDH_Read/SDH_Write hand the buffer to the SDH DMA, which only takes   */
+/* word aligned addresses. Aligned buffers go straight through with the  */
+/* whole sector count in one multi-block command; unaligned ones are     */
+/* staged through a small per-port bounce buffer.                        */
 
-DSTATUS disk_status (
-	BYTE pdrv		/* Physical drive nmuber to identify the drive */
-)
+static uint32_t s_au32Bounce[2][DISKIO_BOUNCE_SECTORS * SECTOR_SIZE / 4];
+
+/* Set by disk_media_change() from the card detect interrupt */
+static volatile uint8_t s_au8MediaChange[2];
+
+static SDH_T *sdh_port(BYTE pdrv)
 {
-	DSTATUS stat;
-	int result;
+    return (pdrv == DEV_SD0) ? SDH0 : SDH1;
+}
 
-	switch (pdrv) {
-	case DEV_RAM :
-		result = RAM_disk_status();
+static SDH_INFO_T *sdh_info(BYTE pdrv)
+{
+    return (pdrv == DEV_SD0) ? &SD0 : &SD1;
+}
 
-		// translate the reslut code here
+static DRESULT sdh_result(uint32_t u32Status)
+{
+    if (u32Status == Successful)
+        return RES_OK;
+    if (u32Status == SDH_NO_SD_CARD)
+        return RES_NOTRDY;
+    if (u32Status == SDH_WRITE_PROTECT)
+        return RES_WRPRT;
+    return RES_ERROR;
+}
 
-		return stat;
+static DSTATUS sdh_status(BYTE pdrv)
+{
+    if (SDH_GET_CARD_CAPACITY(sdh_port(pdrv)) == 0)
+        return STA_NOINIT;
+    return 0;
+}
 
-	case DEV_MMC :
-		result = MMC_disk_status();
+static DRESULT sdh_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    SDH_T *sdh = sdh_port(pdrv);
+    uint8_t *pu8Bounce = (uint8_t *)s_au32Bounce[pdrv];
+    UINT n;
+    DRESULT res;
+
+    if (((uintptr_t)buff & 3) == 0)
+        return sdh_result(SDH_Read(sdh, buff, sector, count));
+
+    while (count)
+    {
+        n = (count < DISKIO_BOUNCE_SECTORS) ? count : DISKIO_BOUNCE_SECTORS;
+        res = sdh_result(SDH_Read(sdh, pu8Bounce, sector, n));
+        if (res != RES_OK)
+            return res;
+        memcpy(buff, pu8Bounce, n * SECTOR_SIZE);
+        buff += n * SECTOR_SIZE;
+        sector += n;
+        count -= n;
+    }
+    return RES_OK;
+}
 
-		// translate the reslut code here
+static DRESULT sdh_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    SDH_T *sdh = sdh_port(pdrv);
+    uint8_t *pu8Bounce = (uint8_t *)s_au32Bounce[pdrv];
+    UINT n;
+    DRESULT res;
+
+    if (((uintptr_t)buff & 3) == 0)
+        return sdh_result(SDH_Write(sdh, (uint8_t *)(uintptr_t)buff, sector, count));
+
+    while (count)
+    {
+        n = (count < DISKIO_BOUNCE_SECTORS) ? count : DISKIO_BOUNCE_SECTORS;
+        memcpy(pu8Bounce, buff, n * SECTOR_SIZE);
+        res = sdh_result(SDH_Write(sdh, pu8Bounce, sector, n));
+        if (res != RES_OK)
+            return res;
+        buff += n * SECTOR_SIZE;
+        sector += n;
+        count -= n;
+    }
+    return RES_OK;
+}
 
-		return stat;
+static DRESULT sdh_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    SDH_INFO_T *pSD = sdh_info(pdrv);
+    DWORD *range;
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        /* SDH_Write returns after the card has left the busy state */
+        return RES_OK;
+
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = pSD->totalSectorN;
+        return RES_OK;
+
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = SECTOR_SIZE;
+        return RES_OK;
+
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = DISKIO_SDH_BLOCK_SIZE;
+        return RES_OK;
+
+    case CTRL_TRIM:
+        range = (DWORD *)buff;
+        if (range[1] < range[0])
+            return RES_PARERR;
+        return sdh_result(SDH_Erase(sdh_port(pdrv), range[0], range[1] - range[0] + 1));
+
+    default:
+        return RES_PARERR;
+    }
+}
 
-	case DEV_USB :
-		result = USB_disk_status();
 
-		// translate the reslut code here
+#if DISKIO_CACHE_SECTORS
+/*-----------------------------------------------------------------------*/
+/* Write-back sector cache for SDH0/SDH1                                 */
+/*-----------------------------------------------------------------------*/
+/* FatFs updates the FAT, directory entries and partial data sectors one */
+/* sector at a time, each a separate programming cycle of the card. The  */
+/* cache keeps them, set associative with LRU replacement, and writes    */
+/* dirty sectors back when their line is evicted, on CTRL_SYNC (f_sync,  */
+/* f_close) and once the oldest of them is DISKIO_CACHE_MAX_AGE ms old.  */
+/* The age is checked on each cached call and in                         */
+/* disk_cache_flush_aged(), which a timer task or the main loop calls    */
+/* periodically so that the bound also holds when the I/O stops. A card  */
+/* change reported by disk_media_change() drops every line before the    */
+/* next cached call or write back, so no sector of one card goes to the  */
+/* next.                                                                 */
+/*                                                                       */
+/* With FF_FS_REENTRANT each port has a sync object of its own (slots    */
+/* FF_VOLUMES + 2 and + 3 of ffsystem.c), since disk_cache_flush_aged()  */
+/* is called outside the FatFs volume lock.                              */
+/*                                                                       */
+/* Line data is stored way by way, so consecutive sectors that sit in    */
+/* consecutive sets of one way are consecutive in memory and go back to  */
+/* the card as one multi-block write. Transfers longer than              */
+/* DISKIO_CACHE_BYPASS go to the card directly: reads are patched with   */
+/* the dirty lines they overlap, writes drop the lines they overwrite.   */
+
+#define CACHE_SETS      (DISKIO_CACHE_SECTORS / DISKIO_CACHE_WAYS)
+
+typedef struct
+{
+    DWORD sector;
+    uint32_t u32Used;       /* LRU stamp, 0 for an empty line */
+    uint32_t u32Dirty;
+} cache_tag_t;
 
-		return stat;
-	}
-	return STA_NOINIT;
+typedef struct
+{
+    cache_tag_t tag[DISKIO_CACHE_WAYS][CACHE_SETS];
+    uint32_t u32Stamp;      /* last LRU stamp */
+    uint32_t u32Dirty;      /* dirty lines */
+    uint32_t u32Now;        /* tick of the current call */
+    uint32_t u32DirtyTick;  /* tick the oldest dirty line was written */
+} sdh_cache_t;
+
+static sdh_cache_t s_asCache[2];
+
+#ifndef DISKIO_CACHE_ADDR
+static uint32_t s_au32CacheData[2 * DISKIO_CACHE_SECTORS * SECTOR_SIZE / 4];
+#define DISKIO_CACHE_ADDR       s_au32CacheData
+#endif
+
+#ifndef DISKIO_CACHE_TICK
+#if FF_FS_REENTRANT
+#include "task.h"
+#define DISKIO_CACHE_TICK()     ((uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS))
+#else
+/* ms from the DWT cycle counter, which wraps every 2^32 / SystemCoreClock
+ * seconds (21 s at 200 MHz). Time is lost only over a wrap with no line
+ * dirty: disk_cache_flush_aged() reads the clock while there is one. */
+static uint32_t cache_ms(void)
+{
+    static uint32_t s_u32Last, s_u32Rem, s_u32Ms;
+    uint32_t u32PerMs = SystemCoreClock / 1000, u32Now, u32Delta;
+
+    if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk))
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        s_u32Last = DWT->CYCCNT;
+    }
+    u32Now = DWT->CYCCNT;
+    u32Delta = u32Now - s_u32Last;
+    s_u32Last = u32Now;
+
+    s_u32Ms += u32Delta / u32PerMs;
+    s_u32Rem += u32Delta % u32PerMs;
+    if (s_u32Rem >= u32PerMs)
+    {
+        s_u32Ms++;
+        s_u32Rem -= u32PerMs;
+    }
+    return s_u32Ms;
 }
+#define DISKIO_CACHE_TICK()     cache_ms()
+#endif
+#endif
 
+#if FF_FS_REENTRANT
+static FF_SYNC_t s_aCacheLock[2];
+static int s_aiCacheLock[2];
 
+static int cache_lock(BYTE pdrv)
+{
+    if (!s_aiCacheLock[pdrv])
+    {
+        ff_sys_lock();
+        if (!s_aiCacheLock[pdrv])
+            s_aiCacheLock[pdrv] = ff_cre_syncobj(FF_VOLUMES + 2 + pdrv, &s_aCacheLock[pdrv]);
+        ff_sys_unlock();
+        if (!s_aiCacheLock[pdrv])
+            return 0;
+    }
+    return ff_req_grant(s_aCacheLock[pdrv]);
+}
 
-/*-----------------------------------------------------------------------*/
-/* Inidialize a Drive                                                    */
-/*-----------------------------------------------------------------------*/
+#define cache_unlock(pdrv)  ff_rel_grant(s_aCacheLock[pdrv])
+#else
+#define cache_lock(pdrv)    1
+#define cache_unlock(pdrv)
+#endif
 
-DSTATUS disk_initialize (
-	BYTE pdrv				/* Physical drive nmuber to identify the drive */
-)
+static uint8_t *cache_data(BYTE pdrv, UINT way, UINT set)
 {
-	DSTATUS stat;
-	int result;
+    return (uint8_t *)(DISKIO_CACHE_ADDR) + ((pdrv * DISKIO_CACHE_WAYS + way) * CACHE_SETS + set) * SECTOR_SIZE;
+}
 
-	switch (pdrv) {
-	case DEV_RAM :
-		result = RAM_disk_initialize();
+static int cache_find(BYTE pdrv, DWORD sector)
+{
+    sdh_cache_t *c = &s_asCache[pdrv];
+    UINT set = sector % CACHE_SETS, way;
+
+    for (way = 0; way < DISKIO_CACHE_WAYS; way++)
+    {
+        if (c->tag[way][set].u32Used && (c->tag[way][set].sector == sector))
+            return (int)way;
+    }
+    return -1;
+}
 
-		// translate the reslut code here
+/* Write back a dirty line together with the dirty lines next to it in
+ * its way that continue its sector run */
+static DRESULT cache_write_run(BYTE pdrv, UINT way, UINT set)
+{
+    sdh_cache_t *c = &s_asCache[pdrv];
+    cache_tag_t *t = c->tag[way];
+    UINT lo = set, hi = set, i;
+    DRESULT res;
+
+    while ((lo > 0) && t[lo - 1].u32Dirty && (t[lo - 1].sector + 1 == t[lo].sector))
+        lo--;
+    while ((hi < CACHE_SETS - 1) && t[hi + 1].u32Dirty && (t[hi + 1].sector == t[hi].sector + 1))
+        hi++;
+
+    /* card changed since the lines were written: they belong to the old one */
+    if (s_au8MediaChange[pdrv])
+        return RES_NOTRDY;
+
+    res = sdh_result(SDH_Write(sdh_port(pdrv), cache_data(pdrv, way, lo), t[lo].sector, hi - lo + 1));
+    if (res != RES_OK)
+        return res;
+
+    for (i = lo; i <= hi; i++)
+        t[i].u32Dirty = 0;
+    c->u32Dirty -= hi - lo + 1;
+    return RES_OK;
+}
 
-		return stat;
+static DRESULT cache_flush(BYTE pdrv)
+{
+    sdh_cache_t *c = &s_asCache[pdrv];
+    UINT way, set;
+    DRESULT res;
+
+    for (way = 0; (way < DISKIO_CACHE_WAYS) && c->u32Dirty; way++)
+    {
+        for (set = 0; set < CACHE_SETS; set++)
+        {
+            if (c->tag[way][set].u32Dirty)
+            {
+                res = cache_write_run(pdrv, way, set);
+                if (res != RES_OK)
+                    return res;
+            }
+        }
+    }
+    return RES_OK;
+}
 
-	case DEV_MMC :
-		result = MMC_disk_initialize();
+/* Forget the lines of count sectors from sector, dirty or not */
+static void cache_drop(BYTE pdrv, DWORD sector, DWORD count)
+{
+    sdh_cache_t *c = &s_asCache[pdrv];
+    cache_tag_t *t;
+    UINT way, set;
+
+    for (way = 0; way < DISKIO_CACHE_WAYS; way++)
+    {
+        for (set = 0; set < CACHE_SETS; set++)
+        {
+            t = &c->tag[way][set];
+            if (t->u32Used && (t->sector - sector < count))
+            {
+                if (t->u32Dirty)
+                    c->u32Dirty--;
+                t->u32Used = 0;
+                t->u32Dirty = 0;
+            }
+        }
+    }
+}
 
-		// translate the reslut code here
+/* Pick the line for a sector that is not cached. The way that holds the
+ * previous sector is preferred unless that means a write back, so runs
+ * of sectors stay in one way; then an empty line, then the LRU one. */
+static DRESULT cache_victim(BYTE pdrv, DWORD sector, UINT *pWay)
+{
+    sdh_cache_t *c = &s_asCache[pdrv];
+    UINT set = sector % CACHE_SETS, way, victim = DISKIO_CACHE_WAYS;
+    cache_tag_t *t;
+    DRESULT res;
+
+    if (set > 0)
+    {
+        for (way = 0; way < DISKIO_CACHE_WAYS; way++)
+        {
+            t = &c->tag[way][set - 1];
+            if (t->u32Used && (t->sector + 1 == sector) && !c->tag[way][set].u32Dirty)
+            {
+                victim = way;
+                break;
+            }
+        }
+    }
+
+    for (way = 0; (way < DISKIO_CACHE_WAYS) && (victim == DISKIO_CACHE_WAYS); way++)
+    {
+        if (c->tag[way][set].u32Used == 0)
+            victim = way;
+    }
+
+    if (victim == DISKIO_CACHE_WAYS)
+    {
+        victim = 0;
+        for (way = 1; way < DISKIO_CACHE_WAYS; way++)
+        {
+            if (c->tag[way][set].u32Used < c->tag[victim][set].u32Used)
+                victim = way;
+        }
+        if (c->tag[victim][set].u32Dirty)
+        {
+            res = cache_write_run(pdrv, victim, set);
+            if (res != RES_OK)
+                return res;
+        }
+    }
+
+    c->tag[victim][set].u32Used = 0;
+    *pWay = victim;
+    return RES_OK;
+}
 
-		return stat;
+static void cache_fill(BYTE pdrv, UINT way, DWORD sector, int dirty)
+{
+    sdh_cache_t *c = &s_asCache[pdrv];
+    cache_tag_t *t = &c->tag[way][sector % CACHE_SETS];
+
+    t->sector = sector;
+    t->u32Used = ++c->u32Stamp;
+    if (dirty && !t->u32Dirty)
+    {
+        t->u32Dirty = 1;
+        if (c->u32Dirty++ == 0)
+            c->u32DirtyTick = c->u32Now;
+    }
+}
 
-	case DEV_USB :
-		result = USB_disk_initialize();
+/* Start of every cached call: take the port, drop the lines of a card
+ * that was changed and write back stale dirty lines. A failed write back
+ * leaves them dirty for the next try. */
+static int cache_enter(BYTE pdrv, DRESULT *pRes)
+{
+    sdh_cache_t *c = &s_asCache[pdrv];
+    DRESULT res = RES_OK;
+
+    if (!cache_lock(pdrv))
+        return 0;
+    if (s_au8MediaChange[pdrv])
+    {
+        s_au8MediaChange[pdrv] = 0;
+        cache_drop(pdrv, 0, 0xFFFFFFFF);
+    }
+    c->u32Now = DISKIO_CACHE_TICK();
+    if (c->u32Dirty && (c->u32Now - c->u32DirtyTick >= DISKIO_CACHE_MAX_AGE))
+        res = cache_flush(pdrv);
+    if (pRes)
+        *pRes = res;
+    return 1;
+}
 
-		// translate the reslut code here
+static DSTATUS cache_status(BYTE pdrv)
+{
+    DSTATUS st;
 
-		return stat;
-	}
-	return STA_NOINIT;
+    if (!cache_enter(pdrv, NULL))
+        return STA_NOINIT;
+    st = sdh_status(pdrv);
+
+    /* card gone, whatever was not written back is lost */
+    if (st & STA_NOINIT)
+        cache_drop(pdrv, 0, 0xFFFFFFFF);
+    cache_unlock(pdrv);
+    return st;
 }
 
+static DRESULT cache_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    sdh_cache_t *c = &s_asCache[pdrv];
+    cache_tag_t *t;
+    UINT way, set;
+    int hit;
+    DRESULT res;
+
+    if (count > DISKIO_CACHE_BYPASS)
+    {
+        res = sdh_read(pdrv, buff, sector, count);
+        for (way = 0; (way < DISKIO_CACHE_WAYS) && c->u32Dirty && (res == RES_OK); way++)
+        {
+            for (set = 0; set < CACHE_SETS; set++)
+            {
+                t = &c->tag[way][set];
+                if (t->u32Dirty && (t->sector - sector < count))
+                    memcpy(buff + (t->sector - sector) * SECTOR_SIZE, cache_data(pdrv, way, set), SECTOR_SIZE);
+            }
+        }
+        return res;
+    }
+
+    for (; count; count--, sector++, buff += SECTOR_SIZE)
+    {
+        hit = cache_find(pdrv, sector);
+        if (hit >= 0)
+        {
+            way = (UINT)hit;
+        }
+        else
+        {
+            res = cache_victim(pdrv, sector, &way);
+            if (res == RES_OK)
+                res = sdh_result(SDH_Read(sdh_port(pdrv), cache_data(pdrv, way, sector % CACHE_SETS), sector, 1));
+            if (res != RES_OK)
+                return res;
+        }
+        cache_fill(pdrv, way, sector, 0);
+        memcpy(buff, cache_data(pdrv, way, sector % CACHE_SETS), SECTOR_SIZE);
+    }
+    return RES_OK;
+}
 
+static DRESULT cache_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    UINT way;
+    int hit;
+    DRESULT res;
+
+    if (count > DISKIO_CACHE_BYPASS)
+    {
+        cache_drop(pdrv, sector, count);
+        return sdh_write(pdrv, buff, sector, count);
+    }
+
+    for (; count; count--, sector++, buff += SECTOR_SIZE)
+    {
+        hit = cache_find(pdrv, sector);
+        if (hit >= 0)
+        {
+            way = (UINT)hit;
+        }
+        else
+        {
+            res = cache_victim(pdrv, sector, &way);
+            if (res != RES_OK)
+                return res;
+        }
+        memcpy(cache_data(pdrv, way, sector % CACHE_SETS), buff, SECTOR_SIZE);
+        cache_fill(pdrv, way, sector, 1);
+    }
+    return RES_OK;
+}
 
-/*-----------------------------------------------------------------------*/
-/* Read Sector(s)                                                        */
-/*-----------------------------------------------------------------------*/
+static DRESULT cache_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    DWORD *range;
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        return cache_flush(pdrv);
+
+    case CTRL_TRIM:
+        range = (DWORD *)buff;
+        if (range[1] < range[0])
+            return RES_PARERR;
+        cache_drop(pdrv, range[0], range[1] - range[0] + 1);
+        return sdh_ioctl(pdrv, cmd, buff);
+
+    default:
+        return sdh_ioctl(pdrv, cmd, buff);
+    }
+}
 
-DRESULT disk_read (
-	BYTE pdrv,		/* Physical drive nmuber to identify the drive */
-	BYTE *buff,		/* Data buffer to store read data */
-	DWORD sector,	/* Start sector in LBA */
-	UINT count		/* Number of sectors to read */
-)
+static DRESULT cache_locked_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 {
-	DRESULT res;
-	int result;
+    DRESULT res;
 
-	switch (pdrv) {
-	case DEV_RAM :
-		// translate the arguments here
+    if (!cache_enter(pdrv, NULL))
+        return RES_ERROR;
+    res = cache_read(pdrv, buff, sector, count);
+    cache_unlock(pdrv);
+    return res;
+}
 
-		result = RAM_disk_read(buff, sector, count);
+static DRESULT cache_locked_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res;
 
-		// translate the reslut code here
+    if (!cache_enter(pdrv, NULL))
+        return RES_ERROR;
+    res = cache_write(pdrv, buff, sector, count);
+    cache_unlock(pdrv);
+    return res;
+}
 
-		return res;
+static DRESULT cache_locked_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    DRESULT res;
 
-	case DEV_MMC :
-		// translate the arguments here
+    if (!cache_enter(pdrv, NULL))
+        return RES_ERROR;
+    res = cache_ioctl(pdrv, cmd, buff);
+    cache_unlock(pdrv);
+    return res;
+}
 
-		result = MMC_disk_read(buff, sector, count);
+#define sdh_disk_status     cache_status
+#define sdh_disk_read       cache_locked_read
+#define sdh_disk_write      cache_locked_write
+#define sdh_disk_ioctl      cache_locked_ioctl
 
-		// translate the reslut code here
+#else
 
-		return res;
+#define sdh_disk_status     sdh_status
+#define sdh_disk_read       sdh_read
+#define sdh_disk_write      sdh_write
+#define sdh_disk_ioctl      sdh_ioctl
 
-	case DEV_USB :
-		// translate the arguments here
+#endif /* DISKIO_CACHE_SECTORS */
 
-		result = USB_disk_read(buff, sector, count);
 
-		// translate the reslut code here
+/*-----------------------------------------------------------------------*/
+/* Card change and cache ageing, see diskio.h                            */
+/*-----------------------------------------------------------------------*/
 
-		return res;
-	}
+void disk_media_change (
+    BYTE pdrv       /* Physical drive number of the SD card */
+)
+{
+    if ((pdrv == DEV_SD0) || (pdrv == DEV_SD1))
+        s_au8MediaChange[pdrv] = 1;
+}
 
-	return RES_PARERR;
+DRESULT disk_cache_flush_aged (void)
+{
+    DRESULT res = RES_OK;
+#if DISKIO_CACHE_SECTORS
+    DRESULT r;
+    BYTE pdrv;
+
+    for (pdrv = DEV_SD0; pdrv <= DEV_SD1; pdrv++)
+    {
+        /* a port without dirty lines is not worth the lock; a line that
+           gets dirty right after this is seen on the next call */
+        if (s_asCache[pdrv].u32Dirty == 0)
+            continue;
+        if (cache_enter(pdrv, &r))
+        {
+            cache_unlock(pdrv);
+        }
+        else
+        {
+            r = RES_ERROR;
+        }
+        if (res == RES_OK)
+            res = r;
+    }
+#endif
+    return res;
 }
 
+#endif /* DISKIO_SDH */
 
 
+#if DISKIO_USBH
 /*-----------------------------------------------------------------------*/
-/* Write Sector(s)                                                       */
+/* USB mass storage                                                      */
 /*-----------------------------------------------------------------------*/
-
-DRESULT disk_write (
-	BYTE pdrv,			/* Physical drive nmuber to identify the drive */
-	const BYTE *buff,	/* Data to be written */
-	DWORD sector,		/* Start sector in LBA */
-	UINT count			/* Number of sectors to write */
-)
+/* The EHCI/OHCI transfer descriptors take byte aligned buffers, so any  */
+/* buffer and sector count is passed straight to READ(10)/WRITE(10).     */
+/* A failed transfer resets the device and is retried once.              */
+/*                                                                       */
+/* With FF_FS_REENTRANT, FatFs serialises the calls per volume only, but */
+/* all USB drives share one host stack. Every usbh_umas_* call is then   */
+/* made under one more sync object, created on first use in the spare    */
+/* slot FF_VOLUMES of ffsystem.c.                                        */
+
+#if FF_FS_REENTRANT
+static FF_SYNC_t s_UmasLock;
+static int s_iUmasLock;
+
+static int umas_lock(void)
 {
-	DRESULT res;
-	int result;
+    if (!s_iUmasLock)
+    {
+        ff_sys_lock();
+        if (!s_iUmasLock)
+            s_iUmasLock = ff_cre_syncobj(FF_VOLUMES, &s_UmasLock);
+        ff_sys_unlock();
+        if (!s_iUmasLock)
+            return 0;
+    }
+    return ff_req_grant(s_UmasLock);
+}
 
-	switch (pdrv) {
-	case DEV_RAM :
-		// translate the arguments here
+#define umas_unlock()   ff_rel_grant(s_UmasLock)
+#else
+#define umas_lock()     1
+#define umas_unlock()
+#endif
 
-		result = RAM_disk_write(buff, sector, count);
+static DRESULT umas_result(int ret)
+{
+    if (ret == UMAS_OK)
+        return RES_OK;
+    if ((ret == UMAS_ERR_NO_DEVICE) || (ret == UMAS_ERR_DRIVE_NOT_FOUND))
+        return RES_NOTRDY;
+    return RES_ERROR;
+}
 
-		// translate the reslut code here
+static DSTATUS umas_status(BYTE pdrv)
+{
+    int ret;
+
+    if (!umas_lock())
+        return STA_NOINIT;
+    usbh_pooling_hubs();
+    ret = usbh_umas_disk_status(pdrv);
+    umas_unlock();
+    if (ret != 0)
+        return STA_NOINIT | STA_NODISK;
+    return 0;
+}
 
-		return res;
+static DRESULT umas_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    int ret;
+
+    if (!umas_lock())
+        return RES_ERROR;
+    ret = usbh_umas_read(pdrv, sector, (int)count, buff);
+    if ((ret != UMAS_OK) && (ret != UMAS_ERR_DRIVE_NOT_FOUND))
+    {
+        usbh_umas_reset_disk(pdrv);
+        ret = usbh_umas_read(pdrv, sector, (int)count, buff);
+    }
+    umas_unlock();
+    return umas_result(ret);
+}
 
-	case DEV_MMC :
-		// translate the arguments here
+static DRESULT umas_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    int ret;
+
+    if (!umas_lock())
+        return RES_ERROR;
+    ret = usbh_umas_write(pdrv, sector, (int)count, (uint8_t *)(uintptr_t)buff);
+    if ((ret != UMAS_OK) && (ret != UMAS_ERR_DRIVE_NOT_FOUND))
+    {
+        usbh_umas_reset_disk(pdrv);
+        ret = usbh_umas_write(pdrv, sector, (int)count, (uint8_t *)(uintptr_t)buff);
+    }
+    umas_unlock();
+    return umas_result(ret);
+}
 
-		result = MMC_disk_write(buff, sector, count);
+static DRESULT umas_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    uint32_t u32Val;
+    int ret;
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        /* WRITE(10) completes with the device's status phase */
+        return RES_OK;
+
+    case GET_SECTOR_COUNT:
+        if (!umas_lock())
+            return RES_ERROR;
+        ret = usbh_umas_ioctl(pdrv, GET_SECTOR_COUNT, &u32Val);
+        umas_unlock();
+        if (ret == UMAS_OK)
+            *(DWORD *)buff = u32Val;
+        return umas_result(ret);
+
+    case GET_SECTOR_SIZE:
+        /* usbh_umas_ioctl stores 32 bits, FatFs passes a WORD */
+        if (!umas_lock())
+            return RES_ERROR;
+        ret = usbh_umas_ioctl(pdrv, GET_SECTOR_SIZE, &u32Val);
+        umas_unlock();
+        if (ret == UMAS_OK)
+            *(WORD *)buff = (WORD)u32Val;
+        return umas_result(ret);
+
+    case GET_BLOCK_SIZE:
+        /* erase block size is not reported over Bulk-Only Transport */
+        *(DWORD *)buff = 1;
+        return RES_OK;
+
+    case CTRL_TRIM:
+        /* no UNMAP in the MSC driver, the hint is dropped */
+        return RES_OK;
+
+    default:
+        return RES_PARERR;
+    }
+}
+#endif /* DISKIO_USBH */
 
-		// translate the reslut code here
 
-		return res;
+/*-----------------------------------------------------------------------*/
+/* Get Drive Status                                                      */
+/*-----------------------------------------------------------------------*/
 
-	case DEV_USB :
-		// translate the arguments here
+DSTATUS disk_status (
+    BYTE pdrv       /* Physical drive number to identify the drive */
+)
+{
+#if DISKIO_SDH
+    if ((pdrv == DEV_SD0) || (pdrv == DEV_SD1))
+        return sdh_disk_status(pdrv);
+#endif
+#if DISKIO_USBH
+    if (pdrv >= DEV_USB0)
+        return umas_status(pdrv);
+#endif
+    return STA_NOINIT;
+}
 
-		result = USB_disk_write(buff, sector, count);
 
-		// translate the reslut code here
 
-		return res;
-	}
+/*-----------------------------------------------------------------------*/
+/* Initialize a Drive                                                    */
+/*-----------------------------------------------------------------------*/
 
-	return RES_PARERR;
+DSTATUS disk_initialize (
+    BYTE pdrv       /* Physical drive number to identify the drive */
+)
+{
+    /* Cards and USB disks are brought up by SDH_Open_Disk() and the USB
+       host stack before f_mount(), only report their state here. */
+    return disk_status(pdrv);
 }
 
 
 
 /*-----------------------------------------------------------------------*/
-/* Miscellaneous Functions                                               */
+/* Read Sector(s)                                                        */
 /*-----------------------------------------------------------------------*/
 
-DRESULT disk_ioctl (
-	BYTE pdrv,		/* Physical drive nmuber (0..) */
-	BYTE cmd,		/* Control code */
-	void *buff		/* Buffer to send/receive control data */
+DRESULT disk_read (
+    BYTE pdrv,      /* Physical drive number to identify the drive */
+    BYTE *buff,     /* Data buffer to store read data */
+    DWORD sector,   /* Start sector in LBA */
+    UINT count      /* Number of sectors to read */
 )
 {
-	DRESULT res;
-	int result;
+    if (count == 0)
+        return RES_PARERR;
+#if DISKIO_SDH
+    if ((pdrv == DEV_SD0) || (pdrv == DEV_SD1))
+        return sdh_disk_read(pdrv, buff, sector, count);
+#endif
+#if DISKIO_USBH
+    if (pdrv >= DEV_USB0)
+        return umas_read(pdrv, buff, sector, count);
+#endif
+    return RES_PARERR;
+}
 
-	switch (pdrv) {
-	case DEV_RAM :
 
-		// Process of the command for the RAM drive
 
-		return res;
+/*-----------------------------------------------------------------------*/
+/* Write Sector(s)                                                       */
+/*-----------------------------------------------------------------------*/
 
-	case DEV_MMC :
+#if FF_FS_READONLY == 0
 
-		// Process of the command for the MMC/SD card
+DRESULT disk_write (
+    BYTE pdrv,          /* Physical drive number to identify the drive */
+    const BYTE *buff,   /* Data to be written */
+    DWORD sector,       /* Start sector in LBA */
+    UINT count          /* Number of sectors to write */
+)
+{
+    if (count == 0)
+        return RES_PARERR;
+#if DISKIO_SDH
+    if ((pdrv == DEV_SD0) || (pdrv == DEV_SD1))
+        return sdh_disk_write(pdrv, buff, sector, count);
+#endif
+#if DISKIO_USBH
+    if (pdrv >= DEV_USB0)
+        return umas_write(pdrv, buff, sector, count);
+#endif
+    return RES_PARERR;
+}
 
-		return res;
+#endif
 
-	case DEV_USB :
 
-		// Process of the command the USB drive
 
-		return res;
-	}
+/*-----------------------------------------------------------------------*/
+/* Miscellaneous Functions                                               */
+/*-----------------------------------------------------------------------*/
 
-	return RES_PARERR;
+DRESULT disk_ioctl (
+    BYTE pdrv,      /* Physical drive number (0..) */
+    BYTE cmd,       /* Control code */
+    void *buff      /* Buffer to send/receive control data */
+)
+{
+#if DISKIO_SDH
+    if ((pdrv == DEV_SD0) || (pdrv == DEV_SD1))
+        return sdh_disk_ioctl(pdrv, cmd, buff);
+#endif
+#if DISKIO_USBH
+    if (pdrv >= DEV_USB0)
+        return umas_ioctl(pdrv, cmd, buff);
+#endif
+    return RES_PARERR;
 }
-
@@ -35,6 +35,12 @@ DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 
+/* M460 diskio.c: SD card changed, call from the card detect interrupt */
+void disk_media_change (BYTE pdrv);
+/* Write back SD cache lines older than DISKIO_CACHE_MAX_AGE. Call it
+   periodically from a task or the main loop, not from an interrupt. */
+DRESULT disk_cache_flush_aged (void);
+
 
 /* Disk Status Bits (DSTATUS) */
 
@@ -913,6 +913,38 @@ void unlock_fs (
 /*-----------------------------------------------------------------------*/
 /* File lock control functions                                           */
 /*-----------------------------------------------------------------------*/
+/* Files[] is shared by all volumes, while a volume lock only keeps out  */
+/* the tasks on that volume. The table has a sync object of its own,    */
+/* taken after the volume lock. f_open() holds it from the check to the  */
+/* registration of the file, so a task on another volume cannot take the */
+/* entry the check found free.                                           */
+
+#if FF_FS_REENTRANT
+static FF_SYNC_t FilesSobj;	/* Sync object of Files[] */
+static int FilesSobjOk;
+
+static
+int cre_files_lock (void)	/* Called by f_mount(), 1:Ok, 0:Could not create it */
+{
+	if (!FilesSobjOk) {
+		ff_sys_lock();
+		if (!FilesSobjOk) FilesSobjOk = ff_cre_syncobj(FF_VOLUMES + 1, &FilesSobj);
+		ff_sys_unlock();
+	}
+	return FilesSobjOk;
+}
+
+static
+void lock_files (void)
+{
+	while (!ff_req_grant(FilesSobj)) ;	/* Held over one f_open() at most */
+}
+#define LOCK_FILES()	lock_files()
+#define UNLOCK_FILES()	ff_rel_grant(FilesSobj)
+#else
+#define LOCK_FILES()
+#define UNLOCK_FILES()
+#endif
 
 static
 FRESULT chk_lock (	/* Check if the file can be accessed */
@@ -994,11 +1026,13 @@ FRESULT dec_lock (	/* Decrement object open counter */
 
 
 	if (--i < FF_FS_LOCK) {	/* Index number origin from 0 */
+		LOCK_FILES();
 		n = Files[i].ctr;
 		if (n == 0x100) n = 0;		/* If write mode open, delete the entry */
 		if (n > 0) n--;				/* Decrement read mode open count */
 		Files[i].ctr = n;
 		if (n == 0) Files[i].fs = 0;	/* Delete the entry if open count gets zero */
+		UNLOCK_FILES();
 		res = FR_OK;
 	} else {
 		res = FR_INT_ERR;			/* Invalid index nunber */
@@ -1014,9 +1048,11 @@ void clear_lock (	/* Clear lock entries of the volume */
 {
 	UINT i;
 
+	LOCK_FILES();
 	for (i = 0; i < FF_FS_LOCK; i++) {
 		if (Files[i].fs == fs) Files[i].fs = 0;
 	}
+	UNLOCK_FILES();
 }
 
 #endif	/* FF_FS_LOCK != 0 */
@@ -3521,6 +3557,9 @@ FRESULT f_mount (
 		fs->fs_type = 0;				/* Clear new fs object */
 #if FF_FS_REENTRANT						/* Create sync object for the new volume */
 		if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
+#if FF_FS_LOCK != 0
+		if (!cre_files_lock()) return FR_INT_ERR;
+#endif
 #endif
 	}
 	FatFs[vol] = fs;					/* Register new fs object */
@@ -3564,6 +3603,9 @@ FRESULT f_open (
 		INIT_NAMBUF(fs);
 		res = follow_path(&dj, path);	/* Follow the file path */
 #if !FF_FS_READONLY	/* Read/Write configuration */
+#if FF_FS_LOCK != 0
+		LOCK_FILES();	/* Keep the entry found free until the file is registered */
+#endif
 		if (res == FR_OK) {
 			if (dj.fn[NSFLAG] & NS_NONAME) {	/* Origin directory itself? */
 				res = FR_INVALID_NAME;
@@ -3651,6 +3693,9 @@ FRESULT f_open (
 			if (fp->obj.lockid == 0) res = FR_INT_ERR;
 #endif
 		}
+#if FF_FS_LOCK != 0
+		UNLOCK_FILES();
+#endif
 #else		/* R/O configuration */
 		if (res == FR_OK) {
 			if (dj.fn[NSFLAG] & NS_NONAME) {	/* Is it origin directory itself? */
@@ -4420,7 +4465,9 @@ FRESULT f_opendir (
 #if FF_FS_LOCK != 0
 				if (res == FR_OK) {
 					if (dp->obj.sclust != 0) {
+						LOCK_FILES();
 						dp->obj.lockid = inc_lock(dp, 0);	/* Lock the sub directory */
+						UNLOCK_FILES();
 						if (!dp->obj.lockid) res = FR_TOO_MANY_OPEN_FILES;
 					} else {
 						dp->obj.lockid = 0;	/* Root directory need not to be locked */
@@ -4760,7 +4807,11 @@ FRESULT f_unlink (
 			res = FR_INVALID_NAME;			/* Cannot remove dot entry */
 		}
 #if FF_FS_LOCK != 0
-		if (res == FR_OK) res = chk_lock(&dj, 2);	/* Check if it is an open object */
+		if (res == FR_OK) {
+			LOCK_FILES();
+			res = chk_lock(&dj, 2);		/* Check if it is an open object */
+			UNLOCK_FILES();
+		}
 #endif
 		if (res == FR_OK) {					/* The object is accessible */
 			if (dj.fn[NSFLAG] & NS_NONAME) {
@@ -4940,7 +4991,9 @@ FRESULT f_rename (
 		if (res == FR_OK && (djo.fn[NSFLAG] & (NS_DOT | NS_NONAME))) res = FR_INVALID_NAME;	/* Check validity of name */
 #if FF_FS_LOCK != 0
 		if (res == FR_OK) {
+			LOCK_FILES();
 			res = chk_lock(&djo, 2);
+			UNLOCK_FILES();
 		}
 #endif
 		if (res == FR_OK) {						/* Object to be renamed is found */
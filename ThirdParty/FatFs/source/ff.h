@@ -317,6 +317,8 @@ int ff_cre_syncobj (BYTE vol, FF_SYNC_t* sobj);	/* Create a sync object */
 int ff_req_grant (FF_SYNC_t sobj);		/* Lock sync object */
 void ff_rel_grant (FF_SYNC_t sobj);		/* Unlock sync object */
 int ff_del_syncobj (FF_SYNC_t sobj);	/* Delete a sync object */
+void ff_sys_lock (void);				/* Enter a short section over data of all volumes */
+void ff_sys_unlock (void);				/* Leave it */
 #endif
 
 
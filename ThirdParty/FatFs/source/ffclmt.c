@@ -0,0 +1,101 @@
+/*-----------------------------------------------------------------------*/
+/* Cluster link map (fast seek) helpers for FatFs                        */
+/*-----------------------------------------------------------------------*/
+/* Build options, override on the compiler command line:                 */
+/*   FF_CLMT_MALLOC/FF_CLMT_FREE   heap used by f_clmt_alloc() (default  */
+/*                                 malloc/free)                          */
+/*   FF_CLMT_PROBE                 items of the table built on the stack */
+/*                                 to size the heap block (default 16)   */
+/*-----------------------------------------------------------------------*/
+#include <string.h>
+
+#include "ff.h"
+#include "ffclmt.h"
+
+#if FF_USE_FASTSEEK
+
+#ifndef FF_CLMT_MALLOC
+#include <stdlib.h>
+#define FF_CLMT_MALLOC(size)    malloc(size)
+#define FF_CLMT_FREE(ptr)       free(ptr)
+#endif
+
+#ifndef FF_CLMT_PROBE
+#define FF_CLMT_PROBE           FF_CLMT_ITEMS(7)
+#endif
+
+
+FRESULT f_clmt_attach(FIL *fp, DWORD *tbl, UINT items)
+{
+    FRESULT res;
+
+    fp->cltbl = 0;
+#if !FF_FS_READONLY
+    if (fp->flag & FA_WRITE)
+        return FR_DENIED;
+#endif
+    if ((tbl == 0) || (items < FF_CLMT_ITEMS(0)))
+        return FR_INVALID_PARAMETER;
+
+    tbl[0] = items;
+    fp->cltbl = tbl;
+    res = f_lseek(fp, CREATE_LINKMAP);
+    if (res != FR_OK)
+        fp->cltbl = 0;
+
+    return res;
+}
+
+
+/* Most media files are in a few fragments: the probe table on the stack
+ * then already holds the complete map and is copied, so the FAT chain is
+ * walked only once. A longer chain is walked again into a block of the
+ * size the probe reported. */
+FRESULT f_clmt_alloc(FIL *fp, UINT max_items)
+{
+    DWORD probe[FF_CLMT_PROBE];
+    DWORD *tbl;
+    UINT need;
+    FRESULT res;
+
+    if (max_items == 0)
+        max_items = FF_CLMT_MAX_ITEMS;
+
+    res = f_clmt_attach(fp, probe, FF_CLMT_PROBE);
+    fp->cltbl = 0;
+    if ((res != FR_OK) && (res != FR_NOT_ENOUGH_CORE))
+        return res;
+
+    need = (UINT)probe[0];
+    if (need > max_items)
+        return FR_NOT_ENOUGH_CORE;
+
+    tbl = (DWORD *)FF_CLMT_MALLOC(need * sizeof(DWORD));
+    if (tbl == 0)
+        return FR_NOT_ENOUGH_CORE;
+
+    if (res == FR_OK)
+    {
+        memcpy(tbl, probe, need * sizeof(DWORD));
+        fp->cltbl = tbl;
+        return FR_OK;
+    }
+
+    res = f_clmt_attach(fp, tbl, need);
+    if (res != FR_OK)
+        FF_CLMT_FREE(tbl);
+
+    return res;
+}
+
+
+void f_clmt_free(FIL *fp)
+{
+    if (fp->cltbl)
+    {
+        FF_CLMT_FREE(fp->cltbl);
+        fp->cltbl = 0;
+    }
+}
+
+#endif /* FF_USE_FASTSEEK */
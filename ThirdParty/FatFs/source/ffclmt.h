@@ -0,0 +1,53 @@
+/*-----------------------------------------------------------------------*/
+/* Cluster link map (fast seek) helpers for FatFs                        */
+/*-----------------------------------------------------------------------*/
+/* With FF_USE_FASTSEEK, f_lseek() and f_read() look the cluster of a    */
+/* file offset up in a cluster link map table (CLMT) instead of walking  */
+/* the FAT chain from the top of the file. These helpers size, build and */
+/* attach the table to an open file. A file whose table does not fit     */
+/* keeps working with the normal seek, so the result is only a hint.     */
+/*                                                                       */
+/* The table holds two DWORDs per fragment of the file plus two. A file  */
+/* in fast seek mode cannot grow, so only files opened without FA_WRITE  */
+/* are accepted.                                                         */
+/*-----------------------------------------------------------------------*/
+#ifndef FF_CLMT_DEFINED
+#define FF_CLMT_DEFINED
+
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if FF_USE_FASTSEEK
+
+/* Items of the table needed for a file of n fragments */
+#define FF_CLMT_ITEMS(n)    (2 * (n) + 2)
+
+/* Default limit of f_clmt_alloc(), 127 fragments in 1 KB */
+#ifndef FF_CLMT_MAX_ITEMS
+#define FF_CLMT_MAX_ITEMS   FF_CLMT_ITEMS(127)
+#endif
+
+/* Build the table in caller storage of the given number of items. On
+ * FR_NOT_ENOUGH_CORE, tbl[0] is the number of items the file needs and
+ * the file is left in normal seek mode. */
+FRESULT f_clmt_attach(FIL *fp, DWORD *tbl, UINT items);
+
+/* Build the table in a heap block of exactly the size the file needs,
+ * up to max_items (0 for FF_CLMT_MAX_ITEMS). Release it with
+ * f_clmt_free(), before or after f_close(). */
+FRESULT f_clmt_alloc(FIL *fp, UINT max_items);
+void f_clmt_free(FIL *fp);
+
+/* Back to normal seek without releasing anything */
+#define f_clmt_detach(fp)   ((fp)->cltbl = 0)
+
+#endif /* FF_USE_FASTSEEK */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FF_CLMT_DEFINED */
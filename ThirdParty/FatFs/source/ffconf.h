@@ -42,11 +42,11 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_FASTSEEK	0
+#define FF_USE_FASTSEEK	1
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_EXPAND	0
+#define FF_USE_EXPAND	1
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
 
@@ -244,7 +244,9 @@
 /  These options have no effect at read-only configuration (FF_FS_READONLY = 1). */
 
 
+#ifndef FF_FS_LOCK
 #define FF_FS_LOCK		0
+#endif
 /* The option FF_FS_LOCK switches file lock function to control duplicated file open
 /  and illegal operation to open objects. This option must be 0 when FF_FS_READONLY
 /  is 1.
@@ -256,9 +258,11 @@
 /      lock control is independent of re-entrancy. */
 
 
+#ifndef FF_FS_REENTRANT
 #define FF_FS_REENTRANT	0
-#define FF_FS_TIMEOUT	1000
-#define FF_SYNC_t		HANDLE
+#endif
+#define FF_FS_TIMEOUT	pdMS_TO_TICKS(1000)
+#define FF_SYNC_t		SemaphoreHandle_t
 /* The option FF_FS_REENTRANT switches the re-entrancy (thread safe) of the FatFs
 /  module itself. Note that regardless of this option, file access to different
 /  volume is always re-entrant and volume control functions, f_mount(), f_mkfs()
@@ -274,9 +278,16 @@
 /  The FF_FS_TIMEOUT defines timeout period in unit of time tick.
 /  The FF_SYNC_t defines O/S dependent sync object type. e.g. HANDLE, ID, OS_EVENT*,
 /  SemaphoreHandle_t and etc. A header file for O/S definitions needs to be
-/  included somewhere in the scope of ff.h. */
-
-/* #include <windows.h>	// O/S definitions  */
+/  included somewhere in the scope of ff.h.
+/
+/  ffsystem.c binds FreeRTOS: a mutex per volume, and one more for the file
+/  lock table that all volumes share. Projects set FF_FS_REENTRANT (and
+/  FF_FS_LOCK) on the compiler command line. */
+
+#if FF_FS_REENTRANT
+#include "FreeRTOS.h"	/* O/S definitions */
+#include "semphr.h"
+#endif
 
 
 
@@ -0,0 +1,185 @@
+/*-----------------------------------------------------------------------*/
+/* Contiguous streaming writer for FatFs                                 */
+/*-----------------------------------------------------------------------*/
+/* The reserved sectors are written with disk_write(), not the SDH or    */
+/* USB driver, so the write-back cache of diskio.c stays coherent. With  */
+/* FF_FS_REENTRANT the writes are made under the volume lock.            */
+/*-----------------------------------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "ffstream.h"
+
+#if FF_USE_EXPAND && !FF_FS_READONLY
+
+#if FF_MAX_SS != FF_MIN_SS
+#error "ffstream.c supports a fixed sector size only"
+#endif
+
+#define SS              FF_MAX_SS
+
+#if FF_FS_REENTRANT
+#define LOCK_FS(fs)     ff_req_grant((fs)->sobj)
+#define UNLOCK_FS(fs)   ff_rel_grant((fs)->sobj)
+#else
+#define LOCK_FS(fs)     1
+#define UNLOCK_FS(fs)
+#endif
+
+
+/* Write n bytes, whole sectors, to the reserve at the stream offset */
+static FRESULT stream_put(FSTREAM *st, const BYTE *data, UINT n)
+{
+    FATFS *fs = st->fp->obj.fs;
+    FRESULT res = FR_OK;
+
+    if ((fs == 0) || !LOCK_FS(fs))
+        return (fs == 0) ? FR_INVALID_OBJECT : FR_TIMEOUT;
+    if (fs->id != st->fp->obj.id)
+        res = FR_INVALID_OBJECT;    /* volume mounted again */
+    else if (disk_write(fs->pdrv, data, st->sect + (DWORD)(st->ofs / SS), n / SS) != RES_OK)
+        res = FR_DISK_ERR;
+    UNLOCK_FS(fs);
+
+    if (res == FR_OK)
+        st->ofs += n;
+    return res;
+}
+
+
+FRESULT f_stream_open(FSTREAM *st, FIL *fp, const TCHAR *path, FSIZE_t size,
+                      void *buf, UINT bufsize)
+{
+    FRESULT res;
+    DWORD csz;
+
+    memset(st, 0, sizeof(*st));
+    if ((buf == 0) || (bufsize == 0) || (bufsize % SS))
+        return FR_INVALID_PARAMETER;
+
+    res = f_open(fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK)
+        return res;
+
+    st->fp = fp;
+    st->buf = (BYTE *)buf;
+    st->bufsize = bufsize;
+    if (size == 0)
+        return FR_OK;
+
+    csz = (DWORD)fp->obj.fs->csize * SS;
+    size = (size + csz - 1) / csz * csz;
+    res = f_expand(fp, size, 1);
+    if (res == FR_DENIED)
+        return FR_OK;               /* no run that long, f_write() only */
+
+    /* Put the allocation on the disk before any data goes to it */
+    if (res == FR_OK)
+        res = f_sync(fp);
+    if (res != FR_OK)
+    {
+        f_close(fp);
+        return res;
+    }
+
+    st->sect = fp->obj.fs->database + fp->obj.fs->csize * (fp->obj.sclust - 2);
+    st->size = size;
+    return FR_OK;
+}
+
+
+FRESULT f_stream_write(FSTREAM *st, const void *data, UINT len, UINT *bw)
+{
+    const BYTE *p = (const BYTE *)data;
+    FSIZE_t room;
+    FRESULT res = FR_OK;
+    UINT n;
+
+    *bw = 0;
+    if (st->fp == 0)
+        return FR_INVALID_OBJECT;
+    while (len)
+    {
+        room = st->size - st->ofs - st->fill;
+        if (room == 0)
+        {
+            /* Past the reserve: append after it */
+            if (f_tell(st->fp) < st->size)
+                res = f_lseek(st->fp, st->size);
+            if (res == FR_OK)
+                res = f_write(st->fp, p, len, &n);
+            if (res == FR_OK)
+                *bw += n;
+            return res;
+        }
+
+        if ((st->fill == 0) && (len >= SS) && (((uintptr_t)p & 3) == 0))
+        {
+            /* Whole sectors of an aligned buffer go straight to the disk */
+            n = len / SS * SS;
+            if (n > room)
+                n = (UINT)room;
+            res = stream_put(st, p, n);
+        }
+        else
+        {
+            n = st->bufsize - st->fill;
+            if (n > len)
+                n = len;
+            if (n > room)
+                n = (UINT)room;
+            memcpy(st->buf + st->fill, p, n);
+            st->fill += n;
+            if ((st->fill == st->bufsize) || (n == room))
+            {
+                res = stream_put(st, st->buf, st->fill);
+                if (res == FR_OK)
+                    st->fill = 0;
+                else
+                    st->fill -= n;  /* leave the stream as it was */
+            }
+        }
+        if (res != FR_OK)
+            return res;
+        p += n;
+        len -= n;
+        *bw += n;
+    }
+    return FR_OK;
+}
+
+
+FRESULT f_stream_close(FSTREAM *st)
+{
+    FSIZE_t fsz = st->ofs + st->fill;
+    FRESULT res = FR_OK, rc;
+    UINT n;
+
+    if (st->fp == 0)
+        return FR_INVALID_OBJECT;
+
+    if (fsz < st->size)
+    {
+        /* Pad the last sector, then give the rest of the reserve back */
+        if (st->fill)
+        {
+            n = (st->fill + SS - 1) / SS * SS;
+            memset(st->buf + st->fill, 0, n - st->fill);
+            res = stream_put(st, st->buf, n);
+        }
+        if (res == FR_OK)
+            res = f_lseek(st->fp, fsz);
+        if (res == FR_OK)
+            res = f_truncate(st->fp);
+    }
+    rc = f_close(st->fp);
+    if (res == FR_OK)
+        res = rc;
+
+    st->fp = 0;
+    return res;
+}
+
+#endif /* FF_USE_EXPAND && !FF_FS_READONLY */
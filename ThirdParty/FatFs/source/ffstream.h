@@ -0,0 +1,58 @@
+/*-----------------------------------------------------------------------*/
+/* Contiguous streaming writer for FatFs                                 */
+/*-----------------------------------------------------------------------*/
+/* f_write() allocates a file one cluster at a time, so a long recording */
+/* keeps updating the FAT in between its data. A stream reserves one     */
+/* contiguous cluster run with f_expand() when the file is created, then */
+/* collects the data in a caller buffer and writes it to the reserved    */
+/* sectors with disk_write() of the whole buffer. The FAT and directory  */
+/* are not touched again until f_stream_close() cuts the file down to    */
+/* the bytes written.                                                    */
+/*                                                                       */
+/* Data past the reserve, or all of it when the volume has no free run   */
+/* that long, goes through f_write() as usual. Until the stream is       */
+/* closed the file has the reserved size on the disk, with the unwritten */
+/* part undefined.                                                       */
+/*-----------------------------------------------------------------------*/
+#ifndef FF_STREAM_DEFINED
+#define FF_STREAM_DEFINED
+
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if FF_USE_EXPAND && !FF_FS_READONLY
+
+typedef struct
+{
+    FIL     *fp;        /* File object the stream writes to */
+    DWORD   sect;       /* First sector of the reserved area */
+    FSIZE_t size;       /* Bytes reserved, whole clusters (0: not reserved) */
+    FSIZE_t ofs;        /* Bytes written to the disk */
+    BYTE    *buf;       /* Collects the data up to whole sectors */
+    UINT    bufsize;
+    UINT    fill;       /* Bytes in buf */
+} FSTREAM;
+
+/* Create path and reserve size bytes for it. buf takes bufsize bytes, a
+ * multiple of the sector size; the longer it is, the fewer and longer the
+ * disk writes. It should be word aligned for the SDH DMA. */
+FRESULT f_stream_open(FSTREAM *st, FIL *fp, const TCHAR *path, FSIZE_t size,
+                      void *buf, UINT bufsize);
+FRESULT f_stream_write(FSTREAM *st, const void *data, UINT len, UINT *bw);
+
+/* Write the last sector, set the file size and close the file */
+FRESULT f_stream_close(FSTREAM *st);
+
+/* Bytes of the file held by the contiguous area, 0 if it got none */
+#define f_stream_reserved(st)   ((st)->size)
+
+#endif /* FF_USE_EXPAND && !FF_FS_READONLY */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FF_STREAM_DEFINED */
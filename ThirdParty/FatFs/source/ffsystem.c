@@ -39,6 +39,20 @@ void ff_memfree (
 
 #if FF_FS_REENTRANT	/* Mutal exclusion */
 
+#include "task.h"
+
+/* The sync objects are FreeRTOS mutexes, one per volume. Index FF_VOLUMES
+/  is one more for the USB host stack behind all USB drives (diskio.c),
+/  FF_VOLUMES + 1 the one for the open object table of FF_FS_LOCK (ff.c),
+/  FF_VOLUMES + 2 and + 3 those of the SD caches of SDH0/SDH1 (diskio.c).
+/  Other O/S bindings are left as comments. */
+
+#if configSUPPORT_STATIC_ALLOCATION
+static StaticSemaphore_t Mutex[FF_VOLUMES + 4];	/* FreeRTOS */
+#endif
+//const osMutexDef_t Mutex[FF_VOLUMES];	/* CMSIS-RTOS */
+
+
 /*------------------------------------------------------------------------*/
 /* Create a Synchronization Object                                        */
 /*------------------------------------------------------------------------*/
@@ -47,17 +61,23 @@ void ff_memfree (
 /  When a 0 is returned, the f_mount() function fails with FR_INT_ERR.
 */
 
-//const osMutexDef_t Mutex[FF_VOLUMES];	/* CMSIS-RTOS */
-
-
 int ff_cre_syncobj (	/* 1:Function succeeded, 0:Could not create the sync object */
 	BYTE vol,			/* Corresponding volume (logical drive number) */
 	FF_SYNC_t *sobj		/* Pointer to return the created sync object */
 )
 {
+	/* FreeRTOS */
+#if configSUPPORT_STATIC_ALLOCATION
+	if (vol > FF_VOLUMES + 3) return 0;
+	*sobj = xSemaphoreCreateMutexStatic(&Mutex[vol]);
+#else
+	*sobj = xSemaphoreCreateMutex();
+#endif
+	return (int)(*sobj != NULL);
+
 	/* Win32 */
-	*sobj = CreateMutex(NULL, FALSE, NULL);
-	return (int)(*sobj != INVALID_HANDLE_VALUE);
+//	*sobj = CreateMutex(NULL, FALSE, NULL);
+//	return (int)(*sobj != INVALID_HANDLE_VALUE);
 
 	/* uITRON */
 //	T_CSEM csem = {TA_TPRI,1,1};
@@ -69,10 +89,6 @@ int ff_cre_syncobj (	/* 1:Function succeeded, 0:Could not create the sync object
 //	*sobj = OSMutexCreate(0, &err);
 //	return (int)(err == OS_NO_ERR);
 
-	/* FreeRTOS */
-//	*sobj = xSemaphoreCreateMutex();
-//	return (int)(*sobj != NULL);
-
 	/* CMSIS-RTOS */
 //	*sobj = osMutexCreate(Mutex + vol);
 //	return (int)(*sobj != NULL);
@@ -91,8 +107,12 @@ int ff_del_syncobj (	/* 1:Function succeeded, 0:Could not delete due to an error
 	FF_SYNC_t sobj		/* Sync object tied to the logical drive to be deleted */
 )
 {
+	/* FreeRTOS */
+	vSemaphoreDelete(sobj);
+	return 1;
+
 	/* Win32 */
-	return (int)CloseHandle(sobj);
+//	return (int)CloseHandle(sobj);
 
 	/* uITRON */
 //	return (int)(del_sem(sobj) == E_OK);
@@ -102,10 +122,6 @@ int ff_del_syncobj (	/* 1:Function succeeded, 0:Could not delete due to an error
 //	OSMutexDel(sobj, OS_DEL_ALWAYS, &err);
 //	return (int)(err == OS_NO_ERR);
 
-	/* FreeRTOS */
-//  vSemaphoreDelete(sobj);
-//	return 1;
-
 	/* CMSIS-RTOS */
 //	return (int)(osMutexDelete(sobj) == osOK);
 }
@@ -122,8 +138,11 @@ int ff_req_grant (	/* 1:Got a grant to access the volume, 0:Could not get a gran
 	FF_SYNC_t sobj	/* Sync object to wait */
 )
 {
+	/* FreeRTOS */
+	return (int)(xSemaphoreTake(sobj, FF_FS_TIMEOUT) == pdTRUE);
+
 	/* Win32 */
-	return (int)(WaitForSingleObject(sobj, FF_FS_TIMEOUT) == WAIT_OBJECT_0);
+//	return (int)(WaitForSingleObject(sobj, FF_FS_TIMEOUT) == WAIT_OBJECT_0);
 
 	/* uITRON */
 //	return (int)(wai_sem(sobj) == E_OK);
@@ -133,9 +152,6 @@ int ff_req_grant (	/* 1:Got a grant to access the volume, 0:Could not get a gran
 //	OSMutexPend(sobj, FF_FS_TIMEOUT, &err));
 //	return (int)(err == OS_NO_ERR);
 
-	/* FreeRTOS */
-//	return (int)(xSemaphoreTake(sobj, FF_FS_TIMEOUT) == pdTRUE);
-
 	/* CMSIS-RTOS */
 //	return (int)(osMutexWait(sobj, FF_FS_TIMEOUT) == osOK);
 }
@@ -151,8 +167,11 @@ void ff_rel_grant (
 	FF_SYNC_t sobj	/* Sync object to be signaled */
 )
 {
+	/* FreeRTOS */
+	xSemaphoreGive(sobj);
+
 	/* Win32 */
-	ReleaseMutex(sobj);
+//	ReleaseMutex(sobj);
 
 	/* uITRON */
 //	sig_sem(sobj);
@@ -160,12 +179,31 @@ void ff_rel_grant (
 	/* uC/OS-II */
 //	OSMutexPost(sobj);
 
-	/* FreeRTOS */
-//	xSemaphoreGive(sobj);
-
 	/* CMSIS-RTOS */
 //	osMutexRelease(sobj);
 }
 
-#endif
 
+/*------------------------------------------------------------------------*/
+/* Enter/Leave a Section over Data of All Volumes                         */
+/*------------------------------------------------------------------------*/
+/* The volume locks do not cover what all volumes share: the creation of
+/  the USB and cache locks in diskio.c and of the open object table lock
+/  in ff.c. The sections are short and never block, so the scheduler is
+/  just held off.
+*/
+
+void ff_sys_lock (void)
+{
+	/* FreeRTOS */
+	vTaskSuspendAll();
+}
+
+
+void ff_sys_unlock (void)
+{
+	/* FreeRTOS */
+	(void)xTaskResumeAll();
+}
+
+#endif
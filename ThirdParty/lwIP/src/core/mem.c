@@ -62,6 +62,10 @@
 
 #include <string.h>
 
+#ifdef LWIP_HOOK_FILENAME
+#include LWIP_HOOK_FILENAME
+#endif
+
 #if MEM_LIBC_MALLOC
 #include <stdlib.h> /* for malloc()/free() */
 #endif
@@ -675,6 +679,9 @@ mem_free(void *rmem)
   }
 
   MEM_STATS_DEC_USED(used, mem->next - (mem_size_t)(((u8_t *)mem - ram)));
+#ifdef LWIP_HOOK_MEM_FREE
+  LWIP_HOOK_MEM_FREE((mem_size_t)(mem->next - mem_to_ptr(mem) - (SIZEOF_STRUCT_MEM + MEM_SANITY_OVERHEAD)));
+#endif
 
   /* finally, see if prev or next are free also */
   plug_holes(mem);
@@ -808,6 +815,9 @@ mem_trim(void *rmem, mem_size_t new_size)
     -> don't do anyhting.
     -> the remaining space stays unused since it is too small
   } */
+#ifdef LWIP_HOOK_MEM_TRIM
+  LWIP_HOOK_MEM_TRIM(size, (mem_size_t)(mem->next - ptr - (SIZEOF_STRUCT_MEM + MEM_SANITY_OVERHEAD)));
+#endif
 #if MEM_OVERFLOW_CHECK
   mem_overflow_init_element(mem, new_size);
 #endif
@@ -925,6 +935,9 @@ mem_malloc(mem_size_t size_in)
           mem->used = 1;
           MEM_STATS_INC_USED(used, mem->next - mem_to_ptr(mem));
         }
+#ifdef LWIP_HOOK_MEM_MALLOC
+        LWIP_HOOK_MEM_MALLOC(size_in, (mem_size_t)(mem->next - ptr - (SIZEOF_STRUCT_MEM + MEM_SANITY_OVERHEAD)));
+#endif
 #if LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT
 mem_malloc_adjust_lfree:
 #endif /* LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT */
@@ -969,6 +982,9 @@ mem_malloc_adjust_lfree:
   } while (local_mem_free_count != 0);
 #endif /* LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT */
   MEM_STATS_INC(err);
+#ifdef LWIP_HOOK_MEM_MALLOC
+  LWIP_HOOK_MEM_MALLOC(size_in, 0);
+#endif
   LWIP_MEM_ALLOC_UNPROTECT();
   sys_mutex_unlock(&mem_mutex);
   LWIP_DEBUGF(MEM_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("mem_malloc: could not allocate %"S16_F" bytes\n", (s16_t)size));
@@ -3220,6 +3220,53 @@
 #ifdef __DOXYGEN__
 #define LWIP_HOOK_NETCONN_EXTERNAL_RESOLVE(name, addr, addrtype, err)
 #endif
+
+/**
+ * LWIP_HOOK_MEM_MALLOC(size, usable):
+ * Called from mem_malloc() (heap allocator only, not with MEM_LIBC_MALLOC or
+ * MEM_USE_POOLS) with the heap locked, once per call that got past the size
+ * checks. Signature:\code{.c}
+ *   void my_hook(mem_size_t size, mem_size_t usable);
+ * \endcode
+ * Arguments:
+ * - size: requested size
+ * - usable: user data size of the block handed out (>= size, rounded up
+ *           to alignment and MIN_SIZE) or 0 if the allocation failed
+ *
+ * Together with LWIP_HOOK_MEM_FREE and LWIP_HOOK_MEM_TRIM this allows
+ * tracking heap usage by allocation size. Must not call into mem_*().
+ */
+#ifdef __DOXYGEN__
+#define LWIP_HOOK_MEM_MALLOC(size, usable)
+#endif
+
+/**
+ * LWIP_HOOK_MEM_FREE(usable):
+ * Called from mem_free() with the heap locked for every legal free.
+ * Signature:\code{.c}
+ *   void my_hook(mem_size_t usable);
+ * \endcode
+ * Arguments:
+ * - usable: user data size of the block, as passed to LWIP_HOOK_MEM_MALLOC
+ */
+#ifdef __DOXYGEN__
+#define LWIP_HOOK_MEM_FREE(usable)
+#endif
+
+/**
+ * LWIP_HOOK_MEM_TRIM(old_usable, new_usable):
+ * Called from mem_trim() with the heap locked after a block was shrunk.
+ * Signature:\code{.c}
+ *   void my_hook(mem_size_t old_usable, mem_size_t new_usable);
+ * \endcode
+ * Arguments:
+ * - old_usable: user data size before the call
+ * - new_usable: user data size after the call (equal to old_usable if the
+ *               remainder was too small to split off)
+ */
+#ifdef __DOXYGEN__
+#define LWIP_HOOK_MEM_TRIM(old_usable, new_usable)
+#endif
 /**
  * @}
  */
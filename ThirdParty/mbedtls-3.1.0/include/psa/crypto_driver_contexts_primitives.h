@@ -89,6 +89,26 @@ typedef struct {
 
 #endif /* PSA_CRYPTO_DRIVER_TEST */
 
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+/* AES operation of the M460 CRPT drivers, see
+ * Library/CryptoAccelerator/psa_crypto_driver_crpt.c. The key is either
+ * copied (transparent) or referenced by its Key Store SRAM number (opaque). */
+typedef struct {
+    psa_algorithm_t alg;
+    uint32_t keysz;         /* AES_KEY_SIZE_xxx */
+    int32_t ks_idx;         /* Key Store SRAM key number, -1 if in key[] */
+    uint32_t key[8];        /* Big-endian key words */
+    uint8_t iv[16];         /* Chaining value or counter block */
+    uint8_t buf[16];        /* Partial block, or CTR key stream */
+    uint8_t buf_len;
+    unsigned int encrypt : 1;
+    unsigned int iv_required : 1;
+    unsigned int iv_set : 1;
+} nu_crpt_cipher_operation_t;
+
+#define NU_CRPT_CIPHER_OPERATION_INIT { 0 }
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
+
 /* Define the context to be used for an operation that is executed through the
  * PSA Driver wrapper layer as the union of all possible driver's contexts.
  *
@@ -111,6 +131,9 @@ typedef union {
     mbedtls_transparent_test_driver_cipher_operation_t transparent_test_driver_ctx;
     mbedtls_opaque_test_driver_cipher_operation_t opaque_test_driver_ctx;
 #endif
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+    nu_crpt_cipher_operation_t nu_crpt_ctx;
+#endif
 } psa_driver_cipher_context_t;
 
 #endif /* PSA_CRYPTO_DRIVER_CONTEXTS_PRIMITIVES_H */
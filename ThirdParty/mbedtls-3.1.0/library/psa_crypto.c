@@ -983,7 +983,24 @@ psa_status_t psa_remove_key_data_from_memory( psa_key_slot_t *slot )
  * Persistent storage is not affected. */
 psa_status_t psa_wipe_key_slot( psa_key_slot_t *slot )
 {
-    psa_status_t status = psa_remove_key_data_from_memory( slot );
+    psa_status_t status;
+    psa_status_t destroy_status = PSA_SUCCESS;
+
+    /* Let an opaque driver release key material it holds elsewhere, e.g.
+     * in a hardware key store, before the key buffer goes away. */
+    if( slot->key.data != NULL )
+    {
+        psa_key_attributes_t attributes = {
+            .core = slot->attr
+        };
+        destroy_status = psa_driver_wrapper_destroy_key( &attributes,
+                                                         slot->key.data,
+                                                         slot->key.bytes );
+    }
+
+    status = psa_remove_key_data_from_memory( slot );
+    if( status == PSA_SUCCESS )
+        status = destroy_status;
 
    /*
     * As the return error code may not be handled in case of multiple errors,
@@ -44,6 +44,16 @@
 #include "test/drivers/test_driver.h"
 #endif /* PSA_CRYPTO_DRIVER_TEST */
 
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+#ifndef PSA_CRYPTO_DRIVER_PRESENT
+#define PSA_CRYPTO_DRIVER_PRESENT
+#endif
+#ifndef PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT
+#define PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT
+#endif
+#include "psa_crypto_driver_crpt.h"
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
+
 /* Repeat above block for each JSON-declared driver during autogeneration */
 #endif /* MBEDTLS_PSA_CRYPTO_DRIVERS */
 
@@ -57,6 +67,11 @@
 #define PSA_CRYPTO_OPAQUE_TEST_DRIVER_ID (3)
 #endif /* PSA_CRYPTO_DRIVER_TEST */
 
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+#define PSA_CRYPTO_NU_CRPT_TRANSPARENT_DRIVER_ID (4)
+#define PSA_CRYPTO_NU_CRPT_OPAQUE_DRIVER_ID (5)
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
+
 /* Support the 'old' SE interface when asked to */
 #if defined(MBEDTLS_PSA_CRYPTO_SE_C)
 /* PSA_CRYPTO_DRIVER_PRESENT is defined when either a new-style or old-style
@@ -87,6 +102,16 @@ psa_status_t psa_driver_wrapper_init( void )
         return( status );
 #endif
 
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+    status = nu_crpt_transparent_init( );
+    if( status != PSA_SUCCESS )
+        return( status );
+
+    status = nu_crpt_opaque_init( );
+    if( status != PSA_SUCCESS )
+        return( status );
+#endif
+
     (void) status;
     return( PSA_SUCCESS );
 }
@@ -103,6 +128,11 @@ void psa_driver_wrapper_free( void )
     mbedtls_test_transparent_free( );
     mbedtls_test_opaque_free( );
 #endif
+
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+    nu_crpt_transparent_free( );
+    nu_crpt_opaque_free( );
+#endif
 }
 
 /* Start delegation functions */
@@ -302,6 +332,21 @@ psa_status_t psa_driver_wrapper_sign_hash(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_sign_hash(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg,
+                        hash,
+                        hash_length,
+                        signature,
+                        signature_size,
+                        signature_length );
+            /* Declared with fallback == true */
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
             /* Fell through, meaning no accelerator supports this operation */
             return( psa_sign_hash_builtin( attributes,
@@ -328,6 +373,19 @@ psa_status_t psa_driver_wrapper_sign_hash(
                                                              signature_size,
                                                              signature_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            return( nu_crpt_opaque_sign_hash(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg,
+                        hash,
+                        hash_length,
+                        signature,
+                        signature_size,
+                        signature_length ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
         default:
             /* Key is declared with a lifetime not known to us */
@@ -386,6 +444,20 @@ psa_status_t psa_driver_wrapper_verify_hash(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_verify_hash(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg,
+                        hash,
+                        hash_length,
+                        signature,
+                        signature_length );
+            /* Declared with fallback == true */
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 
             return( psa_verify_hash_builtin( attributes,
@@ -410,6 +482,18 @@ psa_status_t psa_driver_wrapper_verify_hash(
                                                                signature,
                                                                signature_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            return( nu_crpt_opaque_verify_hash(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg,
+                        hash,
+                        hash_length,
+                        signature,
+                        signature_length ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
         default:
             /* Key is declared with a lifetime not known to us */
@@ -450,6 +534,13 @@ psa_status_t psa_driver_wrapper_get_key_buffer_size_from_key_data(
             return( ( *key_buffer_size != 0 ) ?
                     PSA_SUCCESS : PSA_ERROR_NOT_SUPPORTED );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            *key_buffer_size = nu_crpt_opaque_size_function( key_type,
+                                     PSA_BYTES_TO_BITS( data_length ) );
+            return( ( *key_buffer_size != 0 ) ?
+                    PSA_SUCCESS : PSA_ERROR_NOT_SUPPORTED );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 
         default:
             (void)key_type;
@@ -502,6 +593,13 @@ psa_status_t psa_driver_wrapper_get_key_buffer_size(
             return( ( *key_buffer_size != 0 ) ?
                     PSA_SUCCESS : PSA_ERROR_NOT_SUPPORTED );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            *key_buffer_size = nu_crpt_opaque_size_function( key_type,
+                                                             key_bits );
+            return( ( *key_buffer_size != 0 ) ?
+                    PSA_SUCCESS : PSA_ERROR_NOT_SUPPORTED );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 
         default:
             (void)key_type;
@@ -571,6 +669,12 @@ psa_status_t psa_driver_wrapper_generate_key(
                 attributes, key_buffer, key_buffer_size, key_buffer_length );
             break;
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            status = nu_crpt_opaque_generate_key(
+                attributes, key_buffer, key_buffer_size, key_buffer_length );
+            break;
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 
         default:
@@ -656,6 +760,14 @@ psa_status_t psa_driver_wrapper_import_key(
                          key_buffer, key_buffer_size,
                          key_buffer_length, bits ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            return( nu_crpt_opaque_import_key(
+                        attributes,
+                        data, data_length,
+                        key_buffer, key_buffer_size,
+                        key_buffer_length, bits ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
         default:
             (void)status;
@@ -715,6 +827,11 @@ psa_status_t psa_driver_wrapper_export_key(
                                                     data_size,
                                                     data_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            /* Key Store keys are not readable */
+            return( PSA_ERROR_NOT_SUPPORTED );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
         default:
             /* Key is declared with a lifetime not known to us */
@@ -770,6 +887,18 @@ psa_status_t psa_driver_wrapper_export_public_key(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_export_public_key(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        data,
+                        data_size,
+                        data_length );
+            /* Declared with fallback == true */
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
             /* Fell through, meaning no accelerator supports this operation */
             return( psa_export_public_key_internal( attributes,
@@ -790,6 +919,16 @@ psa_status_t psa_driver_wrapper_export_public_key(
                                                            data_size,
                                                            data_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            return( nu_crpt_opaque_export_public_key(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        data,
+                        data_size,
+                        data_length ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
         default:
             /* Key is declared with a lifetime not known to us */
@@ -853,6 +992,11 @@ psa_status_t psa_driver_wrapper_copy_key(
                                                   target_key_buffer_size,
                                                   target_key_buffer_length) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            /* Key Store keys are not readable */
+            return( PSA_ERROR_NOT_SUPPORTED );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
         default:
             (void)source_key;
@@ -865,6 +1009,33 @@ psa_status_t psa_driver_wrapper_copy_key(
     return( status );
 }
 
+/** Release the key material an opaque driver holds outside the key slot.
+ *
+ * Called when a key slot is wiped. Keys in local storage and keys of
+ * drivers that keep everything in the key buffer need nothing.
+ */
+psa_status_t psa_driver_wrapper_destroy_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size )
+{
+    psa_key_location_t location =
+        PSA_KEY_LIFETIME_GET_LOCATION( attributes->core.lifetime );
+
+    switch( location )
+    {
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            return( nu_crpt_opaque_destroy_key( attributes,
+                                                key_buffer,
+                                                key_buffer_size ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
+        default:
+            (void)key_buffer;
+            (void)key_buffer_size;
+            return( PSA_SUCCESS );
+    }
+}
+
 /*
  * Cipher functions
  */
@@ -907,6 +1078,23 @@ psa_status_t psa_driver_wrapper_cipher_encrypt(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_cipher_encrypt(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg,
+                        iv,
+                        iv_length,
+                        input,
+                        input_length,
+                        output,
+                        output_size,
+                        output_length );
+            /* Declared with fallback == true */
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 
 #if defined(MBEDTLS_PSA_BUILTIN_CIPHER)
@@ -941,6 +1129,21 @@ psa_status_t psa_driver_wrapper_cipher_encrypt(
                                                         output_size,
                                                         output_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            return( nu_crpt_opaque_cipher_encrypt(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg,
+                        iv,
+                        iv_length,
+                        input,
+                        input_length,
+                        output,
+                        output_size,
+                        output_length ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 
         default:
@@ -995,6 +1198,21 @@ psa_status_t psa_driver_wrapper_cipher_decrypt(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_cipher_decrypt(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg,
+                        input,
+                        input_length,
+                        output,
+                        output_size,
+                        output_length );
+            /* Declared with fallback == true */
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 
 #if defined(MBEDTLS_PSA_BUILTIN_CIPHER)
@@ -1025,6 +1243,19 @@ psa_status_t psa_driver_wrapper_cipher_decrypt(
                                                         output_size,
                                                         output_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            return( nu_crpt_opaque_cipher_decrypt(
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg,
+                        input,
+                        input_length,
+                        output,
+                        output_size,
+                        output_length ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 
         default:
@@ -1072,6 +1303,20 @@ psa_status_t psa_driver_wrapper_cipher_encrypt_setup(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_cipher_encrypt_setup(
+                        &operation->ctx.nu_crpt_ctx,
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg );
+            /* Declared with fallback == true */
+            if( status == PSA_SUCCESS )
+                operation->id = PSA_CRYPTO_NU_CRPT_TRANSPARENT_DRIVER_ID;
+
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 #if defined(MBEDTLS_PSA_BUILTIN_CIPHER)
             /* Fell through, meaning no accelerator supports this operation */
@@ -1103,6 +1348,19 @@ psa_status_t psa_driver_wrapper_cipher_encrypt_setup(
 
             return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            status = nu_crpt_opaque_cipher_encrypt_setup(
+                         &operation->ctx.nu_crpt_ctx,
+                         attributes,
+                         key_buffer, key_buffer_size,
+                         alg );
+
+            if( status == PSA_SUCCESS )
+                operation->id = PSA_CRYPTO_NU_CRPT_OPAQUE_DRIVER_ID;
+
+            return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
         default:
             /* Key is declared with a lifetime not known to us */
@@ -1145,6 +1403,20 @@ psa_status_t psa_driver_wrapper_cipher_decrypt_setup(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_cipher_decrypt_setup(
+                        &operation->ctx.nu_crpt_ctx,
+                        attributes,
+                        key_buffer,
+                        key_buffer_size,
+                        alg );
+            /* Declared with fallback == true */
+            if( status == PSA_SUCCESS )
+                operation->id = PSA_CRYPTO_NU_CRPT_TRANSPARENT_DRIVER_ID;
+
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 #if defined(MBEDTLS_PSA_BUILTIN_CIPHER)
             /* Fell through, meaning no accelerator supports this operation */
@@ -1175,6 +1447,19 @@ psa_status_t psa_driver_wrapper_cipher_decrypt_setup(
 
             return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_KS_LOCATION:
+            status = nu_crpt_opaque_cipher_decrypt_setup(
+                         &operation->ctx.nu_crpt_ctx,
+                         attributes,
+                         key_buffer, key_buffer_size,
+                         alg );
+
+            if( status == PSA_SUCCESS )
+                operation->id = PSA_CRYPTO_NU_CRPT_OPAQUE_DRIVER_ID;
+
+            return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
         default:
             /* Key is declared with a lifetime not known to us */
@@ -1213,6 +1498,13 @@ psa_status_t psa_driver_wrapper_cipher_set_iv(
                         &operation->ctx.opaque_test_driver_ctx,
                         iv, iv_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_TRANSPARENT_DRIVER_ID:
+        case PSA_CRYPTO_NU_CRPT_OPAQUE_DRIVER_ID:
+            return( nu_crpt_cipher_set_iv(
+                        &operation->ctx.nu_crpt_ctx,
+                        iv, iv_length ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
     }
 
@@ -1256,6 +1548,14 @@ psa_status_t psa_driver_wrapper_cipher_update(
                         input, input_length,
                         output, output_size, output_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_TRANSPARENT_DRIVER_ID:
+        case PSA_CRYPTO_NU_CRPT_OPAQUE_DRIVER_ID:
+            return( nu_crpt_cipher_update(
+                        &operation->ctx.nu_crpt_ctx,
+                        input, input_length,
+                        output, output_size, output_length ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
     }
 
@@ -1296,6 +1596,13 @@ psa_status_t psa_driver_wrapper_cipher_finish(
                         &operation->ctx.opaque_test_driver_ctx,
                         output, output_size, output_length ) );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_TRANSPARENT_DRIVER_ID:
+        case PSA_CRYPTO_NU_CRPT_OPAQUE_DRIVER_ID:
+            return( nu_crpt_cipher_finish(
+                        &operation->ctx.nu_crpt_ctx,
+                        output, output_size, output_length ) );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
     }
 
@@ -1336,6 +1643,15 @@ psa_status_t psa_driver_wrapper_cipher_abort(
                 sizeof( operation->ctx.opaque_test_driver_ctx ) );
             return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+        case PSA_CRYPTO_NU_CRPT_TRANSPARENT_DRIVER_ID:
+        case PSA_CRYPTO_NU_CRPT_OPAQUE_DRIVER_ID:
+            status = nu_crpt_cipher_abort( &operation->ctx.nu_crpt_ctx );
+            mbedtls_platform_zeroize(
+                &operation->ctx.nu_crpt_ctx,
+                sizeof( operation->ctx.nu_crpt_ctx ) );
+            return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
     }
 
@@ -1363,6 +1679,12 @@ psa_status_t psa_driver_wrapper_hash_compute(
     if( status != PSA_ERROR_NOT_SUPPORTED )
         return( status );
 #endif
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+    status = nu_crpt_transparent_hash_compute(
+                alg, input, input_length, hash, hash_size, hash_length );
+    if( status != PSA_ERROR_NOT_SUPPORTED )
+        return( status );
+#endif
 
     /* If software fallback is compiled in, try fallback */
 #if defined(MBEDTLS_PSA_BUILTIN_HASH)
@@ -1543,6 +1865,18 @@ psa_status_t psa_driver_wrapper_aead_encrypt(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_aead_encrypt(
+                        attributes, key_buffer, key_buffer_size,
+                        alg,
+                        nonce, nonce_length,
+                        additional_data, additional_data_length,
+                        plaintext, plaintext_length,
+                        ciphertext, ciphertext_size, ciphertext_length );
+            /* Declared with fallback == true */
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 
             /* Fell through, meaning no accelerator supports this operation */
@@ -1595,6 +1929,18 @@ psa_status_t psa_driver_wrapper_aead_decrypt(
             if( status != PSA_ERROR_NOT_SUPPORTED )
                 return( status );
 #endif /* PSA_CRYPTO_DRIVER_TEST */
+#if defined(PSA_CRYPTO_DRIVER_NU_CRPT)
+            status = nu_crpt_transparent_aead_decrypt(
+                        attributes, key_buffer, key_buffer_size,
+                        alg,
+                        nonce, nonce_length,
+                        additional_data, additional_data_length,
+                        ciphertext, ciphertext_length,
+                        plaintext, plaintext_size, plaintext_length );
+            /* Declared with fallback == true */
+            if( status != PSA_ERROR_NOT_SUPPORTED )
+                return( status );
+#endif /* PSA_CRYPTO_DRIVER_NU_CRPT */
 #endif /* PSA_CRYPTO_ACCELERATOR_DRIVER_PRESENT */
 
             /* Fell through, meaning no accelerator supports this operation */
@@ -111,6 +111,11 @@ psa_status_t psa_driver_wrapper_copy_key(
     const uint8_t *source_key, size_t source_key_length,
     uint8_t *target_key_buffer, size_t target_key_buffer_size,
     size_t *target_key_buffer_length );
+
+psa_status_t psa_driver_wrapper_destroy_key(
+    const psa_key_attributes_t *attributes,
+    const uint8_t *key_buffer, size_t key_buffer_size );
+
 /*
  * Cipher functions
  */
@@ -14,6 +14,7 @@
  *   Allan Stockdill-Mander/Ian Craggs - initial API and implementation and/or initial documentation
  *   Ian Craggs - fix for #96 - check rem_len in readPacket
  *   Ian Craggs - add ability to set message handler separately #6
+ *   inflight window for QoS 1/2 publishes, MQTTPublishAsync
  *******************************************************************************/
 #include "MQTTClient.h"
 
@@ -26,8 +27,24 @@ static void NewMessageData(MessageData* md, MQTTString* aTopicName, MQTTMessage*
 }
 
 
+static int findInflight(MQTTClient* c, unsigned short id)
+{
+    int i;
+
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+    {
+        if (c->inflight[i].id == id)
+            return i;
+    }
+    return -1;
+}
+
+
 static int getNextPacketId(MQTTClient *c) {
-    return c->next_packetid = (c->next_packetid == MAX_PACKET_ID) ? 1 : c->next_packetid + 1;
+    do
+        c->next_packetid = (c->next_packetid == MAX_PACKET_ID) ? 1 : c->next_packetid + 1;
+    while (c->inflight_count > 0 && findInflight(c, c->next_packetid) >= 0); /* still in use */
+    return c->next_packetid;
 }
 
 
@@ -71,6 +88,10 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
     c->cleansession = 0;
     c->ping_outstanding = 0;
     c->defaultMessageHandler = NULL;
+    c->publishCompleteHandler = NULL;
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+        c->inflight[i].id = 0;
+    c->inflight_count = 0;
 	  c->next_packetid = 1;
     TimerInit(&c->last_sent);
     TimerInit(&c->last_received);
@@ -236,12 +257,102 @@ exit:
 }
 
 
+static void completeInflight(MQTTClient* c, int i, int rc)
+{
+    unsigned short id = c->inflight[i].id;
+
+    c->inflight[i].id = 0;
+    c->inflight_count--;
+    if (c->publishCompleteHandler != NULL)
+        c->publishCompleteHandler(id, rc);
+}
+
+
+// send the packet the inflight message is at: PUBLISH while waiting for PUBACK or PUBREC, PUBREL while waiting for PUBCOMP
+static int sendInflight(MQTTClient* c, int i, unsigned char dup, Timer* timer)
+{
+    struct InflightMessage* m = &c->inflight[i];
+    MQTTString topic = MQTTString_initializer;
+    int len;
+
+    if (m->ack == PUBCOMP)
+        len = MQTTSerialize_ack(c->buf, c->buf_size, PUBREL, 0, m->id);
+    else
+    {
+        topic.cstring = (char*)m->topicName;
+        len = MQTTSerialize_publish(c->buf, c->buf_size, dup, m->message.qos, m->message.retained, m->id,
+                  topic, (unsigned char*)m->message.payload, m->message.payloadlen);
+    }
+    if (len <= 0)
+        return FAILURE;
+    TimerCountdownMS(&m->retry, MQTT_RETRY_INTERVAL_MS);
+    return sendPacket(c, len, timer);
+}
+
+
+static int retryInflight(MQTTClient* c)
+{
+    int i, rc = SUCCESS;
+
+    if (c->inflight_count == 0 || !c->isconnected)
+        goto exit;
+
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+    {
+        if (c->inflight[i].id != 0 && TimerIsExpired(&c->inflight[i].retry))
+        {
+            Timer timer;
+            if (c->inflight[i].retries++ >= MQTT_MAX_RETRIES)
+            {
+                rc = FAILURE; /* the server stopped acknowledging, treat the connection as lost */
+                break;
+            }
+            TimerInit(&timer);
+            TimerCountdownMS(&timer, c->command_timeout_ms);
+            if ((rc = sendInflight(c, i, 1, &timer)) != SUCCESS)
+                break;
+        }
+    }
+
+exit:
+    return rc;
+}
+
+
+// match an acknowledgement in readbuf against the inflight window, moving a QoS 2 message on from PUBREC to PUBCOMP
+static void ackInflight(MQTTClient* c, int packet_type)
+{
+    unsigned short mypacketid;
+    unsigned char dup, type;
+    int i;
+
+    if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1 || mypacketid == 0)
+        return;
+    if ((i = findInflight(c, mypacketid)) < 0)
+        return; /* a duplicate, or not ours */
+
+    if (packet_type == PUBREC && c->inflight[i].ack == PUBREC)
+    {
+        c->inflight[i].ack = PUBCOMP;
+        c->inflight[i].retries = 0;
+        TimerCountdownMS(&c->inflight[i].retry, MQTT_RETRY_INTERVAL_MS);
+    }
+    else if (packet_type == c->inflight[i].ack)
+        completeInflight(c, i, SUCCESS);
+}
+
+
 void MQTTCleanSession(MQTTClient* c)
 {
     int i = 0;
 
     for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
         c->messageHandlers[i].topicFilter = NULL;
+    for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+    {
+        if (c->inflight[i].id != 0)
+            completeInflight(c, i, FAILURE);
+    }
 }
 
 
@@ -258,9 +369,13 @@ int cycle(MQTTClient* c, Timer* timer)
 {
     int len = 0,
         rc = SUCCESS;
+    Timer ack_timer;    /* acks are sent in full even if the read timer has run out */
 
     int packet_type = readPacket(c, timer);     /* read the socket, see what work is due */
 
+    TimerInit(&ack_timer);
+    TimerCountdownMS(&ack_timer, c->command_timeout_ms);
+
     switch (packet_type)
     {
         default:
@@ -269,8 +384,10 @@ int cycle(MQTTClient* c, Timer* timer)
             goto exit;
         case 0: /* timed out reading packet */
             break;
-        case CONNACK:
         case PUBACK:
+            ackInflight(c, packet_type);
+            break;
+        case CONNACK:
         case SUBACK:
         case UNSUBACK:
             break;
@@ -294,7 +411,7 @@ int cycle(MQTTClient* c, Timer* timer)
                 if (len <= 0)
                     rc = FAILURE;
                 else
-                    rc = sendPacket(c, len, timer);
+                    rc = sendPacket(c, len, &ack_timer);
                 if (rc == FAILURE)
                     goto exit; // there was a problem
             }
@@ -305,12 +422,14 @@ int cycle(MQTTClient* c, Timer* timer)
         {
             unsigned short mypacketid;
             unsigned char dup, type;
+            if (packet_type == PUBREC)
+                ackInflight(c, packet_type);
             if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
                 rc = FAILURE;
             else if ((len = MQTTSerialize_ack(c->buf, c->buf_size,
                 (packet_type == PUBREC) ? PUBREL : PUBCOMP, 0, mypacketid)) <= 0)
                 rc = FAILURE;
-            else if ((rc = sendPacket(c, len, timer)) != SUCCESS) // send the PUBREL packet
+            else if ((rc = sendPacket(c, len, &ack_timer)) != SUCCESS) // send the PUBREL packet
                 rc = FAILURE; // there was a problem
             if (rc == FAILURE)
                 goto exit; // there was a problem
@@ -318,12 +437,16 @@ int cycle(MQTTClient* c, Timer* timer)
         }
 
         case PUBCOMP:
+            ackInflight(c, packet_type);
             break;
         case PINGRESP:
             c->ping_outstanding = 0;
             break;
     }
 
+    if (retryInflight(c) != SUCCESS)
+        rc = FAILURE;
+
     if (keepalive(c) != SUCCESS) {
         //check only keepalive FAILURE status so that previous FAILURE status can be considered as FAULT
         rc = FAILURE;
@@ -453,8 +576,24 @@ int MQTTConnectWithResults(MQTTClient* c, MQTTPacket_connectData* options, MQTTC
 exit:
     if (rc == SUCCESS)
     {
+        int i;
+
         c->isconnected = 1;
         c->ping_outstanding = 0;
+        /* resend anything still unacknowledged from the previous connection on the next cycle,
+           unless the server starts a clean session */
+        for (i = 0; i < MAX_INFLIGHT_MESSAGES; ++i)
+        {
+            if (c->inflight[i].id == 0)
+                continue;
+            if (c->cleansession)
+                completeInflight(c, i, FAILURE);
+            else
+            {
+                c->inflight[i].retries = 0;
+                TimerCountdownMS(&c->inflight[i].retry, 0);
+            }
+        }
     }
 
 #if defined(MQTT_TASK)
@@ -614,13 +753,52 @@ exit:
 }
 
 
-int MQTTPublish(MQTTClient* c, const char* topicName, MQTTMessage* message)
+// send a publish, taking an inflight slot for QoS 1 and 2; waits for a free slot if the window is full
+static int publish(MQTTClient* c, const char* topicName, MQTTMessage* message, Timer* timer)
 {
     int rc = FAILURE;
-    Timer timer;
     MQTTString topic = MQTTString_initializer;
     topic.cstring = (char *)topicName;
     int len = 0;
+    int i;
+
+    if (message->qos == QOS0)
+    {
+        len = MQTTSerialize_publish(c->buf, c->buf_size, 0, message->qos, message->retained, message->id,
+                  topic, (unsigned char*)message->payload, message->payloadlen);
+        if (len > 0)
+            rc = sendPacket(c, len, timer);
+        goto exit;
+    }
+
+    while (c->inflight_count >= MAX_INFLIGHT_MESSAGES)
+    {
+        if (TimerIsExpired(timer) || cycle(c, timer) < 0)
+            goto exit;
+    }
+
+    i = findInflight(c, 0);
+    message->id = getNextPacketId(c);
+    c->inflight[i].id = message->id;
+    c->inflight[i].ack = (message->qos == QOS1) ? PUBACK : PUBREC;
+    c->inflight[i].retries = 0;
+    c->inflight[i].topicName = topicName;
+    c->inflight[i].message = *message;
+    TimerInit(&c->inflight[i].retry);
+    c->inflight_count++;
+
+    if ((rc = sendInflight(c, i, 0, timer)) != SUCCESS)
+        completeInflight(c, i, FAILURE);
+
+exit:
+    return rc;
+}
+
+
+int MQTTPublishAsync(MQTTClient* c, const char* topicName, MQTTMessage* message)
+{
+    int rc = FAILURE;
+    Timer timer;
 
 #if defined(MQTT_TASK)
 	  MutexLock(&c->mutex);
@@ -631,39 +809,46 @@ int MQTTPublish(MQTTClient* c, const char* topicName, MQTTMessage* message)
     TimerInit(&timer);
     TimerCountdownMS(&timer, c->command_timeout_ms);
 
-    if (message->qos == QOS1 || message->qos == QOS2)
-        message->id = getNextPacketId(c);
+    rc = publish(c, topicName, message, &timer);
 
-    len = MQTTSerialize_publish(c->buf, c->buf_size, 0, message->qos, message->retained, message->id,
-              topic, (unsigned char*)message->payload, message->payloadlen);
-    if (len <= 0)
-        goto exit;
-    if ((rc = sendPacket(c, len, &timer)) != SUCCESS) // send the subscribe packet
-        goto exit; // there was a problem
+exit:
+    if (rc == FAILURE)
+        MQTTCloseSession(c);
+#if defined(MQTT_TASK)
+	  MutexUnlock(&c->mutex);
+#endif
+    return rc;
+}
+
+
+int MQTTPublish(MQTTClient* c, const char* topicName, MQTTMessage* message)
+{
+    int rc = FAILURE;
+    Timer timer;
+    int i;
 
-    if (message->qos == QOS1)
+#if defined(MQTT_TASK)
+	  MutexLock(&c->mutex);
+#endif
+	  if (!c->isconnected)
+		    goto exit;
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, c->command_timeout_ms);
+
+    if ((rc = publish(c, topicName, message, &timer)) != SUCCESS || message->qos == QOS0)
+        goto exit; // there was a problem, or nothing to wait for
+
+    // wait for the acks of this message; others in the window are matched along the way
+    while ((i = findInflight(c, message->id)) >= 0)
     {
-        if (waitfor(c, PUBACK, &timer) == PUBACK)
+        if (TimerIsExpired(&timer) || cycle(c, &timer) < 0)
         {
-            unsigned short mypacketid;
-            unsigned char dup, type;
-            if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
-                rc = FAILURE;
-        }
-        else
+            if ((i = findInflight(c, message->id)) >= 0)
+                completeInflight(c, i, FAILURE); // the message is about to go out of scope
             rc = FAILURE;
-    }
-    else if (message->qos == QOS2)
-    {
-        if (waitfor(c, PUBCOMP, &timer) == PUBCOMP)
-        {
-            unsigned short mypacketid;
-            unsigned char dup, type;
-            if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
-                rc = FAILURE;
+            break;
         }
-        else
-            rc = FAILURE;
     }
 
 exit:
@@ -676,6 +861,18 @@ exit:
 }
 
 
+void MQTTSetPublishCompleteHandler(MQTTClient* c, publishHandler handler)
+{
+    c->publishCompleteHandler = handler;
+}
+
+
+int MQTTInflightCount(MQTTClient* c)
+{
+    return c->inflight_count;
+}
+
+
 int MQTTDisconnect(MQTTClient* c)
 {
     int rc = FAILURE;
@@ -51,6 +51,18 @@
 #define MAX_MESSAGE_HANDLERS 5 /* redefinable - how many subscriptions do you want? */
 #endif
 
+#if !defined(MAX_INFLIGHT_MESSAGES)
+#define MAX_INFLIGHT_MESSAGES 4 /* redefinable - how many QoS 1/2 publishes may await acknowledgement */
+#endif
+
+#if !defined(MQTT_RETRY_INTERVAL_MS)
+#define MQTT_RETRY_INTERVAL_MS 10000 /* redefinable - resend an unacknowledged publish after this time */
+#endif
+
+#if !defined(MQTT_MAX_RETRIES)
+#define MQTT_MAX_RETRIES 3 /* redefinable - give up and close the session after this many resends */
+#endif
+
 enum QoS { QOS0, QOS1, QOS2, SUBFAIL=0x80 };
 
 /* all failure return codes must be negative */
@@ -102,6 +114,8 @@ typedef struct MQTTSubackData
 
 typedef void (*messageHandler)(MessageData*);
 
+typedef void (*publishHandler)(unsigned short id, int rc);
+
 typedef struct MQTTClient
 {
     unsigned int next_packetid,
@@ -123,6 +137,19 @@ typedef struct MQTTClient
 
     void (*defaultMessageHandler) (MessageData*);
 
+    struct InflightMessage
+    {
+        unsigned short id;              /* 0 when the slot is free */
+        unsigned char ack;              /* PUBACK, PUBREC or PUBCOMP expected next */
+        unsigned char retries;
+        const char* topicName;
+        MQTTMessage message;
+        Timer retry;
+    } inflight[MAX_INFLIGHT_MESSAGES];  /* QoS 1/2 publishes awaiting acknowledgement */
+    int inflight_count;
+
+    void (*publishCompleteHandler) (unsigned short id, int rc);
+
     Network* ipstack;
     Timer last_sent, last_received;
 #if defined(MQTT_TASK)
@@ -167,6 +194,30 @@ DLLExport int MQTTConnect(MQTTClient* client, MQTTPacket_connectData* options);
  */
 DLLExport int MQTTPublish(MQTTClient* client, const char*, MQTTMessage*);
 
+/** MQTT Publish Async - send an MQTT publish packet without waiting for its acks
+ *  QoS 1 and 2 messages are kept in the inflight window until they are acknowledged,
+ *  which happens in MQTTYield or the background task. The call only blocks while all
+ *  MAX_INFLIGHT_MESSAGES slots are in use. The topic and payload are not copied and
+ *  must remain valid until the publish complete handler is called for message->id.
+ *  @param client - the client object to use
+ *  @param topic - the topic to publish to
+ *  @param message - the message to send, id is set to the packet id used
+ *  @return success code
+ */
+DLLExport int MQTTPublishAsync(MQTTClient* client, const char*, MQTTMessage*);
+
+/** MQTT SetPublishCompleteHandler - set or remove the handler called when an async publish completes
+ *  @param client - the client object to use
+ *  @param handler - called with the packet id and SUCCESS or FAILURE, or NULL to remove
+ */
+DLLExport void MQTTSetPublishCompleteHandler(MQTTClient* client, publishHandler handler);
+
+/** MQTT InflightCount - number of QoS 1/2 publishes awaiting acknowledgement
+ *  @param client - the client object to use
+ *  @return count
+ */
+DLLExport int MQTTInflightCount(MQTTClient* client);
+
 /** MQTT SetMessageHandler - set or remove a per topic message handler
  *  @param client - the client object to use
  *  @param topicFilter - the topic filter set the message handler for
@@ -0,0 +1,568 @@
+/*******************************************************************************
+ * Copyright (c) 2009, 2017 IBM Corp.
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Ian Craggs - initial implementation for embedded C client
+ *    inflight window throughput tests
+ *******************************************************************************/
+
+
+/**
+ * @file
+ * Inflight window tests for the Paho embedded C "high" level client.
+ *
+ * A minimal broker stand-in runs in a thread of this program. It accepts one
+ * connection per test and answers PUBLISH packets after a simulated round trip
+ * time, so no external broker is needed.
+ */
+
+
+#include "MQTTClient.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+void usage(void)
+{
+	printf("options:\n  --test_no <n>\n  --port <stand-in broker port>\n  --rtt <ms>\n  --count <messages>\n  --verbose\n");
+	exit(EXIT_FAILURE);
+}
+
+struct Options
+{
+	int port;
+	int rtt_ms;
+	int count;
+	int verbose;
+	int test_no;
+} options =
+{
+	1886,
+	10,
+	200,
+	0, //verbose
+	0, //test_no
+};
+
+void getopts(int argc, char** argv)
+{
+	int count = 1;
+
+	while (count < argc)
+	{
+		if (strcmp(argv[count], "--test_no") == 0)
+		{
+			if (++count < argc)
+				options.test_no = atoi(argv[count]);
+			else
+				usage();
+		}
+		else if (strcmp(argv[count], "--port") == 0)
+		{
+			if (++count < argc)
+				options.port = atoi(argv[count]);
+			else
+				usage();
+		}
+		else if (strcmp(argv[count], "--rtt") == 0)
+		{
+			if (++count < argc)
+				options.rtt_ms = atoi(argv[count]);
+			else
+				usage();
+		}
+		else if (strcmp(argv[count], "--count") == 0)
+		{
+			if (++count < argc)
+				options.count = atoi(argv[count]);
+			else
+				usage();
+		}
+		else if (strcmp(argv[count], "--verbose") == 0)
+			options.verbose = 1;
+		else
+			usage();
+		count++;
+	}
+}
+
+
+#define LOGA_DEBUG 0
+#define LOGA_INFO 1
+void MyLog(int LOGA_level, char* format, ...)
+{
+	static char msg_buf[256];
+	va_list args;
+	struct timeval tv;
+	struct tm *timeinfo;
+
+	if (LOGA_level == LOGA_DEBUG && options.verbose == 0)
+	  return;
+
+	gettimeofday(&tv, NULL);
+	timeinfo = localtime(&tv.tv_sec);
+	strftime(msg_buf, 80, "%Y%m%d %H%M%S", timeinfo);
+
+	sprintf(&msg_buf[strlen(msg_buf)], ".%.3d ", (int)(tv.tv_usec / 1000));
+
+	va_start(args, format);
+	vsnprintf(&msg_buf[strlen(msg_buf)], sizeof(msg_buf) - strlen(msg_buf), format, args);
+	va_end(args);
+
+	printf("%s\n", msg_buf);
+	fflush(stdout);
+}
+
+
+#define START_TIME_TYPE struct timeval
+START_TIME_TYPE start_clock(void)
+{
+	struct timeval start_time;
+	gettimeofday(&start_time, NULL);
+	return start_time;
+}
+
+
+long elapsed(START_TIME_TYPE start_time)
+{
+	struct timeval now, res;
+
+	gettimeofday(&now, NULL);
+	timersub(&now, &start_time, &res);
+	return (res.tv_sec)*1000 + (res.tv_usec)/1000;
+}
+
+
+#define assert(a, b, ...) myassert(__FILE__, __LINE__, a, b, __VA_ARGS__)
+
+int tests = 0;
+int failures = 0;
+
+
+void myassert(char* filename, int lineno, char* description, int value, char* format, ...)
+{
+	++tests;
+	if (!value)
+	{
+		va_list args;
+
+		++failures;
+		MyLog(LOGA_INFO, "Assertion failed, file %s, line %d, description: %s\n", filename, lineno, description);
+
+		va_start(args, format);
+		vprintf(format, args);
+		va_end(args);
+		printf("\n");
+	}
+	else
+		MyLog(LOGA_DEBUG, "Assertion succeeded, file %s, line %d, description: %s", filename, lineno, description);
+}
+
+
+/*********************************************************************
+
+Broker stand-in: acknowledges each PUBLISH and PUBREL after rtt_ms.
+Every drop_every'th PUBLISH (0 = none) is not acknowledged the first
+time, so the client has to resend it with the dup flag set.
+
+*********************************************************************/
+#define STANDIN_QUEUE 64
+
+static struct
+{
+	int listen_fd;
+	int rtt_ms;
+	int drop_every;
+	int publishes;      /* PUBLISH packets received, including resends */
+	int dups;           /* ... of which had the dup flag set */
+	int connected;
+	struct
+	{
+		long due;
+		unsigned char type;
+		unsigned short id;
+	} queue[STANDIN_QUEUE];
+	int queued;
+} standin;
+
+
+static long now_ms(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000L + t.tv_nsec / 1000000L;
+}
+
+
+static int read_all(int fd, unsigned char* buf, int len)
+{
+	int got = 0;
+
+	while (got < len)
+	{
+		int rc = recv(fd, buf + got, len - got, 0);
+		if (rc <= 0)
+			return -1;
+		got += rc;
+	}
+	return got;
+}
+
+
+/* read one whole packet into buf, returns its type or -1 */
+static int standin_read(int fd, unsigned char* buf, int buflen)
+{
+	MQTTHeader header = {0};
+	int rem_len = 0, multiplier = 1, len = 1;
+	unsigned char c;
+
+	if (read_all(fd, buf, 1) != 1)
+		return -1;
+	do
+	{
+		if (read_all(fd, &c, 1) != 1 || len > 4)
+			return -1;
+		buf[len++] = c;
+		rem_len += (c & 127) * multiplier;
+		multiplier *= 128;
+	} while (c & 128);
+	if (rem_len > buflen - len || (rem_len > 0 && read_all(fd, buf + len, rem_len) != rem_len))
+		return -1;
+	header.byte = buf[0];
+	return header.bits.type;
+}
+
+
+static void standin_queue(unsigned char type, unsigned short id)
+{
+	if (standin.queued < STANDIN_QUEUE)
+	{
+		standin.queue[standin.queued].due = now_ms() + standin.rtt_ms;
+		standin.queue[standin.queued].type = type;
+		standin.queue[standin.queued].id = id;
+		standin.queued++;
+	}
+}
+
+
+static void* standin_run(void* arg)
+{
+	unsigned char buf[1024];
+	int fd = accept(standin.listen_fd, NULL, NULL);
+
+	standin.queued = 0;
+	while (fd >= 0)
+	{
+		long wait = -1;
+		struct timeval tv;
+		fd_set fds;
+		int i, rc;
+
+		/* send the acknowledgements that are due, in order */
+		while (standin.queued > 0 && (wait = standin.queue[0].due - now_ms()) <= 0)
+		{
+			int len = MQTTSerialize_ack(buf, sizeof(buf), standin.queue[0].type, 0, standin.queue[0].id);
+			if (send(fd, buf, len, 0) != len)
+				goto exit;
+			memmove(&standin.queue[0], &standin.queue[1], --standin.queued * sizeof(standin.queue[0]));
+			wait = -1;
+		}
+
+		FD_ZERO(&fds);
+		FD_SET(fd, &fds);
+		tv.tv_sec = 0;
+		tv.tv_usec = (wait < 0) ? 100000 : wait * 1000;
+		if ((rc = select(fd + 1, &fds, NULL, NULL, &tv)) < 0)
+			break;
+		if (rc == 0)
+			continue;
+
+		switch (standin_read(fd, buf, sizeof(buf)))
+		{
+			case CONNECT:
+				i = MQTTSerialize_connack(buf, sizeof(buf), 0, 0);
+				if (send(fd, buf, i, 0) != i)
+					goto exit;
+				standin.connected = 1;
+				break;
+			case PUBLISH:
+			{
+				unsigned char dup, retained;
+				unsigned short id;
+				int qos, payloadlen;
+				unsigned char* payload;
+				MQTTString topic;
+
+				MQTTDeserialize_publish(&dup, &qos, &retained, &id, &topic, &payload, &payloadlen, buf, sizeof(buf));
+				standin.publishes++;
+				if (dup)
+					standin.dups++;
+				else if (standin.drop_every && (standin.publishes % standin.drop_every) == 0)
+					break; /* lose the acknowledgement of the first attempt */
+				if (qos == 1)
+					standin_queue(PUBACK, id);
+				else if (qos == 2)
+					standin_queue(PUBREC, id);
+				break;
+			}
+			case PUBREL:
+			{
+				unsigned char dup, type;
+				unsigned short id;
+
+				MQTTDeserialize_ack(&type, &dup, &id, buf, sizeof(buf));
+				standin_queue(PUBCOMP, id);
+				break;
+			}
+			case PINGREQ:
+				buf[0] = PINGRESP << 4;
+				buf[1] = 0;
+				if (send(fd, buf, 2, 0) != 2)
+					goto exit;
+				break;
+			case DISCONNECT:
+			case -1:
+				goto exit;
+			default:
+				break;
+		}
+	}
+exit:
+	if (fd >= 0)
+		close(fd);
+	return NULL;
+}
+
+
+static pthread_t standin_start(int rtt_ms, int drop_every)
+{
+	pthread_t thread;
+
+	standin.rtt_ms = rtt_ms;
+	standin.drop_every = drop_every;
+	standin.publishes = standin.dups = standin.connected = 0;
+	pthread_create(&thread, NULL, standin_run, NULL);
+	return thread;
+}
+
+
+static int standin_listen(int port)
+{
+	struct sockaddr_in addr;
+	int on = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+/*********************************************************************
+
+Common client side
+
+*********************************************************************/
+static MQTTClient client;
+static Network network;
+static unsigned char sendbuf[256], readbuf[256];
+static char payload[] = "inflight window test payload";
+static int completed, completed_ok;
+
+
+void publishComplete(unsigned short id, int rc)
+{
+	completed++;
+	if (rc == SUCCESS)
+		completed_ok++;
+}
+
+
+static int connect_client(void)
+{
+	MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+	int rc;
+
+	NetworkInit(&network);
+	if ((rc = NetworkConnect(&network, "127.0.0.1", options.port)) != 0)
+		return rc;
+	MQTTClientInit(&client, &network, 2000, sendbuf, sizeof(sendbuf), readbuf, sizeof(readbuf));
+	MQTTSetPublishCompleteHandler(&client, publishComplete);
+	data.MQTTVersion = 4;
+	data.clientID.cstring = "inflight-test";
+	data.keepAliveInterval = 20;
+	data.cleansession = 1;
+	completed = completed_ok = 0;
+	return MQTTConnect(&client, &data);
+}
+
+
+static void disconnect_client(pthread_t thread)
+{
+	MQTTDisconnect(&client);
+	NetworkDisconnect(&network);
+	pthread_join(thread, NULL);
+}
+
+
+/* publish count messages with MQTTPublish or MQTTPublishAsync, returns the time taken in ms */
+static long publish_messages(int qos, int async, int count, int drop_every)
+{
+	pthread_t thread = standin_start(options.rtt_ms, drop_every);
+	START_TIME_TYPE start;
+	MQTTMessage msg;
+	long duration;
+	int i, rc;
+
+	rc = connect_client();
+	assert("Good rc from connect", rc == SUCCESS, "rc was %d", rc);
+	if (rc != SUCCESS)
+	{
+		pthread_cancel(thread);
+		return -1;
+	}
+
+	start = start_clock();
+	for (i = 0; i < count; ++i)
+	{
+		memset(&msg, 0, sizeof(msg));
+		msg.qos = (enum QoS)qos;
+		msg.payload = payload;
+		msg.payloadlen = strlen(payload);
+		rc = async ? MQTTPublishAsync(&client, "test/inflight", &msg) : MQTTPublish(&client, "test/inflight", &msg);
+		if (rc != SUCCESS)
+			break;
+	}
+	assert("Good rc from publish", rc == SUCCESS, "rc was %d at message %d", rc, i);
+
+	/* let the window drain */
+	while (rc == SUCCESS && MQTTInflightCount(&client) > 0 && elapsed(start) < 30000)
+		rc = MQTTYield(&client, 10);
+	duration = elapsed(start);
+
+	assert("Window drained", MQTTInflightCount(&client) == 0, "inflight count was %d", MQTTInflightCount(&client));
+	assert("All publishes acknowledged", completed_ok == count,
+		   "completed %d of %d, %d ok", completed, count, completed_ok);
+
+	disconnect_client(thread);
+	MyLog(LOGA_INFO, "%d QoS %d messages %s, RTT %d ms: %ld ms, %ld msg/s", count, qos,
+		  async ? "async" : "blocking", options.rtt_ms, duration, duration ? count * 1000L / duration : 0);
+	return duration;
+}
+
+
+/*********************************************************************
+
+Test1: QoS 1 throughput, blocking publish against the inflight window
+
+*********************************************************************/
+int test1(struct Options options)
+{
+	long blocking, async;
+
+	fprintf(stdout, "test1: QoS 1 throughput, window of %d\n", MAX_INFLIGHT_MESSAGES);
+	failures = 0;
+
+	blocking = publish_messages(QOS1, 0, options.count, 0);
+	async = publish_messages(QOS1, 1, options.count, 0);
+	if (MAX_INFLIGHT_MESSAGES > 1)
+		assert("Window is faster", async > 0 && async * 2 < blocking,
+			   "async %ld ms, blocking %ld ms", async, blocking);
+
+	MyLog(LOGA_INFO, "test1: %s. %d tests run, %d failures.", (failures == 0) ? "passed" : "failed", tests, failures);
+	return failures;
+}
+
+
+/*********************************************************************
+
+Test2: QoS 2 through the inflight window
+
+*********************************************************************/
+int test2(struct Options options)
+{
+	fprintf(stdout, "test2: QoS 2 throughput, window of %d\n", MAX_INFLIGHT_MESSAGES);
+	failures = 0;
+
+	publish_messages(QOS2, 0, options.count, 0);
+	publish_messages(QOS2, 1, options.count, 0);
+
+	MyLog(LOGA_INFO, "test2: %s. %d tests run, %d failures.", (failures == 0) ? "passed" : "failed", tests, failures);
+	return failures;
+}
+
+
+/*********************************************************************
+
+Test3: lost acknowledgements are recovered by resending with dup set
+
+*********************************************************************/
+int test3(struct Options options)
+{
+	fprintf(stdout, "test3: resend after MQTT_RETRY_INTERVAL_MS (%d ms)\n", MQTT_RETRY_INTERVAL_MS);
+	failures = 0;
+
+	publish_messages(QOS1, 1, 20, 5);
+	assert("Resends seen", standin.dups == 4, "dups was %d", standin.dups);
+
+	MyLog(LOGA_INFO, "test3: %s. %d tests run, %d failures.", (failures == 0) ? "passed" : "failed", tests, failures);
+	return failures;
+}
+
+
+int main(int argc, char** argv)
+{
+	int rc = 0;
+	int (*tests[])() = {NULL, test1, test2, test3};
+	int i;
+
+	getopts(argc, argv);
+
+	if ((standin.listen_fd = standin_listen(options.port)) < 0)
+	{
+		MyLog(LOGA_INFO, "cannot listen on port %d", options.port);
+		return EXIT_FAILURE;
+	}
+
+	if (options.test_no == 0)
+	{ /* run all the tests */
+		for (i = 1; i < ARRAY_SIZE(tests); ++i)
+			rc += tests[i](options); /* return number of failures.  0 = test succeeded */
+	}
+	else
+		rc = tests[options.test_no](options); /* run just the selected test */
+
+	close(standin.listen_fd);
+
+	if (rc == 0)
+		MyLog(LOGA_INFO, "verdict pass");
+	else
+		MyLog(LOGA_INFO, "verdict fail");
+	return rc;
+}